@@ -85,4 +85,12 @@
 #define SO_ATTACH_BPF		50
 #define SO_DETACH_BPF		SO_DETACH_FILTER
 
+#define SO_ATTACH_REUSEPORT_CBPF	51
+#define SO_ATTACH_REUSEPORT_EBPF	52
+
+#define SO_ZEROCOPY		53
+
+#define SO_TXTIME		54
+#define SCM_TXTIME		SO_TXTIME
+
 #endif /* _UAPI__ASM_AVR32_SOCKET_H */
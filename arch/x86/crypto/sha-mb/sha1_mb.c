@@ -74,6 +74,11 @@
 
 #define FLUSH_INTERVAL 1000 /* in usec */
 
+static unsigned int flush_interval = FLUSH_INTERVAL;
+module_param(flush_interval, uint, 0644);
+MODULE_PARM_DESC(flush_interval, "Longest time in usec a partially filled "
+		 "set of lanes waits for more requests before it is flushed");
+
 static struct mcryptd_alg_state sha1_mb_alg_state;
 
 struct sha1_mb_ctx {
@@ -473,7 +478,7 @@ static void sha1_mb_add_list(struct mcryptd_hash_request_ctx *rctx,
 			     struct mcryptd_alg_cstate *cstate)
 {
 	unsigned long next_flush;
-	unsigned long delay = usecs_to_jiffies(FLUSH_INTERVAL);
+	unsigned long delay = usecs_to_jiffies(ACCESS_ONCE(flush_interval));
 
 	/* initialize tag */
 	rctx->tag.arrival = jiffies;    /* tag the arrival time */
@@ -818,7 +823,8 @@ static struct ahash_alg sha1_mb_async_alg = {
 	},
 };
 
-static unsigned long sha1_mb_flusher(struct mcryptd_alg_cstate *cstate)
+static unsigned long sha1_mb_flusher(struct mcryptd_alg_cstate *cstate,
+				     bool force)
 {
 	struct mcryptd_hash_request_ctx *rctx;
 	unsigned long cur_time;
@@ -831,7 +837,7 @@ static unsigned long sha1_mb_flusher(struct mcryptd_alg_cstate *cstate)
 	while (!list_empty(&cstate->work_list)) {
 		rctx = list_entry(cstate->work_list.next,
 				struct mcryptd_hash_request_ctx, waiter);
-		if (time_before(cur_time, rctx->tag.expire))
+		if (!force && time_before(cur_time, rctx->tag.expire))
 			break;
 		kernel_fpu_begin();
 		sha_ctx = (struct sha1_hash_ctx *) sha1_ctx_mgr_flush(cstate->mgr);
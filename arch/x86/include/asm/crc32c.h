@@ -0,0 +1,20 @@
+#ifndef _ASM_X86_CRC32C_H
+#define _ASM_X86_CRC32C_H
+
+#include <linux/types.h>
+#include <asm/cpufeature.h>
+
+/*
+ * CRC32C using the SSE4.2 crc32 instruction, for lib/crc32.c.  These do
+ * not touch the FPU, so unlike the PCLMULQDQ version in arch/x86/crypto
+ * they can be called from any context without kernel_fpu_begin().
+ */
+static inline bool crc32c_arch_usable(void)
+{
+	return static_cpu_has(X86_FEATURE_XMM4_2);
+}
+
+u32 __pure crc32c_le_arch(u32 crc, unsigned char const *p, size_t len);
+void crc32c_le_arch_3way(u32 *crc, unsigned char const *const *p, size_t len);
+
+#endif /* _ASM_X86_CRC32C_H */
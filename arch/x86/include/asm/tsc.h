@@ -54,6 +54,8 @@ extern unsigned long native_calibrate_tsc(void);
 
 extern int tsc_clocksource_reliable;
 
+struct system_counterval_t convert_art_to_tsc(cycle_t art);
+
 /*
  * Boot-time check whether the TSCs are synchronized across
  * all CPUs/cores:
@@ -285,6 +285,43 @@ static void deassign_host_irq(struct kvm *kvm,
 	assigned_dev->irq_requested_type &= ~(KVM_DEV_IRQ_HOST_MASK);
 }
 
+/*
+ * Switch the host MSI/MSI-X vectors of @dev between posted delivery to the
+ * guest and ordinary remapped delivery to the host handlers.  Posting is
+ * only possible once both the host and the guest side are in MSI mode.
+ */
+static void kvm_assigned_dev_update_pi(struct kvm *kvm,
+				       struct kvm_assigned_dev_kernel *dev,
+				       bool set)
+{
+	unsigned long type = dev->irq_requested_type;
+	int i;
+
+	if (!kvm_x86_ops->update_pi_irte)
+		return;
+
+	if ((type & KVM_DEV_IRQ_HOST_MSI) && (type & KVM_DEV_IRQ_GUEST_MSI))
+		kvm_x86_ops->update_pi_irte(kvm, dev->host_irq,
+					    dev->guest_irq, set);
+	else if ((type & KVM_DEV_IRQ_HOST_MSIX) &&
+		 (type & KVM_DEV_IRQ_GUEST_MSIX))
+		for (i = 0; i < dev->entries_nr; i++)
+			kvm_x86_ops->update_pi_irte(kvm,
+				dev->host_msix_entries[i].vector,
+				dev->guest_msix_entries[i].vector, set);
+}
+
+/* Re-evaluate posting for every device after the MSI routing changed. */
+void kvm_assigned_dev_update_posting(struct kvm *kvm)
+{
+	struct kvm_assigned_dev_kernel *dev;
+
+	mutex_lock(&kvm->lock);
+	list_for_each_entry(dev, &kvm->arch.assigned_dev_head, list)
+		kvm_assigned_dev_update_pi(kvm, dev, true);
+	mutex_unlock(&kvm->lock);
+}
+
 static int kvm_deassign_irq(struct kvm *kvm,
 			    struct kvm_assigned_dev_kernel *assigned_dev,
 			    unsigned long irq_requested_type)
@@ -300,6 +337,10 @@ static int kvm_deassign_irq(struct kvm *kvm,
 	host_irq_type = irq_requested_type & KVM_DEV_IRQ_HOST_MASK;
 	guest_irq_type = irq_requested_type & KVM_DEV_IRQ_GUEST_MASK;
 
+	/* Hand interrupts back to the host before tearing either side down. */
+	if (host_irq_type || guest_irq_type)
+		kvm_assigned_dev_update_pi(kvm, assigned_dev, false);
+
 	if (host_irq_type)
 		deassign_host_irq(kvm, assigned_dev);
 	if (guest_irq_type)
@@ -336,6 +377,8 @@ static void kvm_free_assigned_device(struct kvm *kvm,
 
 	list_del(&assigned_dev->list);
 	kfree(assigned_dev);
+
+	kvm_arch_end_assignment(kvm);
 }
 
 void kvm_free_all_assigned_devices(struct kvm *kvm)
@@ -598,6 +641,8 @@ static int kvm_vm_ioctl_assign_irq(struct kvm *kvm,
 
 	if (guest_irq_type)
 		r = assign_guest_irq(kvm, match, assigned_irq, guest_irq_type);
+	if (!r)
+		kvm_assigned_dev_update_pi(kvm, match, true);
 out:
 	mutex_unlock(&kvm->lock);
 	return r;
@@ -768,6 +813,7 @@ static int kvm_vm_ioctl_assign_device(struct kvm *kvm,
 	match->ack_notifier.irq_acked = kvm_assigned_dev_ack_irq;
 
 	list_add(&match->list, &kvm->arch.assigned_dev_head);
+	kvm_arch_start_assignment(kvm);
 
 	if (!kvm->arch.iommu_domain) {
 		r = kvm_iommu_map_guest(kvm);
@@ -787,6 +833,7 @@ out_list_del:
 		printk(KERN_INFO "%s: Couldn't reload %s saved state\n",
 		       __func__, dev_name(&dev->dev));
 	list_del(&match->list);
+	kvm_arch_end_assignment(kvm);
 	pci_release_regions(dev);
 out_disable:
 	pci_disable_device(dev);
@@ -875,7 +875,7 @@ gfn_to_memslot_dirty_bitmap(struct kvm_vcpu *vcpu, gfn_t gfn,
 {
 	struct kvm_memory_slot *slot;
 
-	slot = gfn_to_memslot(vcpu->kvm, gfn);
+	slot = kvm_vcpu_gfn_to_memslot(vcpu, gfn);
 	if (!slot || slot->flags & KVM_MEMSLOT_INVALID ||
 	      (no_dirty_log && slot->dirty_bitmap))
 		slot = NULL;
@@ -2895,17 +2895,33 @@ static bool page_fault_can_be_fast(u32 error_code)
 		return false;
 
 	/*
-	 * #PF can be fast only if the shadow page table is present and it
-	 * is caused by write-protect, that means we just need change the
-	 * W bit of the spte which can be done out of mmu-lock.
+	 * #PF can be fast if:
+	 * 1. The shadow page table entry is present and the fault is caused
+	 *    by write-protect, that means we just need change the W bit of
+	 *    the spte which can be done out of mmu-lock.
+	 * 2. The fault is spurious: some other vcpu already installed an
+	 *    spte that allows the access while this one was exiting.  That
+	 *    is common when many vcpus touch fresh memory at the same time,
+	 *    and needs no change to the spte at all.
+	 *
+	 * Both are only handled for direct maps, which are the only callers
+	 * of fast_page_fault.
 	 */
-	if (!(error_code & PFERR_PRESENT_MASK) ||
-	      !(error_code & PFERR_WRITE_MASK))
-		return false;
-
 	return true;
 }
 
+static bool is_access_allowed(u32 error_code, u64 spte)
+{
+	if (error_code & PFERR_FETCH_MASK)
+		return (spte & (shadow_x_mask | shadow_nx_mask)) == shadow_x_mask;
+
+	if (error_code & PFERR_WRITE_MASK)
+		return is_writable_pte(spte);
+
+	/* Fault was on read access */
+	return spte & PT_PRESENT_MASK;
+}
+
 static bool
 fast_pf_fix_direct_spte(struct kvm_vcpu *vcpu, struct kvm_mmu_page *sp,
 			u64 *sptep, u64 spte)
@@ -2964,10 +2980,11 @@ static bool fast_page_fault(struct kvm_vcpu *vcpu, gva_t gva, int level,
 
 	/*
 	 * If the mapping has been changed, let the vcpu fault on the
-	 * same address again.
+	 * same address again.  A not-present fault on a still not-present
+	 * spte needs the slow path to build the mapping.
 	 */
 	if (!is_rmap_spte(spte)) {
-		ret = true;
+		ret = error_code & PFERR_PRESENT_MASK;
 		goto exit;
 	}
 
@@ -2976,16 +2993,23 @@ static bool fast_page_fault(struct kvm_vcpu *vcpu, gva_t gva, int level,
 		goto exit;
 
 	/*
-	 * Check if it is a spurious fault caused by TLB lazily flushed.
+	 * Check if it is a spurious fault caused by TLB lazily flushed, or
+	 * by another vcpu having mapped the page in the meantime.
 	 *
 	 * Need not check the access of upper level table entries since
 	 * they are always ACC_ALL.
 	 */
-	 if (is_writable_pte(spte)) {
+	if (is_access_allowed(error_code, spte)) {
+		++vcpu->stat.pf_spurious;
 		ret = true;
 		goto exit;
 	}
 
+	/* Everything below only fixes write-protected, present sptes. */
+	if (!(error_code & PFERR_PRESENT_MASK) ||
+	    !(error_code & PFERR_WRITE_MASK))
+		goto exit;
+
 	/*
 	 * Currently, to simplify the code, only the spte write-protected
 	 * by dirty-log can be fast fixed.
@@ -3012,6 +3036,8 @@ static bool fast_page_fault(struct kvm_vcpu *vcpu, gva_t gva, int level,
 	 * See Documentation/virtual/kvm/locking.txt to get more detail.
 	 */
 	ret = fast_pf_fix_direct_spte(vcpu, sp, iterator.sptep, spte);
+	if (ret)
+		++vcpu->stat.pf_fast;
 exit:
 	trace_fast_page_fault(vcpu, gva, error_code, iterator.sptep,
 			      spte, ret);
@@ -3475,9 +3501,12 @@ static bool can_do_async_pf(struct kvm_vcpu *vcpu)
 static bool try_async_pf(struct kvm_vcpu *vcpu, bool prefault, gfn_t gfn,
 			 gva_t gva, pfn_t *pfn, bool write, bool *writable)
 {
+	struct kvm_memory_slot *slot;
 	bool async;
 
-	*pfn = gfn_to_pfn_async(vcpu->kvm, gfn, &async, write, writable);
+	slot = kvm_vcpu_gfn_to_memslot(vcpu, gfn);
+	async = false;
+	*pfn = __gfn_to_pfn_memslot(slot, gfn, false, &async, write, writable);
 
 	if (!async)
 		return false; /* *pfn has correct page already */
@@ -3492,7 +3521,7 @@ static bool try_async_pf(struct kvm_vcpu *vcpu, bool prefault, gfn_t gfn,
 			return true;
 	}
 
-	*pfn = gfn_to_pfn_prot(vcpu->kvm, gfn, write, writable);
+	*pfn = __gfn_to_pfn_memslot(slot, gfn, false, NULL, write, writable);
 
 	return false;
 }
@@ -46,6 +46,7 @@
 #include <asm/debugreg.h>
 #include <asm/kexec.h>
 #include <asm/apic.h>
+#include <asm/irq_remapping.h>
 
 #include "trace.h"
 
@@ -443,11 +444,29 @@ struct nested_vmx {
 };
 
 #define POSTED_INTR_ON  0
+#define POSTED_INTR_SN  1
+
 /* Posted-Interrupt Descriptor */
 struct pi_desc {
 	u32 pir[8];     /* Posted interrupt requested */
-	u32 control;	/* bit 0 of control is outstanding notification bit */
-	u32 rsvd[7];
+	union {
+		struct {
+				/* bit 256 - Outstanding Notification */
+			u16	on	: 1,
+				/* bit 257 - Suppress Notification */
+				sn	: 1,
+				/* bit 271:258 - Reserved */
+				rsvd_1	: 14;
+				/* bit 279:272 - Notification Vector */
+			u8	nv;
+				/* bit 287:280 - Reserved */
+			u8	rsvd_2;
+				/* bit 319:288 - Notification Destination */
+			u32	ndst;
+		};
+		u64 control;
+	};
+	u32 rsvd[6];
 } __aligned(64);
 
 static bool pi_test_and_set_on(struct pi_desc *pi_desc)
@@ -467,6 +486,29 @@ static int pi_test_and_set_pir(int vector, struct pi_desc *pi_desc)
 	return test_and_set_bit(vector, (unsigned long *)pi_desc->pir);
 }
 
+static inline void pi_set_sn(struct pi_desc *pi_desc)
+{
+	set_bit(POSTED_INTR_SN, (unsigned long *)&pi_desc->control);
+}
+
+static inline int pi_test_on(struct pi_desc *pi_desc)
+{
+	return test_bit(POSTED_INTR_ON, (unsigned long *)&pi_desc->control);
+}
+
+static inline bool pi_is_pir_empty(struct pi_desc *pi_desc)
+{
+	return bitmap_empty((unsigned long *)pi_desc->pir, 256);
+}
+
+/* Notification destination for @cpu, in the format the APIC mode uses */
+static inline u32 pi_ndst(int cpu)
+{
+	u32 dest = cpu_physical_id(cpu);
+
+	return x2apic_enabled() ? dest : (dest << 8) & 0xFF00;
+}
+
 struct vcpu_vmx {
 	struct kvm_vcpu       vcpu;
 	unsigned long         host_rsp;
@@ -537,6 +579,13 @@ struct vcpu_vmx {
 	/* Posted interrupt descriptor */
 	struct pi_desc pi_desc;
 
+	/*
+	 * While blocked with device interrupts posted to pi_desc, the vcpu
+	 * sits on the wakeup list of pi_blocked_cpu, -1 otherwise.
+	 */
+	struct list_head pi_blocked_list;
+	int pi_blocked_cpu;
+
 	/* Support for a guest hypervisor (nested VMX) */
 	struct nested_vmx nested;
 
@@ -831,6 +880,14 @@ static DEFINE_PER_CPU(struct vmcs *, current_vmcs);
 static DEFINE_PER_CPU(struct list_head, loaded_vmcss_on_cpu);
 static DEFINE_PER_CPU(struct desc_ptr, host_gdt);
 
+/*
+ * Vcpus blocked on a CPU with device interrupts posted to them.  The
+ * IOMMU notifies that CPU with POSTED_INTR_WAKEUP_VECTOR, whose handler
+ * walks the list and kicks the vcpus that have interrupts pending.
+ */
+static DEFINE_PER_CPU(struct list_head, blocked_vcpu_on_cpu);
+static DEFINE_PER_CPU(spinlock_t, blocked_vcpu_on_cpu_lock);
+
 static unsigned long *vmx_io_bitmap_a;
 static unsigned long *vmx_io_bitmap_b;
 static unsigned long *vmx_msr_bitmap_legacy;
@@ -1895,6 +1952,59 @@ static void vmx_load_host_state(struct vcpu_vmx *vmx)
 	preempt_enable();
 }
 
+static bool vmx_can_post_device_intr(struct kvm *kvm)
+{
+	return enable_apicv && irqchip_in_kernel(kvm) &&
+	       irq_remapping_cap(IRQ_POSTING_CAP);
+}
+
+/*
+ * Point the notification destination of the posted-interrupt descriptor
+ * at the cpu the vcpu now runs on, so that the IOMMU can post device
+ * interrupts to it again.
+ */
+static void vmx_vcpu_pi_load(struct kvm_vcpu *vcpu, int cpu)
+{
+	struct vcpu_vmx *vmx = to_vmx(vcpu);
+	struct pi_desc *pi_desc = &vmx->pi_desc;
+	struct pi_desc old, new;
+
+	if (!vmx_can_post_device_intr(vcpu->kvm))
+		return;
+
+	/* Keep the wakeup vector aimed at the cpu whose list has the vcpu */
+	if (vmx->pi_blocked_cpu != -1)
+		return;
+
+	if (vcpu->cpu == cpu && !pi_desc->sn)
+		return;
+
+	do {
+		old.control = new.control = pi_desc->control;
+		new.ndst = pi_ndst(cpu);
+		new.sn = 0;
+	} while (cmpxchg(&pi_desc->control, old.control,
+			 new.control) != old.control);
+
+	/*
+	 * Interrupts posted while notifications were suppressed only set
+	 * PIR bits; raise ON so that the next entry picks them up.
+	 */
+	smp_mb__after_atomic();
+	if (!pi_is_pir_empty(pi_desc))
+		pi_test_and_set_on(pi_desc);
+}
+
+static void vmx_vcpu_pi_put(struct kvm_vcpu *vcpu)
+{
+	if (!vmx_can_post_device_intr(vcpu->kvm))
+		return;
+
+	/* Don't notify a cpu the preempted vcpu no longer runs on */
+	if (vcpu->preempted)
+		pi_set_sn(&to_vmx(vcpu)->pi_desc);
+}
+
 /*
  * Switches to specified vcpu, until a matching vcpu_put(), but assumes
  * vcpu mutex is already taken.
@@ -1945,10 +2055,14 @@ static void vmx_vcpu_load(struct kvm_vcpu *vcpu, int cpu)
 		vmcs_writel(HOST_IA32_SYSENTER_ESP, sysenter_esp); /* 22.2.3 */
 		vmx->loaded_vmcs->cpu = cpu;
 	}
+
+	vmx_vcpu_pi_load(vcpu, cpu);
 }
 
 static void vmx_vcpu_put(struct kvm_vcpu *vcpu)
 {
+	vmx_vcpu_pi_put(vcpu);
+
 	__vmx_load_host_state(to_vmx(vcpu));
 	if (!vmm_exclusive) {
 		__loaded_vmcs_clear(to_vmx(vcpu)->loaded_vmcs);
@@ -2882,6 +2996,8 @@ static int hardware_enable(void)
 		return -EBUSY;
 
 	INIT_LIST_HEAD(&per_cpu(loaded_vmcss_on_cpu, cpu));
+	INIT_LIST_HEAD(&per_cpu(blocked_vcpu_on_cpu, cpu));
+	spin_lock_init(&per_cpu(blocked_vcpu_on_cpu_lock, cpu));
 
 	/*
 	 * Now we can enable the vmclear operation in kdump
@@ -4773,8 +4889,11 @@ static void vmx_vcpu_reset(struct kvm_vcpu *vcpu)
 
 	kvm_make_request(KVM_REQ_APIC_PAGE_RELOAD, vcpu);
 
-	if (vmx_vm_has_apicv(vcpu->kvm))
+	if (vmx_vm_has_apicv(vcpu->kvm)) {
 		memset(&vmx->pi_desc, 0, sizeof(struct pi_desc));
+		vmx->pi_desc.nv = POSTED_INTR_VECTOR;
+		vmx->pi_desc.ndst = pi_ndst(vcpu->cpu);
+	}
 
 	if (vmx->vpid != 0)
 		vmcs_write16(VIRTUAL_PROCESSOR_ID, vmx->vpid);
@@ -8372,6 +8491,9 @@ static struct kvm_vcpu *vmx_create_vcpu(struct kvm *kvm, unsigned int id)
 
 	allocate_vpid(vmx);
 
+	INIT_LIST_HEAD(&vmx->pi_blocked_list);
+	vmx->pi_blocked_cpu = -1;
+
 	err = kvm_vcpu_init(&vmx->vcpu, kvm, id);
 	if (err)
 		goto free_vcpu;
@@ -10133,6 +10255,157 @@ static void vmx_enable_log_dirty_pt_masked(struct kvm *kvm,
 	kvm_mmu_clear_dirty_pt_masked(kvm, memslot, offset, mask);
 }
 
+static bool vmx_posts_device_intr(struct kvm *kvm)
+{
+	return vmx_can_post_device_intr(kvm) &&
+	       kvm_arch_has_assigned_device(kvm);
+}
+
+/*
+ * Before blocking, redirect device notifications for this vcpu to the
+ * wakeup vector on the current cpu and queue the vcpu on that cpu's
+ * wakeup list.  Returns 1 if an interrupt is already pending, in which
+ * case the vcpu must not block.
+ */
+static int vmx_pre_block(struct kvm_vcpu *vcpu)
+{
+	struct vcpu_vmx *vmx = to_vmx(vcpu);
+	struct pi_desc *pi_desc = &vmx->pi_desc;
+	struct pi_desc old, new;
+	unsigned long flags;
+	int cpu;
+
+	if (!vmx_posts_device_intr(vcpu->kvm))
+		return 0;
+
+	cpu = vmx->pi_blocked_cpu = vcpu->cpu;
+	spin_lock_irqsave(&per_cpu(blocked_vcpu_on_cpu_lock, cpu), flags);
+	list_add_tail(&vmx->pi_blocked_list,
+		      &per_cpu(blocked_vcpu_on_cpu, cpu));
+	spin_unlock_irqrestore(&per_cpu(blocked_vcpu_on_cpu_lock, cpu), flags);
+
+	do {
+		old.control = new.control = pi_desc->control;
+
+		if (pi_test_on(pi_desc)) {
+			spin_lock_irqsave(&per_cpu(blocked_vcpu_on_cpu_lock,
+						   cpu), flags);
+			list_del(&vmx->pi_blocked_list);
+			spin_unlock_irqrestore(&per_cpu(blocked_vcpu_on_cpu_lock,
+							cpu), flags);
+			vmx->pi_blocked_cpu = -1;
+			return 1;
+		}
+
+		WARN_ONCE(pi_desc->sn,
+			  "kvm: posted-interrupt notification suppressed before blocking\n");
+
+		/*
+		 * The vcpu may get preempted and migrate in the meantime, so
+		 * aim at the cpu whose list has it rather than vcpu->cpu.
+		 */
+		new.ndst = pi_ndst(cpu);
+		new.nv = POSTED_INTR_WAKEUP_VECTOR;
+	} while (cmpxchg(&pi_desc->control, old.control,
+			 new.control) != old.control);
+
+	return 0;
+}
+
+static void vmx_post_block(struct kvm_vcpu *vcpu)
+{
+	struct vcpu_vmx *vmx = to_vmx(vcpu);
+	struct pi_desc *pi_desc = &vmx->pi_desc;
+	struct pi_desc old, new;
+	unsigned long flags;
+	int cpu = vmx->pi_blocked_cpu;
+
+	if (cpu == -1)
+		return;
+
+	do {
+		old.control = new.control = pi_desc->control;
+		new.ndst = pi_ndst(vcpu->cpu);
+		new.sn = 0;
+		new.nv = POSTED_INTR_VECTOR;
+	} while (cmpxchg(&pi_desc->control, old.control,
+			 new.control) != old.control);
+
+	spin_lock_irqsave(&per_cpu(blocked_vcpu_on_cpu_lock, cpu), flags);
+	list_del(&vmx->pi_blocked_list);
+	spin_unlock_irqrestore(&per_cpu(blocked_vcpu_on_cpu_lock, cpu), flags);
+	vmx->pi_blocked_cpu = -1;
+}
+
+/* Handler for POSTED_INTR_WAKEUP_VECTOR */
+static void pi_wakeup_handler(void)
+{
+	struct vcpu_vmx *vmx;
+	int cpu = smp_processor_id();
+
+	spin_lock(&per_cpu(blocked_vcpu_on_cpu_lock, cpu));
+	list_for_each_entry(vmx, &per_cpu(blocked_vcpu_on_cpu, cpu),
+			    pi_blocked_list)
+		if (pi_test_on(&vmx->pi_desc))
+			kvm_vcpu_kick(&vmx->vcpu);
+	spin_unlock(&per_cpu(blocked_vcpu_on_cpu_lock, cpu));
+}
+
+/*
+ * vmx_update_pi_irte - post a host interrupt of an assigned device
+ *
+ * @kvm: kvm
+ * @host_irq: host irq of the interrupt
+ * @guest_irq: gsi the interrupt is routed to in the guest
+ * @set: post the interrupt if possible, or hand it back to the host
+ *
+ * The interrupt is delivered straight into the posted-interrupt
+ * descriptor if the gsi routes to an MSI with a single destination vcpu.
+ * Multicast and broadcast MSIs, and anything else, keep going through
+ * the host handler and regular injection.
+ */
+static int vmx_update_pi_irte(struct kvm *kvm, unsigned int host_irq,
+			      u32 guest_irq, bool set)
+{
+	struct kvm_kernel_irq_routing_entry entries[KVM_NR_IRQCHIPS];
+	struct kvm_vcpu *vcpu = NULL;
+	struct kvm_lapic_irq irq;
+	struct vcpu_data vcpu_info;
+	int i, n, idx, ret;
+
+	if (!vmx_can_post_device_intr(kvm))
+		return 0;
+
+	idx = srcu_read_lock(&kvm->irq_srcu);
+	n = set ? kvm_irq_map_gsi(kvm, entries, guest_irq) : 0;
+	for (i = 0; i < n; i++) {
+		if (entries[i].type != KVM_IRQ_ROUTING_MSI)
+			continue;
+
+		kvm_set_msi_irq(&entries[i], &irq);
+		if (irq.delivery_mode != APIC_DM_FIXED &&
+		    irq.delivery_mode != APIC_DM_LOWEST)
+			continue;
+		if (kvm_intr_is_single_vcpu(kvm, &irq, &vcpu))
+			break;
+		vcpu = NULL;
+	}
+
+	if (vcpu) {
+		vcpu_info.pi_desc_addr = __pa(&to_vmx(vcpu)->pi_desc);
+		vcpu_info.vector = irq.vector;
+		ret = irq_remapping_set_vcpu_affinity(host_irq, &vcpu_info);
+	} else
+		ret = irq_remapping_set_vcpu_affinity(host_irq, NULL);
+	srcu_read_unlock(&kvm->irq_srcu, idx);
+
+	if (ret < 0)
+		pr_info_ratelimited("kvm: failed to update PI IRTE for irq %u\n",
+				    host_irq);
+
+	return ret;
+}
+
 static struct kvm_x86_ops vmx_x86_ops = {
 	.cpu_has_kvm_support = cpu_has_kvm_support,
 	.disabled_by_bios = vmx_disabled_by_bios,
@@ -10246,6 +10519,10 @@ static struct kvm_x86_ops vmx_x86_ops = {
 	.slot_disable_log_dirty = vmx_slot_disable_log_dirty,
 	.flush_log_dirty = vmx_flush_log_dirty,
 	.enable_log_dirty_pt_masked = vmx_enable_log_dirty_pt_masked,
+
+	.pre_block = vmx_pre_block,
+	.post_block = vmx_post_block,
+	.update_pi_irte = vmx_update_pi_irte,
 };
 
 static int __init vmx_init(void)
@@ -10259,12 +10536,15 @@ static int __init vmx_init(void)
 	rcu_assign_pointer(crash_vmclear_loaded_vmcss,
 			   crash_vmclear_local_loaded_vmcss);
 #endif
+	kvm_set_posted_intr_wakeup_handler(pi_wakeup_handler);
 
 	return 0;
 }
 
 static void __exit vmx_exit(void)
 {
+	kvm_set_posted_intr_wakeup_handler(NULL);
+
 #ifdef CONFIG_KEXEC
 	RCU_INIT_POINTER(crash_vmclear_loaded_vmcss, NULL);
 	synchronize_rcu();
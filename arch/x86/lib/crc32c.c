@@ -0,0 +1,72 @@
+/*
+ * CRC32C with the SSE4.2 crc32 instruction, shared by lib/crc32.c so that
+ * library users do not have to go through the crypto API to get at it.
+ *
+ * The multi-buffer variant interleaves three independent streams: the
+ * instruction has a latency of three cycles but a throughput of one, so
+ * a single dependency chain leaves two thirds of the unit idle.
+ */
+#include <linux/export.h>
+#include <asm/crc32c.h>
+
+#define SCALE_F	sizeof(unsigned long)
+
+#ifdef CONFIG_X86_64
+#define REX_PRE "0x48, "
+#else
+#define REX_PRE
+#endif
+
+static inline u32 crc32c_x86_byte(u32 crc, unsigned char data)
+{
+	asm(".byte 0xf2, 0xf, 0x38, 0xf0, 0xf1"
+	    : "=S" (crc)
+	    : "0" (crc), "c" (data));
+	return crc;
+}
+
+static inline u32 crc32c_x86_word(u32 crc, unsigned long data)
+{
+	asm(".byte 0xf2, " REX_PRE "0xf, 0x38, 0xf1, 0xf1"
+	    : "=S" (crc)
+	    : "0" (crc), "c" (data));
+	return crc;
+}
+
+u32 __pure crc32c_le_arch(u32 crc, unsigned char const *p, size_t len)
+{
+	const unsigned long *ptmp = (const unsigned long *)p;
+	size_t iquotient = len / SCALE_F;
+	size_t iremainder = len % SCALE_F;
+
+	while (iquotient--)
+		crc = crc32c_x86_word(crc, *ptmp++);
+
+	p = (unsigned char const *)ptmp;
+	while (iremainder--)
+		crc = crc32c_x86_byte(crc, *p++);
+
+	return crc;
+}
+EXPORT_SYMBOL(crc32c_le_arch);
+
+void crc32c_le_arch_3way(u32 *crc, unsigned char const *const *p, size_t len)
+{
+	const unsigned long *p0 = (const unsigned long *)p[0];
+	const unsigned long *p1 = (const unsigned long *)p[1];
+	const unsigned long *p2 = (const unsigned long *)p[2];
+	u32 crc0 = crc[0], crc1 = crc[1], crc2 = crc[2];
+	size_t iquotient = len / SCALE_F;
+	size_t done = iquotient * SCALE_F;
+
+	while (iquotient--) {
+		crc0 = crc32c_x86_word(crc0, *p0++);
+		crc1 = crc32c_x86_word(crc1, *p1++);
+		crc2 = crc32c_x86_word(crc2, *p2++);
+	}
+
+	crc[0] = crc32c_le_arch(crc0, p[0] + done, len - done);
+	crc[1] = crc32c_le_arch(crc1, p[1] + done, len - done);
+	crc[2] = crc32c_le_arch(crc2, p[2] + done, len - done);
+}
+EXPORT_SYMBOL(crc32c_le_arch_3way);
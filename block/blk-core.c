@@ -39,6 +39,7 @@
 #include "blk.h"
 #include "blk-cgroup.h"
 #include "blk-mq.h"
+#include "blk-wbt.h"
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_bio_remap);
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_rq_remap);
@@ -366,7 +367,7 @@ static void __blk_drain_queue(struct request_queue *q, bool drain_all)
 		 * The caller might be trying to drain @q before its
 		 * elevator is initialized.
 		 */
-		if (q->elevator)
+		if (q->elevator && !q->mq_ops)
 			elv_drain_elevator(q);
 
 		blkcg_drain_queue(q);
@@ -1387,6 +1388,8 @@ void __blk_put_request(struct request_queue *q, struct request *req)
 
 	elv_completed_request(q, req);
 
+	wbt_done(q->rq_wb, req);
+
 	/* this is a bio leak */
 	WARN_ON(req->bio != NULL);
 
@@ -1581,6 +1584,7 @@ void blk_queue_bio(struct request_queue *q, struct bio *bio)
 	const bool sync = !!(bio->bi_rw & REQ_SYNC);
 	struct blk_plug *plug;
 	int el_ret, rw_flags, where = ELEVATOR_INSERT_SORT;
+	bool wb_acct;
 	struct request *req;
 	unsigned int request_count = 0;
 
@@ -1639,16 +1643,22 @@ get_rq:
 	if (sync)
 		rw_flags |= REQ_SYNC;
 
+	wb_acct = wbt_wait(q->rq_wb, bio, q->queue_lock);
+
 	/*
 	 * Grab a free request. This is might sleep but can not fail.
 	 * Returns with the queue unlocked.
 	 */
 	req = get_request(q, rw_flags, bio, GFP_NOIO);
 	if (IS_ERR(req)) {
+		if (wb_acct)
+			wbt_cancel(q->rq_wb);
 		bio_endio(bio, PTR_ERR(req));	/* @q is dead */
 		goto out_unlock;
 	}
 
+	wbt_track(req, wb_acct);
+
 	/*
 	 * After dropping the lock and possibly sleeping here, our request
 	 * may now be mergeable after it had proven unmergeable (above).
@@ -2385,6 +2395,8 @@ void blk_start_request(struct request *req)
 	if (unlikely(blk_bidi_rq(req)))
 		req->next_rq->resid_len = blk_rq_bytes(req->next_rq);
 
+	wbt_issue(req->q->rq_wb, req);
+
 	BUG_ON(test_bit(REQ_ATOM_COMPLETE, &req->atomic_flags));
 	blk_add_timer(req);
 }
@@ -0,0 +1,305 @@
+/*
+ * blk-mq scheduling framework
+ *
+ * Lets an elevator_type with ->uses_mq set sit between the submission
+ * path and the hardware queues: requests are handed to the scheduler
+ * instead of the per-cpu software queues and pulled back out one at a
+ * time when the hardware queue is run.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/rbtree.h>
+#include <linux/blktrace_api.h>
+
+#include <trace/events/block.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-sched.h"
+
+static void blk_mq_sched_exit_hctxs(struct request_queue *q,
+				    struct elevator_queue *e,
+				    unsigned int nr_hctx)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (i == nr_hctx)
+			break;
+		if (e->type->mq_ops.exit_hctx)
+			e->type->mq_ops.exit_hctx(hctx, i);
+		hctx->sched_data = NULL;
+	}
+}
+
+static int blk_mq_sched_init(struct request_queue *q, struct elevator_type *e)
+{
+	struct elevator_queue *eq;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+	int ret;
+
+	ret = e->mq_ops.init_sched(q, e);
+	if (ret)
+		return ret;
+
+	/* ->init_sched() set up q->elevator, it isn't visible to IO yet */
+	eq = q->elevator;
+	q->elevator = NULL;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!e->mq_ops.init_hctx)
+			break;
+		ret = e->mq_ops.init_hctx(eq, hctx, i);
+		if (ret) {
+			blk_mq_sched_exit_hctxs(q, eq, i);
+			elevator_exit(eq);
+			return ret;
+		}
+	}
+
+	rcu_assign_pointer(q->elevator, eq);
+	return 0;
+}
+
+/*
+ * Unhook the scheduler from a frozen queue. Runs of the hardware queues
+ * look at q->elevator under rcu_read_lock(), so wait for those to finish
+ * before tearing down the per-hctx state.
+ */
+static void blk_mq_sched_exit(struct request_queue *q)
+{
+	struct elevator_queue *e = q->elevator;
+
+	rcu_assign_pointer(q->elevator, NULL);
+	synchronize_rcu();
+
+	blk_mq_sched_exit_hctxs(q, e, q->nr_hw_queues);
+	elevator_exit(e);
+}
+
+/**
+ * blk_mq_sched_switch - switch the IO scheduler of a blk-mq queue
+ * @q:		the queue
+ * @new_e:	the new scheduler, or %NULL to run without one
+ *
+ * Description:
+ *	Called with q->sysfs_lock held. The queue is frozen around the
+ *	switch, so every request has completed and the old scheduler is
+ *	empty by the time it is torn down. If the new scheduler fails to
+ *	initialize, the queue is left without one.
+ **/
+int blk_mq_sched_switch(struct request_queue *q, struct elevator_type *new_e)
+{
+	bool registered = q->kobj.state_in_sysfs;
+	int ret = 0;
+
+	blk_mq_freeze_queue(q);
+
+	if (q->elevator) {
+		if (q->elevator->registered)
+			elv_unregister_queue(q);
+		blk_mq_sched_exit(q);
+	}
+
+	if (new_e) {
+		ret = blk_mq_sched_init(q, new_e);
+		if (!ret && registered) {
+			ret = elv_register_queue(q);
+			if (ret)
+				blk_mq_sched_exit(q);
+		}
+	}
+
+	blk_mq_unfreeze_queue(q);
+
+	blk_add_trace_msg(q, "elv switch: %s",
+			  new_e ? new_e->elevator_name : "none");
+	return ret;
+}
+
+/*
+ * Called when the hardware queues are about to be freed.
+ */
+void blk_mq_sched_teardown(struct request_queue *q)
+{
+	if (q->elevator)
+		blk_mq_sched_exit(q);
+}
+
+bool blk_mq_sched_bio_merge(struct blk_mq_hw_ctx *hctx, struct bio *bio)
+{
+	struct elevator_queue *e = hctx->queue->elevator;
+
+	if (e->type->mq_ops.bio_merge)
+		return e->type->mq_ops.bio_merge(hctx, bio);
+
+	return false;
+}
+
+/**
+ * blk_mq_sched_rb_merge - try to merge a bio into an rb-tree sorted request
+ * @q:			the queue
+ * @root:		tree of requests added with elv_rb_add()
+ * @bio:		the bio to merge
+ * @front_merges:	whether front merges should be attempted
+ * @merged:		set to the request @bio was merged into
+ *
+ * Description:
+ *	Helper for schedulers that keep their pending requests sector
+ *	sorted. The caller must hold the lock protecting @root. Returns
+ *	%ELEVATOR_BACK_MERGE or %ELEVATOR_FRONT_MERGE on success, in the
+ *	latter case the caller must reposition *@merged in its tree.
+ **/
+int blk_mq_sched_rb_merge(struct request_queue *q, struct rb_root *root,
+			  struct bio *bio, bool front_merges,
+			  struct request **merged)
+{
+	struct rb_node *n = root->rb_node;
+	struct request *rq, *prev = NULL;
+
+	/*
+	 * Find the last request starting before the bio, it's the
+	 * only candidate for a back merge.
+	 */
+	while (n) {
+		rq = rb_entry_rq(n);
+		if (blk_rq_pos(rq) < bio->bi_iter.bi_sector) {
+			prev = rq;
+			n = n->rb_right;
+		} else
+			n = n->rb_left;
+	}
+
+	if (prev && rq_end_sector(prev) == bio->bi_iter.bi_sector &&
+	    blk_rq_merge_ok(prev, bio) &&
+	    bio_attempt_back_merge(q, prev, bio)) {
+		*merged = prev;
+		return ELEVATOR_BACK_MERGE;
+	}
+
+	if (front_merges) {
+		rq = elv_rb_find(root, bio_end_sector(bio));
+		if (rq && blk_rq_merge_ok(rq, bio) &&
+		    bio_attempt_front_merge(q, rq, bio)) {
+			*merged = rq;
+			return ELEVATOR_FRONT_MERGE;
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+EXPORT_SYMBOL_GPL(blk_mq_sched_rb_merge);
+
+/*
+ * Flush sequences, passthrough commands and head insertions must not be
+ * reordered, they go straight to the hctx dispatch list.
+ */
+static bool blk_mq_sched_bypass_insert(struct request *rq)
+{
+	return (rq->cmd_flags & REQ_FLUSH_SEQ) || rq->cmd_type != REQ_TYPE_FS;
+}
+
+static void blk_mq_sched_insert_dispatch(struct blk_mq_hw_ctx *hctx,
+					 struct request *rq, bool at_head)
+{
+	spin_lock(&hctx->lock);
+	if (at_head)
+		list_add(&rq->queuelist, &hctx->dispatch);
+	else
+		list_add_tail(&rq->queuelist, &hctx->dispatch);
+	spin_unlock(&hctx->lock);
+}
+
+void blk_mq_sched_insert_request(struct request *rq, bool at_head,
+				 bool run_queue, bool async)
+{
+	struct request_queue *q = rq->q;
+	struct elevator_queue *e = q->elevator;
+	struct blk_mq_ctx *ctx = rq->mq_ctx, *current_ctx;
+	struct blk_mq_hw_ctx *hctx;
+
+	current_ctx = blk_mq_get_ctx(q);
+	if (!cpu_online(ctx->cpu))
+		rq->mq_ctx = ctx = current_ctx;
+
+	hctx = q->mq_ops->map_queue(q, ctx->cpu);
+
+	trace_block_rq_insert(q, rq);
+
+	if (at_head || blk_mq_sched_bypass_insert(rq)) {
+		blk_mq_sched_insert_dispatch(hctx, rq, at_head);
+	} else {
+		LIST_HEAD(list);
+
+		list_add(&rq->queuelist, &list);
+		e->type->mq_ops.insert_requests(hctx, &list);
+	}
+
+	if (run_queue)
+		blk_mq_run_hw_queue(hctx, async);
+
+	blk_mq_put_ctx(current_ctx);
+}
+
+void blk_mq_sched_insert_requests(struct blk_mq_hw_ctx *hctx,
+				  struct blk_mq_ctx *ctx,
+				  struct list_head *list)
+{
+	struct request_queue *q = hctx->queue;
+	struct elevator_queue *e = q->elevator;
+	struct request *rq, *next;
+
+	list_for_each_entry_safe(rq, next, list, queuelist) {
+		rq->mq_ctx = ctx;
+		trace_block_rq_insert(q, rq);
+
+		if (blk_mq_sched_bypass_insert(rq)) {
+			list_del_init(&rq->queuelist);
+			blk_mq_sched_insert_dispatch(hctx, rq, false);
+		}
+	}
+
+	if (!list_empty(list))
+		e->type->mq_ops.insert_requests(hctx, list);
+}
+
+/*
+ * Dispatch for a queue with a scheduler attached. Requests already on
+ * hctx->dispatch (left over after the driver was busy, or bypassing the
+ * scheduler) go first, then the scheduler is asked for one request at a
+ * time until it runs dry or the driver pushes back.
+ */
+void blk_mq_sched_dispatch_requests(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct elevator_queue *e;
+	struct request *rq;
+	LIST_HEAD(rq_list);
+
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		if (!list_empty(&hctx->dispatch))
+			list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	if (!list_empty(&rq_list) && !blk_mq_dispatch_rq_list(hctx, &rq_list))
+		return;
+
+	do {
+		rcu_read_lock();
+		e = rcu_dereference(q->elevator);
+		rq = e ? e->type->mq_ops.dispatch_request(hctx) : NULL;
+		rcu_read_unlock();
+
+		if (!rq)
+			break;
+
+		list_add(&rq->queuelist, &rq_list);
+	} while (blk_mq_dispatch_rq_list(hctx, &rq_list));
+}
@@ -0,0 +1,38 @@
+#ifndef BLK_MQ_SCHED_H
+#define BLK_MQ_SCHED_H
+
+#include <linux/elevator.h>
+#include <linux/rcupdate.h>
+
+#include "blk-mq.h"
+
+int blk_mq_sched_switch(struct request_queue *q, struct elevator_type *e);
+void blk_mq_sched_teardown(struct request_queue *q);
+
+bool blk_mq_sched_bio_merge(struct blk_mq_hw_ctx *hctx, struct bio *bio);
+int blk_mq_sched_rb_merge(struct request_queue *q, struct rb_root *root,
+			  struct bio *bio, bool front_merges,
+			  struct request **merged);
+
+void blk_mq_sched_insert_request(struct request *rq, bool at_head,
+				 bool run_queue, bool async);
+void blk_mq_sched_insert_requests(struct blk_mq_hw_ctx *hctx,
+				  struct blk_mq_ctx *ctx,
+				  struct list_head *list);
+void blk_mq_sched_dispatch_requests(struct blk_mq_hw_ctx *hctx);
+
+static inline bool blk_mq_sched_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct elevator_queue *e;
+	bool ret = false;
+
+	rcu_read_lock();
+	e = rcu_dereference(hctx->queue->elevator);
+	if (e)
+		ret = e->type->mq_ops.has_work(hctx);
+	rcu_read_unlock();
+
+	return ret;
+}
+
+#endif
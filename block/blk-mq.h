@@ -12,10 +12,8 @@ struct blk_mq_ctx {
 	unsigned int		cpu;
 	unsigned int		index_hw;
 
-	unsigned int		last_tag ____cacheline_aligned_in_smp;
-
 	/* incremented at dispatch time */
-	unsigned long		rq_dispatched[2];
+	unsigned long		rq_dispatched[2] ____cacheline_aligned_in_smp;
 	unsigned long		rq_merged;
 
 	/* incremented at completion time */
@@ -27,6 +25,8 @@ struct blk_mq_ctx {
 
 void __blk_mq_complete_request(struct request *rq);
 void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async);
+bool blk_mq_dispatch_rq_list(struct blk_mq_hw_ctx *hctx,
+			     struct list_head *rq_list);
 void blk_mq_freeze_queue(struct request_queue *q);
 void blk_mq_free_queue(struct request_queue *q);
 void blk_mq_clone_flush_request(struct request *flush_rq,
@@ -0,0 +1,250 @@
+/*
+ * Buffered writeback throttling, based on read completion latency
+ *
+ * A flush of a large dirty set fills the device queue with async writes,
+ * and the reads that arrive behind them stall. We watch the completion
+ * latency of reads over a short window: if the fastest read of a window
+ * still missed the target, the number of background writes allowed in
+ * flight is halved. Once reads make the target again, or there are no
+ * reads at all, the depth is stepped back up.
+ *
+ * Only async writes are throttled. Sync writes and O_DIRECT set REQ_SYNC
+ * and are left alone, as are reads.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/timekeeping.h>
+
+#include "blk.h"
+#include "blk-wbt.h"
+
+/* Read latency targets, used until changed through sysfs */
+#define WBT_DEF_LAT_NONROT	(2 * NSEC_PER_MSEC)
+#define WBT_DEF_LAT_ROT		(75 * NSEC_PER_MSEC)
+
+/* Length of the sampling window */
+#define WBT_WINDOW_NSEC		(100 * NSEC_PER_MSEC)
+
+static bool wbt_should_throttle(struct bio *bio)
+{
+	const unsigned long mask = REQ_WRITE | REQ_SYNC | REQ_DISCARD |
+				   REQ_FLUSH | REQ_FUA;
+
+	return (bio->bi_rw & mask) == REQ_WRITE;
+}
+
+static void wbt_calc_depth(struct rq_wb *rwb)
+{
+	rwb->wb_depth = max(1U, rwb->max_depth >> rwb->scale_step);
+}
+
+/*
+ * Background writeback gets half of the queue at most, the rest is left
+ * to reads and sync writes.
+ */
+void wbt_update_limits(struct rq_wb *rwb)
+{
+	if (!rwb)
+		return;
+
+	rwb->max_depth = max(1UL, rwb->queue->nr_requests / 2);
+	wbt_calc_depth(rwb);
+	wake_up_all(&rwb->wait);
+}
+
+void wbt_set_min_lat(struct rq_wb *rwb, u64 val)
+{
+	if (!rwb)
+		return;
+
+	rwb->min_lat_nsec = val;
+	rwb->scale_step = 0;
+	wbt_update_limits(rwb);
+}
+
+static bool atomic_inc_below(atomic_t *v, unsigned int below)
+{
+	unsigned int cur = atomic_read(v);
+
+	for (;;) {
+		unsigned int old;
+
+		if (cur >= below)
+			return false;
+		old = atomic_cmpxchg(v, cur, cur + 1);
+		if (old == cur)
+			break;
+		cur = old;
+	}
+
+	return true;
+}
+
+static void wbt_window_fn(unsigned long data)
+{
+	struct rq_wb *rwb = (struct rq_wb *) data;
+	unsigned int old_depth = rwb->wb_depth;
+	unsigned long flags;
+	unsigned int nr;
+	u64 min_lat;
+
+	spin_lock_irqsave(&rwb->stat_lock, flags);
+	nr = rwb->stat_nr;
+	min_lat = rwb->stat_min_lat;
+	rwb->stat_nr = 0;
+	rwb->stat_min_lat = 0;
+	spin_unlock_irqrestore(&rwb->stat_lock, flags);
+
+	if (!rwb->min_lat_nsec)
+		return;
+
+	if (nr && min_lat > rwb->min_lat_nsec) {
+		/* even the fastest read was too slow, back off */
+		if (rwb->wb_depth > 1)
+			rwb->scale_step++;
+	} else if (rwb->scale_step)
+		rwb->scale_step--;
+
+	wbt_calc_depth(rwb);
+	if (rwb->wb_depth > old_depth)
+		wake_up_all(&rwb->wait);
+
+	if (atomic_read(&rwb->inflight) || rwb->scale_step)
+		mod_timer(&rwb->window_timer,
+			  jiffies + nsecs_to_jiffies(rwb->win_nsec));
+}
+
+/**
+ * wbt_wait - throttle a bio before a request is allocated for it
+ * @rwb:	throttling state of the queue, may be %NULL
+ * @bio:	the bio about to be queued
+ * @lock:	spinlock held by the caller with irqs disabled, or %NULL
+ *
+ * Description:
+ *	Sleeps while the queue has as many writeback requests in flight as
+ *	currently allowed. @lock is dropped while sleeping. Returns true if
+ *	the bio was counted, the caller must then mark the request with
+ *	wbt_track(), or undo the count with wbt_cancel() if no request
+ *	could be allocated.
+ **/
+bool wbt_wait(struct rq_wb *rwb, struct bio *bio, spinlock_t *lock)
+{
+	DEFINE_WAIT(wait);
+	bool tracked = true;
+
+	if (!rwb || !rwb->min_lat_nsec || !wbt_should_throttle(bio))
+		return false;
+
+	if (atomic_inc_below(&rwb->inflight, rwb->wb_depth))
+		goto out;
+
+	for (;;) {
+		prepare_to_wait_exclusive(&rwb->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+
+		/* turned off while we were waiting */
+		if (!rwb->min_lat_nsec) {
+			tracked = false;
+			break;
+		}
+		if (atomic_inc_below(&rwb->inflight, rwb->wb_depth))
+			break;
+
+		if (lock)
+			spin_unlock_irq(lock);
+		io_schedule();
+		if (lock)
+			spin_lock_irq(lock);
+	}
+	finish_wait(&rwb->wait, &wait);
+
+out:
+	if (tracked && !timer_pending(&rwb->window_timer))
+		mod_timer(&rwb->window_timer,
+			  jiffies + nsecs_to_jiffies(rwb->win_nsec));
+	return tracked;
+}
+
+void wbt_cancel(struct rq_wb *rwb)
+{
+	unsigned int inflight = atomic_dec_return(&rwb->inflight);
+
+	if (inflight < rwb->wb_depth && waitqueue_active(&rwb->wait))
+		wake_up(&rwb->wait);
+}
+
+/*
+ * Called when the request is handed to the driver.
+ */
+void wbt_issue(struct rq_wb *rwb, struct request *rq)
+{
+	if (rwb && rq->cmd_type == REQ_TYPE_FS && !rq_data_dir(rq))
+		rq->wbt_issue_ns = ktime_get_ns();
+}
+
+/*
+ * Called when the request is freed. Writes release their slot, reads
+ * that were issued contribute their latency to the current window.
+ */
+void wbt_done(struct rq_wb *rwb, struct request *rq)
+{
+	if (!rwb)
+		return;
+
+	if (rq->cmd_flags & REQ_WBT) {
+		rq->cmd_flags &= ~REQ_WBT;
+		wbt_cancel(rwb);
+	} else if (rq->wbt_issue_ns) {
+		u64 lat = ktime_get_ns() - rq->wbt_issue_ns;
+		unsigned long flags;
+
+		spin_lock_irqsave(&rwb->stat_lock, flags);
+		if (!rwb->stat_nr || lat < rwb->stat_min_lat)
+			rwb->stat_min_lat = lat;
+		rwb->stat_nr++;
+		spin_unlock_irqrestore(&rwb->stat_lock, flags);
+	}
+
+	rq->wbt_issue_ns = 0;
+}
+
+void wbt_init(struct request_queue *q)
+{
+	struct rq_wb *rwb;
+
+	if (q->rq_wb || (!q->request_fn && !q->mq_ops))
+		return;
+
+	rwb = kzalloc_node(sizeof(*rwb), GFP_KERNEL, q->node);
+	if (!rwb)
+		return;
+
+	spin_lock_init(&rwb->stat_lock);
+	atomic_set(&rwb->inflight, 0);
+	init_waitqueue_head(&rwb->wait);
+	setup_timer(&rwb->window_timer, wbt_window_fn, (unsigned long) rwb);
+	rwb->win_nsec = WBT_WINDOW_NSEC;
+	rwb->queue = q;
+
+	if (blk_queue_nonrot(q))
+		rwb->min_lat_nsec = WBT_DEF_LAT_NONROT;
+	else
+		rwb->min_lat_nsec = WBT_DEF_LAT_ROT;
+
+	wbt_update_limits(rwb);
+	q->rq_wb = rwb;
+}
+
+void wbt_exit(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (rwb) {
+		del_timer_sync(&rwb->window_timer);
+		q->rq_wb = NULL;
+		kfree(rwb);
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef BLK_WBT_H
+#define BLK_WBT_H
+
+#include <linux/kernel.h>
+#include <linux/atomic.h>
+#include <linux/wait.h>
+#include <linux/timer.h>
+#include <linux/spinlock.h>
+#include <linux/blkdev.h>
+
+struct rq_wb {
+	/*
+	 * Allowed number of writeback requests in flight. Starts at
+	 * max_depth and is halved for each scale_step.
+	 */
+	unsigned int max_depth;
+	unsigned int wb_depth;
+	unsigned int scale_step;
+
+	u64 min_lat_nsec;			/* read latency target, 0 is off */
+	u64 win_nsec;				/* sampling window */
+	struct timer_list window_timer;
+
+	/* read completions seen in the current window */
+	spinlock_t stat_lock;
+	u64 stat_min_lat;
+	unsigned int stat_nr;
+
+	atomic_t inflight;
+	wait_queue_head_t wait;
+
+	struct request_queue *queue;
+};
+
+#ifdef CONFIG_BLK_WBT
+
+void wbt_init(struct request_queue *);
+void wbt_exit(struct request_queue *);
+void wbt_update_limits(struct rq_wb *);
+void wbt_set_min_lat(struct rq_wb *, u64);
+
+bool wbt_wait(struct rq_wb *, struct bio *, spinlock_t *);
+void wbt_cancel(struct rq_wb *);
+void wbt_issue(struct rq_wb *, struct request *);
+void wbt_done(struct rq_wb *, struct request *);
+
+static inline void wbt_track(struct request *rq, bool tracked)
+{
+	if (tracked)
+		rq->cmd_flags |= REQ_WBT;
+}
+
+#else
+
+static inline void wbt_init(struct request_queue *q)
+{
+}
+static inline void wbt_exit(struct request_queue *q)
+{
+}
+static inline void wbt_update_limits(struct rq_wb *rwb)
+{
+}
+static inline void wbt_set_min_lat(struct rq_wb *rwb, u64 val)
+{
+}
+static inline bool wbt_wait(struct rq_wb *rwb, struct bio *bio,
+			    spinlock_t *lock)
+{
+	return false;
+}
+static inline void wbt_cancel(struct rq_wb *rwb)
+{
+}
+static inline void wbt_issue(struct rq_wb *rwb, struct request *rq)
+{
+}
+static inline void wbt_done(struct rq_wb *rwb, struct request *rq)
+{
+}
+static inline void wbt_track(struct request *rq, bool tracked)
+{
+}
+
+#endif /* CONFIG_BLK_WBT */
+
+#endif
@@ -40,6 +40,7 @@
 
 #include "blk.h"
 #include "blk-cgroup.h"
+#include "blk-mq-sched.h"
 
 static DEFINE_SPINLOCK(elv_list_lock);
 static LIST_HEAD(elv_list);
@@ -228,6 +229,12 @@ int elevator_init(struct request_queue *q, char *name)
 		}
 	}
 
+	/* blk-mq schedulers attach through blk_mq_sched_switch() */
+	if (e->uses_mq) {
+		elevator_put(e);
+		return -EINVAL;
+	}
+
 	err = e->ops.elevator_init_fn(q, e);
 	if (err)
 		elevator_put(e);
@@ -238,7 +245,9 @@ EXPORT_SYMBOL(elevator_init);
 void elevator_exit(struct elevator_queue *e)
 {
 	mutex_lock(&e->sysfs_lock);
-	if (e->type->ops.elevator_exit_fn)
+	if (e->type->uses_mq && e->type->mq_ops.exit_sched)
+		e->type->mq_ops.exit_sched(e);
+	else if (!e->type->uses_mq && e->type->ops.elevator_exit_fn)
 		e->type->ops.elevator_exit_fn(e);
 	mutex_unlock(&e->sysfs_lock);
 
@@ -954,21 +963,41 @@ static int __elevator_change(struct request_queue *q, const char *name)
 	char elevator_name[ELV_NAME_MAX];
 	struct elevator_type *e;
 
-	if (!q->elevator)
+	if (!q->elevator && !q->mq_ops)
 		return -ENXIO;
 
 	strlcpy(elevator_name, name, sizeof(elevator_name));
-	e = elevator_get(strstrip(elevator_name), true);
+	strstrip(elevator_name);
+
+	/*
+	 * blk-mq queues can run without a scheduler.
+	 */
+	if (q->mq_ops && !strcmp(elevator_name, "none")) {
+		if (!q->elevator)
+			return 0;
+		return blk_mq_sched_switch(q, NULL);
+	}
+
+	e = elevator_get(elevator_name, true);
 	if (!e) {
 		printk(KERN_ERR "elevator: type %s not found\n", elevator_name);
 		return -EINVAL;
 	}
 
-	if (!strcmp(elevator_name, q->elevator->type->elevator_name)) {
+	if (q->elevator &&
+	    !strcmp(elevator_name, q->elevator->type->elevator_name)) {
 		elevator_put(e);
 		return 0;
 	}
 
+	if (e->uses_mq != !!q->mq_ops) {
+		elevator_put(e);
+		return -EINVAL;
+	}
+
+	if (q->mq_ops)
+		return blk_mq_sched_switch(q, e);
+
 	return elevator_switch(q, e);
 }
 
@@ -990,7 +1019,7 @@ ssize_t elv_iosched_store(struct request_queue *q, const char *name,
 {
 	int ret;
 
-	if (!q->elevator)
+	if (!q->elevator && !q->mq_ops)
 		return count;
 
 	ret = __elevator_change(q, name);
@@ -1004,24 +1033,30 @@ ssize_t elv_iosched_store(struct request_queue *q, const char *name,
 ssize_t elv_iosched_show(struct request_queue *q, char *name)
 {
 	struct elevator_queue *e = q->elevator;
-	struct elevator_type *elv;
+	struct elevator_type *elv = NULL;
 	struct elevator_type *__e;
 	int len = 0;
 
-	if (!q->elevator || !blk_queue_stackable(q))
+	if (!blk_queue_stackable(q) || (!q->elevator && !q->mq_ops))
 		return sprintf(name, "none\n");
 
-	elv = e->type;
+	if (e)
+		elv = e->type;
 
 	spin_lock(&elv_list_lock);
 	list_for_each_entry(__e, &elv_list, list) {
-		if (!strcmp(elv->elevator_name, __e->elevator_name))
+		if (__e->uses_mq != !!q->mq_ops)
+			continue;
+		if (elv && !strcmp(elv->elevator_name, __e->elevator_name))
 			len += sprintf(name+len, "[%s] ", elv->elevator_name);
 		else
 			len += sprintf(name+len, "%s ", __e->elevator_name);
 	}
 	spin_unlock(&elv_list_lock);
 
+	if (q->mq_ops)
+		len += sprintf(name+len, elv ? "none " : "[none] ");
+
 	len += sprintf(len+name, "\n");
 	return len;
 }
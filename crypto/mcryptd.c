@@ -118,7 +118,9 @@ static int mcryptd_enqueue_request(struct mcryptd_queue *queue,
 
 /*
  * Try to opportunisticlly flush the partially completed jobs if
- * crypto daemon is the only task running.
+ * crypto daemon is the only task running.  No more requests are
+ * coming in to fill the lanes, so there is nothing to gain from
+ * waiting for the flush interval.
  */
 static void mcryptd_opportunistic_flush(void)
 {
@@ -141,7 +143,7 @@ static void mcryptd_opportunistic_flush(void)
 		list_del(&cstate->flush_list);
 		cstate->flusher_engaged = false;
 		mutex_unlock(&flist->lock);
-		cstate->alg_state->flusher(cstate);
+		cstate->alg_state->flusher(cstate, true);
 	}
 }
 
@@ -212,7 +214,7 @@ void mcryptd_flusher(struct work_struct *__work)
 		list_del(&alg_cpu_state->flush_list);
 		alg_cpu_state->flusher_engaged = false;
 		mutex_unlock(&flist->lock);
-		alg_state->flusher(alg_cpu_state);
+		alg_state->flusher(alg_cpu_state, false);
 	}
 }
 EXPORT_SYMBOL_GPL(mcryptd_flusher);
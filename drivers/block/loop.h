@@ -52,6 +52,7 @@ struct loop_device {
 	void		*key_data; 
 
 	gfp_t		old_gfp_mask;
+	bool		use_dio;
 
 	spinlock_t		lo_lock;
 	struct list_head	write_cmd_head;
@@ -69,6 +70,8 @@ struct loop_cmd {
 	struct work_struct read_work;
 	struct request *rq;
 	struct list_head list;
+	bool use_aio;           /* use AIO interface to handle I/O */
+	struct kiocb iocb;
 };
 
 /* Support for loadable transfer modules */
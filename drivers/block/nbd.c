@@ -33,32 +33,52 @@
 #include <linux/net.h>
 #include <linux/kthread.h>
 #include <linux/types.h>
+#include <linux/blk-mq.h>
+#include <linux/workqueue.h>
 
 #include <asm/uaccess.h>
 #include <asm/types.h>
 
 #include <linux/nbd.h>
 
+struct nbd_sock {
+	struct socket *sock;
+	struct mutex tx_lock;
+	bool dead;
+	int index;
+	struct nbd_device *nbd;
+	struct work_struct recv_work;
+	struct work_struct timeout_work;
+};
+
+#define NBD_DISCONNECT_REQUESTED	1
+
 struct nbd_device {
-	int flags;
+	u32 flags;
+	unsigned long runtime_flags;
 	int harderror;		/* Code of hard error			*/
-	struct socket * sock;	/* If == NULL, device is not ready, yet	*/
+	struct nbd_sock **socks; /* one per connection			*/
+	int num_connections;
 	int magic;
 
-	spinlock_t queue_lock;
-	struct list_head queue_head;	/* Requests waiting result */
-	struct request *active_req;
-	wait_queue_head_t active_wq;
-	struct list_head waiting_queue;	/* Requests to be sent */
-	wait_queue_head_t waiting_wq;
+	struct blk_mq_tag_set tag_set;
 
-	struct mutex tx_lock;
+	struct mutex config_lock;
 	struct gendisk *disk;
 	int blksize;
 	loff_t bytesize;
 	pid_t pid; /* pid of nbd-client, if attached */
 	int xmit_timeout;
-	int disconnect; /* a disconnect has been requested by user */
+
+	atomic_t recv_threads;
+	wait_queue_head_t recv_wq;
+};
+
+struct nbd_cmd {
+	struct work_struct work;
+	struct nbd_device *nbd;
+	int hwq;	/* hardware queue the request was issued on */
+	int index;	/* connection it was sent on, -1 if not sent */
 };
 
 #define NBD_MAGIC 0x68797548
@@ -66,18 +86,9 @@ struct nbd_device {
 static unsigned int nbds_max = 16;
 static struct nbd_device *nbd_dev;
 static int max_part;
-
-/*
- * Use just one lock (or at most 1 per NIC). Two arguments for this:
- * 1. Each NIC is essentially a synchronization point for all servers
- *    accessed through that NIC so there's no need to have more locks
- *    than NICs anyway.
- * 2. More locks lead to more "Dirty cache line bouncing" which will slow
- *    down each lock to the point where they're actually slower than just
- *    a single lock.
- * Thanks go to Jens Axboe and Al Viro for their LKML emails explaining this!
- */
-static DEFINE_SPINLOCK(nbd_lock);
+static unsigned int nr_hw_queues;
+static struct workqueue_struct *nbd_wq;
+static struct workqueue_struct *recv_workqueue;
 
 static inline struct device *nbd_to_dev(struct nbd_device *nbd)
 {
@@ -96,70 +107,92 @@ static const char *nbdcmd_to_ascii(int cmd)
 	return "invalid";
 }
 
-static void nbd_end_request(struct nbd_device *nbd, struct request *req)
+static void nbd_end_request(struct nbd_cmd *cmd)
 {
-	int error = req->errors ? -EIO : 0;
-	struct request_queue *q = req->q;
-	unsigned long flags;
+	struct nbd_device *nbd = cmd->nbd;
+	struct request *req = blk_mq_rq_from_pdu(cmd);
 
 	dev_dbg(nbd_to_dev(nbd), "request %p: %s\n", req,
-		error ? "failed" : "done");
+		req->errors ? "failed" : "done");
+
+	blk_mq_complete_request(req);
+}
 
-	spin_lock_irqsave(q->queue_lock, flags);
-	__blk_end_request_all(req, error);
-	spin_unlock_irqrestore(q->queue_lock, flags);
+/*
+ * Forcibly shutdown a connection causing its receiver to error out.
+ * Must be called with nsock->tx_lock held.
+ */
+static void nbd_mark_nsock_dead(struct nbd_sock *nsock)
+{
+	if (!nsock->dead) {
+		dev_warn(nbd_to_dev(nsock->nbd), "shutting down socket %d\n",
+			 nsock->index);
+		kernel_sock_shutdown(nsock->sock, SHUT_RDWR);
+		nsock->dead = true;
+	}
 }
 
 /*
- * Forcibly shutdown the socket causing all listeners to error
+ * Forcibly shutdown all connections
  */
-static void sock_shutdown(struct nbd_device *nbd, int lock)
-{
-	if (lock)
-		mutex_lock(&nbd->tx_lock);
-	if (nbd->sock) {
-		dev_warn(disk_to_dev(nbd->disk), "shutting down socket\n");
-		kernel_sock_shutdown(nbd->sock, SHUT_RDWR);
-		nbd->sock = NULL;
+static void sock_shutdown(struct nbd_device *nbd)
+{
+	int i;
+
+	for (i = 0; i < nbd->num_connections; i++) {
+		struct nbd_sock *nsock = nbd->socks[i];
+
+		mutex_lock(&nsock->tx_lock);
+		nbd_mark_nsock_dead(nsock);
+		mutex_unlock(&nsock->tx_lock);
 	}
-	if (lock)
-		mutex_unlock(&nbd->tx_lock);
 }
 
-static void nbd_xmit_timeout(unsigned long arg)
+static void nbd_timeout_work(struct work_struct *work)
 {
-	struct task_struct *task = (struct task_struct *)arg;
+	struct nbd_sock *nsock = container_of(work, struct nbd_sock,
+					      timeout_work);
+
+	mutex_lock(&nsock->tx_lock);
+	nbd_mark_nsock_dead(nsock);
+	mutex_unlock(&nsock->tx_lock);
+}
 
-	printk(KERN_WARNING "nbd: killing hung xmit (%s, pid: %d)\n",
-		task->comm, task->pid);
-	force_sig(SIGKILL, task);
+/*
+ * A request that did not get a reply in time takes its connection down
+ * with it. The receiver for that connection then hands everything that
+ * was in flight on it back to the block layer, to be resent on another
+ * connection if one is left.
+ */
+static enum blk_eh_timer_return nbd_xmit_timeout(struct request *req,
+						 bool reserved)
+{
+	struct nbd_cmd *cmd = blk_mq_rq_to_pdu(req);
+	struct nbd_device *nbd = cmd->nbd;
+	int index = cmd->index;
+
+	if (!nbd->xmit_timeout || index < 0)
+		return BLK_EH_RESET_TIMER;
+
+	dev_err_ratelimited(nbd_to_dev(nbd),
+			    "Connection %d timed out, shutting it down\n",
+			    index);
+	queue_work(nbd_wq, &nbd->socks[index]->timeout_work);
+	return BLK_EH_RESET_TIMER;
 }
 
 /*
  *  Send or receive packet.
  */
-static int sock_xmit(struct nbd_device *nbd, int send, void *buf, int size,
-		int msg_flags)
+static int sock_xmit(struct nbd_device *nbd, int index, int send, void *buf,
+		int size, int msg_flags)
 {
-	struct socket *sock = nbd->sock;
+	struct socket *sock = nbd->socks[index]->sock;
 	int result;
 	struct msghdr msg;
 	struct kvec iov;
-	sigset_t blocked, oldset;
 	unsigned long pflags = current->flags;
 
-	if (unlikely(!sock)) {
-		dev_err(disk_to_dev(nbd->disk),
-			"Attempted %s on closed socket in sock_xmit\n",
-			(send ? "send" : "recv"));
-		return -EINVAL;
-	}
-
-	/* Allow interception of SIGKILL only
-	 * Don't allow other signals to interrupt the transmission */
-	siginitsetinv(&blocked, sigmask(SIGKILL));
-	sigprocmask(SIG_SETMASK, &blocked, &oldset);
-
 	current->flags |= PF_MEMALLOC;
 	do {
 		sock->sk->sk_allocation = GFP_NOIO | __GFP_MEMALLOC;
@@ -171,33 +204,12 @@ static int sock_xmit(struct nbd_device *nbd, int send, void *buf, int size,
 		msg.msg_controllen = 0;
 		msg.msg_flags = msg_flags | MSG_NOSIGNAL;
 
-		if (send) {
-			struct timer_list ti;
-
-			if (nbd->xmit_timeout) {
-				init_timer(&ti);
-				ti.function = nbd_xmit_timeout;
-				ti.data = (unsigned long)current;
-				ti.expires = jiffies + nbd->xmit_timeout;
-				add_timer(&ti);
-			}
+		if (send)
 			result = kernel_sendmsg(sock, &msg, &iov, 1, size);
-			if (nbd->xmit_timeout)
-				del_timer_sync(&ti);
-		} else
+		else
 			result = kernel_recvmsg(sock, &msg, &iov, 1, size,
 						msg.msg_flags);
 
-		if (signal_pending(current)) {
-			siginfo_t info;
-			printk(KERN_WARNING "nbd (pid %d: %s) got signal %d\n",
-				task_pid_nr(current), current->comm,
-				dequeue_signal_lock(current, &current->blocked, &info));
-			result = -EINTR;
-			sock_shutdown(nbd, !send);
-			break;
-		}
-
 		if (result <= 0) {
 			if (result == 0)
 				result = -EPIPE; /* short read */
@@ -207,52 +219,67 @@ static int sock_xmit(struct nbd_device *nbd, int send, void *buf, int size,
 		buf += result;
 	} while (size > 0);
 
-	sigprocmask(SIG_SETMASK, &oldset, NULL);
 	tsk_restore_flags(current, pflags, PF_MEMALLOC);
 
 	return result;
 }
 
-static inline int sock_send_bvec(struct nbd_device *nbd, struct bio_vec *bvec,
-		int flags)
+static inline int sock_send_bvec(struct nbd_device *nbd, int index,
+				 struct bio_vec *bvec, int flags)
 {
 	int result;
 	void *kaddr = kmap(bvec->bv_page);
-	result = sock_xmit(nbd, 1, kaddr + bvec->bv_offset,
+	result = sock_xmit(nbd, index, 1, kaddr + bvec->bv_offset,
 			   bvec->bv_len, flags);
 	kunmap(bvec->bv_page);
 	return result;
 }
 
-/* always call with the tx_lock held */
-static int nbd_send_req(struct nbd_device *nbd, struct request *req)
+static u32 nbd_req_type(struct request *req)
 {
+	if (req->cmd_flags & REQ_DISCARD)
+		return NBD_CMD_TRIM;
+	if (req->cmd_flags & REQ_FLUSH)
+		return NBD_CMD_FLUSH;
+	if (rq_data_dir(req) == WRITE)
+		return NBD_CMD_WRITE;
+	return NBD_CMD_READ;
+}
+
+/* always call with the tx_lock of connection @index held */
+static int nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd,
+			int index)
+{
+	struct request *req = blk_mq_rq_from_pdu(cmd);
 	int result, flags;
 	struct nbd_request request;
 	unsigned long size = blk_rq_bytes(req);
+	u32 type = nbd_req_type(req);
+	u32 tag = blk_mq_unique_tag(req);
 
 	memset(&request, 0, sizeof(request));
 	request.magic = htonl(NBD_REQUEST_MAGIC);
-	request.type = htonl(nbd_cmd(req));
+	request.type = htonl(type);
 
-	if (nbd_cmd(req) != NBD_CMD_FLUSH && nbd_cmd(req) != NBD_CMD_DISC) {
+	if (type != NBD_CMD_FLUSH) {
 		request.from = cpu_to_be64((u64)blk_rq_pos(req) << 9);
 		request.len = htonl(size);
 	}
-	memcpy(request.handle, &req, sizeof(req));
-
-	dev_dbg(nbd_to_dev(nbd), "request %p: sending control (%s@%llu,%uB)\n",
-		req, nbdcmd_to_ascii(nbd_cmd(req)),
-		(unsigned long long)blk_rq_pos(req) << 9, blk_rq_bytes(req));
-	result = sock_xmit(nbd, 1, &request, sizeof(request),
-			(nbd_cmd(req) == NBD_CMD_WRITE) ? MSG_MORE : 0);
+	memcpy(request.handle, &tag, sizeof(tag));
+
+	dev_dbg(nbd_to_dev(nbd), "request %p: sending control (%s@%llu,%uB) on %d\n",
+		req, nbdcmd_to_ascii(type),
+		(unsigned long long)blk_rq_pos(req) << 9, blk_rq_bytes(req),
+		index);
+	result = sock_xmit(nbd, index, 1, &request, sizeof(request),
+			(type == NBD_CMD_WRITE) ? MSG_MORE : 0);
 	if (result <= 0) {
-		dev_err(disk_to_dev(nbd->disk),
+		dev_err_ratelimited(disk_to_dev(nbd->disk),
 			"Send control failed (result %d)\n", result);
 		return -EIO;
 	}
 
-	if (nbd_cmd(req) == NBD_CMD_WRITE) {
+	if (type == NBD_CMD_WRITE) {
 		struct req_iterator iter;
 		struct bio_vec bvec;
 		/*
@@ -265,9 +292,9 @@ static int nbd_send_req(struct nbd_device *nbd, struct request *req)
 				flags = MSG_MORE;
 			dev_dbg(nbd_to_dev(nbd), "request %p: sending %d bytes data\n",
 				req, bvec.bv_len);
-			result = sock_send_bvec(nbd, &bvec, flags);
+			result = sock_send_bvec(nbd, index, &bvec, flags);
 			if (result <= 0) {
-				dev_err(disk_to_dev(nbd->disk),
+				dev_err_ratelimited(disk_to_dev(nbd->disk),
 					"Send data failed (result %d)\n",
 					result);
 				return -EIO;
@@ -277,101 +304,144 @@ static int nbd_send_req(struct nbd_device *nbd, struct request *req)
 	return 0;
 }
 
-static struct request *nbd_find_request(struct nbd_device *nbd,
-					struct request *xreq)
-{
-	struct request *req, *tmp;
-	int err;
-
-	err = wait_event_interruptible(nbd->active_wq, nbd->active_req != xreq);
-	if (unlikely(err))
-		return ERR_PTR(err);
-
-	spin_lock(&nbd->queue_lock);
-	list_for_each_entry_safe(req, tmp, &nbd->queue_head, queuelist) {
-		if (req != xreq)
-			continue;
-		list_del_init(&req->queuelist);
-		spin_unlock(&nbd->queue_lock);
-		return req;
-	}
-	spin_unlock(&nbd->queue_lock);
-
-	return ERR_PTR(-ENOENT);
-}
-
-static inline int sock_recv_bvec(struct nbd_device *nbd, struct bio_vec *bvec)
+static inline int sock_recv_bvec(struct nbd_device *nbd, int index,
+				 struct bio_vec *bvec)
 {
 	int result;
 	void *kaddr = kmap(bvec->bv_page);
-	result = sock_xmit(nbd, 0, kaddr + bvec->bv_offset, bvec->bv_len,
-			MSG_WAITALL);
+	result = sock_xmit(nbd, index, 0, kaddr + bvec->bv_offset,
+			   bvec->bv_len, MSG_WAITALL);
 	kunmap(bvec->bv_page);
 	return result;
 }
 
-/* NULL returned = something went wrong, inform userspace */
-static struct request *nbd_read_stat(struct nbd_device *nbd)
+/* ERR_PTR returned = connection is unusable, stop receiving on it */
+static struct nbd_cmd *nbd_read_stat(struct nbd_device *nbd, int index)
 {
 	int result;
 	struct nbd_reply reply;
-	struct request *req;
+	struct nbd_cmd *cmd;
+	struct request *req = NULL;
+	u16 hwq;
+	u32 tag;
 
 	reply.magic = 0;
-	result = sock_xmit(nbd, 0, &reply, sizeof(reply), MSG_WAITALL);
+	result = sock_xmit(nbd, index, 0, &reply, sizeof(reply), MSG_WAITALL);
 	if (result <= 0) {
-		dev_err(disk_to_dev(nbd->disk),
-			"Receive control failed (result %d)\n", result);
-		goto harderror;
+		if (!test_bit(NBD_DISCONNECT_REQUESTED, &nbd->runtime_flags))
+			dev_err(disk_to_dev(nbd->disk),
+				"Receive control failed (result %d)\n",
+				result);
+		return ERR_PTR(result);
 	}
 
 	if (ntohl(reply.magic) != NBD_REPLY_MAGIC) {
 		dev_err(disk_to_dev(nbd->disk), "Wrong magic (0x%lx)\n",
 				(unsigned long)ntohl(reply.magic));
-		result = -EPROTO;
-		goto harderror;
+		return ERR_PTR(-EPROTO);
 	}
 
-	req = nbd_find_request(nbd, *(struct request **)reply.handle);
-	if (IS_ERR(req)) {
-		result = PTR_ERR(req);
-		if (result != -ENOENT)
-			goto harderror;
-
-		dev_err(disk_to_dev(nbd->disk), "Unexpected reply (%p)\n",
-			reply.handle);
-		result = -EBADR;
-		goto harderror;
+	memcpy(&tag, reply.handle, sizeof(tag));
+	hwq = blk_mq_unique_tag_to_hwq(tag);
+	if (hwq < nbd->tag_set.nr_hw_queues)
+		req = blk_mq_tag_to_rq(nbd->tag_set.tags[hwq],
+				       blk_mq_unique_tag_to_tag(tag));
+	if (!req || !blk_mq_request_started(req)) {
+		dev_err(disk_to_dev(nbd->disk), "Unexpected reply (%u) %p\n",
+			tag, req);
+		return ERR_PTR(-ENOENT);
 	}
+	cmd = blk_mq_rq_to_pdu(req);
 
 	if (ntohl(reply.error)) {
 		dev_err(disk_to_dev(nbd->disk), "Other side returned error (%d)\n",
 			ntohl(reply.error));
-		req->errors++;
-		return req;
+		req->errors = -EIO;
+		return cmd;
 	}
 
 	dev_dbg(nbd_to_dev(nbd), "request %p: got reply\n", req);
-	if (nbd_cmd(req) == NBD_CMD_READ) {
+	if (rq_data_dir(req) == READ) {
 		struct req_iterator iter;
 		struct bio_vec bvec;
 
 		rq_for_each_segment(bvec, req, iter) {
-			result = sock_recv_bvec(nbd, &bvec);
+			result = sock_recv_bvec(nbd, index, &bvec);
 			if (result <= 0) {
 				dev_err(disk_to_dev(nbd->disk), "Receive data failed (result %d)\n",
 					result);
-				req->errors++;
-				return req;
+				/* the stream is out of sync now, drop it */
+				req->errors = -EIO;
+				nbd_end_request(cmd);
+				return ERR_PTR(result);
 			}
 			dev_dbg(nbd_to_dev(nbd), "request %p: got %d bytes data\n",
 				req, bvec.bv_len);
 		}
 	}
-	return req;
-harderror:
-	nbd->harderror = result;
-	return NULL;
+	return cmd;
+}
+
+static void nbd_requeue_cmd(struct blk_mq_hw_ctx *hctx, struct request *req,
+			    void *data, bool reserved)
+{
+	struct nbd_cmd *cmd = blk_mq_rq_to_pdu(req);
+	int index = *(int *)data;
+
+	if (cmd->index != index)
+		return;
+	cmd->index = -1;
+	blk_mq_requeue_request(req);
+}
+
+/*
+ * Give everything that was sent on a dead connection back to the block
+ * layer. nbd_send_work() will pick another connection, or fail the
+ * request when none is left.
+ */
+static void nbd_requeue_dead(struct nbd_device *nbd, int index)
+{
+	struct request_queue *q = nbd->disk->queue;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		blk_mq_tag_busy_iter(hctx, nbd_requeue_cmd, &index);
+	blk_mq_kick_requeue_list(q);
+}
+
+static void recv_work(struct work_struct *work)
+{
+	struct nbd_sock *nsock = container_of(work, struct nbd_sock,
+					      recv_work);
+	struct nbd_device *nbd = nsock->nbd;
+	struct nbd_cmd *cmd;
+
+	BUG_ON(nbd->magic != NBD_MAGIC);
+
+	while (1) {
+		cmd = nbd_read_stat(nbd, nsock->index);
+		if (IS_ERR(cmd)) {
+			nbd->harderror = PTR_ERR(cmd);
+			break;
+		}
+		nbd_end_request(cmd);
+	}
+
+	mutex_lock(&nsock->tx_lock);
+	nbd_mark_nsock_dead(nsock);
+	mutex_unlock(&nsock->tx_lock);
+	nbd_requeue_dead(nbd, nsock->index);
+
+	atomic_dec(&nbd->recv_threads);
+	wake_up(&nbd->recv_wq);
+}
+
+static void nbd_start_recv(struct nbd_device *nbd, struct nbd_sock *nsock)
+{
+	sk_set_memalloc(nsock->sock->sk);
+	atomic_inc(&nbd->recv_threads);
+	queue_work(recv_workqueue, &nsock->recv_work);
 }
 
 static ssize_t pid_show(struct device *dev,
@@ -388,14 +458,13 @@ static struct device_attribute pid_attr = {
 	.show = pid_show,
 };
 
+/* Called with config_lock held, drops it while the device is running */
 static int nbd_do_it(struct nbd_device *nbd)
 {
-	struct request *req;
-	int ret;
+	int i, ret;
 
 	BUG_ON(nbd->magic != NBD_MAGIC);
 
-	sk_set_memalloc(nbd->sock->sk);
 	nbd->pid = task_pid_nr(current);
 	ret = device_create_file(disk_to_dev(nbd->disk), &pid_attr);
 	if (ret) {
@@ -404,234 +473,313 @@ static int nbd_do_it(struct nbd_device *nbd)
 		return ret;
 	}
 
-	while ((req = nbd_read_stat(nbd)) != NULL)
-		nbd_end_request(nbd, req);
+	for (i = 0; i < nbd->num_connections; i++)
+		nbd_start_recv(nbd, nbd->socks[i]);
+
+	/*
+	 * A signal to nbd-client tears the whole device down. A
+	 * reconnect may start a new receiver while we wait for the
+	 * config_lock, so check again once we hold it.
+	 */
+	do {
+		mutex_unlock(&nbd->config_lock);
+		ret = wait_event_interruptible(nbd->recv_wq,
+				atomic_read(&nbd->recv_threads) == 0);
+		if (ret)
+			sock_shutdown(nbd);
+		wait_event(nbd->recv_wq, atomic_read(&nbd->recv_threads) == 0);
+		mutex_lock(&nbd->config_lock);
+	} while (atomic_read(&nbd->recv_threads));
 
 	device_remove_file(disk_to_dev(nbd->disk), &pid_attr);
 	nbd->pid = 0;
 	return 0;
 }
 
+static void nbd_clear_req(struct blk_mq_hw_ctx *hctx, struct request *req,
+			  void *data, bool reserved)
+{
+	struct nbd_cmd *cmd = blk_mq_rq_to_pdu(req);
+
+	if (!blk_mq_request_started(req) || cmd->index < 0)
+		return;
+	cmd->index = -1;
+	req->errors = -EIO;
+	nbd_end_request(cmd);
+}
+
 static void nbd_clear_que(struct nbd_device *nbd)
 {
-	struct request *req;
+	struct request_queue *q = nbd->disk->queue;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
 
 	BUG_ON(nbd->magic != NBD_MAGIC);
 
 	/*
-	 * Because we have set nbd->sock to NULL under the tx_lock, all
-	 * modifications to the list must have completed by now.  For
-	 * the same reason, the active_req must be NULL.
-	 *
-	 * As a consequence, we don't need to take the spin lock while
-	 * purging the list here.
+	 * All connections are dead by now, so nothing can be sent and
+	 * no reply can arrive. Requests that are not yet sent fail in
+	 * nbd_send_work(); fail the ones still waiting for a reply.
 	 */
-	BUG_ON(nbd->sock);
-	BUG_ON(nbd->active_req);
-
-	while (!list_empty(&nbd->queue_head)) {
-		req = list_entry(nbd->queue_head.next, struct request,
-				 queuelist);
-		list_del_init(&req->queuelist);
-		req->errors++;
-		nbd_end_request(nbd, req);
-	}
+	queue_for_each_hw_ctx(q, hctx, i)
+		blk_mq_tag_busy_iter(hctx, nbd_clear_req, NULL);
+}
+
+static void nbd_free_socks(struct nbd_device *nbd)
+{
+	int i;
+
+	if (!nbd->num_connections)
+		return;
+
+	/* make sure no send work still looks at the connections */
+	blk_mq_freeze_queue(nbd->disk->queue);
+	for (i = 0; i < nbd->num_connections; i++) {
+		struct nbd_sock *nsock = nbd->socks[i];
 
-	while (!list_empty(&nbd->waiting_queue)) {
-		req = list_entry(nbd->waiting_queue.next, struct request,
-				 queuelist);
-		list_del_init(&req->queuelist);
-		req->errors++;
-		nbd_end_request(nbd, req);
+		cancel_work_sync(&nsock->timeout_work);
+		sockfd_put(nsock->sock);
+		kfree(nsock);
 	}
+	kfree(nbd->socks);
+	nbd->socks = NULL;
+	nbd->num_connections = 0;
+	blk_mq_unfreeze_queue(nbd->disk->queue);
 }
 
-
-static void nbd_handle_req(struct nbd_device *nbd, struct request *req)
+static int nbd_handle_cmd(struct nbd_cmd *cmd)
 {
+	struct request *req = blk_mq_rq_from_pdu(cmd);
+	struct nbd_device *nbd = cmd->nbd;
+	int i;
+
 	if (req->cmd_type != REQ_TYPE_FS)
-		goto error_out;
+		return -EIO;
 
-	nbd_cmd(req) = NBD_CMD_READ;
 	if (rq_data_dir(req) == WRITE) {
-		if ((req->cmd_flags & REQ_DISCARD)) {
-			WARN_ON(!(nbd->flags & NBD_FLAG_SEND_TRIM));
-			nbd_cmd(req) = NBD_CMD_TRIM;
-		} else
-			nbd_cmd(req) = NBD_CMD_WRITE;
+		WARN_ON((req->cmd_flags & REQ_DISCARD) &&
+			!(nbd->flags & NBD_FLAG_SEND_TRIM));
 		if (nbd->flags & NBD_FLAG_READ_ONLY) {
-			dev_err(disk_to_dev(nbd->disk),
-				"Write on read-only\n");
-			goto error_out;
+			dev_err_ratelimited(disk_to_dev(nbd->disk),
+					    "Write on read-only\n");
+			return -EIO;
 		}
 	}
 
-	if (req->cmd_flags & REQ_FLUSH) {
-		BUG_ON(unlikely(blk_rq_sectors(req)));
-		nbd_cmd(req) = NBD_CMD_FLUSH;
-	}
-
-	req->errors = 0;
+	/*
+	 * Each hardware queue has its own connection. If that one is
+	 * gone, fall back to the next one that is still alive.
+	 */
+	for (i = 0; i < nbd->num_connections; i++) {
+		int index = (cmd->hwq + i) % nbd->num_connections;
+		struct nbd_sock *nsock = nbd->socks[index];
 
-	mutex_lock(&nbd->tx_lock);
-	if (unlikely(!nbd->sock)) {
-		mutex_unlock(&nbd->tx_lock);
-		dev_err(disk_to_dev(nbd->disk),
-			"Attempted send on closed socket\n");
-		goto error_out;
-	}
+		mutex_lock(&nsock->tx_lock);
+		if (nsock->dead) {
+			mutex_unlock(&nsock->tx_lock);
+			continue;
+		}
 
-	nbd->active_req = req;
+		if (nbd_send_cmd(nbd, cmd, index) == 0) {
+			cmd->index = index;
+			mutex_unlock(&nsock->tx_lock);
+			return 0;
+		}
 
-	if (nbd_send_req(nbd, req) != 0) {
-		dev_err(disk_to_dev(nbd->disk), "Request send failed\n");
-		req->errors++;
-		nbd_end_request(nbd, req);
-	} else {
-		spin_lock(&nbd->queue_lock);
-		list_add_tail(&req->queuelist, &nbd->queue_head);
-		spin_unlock(&nbd->queue_lock);
+		dev_err_ratelimited(disk_to_dev(nbd->disk),
+				    "Request send failed on connection %d\n",
+				    index);
+		nbd_mark_nsock_dead(nsock);
+		mutex_unlock(&nsock->tx_lock);
 	}
 
-	nbd->active_req = NULL;
-	mutex_unlock(&nbd->tx_lock);
-	wake_up_all(&nbd->active_wq);
+	dev_err_ratelimited(disk_to_dev(nbd->disk),
+			    "Attempted send on closed socket\n");
+	return -EIO;
+}
 
-	return;
+static void nbd_send_work(struct work_struct *work)
+{
+	struct nbd_cmd *cmd = container_of(work, struct nbd_cmd, work);
+	struct request *req = blk_mq_rq_from_pdu(cmd);
 
-error_out:
-	req->errors++;
-	nbd_end_request(nbd, req);
+	if (nbd_handle_cmd(cmd)) {
+		req->errors = -EIO;
+		nbd_end_request(cmd);
+	}
 }
 
-static int nbd_thread(void *data)
+static int nbd_queue_rq(struct blk_mq_hw_ctx *hctx,
+			const struct blk_mq_queue_data *bd)
 {
-	struct nbd_device *nbd = data;
-	struct request *req;
+	struct nbd_cmd *cmd = blk_mq_rq_to_pdu(bd->rq);
 
-	set_user_nice(current, MIN_NICE);
-	while (!kthread_should_stop() || !list_empty(&nbd->waiting_queue)) {
-		/* wait for something to do */
-		wait_event_interruptible(nbd->waiting_wq,
-					 kthread_should_stop() ||
-					 !list_empty(&nbd->waiting_queue));
+	cmd->hwq = hctx->queue_num;
+	cmd->index = -1;
+	bd->rq->errors = 0;
 
-		/* extract request */
-		if (list_empty(&nbd->waiting_queue))
-			continue;
+	dev_dbg(nbd_to_dev(cmd->nbd), "request %p: dequeued (flags=%x)\n",
+		bd->rq, bd->rq->cmd_type);
 
-		spin_lock_irq(&nbd->queue_lock);
-		req = list_entry(nbd->waiting_queue.next, struct request,
-				 queuelist);
-		list_del_init(&req->queuelist);
-		spin_unlock_irq(&nbd->queue_lock);
+	blk_mq_start_request(bd->rq);
+	queue_work(nbd_wq, &cmd->work);
+
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static int nbd_init_request(void *data, struct request *rq,
+			    unsigned int hctx_idx, unsigned int request_idx,
+			    unsigned int numa_node)
+{
+	struct nbd_cmd *cmd = blk_mq_rq_to_pdu(rq);
+
+	cmd->nbd = data;
+	cmd->index = -1;
+	INIT_WORK(&cmd->work, nbd_send_work);
 
-		/* handle request */
-		nbd_handle_req(nbd, req);
-	}
 	return 0;
 }
 
-/*
- * We always wait for result of write, for now. It would be nice to make it optional
- * in future
- * if ((rq_data_dir(req) == WRITE) && (nbd->flags & NBD_WRITE_NOCHK))
- *   { printk( "Warning: Ignoring result!\n"); nbd_end_request( req ); }
- */
+static struct blk_mq_ops nbd_mq_ops = {
+	.queue_rq	= nbd_queue_rq,
+	.map_queue	= blk_mq_map_queue,
+	.init_request	= nbd_init_request,
+	.timeout	= nbd_xmit_timeout,
+};
 
-static void do_nbd_request(struct request_queue *q)
-		__releases(q->queue_lock) __acquires(q->queue_lock)
+static void send_disconnects(struct nbd_device *nbd)
 {
-	struct request *req;
-	
-	while ((req = blk_fetch_request(q)) != NULL) {
-		struct nbd_device *nbd;
+	struct nbd_request request = {};
+	int i, ret;
 
-		spin_unlock_irq(q->queue_lock);
+	request.magic = htonl(NBD_REQUEST_MAGIC);
+	request.type = htonl(NBD_CMD_DISC);
 
-		nbd = req->rq_disk->private_data;
+	for (i = 0; i < nbd->num_connections; i++) {
+		struct nbd_sock *nsock = nbd->socks[i];
+
+		mutex_lock(&nsock->tx_lock);
+		if (!nsock->dead) {
+			ret = sock_xmit(nbd, i, 1, &request, sizeof(request), 0);
+			if (ret <= 0)
+				dev_err(disk_to_dev(nbd->disk),
+					"Send disconnect failed %d\n", ret);
+		}
+		mutex_unlock(&nsock->tx_lock);
+	}
+}
 
-		BUG_ON(nbd->magic != NBD_MAGIC);
+/*
+ * Before NBD_DO_IT every NBD_SET_SOCK adds a connection. Once the
+ * device is running, NBD_SET_SOCK replaces a connection that died.
+ */
+static int nbd_add_socket(struct nbd_device *nbd, struct block_device *bdev,
+			  unsigned long arg)
+{
+	struct nbd_sock **socks;
+	struct nbd_sock *nsock;
+	struct socket *sock;
+	int i, err;
 
-		dev_dbg(nbd_to_dev(nbd), "request %p: dequeued (flags=%x)\n",
-			req, req->cmd_type);
+	sock = sockfd_lookup(arg, &err);
+	if (!sock)
+		return -EINVAL;
 
-		if (unlikely(!nbd->sock)) {
-			dev_err(disk_to_dev(nbd->disk),
-				"Attempted send on closed socket\n");
-			req->errors++;
-			nbd_end_request(nbd, req);
-			spin_lock_irq(q->queue_lock);
-			continue;
+	if (nbd->pid) {
+		for (i = 0; i < nbd->num_connections; i++) {
+			struct socket *old;
+
+			nsock = nbd->socks[i];
+			if (!nsock->dead)
+				continue;
+			/* the old receiver exits as soon as it sees the error */
+			flush_work(&nsock->recv_work);
+
+			mutex_lock(&nsock->tx_lock);
+			old = nsock->sock;
+			nsock->sock = sock;
+			nsock->dead = false;
+			mutex_unlock(&nsock->tx_lock);
+			sockfd_put(old);
+
+			nbd_start_recv(nbd, nsock);
+			dev_info(disk_to_dev(nbd->disk),
+				 "reconnected socket %d\n", i);
+			return 0;
 		}
+		sockfd_put(sock);
+		return -EBUSY;
+	}
 
-		spin_lock_irq(&nbd->queue_lock);
-		list_add_tail(&req->queuelist, &nbd->waiting_queue);
-		spin_unlock_irq(&nbd->queue_lock);
-
-		wake_up(&nbd->waiting_wq);
+	nsock = kzalloc(sizeof(*nsock), GFP_KERNEL);
+	if (!nsock) {
+		sockfd_put(sock);
+		return -ENOMEM;
+	}
 
-		spin_lock_irq(q->queue_lock);
+	blk_mq_freeze_queue(nbd->disk->queue);
+	socks = krealloc(nbd->socks, (nbd->num_connections + 1) *
+			 sizeof(struct nbd_sock *), GFP_KERNEL);
+	if (!socks) {
+		blk_mq_unfreeze_queue(nbd->disk->queue);
+		kfree(nsock);
+		sockfd_put(sock);
+		return -ENOMEM;
 	}
+	nbd->socks = socks;
+
+	mutex_init(&nsock->tx_lock);
+	nsock->sock = sock;
+	nsock->nbd = nbd;
+	nsock->index = nbd->num_connections;
+	INIT_WORK(&nsock->recv_work, recv_work);
+	INIT_WORK(&nsock->timeout_work, nbd_timeout_work);
+	socks[nbd->num_connections++] = nsock;
+	blk_mq_unfreeze_queue(nbd->disk->queue);
+
+	if (max_part > 0)
+		bdev->bd_invalidated = 1;
+	/* we're connected now */
+	clear_bit(NBD_DISCONNECT_REQUESTED, &nbd->runtime_flags);
+	return 0;
 }
 
-/* Must be called with tx_lock held */
+/* Must be called with config_lock held */
 
 static int __nbd_ioctl(struct block_device *bdev, struct nbd_device *nbd,
 		       unsigned int cmd, unsigned long arg)
 {
 	switch (cmd) {
 	case NBD_DISCONNECT: {
-		struct request sreq;
-
 		dev_info(disk_to_dev(nbd->disk), "NBD_DISCONNECT\n");
-		if (!nbd->sock)
+		if (!nbd->num_connections)
 			return -EINVAL;
 
-		mutex_unlock(&nbd->tx_lock);
+		mutex_unlock(&nbd->config_lock);
 		fsync_bdev(bdev);
-		mutex_lock(&nbd->tx_lock);
-		blk_rq_init(NULL, &sreq);
-		sreq.cmd_type = REQ_TYPE_SPECIAL;
-		nbd_cmd(&sreq) = NBD_CMD_DISC;
+		mutex_lock(&nbd->config_lock);
 
 		/* Check again after getting mutex back.  */
-		if (!nbd->sock)
+		if (!nbd->num_connections)
 			return -EINVAL;
 
-		nbd->disconnect = 1;
-
-		nbd_send_req(nbd, &sreq);
+		set_bit(NBD_DISCONNECT_REQUESTED, &nbd->runtime_flags);
+		send_disconnects(nbd);
 		return 0;
 	}
  
-	case NBD_CLEAR_SOCK: {
-		struct socket *sock = nbd->sock;
-		nbd->sock = NULL;
+	case NBD_CLEAR_SOCK:
+		sock_shutdown(nbd);
+		/* a running NBD_DO_IT cleans up on its way out */
+		if (nbd->pid)
+			return 0;
 		nbd_clear_que(nbd);
-		BUG_ON(!list_empty(&nbd->queue_head));
-		BUG_ON(!list_empty(&nbd->waiting_queue));
 		kill_bdev(bdev);
-		if (sock)
-			sockfd_put(sock);
+		nbd_free_socks(nbd);
 		return 0;
-	}
 
-	case NBD_SET_SOCK: {
-		struct socket *sock;
-		int err;
-		if (nbd->sock)
-			return -EBUSY;
-		sock = sockfd_lookup(arg, &err);
-		if (sock) {
-			nbd->sock = sock;
-			if (max_part > 0)
-				bdev->bd_invalidated = 1;
-			nbd->disconnect = 0; /* we're connected now */
-			return 0;
-		}
-		return -EINVAL;
-	}
+	case NBD_SET_SOCK:
+		return nbd_add_socket(nbd, bdev, arg);
 
 	case NBD_SET_BLKSIZE:
 		nbd->blksize = arg;
@@ -650,6 +798,8 @@ static int __nbd_ioctl(struct block_device *bdev, struct nbd_device *nbd,
 
 	case NBD_SET_TIMEOUT:
 		nbd->xmit_timeout = arg * HZ;
+		if (arg)
+			blk_queue_rq_timeout(nbd->disk->queue, arg * HZ);
 		return 0;
 
 	case NBD_SET_FLAGS:
@@ -664,17 +814,13 @@ static int __nbd_ioctl(struct block_device *bdev, struct nbd_device *nbd,
 		return 0;
 
 	case NBD_DO_IT: {
-		struct task_struct *thread;
-		struct socket *sock;
 		int error;
 
 		if (nbd->pid)
 			return -EBUSY;
-		if (!nbd->sock)
+		if (!nbd->num_connections)
 			return -EINVAL;
 
-		mutex_unlock(&nbd->tx_lock);
-
 		if (nbd->flags & NBD_FLAG_READ_ONLY)
 			set_device_ro(bdev, true);
 		if (nbd->flags & NBD_FLAG_SEND_TRIM)
@@ -685,36 +831,24 @@ static int __nbd_ioctl(struct block_device *bdev, struct nbd_device *nbd,
 		else
 			blk_queue_flush(nbd->disk->queue, 0);
 
-		thread = kthread_run(nbd_thread, nbd, "%s",
-				     nbd->disk->disk_name);
-		if (IS_ERR(thread)) {
-			mutex_lock(&nbd->tx_lock);
-			return PTR_ERR(thread);
-		}
-
 		error = nbd_do_it(nbd);
-		kthread_stop(thread);
-
-		mutex_lock(&nbd->tx_lock);
 		if (error)
 			return error;
-		sock_shutdown(nbd, 0);
-		sock = nbd->sock;
-		nbd->sock = NULL;
+		sock_shutdown(nbd);
 		nbd_clear_que(nbd);
 		dev_warn(disk_to_dev(nbd->disk), "queue cleared\n");
 		kill_bdev(bdev);
+		nbd_free_socks(nbd);
 		queue_flag_clear_unlocked(QUEUE_FLAG_DISCARD, nbd->disk->queue);
 		set_device_ro(bdev, false);
-		if (sock)
-			sockfd_put(sock);
 		nbd->flags = 0;
 		nbd->bytesize = 0;
 		bdev->bd_inode->i_size = 0;
 		set_capacity(nbd->disk, 0);
 		if (max_part > 0)
 			ioctl_by_bdev(bdev, BLKRRPART, 0);
-		if (nbd->disconnect) /* user requested, ignore socket errors */
+		/* user requested, ignore socket errors */
+		if (test_bit(NBD_DISCONNECT_REQUESTED, &nbd->runtime_flags))
 			return 0;
 		return nbd->harderror;
 	}
@@ -728,9 +862,8 @@ static int __nbd_ioctl(struct block_device *bdev, struct nbd_device *nbd,
 
 	case NBD_PRINT_DEBUG:
 		dev_info(disk_to_dev(nbd->disk),
-			"next = %p, prev = %p, head = %p\n",
-			nbd->queue_head.next, nbd->queue_head.prev,
-			&nbd->queue_head);
+			"%d connections, %d receiving\n",
+			nbd->num_connections, atomic_read(&nbd->recv_threads));
 		return 0;
 	}
 	return -ENOTTY;
@@ -747,9 +880,9 @@ static int nbd_ioctl(struct block_device *bdev, fmode_t mode,
 
 	BUG_ON(nbd->magic != NBD_MAGIC);
 
-	mutex_lock(&nbd->tx_lock);
+	mutex_lock(&nbd->config_lock);
 	error = __nbd_ioctl(bdev, nbd, cmd, arg);
-	mutex_unlock(&nbd->tx_lock);
+	mutex_unlock(&nbd->config_lock);
 
 	return error;
 }
@@ -799,25 +932,52 @@ static int __init nbd_init(void)
 	if (nbds_max > 1UL << (MINORBITS - part_shift))
 		return -EINVAL;
 
+	if (!nr_hw_queues)
+		nr_hw_queues = num_online_cpus();
+
 	nbd_dev = kcalloc(nbds_max, sizeof(*nbd_dev), GFP_KERNEL);
 	if (!nbd_dev)
 		return -ENOMEM;
 
+	nbd_wq = alloc_workqueue("knbd", WQ_MEM_RECLAIM | WQ_HIGHPRI, 0);
+	if (!nbd_wq)
+		goto out_free_dev;
+
+	recv_workqueue = alloc_workqueue("knbd-recv", WQ_MEM_RECLAIM, 0);
+	if (!recv_workqueue)
+		goto out_free_wq;
+
 	for (i = 0; i < nbds_max; i++) {
+		struct nbd_device *nbd = &nbd_dev[i];
 		struct gendisk *disk = alloc_disk(1 << part_shift);
-		if (!disk)
+		if (!disk) {
+			err = -ENOMEM;
 			goto out;
-		nbd_dev[i].disk = disk;
-		/*
-		 * The new linux 2.5 block layer implementation requires
-		 * every gendisk to have its very own request_queue struct.
-		 * These structs are big so we dynamically allocate them.
-		 */
-		disk->queue = blk_init_queue(do_nbd_request, &nbd_lock);
-		if (!disk->queue) {
+		}
+		nbd->disk = disk;
+
+		nbd->tag_set.ops = &nbd_mq_ops;
+		nbd->tag_set.nr_hw_queues = nr_hw_queues;
+		nbd->tag_set.queue_depth = 128;
+		nbd->tag_set.numa_node = NUMA_NO_NODE;
+		nbd->tag_set.cmd_size = sizeof(struct nbd_cmd);
+		nbd->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_SG_MERGE;
+		nbd->tag_set.driver_data = nbd;
+
+		err = blk_mq_alloc_tag_set(&nbd->tag_set);
+		if (err) {
+			put_disk(disk);
+			goto out;
+		}
+
+		disk->queue = blk_mq_init_queue(&nbd->tag_set);
+		if (IS_ERR(disk->queue)) {
+			err = PTR_ERR(disk->queue);
+			blk_mq_free_tag_set(&nbd->tag_set);
 			put_disk(disk);
 			goto out;
 		}
+		disk->queue->queuedata = nbd;
 		/*
 		 * Tell the block layer that we are not a rotational device
 		 */
@@ -840,12 +1000,9 @@ static int __init nbd_init(void)
 	for (i = 0; i < nbds_max; i++) {
 		struct gendisk *disk = nbd_dev[i].disk;
 		nbd_dev[i].magic = NBD_MAGIC;
-		INIT_LIST_HEAD(&nbd_dev[i].waiting_queue);
-		spin_lock_init(&nbd_dev[i].queue_lock);
-		INIT_LIST_HEAD(&nbd_dev[i].queue_head);
-		mutex_init(&nbd_dev[i].tx_lock);
-		init_waitqueue_head(&nbd_dev[i].active_wq);
-		init_waitqueue_head(&nbd_dev[i].waiting_wq);
+		mutex_init(&nbd_dev[i].config_lock);
+		atomic_set(&nbd_dev[i].recv_threads, 0);
+		init_waitqueue_head(&nbd_dev[i].recv_wq);
 		nbd_dev[i].blksize = 1024;
 		nbd_dev[i].bytesize = 0;
 		disk->major = NBD_MAJOR;
@@ -861,8 +1018,13 @@ static int __init nbd_init(void)
 out:
 	while (i--) {
 		blk_cleanup_queue(nbd_dev[i].disk->queue);
+		blk_mq_free_tag_set(&nbd_dev[i].tag_set);
 		put_disk(nbd_dev[i].disk);
 	}
+	destroy_workqueue(recv_workqueue);
+out_free_wq:
+	destroy_workqueue(nbd_wq);
+out_free_dev:
 	kfree(nbd_dev);
 	return err;
 }
@@ -876,10 +1038,13 @@ static void __exit nbd_cleanup(void)
 		if (disk) {
 			del_gendisk(disk);
 			blk_cleanup_queue(disk->queue);
+			blk_mq_free_tag_set(&nbd_dev[i].tag_set);
 			put_disk(disk);
 		}
 	}
 	unregister_blkdev(NBD_MAJOR, "nbd");
+	destroy_workqueue(recv_workqueue);
+	destroy_workqueue(nbd_wq);
 	kfree(nbd_dev);
 	printk(KERN_INFO "nbd: unregistered device at major %d\n", NBD_MAJOR);
 }
@@ -894,3 +1059,5 @@ module_param(nbds_max, int, 0444);
 MODULE_PARM_DESC(nbds_max, "number of network block devices to initialize (default: 16)");
 module_param(max_part, int, 0444);
 MODULE_PARM_DESC(max_part, "number of partitions per device (default: 0)");
+module_param(nr_hw_queues, uint, 0444);
+MODULE_PARM_DESC(nr_hw_queues, "number of hardware queues per device, each served by its own connection when enough are given (default: number of online CPUs)");
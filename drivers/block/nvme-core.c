@@ -71,6 +71,12 @@ module_param(nvme_char_major, int, 0);
 static int use_threaded_interrupts;
 module_param(use_threaded_interrupts, int, 0);
 
+static unsigned int sgl_threshold = 32 * 1024;
+module_param(sgl_threshold, uint, 0644);
+MODULE_PARM_DESC(sgl_threshold,
+		"use SGLs when the average request segment size is larger or equal to "
+		"this size; 0 to disable SGLs");
+
 static DEFINE_SPINLOCK(dev_list_lock);
 static LIST_HEAD(dev_list);
 static struct task_struct *nvme_thread;
@@ -109,12 +115,17 @@ struct nvme_queue {
 	s16 cq_vector;
 	u16 sq_head;
 	u16 sq_tail;
+	u16 last_sq_tail;	/* tail the doorbell was last rung with */
 	u16 cq_head;
 	u16 qid;
 	u8 cq_phase;
 	u8 cqe_seen;
 	struct async_cmd_info cmdinfo;
 	struct blk_mq_hw_ctx *hctx;
+	u32 *dbbuf_sq_db;
+	u32 *dbbuf_cq_db;
+	u32 *dbbuf_sq_ei;
+	u32 *dbbuf_cq_ei;
 };
 
 /*
@@ -365,6 +376,70 @@ static void *nvme_finish_cmd(struct nvme_queue *nvmeq, int tag,
 	return ctx;
 }
 
+/*
+ * With the Doorbell Buffer Config command, the host writes the doorbell
+ * values to memory (the shadow doorbells) and the controller, typically an
+ * emulated one, tells through the event index when it wants to see an MMIO
+ * doorbell write again.  The test is the one of virtio's vring_need_event().
+ */
+static inline bool nvme_dbbuf_need_event(u16 event_idx, u16 new_idx, u16 old)
+{
+	return (u16)(new_idx - event_idx - 1) < (u16)(new_idx - old);
+}
+
+/* Update the shadow doorbell, if any, and return whether MMIO is needed */
+static bool nvme_dbbuf_update_and_check_event(u16 value, u32 *dbbuf_db,
+					      volatile u32 *dbbuf_ei)
+{
+	if (dbbuf_db) {
+		u16 old_value;
+
+		/*
+		 * Ensure that the queue is written before updating
+		 * the doorbell in memory
+		 */
+		wmb();
+
+		old_value = *dbbuf_db;
+		*dbbuf_db = value;
+
+		/*
+		 * Ensure that the doorbell is updated before reading the event
+		 * index from memory.  The controller needs to provide similar
+		 * ordering to ensure the event index is updated before reading
+		 * the doorbell.
+		 */
+		mb();
+
+		if (!nvme_dbbuf_need_event(*dbbuf_ei, value, old_value))
+			return false;
+	}
+
+	return true;
+}
+
+/* Tell the controller about the commands queued so far; q_lock held */
+static void nvme_write_sq_db(struct nvme_queue *nvmeq)
+{
+	if (nvme_dbbuf_update_and_check_event(nvmeq->sq_tail,
+			nvmeq->dbbuf_sq_db, nvmeq->dbbuf_sq_ei))
+		writel(nvmeq->sq_tail, nvmeq->q_db);
+	nvmeq->last_sq_tail = nvmeq->sq_tail;
+}
+
+/*
+ * blk-mq tells through bd->last whether more requests are coming, so the
+ * doorbell is left alone until the last one.  When it stops early, though,
+ * e.g. on BLK_MQ_RQ_QUEUE_BUSY, what was queued has to be pushed out.
+ */
+static void nvme_commit_sq(struct nvme_queue *nvmeq)
+{
+	spin_lock_irq(&nvmeq->q_lock);
+	if (nvmeq->sq_tail != nvmeq->last_sq_tail)
+		nvme_write_sq_db(nvmeq);
+	spin_unlock_irq(&nvmeq->q_lock);
+}
+
 /**
  * nvme_submit_cmd() - Copy a command into a queue and ring the doorbell
  * @nvmeq: The queue to use
@@ -379,8 +454,8 @@ static int __nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 	memcpy(&nvmeq->sq_cmds[tail], cmd, sizeof(*cmd));
 	if (++tail == nvmeq->q_depth)
 		tail = 0;
-	writel(tail, nvmeq->q_db);
 	nvmeq->sq_tail = tail;
+	nvme_write_sq_db(nvmeq);
 
 	return 0;
 }
@@ -406,6 +481,7 @@ static inline void iod_init(struct nvme_iod *iod, unsigned nbytes,
 	iod->private = private;
 	iod->offset = offsetof(struct nvme_iod, sg[nseg]);
 	iod->npages = -1;
+	iod->nr_sgl = 0;
 	iod->length = nbytes;
 	iod->nents = 0;
 }
@@ -709,6 +785,78 @@ int nvme_setup_prps(struct nvme_dev *dev, struct nvme_iod *iod, int total_len,
 	return total_len;
 }
 
+static void nvme_sgl_set_data(struct nvme_sgl_desc *sge,
+			      struct scatterlist *sg)
+{
+	sge->addr = cpu_to_le64(sg_dma_address(sg));
+	sge->length = cpu_to_le32(sg_dma_len(sg));
+	sge->type = NVME_SGL_FMT_DATA_DESC << 4;
+}
+
+static void nvme_sgl_set_seg(struct nvme_sgl_desc *sge, dma_addr_t dma_addr,
+			     int entries)
+{
+	sge->addr = cpu_to_le64(dma_addr);
+	sge->length = cpu_to_le32(entries * sizeof(*sge));
+	sge->type = NVME_SGL_FMT_LAST_SEG_DESC << 4;
+}
+
+/*
+ * SGLs describe a request with one descriptor per DMA segment instead of one
+ * PRP entry per controller page, so they win for large segments.  Only used
+ * when the descriptors fit in a single list, which is what the PRP pools
+ * hand out.
+ */
+static bool nvme_use_sgls(struct nvme_dev *dev, struct request *req)
+{
+	unsigned int avg_seg_size;
+
+	if (!(dev->sgls & (NVME_CTRL_SGLS_SUPP | NVME_CTRL_SGLS_SUPP_DWORD_ALIGN)))
+		return false;
+	if (!sgl_threshold || !req->nr_phys_segments)
+		return false;
+	if (req->nr_phys_segments > dev->page_size / sizeof(struct nvme_sgl_desc))
+		return false;
+
+	avg_seg_size = DIV_ROUND_UP(blk_rq_bytes(req), req->nr_phys_segments);
+	return avg_seg_size >= sgl_threshold;
+}
+
+/* nents is the number of segments dma_map_sg() returned */
+static bool nvme_setup_sgls(struct nvme_dev *dev, struct nvme_iod *iod,
+			    int nents, gfp_t gfp)
+{
+	struct nvme_sgl_desc *sg_list;
+	struct scatterlist *sg;
+	struct dma_pool *pool;
+	int i;
+
+	if (nents == 1) {
+		iod->nr_sgl = 1;
+		return true;
+	}
+
+	if (nents <= (256 / sizeof(struct nvme_sgl_desc))) {
+		pool = dev->prp_small_pool;
+		iod->npages = 0;
+	} else {
+		pool = dev->prp_page_pool;
+		iod->npages = 1;
+	}
+
+	sg_list = dma_pool_alloc(pool, gfp, &iod->first_dma);
+	if (!sg_list) {
+		iod->npages = -1;
+		return false;
+	}
+
+	iod_list(iod)[0] = (__le64 *)sg_list;
+	for_each_sg(iod->sg, sg, nents, i)
+		nvme_sgl_set_data(&sg_list[i], sg);
+	iod->nr_sgl = nents;
+	return true;
+}
+
 /*
  * We reuse the small pool to allocate the 16-byte range here as it is not
  * worth having a special pool for these or additional cases to handle freeing
@@ -735,7 +883,6 @@ static void nvme_submit_discard(struct nvme_queue *nvmeq, struct nvme_ns *ns,
 
 	if (++nvmeq->sq_tail == nvmeq->q_depth)
 		nvmeq->sq_tail = 0;
-	writel(nvmeq->sq_tail, nvmeq->q_db);
 }
 
 static void nvme_submit_flush(struct nvme_queue *nvmeq, struct nvme_ns *ns,
@@ -750,7 +897,6 @@ static void nvme_submit_flush(struct nvme_queue *nvmeq, struct nvme_ns *ns,
 
 	if (++nvmeq->sq_tail == nvmeq->q_depth)
 		nvmeq->sq_tail = 0;
-	writel(nvmeq->sq_tail, nvmeq->q_db);
 }
 
 static int nvme_submit_iod(struct nvme_queue *nvmeq, struct nvme_iod *iod,
@@ -775,8 +921,17 @@ static int nvme_submit_iod(struct nvme_queue *nvmeq, struct nvme_iod *iod,
 	cmnd->rw.opcode = (rq_data_dir(req) ? nvme_cmd_write : nvme_cmd_read);
 	cmnd->rw.command_id = req->tag;
 	cmnd->rw.nsid = cpu_to_le32(ns->ns_id);
-	cmnd->rw.prp1 = cpu_to_le64(sg_dma_address(iod->sg));
-	cmnd->rw.prp2 = cpu_to_le64(iod->first_dma);
+	if (iod->nr_sgl) {
+		cmnd->rw.flags = NVME_CMD_SGL_METABUF;
+		if (iod->nr_sgl == 1)
+			nvme_sgl_set_data(&cmnd->rw.sgl, iod->sg);
+		else
+			nvme_sgl_set_seg(&cmnd->rw.sgl, iod->first_dma,
+					 iod->nr_sgl);
+	} else {
+		cmnd->rw.prp1 = cpu_to_le64(sg_dma_address(iod->sg));
+		cmnd->rw.prp2 = cpu_to_le64(iod->first_dma);
+	}
 	cmnd->rw.slba = cpu_to_le64(nvme_block_nr(ns, blk_rq_pos(req)));
 	cmnd->rw.length = cpu_to_le16((blk_rq_bytes(req) >> ns->lba_shift) - 1);
 
@@ -802,7 +957,6 @@ static int nvme_submit_iod(struct nvme_queue *nvmeq, struct nvme_iod *iod,
 
 	if (++nvmeq->sq_tail == nvmeq->q_depth)
 		nvmeq->sq_tail = 0;
-	writel(nvmeq->sq_tail, nvmeq->q_db);
 
 	return 0;
 }
@@ -816,6 +970,7 @@ static int nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
 	struct nvme_cmd_info *cmd = blk_mq_rq_to_pdu(req);
 	struct nvme_iod *iod;
 	enum dma_data_direction dma_dir;
+	int nents;
 
 	/*
 	 * If formated with metadata, require the block layer provide a buffer
@@ -826,13 +981,17 @@ static int nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
 		if (!(ns->pi_type && ns->ms == 8)) {
 			req->errors = -EFAULT;
 			blk_mq_complete_request(req);
+			if (bd->last)
+				nvme_commit_sq(nvmeq);
 			return BLK_MQ_RQ_QUEUE_OK;
 		}
 	}
 
 	iod = nvme_alloc_iod(req, ns->dev, GFP_ATOMIC);
-	if (!iod)
+	if (!iod) {
+		nvme_commit_sq(nvmeq);
 		return BLK_MQ_RQ_QUEUE_BUSY;
+	}
 
 	if (req->cmd_flags & REQ_DISCARD) {
 		void *range;
@@ -856,11 +1015,20 @@ static int nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
 		if (!iod->nents)
 			goto error_cmd;
 
-		if (!dma_map_sg(nvmeq->q_dmadev, iod->sg, iod->nents, dma_dir))
+		nents = dma_map_sg(nvmeq->q_dmadev, iod->sg, iod->nents,
+				   dma_dir);
+		if (!nents)
 			goto retry_cmd;
 
-		if (blk_rq_bytes(req) !=
-                    nvme_setup_prps(nvmeq->dev, iod, blk_rq_bytes(req), GFP_ATOMIC)) {
+		if (nvme_use_sgls(nvmeq->dev, req)) {
+			if (!nvme_setup_sgls(nvmeq->dev, iod, nents,
+					     GFP_ATOMIC)) {
+				dma_unmap_sg(&nvmeq->dev->pci_dev->dev, iod->sg,
+						iod->nents, dma_dir);
+				goto retry_cmd;
+			}
+		} else if (blk_rq_bytes(req) != nvme_setup_prps(nvmeq->dev, iod,
+					blk_rq_bytes(req), GFP_ATOMIC)) {
 			dma_unmap_sg(&nvmeq->dev->pci_dev->dev, iod->sg,
 					iod->nents, dma_dir);
 			goto retry_cmd;
@@ -891,15 +1059,19 @@ static int nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
 	else
 		nvme_submit_iod(nvmeq, iod, ns);
 
+	if (bd->last)
+		nvme_write_sq_db(nvmeq);
 	nvme_process_cq(nvmeq);
 	spin_unlock_irq(&nvmeq->q_lock);
 	return BLK_MQ_RQ_QUEUE_OK;
 
  error_cmd:
 	nvme_free_iod(nvmeq->dev, iod);
+	nvme_commit_sq(nvmeq);
 	return BLK_MQ_RQ_QUEUE_ERROR;
  retry_cmd:
 	nvme_free_iod(nvmeq->dev, iod);
+	nvme_commit_sq(nvmeq);
 	return BLK_MQ_RQ_QUEUE_BUSY;
 }
 
@@ -934,7 +1106,9 @@ static int nvme_process_cq(struct nvme_queue *nvmeq)
 	if (head == nvmeq->cq_head && phase == nvmeq->cq_phase)
 		return 0;
 
-	writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
+	if (nvme_dbbuf_update_and_check_event(head, nvmeq->dbbuf_cq_db,
+					      nvmeq->dbbuf_cq_ei))
+		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
 	nvmeq->cq_head = head;
 	nvmeq->cq_phase = phase;
 
@@ -972,6 +1146,24 @@ static irqreturn_t nvme_irq_check(int irq, void *data)
 	return IRQ_WAKE_THREAD;
 }
 
+static int nvme_poll(struct blk_mq_hw_ctx *hctx)
+{
+	struct nvme_queue *nvmeq = hctx->driver_data;
+	struct nvme_completion cqe = nvmeq->cqes[nvmeq->cq_head];
+	int found = 0;
+
+	if ((le16_to_cpu(cqe.status) & 1) != nvmeq->cq_phase)
+		return 0;
+
+	spin_lock_irq(&nvmeq->q_lock);
+	nvme_process_cq(nvmeq);
+	found = nvmeq->cqe_seen;
+	nvmeq->cqe_seen = 0;
+	spin_unlock_irq(&nvmeq->q_lock);
+
+	return found;
+}
+
 struct sync_cmd_info {
 	struct task_struct *task;
 	u32 result;
@@ -1344,7 +1536,7 @@ static int nvme_suspend_queue(struct nvme_queue *nvmeq)
 	if (!nvmeq->qid && nvmeq->dev->admin_q)
 		blk_mq_freeze_queue_start(nvmeq->dev->admin_q);
 
-	irq_set_affinity_hint(vector, NULL);
+	irq_set_managed_affinity(vector, NULL);
 	free_irq(vector, nvmeq);
 
 	return 0;
@@ -1439,14 +1631,114 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 
 	spin_lock_irq(&nvmeq->q_lock);
 	nvmeq->sq_tail = 0;
+	nvmeq->last_sq_tail = 0;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
+	/* MMIO doorbells until nvme_dbbuf_set() says otherwise */
+	nvmeq->dbbuf_sq_db = NULL;
+	nvmeq->dbbuf_cq_db = NULL;
+	nvmeq->dbbuf_sq_ei = NULL;
+	nvmeq->dbbuf_cq_ei = NULL;
 	memset((void *)nvmeq->cqes, 0, CQ_SIZE(nvmeq->q_depth));
 	dev->online_queues++;
 	spin_unlock_irq(&nvmeq->q_lock);
 }
 
+/*
+ * One SQ and one CQ doorbell per queue, at the stride of the registers.
+ * Sized for the most queues we could ever create, so that a reset with a
+ * different queue count can reuse the buffers.
+ */
+static unsigned int nvme_dbbuf_size(struct nvme_dev *dev)
+{
+	return (num_possible_cpus() + 1) * 8 * dev->db_stride;
+}
+
+static int nvme_dbbuf_dma_alloc(struct nvme_dev *dev)
+{
+	unsigned int mem_size = nvme_dbbuf_size(dev);
+
+	if (dev->dbbuf_dbs)
+		return 0;
+
+	dev->dbbuf_dbs = dma_alloc_coherent(&dev->pci_dev->dev, mem_size,
+					    &dev->dbbuf_dbs_dma_addr,
+					    GFP_KERNEL);
+	if (!dev->dbbuf_dbs)
+		return -ENOMEM;
+	dev->dbbuf_eis = dma_alloc_coherent(&dev->pci_dev->dev, mem_size,
+					    &dev->dbbuf_eis_dma_addr,
+					    GFP_KERNEL);
+	if (!dev->dbbuf_eis) {
+		dma_free_coherent(&dev->pci_dev->dev, mem_size,
+				  dev->dbbuf_dbs, dev->dbbuf_dbs_dma_addr);
+		dev->dbbuf_dbs = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void nvme_dbbuf_dma_free(struct nvme_dev *dev)
+{
+	unsigned int mem_size = nvme_dbbuf_size(dev);
+
+	if (dev->dbbuf_dbs) {
+		dma_free_coherent(&dev->pci_dev->dev, mem_size,
+				  dev->dbbuf_dbs, dev->dbbuf_dbs_dma_addr);
+		dev->dbbuf_dbs = NULL;
+	}
+	if (dev->dbbuf_eis) {
+		dma_free_coherent(&dev->pci_dev->dev, mem_size,
+				  dev->dbbuf_eis, dev->dbbuf_eis_dma_addr);
+		dev->dbbuf_eis = NULL;
+	}
+}
+
+/*
+ * Hand the shadow doorbell buffers to the controller and switch the I/O
+ * queues over to them.  The admin queue keeps using MMIO.  Called with
+ * the I/O queues created and idle.
+ */
+static void nvme_dbbuf_set(struct nvme_dev *dev)
+{
+	struct nvme_command c;
+	unsigned i;
+
+	if (!dev->dbbuf_dbs)
+		return;
+
+	memset(dev->dbbuf_dbs, 0, nvme_dbbuf_size(dev));
+	memset(dev->dbbuf_eis, 0, nvme_dbbuf_size(dev));
+
+	memset(&c, 0, sizeof(c));
+	c.common.opcode = nvme_admin_dbbuf;
+	c.common.prp1 = cpu_to_le64(dev->dbbuf_dbs_dma_addr);
+	c.common.prp2 = cpu_to_le64(dev->dbbuf_eis_dma_addr);
+
+	if (nvme_submit_admin_cmd(dev, &c, NULL)) {
+		dev_warn(&dev->pci_dev->dev, "unable to set dbbuf\n");
+		/* Free memory and continue on */
+		nvme_dbbuf_dma_free(dev);
+		return;
+	}
+
+	for (i = 1; i < dev->online_queues; i++) {
+		struct nvme_queue *nvmeq = dev->queues[i];
+		unsigned int stride = dev->db_stride;
+
+		spin_lock_irq(&nvmeq->q_lock);
+		nvmeq->dbbuf_sq_db = &dev->dbbuf_dbs[i * 2 * stride];
+		nvmeq->dbbuf_cq_db = &dev->dbbuf_dbs[(i * 2 + 1) * stride];
+		nvmeq->dbbuf_sq_ei = &dev->dbbuf_eis[i * 2 * stride];
+		nvmeq->dbbuf_cq_ei = &dev->dbbuf_eis[(i * 2 + 1) * stride];
+		*nvmeq->dbbuf_sq_db = nvmeq->sq_tail;
+		*nvmeq->dbbuf_cq_db = nvmeq->cq_head;
+		spin_unlock_irq(&nvmeq->q_lock);
+	}
+}
+
 static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 {
 	struct nvme_dev *dev = nvmeq->dev;
@@ -1562,6 +1854,7 @@ static struct blk_mq_ops nvme_mq_ops = {
 	.exit_hctx	= nvme_exit_hctx,
 	.init_request	= nvme_init_request,
 	.timeout	= nvme_timeout,
+	.poll		= nvme_poll,
 };
 
 static void nvme_dev_remove_admin(struct nvme_dev *dev)
@@ -2303,6 +2596,8 @@ static int nvme_dev_add(struct nvme_dev *dev)
 	ctrl = mem;
 	nn = le32_to_cpup(&ctrl->nn);
 	dev->oncs = le16_to_cpup(&ctrl->oncs);
+	dev->oacs = le16_to_cpup(&ctrl->oacs);
+	dev->sgls = le32_to_cpup(&ctrl->sgls);
 	dev->abort_limit = ctrl->acl + 1;
 	dev->vwc = ctrl->vwc;
 	memcpy(dev->serial, ctrl->sn, sizeof(ctrl->sn));
@@ -2324,6 +2619,14 @@ static int nvme_dev_add(struct nvme_dev *dev)
 	}
 	dma_free_coherent(&dev->pci_dev->dev, 4096, mem, dma_addr);
 
+	/*
+	 * The I/O queues were set up before the controller was identified,
+	 * so the shadow doorbells are switched on for them here; resets
+	 * re-enable them from nvme_dev_start().
+	 */
+	if ((dev->oacs & NVME_CTRL_OACS_DBBUF_SUPP) && !nvme_dbbuf_dma_alloc(dev))
+		nvme_dbbuf_set(dev);
+
 	dev->tagset.ops = &nvme_mq_ops;
 	dev->tagset.nr_hw_queues = dev->online_queues - 1;
 	dev->tagset.timeout = NVME_IO_TIMEOUT;
@@ -2803,7 +3106,7 @@ static void nvme_set_irq_hints(struct nvme_dev *dev)
 		if (!nvmeq->hctx)
 			continue;
 
-		irq_set_affinity_hint(dev->entry[nvmeq->cq_vector].vector,
+		irq_set_managed_affinity(dev->entry[nvmeq->cq_vector].vector,
 							nvmeq->hctx->cpumask);
 	}
 }
@@ -2849,6 +3152,7 @@ static int nvme_dev_start(struct nvme_dev *dev)
 	if (result)
 		goto free_tags;
 
+	nvme_dbbuf_set(dev);
 	nvme_set_irq_hints(dev);
 
 	dev->event_limit = 1;
@@ -3047,6 +3351,7 @@ static void nvme_remove(struct pci_dev *pdev)
 	nvme_dev_remove_admin(dev);
 	device_destroy(nvme_class, MKDEV(nvme_char_major, dev->instance));
 	nvme_free_queues(dev, 0);
+	nvme_dbbuf_dma_free(dev);
 	nvme_release_prp_pools(dev);
 	kref_put(&dev->kref, nvme_free_dev);
 }
@@ -13,6 +13,7 @@
 #include <linux/idr.h>
 #include <linux/blk-mq.h>
 #include <linux/numa.h>
+#include <linux/highmem.h>
 
 #define PART_BITS 4
 #define VQ_NAME_LEN 16
@@ -55,6 +56,8 @@ struct virtblk_req {
 	struct request *req;
 	struct virtio_blk_outhdr out_hdr;
 	struct virtio_scsi_inhdr in_hdr;
+	/* the range of a discard or write zeroes request */
+	struct virtio_blk_discard_write_zeroes range;
 	u8 status;
 	struct scatterlist sg[];
 };
@@ -131,6 +134,44 @@ static inline void virtblk_request_done(struct request *req)
 	blk_mq_end_request(req, error);
 }
 
+/*
+ * There is no write zeroes request in the block layer: zeroing goes through
+ * blkdev_issue_zeroout(), which uses WRITE SAME of the zero page when the
+ * queue advertises it.  Only such requests can be turned into write zeroes,
+ * so check the payload.
+ */
+static bool virtblk_write_same_is_zeroes(struct request *req)
+{
+	struct bio_vec bv = bio_iovec(req->bio);
+	void *p;
+	bool zero;
+
+	if (bv.bv_page == ZERO_PAGE(0))
+		return true;
+
+	p = kmap_atomic(bv.bv_page);
+	zero = !memchr_inv(p + bv.bv_offset, 0, bv.bv_len);
+	kunmap_atomic(p);
+	return zero;
+}
+
+/*
+ * Discard and write zeroes carry a single range: contiguous bios are
+ * merged into one request, but the block layer can't hand us several
+ * ranges in one request.
+ */
+static int virtblk_setup_discard_write_zeroes(struct virtblk_req *vbr)
+{
+	struct request *req = vbr->req;
+
+	vbr->range.sector = cpu_to_le64(blk_rq_pos(req));
+	vbr->range.num_sectors = cpu_to_le32(blk_rq_sectors(req));
+	vbr->range.flags = 0;
+
+	sg_init_one(vbr->sg, &vbr->range, sizeof(vbr->range));
+	return 1;
+}
+
 static void virtblk_done(struct virtqueue *vq)
 {
 	struct virtio_blk *vblk = vq->vdev->priv;
@@ -176,6 +217,19 @@ static int virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
 		vbr->out_hdr.type = cpu_to_virtio32(vblk->vdev, VIRTIO_BLK_T_FLUSH);
 		vbr->out_hdr.sector = 0;
 		vbr->out_hdr.ioprio = cpu_to_virtio32(vblk->vdev, req_get_ioprio(vbr->req));
+	} else if (req->cmd_flags & REQ_DISCARD) {
+		vbr->out_hdr.type = cpu_to_virtio32(vblk->vdev, VIRTIO_BLK_T_DISCARD);
+		vbr->out_hdr.sector = 0;
+		vbr->out_hdr.ioprio = cpu_to_virtio32(vblk->vdev, req_get_ioprio(vbr->req));
+	} else if (req->cmd_flags & REQ_WRITE_SAME) {
+		if (!virtblk_write_same_is_zeroes(req)) {
+			blk_mq_start_request(req);
+			blk_mq_end_request(req, -EOPNOTSUPP);
+			return BLK_MQ_RQ_QUEUE_OK;
+		}
+		vbr->out_hdr.type = cpu_to_virtio32(vblk->vdev, VIRTIO_BLK_T_WRITE_ZEROES);
+		vbr->out_hdr.sector = 0;
+		vbr->out_hdr.ioprio = cpu_to_virtio32(vblk->vdev, req_get_ioprio(vbr->req));
 	} else {
 		switch (req->cmd_type) {
 		case REQ_TYPE_FS:
@@ -201,12 +255,17 @@ static int virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
 
 	blk_mq_start_request(req);
 
-	num = blk_rq_map_sg(hctx->queue, vbr->req, vbr->sg);
-	if (num) {
-		if (rq_data_dir(vbr->req) == WRITE)
-			vbr->out_hdr.type |= cpu_to_virtio32(vblk->vdev, VIRTIO_BLK_T_OUT);
-		else
-			vbr->out_hdr.type |= cpu_to_virtio32(vblk->vdev, VIRTIO_BLK_T_IN);
+	if (req->cmd_flags & (REQ_DISCARD | REQ_WRITE_SAME)) {
+		/* both command types have the VIRTIO_BLK_T_OUT bit set */
+		num = virtblk_setup_discard_write_zeroes(vbr);
+	} else {
+		num = blk_rq_map_sg(hctx->queue, vbr->req, vbr->sg);
+		if (num) {
+			if (rq_data_dir(vbr->req) == WRITE)
+				vbr->out_hdr.type |= cpu_to_virtio32(vblk->vdev, VIRTIO_BLK_T_OUT);
+			else
+				vbr->out_hdr.type |= cpu_to_virtio32(vblk->vdev, VIRTIO_BLK_T_IN);
+		}
 	}
 
 	spin_lock_irqsave(&vblk->vqs[qid].lock, flags);
@@ -390,9 +449,12 @@ static int init_vq(struct virtio_blk *vblk)
 	err = virtio_cread_feature(vdev, VIRTIO_BLK_F_MQ,
 				   struct virtio_blk_config, num_queues,
 				   &num_vqs);
-	if (err)
+	if (err || !num_vqs)
 		num_vqs = 1;
 
+	/* More queues than cpus would never be used */
+	num_vqs = min_t(unsigned int, nr_cpu_ids, num_vqs);
+
 	vblk->vqs = kmalloc(sizeof(*vblk->vqs) * num_vqs, GFP_KERNEL);
 	if (!vblk->vqs) {
 		err = -ENOMEM;
@@ -441,6 +503,24 @@ static int init_vq(struct virtio_blk *vblk)
 	return err;
 }
 
+/*
+ * Pin the interrupt of each virtqueue to the cpus blk-mq maps to its
+ * hardware queue, so that completions come in where the requests were
+ * submitted.  hctx->cpumask is updated in place when blk-mq remaps the
+ * queues on cpu hotplug, and the managed affinity follows it.
+ */
+static void virtblk_set_vq_affinity(struct virtio_blk *vblk)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	if (vblk->num_vqs == 1)
+		return;
+
+	queue_for_each_hw_ctx(vblk->disk->queue, hctx, i)
+		virtqueue_set_managed_affinity(vblk->vqs[i].vq, hctx->cpumask);
+}
+
 /*
  * Legacy naming scheme used for virtio devices.  We are stuck with it for
  * virtio blk but don't ever use it for any new driver.
@@ -650,6 +730,8 @@ static int virtblk_probe(struct virtio_device *vdev)
 
 	q->queuedata = vblk;
 
+	virtblk_set_vq_affinity(vblk);
+
 	virtblk_name_format("vd", index, vblk->disk->disk_name, DISK_NAME_LEN);
 
 	vblk->disk->major = major;
@@ -730,6 +812,23 @@ static int virtblk_probe(struct virtio_device *vdev)
 	if (!err && opt_io_size)
 		blk_queue_io_opt(q, blk_size * opt_io_size);
 
+	if (virtio_has_feature(vdev, VIRTIO_BLK_F_DISCARD)) {
+		virtio_cread(vdev, struct virtio_blk_config,
+			     discard_sector_alignment, &v);
+		q->limits.discard_granularity = v ? v << 9 : blk_size;
+
+		virtio_cread(vdev, struct virtio_blk_config,
+			     max_discard_sectors, &v);
+		blk_queue_max_discard_sectors(q, v ? v : UINT_MAX);
+		queue_flag_set_unlocked(QUEUE_FLAG_DISCARD, q);
+	}
+
+	if (virtio_has_feature(vdev, VIRTIO_BLK_F_WRITE_ZEROES)) {
+		virtio_cread(vdev, struct virtio_blk_config,
+			     max_write_zeroes_sectors, &v);
+		blk_queue_max_write_same_sectors(q, v ? v : UINT_MAX);
+	}
+
 	virtio_device_ready(vdev);
 
 	add_disk(vblk->disk);
@@ -768,11 +867,15 @@ static void virtblk_remove(struct virtio_device *vdev)
 {
 	struct virtio_blk *vblk = vdev->priv;
 	int index = vblk->index;
-	int refc;
+	int refc, i;
 
 	/* Make sure no work handler is accessing the device. */
 	flush_work(&vblk->config_work);
 
+	/* The hctx cpumasks go away with the queue */
+	for (i = 0; i < vblk->num_vqs; i++)
+		virtqueue_set_managed_affinity(vblk->vqs[i].vq, NULL);
+
 	del_gendisk(vblk->disk);
 	blk_cleanup_queue(vblk->disk->queue);
 
@@ -818,6 +921,7 @@ static int virtblk_restore(struct virtio_device *vdev)
 	if (ret)
 		return ret;
 
+	virtblk_set_vq_affinity(vblk);
 	virtio_device_ready(vdev);
 
 	blk_mq_start_stopped_hw_queues(vblk->disk->queue, true);
@@ -834,14 +938,14 @@ static unsigned int features_legacy[] = {
 	VIRTIO_BLK_F_SEG_MAX, VIRTIO_BLK_F_SIZE_MAX, VIRTIO_BLK_F_GEOMETRY,
 	VIRTIO_BLK_F_RO, VIRTIO_BLK_F_BLK_SIZE, VIRTIO_BLK_F_SCSI,
 	VIRTIO_BLK_F_WCE, VIRTIO_BLK_F_TOPOLOGY, VIRTIO_BLK_F_CONFIG_WCE,
-	VIRTIO_BLK_F_MQ,
+	VIRTIO_BLK_F_MQ, VIRTIO_BLK_F_DISCARD, VIRTIO_BLK_F_WRITE_ZEROES,
 }
 ;
 static unsigned int features[] = {
 	VIRTIO_BLK_F_SEG_MAX, VIRTIO_BLK_F_SIZE_MAX, VIRTIO_BLK_F_GEOMETRY,
 	VIRTIO_BLK_F_RO, VIRTIO_BLK_F_BLK_SIZE,
 	VIRTIO_BLK_F_TOPOLOGY,
-	VIRTIO_BLK_F_MQ,
+	VIRTIO_BLK_F_MQ, VIRTIO_BLK_F_DISCARD, VIRTIO_BLK_F_WRITE_ZEROES,
 };
 
 static struct virtio_driver virtio_blk = {
@@ -204,6 +204,32 @@ static ssize_t mem_used_max_store(struct device *dev,
 	return len;
 }
 
+/* needs init_lock and an initialized device */
+static void zram_compact(struct zram *zram)
+{
+	unsigned long nr_migrated;
+
+	nr_migrated = zs_compact(zram->meta->mem_pool);
+	atomic64_add(nr_migrated, &zram->stats.num_migrated);
+}
+
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	zram_compact(zram);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
 static ssize_t max_comp_streams_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -224,6 +250,11 @@ static ssize_t max_comp_streams_store(struct device *dev,
 			ret = -EINVAL;
 			goto out;
 		}
+		if (zram->recomp && !zcomp_set_max_streams(zram->recomp, num)) {
+			pr_info("Cannot change max recompression streams\n");
+			ret = -EINVAL;
+			goto out;
+		}
 	}
 
 	zram->max_comp_streams = num;
@@ -261,6 +292,38 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_compressor, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+	if (sysfs_streq(buf, "none"))
+		zram->recomp_compressor[0] = '\0';
+	else
+		strlcpy(zram->recomp_compressor, buf,
+			sizeof(zram->recomp_compressor));
+	up_write(&zram->init_lock);
+	return len;
+}
+
 /* flag operations needs meta->tb_lock */
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
@@ -298,6 +361,172 @@ static inline int is_partial_io(struct bio_vec *bvec)
 	return bvec->bv_len != PAGE_SIZE;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static void reset_bdev(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	zram->bdev = NULL;
+	kfree(zram->backing_dev);
+	zram->backing_dev = NULL;
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE, "%s\n",
+			zram->backing_dev ? zram->backing_dev : "none");
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct block_device *bdev;
+	unsigned long nr_pages, *bitmap;
+	char *path;
+	int err;
+
+	path = kstrndup(buf, len, GFP_KERNEL);
+	if (!path)
+		return -ENOMEM;
+	/* ignore trailing newline */
+	if (len && path[len - 1] == '\n')
+		path[len - 1] = '\0';
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	bdev = blkdev_get_by_path(path, FMODE_READ | FMODE_WRITE | FMODE_EXCL,
+				  zram);
+	if (IS_ERR(bdev)) {
+		err = PTR_ERR(bdev);
+		goto out;
+	}
+
+	err = set_blocksize(bdev, PAGE_SIZE);
+	if (err)
+		goto out_put;
+
+	nr_pages = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out_put;
+	}
+
+	reset_bdev(zram);
+	zram->bdev = bdev;
+	zram->backing_dev = path;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", path);
+	return len;
+
+out_put:
+	blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+out:
+	up_write(&zram->init_lock);
+	kfree(path);
+	return err;
+}
+
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	/* skip bit 0 so that a handle of 0 still means an empty slot */
+	unsigned long blk_idx = 1;
+
+retry:
+	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
+	if (blk_idx >= zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		goto retry;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	WARN_ON_ONCE(!test_and_clear_bit(blk_idx, zram->bitmap));
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+static int zram_bdev_rw_page(struct zram *zram, struct page *page,
+			     unsigned long blk_idx, int rw)
+{
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_iter.bi_sector = blk_idx * SECTORS_PER_PAGE;
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	if (rw == READ)
+		atomic64_inc(&zram->stats.bd_reads);
+	else
+		atomic64_inc(&zram->stats.bd_writes);
+
+	ret = submit_bio_wait(rw, bio);
+	bio_put(bio);
+	return ret;
+}
+#else
+static inline void reset_bdev(struct zram *zram) {}
+static inline void free_block_bdev(struct zram *zram, unsigned long blk_idx) {}
+
+static inline int zram_bdev_rw_page(struct zram *zram, struct page *page,
+				    unsigned long blk_idx, int rw)
+{
+	return -EIO;
+}
+#endif
+
+/* Reads a written back page into @mem, may sleep. */
+static int zram_read_bdev_mem(struct zram *zram, char *mem,
+			      unsigned long blk_idx)
+{
+	struct page *page;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bdev_rw_page(zram, page, blk_idx, READ);
+	if (!ret)
+		copy_page(mem, page_address(page));
+	__free_page(page);
+	return ret;
+}
+
 /*
  * Check if request is within bounds and aligned on zram logical blocks.
  */
@@ -331,7 +560,7 @@ static void zram_meta_free(struct zram_meta *meta, u64 disksize)
 	for (index = 0; index < num_pages; index++) {
 		unsigned long handle = meta->table[index].handle;
 
-		if (!handle)
+		if (!handle || zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
 		zs_free(meta->mem_pool, handle);
@@ -433,6 +662,21 @@ static void zram_free_page(struct zram *zram, size_t index)
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	zram_clear_flag(meta, index, ZRAM_PENDING);
+
+	if (zram_test_flag(meta, index, ZRAM_HUGE)) {
+		zram_clear_flag(meta, index, ZRAM_HUGE);
+		atomic64_dec(&zram->stats.huge_pages);
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, handle);
+		meta->table[index].handle = 0;
+		return;
+	}
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -446,6 +690,7 @@ static void zram_free_page(struct zram *zram, size_t index)
 	}
 
 	zs_free(meta->mem_pool, handle);
+	zram_clear_flag(meta, index, ZRAM_RECOMP);
 
 	atomic64_sub(zram_get_obj_size(meta, index),
 			&zram->stats.compr_data_size);
@@ -455,11 +700,16 @@ static void zram_free_page(struct zram *zram, size_t index)
 	zram_set_obj_size(meta, index, 0);
 }
 
+/*
+ * Sleeps for pages on the backing device, which zram_bvec_read() reads
+ * by itself before mapping the destination atomically.
+ */
 static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 {
 	int ret = 0;
 	unsigned char *cmem;
 	struct zram_meta *meta = zram->meta;
+	struct zcomp *comp = zram->comp;
 	unsigned long handle;
 	size_t size;
 
@@ -467,6 +717,14 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	handle = meta->table[index].handle;
 	size = zram_get_obj_size(meta, index);
 
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return zram_read_bdev_mem(zram, mem, handle);
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_RECOMP))
+		comp = zram->recomp;
+
 	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 		clear_page(mem);
@@ -477,7 +735,7 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	if (size == PAGE_SIZE)
 		copy_page(mem, cmem);
 	else
-		ret = zcomp_decompress(zram->comp, cmem, size, mem);
+		ret = zcomp_decompress(comp, cmem, size, mem);
 	zs_unmap_object(meta->mem_pool, handle);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
@@ -490,6 +748,37 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+static int zram_bvec_read_bdev(struct zram *zram, struct bio_vec *bvec,
+			       unsigned long blk_idx, int offset)
+{
+	struct page *page;
+	unsigned char *user_mem;
+	int ret;
+
+	if (!is_partial_io(bvec)) {
+		ret = zram_bdev_rw_page(zram, bvec->bv_page, blk_idx, READ);
+		if (!ret)
+			flush_dcache_page(bvec->bv_page);
+		return ret;
+	}
+
+	/* Use a temporary page to read the whole block */
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bdev_rw_page(zram, page, blk_idx, READ);
+	if (!ret) {
+		user_mem = kmap_atomic(bvec->bv_page);
+		memcpy(user_mem + bvec->bv_offset, page_address(page) + offset,
+		       bvec->bv_len);
+		kunmap_atomic(user_mem);
+		flush_dcache_page(bvec->bv_page);
+	}
+	__free_page(page);
+	return ret;
+}
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset)
 {
@@ -500,12 +789,19 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	page = bvec->bv_page;
 
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
 	if (unlikely(!meta->table[index].handle) ||
 			zram_test_flag(meta, index, ZRAM_ZERO)) {
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 		handle_zero_page(bvec);
 		return 0;
 	}
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		unsigned long blk_idx = meta->table[index].handle;
+
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return zram_bvec_read_bdev(zram, bvec, blk_idx, offset);
+	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	if (is_partial_io(bvec))
@@ -669,6 +965,10 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	meta->table[index].handle = handle;
 	zram_set_obj_size(meta, index, clen);
+	if (clen == PAGE_SIZE) {
+		zram_set_flag(meta, index, ZRAM_HUGE);
+		atomic64_inc(&zram->stats.huge_pages);
+	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	/* Update stats */
@@ -711,6 +1011,282 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	return ret;
 }
 
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	size_t index, nr_pages;
+	ssize_t ret = len;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (meta->table[index].handle &&
+		    !zram_test_flag(meta, index, ZRAM_WB))
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	}
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+/* "idle", "huge" or "huge_idle" select the pages to post-process */
+static int parse_page_selection(const char *buf, bool *idle, bool *huge)
+{
+	*idle = *huge = false;
+
+	if (sysfs_streq(buf, "idle"))
+		*idle = true;
+	else if (sysfs_streq(buf, "huge"))
+		*huge = true;
+	else if (sysfs_streq(buf, "huge_idle"))
+		*idle = *huge = true;
+	else
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Checks the slot against the selection and marks it ZRAM_PENDING if it
+ * matches: the slot is unlocked while its page is being recompressed or
+ * written back, and any write or free in between clears the flag so the
+ * result is dropped.
+ */
+static bool zram_mark_pending(struct zram_meta *meta, u32 index,
+			      bool idle, bool huge, bool recomp)
+{
+	bool ret = false;
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	if (!meta->table[index].handle ||
+	    zram_test_flag(meta, index, ZRAM_WB) ||
+	    zram_test_flag(meta, index, ZRAM_PENDING))
+		goto out;
+	if (recomp && zram_test_flag(meta, index, ZRAM_RECOMP))
+		goto out;
+	if (idle && !zram_test_flag(meta, index, ZRAM_IDLE))
+		goto out;
+	if (huge && !zram_test_flag(meta, index, ZRAM_HUGE))
+		goto out;
+
+	zram_set_flag(meta, index, ZRAM_PENDING);
+	ret = true;
+out:
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	return ret;
+}
+
+static void zram_clear_pending(struct zram_meta *meta, u32 index)
+{
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	zram_clear_flag(meta, index, ZRAM_PENDING);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+}
+
+/*
+ * Recompresses the page at @index with the secondary algorithm and keeps
+ * the result only if it is smaller than what is stored.
+ */
+static int zram_recompress(struct zram *zram, u32 index, struct page *page,
+			   bool idle, bool huge)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zcomp_strm *zstrm;
+	unsigned long handle, old_handle;
+	size_t size, old_size;
+	unsigned char *cmem;
+	int ret;
+
+	if (!zram_mark_pending(meta, index, idle, huge, true))
+		return 0;
+
+	ret = zram_decompress_page(zram, page_address(page), index);
+	if (ret)
+		goto out;
+
+	zstrm = zcomp_strm_find(zram->recomp);
+	ret = zcomp_compress(zram->recomp, zstrm, page_address(page), &size);
+	if (ret || size > max_zpage_size) {
+		zcomp_strm_release(zram->recomp, zstrm);
+		goto out;
+	}
+
+	handle = zs_malloc(meta->mem_pool, size);
+	if (!handle) {
+		zcomp_strm_release(zram->recomp, zstrm);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
+	memcpy(cmem, zstrm->buffer, size);
+	zs_unmap_object(meta->mem_pool, handle);
+	zcomp_strm_release(zram->recomp, zstrm);
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	old_handle = meta->table[index].handle;
+	old_size = zram_get_obj_size(meta, index);
+	if (!zram_test_flag(meta, index, ZRAM_PENDING) || size >= old_size) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		zs_free(meta->mem_pool, handle);
+		goto out;
+	}
+
+	zs_free(meta->mem_pool, old_handle);
+	if (zram_test_flag(meta, index, ZRAM_HUGE)) {
+		zram_clear_flag(meta, index, ZRAM_HUGE);
+		atomic64_dec(&zram->stats.huge_pages);
+	}
+	zram_clear_flag(meta, index, ZRAM_PENDING);
+	zram_set_flag(meta, index, ZRAM_RECOMP);
+	meta->table[index].handle = handle;
+	zram_set_obj_size(meta, index, size);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	atomic64_sub(old_size - size, &zram->stats.compr_data_size);
+	return 0;
+out:
+	zram_clear_pending(meta, index);
+	return ret;
+}
+
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	size_t index, nr_pages;
+	struct page *page;
+	bool idle, huge;
+	int ret;
+
+	ret = parse_page_selection(buf, &idle, &huge);
+	if (ret)
+		return ret;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->recomp) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		ret = zram_recompress(zram, index, page, idle, huge);
+		if (ret)
+			break;
+		cond_resched();
+	}
+	/* the old objects were freed all over the size classes */
+	zram_compact(zram);
+out:
+	up_read(&zram->init_lock);
+	__free_page(page);
+	return ret ? ret : len;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/*
+ * Moves the page at @index to the backing device.  It is written out
+ * decompressed, so reading it back costs one block read and nothing else.
+ */
+static int zram_writeback_slot(struct zram *zram, u32 index,
+			       struct page *page, bool idle, bool huge)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long blk_idx;
+	int ret;
+
+	if (!zram_mark_pending(meta, index, idle, huge, false))
+		return 0;
+
+	blk_idx = alloc_block_bdev(zram);
+	if (!blk_idx) {
+		ret = -ENOSPC;
+		goto out;
+	}
+
+	ret = zram_decompress_page(zram, page_address(page), index);
+	if (ret)
+		goto out_free_block;
+
+	ret = zram_bdev_rw_page(zram, page, blk_idx, WRITE);
+	if (ret)
+		goto out_free_block;
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	if (!zram_test_flag(meta, index, ZRAM_PENDING)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		free_block_bdev(zram, blk_idx);
+		return 0;
+	}
+	zram_free_page(zram, index);
+	zram_set_flag(meta, index, ZRAM_WB);
+	meta->table[index].handle = blk_idx;
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	return 0;
+
+out_free_block:
+	free_block_bdev(zram, blk_idx);
+out:
+	zram_clear_pending(meta, index);
+	return ret;
+}
+
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	size_t index, nr_pages;
+	struct page *page;
+	bool idle, huge;
+	int ret;
+
+	ret = parse_page_selection(buf, &idle, &huge);
+	if (ret)
+		return ret;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->bdev) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		ret = zram_writeback_slot(zram, index, page, idle, huge);
+		if (ret)
+			break;
+		cond_resched();
+	}
+	zram_compact(zram);
+out:
+	up_read(&zram->init_lock);
+	__free_page(page);
+	return ret ? ret : len;
+}
+#endif
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -753,7 +1329,7 @@ static void zram_bio_discard(struct zram *zram, u32 index,
 static void zram_reset_device(struct zram *zram)
 {
 	struct zram_meta *meta;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp;
 	u64 disksize;
 
 	down_write(&zram->init_lock);
@@ -786,17 +1362,23 @@ static void zram_reset_device(struct zram *zram)
 	zram->max_comp_streams = 1;
 	set_capacity(zram->disk, 0);
 
+	recomp = zram->recomp;
+	zram->recomp = NULL;
+	reset_bdev(zram);
+
 	up_write(&zram->init_lock);
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(meta, disksize);
 	zcomp_destroy(comp);
+	if (recomp)
+		zcomp_destroy(recomp);
 }
 
 static ssize_t disksize_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	u64 disksize;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp = NULL;
 	struct zram_meta *meta;
 	struct zram *zram = dev_to_zram(dev);
 	int err;
@@ -818,6 +1400,18 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	if (zram->recomp_compressor[0]) {
+		recomp = zcomp_create(zram->recomp_compressor,
+				      zram->max_comp_streams);
+		if (IS_ERR(recomp)) {
+			pr_info("Cannot initialise %s recompressing backend\n",
+					zram->recomp_compressor);
+			err = PTR_ERR(recomp);
+			recomp = NULL;
+			goto out_free_comp;
+		}
+	}
+
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
 		pr_info("Cannot change disksize for initialized device\n");
@@ -829,6 +1423,7 @@ static ssize_t disksize_store(struct device *dev,
 	atomic_set(&zram->refcount, 1);
 	zram->meta = meta;
 	zram->comp = comp;
+	zram->recomp = recomp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 	up_write(&zram->init_lock);
@@ -844,6 +1439,9 @@ static ssize_t disksize_store(struct device *dev,
 
 out_destroy_comp:
 	up_write(&zram->init_lock);
+out_free_comp:
+	if (recomp)
+		zcomp_destroy(recomp);
 	zcomp_destroy(comp);
 out_free_meta:
 	zram_meta_free(meta, disksize);
@@ -1041,12 +1639,20 @@ static const struct block_device_operations zram_devops = {
 static DEVICE_ATTR_RW(disksize);
 static DEVICE_ATTR_RO(initstate);
 static DEVICE_ATTR_WO(reset);
+static DEVICE_ATTR_WO(compact);
 static DEVICE_ATTR_RO(orig_data_size);
 static DEVICE_ATTR_RO(mem_used_total);
 static DEVICE_ATTR_RW(mem_limit);
 static DEVICE_ATTR_RW(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(idle);
+static DEVICE_ATTR_WO(recompress);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(writeback);
+#endif
 
 static ssize_t io_stat_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
@@ -1082,21 +1688,44 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8llu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
 			zram->limit_pages << PAGE_SHIFT,
 			max_used << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.zero_pages),
-			(u64)atomic64_read(&zram->stats.num_migrated));
+			(u64)atomic64_read(&zram->stats.num_migrated),
+			(u64)atomic64_read(&zram->stats.huge_pages));
 	up_read(&zram->init_lock);
 
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.bd_count) << PAGE_SHIFT,
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
 static DEVICE_ATTR_RO(io_stat);
 static DEVICE_ATTR_RO(mm_stat);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR_RO(bd_stat);
+#endif
 ZRAM_ATTR_RO(num_reads);
 ZRAM_ATTR_RO(num_writes);
 ZRAM_ATTR_RO(failed_reads);
@@ -1110,6 +1739,7 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
 	&dev_attr_initstate.attr,
 	&dev_attr_reset.attr,
+	&dev_attr_compact.attr,
 	&dev_attr_num_reads.attr,
 	&dev_attr_num_writes.attr,
 	&dev_attr_failed_reads.attr,
@@ -1124,6 +1754,14 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_recompress.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_stat.attr,
+#endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
 	NULL,
@@ -68,6 +68,11 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO = ZRAM_FLAG_SHIFT,
 	ZRAM_ACCESS,	/* page is now accessed */
+	ZRAM_WB,	/* page is stored on the backing device */
+	ZRAM_HUGE,	/* incompressible page, stored as is */
+	ZRAM_IDLE,	/* not accessed since it was last marked idle */
+	ZRAM_RECOMP,	/* compressed with the secondary algorithm */
+	ZRAM_PENDING,	/* being recompressed or written back */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -92,6 +97,12 @@ struct zram_stats {
 	atomic64_t zero_pages;		/* no. of zero filled pages */
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
+	atomic64_t huge_pages;		/* no. of incompressible pages */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* no. of pages on the backing device */
+	atomic64_t bd_reads;		/* no. of reads from the backing device */
+	atomic64_t bd_writes;		/* no. of writes to the backing device */
+#endif
 };
 
 struct zram_meta {
@@ -102,6 +113,8 @@ struct zram_meta {
 struct zram {
 	struct zram_meta *meta;
 	struct zcomp *comp;
+	/* secondary algorithm for recompression, may be NULL */
+	struct zcomp *recomp;
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
 	struct rw_semaphore init_lock;
@@ -121,5 +134,13 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[10];
+	char recomp_compressor[10];
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct block_device *bdev;
+	char *backing_dev;
+	/* one bit per PAGE_SIZE block of bdev, bit 0 is never used */
+	unsigned long *bitmap;
+	unsigned long nr_pages;
+#endif
 };
 #endif
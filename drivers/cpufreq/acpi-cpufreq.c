@@ -479,6 +479,53 @@ out:
 	return result;
 }
 
+/*
+ * Only used for the MSR interfaces, on policies whose P-state can be set
+ * from any of its CPUs, so writing the MSR on this CPU is enough.
+ */
+static unsigned int acpi_cpufreq_fast_switch(struct cpufreq_policy *policy,
+					     unsigned int target_freq)
+{
+	struct acpi_cpufreq_data *data = per_cpu(acfreq_data, policy->cpu);
+	struct cpufreq_frequency_table *entry, *next;
+	struct acpi_processor_performance *perf;
+	unsigned int next_perf_state;
+	struct drv_cmd cmd;
+
+	if (unlikely(data == NULL ||
+	     data->acpi_data == NULL || data->freq_table == NULL))
+		return 0;
+
+	/* The table is sorted by decreasing frequency */
+	next = data->freq_table;
+	for (entry = data->freq_table;
+	     entry->frequency != CPUFREQ_TABLE_END; entry++) {
+		if (entry->frequency < target_freq)
+			break;
+		next = entry;
+	}
+
+	perf = data->acpi_data;
+	next_perf_state = next->driver_data;
+	if (perf->state == next_perf_state) {
+		if (unlikely(data->resume))
+			data->resume = 0;
+		else
+			return next->frequency;
+	}
+
+	cmd.type = data->cpu_feature;
+	if (data->cpu_feature == SYSTEM_INTEL_MSR_CAPABLE)
+		cmd.addr.msr.reg = MSR_IA32_PERF_CTL;
+	else
+		cmd.addr.msr.reg = MSR_AMD_PERF_CTL;
+	cmd.val = (u32) perf->states[next_perf_state].control;
+	do_drv_write(&cmd);
+
+	perf->state = next_perf_state;
+	return next->frequency;
+}
+
 static unsigned long
 acpi_cpufreq_guess_freq(struct acpi_cpufreq_data *data, unsigned int cpu)
 {
@@ -815,6 +862,17 @@ static int acpi_cpufreq_cpu_init(struct cpufreq_policy *policy)
 		break;
 	}
 
+	/*
+	 * The MSRs only affect the CPU they are written on, so fast switching
+	 * needs a policy that either covers a single CPU or lets any of its
+	 * CPUs set the P-state for all.  Strict mode reads the frequency back
+	 * from every CPU, which is too slow for the scheduler paths.
+	 */
+	if (data->cpu_feature != SYSTEM_IO_CAPABLE && !acpi_pstate_strict &&
+	    (!policy_is_shared(policy) ||
+	     policy->shared_type == CPUFREQ_SHARED_TYPE_ANY))
+		policy->fast_switch_possible = true;
+
 	/* notify BIOS that we exist */
 	acpi_processor_notify_smm(THIS_MODULE);
 
@@ -886,6 +944,7 @@ static struct freq_attr *acpi_cpufreq_attr[] = {
 static struct cpufreq_driver acpi_cpufreq_driver = {
 	.verify		= cpufreq_generic_frequency_table_verify,
 	.target_index	= acpi_cpufreq_target,
+	.fast_switch	= acpi_cpufreq_fast_switch,
 	.bios_limit	= acpi_processor_get_bios_limit,
 	.init		= acpi_cpufreq_cpu_init,
 	.exit		= acpi_cpufreq_cpu_exit,
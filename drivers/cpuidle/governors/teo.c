@@ -0,0 +1,365 @@
+/*
+ * teo.c - the timer events oriented (TEO) idle governor
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ *
+ * The next timer event is the one wakeup source that is known in
+ * advance, and on most systems it is also the most frequent one, so
+ * the time until the next timer event (the sleep length) is the
+ * starting point for picking an idle state.  What is left to guess is
+ * whether a non-timer wakeup will come in first.
+ *
+ * For that, every idle state keeps three decaying metrics:
+ *
+ *  hits	- the CPU was woken up by the timer, or close enough to it,
+ *		  while the sleep length fell into the range of the state
+ *		  (from its target residency to that of the next one)
+ *  misses	- the sleep length fell into the range of the state, but
+ *		  the CPU was woken up early, in the range of a shallower one
+ *  early_hits	- the CPU was woken up early, in the range of the state,
+ *		  regardless of the sleep length
+ *
+ * The candidate state is the deepest one the sleep length allows.  If
+ * its misses weigh more than its hits, early wakeups are the common
+ * case, and the state with the most early hits among the shallower
+ * ones is picked instead.  Recent early wakeups are also averaged and,
+ * if they are consistent, used to go shallower still.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <trace/events/power.h>
+
+/*
+ * The PULSE value is added to metrics when they grow and the DECAY_SHIFT
+ * value is used for decreasing metrics on a regular basis.
+ */
+#define PULSE		1024
+#define DECAY_SHIFT	3
+
+/* Number of the most recent idle duration values to take into consideration */
+#define INTERVALS	8
+
+#define TEO_TICK_USEC	(USEC_PER_SEC / HZ)
+
+struct teo_idle_state {
+	unsigned int early_hits;
+	unsigned int hits;
+	unsigned int misses;
+};
+
+struct teo_cpu {
+	unsigned int sleep_length_us;
+	unsigned int predicted_us;
+	int last_state;
+	int interval_idx;
+	unsigned int intervals[INTERVALS];
+	struct teo_idle_state states[CPUIDLE_STATE_MAX];
+};
+
+static DEFINE_PER_CPU(struct teo_cpu, teo_cpus);
+
+static bool teo_state_usable(struct cpuidle_driver *drv,
+			     struct cpuidle_device *dev, int i)
+{
+	return !drv->states[i].disabled && !dev->states_usage[i].disable;
+}
+
+/**
+ * teo_update - update the metrics after wakeup
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static void teo_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct teo_cpu *cpu_data = this_cpu_ptr(&teo_cpus);
+	unsigned int sleep_length_us = cpu_data->sleep_length_us;
+	int i, idx_hit = -1, idx_timer = -1;
+	unsigned int measured_us;
+
+	/*
+	 * The residency includes the exit latency, but the wakeup happened
+	 * when leaving the state started.  If the residency is below the
+	 * exit latency, the state was most likely never reached.
+	 */
+	measured_us = cpuidle_get_last_residency(dev);
+	if (measured_us > drv->states[cpu_data->last_state].exit_latency)
+		measured_us -= drv->states[cpu_data->last_state].exit_latency;
+	else
+		measured_us = 0;
+
+	/*
+	 * Decay the "early hits" metric for all of the states and find the
+	 * states matching the sleep length and the measured idle duration.
+	 */
+	for (i = 0; i < drv->state_count; i++) {
+		unsigned int early_hits = cpu_data->states[i].early_hits;
+
+		cpu_data->states[i].early_hits -= early_hits >> DECAY_SHIFT;
+
+		if (drv->states[i].target_residency <= sleep_length_us) {
+			idx_timer = i;
+			if (drv->states[i].target_residency <= measured_us)
+				idx_hit = i;
+		}
+	}
+
+	/*
+	 * Update the "hits" and "misses" data for the state matching the
+	 * sleep length.  If it matches the measured idle duration too, or
+	 * the wakeup came within a tick's worth of the timer, this is a
+	 * "hit", otherwise it is a "miss".
+	 */
+	if (idx_timer >= 0) {
+		unsigned int hits = cpu_data->states[idx_timer].hits;
+		unsigned int misses = cpu_data->states[idx_timer].misses;
+
+		hits -= hits >> DECAY_SHIFT;
+		misses -= misses >> DECAY_SHIFT;
+
+		if (idx_timer > idx_hit &&
+		    measured_us + TEO_TICK_USEC / 2 < sleep_length_us) {
+			misses += PULSE;
+			if (idx_hit >= 0)
+				cpu_data->states[idx_hit].early_hits += PULSE;
+		} else {
+			hits += PULSE;
+		}
+
+		cpu_data->states[idx_timer].misses = misses;
+		cpu_data->states[idx_timer].hits = hits;
+	}
+
+	/*
+	 * Save idle duration values corresponding to non-timer wakeups for
+	 * pattern detection.  Timer wakeups are recorded as UINT_MAX so that
+	 * they don't pull the average of the early wakeups up.
+	 */
+	if (measured_us + TEO_TICK_USEC / 2 < sleep_length_us)
+		cpu_data->intervals[cpu_data->interval_idx++] = measured_us;
+	else
+		cpu_data->intervals[cpu_data->interval_idx++] = UINT_MAX;
+
+	if (cpu_data->interval_idx >= INTERVALS)
+		cpu_data->interval_idx = 0;
+
+	trace_cpu_idle_prediction(dev->cpu, cpu_data->last_state,
+				  cpu_data->predicted_us, measured_us);
+}
+
+/**
+ * teo_find_shallower_state - find shallower idle state matching given duration
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ * @state_idx: index of the capping idle state
+ * @duration_us: idle duration value to match
+ */
+static int teo_find_shallower_state(struct cpuidle_driver *drv,
+				    struct cpuidle_device *dev, int state_idx,
+				    unsigned int duration_us)
+{
+	int i;
+
+	for (i = state_idx - 1; i >= 0; i--) {
+		if (!teo_state_usable(drv, dev, i))
+			continue;
+
+		state_idx = i;
+		if (drv->states[i].target_residency <= duration_us)
+			break;
+	}
+	return state_idx;
+}
+
+/**
+ * teo_select - select the next idle state to enter
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static int teo_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct teo_cpu *cpu_data = this_cpu_ptr(&teo_cpus);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int duration_us, hits, misses, early_hits;
+	int max_early_idx, idx, i;
+
+	if (cpu_data->last_state >= 0) {
+		teo_update(drv, dev);
+		cpu_data->last_state = -1;
+	}
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	duration_us = ktime_to_us(tick_nohz_get_sleep_length());
+	cpu_data->sleep_length_us = duration_us;
+
+	hits = 0;
+	misses = 0;
+	early_hits = 0;
+	max_early_idx = -1;
+	idx = -1;
+
+	for (i = 0; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+
+		if (!teo_state_usable(drv, dev, i)) {
+			/*
+			 * If the "early hits" metric of a disabled state is
+			 * greater than the current maximum, it should be taken
+			 * into account, because it would be a mistake to select
+			 * a deeper state with lower "early hits" metric.  The
+			 * index cannot be changed to point to it, however, so
+			 * just increase the max count alone and let the index
+			 * still point to a shallower idle state.
+			 */
+			if (max_early_idx >= 0 &&
+			    early_hits < cpu_data->states[i].early_hits)
+				early_hits = cpu_data->states[i].early_hits;
+
+			continue;
+		}
+
+		if (idx < 0)
+			idx = i; /* first enabled state */
+
+		if (s->target_residency > duration_us)
+			break;
+
+		if (s->exit_latency > latency_req) {
+			/*
+			 * If we break out of the loop for latency reasons, use
+			 * the target residency of the selected state as the
+			 * expected idle duration.
+			 */
+			duration_us = drv->states[idx].target_residency;
+			goto refine;
+		}
+
+		idx = i;
+		hits = cpu_data->states[i].hits;
+		misses = cpu_data->states[i].misses;
+
+		if (early_hits < cpu_data->states[i].early_hits &&
+		    !(tick_nohz_tick_stopped() &&
+		      drv->states[i].target_residency < TEO_TICK_USEC)) {
+			early_hits = cpu_data->states[i].early_hits;
+			max_early_idx = i;
+		}
+	}
+
+	/*
+	 * If the "hits" metric of the idle state matching the sleep length is
+	 * greater than its "misses" metric, that is the one to use.  Otherwise,
+	 * it is more likely that one of the shallower states will match the
+	 * idle duration observed after wakeup, so take the one with the maximum
+	 * "early hits" metric, but if that cannot be determined, just use the
+	 * state selected so far.
+	 */
+	if (hits <= misses && max_early_idx >= 0) {
+		idx = max_early_idx;
+		duration_us = drv->states[idx].target_residency;
+	}
+
+refine:
+	if (idx < 0) {
+		idx = 0; /* No states enabled. Must use 0. */
+	} else if (idx > 0) {
+		u64 sum = 0;
+		int count = 0;
+
+		/*
+		 * Count and sum the most recent idle duration values less than
+		 * the current expected idle duration value.
+		 */
+		for (i = 0; i < INTERVALS; i++) {
+			unsigned int val = cpu_data->intervals[i];
+
+			if (val >= duration_us)
+				continue;
+
+			count++;
+			sum += val;
+		}
+
+		/*
+		 * Give up unless the majority of the most recent idle duration
+		 * values are in the interesting range.
+		 */
+		if (count > INTERVALS / 2) {
+			unsigned int avg_us = div64_u64(sum, count);
+
+			/*
+			 * Avoid spending too much time in an idle state that
+			 * would be too shallow.
+			 */
+			if (!(tick_nohz_tick_stopped() && avg_us < TEO_TICK_USEC)) {
+				idx = teo_find_shallower_state(drv, dev, idx, avg_us);
+				duration_us = avg_us;
+			}
+		}
+	}
+
+	cpu_data->predicted_us = duration_us;
+	return idx;
+}
+
+/**
+ * teo_reflect - note that governor data for the CPU need to be updated
+ * @dev: the CPU
+ * @state: index of the idle state entered by the CPU
+ */
+static void teo_reflect(struct cpuidle_device *dev, int state)
+{
+	struct teo_cpu *cpu_data = this_cpu_ptr(&teo_cpus);
+
+	cpu_data->last_state = state;
+}
+
+/**
+ * teo_enable_device - initialize the governor's data for the target CPU
+ * @drv: cpuidle driver (not used)
+ * @dev: the CPU
+ */
+static int teo_enable_device(struct cpuidle_driver *drv,
+			     struct cpuidle_device *dev)
+{
+	struct teo_cpu *cpu_data = &per_cpu(teo_cpus, dev->cpu);
+	int i;
+
+	memset(cpu_data, 0, sizeof(*cpu_data));
+	cpu_data->last_state = -1;
+
+	for (i = 0; i < INTERVALS; i++)
+		cpu_data->intervals[i] = UINT_MAX;
+
+	return 0;
+}
+
+static struct cpuidle_governor teo_governor = {
+	.name =		"teo",
+	.rating =	19,
+	.enable =	teo_enable_device,
+	.select =	teo_select,
+	.reflect =	teo_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * teo_governor_init - initializes the governor
+ */
+static int __init teo_governor_init(void)
+{
+	return cpuidle_register_governor(&teo_governor);
+}
+
+postcore_initcall(teo_governor_init);
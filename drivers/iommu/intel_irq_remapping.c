@@ -191,8 +191,24 @@ static int modify_irte(int irq, struct irte *irte_modified)
 	index = irq_iommu->irte_index + irq_iommu->sub_handle;
 	irte = &iommu->ir_table->base[index];
 
-	set_64bit(&irte->low, irte_modified->low);
-	set_64bit(&irte->high, irte_modified->high);
+#ifdef CONFIG_X86_64
+	/*
+	 * A posted IRTE carries the descriptor address in both halves, so
+	 * the hardware must never see a half-updated entry.
+	 */
+	if (irte->pst || irte_modified->pst) {
+		bool ret;
+
+		ret = cmpxchg_double(&irte->low, &irte->high,
+				     irte->low, irte->high,
+				     irte_modified->low, irte_modified->high);
+		WARN_ON(!ret);
+	} else
+#endif
+	{
+		set_64bit(&irte->low, irte_modified->low);
+		set_64bit(&irte->high, irte_modified->high);
+	}
 	__iommu_flush_cache(iommu, irte, sizeof(*irte));
 
 	rc = qi_flush_iec(iommu, index, 0);
@@ -274,6 +290,7 @@ static int free_irte(int irq)
 	irq_iommu->irte_index = 0;
 	irq_iommu->sub_handle = 0;
 	irq_iommu->irte_mask = 0;
+	irq_iommu->posted = 0;
 
 	raw_spin_unlock_irqrestore(&irq_2_ir_lock, flags);
 
@@ -705,6 +722,21 @@ static int __init intel_enable_irq_remapping(void)
 
 	irq_remapping_enabled = 1;
 
+	/*
+	 * Posted interrupts need every remapping unit to support them, and
+	 * a 128-bit cmpxchg to switch IRTEs in and out of posted format.
+	 */
+	if (!disable_irq_post && IS_ENABLED(CONFIG_X86_64) &&
+	    boot_cpu_has(X86_FEATURE_CX16)) {
+		intel_irq_remap_ops.capability |= 1 << IRQ_POSTING_CAP;
+		for_each_iommu(iommu, drhd)
+			if (!cap_pi_support(iommu->cap)) {
+				intel_irq_remap_ops.capability &=
+						~(1 << IRQ_POSTING_CAP);
+				break;
+			}
+	}
+
 	/*
 	 * VT-d has a different layout for IO-APIC entries when
 	 * interrupt remapping is enabled. So it needs a special routine
@@ -1082,14 +1114,17 @@ intel_ioapic_set_affinity(struct irq_data *data, const struct cpumask *mask,
 		return err;
 	}
 
-	irte.vector = cfg->vector;
-	irte.dest_id = IRTE_DEST(dest);
-
 	/*
 	 * Atomically updates the IRTE with the new destination, vector
-	 * and flushes the interrupt entry cache.
+	 * and flushes the interrupt entry cache.  A posted IRTE follows its
+	 * vcpu instead; the new host vector and destination get picked up
+	 * when the irq is handed back to the host.
 	 */
-	modify_irte(irq, &irte);
+	if (!irq_2_iommu(irq)->posted) {
+		irte.vector = cfg->vector;
+		irte.dest_id = IRTE_DEST(dest);
+		modify_irte(irq, &irte);
+	}
 
 	/*
 	 * After this point, all the interrupts will start arriving
@@ -1135,6 +1170,59 @@ static void intel_compose_msi_msg(struct pci_dev *pdev,
 			  MSI_ADDR_IR_INDEX2(ir_index);
 }
 
+/*
+ * Switch the IRTE of @irq to posted format, so that the remapping hardware
+ * records the interrupt in the vcpu's posted-interrupt descriptor and
+ * notifies the cpu the vcpu runs on, without the host ever taking it.
+ * With @vcpu_pi_info NULL, rebuild the remapped IRTE from the host vector
+ * and affinity of the irq.
+ */
+static int intel_ir_set_vcpu_affinity(int irq, struct vcpu_data *vcpu_pi_info)
+{
+	struct irq_2_iommu *irq_iommu = irq_2_iommu(irq);
+	struct irq_data *data = irq_get_irq_data(irq);
+	struct irq_cfg *cfg = irq_cfg(irq);
+	struct irte irte, new;
+	unsigned int dest;
+	int err;
+
+	if (!irq_iommu || !data || get_irte(irq, &irte))
+		return -EBUSY;
+
+	if (vcpu_pi_info) {
+		memset(&new, 0, sizeof(new));
+		new.p_present = 1;
+		new.p_pst = 1;
+		new.p_urgent = 0;
+		new.p_vector = vcpu_pi_info->vector;
+		new.pda_l = (vcpu_pi_info->pi_desc_addr >>
+			     (32 - PDA_LOW_BIT)) & ~(-1UL << PDA_LOW_BIT);
+		new.pda_h = (vcpu_pi_info->pi_desc_addr >> 32) &
+			    ~(-1UL << PDA_HIGH_BIT);
+	} else {
+		if (!irq_iommu->posted)
+			return 0;
+
+		err = apic->cpu_mask_to_apicid_and(cfg->domain,
+						   data->affinity, &dest);
+		if (err)
+			return err;
+
+		prepare_irte(&new, cfg->vector, dest);
+	}
+
+	/* Keep the source-id checks set up at allocation time */
+	new.svt = irte.svt;
+	new.sq = irte.sq;
+	new.sid = irte.sid;
+
+	err = modify_irte(irq, &new);
+	if (!err)
+		irq_iommu->posted = !!vcpu_pi_info;
+
+	return err;
+}
+
 /*
  * Map the PCI dev to the corresponding remapping hardware unit
  * and allocate 'nvec' consecutive interrupt-remapping table entries
@@ -1218,6 +1306,7 @@ struct irq_remap_ops intel_irq_remap_ops = {
 	.msi_alloc_irq		= intel_msi_alloc_irq,
 	.msi_setup_irq		= intel_msi_setup_irq,
 	.alloc_hpet_msi		= intel_alloc_hpet_msi,
+	.set_vcpu_affinity	= intel_ir_set_vcpu_affinity,
 };
 
 /*
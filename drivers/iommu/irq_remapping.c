@@ -3,6 +3,7 @@
 #include <linux/kernel.h>
 #include <linux/string.h>
 #include <linux/errno.h>
+#include <linux/export.h>
 #include <linux/msi.h>
 #include <linux/irq.h>
 #include <linux/pci.h>
@@ -20,6 +21,7 @@ int irq_remapping_enabled;
 int irq_remap_broken;
 int disable_sourceid_checking;
 int no_x2apic_optout;
+int disable_irq_post;
 
 static int disable_irq_remap;
 static struct irq_remap_ops *remap_ops;
@@ -183,6 +185,8 @@ static __init int setup_irqremap(char *str)
 			disable_sourceid_checking = 1;
 		else if (!strncmp(str, "no_x2apic_optout", 16))
 			no_x2apic_optout = 1;
+		else if (!strncmp(str, "nopost", 6))
+			disable_irq_post = 1;
 
 		str += strcspn(str, ",");
 		while (*str == ',')
@@ -326,6 +330,39 @@ int setup_hpet_msi_remapped(unsigned int irq, unsigned int id)
 	return default_setup_hpet_msi(irq, id);
 }
 
+bool irq_remapping_cap(enum irq_remap_cap cap)
+{
+	if (!remap_ops || !irq_remapping_enabled || disable_irq_post)
+		return false;
+
+	return (remap_ops->capability & (1 << cap));
+}
+EXPORT_SYMBOL_GPL(irq_remapping_cap);
+
+/*
+ * Deliver @irq straight into the posted-interrupt descriptor described by
+ * @vcpu_info, or return it to regular remapping if @vcpu_info is NULL.
+ */
+int irq_remapping_set_vcpu_affinity(int irq, struct vcpu_data *vcpu_info)
+{
+	struct irq_desc *desc = irq_to_desc(irq);
+	struct irq_cfg *cfg = irq_cfg(irq);
+	unsigned long flags;
+	int ret;
+
+	if (!desc || !cfg || !irq_remapped(cfg) ||
+	    !remap_ops->set_vcpu_affinity)
+		return -ENODEV;
+
+	/* Serializes against set_affinity, which runs under desc->lock */
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	ret = remap_ops->set_vcpu_affinity(irq, vcpu_info);
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(irq_remapping_set_vcpu_affinity);
+
 void panic_if_irq_remap(const char *msg)
 {
 	if (irq_remapping_enabled)
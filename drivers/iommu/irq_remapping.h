@@ -30,13 +30,18 @@ struct irq_data;
 struct cpumask;
 struct pci_dev;
 struct msi_msg;
+struct vcpu_data;
 
 extern int irq_remap_broken;
 extern int disable_sourceid_checking;
 extern int no_x2apic_optout;
 extern int irq_remapping_enabled;
+extern int disable_irq_post;
 
 struct irq_remap_ops {
+	/* The supported capabilities, bitmask of enum irq_remap_cap */
+	int capability;
+
 	/* Initializes hardware and makes it ready for remapping interrupts */
 	int  (*prepare)(void);
 
@@ -77,6 +82,9 @@ struct irq_remap_ops {
 
 	/* Setup interrupt remapping for an HPET MSI */
 	int (*alloc_hpet_msi)(unsigned int, unsigned int);
+
+	/* Post a remapped irq to a vcpu, or stop posting if vcpu_data is NULL */
+	int (*set_vcpu_affinity)(int irq, struct vcpu_data *);
 };
 
 extern struct irq_remap_ops intel_irq_remap_ops;
@@ -0,0 +1,1378 @@
+/*
+ * This file is released under the GPL.
+ */
+
+#include "dm-cache-policy.h"
+#include "dm.h"
+
+#include <linux/bitmap.h>
+#include <linux/hash.h>
+#include <linux/jiffies.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#define DM_MSG_PREFIX "cache-policy-smq"
+
+/*----------------------------------------------------------------*/
+
+/*
+ * The stochastic multiqueue policy.
+ *
+ * The mq policy keeps two large entries (pre-cache and cache) per cache
+ * block and promotes on hit counts, which costs a lot of memory on big
+ * caches and adapts slowly when the hot set moves.  smq instead:
+ *
+ *  - links entries by 28 bit indexes into an array rather than by
+ *    pointers, so an entry is 16 bytes plus its origin block;
+ *
+ *  - tracks hotness of the origin in a hotspot table.  A hotspot covers
+ *    several cache blocks and there are only a quarter as many hotspots
+ *    as cache blocks;
+ *
+ *  - keeps entries in multilevel queues that are regularly redistributed
+ *    so each level holds a similar number of entries, which makes the
+ *    level of an entry a measure of its rank;
+ *
+ *  - promotes only from hotspots above an adaptive level, and then
+ *    randomly with a probability that grows with the level, so a burst
+ *    of one-off hits does not churn the cache;
+ *
+ *  - bypasses large sequential streams the way bcache does.
+ */
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Safe division functions that return zero on divide by zero.
+ */
+static unsigned safe_div(unsigned n, unsigned d)
+{
+	return d ? n / d : 0u;
+}
+
+static unsigned safe_mod(unsigned n, unsigned d)
+{
+	return d ? n % d : 0u;
+}
+
+/*----------------------------------------------------------------*/
+
+struct entry {
+	unsigned hash_next:28;
+	unsigned prev:28;
+	unsigned next:28;
+	unsigned level:6;
+	unsigned dirty:1;
+	unsigned allocated:1;
+	dm_oblock_t oblock;
+};
+
+/*----------------------------------------------------------------*/
+
+#define INDEXER_NULL ((1u << 28u) - 1u)
+
+/*
+ * An entry_space manages a set of entries that we use for the queues.
+ * The clean and dirty queues share entries, so this object is separate
+ * from the queue itself.
+ */
+struct entry_space {
+	struct entry *begin;
+	struct entry *end;
+};
+
+static int space_init(struct entry_space *es, unsigned nr_entries)
+{
+	if (!nr_entries) {
+		es->begin = es->end = NULL;
+		return 0;
+	}
+
+	es->begin = vzalloc(sizeof(struct entry) * nr_entries);
+	if (!es->begin)
+		return -ENOMEM;
+
+	es->end = es->begin + nr_entries;
+	return 0;
+}
+
+static void space_exit(struct entry_space *es)
+{
+	vfree(es->begin);
+}
+
+static struct entry *__get_entry(struct entry_space *es, unsigned block)
+{
+	struct entry *e;
+
+	e = es->begin + block;
+	BUG_ON(e >= es->end);
+
+	return e;
+}
+
+static unsigned to_index(struct entry_space *es, struct entry *e)
+{
+	BUG_ON(e < es->begin || e >= es->end);
+	return e - es->begin;
+}
+
+static struct entry *to_entry(struct entry_space *es, unsigned block)
+{
+	if (block == INDEXER_NULL)
+		return NULL;
+
+	return __get_entry(es, block);
+}
+
+/*----------------------------------------------------------------*/
+
+struct ilist {
+	unsigned nr_elts;
+	unsigned head, tail;
+};
+
+static void l_init(struct ilist *l)
+{
+	l->nr_elts = 0;
+	l->head = l->tail = INDEXER_NULL;
+}
+
+static struct entry *l_head(struct entry_space *es, struct ilist *l)
+{
+	return to_entry(es, l->head);
+}
+
+static struct entry *l_tail(struct entry_space *es, struct ilist *l)
+{
+	return to_entry(es, l->tail);
+}
+
+static struct entry *l_next(struct entry_space *es, struct entry *e)
+{
+	return to_entry(es, e->next);
+}
+
+static bool l_empty(struct ilist *l)
+{
+	return l->head == INDEXER_NULL;
+}
+
+static void l_add_head(struct entry_space *es, struct ilist *l, struct entry *e)
+{
+	struct entry *head = l_head(es, l);
+
+	e->next = l->head;
+	e->prev = INDEXER_NULL;
+
+	if (head)
+		head->prev = l->head = to_index(es, e);
+	else
+		l->head = l->tail = to_index(es, e);
+
+	l->nr_elts++;
+}
+
+static void l_add_tail(struct entry_space *es, struct ilist *l, struct entry *e)
+{
+	struct entry *tail = l_tail(es, l);
+
+	e->next = INDEXER_NULL;
+	e->prev = l->tail;
+
+	if (tail)
+		tail->next = l->tail = to_index(es, e);
+	else
+		l->head = l->tail = to_index(es, e);
+
+	l->nr_elts++;
+}
+
+static void l_del(struct entry_space *es, struct ilist *l, struct entry *e)
+{
+	struct entry *prev = to_entry(es, e->prev);
+	struct entry *next = to_entry(es, e->next);
+
+	if (prev)
+		prev->next = e->next;
+	else
+		l->head = e->next;
+
+	if (next)
+		next->prev = e->prev;
+	else
+		l->tail = e->prev;
+
+	l->nr_elts--;
+}
+
+static struct entry *l_pop_head(struct entry_space *es, struct ilist *l)
+{
+	struct entry *e = l_head(es, l);
+
+	if (e)
+		l_del(es, l, e);
+
+	return e;
+}
+
+static struct entry *l_pop_tail(struct entry_space *es, struct ilist *l)
+{
+	struct entry *e = l_tail(es, l);
+
+	if (e)
+		l_del(es, l, e);
+
+	return e;
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * The stochastic-multi-queue is a set of lru lists stacked into levels.
+ * Entries are moved up levels when they are used, which loosely orders
+ * the most accessed entries in the top levels and least in the bottom.
+ * This structure is *much* better than a single lru list.
+ */
+#define MAX_LEVELS 64u
+
+struct queue {
+	struct entry_space *es;
+
+	unsigned nr_elts;
+	unsigned nr_levels;
+	struct ilist qs[MAX_LEVELS];
+};
+
+static void q_init(struct queue *q, struct entry_space *es, unsigned nr_levels)
+{
+	unsigned i;
+
+	q->es = es;
+	q->nr_elts = 0;
+	q->nr_levels = nr_levels;
+
+	for (i = 0; i < q->nr_levels; i++)
+		l_init(q->qs + i);
+}
+
+static unsigned q_size(struct queue *q)
+{
+	return q->nr_elts;
+}
+
+/*
+ * Insert an entry to the back of the given level.
+ */
+static void q_push(struct queue *q, struct entry *e)
+{
+	q->nr_elts++;
+	l_add_tail(q->es, q->qs + e->level, e);
+}
+
+static void q_del(struct queue *q, struct entry *e)
+{
+	l_del(q->es, q->qs + e->level, e);
+	q->nr_elts--;
+}
+
+/*
+ * Return the oldest entry of the lowest populated level below max_level.
+ */
+static struct entry *q_peek(struct queue *q, unsigned max_level)
+{
+	unsigned level;
+
+	max_level = min(max_level, q->nr_levels);
+
+	for (level = 0; level < max_level; level++)
+		if (!l_empty(q->qs + level))
+			return l_head(q->es, q->qs + level);
+
+	return NULL;
+}
+
+static struct entry *q_pop(struct queue *q)
+{
+	struct entry *e = q_peek(q, q->nr_levels);
+
+	if (e)
+		q_del(q, e);
+
+	return e;
+}
+
+/*
+ * Move an entry up some levels, it has been used.
+ */
+static void q_requeue(struct queue *q, struct entry *e, unsigned extra_levels)
+{
+	q_del(q, e);
+	e->level = min(e->level + extra_levels, q->nr_levels - 1u);
+	q_push(q, e);
+}
+
+/*
+ * Pops the oldest entry of the lowest populated level at or above @level.
+ */
+static struct entry *__redist_pop_from(struct queue *q, unsigned level)
+{
+	struct entry *e;
+
+	for (; level < q->nr_levels; level++) {
+		e = l_pop_head(q->es, q->qs + level);
+		if (e)
+			return e;
+	}
+
+	return NULL;
+}
+
+/*
+ * Rebalance the queue so that each level holds about the same number of
+ * entries, with any remainder going to the top levels.  Levels then rank
+ * entries by how recently and often they were used.
+ */
+static void q_redistribute(struct queue *q)
+{
+	unsigned target, remainder, level;
+	struct ilist *l, *l_above;
+	struct entry *e;
+
+	target = safe_div(q->nr_elts, q->nr_levels);
+	remainder = safe_mod(q->nr_elts, q->nr_levels);
+
+	for (level = 0u; level < q->nr_levels - 1u; level++) {
+		unsigned t = target + (level >= q->nr_levels - remainder);
+
+		l = q->qs + level;
+		l_above = q->qs + level + 1u;
+
+		/* pull down the coldest entries from the levels above */
+		while (l->nr_elts < t) {
+			e = __redist_pop_from(q, level + 1u);
+			if (!e)
+				break;
+
+			e->level = level;
+			l_add_tail(q->es, l, e);
+		}
+
+		/* push the hottest entries of this level up */
+		while (l->nr_elts > t) {
+			e = l_pop_tail(q->es, l);
+			if (!e)
+				break;
+
+			e->level = level + 1u;
+			l_add_head(q->es, l_above, e);
+		}
+	}
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * All cache entries are stored in a chained hash table.  To save space we
+ * use indexing again, and only store indexes to the next entry.
+ */
+struct smq_hash_table {
+	struct entry_space *es;
+	unsigned long long hash_bits;
+	unsigned *buckets;
+};
+
+static int h_init(struct smq_hash_table *ht, struct entry_space *es,
+		  unsigned nr_entries)
+{
+	unsigned i, nr_buckets;
+
+	ht->es = es;
+	nr_buckets = roundup_pow_of_two(max(nr_entries / 4u, 16u));
+	ht->hash_bits = ffs(nr_buckets) - 1;
+
+	ht->buckets = vmalloc(sizeof(*ht->buckets) * nr_buckets);
+	if (!ht->buckets)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_buckets; i++)
+		ht->buckets[i] = INDEXER_NULL;
+
+	return 0;
+}
+
+static void h_exit(struct smq_hash_table *ht)
+{
+	vfree(ht->buckets);
+}
+
+static struct entry *h_head(struct smq_hash_table *ht, unsigned bucket)
+{
+	return to_entry(ht->es, ht->buckets[bucket]);
+}
+
+static struct entry *h_next(struct smq_hash_table *ht, struct entry *e)
+{
+	return to_entry(ht->es, e->hash_next);
+}
+
+static void __h_insert(struct smq_hash_table *ht, unsigned bucket, struct entry *e)
+{
+	e->hash_next = ht->buckets[bucket];
+	ht->buckets[bucket] = to_index(ht->es, e);
+}
+
+static void h_insert(struct smq_hash_table *ht, struct entry *e)
+{
+	unsigned h = hash_64(from_oblock(e->oblock), ht->hash_bits);
+
+	__h_insert(ht, h, e);
+}
+
+static struct entry *__h_lookup(struct smq_hash_table *ht, unsigned h,
+				dm_oblock_t oblock, struct entry **prev)
+{
+	struct entry *e;
+
+	*prev = NULL;
+	for (e = h_head(ht, h); e; e = h_next(ht, e)) {
+		if (e->oblock == oblock)
+			return e;
+
+		*prev = e;
+	}
+
+	return NULL;
+}
+
+static void __h_unlink(struct smq_hash_table *ht, unsigned h,
+		       struct entry *e, struct entry *prev)
+{
+	if (prev)
+		prev->hash_next = e->hash_next;
+	else
+		ht->buckets[h] = e->hash_next;
+}
+
+/*
+ * Also moves each entry to the front of the bucket.
+ */
+static struct entry *h_lookup(struct smq_hash_table *ht, dm_oblock_t oblock)
+{
+	struct entry *e, *prev;
+	unsigned h = hash_64(from_oblock(oblock), ht->hash_bits);
+
+	e = __h_lookup(ht, h, oblock, &prev);
+	if (e && prev) {
+		/*
+		 * Move to the front because this entry is likely
+		 * to be hit again.
+		 */
+		__h_unlink(ht, h, e, prev);
+		__h_insert(ht, h, e);
+	}
+
+	return e;
+}
+
+static void h_remove(struct smq_hash_table *ht, struct entry *e)
+{
+	unsigned h = hash_64(from_oblock(e->oblock), ht->hash_bits);
+	struct entry *prev;
+
+	/*
+	 * The down side of using a singly linked list is we have to
+	 * iterate the bucket to remove an item.
+	 */
+	e = __h_lookup(ht, h, e->oblock, &prev);
+	if (e)
+		__h_unlink(ht, h, e, prev);
+}
+
+/*----------------------------------------------------------------*/
+
+struct entry_alloc {
+	struct entry_space *es;
+	unsigned nr_allocated;
+	struct ilist free;
+};
+
+static void init_allocator(struct entry_alloc *ea, struct entry_space *es,
+			   unsigned nr_entries)
+{
+	unsigned i;
+
+	ea->es = es;
+	ea->nr_allocated = 0u;
+
+	l_init(&ea->free);
+	for (i = 0; i < nr_entries; i++)
+		l_add_tail(ea->es, &ea->free, __get_entry(ea->es, i));
+}
+
+static void init_entry(struct entry *e)
+{
+	e->hash_next = INDEXER_NULL;
+	e->next = INDEXER_NULL;
+	e->prev = INDEXER_NULL;
+	e->level = 0u;
+	e->dirty = false;
+	e->allocated = true;
+}
+
+static struct entry *alloc_entry(struct entry_alloc *ea)
+{
+	struct entry *e;
+
+	if (l_empty(&ea->free))
+		return NULL;
+
+	e = l_pop_head(ea->es, &ea->free);
+	init_entry(e);
+	ea->nr_allocated++;
+
+	return e;
+}
+
+/*
+ * This assumes the cblock hasn't already been allocated.
+ */
+static struct entry *alloc_particular_entry(struct entry_alloc *ea, unsigned i)
+{
+	struct entry *e = __get_entry(ea->es, i);
+
+	BUG_ON(e->allocated);
+
+	l_del(ea->es, &ea->free, e);
+	init_entry(e);
+	ea->nr_allocated++;
+
+	return e;
+}
+
+static void free_entry(struct entry_alloc *ea, struct entry *e)
+{
+	BUG_ON(!ea->nr_allocated);
+	BUG_ON(!e->allocated);
+
+	ea->nr_allocated--;
+	e->allocated = false;
+	l_add_tail(ea->es, &ea->free, e);
+}
+
+static bool allocator_empty(struct entry_alloc *ea)
+{
+	return l_empty(&ea->free);
+}
+
+static unsigned get_index(struct entry_alloc *ea, struct entry *e)
+{
+	return to_index(ea->es, e);
+}
+
+static struct entry *get_entry(struct entry_alloc *ea, unsigned index)
+{
+	return __get_entry(ea->es, index);
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Large, sequential ios are probably better left on the origin device
+ * since spindles tend to have good bandwidth.
+ *
+ * Like bcache, the io_tracker follows a handful of recent streams and
+ * bypasses the cache once one of them has been sequential for more than
+ * sequential_cutoff sectors.  Several interleaved sequential readers are
+ * thus all spotted, unlike with a single global tracker.
+ */
+#define NR_STREAMS 16u
+#define SEQUENTIAL_CUTOFF_DEFAULT (4u << (20 - SECTOR_SHIFT))	/* 4MiB */
+
+struct io_stream {
+	sector_t last_end;
+	sector_t sequential;
+};
+
+struct io_tracker {
+	unsigned next_stream;
+	sector_t sequential_cutoff;
+	struct io_stream streams[NR_STREAMS];
+};
+
+static void iot_init(struct io_tracker *t, sector_t sequential_cutoff)
+{
+	memset(t, 0, sizeof(*t));
+	t->sequential_cutoff = sequential_cutoff;
+}
+
+static bool iot_sequential(struct io_tracker *t, struct bio *bio)
+{
+	sector_t sector = bio->bi_iter.bi_sector;
+	struct io_stream *s;
+	unsigned i;
+
+	for (i = 0; i < NR_STREAMS; i++) {
+		s = t->streams + i;
+		if (s->sequential && s->last_end == sector)
+			goto found;
+	}
+
+	/* a new stream replaces the one that was started longest ago */
+	s = t->streams + t->next_stream;
+	t->next_stream = (t->next_stream + 1u) % NR_STREAMS;
+	s->sequential = 0;
+
+found:
+	s->sequential += bio_sectors(bio);
+	s->last_end = bio_end_sector(bio);
+
+	return t->sequential_cutoff && s->sequential >= t->sequential_cutoff;
+}
+
+/*----------------------------------------------------------------*/
+
+#define NR_HOTSPOT_LEVELS 64u
+#define NR_CACHE_LEVELS 64u
+
+/* Hits are only counted once per entry in each hit period */
+#define HIT_PERIOD (HZ / 10)
+#define PROMOTE_PERIOD HZ
+
+#define DEFAULT_WRITE_PROMOTE_ADJUSTMENT 4u
+#define MIN_PROMOTE_LEVEL (NR_HOTSPOT_LEVELS / 4u)
+#define DEFAULT_PROMOTE_LEVEL (NR_HOTSPOT_LEVELS * 3u / 4u)
+
+#define CLEAN_TARGET_PERCENTAGE 25u
+
+struct smq_policy {
+	struct dm_cache_policy policy;
+
+	/* protects everything */
+	struct mutex lock;
+	dm_cblock_t cache_size;
+	sector_t cache_block_size;
+
+	sector_t hotspot_block_size;
+	unsigned nr_hotspot_blocks;
+	unsigned cache_blocks_per_hotspot_block;
+	unsigned hotspot_level_jump;
+
+	struct entry_space cache_es;
+	struct entry_space hotspot_es;
+	struct entry_alloc cache_alloc;
+	struct entry_alloc hotspot_alloc;
+
+	unsigned long *cache_hit_bits;
+	unsigned long *hotspot_hit_bits;
+
+	/*
+	 * The hotspot queue ranks regions of the origin, which may or may
+	 * not be in the cache.  The clean and dirty queues hold the
+	 * entries of the cache proper.
+	 */
+	struct queue hotspot;
+	struct queue clean;
+	struct queue dirty;
+
+	struct smq_hash_table table;
+	struct smq_hash_table hotspot_table;
+
+	struct io_tracker tracker;
+
+	/*
+	 * Hotspots must have reached this level to be promoted.  It is
+	 * lowered when the cache misses a lot, so a moving hot set is
+	 * followed quickly, and raised when it hits well.
+	 */
+	unsigned promote_level;
+	unsigned write_promote_adjustment;
+	unsigned hits;
+	unsigned misses;
+
+	unsigned long next_hit_period;
+	unsigned long next_promote_period;
+};
+
+/*----------------------------------------------------------------*/
+
+static struct queue *cache_queue(struct smq_policy *mq, struct entry *e)
+{
+	return e->dirty ? &mq->dirty : &mq->clean;
+}
+
+static dm_cblock_t infer_cblock(struct smq_policy *mq, struct entry *e)
+{
+	return to_cblock(get_index(&mq->cache_alloc, e));
+}
+
+static void update_promote_level(struct smq_policy *mq)
+{
+	unsigned total = mq->hits + mq->misses;
+
+	if (total) {
+		if (mq->hits * 4u < total && mq->promote_level > MIN_PROMOTE_LEVEL)
+			mq->promote_level--;
+
+		else if (mq->hits * 4u > total * 3u &&
+			 mq->promote_level < NR_HOTSPOT_LEVELS - 1u)
+			mq->promote_level++;
+	}
+
+	mq->hits = mq->misses = 0;
+}
+
+static void end_periods(struct smq_policy *mq)
+{
+	if (time_after(jiffies, mq->next_hit_period)) {
+		bitmap_zero(mq->cache_hit_bits, from_cblock(mq->cache_size));
+		bitmap_zero(mq->hotspot_hit_bits, mq->nr_hotspot_blocks);
+
+		q_redistribute(&mq->hotspot);
+		q_redistribute(&mq->clean);
+		q_redistribute(&mq->dirty);
+
+		mq->next_hit_period = jiffies + HIT_PERIOD;
+	}
+
+	if (time_after(jiffies, mq->next_promote_period)) {
+		update_promote_level(mq);
+		mq->next_promote_period = jiffies + PROMOTE_PERIOD;
+	}
+}
+
+static void requeue(struct smq_policy *mq, struct entry *e)
+{
+	if (!test_and_set_bit(get_index(&mq->cache_alloc, e), mq->cache_hit_bits))
+		q_requeue(cache_queue(mq, e), e, 1u);
+}
+
+static struct entry *update_hotspot_queue(struct smq_policy *mq, dm_oblock_t b)
+{
+	unsigned hb = from_oblock(b) / mq->cache_blocks_per_hotspot_block;
+	struct entry *e = h_lookup(&mq->hotspot_table, to_oblock(hb));
+
+	if (e) {
+		if (!test_and_set_bit(get_index(&mq->hotspot_alloc, e),
+				      mq->hotspot_hit_bits))
+			q_requeue(&mq->hotspot, e, mq->hotspot_level_jump);
+		return e;
+	}
+
+	if (allocator_empty(&mq->hotspot_alloc)) {
+		/* recycle the coldest hotspot */
+		e = q_pop(&mq->hotspot);
+		h_remove(&mq->hotspot_table, e);
+		clear_bit(get_index(&mq->hotspot_alloc, e), mq->hotspot_hit_bits);
+		init_entry(e);
+	} else
+		e = alloc_entry(&mq->hotspot_alloc);
+
+	e->oblock = to_oblock(hb);
+	q_push(&mq->hotspot, e);
+	h_insert(&mq->hotspot_table, e);
+
+	return e;
+}
+
+/*
+ * The promotion decision.  While there are free cache blocks everything
+ * is promoted.  After that only hotspots at or above the promote level
+ * are, and then with a probability that rises from level to level, so
+ * the first few hits on a cooling block rarely displace a hot one.
+ */
+static bool should_promote(struct smq_policy *mq, struct entry *hs_e,
+			   int data_dir)
+{
+	unsigned level = mq->promote_level;
+
+	if (!allocator_empty(&mq->cache_alloc))
+		return true;
+
+	if (data_dir == WRITE)
+		level = min(level + mq->write_promote_adjustment,
+			    NR_HOTSPOT_LEVELS - 1u);
+
+	if (hs_e->level < level)
+		return false;
+
+	return prandom_u32_max(NR_HOTSPOT_LEVELS - level + 1u) <=
+		hs_e->level - level;
+}
+
+static int insert_in_cache(struct smq_policy *mq, dm_oblock_t oblock,
+			   struct policy_result *result)
+{
+	struct entry *e;
+
+	if (allocator_empty(&mq->cache_alloc)) {
+		/* dirty blocks are never demoted, they're written back first */
+		e = q_pop(&mq->clean);
+		if (!e)
+			return -ENOSPC;
+
+		result->op = POLICY_REPLACE;
+		result->old_oblock = e->oblock;
+		h_remove(&mq->table, e);
+		clear_bit(get_index(&mq->cache_alloc, e), mq->cache_hit_bits);
+		init_entry(e);
+	} else {
+		e = alloc_entry(&mq->cache_alloc);
+		result->op = POLICY_NEW;
+	}
+
+	e->oblock = oblock;
+	q_push(&mq->clean, e);
+	h_insert(&mq->table, e);
+
+	result->cblock = infer_cblock(mq, e);
+
+	return 0;
+}
+
+static int map(struct smq_policy *mq, struct bio *bio, dm_oblock_t oblock,
+	       bool can_migrate, bool discarded_oblock,
+	       struct policy_result *result)
+{
+	struct entry *e, *hs_e;
+	bool sequential = iot_sequential(&mq->tracker, bio);
+
+	e = h_lookup(&mq->table, oblock);
+	if (e) {
+		mq->hits++;
+		requeue(mq, e);
+		result->op = POLICY_HIT;
+		result->cblock = infer_cblock(mq, e);
+		return 0;
+	}
+
+	result->op = POLICY_MISS;
+
+	/*
+	 * Sequential io still warms the hotspots, so a region that is
+	 * later read randomly isn't starting from cold.
+	 */
+	hs_e = update_hotspot_queue(mq, oblock);
+	if (sequential)
+		return 0;
+
+	mq->misses++;
+
+	if (!should_promote(mq, hs_e, bio_data_dir(bio)))
+		return 0;
+
+	if (!can_migrate)
+		return -EWOULDBLOCK;
+
+	if (insert_in_cache(mq, oblock, result))
+		result->op = POLICY_MISS;
+
+	return 0;
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Public interface, via the policy struct.  See dm-cache-policy.h for a
+ * description of these.
+ */
+
+static struct smq_policy *to_smq_policy(struct dm_cache_policy *p)
+{
+	return container_of(p, struct smq_policy, policy);
+}
+
+static void smq_destroy(struct dm_cache_policy *p)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+
+	h_exit(&mq->hotspot_table);
+	h_exit(&mq->table);
+	vfree(mq->hotspot_hit_bits);
+	vfree(mq->cache_hit_bits);
+	space_exit(&mq->hotspot_es);
+	space_exit(&mq->cache_es);
+	kfree(mq);
+}
+
+static int smq_map(struct dm_cache_policy *p, dm_oblock_t oblock,
+		   bool can_block, bool can_migrate, bool discarded_oblock,
+		   struct bio *bio, struct policy_result *result)
+{
+	int r;
+	struct smq_policy *mq = to_smq_policy(p);
+
+	result->op = POLICY_MISS;
+
+	if (can_block)
+		mutex_lock(&mq->lock);
+	else if (!mutex_trylock(&mq->lock))
+		return -EWOULDBLOCK;
+
+	end_periods(mq);
+	r = map(mq, bio, oblock, can_migrate, discarded_oblock, result);
+
+	mutex_unlock(&mq->lock);
+
+	return r;
+}
+
+static int smq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t *cblock)
+{
+	int r;
+	struct smq_policy *mq = to_smq_policy(p);
+	struct entry *e;
+
+	if (!mutex_trylock(&mq->lock))
+		return -EWOULDBLOCK;
+
+	e = h_lookup(&mq->table, oblock);
+	if (e) {
+		*cblock = infer_cblock(mq, e);
+		r = 0;
+	} else
+		r = -ENOENT;
+
+	mutex_unlock(&mq->lock);
+
+	return r;
+}
+
+static void __smq_set_clear_dirty(struct smq_policy *mq, dm_oblock_t oblock, bool set)
+{
+	struct entry *e;
+
+	e = h_lookup(&mq->table, oblock);
+	BUG_ON(!e);
+
+	q_del(cache_queue(mq, e), e);
+	e->dirty = set;
+	q_push(cache_queue(mq, e), e);
+}
+
+static void smq_set_dirty(struct dm_cache_policy *p, dm_oblock_t oblock)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+
+	mutex_lock(&mq->lock);
+	__smq_set_clear_dirty(mq, oblock, true);
+	mutex_unlock(&mq->lock);
+}
+
+static void smq_clear_dirty(struct dm_cache_policy *p, dm_oblock_t oblock)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+
+	mutex_lock(&mq->lock);
+	__smq_set_clear_dirty(mq, oblock, false);
+	mutex_unlock(&mq->lock);
+}
+
+static int smq_load_mapping(struct dm_cache_policy *p,
+			    dm_oblock_t oblock, dm_cblock_t cblock,
+			    uint32_t hint, bool hint_valid)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+	struct entry *e;
+
+	e = alloc_particular_entry(&mq->cache_alloc, from_cblock(cblock));
+	e->oblock = oblock;
+	e->dirty = false;	/* this gets corrected in a minute */
+	e->level = hint_valid ? min(hint, NR_CACHE_LEVELS - 1u) : 1u;
+	q_push(&mq->clean, e);
+	h_insert(&mq->table, e);
+
+	return 0;
+}
+
+static int smq_save_hints(struct smq_policy *mq, struct queue *q,
+			  policy_walk_fn fn, void *context)
+{
+	int r;
+	unsigned level;
+	struct entry *e;
+
+	for (level = 0; level < q->nr_levels; level++)
+		for (e = l_head(q->es, q->qs + level); e; e = l_next(q->es, e)) {
+			r = fn(context, infer_cblock(mq, e),
+			       e->oblock, e->level);
+			if (r)
+				return r;
+		}
+
+	return 0;
+}
+
+static int smq_walk_mappings(struct dm_cache_policy *p, policy_walk_fn fn,
+			     void *context)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+	int r = 0;
+
+	mutex_lock(&mq->lock);
+
+	r = smq_save_hints(mq, &mq->clean, fn, context);
+	if (!r)
+		r = smq_save_hints(mq, &mq->dirty, fn, context);
+
+	mutex_unlock(&mq->lock);
+
+	return r;
+}
+
+static void del_entry(struct smq_policy *mq, struct entry *e)
+{
+	q_del(cache_queue(mq, e), e);
+	h_remove(&mq->table, e);
+	clear_bit(get_index(&mq->cache_alloc, e), mq->cache_hit_bits);
+	free_entry(&mq->cache_alloc, e);
+}
+
+static void __remove_mapping(struct smq_policy *mq, dm_oblock_t oblock)
+{
+	struct entry *e;
+
+	e = h_lookup(&mq->table, oblock);
+	BUG_ON(!e);
+
+	del_entry(mq, e);
+}
+
+static void smq_remove_mapping(struct dm_cache_policy *p, dm_oblock_t oblock)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+
+	mutex_lock(&mq->lock);
+	__remove_mapping(mq, oblock);
+	mutex_unlock(&mq->lock);
+}
+
+static int __remove_cblock(struct smq_policy *mq, dm_cblock_t cblock)
+{
+	struct entry *e = get_entry(&mq->cache_alloc, from_cblock(cblock));
+
+	if (!e->allocated)
+		return -ENODATA;
+
+	del_entry(mq, e);
+
+	return 0;
+}
+
+static int smq_remove_cblock(struct dm_cache_policy *p, dm_cblock_t cblock)
+{
+	int r;
+	struct smq_policy *mq = to_smq_policy(p);
+
+	mutex_lock(&mq->lock);
+	r = __remove_cblock(mq, cblock);
+	mutex_unlock(&mq->lock);
+
+	return r;
+}
+
+static bool clean_target_met(struct smq_policy *mq)
+{
+	/*
+	 * Cache entries may not be populated.  So we cannot rely on the
+	 * size of the clean queue.
+	 */
+	unsigned nr_clean = from_cblock(mq->cache_size) - q_size(&mq->dirty);
+	unsigned target = from_cblock(mq->cache_size) * CLEAN_TARGET_PERCENTAGE / 100u;
+
+	return nr_clean >= target;
+}
+
+/*
+ * Dirty blocks in the bottom level have gone cold and are written back
+ * regardless.  Hotter ones only when too few clean blocks are left to
+ * demote.
+ */
+static int __smq_writeback_work(struct smq_policy *mq, dm_oblock_t *oblock,
+				dm_cblock_t *cblock)
+{
+	struct entry *e;
+
+	if (clean_target_met(mq))
+		e = q_peek(&mq->dirty, 1u);
+	else
+		e = q_peek(&mq->dirty, mq->dirty.nr_levels);
+
+	if (!e)
+		return -ENODATA;
+
+	*oblock = e->oblock;
+	*cblock = infer_cblock(mq, e);
+
+	q_del(&mq->dirty, e);
+	e->dirty = false;
+	q_push(&mq->clean, e);
+
+	return 0;
+}
+
+static int smq_writeback_work(struct dm_cache_policy *p, dm_oblock_t *oblock,
+			      dm_cblock_t *cblock)
+{
+	int r;
+	struct smq_policy *mq = to_smq_policy(p);
+
+	mutex_lock(&mq->lock);
+	r = __smq_writeback_work(mq, oblock, cblock);
+	mutex_unlock(&mq->lock);
+
+	return r;
+}
+
+static void __force_mapping(struct smq_policy *mq,
+			    dm_oblock_t current_oblock, dm_oblock_t new_oblock)
+{
+	struct entry *e = h_lookup(&mq->table, current_oblock);
+
+	if (e) {
+		q_del(cache_queue(mq, e), e);
+		h_remove(&mq->table, e);
+		e->oblock = new_oblock;
+		e->dirty = true;
+		h_insert(&mq->table, e);
+		q_push(cache_queue(mq, e), e);
+	}
+}
+
+static void smq_force_mapping(struct dm_cache_policy *p,
+			      dm_oblock_t current_oblock, dm_oblock_t new_oblock)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+
+	mutex_lock(&mq->lock);
+	__force_mapping(mq, current_oblock, new_oblock);
+	mutex_unlock(&mq->lock);
+}
+
+static dm_cblock_t smq_residency(struct dm_cache_policy *p)
+{
+	dm_cblock_t r;
+	struct smq_policy *mq = to_smq_policy(p);
+
+	mutex_lock(&mq->lock);
+	r = to_cblock(mq->cache_alloc.nr_allocated);
+	mutex_unlock(&mq->lock);
+
+	return r;
+}
+
+static int smq_set_config_value(struct dm_cache_policy *p,
+				const char *key, const char *value)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+	unsigned long tmp;
+
+	if (kstrtoul(value, 10, &tmp))
+		return -EINVAL;
+
+	if (!strcasecmp(key, "sequential_cutoff")) {
+		mutex_lock(&mq->lock);
+		mq->tracker.sequential_cutoff = tmp;
+		mutex_unlock(&mq->lock);
+
+	} else if (!strcasecmp(key, "write_promote_adjustment"))
+		mq->write_promote_adjustment = min_t(unsigned long, tmp,
+						     NR_HOTSPOT_LEVELS);
+
+	else
+		return -EINVAL;
+
+	return 0;
+}
+
+static int smq_emit_config_values(struct dm_cache_policy *p, char *result, unsigned maxlen)
+{
+	ssize_t sz = 0;
+	struct smq_policy *mq = to_smq_policy(p);
+
+	DMEMIT("4 sequential_cutoff %llu "
+	       "write_promote_adjustment %u",
+	       (unsigned long long) mq->tracker.sequential_cutoff,
+	       mq->write_promote_adjustment);
+
+	return 0;
+}
+
+/* Init the policy plugin interface function pointers. */
+static void init_policy_functions(struct smq_policy *mq)
+{
+	mq->policy.destroy = smq_destroy;
+	mq->policy.map = smq_map;
+	mq->policy.lookup = smq_lookup;
+	mq->policy.set_dirty = smq_set_dirty;
+	mq->policy.clear_dirty = smq_clear_dirty;
+	mq->policy.load_mapping = smq_load_mapping;
+	mq->policy.walk_mappings = smq_walk_mappings;
+	mq->policy.remove_mapping = smq_remove_mapping;
+	mq->policy.remove_cblock = smq_remove_cblock;
+	mq->policy.writeback_work = smq_writeback_work;
+	mq->policy.force_mapping = smq_force_mapping;
+	mq->policy.residency = smq_residency;
+	mq->policy.emit_config_values = smq_emit_config_values;
+	mq->policy.set_config_value = smq_set_config_value;
+}
+
+static bool too_many_hotspot_blocks(sector_t origin_size,
+				    sector_t hotspot_block_size,
+				    unsigned nr_hotspot_blocks)
+{
+	return (hotspot_block_size * nr_hotspot_blocks) > origin_size;
+}
+
+/*
+ * Hotspots are as big as 16 cache blocks, but shrink on small origins so
+ * that the hotspots we have still divide it up finely enough.
+ */
+static void calc_hotspot_params(sector_t origin_size,
+				sector_t cache_block_size,
+				unsigned nr_cache_blocks,
+				sector_t *hotspot_block_size,
+				unsigned *nr_hotspot_blocks)
+{
+	*hotspot_block_size = cache_block_size * 16u;
+	*nr_hotspot_blocks = max(nr_cache_blocks / 4u, 1024u);
+
+	while ((*hotspot_block_size > cache_block_size) &&
+	       too_many_hotspot_blocks(origin_size, *hotspot_block_size, *nr_hotspot_blocks))
+		*hotspot_block_size /= 2u;
+}
+
+static unsigned long *alloc_bitset(unsigned nr_bits)
+{
+	return vzalloc(BITS_TO_LONGS(max(nr_bits, 1u)) * sizeof(unsigned long));
+}
+
+static struct dm_cache_policy *smq_create(dm_cblock_t cache_size,
+					  sector_t origin_size,
+					  sector_t cache_block_size)
+{
+	unsigned nr_cache_blocks = from_cblock(cache_size);
+	struct smq_policy *mq;
+
+	/* entries are linked by 28 bit indexes */
+	if (nr_cache_blocks >= INDEXER_NULL) {
+		DMERR("cache too large for smq policy");
+		return NULL;
+	}
+
+	mq = kzalloc(sizeof(*mq), GFP_KERNEL);
+	if (!mq)
+		return NULL;
+
+	init_policy_functions(mq);
+	mq->cache_size = cache_size;
+	mq->cache_block_size = cache_block_size;
+
+	calc_hotspot_params(origin_size, cache_block_size, nr_cache_blocks,
+			    &mq->hotspot_block_size, &mq->nr_hotspot_blocks);
+
+	mq->cache_blocks_per_hotspot_block = div64_u64(mq->hotspot_block_size,
+						       mq->cache_block_size);
+	mq->hotspot_level_jump = 1u;
+
+	if (space_init(&mq->cache_es, nr_cache_blocks)) {
+		DMERR("couldn't initialize entry space");
+		goto bad_cache_space;
+	}
+
+	if (space_init(&mq->hotspot_es, mq->nr_hotspot_blocks)) {
+		DMERR("couldn't initialize hotspot entry space");
+		goto bad_hotspot_space;
+	}
+
+	init_allocator(&mq->cache_alloc, &mq->cache_es, nr_cache_blocks);
+	init_allocator(&mq->hotspot_alloc, &mq->hotspot_es, mq->nr_hotspot_blocks);
+
+	mq->cache_hit_bits = alloc_bitset(nr_cache_blocks);
+	if (!mq->cache_hit_bits) {
+		DMERR("couldn't allocate cache hit bitset");
+		goto bad_cache_hit_bits;
+	}
+
+	mq->hotspot_hit_bits = alloc_bitset(mq->nr_hotspot_blocks);
+	if (!mq->hotspot_hit_bits) {
+		DMERR("couldn't allocate hotspot hit bitset");
+		goto bad_hotspot_hit_bits;
+	}
+
+	q_init(&mq->hotspot, &mq->hotspot_es, NR_HOTSPOT_LEVELS);
+	q_init(&mq->clean, &mq->cache_es, NR_CACHE_LEVELS);
+	q_init(&mq->dirty, &mq->cache_es, NR_CACHE_LEVELS);
+
+	if (h_init(&mq->table, &mq->cache_es, nr_cache_blocks))
+		goto bad_alloc_table;
+
+	if (h_init(&mq->hotspot_table, &mq->hotspot_es, mq->nr_hotspot_blocks))
+		goto bad_alloc_hotspot_table;
+
+	iot_init(&mq->tracker, SEQUENTIAL_CUTOFF_DEFAULT);
+	mq->promote_level = DEFAULT_PROMOTE_LEVEL;
+	mq->write_promote_adjustment = DEFAULT_WRITE_PROMOTE_ADJUSTMENT;
+	mq->next_hit_period = jiffies + HIT_PERIOD;
+	mq->next_promote_period = jiffies + PROMOTE_PERIOD;
+	mutex_init(&mq->lock);
+
+	return &mq->policy;
+
+bad_alloc_hotspot_table:
+	h_exit(&mq->table);
+bad_alloc_table:
+	vfree(mq->hotspot_hit_bits);
+bad_hotspot_hit_bits:
+	vfree(mq->cache_hit_bits);
+bad_cache_hit_bits:
+	space_exit(&mq->hotspot_es);
+bad_hotspot_space:
+	space_exit(&mq->cache_es);
+bad_cache_space:
+	kfree(mq);
+
+	return NULL;
+}
+
+/*----------------------------------------------------------------*/
+
+static struct dm_cache_policy_type smq_policy_type = {
+	.name = "smq",
+	.version = {1, 0, 0},
+	.hint_size = 4,
+	.owner = THIS_MODULE,
+	.create = smq_create
+};
+
+static int __init smq_init(void)
+{
+	int r;
+
+	r = dm_cache_policy_register(&smq_policy_type);
+	if (r) {
+		DMERR("register failed %d", r);
+		return -ENOMEM;
+	}
+
+	DMINFO("version %u.%u.%u loaded",
+	       smq_policy_type.version[0],
+	       smq_policy_type.version[1],
+	       smq_policy_type.version[2]);
+
+	return 0;
+}
+
+static void __exit smq_exit(void)
+{
+	dm_cache_policy_unregister(&smq_policy_type);
+}
+
+module_init(smq_init);
+module_exit(smq_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("smq cache policy");
@@ -112,7 +112,8 @@ struct iv_tcw_private {
  * and encrypts / decrypts at the same time.
  */
 enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
-	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD };
+	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD,
+	     DM_CRYPT_NO_READ_WORKQUEUE, DM_CRYPT_NO_WRITE_WORKQUEUE };
 
 /*
  * The fields in here must be read only after initialization.
@@ -882,18 +883,25 @@ static int crypt_convert_block(struct crypt_config *cc,
 static void kcryptd_async_done(struct crypto_async_request *async_req,
 			       int error);
 
-static void crypt_alloc_req(struct crypt_config *cc,
-			    struct convert_context *ctx)
+static int crypt_alloc_req(struct crypt_config *cc,
+			   struct convert_context *ctx, bool atomic)
 {
 	unsigned key_index = ctx->cc_sector & (cc->tfms_count - 1);
 
-	if (!ctx->req)
-		ctx->req = mempool_alloc(cc->req_pool, GFP_NOIO);
+	if (!ctx->req) {
+		ctx->req = mempool_alloc(cc->req_pool,
+					 atomic ? GFP_ATOMIC : GFP_NOIO);
+		if (!ctx->req)
+			return -ENOMEM;
+	}
 
 	ablkcipher_request_set_tfm(ctx->req, cc->tfms[key_index]);
 	ablkcipher_request_set_callback(ctx->req,
-	    CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+	    CRYPTO_TFM_REQ_MAY_BACKLOG |
+	    (atomic ? 0 : CRYPTO_TFM_REQ_MAY_SLEEP),
 	    kcryptd_async_done, dmreq_of_req(cc, ctx->req));
+
+	return 0;
 }
 
 static void crypt_free_req(struct crypt_config *cc,
@@ -907,17 +915,25 @@ static void crypt_free_req(struct crypt_config *cc,
 
 /*
  * Encrypt / decrypt data from one bio to another one (can be the same one)
+ *
+ * In @atomic context nothing may sleep.  If the conversion can't go on
+ * without sleeping, -EAGAIN is returned and the caller must finish it
+ * from process context by calling crypt_convert() again, with
+ * @reset_pending false.
  */
 static int crypt_convert(struct crypt_config *cc,
-			 struct convert_context *ctx)
+			 struct convert_context *ctx, bool atomic,
+			 bool reset_pending)
 {
 	int r;
 
-	atomic_set(&ctx->cc_pending, 1);
+	if (reset_pending)
+		atomic_set(&ctx->cc_pending, 1);
 
 	while (ctx->iter_in.bi_size && ctx->iter_out.bi_size) {
 
-		crypt_alloc_req(cc, ctx);
+		if (crypt_alloc_req(cc, ctx, atomic))
+			return -EAGAIN;
 
 		atomic_inc(&ctx->cc_pending);
 
@@ -927,6 +943,14 @@ static int crypt_convert(struct crypt_config *cc,
 		/* async */
 		case -EINPROGRESS:
 		case -EBUSY:
+			if (atomic) {
+				ctx->req = NULL;
+				ctx->cc_sector++;
+				/* backlogged: throttle from process context */
+				if (r == -EBUSY)
+					return -EAGAIN;
+				continue;
+			}
 			wait_for_completion(&ctx->restart);
 			reinit_completion(&ctx->restart);
 			ctx->req = NULL;
@@ -937,7 +961,8 @@ static int crypt_convert(struct crypt_config *cc,
 		case 0:
 			atomic_dec(&ctx->cc_pending);
 			ctx->cc_sector++;
-			cond_resched();
+			if (!atomic)
+				cond_resched();
 			continue;
 
 		/* error */
@@ -1248,7 +1273,9 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io, int async)
 
 	clone->bi_iter.bi_sector = cc->start + io->sector;
 
-	if (likely(!async) && test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags)) {
+	if (likely(!async) &&
+	    (test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags) ||
+	     test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))) {
 		generic_make_request(clone);
 		return;
 	}
@@ -1297,7 +1324,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	sector += bio_sectors(clone);
 
 	crypt_inc_pending(io);
-	r = crypt_convert(cc, &io->ctx);
+	r = crypt_convert(cc, &io->ctx, false, true);
 	if (r)
 		io->error = -EIO;
 	crypt_finished = atomic_dec_and_test(&io->ctx.cc_pending);
@@ -1317,7 +1344,27 @@ static void kcryptd_crypt_read_done(struct dm_crypt_io *io)
 	crypt_dec_pending(io);
 }
 
-static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
+static void kcryptd_crypt_read_finish(struct dm_crypt_io *io, int r)
+{
+	if (r < 0)
+		io->error = -EIO;
+
+	if (atomic_dec_and_test(&io->ctx.cc_pending))
+		kcryptd_crypt_read_done(io);
+
+	crypt_dec_pending(io);
+}
+
+/* Finish a decryption that had to leave atomic context */
+static void kcryptd_crypt_read_continue(struct work_struct *work)
+{
+	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
+
+	kcryptd_crypt_read_finish(io,
+			crypt_convert(io->cc, &io->ctx, false, false));
+}
+
+static void kcryptd_crypt_read_convert(struct dm_crypt_io *io, bool atomic)
 {
 	struct crypt_config *cc = io->cc;
 	int r = 0;
@@ -1327,14 +1374,14 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
 			   io->sector);
 
-	r = crypt_convert(cc, &io->ctx);
-	if (r < 0)
-		io->error = -EIO;
-
-	if (atomic_dec_and_test(&io->ctx.cc_pending))
-		kcryptd_crypt_read_done(io);
+	r = crypt_convert(cc, &io->ctx, atomic, true);
+	if (r == -EAGAIN) {
+		INIT_WORK(&io->work, kcryptd_crypt_read_continue);
+		queue_work(cc->crypt_queue, &io->work);
+		return;
+	}
 
-	crypt_dec_pending(io);
+	kcryptd_crypt_read_finish(io, r);
 }
 
 static void kcryptd_async_done(struct crypto_async_request *async_req,
@@ -1373,7 +1420,7 @@ static void kcryptd_crypt(struct work_struct *work)
 	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
 
 	if (bio_data_dir(io->base_bio) == READ)
-		kcryptd_crypt_read_convert(io);
+		kcryptd_crypt_read_convert(io, false);
 	else
 		kcryptd_crypt_write_convert(io);
 }
@@ -1382,6 +1429,18 @@ static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->cc;
 
+	if (bio_data_dir(io->base_bio) == READ &&
+	    test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags) &&
+	    !in_irq() && !(cc->iv_gen_ops && cc->iv_gen_ops->post)) {
+		/*
+		 * Decrypt in the completion context, on the CPU the bio
+		 * completed on.  The IV generators with a post hook use
+		 * sleeping hash calls, so they always take the workqueue.
+		 */
+		kcryptd_crypt_read_convert(io, true);
+		return;
+	}
+
 	INIT_WORK(&io->work, kcryptd_crypt);
 	queue_work(cc->crypt_queue, &io->work);
 }
@@ -1720,7 +1779,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char dummy;
 
 	static struct dm_arg _args[] = {
-		{0, 3, "Invalid number of feature args"},
+		{0, 5, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1833,6 +1892,12 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 			else if (!strcasecmp(opt_string, "submit_from_crypt_cpus"))
 				set_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
 
+			else if (!strcasecmp(opt_string, "no_read_workqueue"))
+				set_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+
+			else if (!strcasecmp(opt_string, "no_write_workqueue"))
+				set_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+
 			else {
 				ti->error = "Invalid feature arguments";
 				goto bad;
@@ -1904,7 +1969,10 @@ static int crypt_map(struct dm_target *ti, struct bio *bio)
 	if (bio_data_dir(io->base_bio) == READ) {
 		if (kcryptd_io_read(io, GFP_NOWAIT))
 			kcryptd_queue_read(io);
-	} else
+	} else if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
+		/* encrypt and submit from the caller's context */
+		kcryptd_crypt_write_convert(io);
+	else
 		kcryptd_queue_crypt(io);
 
 	return DM_MAPIO_SUBMITTED;
@@ -1937,6 +2005,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		num_feature_args += !!ti->num_discard_bios;
 		num_feature_args += test_bit(DM_CRYPT_SAME_CPU, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
 		if (num_feature_args) {
 			DMEMIT(" %d", num_feature_args);
 			if (ti->num_discard_bios)
@@ -1945,6 +2015,10 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 				DMEMIT(" same_cpu_crypt");
 			if (test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags))
 				DMEMIT(" submit_from_crypt_cpus");
+			if (test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_read_workqueue");
+			if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_write_workqueue");
 		}
 
 		break;
@@ -2042,7 +2116,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 14, 0},
+	.version = {1, 15, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -242,6 +242,17 @@ bool dm_use_blk_mq(struct mapped_device *md)
 	return md->use_blk_mq;
 }
 
+/*
+ * blk-mq request-based DM's queue geometry set by the user.  By default
+ * there is a hardware queue per online CPU, so submitters on different
+ * CPUs don't contend on a single hctx.
+ */
+#define DM_MQ_NR_HW_QUEUES_MAX 64
+#define DM_MQ_QUEUE_DEPTH BLKDEV_MAX_RQ
+#define DM_MQ_QUEUE_DEPTH_MAX BLK_MQ_MAX_DEPTH
+static unsigned dm_mq_nr_hw_queues;
+static unsigned dm_mq_queue_depth = DM_MQ_QUEUE_DEPTH;
+
 /*
  * For mempools pre-allocation at the table loading time.
  */
@@ -307,6 +318,22 @@ unsigned dm_get_reserved_rq_based_ios(void)
 }
 EXPORT_SYMBOL_GPL(dm_get_reserved_rq_based_ios);
 
+static unsigned dm_get_blk_mq_nr_hw_queues(void)
+{
+	unsigned nr = ACCESS_ONCE(dm_mq_nr_hw_queues);
+
+	if (!nr)
+		nr = num_online_cpus();
+
+	return min_t(unsigned, nr, DM_MQ_NR_HW_QUEUES_MAX);
+}
+
+static unsigned dm_get_blk_mq_queue_depth(void)
+{
+	return __dm_get_module_param(&dm_mq_queue_depth,
+				     DM_MQ_QUEUE_DEPTH, DM_MQ_QUEUE_DEPTH_MAX);
+}
+
 static int __init local_init(void)
 {
 	int r = -ENOMEM;
@@ -2775,10 +2802,10 @@ static int dm_init_request_based_blk_mq_queue(struct mapped_device *md)
 
 	memset(&md->tag_set, 0, sizeof(md->tag_set));
 	md->tag_set.ops = &dm_mq_ops;
-	md->tag_set.queue_depth = BLKDEV_MAX_RQ;
+	md->tag_set.queue_depth = dm_get_blk_mq_queue_depth();
 	md->tag_set.numa_node = NUMA_NO_NODE;
 	md->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_SG_MERGE;
-	md->tag_set.nr_hw_queues = 1;
+	md->tag_set.nr_hw_queues = dm_get_blk_mq_nr_hw_queues();
 	if (md_type == DM_TYPE_REQUEST_BASED) {
 		/* make the memory for non-blk-mq clone part of the pdu */
 		md->tag_set.cmd_size = sizeof(struct dm_rq_target_io) + sizeof(struct request);
@@ -3632,6 +3659,12 @@ MODULE_PARM_DESC(reserved_rq_based_ios, "Reserved IOs in request-based mempools"
 module_param(use_blk_mq, bool, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(use_blk_mq, "Use block multiqueue for request-based DM devices");
 
+module_param(dm_mq_nr_hw_queues, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dm_mq_nr_hw_queues, "Number of hardware queues for blk-mq request-based DM devices, 0 for one per CPU");
+
+module_param(dm_mq_queue_depth, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dm_mq_queue_depth, "Queue depth for blk-mq request-based DM devices");
+
 MODULE_DESCRIPTION(DM_NAME " driver");
 MODULE_AUTHOR("Joe Thornber <dm-devel@redhat.com>");
 MODULE_LICENSE("GPL");
@@ -77,6 +77,7 @@
 #include <net/pkt_sched.h>
 #include <linux/rculist.h>
 #include <net/flow_keys.h>
+#include <linux/filter.h>
 #include <net/switchdev.h>
 #include <net/bonding.h>
 #include <net/bond_3ad.h>
@@ -160,7 +161,8 @@ module_param(xmit_hash_policy, charp, 0);
 MODULE_PARM_DESC(xmit_hash_policy, "balance-xor and 802.3ad hashing method; "
 				   "0 for layer 2 (default), 1 for layer 3+4, "
 				   "2 for layer 2+3, 3 for encap layer 2+3, "
-				   "4 for encap layer 3+4");
+				   "4 for encap layer 3+4, 5 for bpf "
+				   "(program attached over netlink)");
 module_param(arp_interval, int, 0);
 MODULE_PARM_DESC(arp_interval, "arp interval in milliseconds");
 module_param_array(arp_ip_target, charp, NULL, 0);
@@ -3095,6 +3097,15 @@ u32 bond_xmit_hash(struct bonding *bond, struct sk_buff *skb)
 	struct flow_keys flow;
 	u32 hash;
 
+	if (bond->params.xmit_policy == BOND_XMIT_POLICY_BPF) {
+		struct bpf_prog *prog = rcu_dereference(bond->xmit_hash_prog);
+
+		/* without a program the policy behaves like layer2 */
+		if (prog)
+			return BPF_PROG_RUN(prog, skb);
+		return bond_eth_hash(skb);
+	}
+
 	if (bond->params.xmit_policy == BOND_XMIT_POLICY_LAYER2 ||
 	    !bond_flow_dissect(bond, skb, &flow))
 		return bond_eth_hash(skb);
@@ -3111,6 +3122,43 @@ u32 bond_xmit_hash(struct bonding *bond, struct sk_buff *skb)
 	return hash;
 }
 
+/**
+ * bond_set_xmit_hash_prog - attach the program used by the bpf xmit policy
+ * @bond: bonding device
+ * @fd: file descriptor of a BPF_PROG_TYPE_SOCKET_FILTER program, or
+ *      negative to detach the current one
+ *
+ * The program runs on the frame as it is handed to the bond, i.e. from
+ * the ethernet header, and its return value is used as the hash.  The
+ * mode decides what the hash is used for, as with the other policies.
+ * Caller must hold RTNL.
+ */
+int bond_set_xmit_hash_prog(struct bonding *bond, int fd)
+{
+	struct bpf_prog *new = NULL, *old;
+
+	ASSERT_RTNL();
+
+	if (fd >= 0) {
+		new = bpf_prog_get(fd);
+		if (IS_ERR(new))
+			return PTR_ERR(new);
+		if (new->type != BPF_PROG_TYPE_SOCKET_FILTER) {
+			bpf_prog_put(new);
+			return -EINVAL;
+		}
+	}
+
+	old = rtnl_dereference(bond->xmit_hash_prog);
+	rcu_assign_pointer(bond->xmit_hash_prog, new);
+	if (old) {
+		synchronize_net();
+		bpf_prog_put(old);
+	}
+
+	return 0;
+}
+
 /*-------------------------- Device entry points ----------------------------*/
 
 static void bond_work_init_all(struct bonding *bond)
@@ -4125,6 +4173,8 @@ static void bond_uninit(struct net_device *bond_dev)
 		kfree_rcu(arr, rcu);
 	}
 
+	bond_set_xmit_hash_prog(bond, -1);
+
 	list_del(&bond->bond_list);
 
 	bond_debug_unregister(bond);
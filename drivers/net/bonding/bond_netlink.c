@@ -94,6 +94,7 @@ static const struct nla_policy bond_policy[IFLA_BOND_MAX + 1] = {
 	[IFLA_BOND_AD_LACP_RATE]	= { .type = NLA_U8 },
 	[IFLA_BOND_AD_SELECT]		= { .type = NLA_U8 },
 	[IFLA_BOND_AD_INFO]		= { .type = NLA_NESTED },
+	[IFLA_BOND_XMIT_HASH_BPF_FD]	= { .type = NLA_S32 },
 };
 
 static const struct nla_policy bond_slave_policy[IFLA_BOND_SLAVE_MAX + 1] = {
@@ -379,6 +380,13 @@ static int bond_changelink(struct net_device *bond_dev,
 		if (err)
 			return err;
 	}
+	if (data[IFLA_BOND_XMIT_HASH_BPF_FD]) {
+		int fd = nla_get_s32(data[IFLA_BOND_XMIT_HASH_BPF_FD]);
+
+		err = bond_set_xmit_hash_prog(bond, fd);
+		if (err)
+			return err;
+	}
 	return 0;
 }
 
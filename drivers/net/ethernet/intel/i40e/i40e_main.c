@@ -7233,10 +7233,12 @@ static int i40e_init_msix(struct i40e_pf *pf)
  * i40e_vsi_alloc_q_vector - Allocate memory for a single interrupt vector
  * @vsi: the VSI being configured
  * @v_idx: index of the vector in the vsi struct
+ * @mask: cpus to service the vector from, NULL to use cpu v_idx
  *
  * We allocate one q_vector.  If allocation fails we return -ENOMEM.
  **/
-static int i40e_vsi_alloc_q_vector(struct i40e_vsi *vsi, int v_idx)
+static int i40e_vsi_alloc_q_vector(struct i40e_vsi *vsi, int v_idx,
+				   const struct cpumask *mask)
 {
 	struct i40e_q_vector *q_vector;
 
@@ -7247,7 +7249,10 @@ static int i40e_vsi_alloc_q_vector(struct i40e_vsi *vsi, int v_idx)
 
 	q_vector->vsi = vsi;
 	q_vector->v_idx = v_idx;
-	cpumask_set_cpu(v_idx, &q_vector->affinity_mask);
+	if (mask)
+		cpumask_copy(&q_vector->affinity_mask, mask);
+	else
+		cpumask_set_cpu(v_idx, &q_vector->affinity_mask);
 	if (vsi->netdev)
 		netif_napi_add(vsi->netdev, &q_vector->napi,
 			       i40e_napi_poll, NAPI_POLL_WEIGHT);
@@ -7272,6 +7277,7 @@ static int i40e_vsi_alloc_q_vectors(struct i40e_vsi *vsi)
 {
 	struct i40e_pf *pf = vsi->back;
 	int v_idx, num_q_vectors;
+	struct cpumask *masks;
 	int err;
 
 	/* if not MSIX, give the one vector only to the LAN VSI */
@@ -7282,18 +7288,24 @@ static int i40e_vsi_alloc_q_vectors(struct i40e_vsi *vsi)
 	else
 		return -EINVAL;
 
+	/* spread the vectors over the nodes and cores */
+	masks = irq_create_affinity_masks(num_q_vectors);
+
 	for (v_idx = 0; v_idx < num_q_vectors; v_idx++) {
-		err = i40e_vsi_alloc_q_vector(vsi, v_idx);
+		err = i40e_vsi_alloc_q_vector(vsi, v_idx,
+					      masks ? &masks[v_idx] : NULL);
 		if (err)
 			goto err_out;
 	}
 
+	kfree(masks);
 	return 0;
 
 err_out:
 	while (v_idx--)
 		i40e_free_q_vector(vsi, v_idx);
 
+	kfree(masks);
 	return err;
 }
 
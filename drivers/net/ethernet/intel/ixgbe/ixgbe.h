@@ -37,6 +37,7 @@
 #include <linux/aer.h>
 #include <linux/if_vlan.h>
 #include <linux/jiffies.h>
+#include <linux/hashtable.h>
 
 #include <linux/timecounter.h>
 #include <linux/net_tstamp.h>
@@ -315,6 +316,12 @@ enum ixgbe_ring_f_enum {
 #define IXGBE_MAX_MACVLANS		31
 #define IXGBE_MAX_DCBMACVLANS		8
 
+/* accelerated RFS soft ids sit above the largest ethtool filter location */
+#define IXGBE_MAX_RFS_FILTERS		1024
+#define IXGBE_RFS_SW_IDX_BASE		(1024 << IXGBE_FDIR_PBALLOC_256K)
+#define IXGBE_RFS_HASH_BITS		8
+#define IXGBE_RFS_EXPIRY_QUOTA		64
+
 struct ixgbe_ring_feature {
 	u16 limit;	/* upper limit on feature indices */
 	u16 indices;	/* current value of indices */
@@ -602,6 +609,7 @@ struct ixgbe_adapter {
 	/* OS defined structs */
 	struct net_device *netdev;
 	struct pci_dev *pdev;
+	struct bpf_prog __rcu *xdp_prog;	/* run on every rx ring */
 
 	unsigned long state;
 
@@ -715,6 +723,14 @@ struct ixgbe_adapter {
 	u32 fdir_pballoc;
 	u32 atr_sample_rate;
 	spinlock_t fdir_perfect_lock;
+#ifdef CONFIG_RFS_ACCEL
+	/* accelerated RFS filters, protected by rfs_lock */
+	spinlock_t rfs_lock;
+	DECLARE_HASHTABLE(rfs_hash, IXGBE_RFS_HASH_BITS);
+	struct list_head rfs_list;
+	DECLARE_BITMAP(rfs_ids, IXGBE_MAX_RFS_FILTERS);
+	int rfs_hw_count;	/* also protected by fdir_perfect_lock */
+#endif
 
 #ifdef IXGBE_FCOE
 	struct ixgbe_fcoe fcoe;
@@ -800,6 +816,29 @@ struct ixgbe_fdir_filter {
 	u16 action;
 };
 
+#ifdef CONFIG_RFS_ACCEL
+struct ixgbe_rfs_filter {
+	struct hlist_node hash_node;
+	struct list_head list;
+	union ixgbe_atr_input filter;
+	u32 flow_id;
+	u16 id;
+	u16 rxq_index;
+	bool pending;	/* (re)program with rxq_index */
+	bool in_hw;
+};
+
+#endif
+static inline bool ixgbe_rfs_in_hw(struct ixgbe_adapter *adapter)
+{
+#ifdef CONFIG_RFS_ACCEL
+	return adapter->rfs_hw_count;
+#else
+	return false;
+#endif
+}
+
+
 enum ixgbe_state_t {
 	__IXGBE_TESTING,
 	__IXGBE_RESETTING,
@@ -2665,7 +2665,8 @@ static int ixgbe_add_ethtool_fdir_entry(struct ixgbe_adapter *adapter,
 
 	spin_lock(&adapter->fdir_perfect_lock);
 
-	if (hlist_empty(&adapter->fdir_filter_list)) {
+	if (hlist_empty(&adapter->fdir_filter_list) &&
+	    !ixgbe_rfs_in_hw(adapter)) {
 		/* save mask and program input mask into HW */
 		memcpy(&adapter->fdir_mask, &mask, sizeof(mask));
 		err = ixgbe_fdir_set_input_mask_82599(hw, &mask);
@@ -49,6 +49,9 @@
 #include <linux/if_macvlan.h>
 #include <linux/if_bridge.h>
 #include <linux/prefetch.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/cpu_rmap.h>
 #include <scsi/fc/fc_fcoe.h>
 #include <net/vxlan.h>
 
@@ -1074,9 +1077,10 @@ static void ixgbe_tx_timeout_reset(struct ixgbe_adapter *adapter)
  * ixgbe_clean_tx_irq - Reclaim resources after transmit completes
  * @q_vector: structure containing interrupt and ring information
  * @tx_ring: tx ring to clean
+ * @napi_budget: Used to determine if we are in netpoll
  **/
 static bool ixgbe_clean_tx_irq(struct ixgbe_q_vector *q_vector,
-			       struct ixgbe_ring *tx_ring)
+			       struct ixgbe_ring *tx_ring, int napi_budget)
 {
 	struct ixgbe_adapter *adapter = q_vector->adapter;
 	struct ixgbe_tx_buffer *tx_buffer;
@@ -1114,7 +1118,7 @@ static bool ixgbe_clean_tx_irq(struct ixgbe_q_vector *q_vector,
 		total_packets += tx_buffer->gso_segs;
 
 		/* free the skb */
-		dev_consume_skb_any(tx_buffer->skb);
+		napi_consume_skb(tx_buffer->skb, napi_budget);
 
 		/* unmap skb header data */
 		dma_unmap_single(tx_ring->dev,
@@ -1989,6 +1993,72 @@ dma_sync:
 	return skb;
 }
 
+/**
+ * ixgbe_run_xdp - give the XDP program a look at a received frame
+ * @rx_ring: rx descriptor ring the frame arrived on
+ * @rx_desc: descriptor of the frame
+ * @xdp_prog: program attached to the adapter
+ *
+ * Only frames that fit in the single buffer at next_to_clean are shown
+ * to the program, anything else is passed on. The buffer still belongs
+ * to the ring, so for a dropped frame it is simply handed back and
+ * next_to_clean is advanced; no skb is ever allocated.
+ *
+ * Returns the XDP_* verdict, XDP_ABORTED and unknown values are folded
+ * into XDP_DROP.
+ **/
+static u32 ixgbe_run_xdp(struct ixgbe_ring *rx_ring,
+			 union ixgbe_adv_rx_desc *rx_desc,
+			 struct bpf_prog *xdp_prog)
+{
+	struct ixgbe_rx_buffer *rx_buffer;
+	struct xdp_buff xdp;
+	u32 ntc, act;
+
+	rx_buffer = &rx_ring->rx_buffer_info[rx_ring->next_to_clean];
+
+	if (rx_buffer->skb ||
+	    !ixgbe_test_staterr(rx_desc, IXGBE_RXD_STAT_EOP) ||
+	    ixgbe_test_staterr(rx_desc, IXGBE_RXDADV_ERR_FRAME_ERR_MASK))
+		return XDP_PASS;
+
+#ifdef IXGBE_FCOE
+	if (test_bit(__IXGBE_RX_FCOE, &rx_ring->state))
+		return XDP_PASS;
+#endif
+
+	dma_sync_single_range_for_cpu(rx_ring->dev,
+				      rx_buffer->dma,
+				      rx_buffer->page_offset,
+				      ixgbe_rx_bufsz(rx_ring),
+				      DMA_FROM_DEVICE);
+
+	xdp.data = page_address(rx_buffer->page) + rx_buffer->page_offset;
+	xdp.len = le16_to_cpu(rx_desc->wb.upper.length);
+
+	act = bpf_prog_run_xdp(xdp_prog, &xdp);
+	switch (act) {
+	case XDP_PASS:
+	case XDP_TX:
+		return act;
+	case XDP_ABORTED:
+	case XDP_DROP:
+	default:
+		break;
+	}
+
+	/* hand the untouched buffer back to the ring */
+	ixgbe_reuse_rx_page(rx_ring, rx_buffer);
+	rx_buffer->page = NULL;
+
+	ntc = rx_ring->next_to_clean + 1;
+	ntc = (ntc < rx_ring->count) ? ntc : 0;
+	rx_ring->next_to_clean = ntc;
+	prefetch(IXGBE_RX_DESC(rx_ring, ntc));
+
+	return XDP_DROP;
+}
+
 /**
  * ixgbe_clean_rx_irq - Clean completed descriptors from Rx ring - bounce buf
  * @q_vector: structure containing interrupt and ring information
@@ -2013,10 +2083,15 @@ static int ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 	unsigned int mss = 0;
 #endif /* IXGBE_FCOE */
 	u16 cleaned_count = ixgbe_desc_unused(rx_ring);
+	struct bpf_prog *xdp_prog;
+
+	rcu_read_lock();
+	xdp_prog = rcu_dereference(q_vector->adapter->xdp_prog);
 
 	while (likely(total_rx_packets < budget)) {
 		union ixgbe_adv_rx_desc *rx_desc;
 		struct sk_buff *skb;
+		u32 xdp_act = XDP_PASS;
 
 		/* return some buffers to hardware, one at a time is too slow */
 		if (cleaned_count >= IXGBE_RX_BUFFER_WRITE) {
@@ -2035,6 +2110,15 @@ static int ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 		 */
 		dma_rmb();
 
+		if (xdp_prog) {
+			xdp_act = ixgbe_run_xdp(rx_ring, rx_desc, xdp_prog);
+			if (xdp_act == XDP_DROP) {
+				cleaned_count++;
+				total_rx_packets++;
+				continue;
+			}
+		}
+
 		/* retrieve a buffer from the ring */
 		skb = ixgbe_fetch_rx_buffer(rx_ring, rx_desc);
 
@@ -2055,6 +2139,15 @@ static int ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 		/* probably a little skewed due to removing CRC */
 		total_rx_bytes += skb->len;
 
+		if (xdp_act == XDP_TX) {
+			/* skb->data is still at the MAC header */
+			skb->dev = rx_ring->netdev;
+			skb_record_rx_queue(skb, rx_ring->queue_index);
+			netif_xdp_xmit(skb);
+			total_rx_packets++;
+			continue;
+		}
+
 		/* populate checksum, timestamp, VLAN, and protocol */
 		ixgbe_process_skb_fields(rx_ring, rx_desc, skb);
 
@@ -2090,6 +2183,8 @@ static int ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 		total_rx_packets++;
 	}
 
+	rcu_read_unlock();
+
 	u64_stats_update_begin(&rx_ring->syncp);
 	rx_ring->stats.packets += total_rx_packets;
 	rx_ring->stats.bytes += total_rx_bytes;
@@ -2702,7 +2797,7 @@ int ixgbe_poll(struct napi_struct *napi, int budget)
 #endif
 
 	ixgbe_for_each_ring(ring, q_vector->tx)
-		clean_complete &= !!ixgbe_clean_tx_irq(q_vector, ring);
+		clean_complete &= !!ixgbe_clean_tx_irq(q_vector, ring, budget);
 
 	if (!ixgbe_qv_lock_napi(q_vector))
 		return budget;
@@ -2740,6 +2835,50 @@ int ixgbe_poll(struct napi_struct *napi, int budget)
  * ixgbe_request_msix_irqs allocates MSI-X vectors and requests
  * interrupts from the kernel.
  **/
+#ifdef CONFIG_RFS_ACCEL
+static void ixgbe_free_rx_cpu_rmap(struct ixgbe_adapter *adapter)
+{
+	free_irq_cpu_rmap(adapter->netdev->rx_cpu_rmap);
+	adapter->netdev->rx_cpu_rmap = NULL;
+}
+
+/**
+ * ixgbe_set_rx_cpu_rmap - map Rx queues to the CPUs handling their irq
+ * @adapter: board private structure
+ *
+ * The rmap index has to be the Rx queue index, so this is only done when
+ * every Rx ring owns a vector of its own.
+ **/
+static void ixgbe_set_rx_cpu_rmap(struct ixgbe_adapter *adapter)
+{
+	struct net_device *netdev = adapter->netdev;
+	int vector, rxq = 0;
+
+	if (adapter->num_rx_queues > adapter->num_q_vectors)
+		return;
+
+	netdev->rx_cpu_rmap = alloc_irq_cpu_rmap(adapter->num_rx_queues);
+	if (!netdev->rx_cpu_rmap)
+		return;
+
+	for (vector = 0; vector < adapter->num_q_vectors; vector++) {
+		struct ixgbe_ring *ring = adapter->q_vector[vector]->rx.ring;
+
+		if (!ring)
+			continue;
+
+		if (ring->queue_index != rxq || ring->next ||
+		    irq_cpu_rmap_add(netdev->rx_cpu_rmap,
+				     adapter->msix_entries[vector].vector)) {
+			ixgbe_free_rx_cpu_rmap(adapter);
+			return;
+		}
+		rxq++;
+	}
+}
+
+#endif /* CONFIG_RFS_ACCEL */
+
 static int ixgbe_request_msix_irqs(struct ixgbe_adapter *adapter)
 {
 	struct net_device *netdev = adapter->netdev;
@@ -2786,6 +2925,10 @@ static int ixgbe_request_msix_irqs(struct ixgbe_adapter *adapter)
 		goto free_queue_irqs;
 	}
 
+#ifdef CONFIG_RFS_ACCEL
+	ixgbe_set_rx_cpu_rmap(adapter);
+#endif
+
 	return 0;
 
 free_queue_irqs:
@@ -2912,6 +3055,10 @@ static void ixgbe_free_irq(struct ixgbe_adapter *adapter)
 		return;
 	}
 
+#ifdef CONFIG_RFS_ACCEL
+	ixgbe_free_rx_cpu_rmap(adapter);
+
+#endif
 	for (vector = 0; vector < adapter->num_q_vectors; vector++) {
 		struct ixgbe_q_vector *q_vector = adapter->q_vector[vector];
 		struct msix_entry *entry = &adapter->msix_entries[vector];
@@ -4416,12 +4563,249 @@ static void ixgbe_configure_pb(struct ixgbe_adapter *adapter)
 	ixgbe_pbthresh_setup(adapter);
 }
 
+#ifdef CONFIG_RFS_ACCEL
+static void ixgbe_rfs_mask(union ixgbe_atr_input *mask)
+{
+	memset(mask, 0, sizeof(*mask));
+	mask->formatted.flow_type = IXGBE_ATR_L4TYPE_IPV6_MASK |
+				    IXGBE_ATR_L4TYPE_MASK;
+	mask->formatted.src_ip[0] = htonl(~0);
+	mask->formatted.dst_ip[0] = htonl(~0);
+	mask->formatted.src_port = htons(~0);
+	mask->formatted.dst_port = htons(~0);
+}
+
+static void ixgbe_rfs_free(struct ixgbe_adapter *adapter,
+			   struct ixgbe_rfs_filter *f)
+{
+	hash_del(&f->hash_node);
+	list_del(&f->list);
+	clear_bit(f->id, adapter->rfs_ids);
+	kfree(f);
+}
+
+/**
+ * ixgbe_rfs_reset - forget hardware state of accelerated RFS filters
+ * @adapter: board private structure
+ *
+ * Called after the flow director table has been reinitialized, or
+ * with flush set when the filters can no longer be used at all.
+ **/
+static void ixgbe_rfs_reset(struct ixgbe_adapter *adapter, bool flush)
+{
+	struct ixgbe_rfs_filter *f, *tmp;
+
+	spin_lock_bh(&adapter->rfs_lock);
+	spin_lock(&adapter->fdir_perfect_lock);
+
+	list_for_each_entry_safe(f, tmp, &adapter->rfs_list, list) {
+		if (flush) {
+			ixgbe_rfs_free(adapter, f);
+			continue;
+		}
+		f->in_hw = false;
+		f->pending = true;
+	}
+	adapter->rfs_hw_count = 0;
+
+	spin_unlock(&adapter->fdir_perfect_lock);
+	spin_unlock_bh(&adapter->rfs_lock);
+}
+
+/**
+ * ixgbe_rfs_subtask - program and expire accelerated RFS filters
+ * @adapter: board private structure
+ *
+ * ndo_rx_flow_steer runs in softirq context and only records the
+ * request; writing the perfect filter is done here so that it is
+ * serialized with the ethtool ntuple filters sharing the same table.
+ **/
+static void ixgbe_rfs_subtask(struct ixgbe_adapter *adapter)
+{
+	struct ixgbe_hw *hw = &adapter->hw;
+	struct ixgbe_rfs_filter *f, *tmp;
+	union ixgbe_atr_input mask;
+	int quota = IXGBE_RFS_EXPIRY_QUOTA;
+
+	if (list_empty(&adapter->rfs_list))
+		return;
+
+	if (!(adapter->flags & IXGBE_FLAG_FDIR_PERFECT_CAPABLE)) {
+		ixgbe_rfs_reset(adapter, true);
+		return;
+	}
+
+	if (test_bit(__IXGBE_DOWN, &adapter->state) ||
+	    test_bit(__IXGBE_RESETTING, &adapter->state))
+		return;
+
+	ixgbe_rfs_mask(&mask);
+
+	spin_lock_bh(&adapter->rfs_lock);
+	spin_lock(&adapter->fdir_perfect_lock);
+
+	list_for_each_entry_safe(f, tmp, &adapter->rfs_list, list) {
+		if (f->pending) {
+			f->pending = false;
+
+			/* the input mask is global, so only claim it when
+			 * nothing else has programmed a filter
+			 */
+			if (!adapter->rfs_hw_count &&
+			    hlist_empty(&adapter->fdir_filter_list)) {
+				memcpy(&adapter->fdir_mask, &mask, sizeof(mask));
+				ixgbe_fdir_set_input_mask_82599(hw, &mask);
+			}
+
+			if (f->rxq_index >= adapter->num_rx_queues ||
+			    memcmp(&adapter->fdir_mask, &mask, sizeof(mask)) ||
+			    ixgbe_fdir_write_perfect_filter_82599(hw,
+					&f->filter,
+					IXGBE_RFS_SW_IDX_BASE + f->id,
+					adapter->rx_ring[f->rxq_index]->reg_idx)) {
+				if (f->in_hw) {
+					ixgbe_fdir_erase_perfect_filter_82599(hw,
+						&f->filter,
+						IXGBE_RFS_SW_IDX_BASE + f->id);
+					adapter->rfs_hw_count--;
+				}
+				ixgbe_rfs_free(adapter, f);
+				continue;
+			}
+
+			if (!f->in_hw) {
+				f->in_hw = true;
+				adapter->rfs_hw_count++;
+			}
+			continue;
+		}
+
+		/* erasing polls the hardware, so bound the work per run */
+		if (!quota)
+			continue;
+
+		if (rps_may_expire_flow(adapter->netdev, f->rxq_index,
+					f->flow_id, f->id)) {
+			ixgbe_fdir_erase_perfect_filter_82599(hw, &f->filter,
+						IXGBE_RFS_SW_IDX_BASE + f->id);
+			adapter->rfs_hw_count--;
+			ixgbe_rfs_free(adapter, f);
+			quota--;
+		}
+	}
+
+	spin_unlock(&adapter->fdir_perfect_lock);
+	spin_unlock_bh(&adapter->rfs_lock);
+}
+
+static int ixgbe_rx_flow_steer(struct net_device *netdev,
+			       const struct sk_buff *skb,
+			       u16 rxq_index, u32 flow_id)
+{
+	struct ixgbe_adapter *adapter = netdev_priv(netdev);
+	struct ixgbe_rfs_filter *f;
+	union ixgbe_atr_input input, mask;
+	const struct iphdr *iph;
+	const __be16 *ports;
+	struct iphdr _iph;
+	__be16 _ports[2];
+	int nhoff = skb_network_offset(skb);
+	int id;
+
+	if (!(adapter->flags & IXGBE_FLAG_FDIR_PERFECT_CAPABLE))
+		return -EOPNOTSUPP;
+
+	if (rxq_index >= adapter->num_rx_queues)
+		return -EINVAL;
+
+	if (skb->protocol != htons(ETH_P_IP))
+		return -EPROTONOSUPPORT;
+
+	iph = skb_header_pointer(skb, nhoff, sizeof(_iph), &_iph);
+	if (!iph || ip_is_fragment(iph))
+		return -EPROTONOSUPPORT;
+
+	memset(&input, 0, sizeof(input));
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		input.formatted.flow_type = IXGBE_ATR_FLOW_TYPE_TCPV4;
+		break;
+	case IPPROTO_UDP:
+		input.formatted.flow_type = IXGBE_ATR_FLOW_TYPE_UDPV4;
+		break;
+	default:
+		return -EPROTONOSUPPORT;
+	}
+
+	ports = skb_header_pointer(skb, nhoff + 4 * iph->ihl,
+				   sizeof(_ports), _ports);
+	if (!ports)
+		return -EPROTONOSUPPORT;
+
+	input.formatted.src_ip[0] = iph->saddr;
+	input.formatted.dst_ip[0] = iph->daddr;
+	input.formatted.src_port = ports[0];
+	input.formatted.dst_port = ports[1];
+
+	ixgbe_rfs_mask(&mask);
+	ixgbe_atr_compute_perfect_hash_82599(&input, &mask);
+
+	spin_lock_bh(&adapter->rfs_lock);
+
+	hash_for_each_possible(adapter->rfs_hash, f, hash_node,
+			       input.formatted.bkt_hash) {
+		if (!memcmp(&f->filter, &input, sizeof(input)))
+			goto found;
+	}
+
+	id = find_first_zero_bit(adapter->rfs_ids, IXGBE_MAX_RFS_FILTERS);
+	if (id >= IXGBE_MAX_RFS_FILTERS) {
+		id = -EBUSY;
+		goto out;
+	}
+
+	f = kzalloc(sizeof(*f), GFP_ATOMIC);
+	if (!f) {
+		id = -ENOMEM;
+		goto out;
+	}
+
+	set_bit(id, adapter->rfs_ids);
+	f->id = id;
+	f->filter = input;
+	f->rxq_index = rxq_index;
+	hash_add(adapter->rfs_hash, &f->hash_node, input.formatted.bkt_hash);
+	list_add_tail(&f->list, &adapter->rfs_list);
+found:
+	f->flow_id = flow_id;
+	if (!f->in_hw || f->rxq_index != rxq_index) {
+		f->rxq_index = rxq_index;
+		f->pending = true;
+	}
+	id = f->id;
+out:
+	spin_unlock_bh(&adapter->rfs_lock);
+
+	if (id >= 0)
+		ixgbe_service_event_schedule(adapter);
+
+	return id;
+}
+
+#endif /* CONFIG_RFS_ACCEL */
+
 static void ixgbe_fdir_filter_restore(struct ixgbe_adapter *adapter)
 {
 	struct ixgbe_hw *hw = &adapter->hw;
 	struct hlist_node *node2;
 	struct ixgbe_fdir_filter *filter;
 
+#ifdef CONFIG_RFS_ACCEL
+	/* the service task reprograms these once we are back up */
+	ixgbe_rfs_reset(adapter, false);
+
+#endif
 	spin_lock(&adapter->fdir_perfect_lock);
 
 	if (!hlist_empty(&adapter->fdir_filter_list))
@@ -5055,6 +5439,10 @@ static void ixgbe_fdir_filter_exit(struct ixgbe_adapter *adapter)
 	struct hlist_node *node2;
 	struct ixgbe_fdir_filter *filter;
 
+#ifdef CONFIG_RFS_ACCEL
+	ixgbe_rfs_reset(adapter, true);
+
+#endif
 	spin_lock(&adapter->fdir_perfect_lock);
 
 	hlist_for_each_entry_safe(filter, node2,
@@ -5281,6 +5669,11 @@ static int ixgbe_sw_init(struct ixgbe_adapter *adapter)
 #endif
 	/* n-tuple support exists, always init our spinlock */
 	spin_lock_init(&adapter->fdir_perfect_lock);
+#ifdef CONFIG_RFS_ACCEL
+	spin_lock_init(&adapter->rfs_lock);
+	hash_init(adapter->rfs_hash);
+	INIT_LIST_HEAD(&adapter->rfs_list);
+#endif
 
 #ifdef CONFIG_IXGBE_DCB
 	switch (hw->mac.type) {
@@ -5636,6 +6029,11 @@ static int ixgbe_change_mtu(struct net_device *netdev, int new_mtu)
 	if ((new_mtu < 68) || (max_frame > IXGBE_MAX_JUMBO_FRAME_SIZE))
 		return -EINVAL;
 
+	/* XDP needs every frame to fit in a single rx buffer */
+	if (rtnl_dereference(adapter->xdp_prog) &&
+	    max_frame + VLAN_HLEN > IXGBE_RXBUFFER_2K)
+		return -EINVAL;
+
 	/*
 	 * For 82599EB we cannot allow legacy VFs to enable their receive
 	 * paths when MTU greater than 1500 is configured.  So display a
@@ -6764,6 +7162,9 @@ static void ixgbe_service_task(struct work_struct *work)
 	ixgbe_check_overtemp_subtask(adapter);
 	ixgbe_watchdog_subtask(adapter);
 	ixgbe_fdir_reinit_subtask(adapter);
+#ifdef CONFIG_RFS_ACCEL
+	ixgbe_rfs_subtask(adapter);
+#endif
 	ixgbe_check_hang_subtask(adapter);
 
 	if (test_bit(__IXGBE_PTP_RUNNING, &adapter->state)) {
@@ -7132,6 +7533,12 @@ static void ixgbe_tx_map(struct ixgbe_ring *tx_ring,
 dma_error:
 	dev_err(tx_ring->dev, "TX DMA map failed\n");
 
+	/* if this frame was to end an xmit_more burst, the frames queued
+	 * ahead of it are still waiting on a tail update
+	 */
+	if (!skb->xmit_more)
+		writel(first - tx_ring->tx_buffer_info, tx_ring->tail);
+
 	/* clear dma mappings for failed tx_buffer_info map */
 	for (;;) {
 		tx_buffer = &tx_ring->tx_buffer_info[i];
@@ -7406,6 +7813,9 @@ xmit_fcoe:
 	return NETDEV_TX_OK;
 
 out_drop:
+	/* frames queued ahead of this one may be waiting on the tail */
+	if (!first->skb->xmit_more)
+		writel(tx_ring->next_to_use, tx_ring->tail);
 	dev_kfree_skb_any(first->skb);
 	first->skb = NULL;
 
@@ -7779,6 +8189,10 @@ static netdev_features_t ixgbe_fix_features(struct net_device *netdev,
 	if (!(adapter->flags2 & IXGBE_FLAG2_RSC_CAPABLE))
 		features &= ~NETIF_F_LRO;
 
+	/* XDP programs only see single buffer frames, no RSC */
+	if (rtnl_dereference(adapter->xdp_prog))
+		features &= ~NETIF_F_LRO;
+
 	return features;
 }
 
@@ -8147,6 +8561,48 @@ static void ixgbe_fwd_del(struct net_device *pdev, void *priv)
 	kfree(fwd_adapter);
 }
 
+static int ixgbe_xdp_setup(struct net_device *dev, struct bpf_prog *prog)
+{
+	struct ixgbe_adapter *adapter = netdev_priv(dev);
+	int frame_size = dev->mtu + ETH_HLEN + ETH_FCS_LEN + VLAN_HLEN;
+	struct bpf_prog *old_prog;
+
+	if (prog && frame_size > IXGBE_RXBUFFER_2K) {
+		e_dev_err("MTU too large to run XDP\n");
+		return -EINVAL;
+	}
+
+	old_prog = rtnl_dereference(adapter->xdp_prog);
+	rcu_assign_pointer(adapter->xdp_prog, prog);
+
+	if (old_prog) {
+		/* wait for the rings to stop running it */
+		synchronize_rcu();
+		bpf_prog_put(old_prog);
+	}
+
+	/* RSC is turned off while a program is attached */
+	if (!old_prog != !prog)
+		netdev_update_features(dev);
+
+	return 0;
+}
+
+static int ixgbe_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+{
+	struct ixgbe_adapter *adapter = netdev_priv(dev);
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return ixgbe_xdp_setup(dev, xdp->prog);
+	case XDP_QUERY_PROG:
+		xdp->prog_attached = !!rtnl_dereference(adapter->xdp_prog);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static const struct net_device_ops ixgbe_netdev_ops = {
 	.ndo_open		= ixgbe_open,
 	.ndo_stop		= ixgbe_close,
@@ -8176,6 +8632,9 @@ static const struct net_device_ops ixgbe_netdev_ops = {
 #ifdef CONFIG_NET_RX_BUSY_POLL
 	.ndo_busy_poll		= ixgbe_low_latency_recv,
 #endif
+#ifdef CONFIG_RFS_ACCEL
+	.ndo_rx_flow_steer	= ixgbe_rx_flow_steer,
+#endif
 #ifdef IXGBE_FCOE
 	.ndo_fcoe_ddp_setup = ixgbe_fcoe_ddp_get,
 	.ndo_fcoe_ddp_target = ixgbe_fcoe_ddp_target,
@@ -8194,6 +8653,7 @@ static const struct net_device_ops ixgbe_netdev_ops = {
 	.ndo_dfwd_del_station	= ixgbe_fwd_del,
 	.ndo_add_vxlan_port	= ixgbe_add_vxlan_port,
 	.ndo_del_vxlan_port	= ixgbe_del_vxlan_port,
+	.ndo_xdp		= ixgbe_xdp,
 };
 
 /**
@@ -94,6 +94,29 @@ err_cq:
 	return err;
 }
 
+/*
+ * Adaptive rx moderation: net_dim profiles are spread evenly between
+ * the rx_usecs_low and rx_usecs_high ethtool settings.
+ */
+static void mlx4_en_rx_dim_apply(struct net_dim *dim, unsigned int profile_ix)
+{
+	struct mlx4_en_cq *cq = container_of(dim, struct mlx4_en_cq, dim);
+	struct mlx4_en_priv *priv = netdev_priv(cq->dev);
+	int err;
+
+	if (!priv->adaptive_rx_coal)
+		return;
+
+	cq->moder_time = priv->rx_usecs_low + profile_ix *
+		(priv->rx_usecs_high - priv->rx_usecs_low) /
+		(NET_DIM_PARAMS_NUM_PROFILES - 1);
+	cq->moder_cnt = priv->rx_frames;
+	err = mlx4_en_set_cq_moder(priv, cq);
+	if (err)
+		en_err(priv, "Failed modifying moderation for cq:%d\n",
+		       cq->ring);
+}
+
 int mlx4_en_activate_cq(struct mlx4_en_priv *priv, struct mlx4_en_cq *cq,
 			int cq_idx)
 {
@@ -175,6 +198,8 @@ int mlx4_en_activate_cq(struct mlx4_en_priv *priv, struct mlx4_en_cq *cq,
 		if (err)
 			mlx4_warn(mdev, "Failed setting affinity hint\n");
 
+		net_dim_init(&cq->dim, MLX4_EN_DIM_DEF_PROFILE,
+			     mlx4_en_rx_dim_apply);
 		netif_napi_add(cq->dev, &cq->napi, mlx4_en_poll_rx_cq, 64);
 		napi_hash_add(&cq->napi);
 	}
@@ -205,6 +230,7 @@ void mlx4_en_deactivate_cq(struct mlx4_en_priv *priv, struct mlx4_en_cq *cq)
 {
 	napi_disable(&cq->napi);
 	if (!cq->is_tx) {
+		net_dim_cancel(&cq->dim);
 		napi_hash_del(&cq->napi);
 		synchronize_rcu();
 		irq_set_affinity_hint(cq->mcq.irq, NULL);
@@ -41,6 +41,8 @@
 #include <linux/if_vlan.h>
 #include <linux/vmalloc.h>
 #include <linux/irq.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
 
 #if IS_ENABLED(CONFIG_IPV6)
 #include <net/ip6_checksum.h>
@@ -748,6 +750,8 @@ int mlx4_en_process_rx_cq(struct net_device *dev, struct mlx4_en_cq *cq, int bud
 	int factor = priv->cqe_factor;
 	u64 timestamp;
 	bool l2_tunnel;
+	struct bpf_prog *xdp_prog;
+	u32 xdp_act;
 
 	if (!priv->port_up)
 		return 0;
@@ -755,6 +759,9 @@ int mlx4_en_process_rx_cq(struct net_device *dev, struct mlx4_en_cq *cq, int bud
 	if (budget <= 0)
 		return polled;
 
+	rcu_read_lock();
+	xdp_prog = rcu_dereference(priv->xdp_prog);
+
 	/* We assume a 1:1 mapping between CQEs and Rx descriptors, so Rx
 	 * descriptor offset can be deduced from the CQE index instead of
 	 * reading 'cqe->index' */
@@ -828,6 +835,35 @@ int mlx4_en_process_rx_cq(struct net_device *dev, struct mlx4_en_cq *cq, int bud
 		length -= ring->fcs_del;
 		ring->bytes += length;
 		ring->packets++;
+
+		/* Frames that fit in the first fragment are shown to the XDP
+		 * program straight from the rx buffer. A dropped frame never
+		 * gets an skb, its fragments are released below as for any
+		 * other discarded completion.
+		 */
+		xdp_act = XDP_PASS;
+		if (xdp_prog && length <= priv->frag_info[0].frag_size) {
+			struct xdp_buff xdp;
+			dma_addr_t dma;
+
+			dma = be64_to_cpu(rx_desc->data[0].addr);
+			dma_sync_single_for_cpu(priv->ddev, dma, length,
+						DMA_FROM_DEVICE);
+			xdp.data = page_address(frags[0].page) +
+				   frags[0].page_offset;
+			xdp.len = length;
+
+			xdp_act = bpf_prog_run_xdp(xdp_prog, &xdp);
+			switch (xdp_act) {
+			case XDP_PASS:
+			case XDP_TX:
+				break;
+			case XDP_ABORTED:
+			case XDP_DROP:
+			default:
+				goto next;
+			}
+		}
 		l2_tunnel = (dev->hw_enc_features & NETIF_F_RXCSUM) &&
 			(cqe->vlan_my_qpn & cpu_to_be32(MLX4_CQE_L2_TUNNEL));
 
@@ -865,7 +901,7 @@ int mlx4_en_process_rx_cq(struct net_device *dev, struct mlx4_en_cq *cq, int bud
 		 * - not an IP fragment
 		 * - no LLS polling in progress
 		 */
-		if (!mlx4_en_cq_busy_polling(cq) &&
+		if (!mlx4_en_cq_busy_polling(cq) && xdp_act != XDP_TX &&
 		    (dev->features & NETIF_F_GRO)) {
 			struct sk_buff *gro_skb = napi_get_frags(&cq->napi);
 			if (!gro_skb)
@@ -933,6 +969,14 @@ int mlx4_en_process_rx_cq(struct net_device *dev, struct mlx4_en_cq *cq, int bud
 			goto next;
 		}
 
+		if (xdp_act == XDP_TX) {
+			/* skb->data is still at the MAC header */
+			skb->dev = dev;
+			skb_record_rx_queue(skb, cq->ring);
+			netif_xdp_xmit(skb);
+			goto next;
+		}
+
 		if (ip_summed == CHECKSUM_COMPLETE) {
 			if (check_csum(cqe, skb, skb->data, ring->hwtstamp_rx_filter)) {
 				ip_summed = CHECKSUM_NONE;
@@ -983,6 +1027,7 @@ next:
 	}
 
 out:
+	rcu_read_unlock();
 	AVG_PERF_COUNTER(priv->pstats.rx_coal_avg, polled);
 	mlx4_cq_set_ci(&cq->mcq);
 	wmb(); /* ensure HW sees CQ consumer before we post new buffers */
@@ -1040,6 +1085,16 @@ int mlx4_en_poll_rx_cq(struct napi_struct *napi, int budget)
 	}
 	/* Done for now */
 	napi_complete_done(napi, done);
+
+	if (priv->adaptive_rx_coal) {
+		struct mlx4_en_rx_ring *ring = priv->rx_ring[cq->ring];
+		struct net_dim_sample sample;
+
+		net_dim_sample(cq->event_ctr++, ring->packets, ring->bytes,
+			       &sample);
+		net_dim(&cq->dim, &sample);
+	}
+
 	mlx4_en_arm_cq(priv, cq);
 	return done;
 }
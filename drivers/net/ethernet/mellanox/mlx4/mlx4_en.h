@@ -41,6 +41,7 @@
 #include <linux/netdevice.h>
 #include <linux/if_vlan.h>
 #include <linux/net_tstamp.h>
+#include <linux/net_dim.h>
 #ifdef CONFIG_MLX4_EN_DCB
 #include <linux/dcbnl.h>
 #endif
@@ -144,9 +145,8 @@ enum {
 #define MLX4_EN_RX_RATE_HIGH		450000
 #define MLX4_EN_RX_COAL_TIME_HIGH	128
 #define MLX4_EN_RX_SIZE_THRESH		1024
-#define MLX4_EN_RX_RATE_THRESH		(1000000 / MLX4_EN_RX_COAL_TIME_HIGH)
 #define MLX4_EN_SAMPLE_INTERVAL		0
-#define MLX4_EN_AVG_PKT_SMALL		256
+#define MLX4_EN_DIM_DEF_PROFILE		1
 
 #define MLX4_EN_AUTO_CONF	0xffff
 
@@ -342,6 +342,8 @@ struct mlx4_en_cq {
 	enum cq_type is_tx;
 	u16 moder_time;
 	u16 moder_cnt;
+	struct net_dim dim;	/* adaptive rx moderation */
+	u16 event_ctr;
 	struct mlx4_cqe *buf;
 #define MLX4_EN_OPCODE_ERROR	0x1e
 
@@ -504,11 +506,6 @@ struct mlx4_en_priv {
 	/* To allow rules removal while port is going down */
 	struct list_head ethtool_list;
 
-	unsigned long last_moder_packets[MAX_RX_RINGS];
-	unsigned long last_moder_tx_packets;
-	unsigned long last_moder_bytes[MAX_RX_RINGS];
-	unsigned long last_moder_jiffies;
-	int last_moder_time[MAX_RX_RINGS];
 	u16 rx_usecs;
 	u16 rx_frames;
 	u16 tx_usecs;
@@ -549,6 +546,7 @@ struct mlx4_en_priv {
 	struct mlx4_en_frag_info frag_info[MLX4_EN_MAX_RX_FRAGS];
 	u16 num_frags;
 	u16 log_rx_info;
+	struct bpf_prog __rcu *xdp_prog;
 
 	struct mlx4_en_tx_ring **tx_ring;
 	struct mlx4_en_rx_ring *rx_ring[MAX_RX_RINGS];
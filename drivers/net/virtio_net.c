@@ -932,6 +932,9 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 				 "Unexpected TXQ (%d) queue failure: %d\n", qnum, err);
 		dev->stats.tx_dropped++;
 		dev_kfree_skb_any(skb);
+		/* earlier buffers of an xmit_more burst still need a kick */
+		if (kick || netif_xmit_stopped(txq))
+			virtqueue_kick(sq->vq);
 		return NETDEV_TX_OK;
 	}
 
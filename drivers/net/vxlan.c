@@ -662,11 +662,9 @@ static void vxlan_notify_add_rx_port(struct vxlan_sock *vs)
 	__be16 port = inet_sk(sk)->inet_sport;
 	int err;
 
-	if (sa_family == AF_INET) {
-		err = udp_add_offload(&vs->udp_offloads);
-		if (err)
-			pr_warn("vxlan: udp_add_offload failed with status %d\n", err);
-	}
+	err = udp_add_offload(&vs->udp_offloads);
+	if (err)
+		pr_warn("vxlan: udp_add_offload failed with status %d\n", err);
 
 	rcu_read_lock();
 	for_each_netdev_rcu(net, dev) {
@@ -694,8 +692,7 @@ static void vxlan_notify_del_rx_port(struct vxlan_sock *vs)
 	}
 	rcu_read_unlock();
 
-	if (sa_family == AF_INET)
-		udp_del_offload(&vs->udp_offloads);
+	udp_del_offload(&vs->udp_offloads);
 }
 
 /* Add new entry to forwarding table -- assumes lock held */
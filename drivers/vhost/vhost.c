@@ -36,6 +36,18 @@ enum {
 #define vhost_used_event(vq) ((__virtio16 __user *)&vq->avail->ring[vq->num])
 #define vhost_avail_event(vq) ((__virtio16 __user *)&vq->used->ring[vq->num])
 
+/* Packed ring indices run freely; vq->num is a power of two so they wrap
+ * consistently at 2^16. */
+static inline u16 vhost_packed_pos(struct vhost_virtqueue *vq, u16 idx)
+{
+	return idx & (vq->num - 1);
+}
+
+static inline bool vhost_packed_wrap(struct vhost_virtqueue *vq, u16 idx)
+{
+	return !((idx / vq->num) & 1);
+}
+
 static void vhost_poll_func(struct file *file, wait_queue_head_t *wqh,
 			    poll_table *pt)
 {
@@ -168,6 +180,13 @@ void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work)
 }
 EXPORT_SYMBOL_GPL(vhost_work_queue);
 
+/* A busy polling worker should stop as soon as anything else is queued. */
+bool vhost_has_work(struct vhost_dev *dev)
+{
+	return !list_empty(&dev->work_list);
+}
+EXPORT_SYMBOL_GPL(vhost_has_work);
+
 void vhost_poll_queue(struct vhost_poll *poll)
 {
 	vhost_work_queue(poll->dev, &poll->work);
@@ -181,6 +200,10 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 	vq->desc = NULL;
 	vq->avail = NULL;
 	vq->used = NULL;
+	vq->desc_packed = NULL;
+	vq->driver_event = NULL;
+	vq->device_event = NULL;
+	vq->packed_fetched = 0;
 	vq->last_avail_idx = 0;
 	vq->avail_idx = 0;
 	vq->last_used_idx = 0;
@@ -199,6 +222,7 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 	vq->call = NULL;
 	vq->log_ctx = NULL;
 	vq->memory = NULL;
+	vq->busyloop_timeout = 0;
 }
 
 static int vhost_worker(void *data)
@@ -258,6 +282,10 @@ static void vhost_vq_free_iovecs(struct vhost_virtqueue *vq)
 	vq->log = NULL;
 	kfree(vq->heads);
 	vq->heads = NULL;
+	kfree(vq->packed_hist);
+	vq->packed_hist = NULL;
+	kfree(vq->packed_count);
+	vq->packed_count = NULL;
 }
 
 /* Helper to allocate iovec buffers for all vqs. */
@@ -272,7 +300,9 @@ static long vhost_dev_alloc_iovecs(struct vhost_dev *dev)
 				       GFP_KERNEL);
 		vq->log = kmalloc(sizeof *vq->log * UIO_MAXIOV, GFP_KERNEL);
 		vq->heads = kmalloc(sizeof *vq->heads * UIO_MAXIOV, GFP_KERNEL);
-		if (!vq->indirect || !vq->log || !vq->heads)
+		vq->packed_hist = kmalloc(sizeof *vq->packed_hist * UIO_MAXIOV,
+					  GFP_KERNEL);
+		if (!vq->indirect || !vq->log || !vq->heads || !vq->packed_hist)
 			goto err_nomem;
 	}
 	return 0;
@@ -313,6 +343,8 @@ void vhost_dev_init(struct vhost_dev *dev,
 		vq->log = NULL;
 		vq->indirect = NULL;
 		vq->heads = NULL;
+		vq->packed_hist = NULL;
+		vq->packed_count = NULL;
 		vq->dev = dev;
 		mutex_init(&vq->mutex);
 		vhost_vq_reset(dev, vq);
@@ -552,6 +584,15 @@ static int vq_access_ok(struct vhost_virtqueue *vq, unsigned int num,
 			struct vring_used __user *used)
 {
 	size_t s = vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX) ? 2 : 0;
+
+	if (vhost_vq_is_packed(vq))
+		return access_ok(VERIFY_WRITE, desc,
+				 num * sizeof(struct vring_packed_desc)) &&
+		       access_ok(VERIFY_READ, avail,
+				 sizeof(struct vring_packed_desc_event)) &&
+		       access_ok(VERIFY_WRITE, used,
+				 sizeof(struct vring_packed_desc_event));
+
 	return access_ok(VERIFY_READ, desc, num * sizeof *desc) &&
 	       access_ok(VERIFY_READ, avail,
 			 sizeof *avail + num * sizeof *avail->ring + s) &&
@@ -573,12 +614,14 @@ static int vq_log_access_ok(struct vhost_virtqueue *vq,
 			    void __user *log_base)
 {
 	size_t s = vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX) ? 2 : 0;
+	size_t sz = sizeof *vq->used + vq->num * sizeof *vq->used->ring + s;
+
+	if (vhost_vq_is_packed(vq))
+		sz = vq->num * sizeof(struct vring_packed_desc);
 
 	return vq_memory_access_ok(log_base, vq->memory,
 				   vhost_has_feature(vq, VHOST_F_LOG_ALL)) &&
-		(!vq->log_used || log_access_ok(log_base, vq->log_addr,
-					sizeof *vq->used +
-					vq->num * sizeof *vq->used->ring + s));
+		(!vq->log_used || log_access_ok(log_base, vq->log_addr, sz));
 }
 
 /* Can we start vq? */
@@ -696,6 +739,19 @@ long vhost_vring_ioctl(struct vhost_dev *d, int ioctl, void __user *argp)
 		if (copy_to_user(argp, &s, sizeof s))
 			r = -EFAULT;
 		break;
+	case VHOST_SET_VRING_BUSYLOOP_TIMEOUT:
+		if (copy_from_user(&s, argp, sizeof(s))) {
+			r = -EFAULT;
+			break;
+		}
+		vq->busyloop_timeout = s.num;
+		break;
+	case VHOST_GET_VRING_BUSYLOOP_TIMEOUT:
+		s.index = idx;
+		s.num = vq->busyloop_timeout;
+		if (copy_to_user(argp, &s, sizeof(s)))
+			r = -EFAULT;
+		break;
 	case VHOST_SET_VRING_ADDR:
 		if (copy_from_user(&a, argp, sizeof a)) {
 			r = -EFAULT;
@@ -739,6 +795,8 @@ long vhost_vring_ioctl(struct vhost_dev *d, int ioctl, void __user *argp)
 			/* Also validate log access for used ring if enabled. */
 			if ((a.flags & (0x1 << VHOST_VRING_F_LOG)) &&
 			    !log_access_ok(vq->log_base, a.log_guest_addr,
+					   vhost_vq_is_packed(vq) ?
+					   vq->num * sizeof *vq->desc_packed :
 					   sizeof *vq->used +
 					   vq->num * sizeof *vq->used->ring)) {
 				r = -EINVAL;
@@ -751,6 +809,9 @@ long vhost_vring_ioctl(struct vhost_dev *d, int ioctl, void __user *argp)
 		vq->avail = (void __user *)(unsigned long)a.avail_user_addr;
 		vq->log_addr = a.log_guest_addr;
 		vq->used = (void __user *)(unsigned long)a.used_user_addr;
+		vq->desc_packed = (void __user *)vq->desc;
+		vq->driver_event = (void __user *)vq->avail;
+		vq->device_event = (void __user *)vq->used;
 		break;
 	case VHOST_SET_VRING_KICK:
 		if (copy_from_user(&f, argp, sizeof f)) {
@@ -1040,6 +1101,51 @@ static int vhost_update_avail_event(struct vhost_virtqueue *vq, u16 avail_event)
 	return 0;
 }
 
+/* Packed ring counterpart of vhost_update_used_flags and
+ * vhost_update_avail_event: publish whether, and from which descriptor on,
+ * we want to be kicked. */
+static int vhost_update_device_event(struct vhost_virtqueue *vq)
+{
+	u16 flags, off_wrap;
+
+	if (vq->used_flags & VRING_USED_F_NO_NOTIFY)
+		flags = VRING_PACKED_EVENT_FLAG_DISABLE;
+	else if (vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX))
+		flags = VRING_PACKED_EVENT_FLAG_DESC;
+	else
+		flags = VRING_PACKED_EVENT_FLAG_ENABLE;
+
+	if (flags == VRING_PACKED_EVENT_FLAG_DESC) {
+		off_wrap = vhost_packed_pos(vq, vq->last_avail_idx) |
+			   vhost_packed_wrap(vq, vq->last_avail_idx) <<
+			   VRING_PACKED_EVENT_F_WRAP_CTR;
+		if (__put_user(cpu_to_le16(off_wrap),
+			       &vq->device_event->off_wrap))
+			return -EFAULT;
+		/* Make sure the offset is seen before the flags. */
+		smp_wmb();
+	}
+	if (__put_user(cpu_to_le16(flags), &vq->device_event->flags))
+		return -EFAULT;
+	return 0;
+}
+
+static int vhost_init_used_packed(struct vhost_virtqueue *vq)
+{
+	u16 *count;
+
+	count = kcalloc(vq->num, sizeof *count, GFP_KERNEL);
+	if (!count)
+		return -ENOMEM;
+	kfree(vq->packed_count);
+	vq->packed_count = count;
+
+	/* Everything fetched before the ring was stopped has been used. */
+	vq->last_used_idx = vq->last_avail_idx;
+	vq->signalled_used_valid = false;
+	return vhost_update_device_event(vq);
+}
+
 int vhost_init_used(struct vhost_virtqueue *vq)
 {
 	__virtio16 last_used_idx;
@@ -1047,6 +1153,9 @@ int vhost_init_used(struct vhost_virtqueue *vq)
 	if (!vq->private_data)
 		return 0;
 
+	if (vhost_vq_is_packed(vq))
+		return vhost_init_used_packed(vq);
+
 	r = vhost_update_used_flags(vq);
 	if (r)
 		return r;
@@ -1208,6 +1317,200 @@ static int get_indirect(struct vhost_virtqueue *vq,
 	return 0;
 }
 
+/* Translate a single packed descriptor (direct or from an indirect table)
+ * and account it as input or output. */
+static int packed_desc_to_iov(struct vhost_virtqueue *vq,
+			      struct vring_packed_desc *desc,
+			      struct iovec iov[], unsigned int iov_size,
+			      unsigned int *out_num, unsigned int *in_num,
+			      struct vhost_log *log, unsigned int *log_num)
+{
+	unsigned iov_count = *in_num + *out_num;
+	u64 addr = le64_to_cpu(desc->addr);
+	u32 len = le32_to_cpu(desc->len);
+	int ret;
+
+	ret = translate_desc(vq, addr, len, iov + iov_count,
+			     iov_size - iov_count);
+	if (unlikely(ret < 0)) {
+		vq_err(vq, "Translation failure %d in packed descriptor\n",
+		       ret);
+		return ret;
+	}
+	if (desc->flags & cpu_to_le16(VRING_DESC_F_WRITE)) {
+		/* If this is an input descriptor,
+		 * increment that count. */
+		*in_num += ret;
+		if (unlikely(log)) {
+			log[*log_num].addr = addr;
+			log[*log_num].len = len;
+			++*log_num;
+		}
+	} else {
+		/* If it's an output descriptor, they're all supposed
+		 * to come before any input descriptors. */
+		if (unlikely(*in_num)) {
+			vq_err(vq, "Packed descriptor has out after in\n");
+			return -EINVAL;
+		}
+		*out_num += ret;
+	}
+	return 0;
+}
+
+static int get_indirect_packed(struct vhost_virtqueue *vq,
+			       struct iovec iov[], unsigned int iov_size,
+			       unsigned int *out_num, unsigned int *in_num,
+			       struct vhost_log *log, unsigned int *log_num,
+			       struct vring_packed_desc *indirect)
+{
+	struct vring_packed_desc desc;
+	unsigned int i, count;
+	u32 len = le32_to_cpu(indirect->len);
+	struct iov_iter from;
+	int ret;
+
+	/* Sanity check */
+	if (unlikely(len % sizeof desc)) {
+		vq_err(vq, "Invalid length in indirect descriptor: "
+		       "len 0x%llx not multiple of 0x%zx\n",
+		       (unsigned long long)len,
+		       sizeof desc);
+		return -EINVAL;
+	}
+
+	ret = translate_desc(vq, le64_to_cpu(indirect->addr), len,
+			     vq->indirect, UIO_MAXIOV);
+	if (unlikely(ret < 0)) {
+		vq_err(vq, "Translation failure %d in indirect.\n", ret);
+		return ret;
+	}
+	iov_iter_init(&from, READ, vq->indirect, ret, len);
+
+	/* We will use the result as an address to read from, so most
+	 * architectures only need a compiler barrier here. */
+	read_barrier_depends();
+
+	count = len / sizeof desc;
+	if (unlikely(count > USHRT_MAX + 1)) {
+		vq_err(vq, "Indirect buffer length too big: %d\n", len);
+		return -E2BIG;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (unlikely(copy_from_iter(&desc, sizeof(desc), &from) !=
+			     sizeof(desc))) {
+			vq_err(vq, "Failed indirect descriptor: idx %d, %zx\n",
+			       i, (size_t)le64_to_cpu(indirect->addr) +
+			       i * sizeof desc);
+			return -EINVAL;
+		}
+		if (unlikely(desc.flags & cpu_to_le16(VRING_DESC_F_INDIRECT))) {
+			vq_err(vq, "Nested indirect descriptor: idx %d, %zx\n",
+			       i, (size_t)le64_to_cpu(indirect->addr) +
+			       i * sizeof desc);
+			return -EINVAL;
+		}
+		ret = packed_desc_to_iov(vq, &desc, iov, iov_size,
+					 out_num, in_num, log, log_num);
+		if (unlikely(ret < 0))
+			return ret;
+	}
+	return 0;
+}
+
+/* Is the descriptor at free running index @idx available to us? */
+static int vhost_packed_desc_avail(struct vhost_virtqueue *vq, u16 idx,
+				   bool *avail)
+{
+	bool wrap = vhost_packed_wrap(vq, idx);
+	__le16 flags;
+
+	if (unlikely(__get_user(flags,
+			&vq->desc_packed[vhost_packed_pos(vq, idx)].flags)))
+		return -EFAULT;
+
+	*avail = !!(flags & cpu_to_le16(1 << VRING_PACKED_DESC_F_AVAIL)) == wrap &&
+		 !!(flags & cpu_to_le16(1 << VRING_PACKED_DESC_F_USED)) != wrap;
+	return 0;
+}
+
+static int vhost_get_vq_desc_packed(struct vhost_virtqueue *vq,
+				    struct iovec iov[], unsigned int iov_size,
+				    unsigned int *out_num, unsigned int *in_num,
+				    struct vhost_log *log, unsigned int *log_num)
+{
+	struct vring_packed_desc desc;
+	unsigned int found = 0;
+	u16 idx = vq->last_avail_idx, id = 0;
+	bool avail;
+	int ret;
+
+	ret = vhost_packed_desc_avail(vq, idx, &avail);
+	if (unlikely(ret)) {
+		vq_err(vq, "Failed to access descriptor flags at %p\n",
+		       vq->desc_packed + vhost_packed_pos(vq, idx));
+		return ret;
+	}
+
+	/* If there's nothing new since last we looked, return invalid. */
+	if (!avail)
+		return vq->num;
+
+	/* Only read descriptors after they have been exposed by guest. */
+	smp_rmb();
+
+	/* When we start there are none of either input nor output. */
+	*out_num = *in_num = 0;
+	if (unlikely(log))
+		*log_num = 0;
+
+	do {
+		u16 pos = vhost_packed_pos(vq, idx);
+
+		if (unlikely(++found > vq->num)) {
+			vq_err(vq, "Loop detected: last one at %u "
+			       "vq size %u\n", pos, vq->num);
+			return -EINVAL;
+		}
+		ret = __copy_from_user(&desc, vq->desc_packed + pos,
+				       sizeof desc);
+		if (unlikely(ret)) {
+			vq_err(vq, "Failed to get descriptor: idx %d addr %p\n",
+			       pos, vq->desc_packed + pos);
+			return -EFAULT;
+		}
+		id = le16_to_cpu(desc.id);
+		if (desc.flags & cpu_to_le16(VRING_DESC_F_INDIRECT))
+			ret = get_indirect_packed(vq, iov, iov_size,
+						  out_num, in_num,
+						  log, log_num, &desc);
+		else
+			ret = packed_desc_to_iov(vq, &desc, iov, iov_size,
+						 out_num, in_num,
+						 log, log_num);
+		if (unlikely(ret < 0)) {
+			vq_err(vq, "Failure detected "
+			       "in descriptor at idx %d\n", pos);
+			return ret;
+		}
+		idx++;
+	} while (desc.flags & cpu_to_le16(VRING_DESC_F_NEXT));
+
+	/* The buffer id is carried by the last descriptor of the chain. */
+	if (unlikely(id >= vq->num)) {
+		vq_err(vq, "Guest says buffer id %u > %u is available",
+		       id, vq->num);
+		return -EINVAL;
+	}
+
+	/* On success, remember how far to move on when it is used. */
+	vq->packed_count[id] = found;
+	vq->packed_hist[vq->packed_fetched++ % UIO_MAXIOV] = found;
+	vq->last_avail_idx = idx;
+	return id;
+}
+
 /* This looks in the virtqueue and for the first available buffer, and converts
  * it to an iovec for convenient access.  Since descriptors consist of some
  * number of output then some number of input descriptors, it's actually two
@@ -1228,6 +1531,11 @@ int vhost_get_vq_desc(struct vhost_virtqueue *vq,
 	__virtio16 ring_head;
 	int ret;
 
+	if (vhost_vq_is_packed(vq))
+		return vhost_get_vq_desc_packed(vq, iov, iov_size,
+						out_num, in_num,
+						log, log_num);
+
 	/* Check it isn't doing very strange things with descriptor numbers. */
 	last_avail_idx = vq->last_avail_idx;
 	if (unlikely(__get_user(avail_idx, &vq->avail->idx))) {
@@ -1348,6 +1656,13 @@ EXPORT_SYMBOL_GPL(vhost_get_vq_desc);
 /* Reverse the effect of vhost_get_vq_desc. Useful for error handling. */
 void vhost_discard_vq_desc(struct vhost_virtqueue *vq, int n)
 {
+	if (vhost_vq_is_packed(vq)) {
+		/* Heads are discarded in reverse order of fetching. */
+		while (n-- > 0)
+			vq->last_avail_idx -=
+				vq->packed_hist[--vq->packed_fetched % UIO_MAXIOV];
+		return;
+	}
 	vq->last_avail_idx -= n;
 }
 EXPORT_SYMBOL_GPL(vhost_discard_vq_desc);
@@ -1408,6 +1723,82 @@ static int __vhost_add_used_n(struct vhost_virtqueue *vq,
 	return 0;
 }
 
+/* Used descriptors overwrite the descriptor ring in place, each skipping
+ * over as many descriptors as the buffer took when it was made available. */
+static int vhost_add_used_n_packed(struct vhost_virtqueue *vq,
+				   struct vring_used_elem *heads,
+				   unsigned count)
+{
+	struct vring_packed_desc __user *desc, *first = NULL;
+	u16 old, new, flags, uninitialized_var(first_flags);
+	unsigned int i;
+
+	old = vq->last_used_idx;
+	for (i = 0; i < count; i++) {
+		u32 id = vhost32_to_cpu(vq, heads[i].id);
+		u32 len = vhost32_to_cpu(vq, heads[i].len);
+
+		if (unlikely(id >= vq->num)) {
+			vq_err(vq, "Used id %u out of range\n", id);
+			return -EINVAL;
+		}
+		desc = vq->desc_packed + vhost_packed_pos(vq, vq->last_used_idx);
+		flags = len ? VRING_DESC_F_WRITE : 0;
+		if (vhost_packed_wrap(vq, vq->last_used_idx))
+			flags |= 1 << VRING_PACKED_DESC_F_AVAIL |
+				 1 << VRING_PACKED_DESC_F_USED;
+
+		if (__put_user(cpu_to_le16(id), &desc->id)) {
+			vq_err(vq, "Failed to write used id");
+			return -EFAULT;
+		}
+		if (__put_user(cpu_to_le32(len), &desc->len)) {
+			vq_err(vq, "Failed to write used len");
+			return -EFAULT;
+		}
+		/* The first descriptor is exposed last, below: the guest
+		 * only looks at the following ones once it has seen it. */
+		if (!first) {
+			first = desc;
+			first_flags = flags;
+		} else if (__put_user(cpu_to_le16(flags), &desc->flags)) {
+			vq_err(vq, "Failed to write used flags");
+			return -EFAULT;
+		}
+		if (unlikely(vq->log_used)) {
+			/* Make sure data is seen before log. */
+			smp_wmb();
+			log_write(vq->log_base, vq->log_addr +
+				  ((void __user *)desc -
+				   (void __user *)vq->desc_packed),
+				  sizeof *desc);
+		}
+		vq->last_used_idx += vq->packed_count[id];
+	}
+	if (!first)
+		return 0;
+
+	/* Make sure buffer is written before we expose it. */
+	smp_wmb();
+	if (__put_user(cpu_to_le16(first_flags), &first->flags)) {
+		vq_err(vq, "Failed to write used flags");
+		return -EFAULT;
+	}
+	if (unlikely(vq->log_used)) {
+		/* Log the flags update of the first descriptor. */
+		log_write(vq->log_base, vq->log_addr +
+			  ((void __user *)first -
+			   (void __user *)vq->desc_packed),
+			  sizeof *first);
+		if (vq->log_ctx)
+			eventfd_signal(vq->log_ctx, 1);
+	}
+	new = vq->last_used_idx;
+	if (unlikely((u16)(new - vq->signalled_used) < (u16)(new - old)))
+		vq->signalled_used_valid = false;
+	return 0;
+}
+
 /* After we've used one of their buffers, we tell them about it.  We'll then
  * want to notify the guest, using eventfd. */
 int vhost_add_used_n(struct vhost_virtqueue *vq, struct vring_used_elem *heads,
@@ -1415,6 +1806,9 @@ int vhost_add_used_n(struct vhost_virtqueue *vq, struct vring_used_elem *heads,
 {
 	int start, n, r;
 
+	if (vhost_vq_is_packed(vq))
+		return vhost_add_used_n_packed(vq, heads, count);
+
 	start = vq->last_used_idx % vq->num;
 	n = vq->num - start;
 	if (n < count) {
@@ -1444,6 +1838,44 @@ int vhost_add_used_n(struct vhost_virtqueue *vq, struct vring_used_elem *heads,
 }
 EXPORT_SYMBOL_GPL(vhost_add_used_n);
 
+static bool vhost_notify_packed(struct vhost_virtqueue *vq)
+{
+	__le16 flags, off_wrap;
+	u16 old, new, event;
+	bool v;
+
+	if (__get_user(flags, &vq->driver_event->flags)) {
+		vq_err(vq, "Failed to get driver event flags");
+		return true;
+	}
+	if (flags == cpu_to_le16(VRING_PACKED_EVENT_FLAG_DISABLE))
+		return false;
+	if (flags != cpu_to_le16(VRING_PACKED_EVENT_FLAG_DESC) ||
+	    !vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX))
+		return true;
+
+	old = vq->signalled_used;
+	v = vq->signalled_used_valid;
+	new = vq->signalled_used = vq->last_used_idx;
+	vq->signalled_used_valid = true;
+
+	if (unlikely(!v))
+		return true;
+
+	if (__get_user(off_wrap, &vq->driver_event->off_wrap)) {
+		vq_err(vq, "Failed to get driver event off_wrap");
+		return true;
+	}
+	/* Turn the ring offset and wrap counter into a free running index,
+	 * in the lap of new or the one before. */
+	event = le16_to_cpu(off_wrap) & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+	event += new & ~(vq->num - 1);
+	if (!!(le16_to_cpu(off_wrap) >> VRING_PACKED_EVENT_F_WRAP_CTR) !=
+	    vhost_packed_wrap(vq, new))
+		event -= vq->num;
+	return vring_need_event(event, new, old);
+}
+
 static bool vhost_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 {
 	__u16 old, new;
@@ -1454,6 +1886,9 @@ static bool vhost_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 	 * interrupts. */
 	smp_mb();
 
+	if (vhost_vq_is_packed(vq))
+		return vhost_notify_packed(vq);
+
 	if (vhost_has_feature(vq, VIRTIO_F_NOTIFY_ON_EMPTY) &&
 	    unlikely(vq->avail_idx == vq->last_avail_idx))
 		return true;
@@ -1519,6 +1954,25 @@ bool vhost_enable_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 	if (!(vq->used_flags & VRING_USED_F_NO_NOTIFY))
 		return false;
 	vq->used_flags &= ~VRING_USED_F_NO_NOTIFY;
+	if (vhost_vq_is_packed(vq)) {
+		bool avail;
+
+		r = vhost_update_device_event(vq);
+		if (r) {
+			vq_err(vq, "Failed to enable notification at %p: %d\n",
+			       &vq->device_event->flags, r);
+			return false;
+		}
+		/* They could have slipped one in as we were doing that:
+		 * make sure it's written, then check again. */
+		smp_mb();
+		r = vhost_packed_desc_avail(vq, vq->last_avail_idx, &avail);
+		if (r) {
+			vq_err(vq, "Failed to check avail descriptor: %d\n", r);
+			return false;
+		}
+		return avail;
+	}
 	if (!vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX)) {
 		r = vhost_update_used_flags(vq);
 		if (r) {
@@ -1548,6 +2002,27 @@ bool vhost_enable_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 }
 EXPORT_SYMBOL_GPL(vhost_enable_notify);
 
+/* Has the guest made nothing new available since we last looked?  Cheap
+ * enough to be called in a busy loop. */
+bool vhost_vq_avail_empty(struct vhost_dev *dev, struct vhost_virtqueue *vq)
+{
+	__virtio16 avail_idx;
+	bool avail;
+	int r;
+
+	if (vhost_vq_is_packed(vq)) {
+		r = vhost_packed_desc_avail(vq, vq->last_avail_idx, &avail);
+		return r ? false : !avail;
+	}
+
+	r = __get_user(avail_idx, &vq->avail->idx);
+	if (r)
+		return false;
+
+	return vhost16_to_cpu(vq, avail_idx) == vq->avail_idx;
+}
+EXPORT_SYMBOL_GPL(vhost_vq_avail_empty);
+
 /* We don't need to be notified again. */
 void vhost_disable_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 {
@@ -1556,6 +2031,13 @@ void vhost_disable_notify(struct vhost_dev *dev, struct vhost_virtqueue *vq)
 	if (vq->used_flags & VRING_USED_F_NO_NOTIFY)
 		return;
 	vq->used_flags |= VRING_USED_F_NO_NOTIFY;
+	if (vhost_vq_is_packed(vq)) {
+		r = vhost_update_device_event(vq);
+		if (r)
+			vq_err(vq, "Failed to disable notification at %p: %d\n",
+			       &vq->device_event->flags, r);
+		return;
+	}
 	if (!vhost_has_feature(vq, VIRTIO_RING_F_EVENT_IDX)) {
 		r = vhost_update_used_flags(vq);
 		if (r)
@@ -37,6 +37,7 @@ struct vhost_poll {
 
 void vhost_work_init(struct vhost_work *work, vhost_work_fn_t fn);
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work);
+bool vhost_has_work(struct vhost_dev *dev);
 
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
 		     unsigned long mask, struct vhost_dev *dev);
@@ -62,6 +63,11 @@ struct vhost_virtqueue {
 	struct vring_desc __user *desc;
 	struct vring_avail __user *avail;
 	struct vring_used __user *used;
+	/* Packed ring: the same three addresses, holding the descriptor
+	 * ring and the driver and device event suppression areas. */
+	struct vring_packed_desc __user *desc_packed;
+	struct vring_packed_desc_event __user *driver_event;
+	struct vring_packed_desc_event __user *device_event;
 	struct file *kick;
 	struct file *call;
 	struct file *error;
@@ -74,7 +80,9 @@ struct vhost_virtqueue {
 	/* The routine to call when the Guest pings us, or timeout. */
 	vhost_work_fn_t handle_kick;
 
-	/* Last available index we saw. */
+	/* Last available index we saw.  For packed rings this and
+	 * last_used_idx keep running past vq->num: the ring position is
+	 * the index modulo num and the wrap counter is its lap parity. */
 	u16 last_avail_idx;
 
 	/* Caches available index value from user. */
@@ -99,6 +107,11 @@ struct vhost_virtqueue {
 	struct iovec iov[UIO_MAXIOV];
 	struct iovec *indirect;
 	struct vring_used_elem *heads;
+	/* Packed ring: descriptors used by each buffer id, and by the
+	 * most recently fetched buffers (for vhost_discard_vq_desc). */
+	u16 *packed_count;
+	u16 *packed_hist;
+	unsigned int packed_fetched;
 	/* Protected by virtqueue mutex. */
 	struct vhost_memory *memory;
 	void *private_data;
@@ -106,6 +119,8 @@ struct vhost_virtqueue {
 	/* Log write descriptors */
 	void __user *log_base;
 	struct vhost_log *log;
+	/* How long the worker may busy poll this ring, in us (0: never). */
+	u32 busyloop_timeout;
 };
 
 struct vhost_dev {
@@ -151,6 +166,7 @@ void vhost_add_used_and_signal_n(struct vhost_dev *, struct vhost_virtqueue *,
 void vhost_signal(struct vhost_dev *, struct vhost_virtqueue *);
 void vhost_disable_notify(struct vhost_dev *, struct vhost_virtqueue *);
 bool vhost_enable_notify(struct vhost_dev *, struct vhost_virtqueue *);
+bool vhost_vq_avail_empty(struct vhost_dev *, struct vhost_virtqueue *);
 
 int vhost_log_write(struct vhost_virtqueue *vq, struct vhost_log *log,
 		    unsigned int log_num, u64 len);
@@ -173,6 +189,11 @@ static inline bool vhost_has_feature(struct vhost_virtqueue *vq, int bit)
 	return vq->acked_features & (1ULL << bit);
 }
 
+static inline bool vhost_vq_is_packed(struct vhost_virtqueue *vq)
+{
+	return vhost_has_feature(vq, VIRTIO_F_RING_PACKED);
+}
+
 /* Memory accessors */
 static inline u16 vhost16_to_cpu(struct vhost_virtqueue *vq, __virtio16 val)
 {
@@ -281,9 +281,12 @@ void vp_del_vqs(struct virtio_device *vdev)
 	list_for_each_entry_safe(vq, n, &vdev->vqs, list) {
 		info = vp_dev->vqs[vq->index];
 		if (vp_dev->per_vq_vectors &&
-			info->msix_vector != VIRTIO_MSI_NO_VECTOR)
-			free_irq(vp_dev->msix_entries[info->msix_vector].vector,
-				 vq);
+			info->msix_vector != VIRTIO_MSI_NO_VECTOR) {
+			int v = vp_dev->msix_entries[info->msix_vector].vector;
+
+			irq_set_managed_affinity(v, NULL);
+			free_irq(v, vq);
+		}
 		vp_del_vq(vq);
 	}
 	vp_dev->per_vq_vectors = false;
@@ -430,6 +433,23 @@ int vp_set_vq_affinity(struct virtqueue *vq, int cpu)
 	return 0;
 }
 
+/* Pin a per vq vector; shared vectors and INTX are left alone */
+int vp_set_vq_managed_affinity(struct virtqueue *vq,
+			       const struct cpumask *mask)
+{
+	struct virtio_pci_device *vp_dev = to_vp_device(vq->vdev);
+	struct virtio_pci_vq_info *info = vp_dev->vqs[vq->index];
+
+	if (!vq->callback)
+		return -EINVAL;
+
+	if (vp_dev->msix_enabled && vp_dev->per_vq_vectors &&
+	    info->msix_vector != VIRTIO_MSI_NO_VECTOR)
+		return irq_set_managed_affinity(
+			vp_dev->msix_entries[info->msix_vector].vector, mask);
+	return 0;
+}
+
 #ifdef CONFIG_PM_SLEEP
 static int virtio_pci_freeze(struct device *dev)
 {
@@ -54,12 +54,25 @@
 #define END_USE(vq)
 #endif
 
+struct vring_desc_state_packed {
+	u16 num;			/* Descriptor list length. */
+	u16 next;			/* The next desc state in a list. */
+	struct vring_packed_desc *indir_desc; /* Indirect descriptor, if any. */
+};
+
 struct vring_virtqueue {
 	struct virtqueue vq;
 
-	/* Actual memory layout for this queue */
+	/* Actual memory layout for this queue (split ring).  For packed
+	 * rings only vring.num is valid. */
 	struct vring vring;
 
+	/* Is this a packed ring? */
+	bool packed_ring;
+
+	/* Host uses buffers in the order they were made available */
+	bool in_order;
+
 	/* Can we use weak barriers? */
 	bool weak_barriers;
 
@@ -80,6 +93,45 @@ struct vring_virtqueue {
 	/* Last used index we've seen. */
 	u16 last_used_idx;
 
+	/* Packed ring state (only valid if packed_ring). */
+	struct {
+		/* Actual memory layout for this queue */
+		struct {
+			unsigned int num;
+			struct vring_packed_desc *desc;
+			struct vring_packed_desc_event *driver;
+			struct vring_packed_desc_event *device;
+		} vring;
+
+		/* Driver ring wrap counter. */
+		bool avail_wrap_counter;
+
+		/* Device ring wrap counter. */
+		bool used_wrap_counter;
+
+		/* Avail used flags. */
+		u16 avail_used_flags;
+
+		/* Index of the next avail descriptor. */
+		u16 next_avail_idx;
+
+		/* Last written value to driver->flags in
+		 * guest byte order. */
+		u16 event_flags_shadow;
+
+		/* Head of free buffer id list. */
+		u16 free_head;
+
+		/* In-order batch: the device used every buffer up to
+		 * and including batch_last with a single descriptor. */
+		bool batch_pending;
+		u16 batch_last;
+		u32 batch_len;
+
+		/* Per-descriptor state. */
+		struct vring_desc_state_packed *desc_state;
+	} packed;
+
 	/* How to notify other side. FIXME: commonalize hcalls! */
 	bool (*notify)(struct virtqueue *vq);
 
@@ -120,6 +172,133 @@ static struct vring_desc *alloc_indirect(struct virtqueue *_vq,
 	return desc;
 }
 
+static struct vring_packed_desc *alloc_indirect_packed(unsigned int total_sg,
+						       gfp_t gfp)
+{
+	/* See alloc_indirect(): the table must be in lowmem. */
+	gfp &= ~(__GFP_HIGHMEM | __GFP_HIGH);
+
+	return kmalloc(total_sg * sizeof(struct vring_packed_desc), gfp);
+}
+
+/* Called from virtqueue_add() with the ring checked and in use. */
+static inline int virtqueue_add_packed(struct vring_virtqueue *vq,
+				       struct scatterlist *sgs[],
+				       unsigned int total_sg,
+				       unsigned int out_sgs,
+				       unsigned int in_sgs,
+				       void *data,
+				       gfp_t gfp)
+{
+	struct vring_packed_desc *desc, *indir = NULL;
+	struct scatterlist *sg;
+	unsigned int i, n, c, descs_used;
+	u16 head, id, avail_used_flags, flags, uninitialized_var(head_flags);
+
+	head = vq->packed.next_avail_idx;
+	avail_used_flags = vq->packed.avail_used_flags;
+
+	/* If the host supports indirect descriptor tables, and we have multiple
+	 * buffers, then go indirect. FIXME: tune this threshold */
+	if (vq->indirect && total_sg > 1 && vq->vq.num_free)
+		indir = alloc_indirect_packed(total_sg, gfp);
+
+	descs_used = indir ? 1 : total_sg;
+	if (vq->vq.num_free < descs_used) {
+		pr_debug("Can't add buf len %i - avail = %i\n",
+			 descs_used, vq->vq.num_free);
+		/* FIXME: for historical reasons, we force a notify here if
+		 * there are outgoing parts to the buffer.  Presumably the
+		 * host should service the ring ASAP. */
+		if (out_sgs)
+			vq->notify(&vq->vq);
+		END_USE(vq);
+		return -ENOSPC;
+	}
+
+	/* With in-order completion the buffer id is simply the position of
+	 * its first descriptor, so no free list needs to be kept. */
+	id = vq->in_order ? head : vq->packed.free_head;
+	BUG_ON(id >= vq->packed.vring.num);
+
+	desc = indir ? indir : vq->packed.vring.desc;
+	i = indir ? 0 : head;
+	c = 0;
+	for (n = 0; n < out_sgs + in_sgs; n++) {
+		for (sg = sgs[n]; sg; sg = sg_next(sg)) {
+			flags = n < out_sgs ? 0 : VRING_DESC_F_WRITE;
+			if (!indir) {
+				if (++c != total_sg)
+					flags |= VRING_DESC_F_NEXT;
+				flags |= vq->packed.avail_used_flags;
+			}
+
+			desc[i].addr = cpu_to_le64(sg_phys(sg));
+			desc[i].len = cpu_to_le32(sg->length);
+			desc[i].id = cpu_to_le16(id);
+
+			/* The head is exposed last, see below. */
+			if (!indir && i == head)
+				head_flags = flags;
+			else
+				desc[i].flags = cpu_to_le16(flags);
+
+			if (indir) {
+				i++;
+			} else if (unlikely(++i >= vq->packed.vring.num)) {
+				i = 0;
+				vq->packed.avail_used_flags ^=
+					1 << VRING_PACKED_DESC_F_AVAIL |
+					1 << VRING_PACKED_DESC_F_USED;
+				vq->packed.avail_wrap_counter ^= 1;
+			}
+		}
+	}
+
+	if (indir) {
+		/* Use a single descriptor pointing at the table. */
+		desc = vq->packed.vring.desc;
+		desc[head].addr = cpu_to_le64(virt_to_phys(indir));
+		/* avoid kmemleak false positive (hidden by virt_to_phys) */
+		kmemleak_ignore(indir);
+		desc[head].len = cpu_to_le32(total_sg *
+					     sizeof(struct vring_packed_desc));
+		desc[head].id = cpu_to_le16(id);
+		head_flags = VRING_DESC_F_INDIRECT | avail_used_flags;
+
+		i = head + 1;
+		if (unlikely(i >= vq->packed.vring.num)) {
+			i = 0;
+			vq->packed.avail_used_flags ^=
+				1 << VRING_PACKED_DESC_F_AVAIL |
+				1 << VRING_PACKED_DESC_F_USED;
+			vq->packed.avail_wrap_counter ^= 1;
+		}
+	}
+
+	/* We're about to use some buffers from the free list. */
+	vq->vq.num_free -= descs_used;
+	vq->packed.next_avail_idx = i;
+	if (!vq->in_order)
+		vq->packed.free_head = vq->packed.desc_state[id].next;
+
+	/* Store token and indirect table. */
+	vq->data[id] = data;
+	vq->packed.desc_state[id].num = descs_used;
+	vq->packed.desc_state[id].indir_desc = indir;
+
+	/* The other descriptors of the chain need to be written before the
+	 * head flags flip the whole buffer to available. */
+	virtio_wmb(vq->weak_barriers);
+	vq->packed.vring.desc[head].flags = cpu_to_le16(head_flags);
+	vq->num_added += descs_used;
+
+	pr_debug("Added buffer id %i at %i to %p\n", id, head, vq);
+	END_USE(vq);
+
+	return 0;
+}
+
 static inline int virtqueue_add(struct virtqueue *_vq,
 				struct scatterlist *sgs[],
 				unsigned int total_sg,
@@ -160,6 +339,10 @@ static inline int virtqueue_add(struct virtqueue *_vq,
 	BUG_ON(total_sg > vq->vring.num);
 	BUG_ON(total_sg == 0);
 
+	if (vq->packed_ring)
+		return virtqueue_add_packed(vq, sgs, total_sg,
+					    out_sgs, in_sgs, data, gfp);
+
 	head = vq->free_head;
 
 	/* If the host supports indirect descriptor tables, and we have multiple
@@ -343,6 +526,28 @@ EXPORT_SYMBOL_GPL(virtqueue_add_inbuf);
  * This is sometimes useful because the virtqueue_kick_prepare() needs
  * to be serialized, but the actual virtqueue_notify() call does not.
  */
+static bool virtqueue_kick_prepare_packed(struct vring_virtqueue *vq)
+{
+	u16 new, old, off_wrap, flags, wrap_counter, event_idx;
+
+	old = vq->packed.next_avail_idx - vq->num_added;
+	new = vq->packed.next_avail_idx;
+	vq->num_added = 0;
+
+	off_wrap = le16_to_cpu(READ_ONCE(vq->packed.vring.device->off_wrap));
+	flags = le16_to_cpu(READ_ONCE(vq->packed.vring.device->flags));
+
+	if (flags != VRING_PACKED_EVENT_FLAG_DESC)
+		return flags != VRING_PACKED_EVENT_FLAG_DISABLE;
+
+	wrap_counter = off_wrap >> VRING_PACKED_EVENT_F_WRAP_CTR;
+	event_idx = off_wrap & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+	if (wrap_counter != vq->packed.avail_wrap_counter)
+		event_idx -= vq->packed.vring.num;
+
+	return vring_need_event(event_idx, new, old);
+}
+
 bool virtqueue_kick_prepare(struct virtqueue *_vq)
 {
 	struct vring_virtqueue *vq = to_vvq(_vq);
@@ -354,6 +559,15 @@ bool virtqueue_kick_prepare(struct virtqueue *_vq)
 	 * event. */
 	virtio_mb(vq->weak_barriers);
 
+	if (vq->packed_ring) {
+		needs_kick = virtqueue_kick_prepare_packed(vq);
+#ifdef DEBUG
+		vq->last_add_time_valid = false;
+#endif
+		END_USE(vq);
+		return needs_kick;
+	}
+
 	old = virtio16_to_cpu(_vq->vdev, vq->vring.avail->idx) - vq->num_added;
 	new = virtio16_to_cpu(_vq->vdev, vq->vring.avail->idx);
 	vq->num_added = 0;
@@ -446,11 +660,126 @@ static void detach_buf(struct vring_virtqueue *vq, unsigned int head)
 	vq->vq.num_free++;
 }
 
+static void detach_buf_packed(struct vring_virtqueue *vq, unsigned int id)
+{
+	struct vring_desc_state_packed *state = &vq->packed.desc_state[id];
+
+	/* Clear data ptr. */
+	vq->data[id] = NULL;
+
+	/* Free the indirect table */
+	kfree(state->indir_desc);
+	state->indir_desc = NULL;
+
+	vq->vq.num_free += state->num;
+	if (!vq->in_order) {
+		state->next = vq->packed.free_head;
+		vq->packed.free_head = id;
+	}
+}
+
+static inline bool is_used_desc_packed(const struct vring_virtqueue *vq,
+				       u16 idx, bool used_wrap_counter)
+{
+	u16 flags = le16_to_cpu(READ_ONCE(vq->packed.vring.desc[idx].flags));
+	bool avail = !!(flags & (1 << VRING_PACKED_DESC_F_AVAIL));
+	bool used = !!(flags & (1 << VRING_PACKED_DESC_F_USED));
+
+	return avail == used && used == used_wrap_counter;
+}
+
 static inline bool more_used(const struct vring_virtqueue *vq)
 {
+	if (vq->packed_ring)
+		return vq->packed.batch_pending ||
+		       is_used_desc_packed(vq, vq->last_used_idx,
+					   vq->packed.used_wrap_counter);
+
 	return vq->last_used_idx != virtio16_to_cpu(vq->vq.vdev, vq->vring.used->idx);
 }
 
+static void *virtqueue_get_buf_packed(struct vring_virtqueue *vq,
+				      unsigned int *len)
+{
+	struct vring_packed_desc *desc;
+	u16 last_used, id;
+	void *ret;
+
+	if (!more_used(vq)) {
+		pr_debug("No more buffers in queue\n");
+		END_USE(vq);
+		return NULL;
+	}
+
+	/* Only get used elements after they have been exposed by host. */
+	virtio_rmb(vq->weak_barriers);
+
+	last_used = vq->last_used_idx;
+	desc = &vq->packed.vring.desc[last_used];
+
+	if (!vq->in_order) {
+		id = le16_to_cpu(desc->id);
+		*len = le32_to_cpu(desc->len);
+	} else if (!vq->packed.batch_pending) {
+		/* An in-order device may use a batch of buffers by writing a
+		 * single descriptor, at the position of the first buffer,
+		 * carrying the id of the last one.  Only the last buffer's
+		 * length is known; the others are returned with length 0. */
+		id = last_used;
+		vq->packed.batch_last = le16_to_cpu(desc->id);
+		vq->packed.batch_len = le32_to_cpu(desc->len);
+		if (vq->packed.batch_last != id) {
+			vq->packed.batch_pending = true;
+			*len = 0;
+		} else {
+			*len = vq->packed.batch_len;
+		}
+	} else {
+		id = last_used;
+		if (id == vq->packed.batch_last) {
+			vq->packed.batch_pending = false;
+			*len = vq->packed.batch_len;
+		} else {
+			*len = 0;
+		}
+	}
+
+	if (unlikely(id >= vq->packed.vring.num)) {
+		BAD_RING(vq, "id %u out of range\n", id);
+		return NULL;
+	}
+	if (unlikely(!vq->data[id])) {
+		BAD_RING(vq, "id %u is not a head!\n", id);
+		return NULL;
+	}
+
+	/* detach_buf_packed clears data, so grab it now. */
+	ret = vq->data[id];
+	vq->last_used_idx += vq->packed.desc_state[id].num;
+	if (unlikely(vq->last_used_idx >= vq->packed.vring.num)) {
+		vq->last_used_idx -= vq->packed.vring.num;
+		vq->packed.used_wrap_counter ^= 1;
+	}
+	detach_buf_packed(vq, id);
+
+	/* If we expect an interrupt for the next entry, tell host
+	 * by writing event index and flush out the write before
+	 * the read in the next get_buf call. */
+	if (vq->packed.event_flags_shadow == VRING_PACKED_EVENT_FLAG_DESC) {
+		vq->packed.vring.driver->off_wrap = cpu_to_le16(vq->last_used_idx |
+			((u16)vq->packed.used_wrap_counter <<
+			 VRING_PACKED_EVENT_F_WRAP_CTR));
+		virtio_mb(vq->weak_barriers);
+	}
+
+#ifdef DEBUG
+	vq->last_add_time_valid = false;
+#endif
+
+	END_USE(vq);
+	return ret;
+}
+
 /**
  * virtqueue_get_buf - get the next used buffer
  * @vq: the struct virtqueue we're talking about.
@@ -481,6 +810,9 @@ void *virtqueue_get_buf(struct virtqueue *_vq, unsigned int *len)
 		return NULL;
 	}
 
+	if (vq->packed_ring)
+		return virtqueue_get_buf_packed(vq, len);
+
 	if (!more_used(vq)) {
 		pr_debug("No more buffers in queue\n");
 		END_USE(vq);
@@ -537,10 +869,51 @@ void virtqueue_disable_cb(struct virtqueue *_vq)
 {
 	struct vring_virtqueue *vq = to_vvq(_vq);
 
+	if (vq->packed_ring) {
+		if (vq->packed.event_flags_shadow !=
+		    VRING_PACKED_EVENT_FLAG_DISABLE) {
+			vq->packed.event_flags_shadow =
+				VRING_PACKED_EVENT_FLAG_DISABLE;
+			vq->packed.vring.driver->flags =
+				cpu_to_le16(vq->packed.event_flags_shadow);
+		}
+		return;
+	}
+
 	vq->vring.avail->flags |= cpu_to_virtio16(_vq->vdev, VRING_AVAIL_F_NO_INTERRUPT);
 }
 EXPORT_SYMBOL_GPL(virtqueue_disable_cb);
 
+/* Point the driver event at @used_idx (if event idx is in use) and turn
+ * callbacks back on. */
+static void enable_cb_packed(struct vring_virtqueue *vq, u16 used_idx,
+			     bool wrap_counter)
+{
+	if (vq->event) {
+		vq->packed.vring.driver->off_wrap = cpu_to_le16(used_idx |
+			((u16)wrap_counter << VRING_PACKED_EVENT_F_WRAP_CTR));
+		/* We need to update event offset and event wrap
+		 * counter first before updating event flags. */
+		virtio_wmb(vq->weak_barriers);
+	}
+
+	if (vq->packed.event_flags_shadow == VRING_PACKED_EVENT_FLAG_DISABLE) {
+		vq->packed.event_flags_shadow = vq->event ?
+				VRING_PACKED_EVENT_FLAG_DESC :
+				VRING_PACKED_EVENT_FLAG_ENABLE;
+		vq->packed.vring.driver->flags =
+			cpu_to_le16(vq->packed.event_flags_shadow);
+	}
+}
+
+static unsigned virtqueue_enable_cb_prepare_packed(struct vring_virtqueue *vq)
+{
+	enable_cb_packed(vq, vq->last_used_idx, vq->packed.used_wrap_counter);
+
+	return vq->last_used_idx | ((u16)vq->packed.used_wrap_counter <<
+				    VRING_PACKED_EVENT_F_WRAP_CTR);
+}
+
 /**
  * virtqueue_enable_cb_prepare - restart callbacks after disable_cb
  * @vq: the struct virtqueue we're talking about.
@@ -560,6 +933,12 @@ unsigned virtqueue_enable_cb_prepare(struct virtqueue *_vq)
 
 	START_USE(vq);
 
+	if (vq->packed_ring) {
+		last_used_idx = virtqueue_enable_cb_prepare_packed(vq);
+		END_USE(vq);
+		return last_used_idx;
+	}
+
 	/* We optimistically turn back on interrupts, then check if there was
 	 * more to do. */
 	/* Depending on the VIRTIO_RING_F_EVENT_IDX feature, we need to
@@ -586,6 +965,14 @@ bool virtqueue_poll(struct virtqueue *_vq, unsigned last_used_idx)
 	struct vring_virtqueue *vq = to_vvq(_vq);
 
 	virtio_mb(vq->weak_barriers);
+	if (vq->packed_ring)
+		return vq->packed.batch_pending ||
+		       is_used_desc_packed(vq,
+				(u16)last_used_idx &
+				~(1 << VRING_PACKED_EVENT_F_WRAP_CTR),
+				!!((u16)last_used_idx &
+				   (1 << VRING_PACKED_EVENT_F_WRAP_CTR)));
+
 	return (u16)last_used_idx != virtio16_to_cpu(_vq->vdev, vq->vring.used->idx);
 }
 EXPORT_SYMBOL_GPL(virtqueue_poll);
@@ -608,6 +995,27 @@ bool virtqueue_enable_cb(struct virtqueue *_vq)
 }
 EXPORT_SYMBOL_GPL(virtqueue_enable_cb);
 
+static bool virtqueue_enable_cb_delayed_packed(struct vring_virtqueue *vq)
+{
+	bool wrap_counter = vq->packed.used_wrap_counter;
+	u16 used_idx, bufs;
+
+	/* TODO: tune this threshold */
+	bufs = (vq->packed.vring.num - vq->vq.num_free) * 3 / 4;
+	used_idx = vq->last_used_idx + bufs;
+	if (used_idx >= vq->packed.vring.num) {
+		used_idx -= vq->packed.vring.num;
+		wrap_counter ^= 1;
+	}
+	enable_cb_packed(vq, used_idx, wrap_counter);
+
+	/* We need to update event suppression structure first
+	 * before re-checking for more used buffers. */
+	virtio_mb(vq->weak_barriers);
+
+	return !more_used(vq);
+}
+
 /**
  * virtqueue_enable_cb_delayed - restart callbacks after disable_cb.
  * @vq: the struct virtqueue we're talking about.
@@ -628,6 +1036,13 @@ bool virtqueue_enable_cb_delayed(struct virtqueue *_vq)
 
 	START_USE(vq);
 
+	if (vq->packed_ring) {
+		bool ret = virtqueue_enable_cb_delayed_packed(vq);
+
+		END_USE(vq);
+		return ret;
+	}
+
 	/* We optimistically turn back on interrupts, then check if there was
 	 * more to do. */
 	/* Depending on the VIRTIO_RING_F_USED_EVENT_IDX feature, we need to
@@ -669,6 +1084,11 @@ void *virtqueue_detach_unused_buf(struct virtqueue *_vq)
 			continue;
 		/* detach_buf clears data, so grab it now. */
 		buf = vq->data[i];
+		if (vq->packed_ring) {
+			detach_buf_packed(vq, i);
+			END_USE(vq);
+			return buf;
+		}
 		detach_buf(vq, i);
 		vq->vring.avail->idx = cpu_to_virtio16(_vq->vdev, virtio16_to_cpu(_vq->vdev, vq->vring.avail->idx) - 1);
 		END_USE(vq);
@@ -725,7 +1145,23 @@ struct virtqueue *vring_new_virtqueue(unsigned int index,
 	if (!vq)
 		return NULL;
 
-	vring_init(&vq->vring, num, pages, vring_align);
+	vq->packed_ring = virtio_has_feature(vdev, VIRTIO_F_RING_PACKED);
+	vq->in_order = virtio_has_feature(vdev, VIRTIO_F_IN_ORDER);
+	if (vq->packed_ring) {
+		/* The packed layout never needs more room than the split
+		 * one, so transports can keep sizing pages by vring_size(). */
+		vq->packed.desc_state = kcalloc(num,
+						sizeof(*vq->packed.desc_state),
+						GFP_KERNEL);
+		if (!vq->packed.desc_state) {
+			kfree(vq);
+			return NULL;
+		}
+		memset(&vq->vring, 0, sizeof(vq->vring));
+		vq->vring.num = num;
+	} else {
+		vring_init(&vq->vring, num, pages, vring_align);
+	}
 	vq->vq.callback = callback;
 	vq->vq.vdev = vdev;
 	vq->vq.name = name;
@@ -745,6 +1181,40 @@ struct virtqueue *vring_new_virtqueue(unsigned int index,
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC);
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
 
+	if (vq->packed_ring) {
+		/* Descriptors must start out neither available nor used. */
+		memset(pages, 0, vring_packed_size(num));
+		vq->packed.vring.num = num;
+		vq->packed.vring.desc = pages;
+		vq->packed.vring.driver = pages +
+			num * sizeof(struct vring_packed_desc);
+		vq->packed.vring.device = vq->packed.vring.driver + 1;
+
+		vq->packed.next_avail_idx = 0;
+		vq->packed.avail_wrap_counter = 1;
+		vq->packed.used_wrap_counter = 1;
+		vq->packed.avail_used_flags = 1 << VRING_PACKED_DESC_F_AVAIL;
+		vq->packed.event_flags_shadow = 0;
+		vq->packed.batch_pending = false;
+
+		/* No callback?  Tell other side not to bother us. */
+		if (!callback) {
+			vq->packed.event_flags_shadow =
+				VRING_PACKED_EVENT_FLAG_DISABLE;
+			vq->packed.vring.driver->flags =
+				cpu_to_le16(vq->packed.event_flags_shadow);
+		}
+
+		/* Put everything in free lists. */
+		vq->packed.free_head = 0;
+		for (i = 0; i < num; i++) {
+			vq->packed.desc_state[i].next = i + 1;
+			vq->data[i] = NULL;
+		}
+
+		return &vq->vq;
+	}
+
 	/* No callback?  Tell other side not to bother us. */
 	if (!callback)
 		vq->vring.avail->flags |= cpu_to_virtio16(vdev, VRING_AVAIL_F_NO_INTERRUPT);
@@ -764,6 +1234,8 @@ EXPORT_SYMBOL_GPL(vring_new_virtqueue);
 void vring_del_virtqueue(struct virtqueue *vq)
 {
 	list_del(&vq->list);
+	if (to_vvq(vq)->packed_ring)
+		kfree(to_vvq(vq)->packed.desc_state);
 	kfree(to_vvq(vq));
 }
 EXPORT_SYMBOL_GPL(vring_del_virtqueue);
@@ -781,6 +1253,17 @@ void vring_transport_features(struct virtio_device *vdev)
 			break;
 		case VIRTIO_F_VERSION_1:
 			break;
+		case VIRTIO_F_RING_PACKED:
+			/* The packed layout is only defined for virtio 1.0 */
+			if (!__virtio_test_bit(vdev, VIRTIO_F_VERSION_1))
+				__virtio_clear_bit(vdev, i);
+			break;
+		case VIRTIO_F_IN_ORDER:
+			/* Batched completions are only handled for packed
+			 * rings. */
+			if (!__virtio_test_bit(vdev, VIRTIO_F_RING_PACKED))
+				__virtio_clear_bit(vdev, i);
+			break;
 		default:
 			/* We don't understand this bit. */
 			__virtio_clear_bit(vdev, i);
@@ -832,6 +1315,9 @@ void *virtqueue_get_avail(struct virtqueue *_vq)
 {
 	struct vring_virtqueue *vq = to_vvq(_vq);
 
+	if (vq->packed_ring)
+		return vq->packed.vring.driver;
+
 	return vq->vring.avail;
 }
 EXPORT_SYMBOL_GPL(virtqueue_get_avail);
@@ -840,6 +1326,9 @@ void *virtqueue_get_used(struct virtqueue *_vq)
 {
 	struct vring_virtqueue *vq = to_vvq(_vq);
 
+	if (vq->packed_ring)
+		return vq->packed.vring.device;
+
 	return vq->vring.used;
 }
 EXPORT_SYMBOL_GPL(virtqueue_get_used);
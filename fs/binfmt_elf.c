@@ -931,6 +931,17 @@ static int load_elf_binary(struct linux_binprm *bprm)
 			goto out_free_dentry;
 		}
 
+		/*
+		 * Large binaries can ask for their text to be read in with
+		 * big read-ahead now, rather than with one fault per page
+		 * while starting up.  Writable segments would be COWed in
+		 * full, so they are left alone.
+		 */
+		if ((elf_ppnt->p_flags & PF_LINUX_PREFAULT) &&
+		    !(elf_ppnt->p_flags & PF_W))
+			mm_populate(error, ELF_PAGEALIGN(elf_ppnt->p_filesz +
+					ELF_PAGEOFFSET(elf_ppnt->p_vaddr)));
+
 		if (!load_addr_set) {
 			load_addr_set = 1;
 			load_addr = (elf_ppnt->p_vaddr - elf_ppnt->p_offset);
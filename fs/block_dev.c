@@ -150,6 +150,17 @@ blkdev_direct_IO(struct kiocb *iocb, struct iov_iter *iter, loff_t offset)
 {
 	struct file *file = iocb->ki_filp;
 	struct inode *inode = file->f_mapping->host;
+	struct block_device *bdev = I_BDEV(inode);
+
+	/* no mapping to look up, small sync reads go straight to the disk */
+	if (dio_read_simple_ok(iocb, iter, offset,
+			       blksize_bits(bdev_logical_block_size(bdev)),
+			       i_size_read(inode))) {
+		ssize_t ret = dio_read_simple(bdev, offset >> 9, iter);
+
+		if (ret != -ENOTBLK)
+			return ret;
+	}
 
 	return __blockdev_direct_IO(iocb, inode, I_BDEV(inode), iter, offset,
 				    blkdev_get_block, NULL, NULL, 0);
@@ -1760,35 +1771,39 @@ EXPORT_SYMBOL(__invalidate_device);
 void iterate_bdevs(void (*func)(struct block_device *, void *), void *arg)
 {
 	struct inode *inode, *old_inode = NULL;
-
-	spin_lock(&inode_sb_list_lock);
-	list_for_each_entry(inode, &blockdev_superblock->s_inodes, i_sb_list) {
-		struct address_space *mapping = inode->i_mapping;
-
-		spin_lock(&inode->i_lock);
-		if (inode->i_state & (I_FREEING|I_WILL_FREE|I_NEW) ||
-		    mapping->nrpages == 0) {
+	struct sb_inode_list *ilist;
+	int cpu;
+
+	for_each_sb_inode_list(blockdev_superblock, cpu, ilist) {
+		spin_lock(&ilist->lock);
+		list_for_each_entry(inode, &ilist->head, i_sb_list) {
+			struct address_space *mapping = inode->i_mapping;
+
+			spin_lock(&inode->i_lock);
+			if (inode->i_state & (I_FREEING|I_WILL_FREE|I_NEW) ||
+			    mapping->nrpages == 0) {
+				spin_unlock(&inode->i_lock);
+				continue;
+			}
+			__iget(inode);
 			spin_unlock(&inode->i_lock);
-			continue;
-		}
-		__iget(inode);
-		spin_unlock(&inode->i_lock);
-		spin_unlock(&inode_sb_list_lock);
-		/*
-		 * We hold a reference to 'inode' so it couldn't have been
-		 * removed from s_inodes list while we dropped the
-		 * inode_sb_list_lock.  We cannot iput the inode now as we can
-		 * be holding the last reference and we cannot iput it under
-		 * inode_sb_list_lock. So we keep the reference and iput it
-		 * later.
-		 */
-		iput(old_inode);
-		old_inode = inode;
+			spin_unlock(&ilist->lock);
+			/*
+			 * We hold a reference to 'inode' so it couldn't have
+			 * been removed from its inode list while we dropped
+			 * the list lock.  We cannot iput the inode now as we
+			 * can be holding the last reference and we cannot iput
+			 * it under the list lock. So we keep the reference and
+			 * iput it later.
+			 */
+			iput(old_inode);
+			old_inode = inode;
 
-		func(I_BDEV(inode), arg);
+			func(I_BDEV(inode), arg);
 
-		spin_lock(&inode_sb_list_lock);
+			spin_lock(&ilist->lock);
+		}
+		spin_unlock(&ilist->lock);
 	}
-	spin_unlock(&inode_sb_list_lock);
 	iput(old_inode);
 }
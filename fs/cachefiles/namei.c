@@ -643,11 +643,13 @@ lookup_again:
 	/* open a file interface onto a data file */
 	if (object->type != FSCACHE_COOKIE_TYPE_INDEX) {
 		if (d_is_reg(object->dentry)) {
-			const struct address_space_operations *aops;
+			struct inode *inode = object->dentry->d_inode;
 
+			/* we need some way to tell which pages are cached */
 			ret = -EPERM;
-			aops = object->dentry->d_inode->i_mapping->a_ops;
-			if (!aops->bmap)
+			if (!inode->i_mapping->a_ops->bmap &&
+			    (!inode->i_fop->llseek ||
+			     inode->i_fop->llseek == generic_file_llseek))
 				goto check_error;
 
 			object->backer = object->dentry;
@@ -373,6 +373,113 @@ nomem:
 	return -ENOMEM;
 }
 
+/*
+ * cursor over the data extents of a backing file
+ * - pages are tested for presence in order, so remembering the extent the
+ *   last one fell in makes a run of pages cost one SEEK_DATA/SEEK_HOLE pair
+ *   per extent rather than one lookup per page
+ * - backing filesystems without a real SEEK_DATA (generic_file_llseek()
+ *   reports everything below EOF as data) fall back to bmap()
+ */
+struct cachefiles_extent {
+	struct inode	*inode;
+	struct file	*file;		/* NULL if using bmap() */
+	unsigned	shift;		/* page to block shift for bmap() */
+	loff_t		start;		/* current extent */
+	loff_t		end;
+	bool		data;		/* T if the current extent holds data */
+};
+
+static int cachefiles_extent_init(struct cachefiles_cache *cache,
+				  struct cachefiles_object *object,
+				  struct cachefiles_extent *ext)
+{
+	struct inode *inode = object->backer->d_inode;
+	struct path path;
+
+	ext->inode = inode;
+	ext->file = NULL;
+	ext->start = ext->end = 0;
+	ext->data = false;
+
+	if (inode->i_fop->llseek &&
+	    inode->i_fop->llseek != generic_file_llseek) {
+		path.mnt = cache->mnt;
+		path.dentry = object->backer;
+		ext->file = dentry_open(&path, O_RDONLY | O_LARGEFILE,
+					cache->cache_cred);
+		if (IS_ERR(ext->file))
+			return PTR_ERR(ext->file);
+		return 0;
+	}
+
+	/* calculate the shift required to use bmap */
+	if (!inode->i_mapping->a_ops->bmap ||
+	    inode->i_sb->s_blocksize > PAGE_SIZE)
+		return -ENOBUFS;
+
+	ext->shift = PAGE_SHIFT - inode->i_sb->s_blocksize_bits;
+	return 0;
+}
+
+static void cachefiles_extent_end(struct cachefiles_extent *ext)
+{
+	if (ext->file)
+		fput(ext->file);
+}
+
+/*
+ * determine whether the backing file holds data for a page
+ * - we assume the absence or presence of data at the start of the page is a
+ *   good enough indication for the page as a whole
+ * - returns 1 if there's data, 0 if there's a hole or -errno
+ */
+static int cachefiles_page_has_data(struct cachefiles_extent *ext,
+				    pgoff_t index)
+{
+	loff_t pos = (loff_t) index << PAGE_SHIFT;
+	loff_t data, hole;
+
+	if (!ext->file) {
+		sector_t block = index;
+
+		block <<= ext->shift;
+		block = ext->inode->i_mapping->a_ops->bmap(
+			ext->inode->i_mapping, block);
+		return block != 0;
+	}
+
+	if (pos >= ext->start && pos < ext->end)
+		return ext->data;
+
+	data = vfs_llseek(ext->file, pos, SEEK_DATA);
+	if (data == -ENXIO) {
+		/* nothing but hole from here to EOF */
+		ext->start = pos;
+		ext->end = LLONG_MAX;
+		ext->data = false;
+		return 0;
+	}
+	if (data < 0)
+		return data;
+
+	if (data > pos) {
+		ext->start = pos;
+		ext->end = data;
+		ext->data = false;
+		return 0;
+	}
+
+	hole = vfs_llseek(ext->file, pos, SEEK_HOLE);
+	if (hole < 0)
+		return hole;
+
+	ext->start = pos;
+	ext->end = hole;
+	ext->data = true;
+	return 1;
+}
+
 /*
  * read a page from the cache or allocate a block in which to store it
  * - cache withdrawal is prevented by the caller
@@ -393,9 +500,8 @@ int cachefiles_read_or_alloc_page(struct fscache_retrieval *op,
 {
 	struct cachefiles_object *object;
 	struct cachefiles_cache *cache;
+	struct cachefiles_extent ext;
 	struct inode *inode;
-	sector_t block0, block;
-	unsigned shift;
 	int ret;
 
 	object = container_of(op->op.object,
@@ -410,34 +516,23 @@ int cachefiles_read_or_alloc_page(struct fscache_retrieval *op,
 
 	inode = object->backer->d_inode;
 	ASSERT(S_ISREG(inode->i_mode));
-	ASSERT(inode->i_mapping->a_ops->bmap);
 	ASSERT(inode->i_mapping->a_ops->readpages);
 
-	/* calculate the shift required to use bmap */
-	if (inode->i_sb->s_blocksize > PAGE_SIZE)
+	if (cachefiles_extent_init(cache, object, &ext) < 0)
 		goto enobufs;
 
-	shift = PAGE_SHIFT - inode->i_sb->s_blocksize_bits;
-
 	op->op.flags &= FSCACHE_OP_KEEP_FLAGS;
 	op->op.flags |= FSCACHE_OP_ASYNC;
 	op->op.processor = cachefiles_read_copier;
 
-	/* we assume the absence or presence of the first block is a good
-	 * enough indication for the page as a whole
-	 * - TODO: don't use bmap() for this as it is _not_ actually good
-	 *   enough for this as it doesn't indicate errors, but it's all we've
-	 *   got for the moment
-	 */
-	block0 = page->index;
-	block0 <<= shift;
-
-	block = inode->i_mapping->a_ops->bmap(inode->i_mapping, block0);
-	_debug("%llx -> %llx",
-	       (unsigned long long) block0,
-	       (unsigned long long) block);
-
-	if (block) {
+	ret = cachefiles_page_has_data(&ext, page->index);
+	cachefiles_extent_end(&ext);
+	_debug("%lx -> %d", page->index, ret);
+
+	if (ret < 0) {
+		cachefiles_io_error_obj(object, "Backing file seek failed");
+		goto enobufs;
+	} else if (ret) {
 		/* submit the apparently valid page to the backing fs to be
 		 * read from disk */
 		ret = cachefiles_read_backing_file_one(object, op, page);
@@ -682,11 +777,12 @@ int cachefiles_read_or_alloc_pages(struct fscache_retrieval *op,
 {
 	struct cachefiles_object *object;
 	struct cachefiles_cache *cache;
+	struct cachefiles_extent ext;
 	struct list_head backpages;
 	struct pagevec pagevec;
 	struct inode *inode;
 	struct page *page, *_n;
-	unsigned shift, nrbackpages;
+	unsigned nrbackpages;
 	int ret, ret2, space;
 
 	object = container_of(op->op.object,
@@ -707,15 +803,11 @@ int cachefiles_read_or_alloc_pages(struct fscache_retrieval *op,
 
 	inode = object->backer->d_inode;
 	ASSERT(S_ISREG(inode->i_mode));
-	ASSERT(inode->i_mapping->a_ops->bmap);
 	ASSERT(inode->i_mapping->a_ops->readpages);
 
-	/* calculate the shift required to use bmap */
-	if (inode->i_sb->s_blocksize > PAGE_SIZE)
+	if (cachefiles_extent_init(cache, object, &ext) < 0)
 		goto all_enobufs;
 
-	shift = PAGE_SHIFT - inode->i_sb->s_blocksize_bits;
-
 	pagevec_init(&pagevec, 0);
 
 	op->op.flags &= FSCACHE_OP_KEEP_FLAGS;
@@ -727,24 +819,15 @@ int cachefiles_read_or_alloc_pages(struct fscache_retrieval *op,
 
 	ret = space ? -ENODATA : -ENOBUFS;
 	list_for_each_entry_safe(page, _n, pages, lru) {
-		sector_t block0, block;
-
-		/* we assume the absence or presence of the first block is a
-		 * good enough indication for the page as a whole
-		 * - TODO: don't use bmap() for this as it is _not_ actually
-		 *   good enough for this as it doesn't indicate errors, but
-		 *   it's all we've got for the moment
-		 */
-		block0 = page->index;
-		block0 <<= shift;
-
-		block = inode->i_mapping->a_ops->bmap(inode->i_mapping,
-						      block0);
-		_debug("%llx -> %llx",
-		       (unsigned long long) block0,
-		       (unsigned long long) block);
-
-		if (block) {
+		int data;
+
+		data = cachefiles_page_has_data(&ext, page->index);
+		_debug("%lx -> %d", page->index, data);
+
+		if (data < 0) {
+			/* leave the page to be read from the server */
+			fscache_retrieval_complete(op, 1);
+		} else if (data) {
 			/* we have data - add it to the list to give to the
 			 * backing fs */
 			list_move(&page->lru, &backpages);
@@ -759,6 +842,8 @@ int cachefiles_read_or_alloc_pages(struct fscache_retrieval *op,
 		}
 	}
 
+	cachefiles_extent_end(&ext);
+
 	if (pagevec_count(&pagevec) > 0)
 		fscache_mark_pages_cached(op, &pagevec);
 
@@ -60,4 +60,14 @@
 /* Maximum buffer size value we can send with 1 credit */
 #define SMB2_MAX_BUFFER_SIZE 65536
 
+/*
+ * Number of credits we try to keep granted, so that enough large MTU
+ * reads and writes (one credit per SMB2_MAX_BUFFER_SIZE) can be on the
+ * wire at once to fill a fast link.
+ */
+#define SMB2_CREDITS_TARGET 512
+
+/* Extra credits asked for on top of the charge while below the target */
+#define SMB2_CREDITS_EXTRA 8
+
 #endif	/* _SMB2_GLOB_H */
@@ -77,6 +77,22 @@ static const int smb2_req_struct_sizes[NUMBER_OF_SMB2_COMMANDS] = {
 };
 
 
+/*
+ * Ask the server for enough credits to cover this request, plus some
+ * extra until we hold SMB2_CREDITS_TARGET, so that the number of
+ * requests in flight can grow instead of staying at what we started with.
+ */
+static __le16
+smb2_credit_request(struct TCP_Server_Info *server, unsigned int charge)
+{
+	unsigned int request = max_t(unsigned int, charge, 1);
+
+	if (server && server->credits < SMB2_CREDITS_TARGET)
+		request += min_t(unsigned int, SMB2_CREDITS_EXTRA,
+				 SMB2_CREDITS_TARGET - server->credits);
+	return cpu_to_le16(request);
+}
+
 static void
 smb2_hdr_assemble(struct smb2_hdr *hdr, __le16 smb2_cmd /* command */ ,
 		  const struct cifs_tcon *tcon)
@@ -102,12 +118,15 @@ smb2_hdr_assemble(struct smb2_hdr *hdr, __le16 smb2_cmd /* command */ ,
 	hdr->ProtocolId[3] = 'B';
 	hdr->StructureSize = cpu_to_le16(64);
 	hdr->Command = smb2_cmd;
-	hdr->CreditRequest = cpu_to_le16(2); /* BB make this dynamic */
+	hdr->CreditRequest = cpu_to_le16(2);
 	hdr->ProcessId = cpu_to_le32((__u16)current->tgid);
 
 	if (!tcon)
 		goto out;
 
+	if (tcon->ses)
+		hdr->CreditRequest = smb2_credit_request(tcon->ses->server, 2);
+
 	/* GLOBAL_CAP_LARGE_MTU will only be set if dialect > SMB2.02 */
 	/* See sections 2.2.4 and 3.2.4.1.5 of MS-SMB2 */
 	if ((tcon->ses) &&
@@ -1798,6 +1817,8 @@ smb2_async_readv(struct cifs_readdata *rdata)
 	if (rdata->credits) {
 		buf->CreditCharge = cpu_to_le16(DIV_ROUND_UP(rdata->bytes,
 						SMB2_MAX_BUFFER_SIZE));
+		buf->CreditRequest = smb2_credit_request(server,
+					le16_to_cpu(buf->CreditCharge));
 		spin_lock(&server->req_lock);
 		server->credits += rdata->credits -
 						le16_to_cpu(buf->CreditCharge);
@@ -1981,6 +2002,8 @@ smb2_async_writev(struct cifs_writedata *wdata,
 	if (wdata->credits) {
 		req->hdr.CreditCharge = cpu_to_le16(DIV_ROUND_UP(wdata->bytes,
 						    SMB2_MAX_BUFFER_SIZE));
+		req->hdr.CreditRequest = smb2_credit_request(server,
+					le16_to_cpu(req->hdr.CreditCharge));
 		spin_lock(&server->req_lock);
 		server->credits += wdata->credits -
 					le16_to_cpu(req->hdr.CreditCharge);
@@ -462,6 +462,188 @@ int dax_fault(struct vm_area_struct *vma, struct vm_fault *vmf,
 }
 EXPORT_SYMBOL_GPL(dax_fault);
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * The 'colour' (ie low bits) within a PMD of a page offset.  This comes up
+ * more often than one might expect in the below function.
+ */
+#define PG_PMD_COLOUR	((PMD_SIZE >> PAGE_SHIFT) - 1)
+
+static int dax_insert_pfn_pmd(struct vm_area_struct *vma, unsigned long addr,
+			pmd_t *pmd, unsigned long pfn, bool write)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	spinlock_t *ptl;
+	pmd_t entry;
+
+	ptl = pmd_lock(mm, pmd);
+	/* somebody else faulted in this range first */
+	if (pmd_none(*pmd)) {
+		entry = pmd_mkhuge(pfn_pmd(pfn, vma->vm_page_prot));
+		if (write) {
+			entry = pmd_mkyoung(pmd_mkdirty(entry));
+			if (likely(vma->vm_flags & VM_WRITE))
+				entry = pmd_mkwrite(entry);
+		}
+		set_pmd_at(mm, addr & PMD_MASK, pmd, entry);
+		update_mmu_cache_pmd(vma, addr, pmd);
+	}
+	spin_unlock(ptl);
+	return VM_FAULT_NOPAGE;
+}
+
+static int do_dax_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+			pmd_t *pmd, unsigned int flags, get_block_t get_block)
+{
+	struct file *file = vma->vm_file;
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	struct buffer_head bh;
+	unsigned blkbits = inode->i_blkbits;
+	unsigned long pmd_addr = address & PMD_MASK;
+	bool write = flags & FAULT_FLAG_WRITE;
+	long length;
+	void *kaddr;
+	pgoff_t size, pgoff;
+	sector_t block, sector;
+	unsigned long pfn;
+	int result = 0;
+	int i;
+
+	/* Fall back to PTEs if we're going to COW */
+	if (write && !(vma->vm_flags & VM_SHARED))
+		return VM_FAULT_FALLBACK;
+	/* If the PMD would extend outside the VMA */
+	if (pmd_addr < vma->vm_start)
+		return VM_FAULT_FALLBACK;
+	if ((pmd_addr + PMD_SIZE) > vma->vm_end)
+		return VM_FAULT_FALLBACK;
+
+	pgoff = linear_page_index(vma, pmd_addr);
+	size = (i_size_read(inode) + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	if (pgoff >= size)
+		return VM_FAULT_SIGBUS;
+	/* If the PMD would cover blocks out of the file */
+	if ((pgoff | PG_PMD_COLOUR) >= size)
+		return VM_FAULT_FALLBACK;
+
+	memset(&bh, 0, sizeof(bh));
+	block = (sector_t)pgoff << (PAGE_SHIFT - blkbits);
+	bh.b_size = PMD_SIZE;
+
+	/*
+	 * Look before allocating: holes are left to the PTE path on reads,
+	 * and most files never get an extent that could back a PMD.
+	 */
+	if (get_block(inode, block, &bh, 0))
+		return VM_FAULT_SIGBUS;
+	if (!buffer_mapped(&bh) && !buffer_unwritten(&bh)) {
+		if (!write)
+			return VM_FAULT_FALLBACK;
+		memset(&bh, 0, sizeof(bh));
+		bh.b_size = PMD_SIZE;
+		if (get_block(inode, block, &bh, 1))
+			return VM_FAULT_SIGBUS;
+		count_vm_event(PGMAJFAULT);
+		mem_cgroup_count_vm_event(vma->vm_mm, PGMAJFAULT);
+		result |= VM_FAULT_MAJOR;
+	}
+
+	/*
+	 * If the filesystem isn't willing to tell us the length of the
+	 * extent, or it is too short, fall back to PTEs.  Calling get_block
+	 * 512 times in a loop would be silly.
+	 */
+	if (!buffer_size_valid(&bh) || bh.b_size < PMD_SIZE)
+		goto fallback;
+
+	i_mmap_lock_read(mapping);
+
+	/* Guard against a race with truncate */
+	size = (i_size_read(inode) + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	if (pgoff >= size) {
+		result = VM_FAULT_SIGBUS;
+		goto out;
+	}
+	if ((pgoff | PG_PMD_COLOUR) >= size)
+		goto fallback_unlock;
+
+	sector = bh.b_blocknr << (blkbits - 9);
+	length = bdev_direct_access(bh.b_bdev, sector, &kaddr, &pfn,
+				    bh.b_size);
+	if (length < 0) {
+		result = VM_FAULT_SIGBUS;
+		goto out;
+	}
+	/* the device must back the whole PMD with one aligned range */
+	if ((length < PMD_SIZE) || (pfn & PG_PMD_COLOUR))
+		goto fallback_unlock;
+
+	if (buffer_unwritten(&bh) || buffer_new(&bh)) {
+		for (i = 0; i < PTRS_PER_PMD; i++)
+			clear_page(kaddr + i * PAGE_SIZE);
+		clear_bit(BH_New, &bh.b_state);
+	}
+
+	result |= dax_insert_pfn_pmd(vma, address, pmd, pfn, write);
+
+ out:
+	i_mmap_unlock_read(mapping);
+	if (bh.b_end_io)
+		bh.b_end_io(&bh, 1);
+	return result;
+
+ fallback_unlock:
+	i_mmap_unlock_read(mapping);
+ fallback:
+	/*
+	 * Blocks we just allocated must not show up with stale contents
+	 * once the PTE path maps them.  Unwritten extents are left alone,
+	 * the PTE path zeroes and converts them itself.
+	 */
+	result = VM_FAULT_FALLBACK;
+	if (buffer_new(&bh) && buffer_size_valid(&bh)) {
+		if (dax_clear_blocks(inode, bh.b_blocknr, bh.b_size))
+			result = VM_FAULT_SIGBUS;
+		else if (bh.b_end_io)
+			bh.b_end_io(&bh, 1);
+	}
+	count_vm_event(THP_FAULT_FALLBACK);
+	return result;
+}
+
+/**
+ * dax_pmd_fault - handle a PMD fault on a DAX file
+ * @vma: The virtual memory area where the fault occurred
+ * @address: The faulting address
+ * @pmd: The PMD entry to install the mapping in
+ * @flags: The fault flags (FAULT_FLAG_*)
+ * @get_block: The filesystem method used to translate file offsets to blocks
+ *
+ * When a PMD fault occurs, filesystems may call this helper in their
+ * pmd_fault handler for DAX files.  The whole PMD is mapped if the file has
+ * one extent covering it on a device range that is PMD aligned, otherwise
+ * VM_FAULT_FALLBACK is returned and the fault is retried with PTEs.
+ */
+int dax_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+			pmd_t *pmd, unsigned int flags, get_block_t get_block)
+{
+	int result;
+	struct super_block *sb = file_inode(vma->vm_file)->i_sb;
+
+	if (flags & FAULT_FLAG_WRITE) {
+		sb_start_pagefault(sb);
+		file_update_time(vma->vm_file);
+	}
+	result = do_dax_pmd_fault(vma, address, pmd, flags, get_block);
+	if (flags & FAULT_FLAG_WRITE)
+		sb_end_pagefault(sb);
+
+	return result;
+}
+EXPORT_SYMBOL_GPL(dax_pmd_fault);
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+
 /**
  * dax_pfn_mkwrite - handle first write to DAX page
  * @vma: The virtual memory area where the fault occurred
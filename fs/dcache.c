@@ -118,6 +118,14 @@ struct dentry_stat_t dentry_stat = {
 
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
+static DEFINE_PER_CPU(long, nr_dentry_negative);
+
+/*
+ * Unused negative dentries allowed per superblock before they are trimmed
+ * in the background, 0 means no limit.  Set at boot to what fits in 5% of
+ * memory.
+ */
+unsigned long sysctl_negative_dentry_max __read_mostly;
 
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 
@@ -151,11 +159,21 @@ static long get_nr_dentry_unused(void)
 	return sum < 0 ? 0 : sum;
 }
 
+static long get_nr_dentry_negative(void)
+{
+	int i;
+	long sum = 0;
+	for_each_possible_cpu(i)
+		sum += per_cpu(nr_dentry_negative, i);
+	return sum < 0 ? 0 : sum;
+}
+
 int proc_nr_dentry(struct ctl_table *table, int write, void __user *buffer,
 		   size_t *lenp, loff_t *ppos)
 {
 	dentry_stat.nr_dentry = get_nr_dentry();
 	dentry_stat.nr_unused = get_nr_dentry_unused();
+	dentry_stat.nr_negative = get_nr_dentry_negative();
 	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
 }
 #endif
@@ -269,6 +287,29 @@ static inline int dname_external(const struct dentry *dentry)
 	return dentry->d_name.name != dentry->d_iname;
 }
 
+/*
+ * Negative dentries are counted while they are on an LRU list, that is
+ * while they are unused or about to be.  Every superblock keeps its own
+ * count as well, so that it can be trimmed when it has too many.
+ */
+static void dentry_negative_add(struct dentry *dentry)
+{
+	struct super_block *sb = dentry->d_sb;
+	unsigned long max = sysctl_negative_dentry_max;
+
+	this_cpu_inc(nr_dentry_negative);
+	percpu_counter_inc(&sb->s_nr_dentry_negative);
+	if (max && percpu_counter_read(&sb->s_nr_dentry_negative) > max &&
+	    (sb->s_flags & MS_ACTIVE))
+		schedule_work(&sb->s_dentry_trim_work);
+}
+
+static void dentry_negative_del(struct dentry *dentry)
+{
+	this_cpu_dec(nr_dentry_negative);
+	percpu_counter_dec(&dentry->d_sb->s_nr_dentry_negative);
+}
+
 /*
  * Make sure other CPUs see the inode attached before the type is set.
  */
@@ -281,6 +322,10 @@ static inline void __d_set_inode_and_type(struct dentry *dentry,
 	dentry->d_inode = inode;
 	smp_wmb();
 	flags = READ_ONCE(dentry->d_flags);
+	if (unlikely(flags & DCACHE_LRU_LIST) &&
+	    (type_flags & DCACHE_ENTRY_TYPE) != DCACHE_MISS_TYPE &&
+	    (flags & DCACHE_ENTRY_TYPE) == DCACHE_MISS_TYPE)
+		dentry_negative_del(dentry);
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
 	flags |= type_flags;
 	WRITE_ONCE(dentry->d_flags, flags);
@@ -298,6 +343,9 @@ static inline void __d_clear_type_and_inode(struct dentry *dentry)
 {
 	unsigned flags = READ_ONCE(dentry->d_flags);
 
+	if (unlikely(flags & DCACHE_LRU_LIST) &&
+	    (flags & DCACHE_ENTRY_TYPE) != DCACHE_MISS_TYPE)
+		dentry_negative_add(dentry);
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
 	WRITE_ONCE(dentry->d_flags, flags);
 	smp_wmb();
@@ -392,7 +440,8 @@ static void dentry_unlink_inode(struct dentry * dentry)
  * on the shrink list (ie not on the superblock LRU list).
  *
  * The per-cpu "nr_dentry_unused" counters are updated with
- * the DCACHE_LRU_LIST bit.
+ * the DCACHE_LRU_LIST bit, "nr_dentry_negative" as well if the
+ * dentry is negative.
  *
  * These helper functions make sure we always follow the
  * rules. d_lock must be held by the caller.
@@ -403,6 +452,8 @@ static void d_lru_add(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, 0);
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		dentry_negative_add(dentry);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -411,6 +462,8 @@ static void d_lru_del(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		dentry_negative_del(dentry);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -420,6 +473,8 @@ static void d_shrink_del(struct dentry *dentry)
 	list_del_init(&dentry->d_lru);
 	dentry->d_flags &= ~(DCACHE_SHRINK_LIST | DCACHE_LRU_LIST);
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		dentry_negative_del(dentry);
 }
 
 static void d_shrink_add(struct dentry *dentry, struct list_head *list)
@@ -428,6 +483,8 @@ static void d_shrink_add(struct dentry *dentry, struct list_head *list)
 	list_add(&dentry->d_lru, list);
 	dentry->d_flags |= DCACHE_SHRINK_LIST | DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		dentry_negative_add(dentry);
 }
 
 /*
@@ -441,6 +498,8 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	if (d_is_negative(dentry))
+		dentry_negative_del(dentry);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
 
@@ -1097,6 +1156,56 @@ long prune_dcache_sb(struct super_block *sb, struct shrink_control *sc)
 	return freed;
 }
 
+static enum lru_status dentry_negative_isolate(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct dentry *dentry = container_of(item, struct dentry, d_lru);
+
+	/* positive ones are left to the shrinker */
+	if (!d_is_negative(dentry))
+		return LRU_SKIP;
+
+	return dentry_lru_isolate(item, lru, lru_lock, arg);
+}
+
+/*
+ * Background trimming of the negative dentries of a superblock that went
+ * over sysctl_negative_dentry_max.  This frees them in small batches
+ * instead of leaving it all to a shrinker run in direct reclaim.
+ */
+void prune_dcache_negative_work(struct work_struct *work)
+{
+	struct super_block *sb = container_of(work, struct super_block,
+					      s_dentry_trim_work);
+	unsigned long max = sysctl_negative_dentry_max;
+	long excess, freed;
+
+	/* umount in progress, it is going to free them all anyway */
+	if (!down_read_trylock(&sb->s_umount))
+		return;
+	if (!(sb->s_flags & MS_ACTIVE))
+		goto out;
+
+	do {
+		LIST_HEAD(dispose);
+
+		if (!max)
+			break;
+		excess = percpu_counter_read_positive(&sb->s_nr_dentry_negative) -
+			 max;
+		if (excess <= 0)
+			break;
+		/* trim a bit below the limit so we don't come back at once */
+		excess = min_t(long, excess + max / 16, 1024);
+		freed = list_lru_walk(&sb->s_dentry_lru, dentry_negative_isolate,
+				      &dispose, excess);
+		shrink_dentry_list(&dispose);
+		cond_resched();
+	} while (freed > 0);
+out:
+	up_read(&sb->s_umount);
+}
+
 static enum lru_status dentry_lru_isolate_shrink(struct list_head *item,
 		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
 {
@@ -1744,11 +1853,16 @@ type_determined:
 	return add_flags;
 }
 
+static void __d_lookup_done(struct dentry *dentry);
+
 static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 {
 	unsigned add_flags = d_flags_for_inode(inode);
 
 	spin_lock(&dentry->d_lock);
+	/* d_alias shares memory with the in-lookup hash */
+	if (unlikely(d_in_lookup(dentry)))
+		__d_lookup_done(dentry);
 	if (inode)
 		hlist_add_head(&dentry->d_u.d_alias, &inode->i_dentry);
 	__d_set_inode_and_type(dentry, inode, add_flags);
@@ -2333,6 +2447,142 @@ next:
  	return found;
 }
 
+/*
+ * Dentries that are being looked up with the parent only locked shared
+ * sit in a small hash of their own until ->lookup() is done with them.
+ * A second lookup of the same name waits for the first one instead of
+ * allocating a duplicate.
+ */
+#define IN_LOOKUP_SHIFT		10
+
+struct in_lookup_bucket {
+	struct hlist_bl_head	head;
+	unsigned int		seq;	/* bumped when an entry leaves */
+	wait_queue_head_t	wait;
+};
+
+static struct in_lookup_bucket in_lookup_hashtable[1 << IN_LOOKUP_SHIFT];
+
+static inline struct in_lookup_bucket *in_lookup_hash(unsigned int hash)
+{
+	return in_lookup_hashtable + hash_32(hash, IN_LOOKUP_SHIFT);
+}
+
+static bool d_same_name(const struct dentry *dentry,
+			const struct dentry *parent, const struct qstr *name)
+{
+	if (dentry->d_name.hash != name->hash)
+		return false;
+	if (parent->d_flags & DCACHE_OP_COMPARE)
+		return !parent->d_op->d_compare(parent, dentry,
+						dentry->d_name.len,
+						dentry->d_name.name, name);
+	if (dentry->d_name.len != name->len)
+		return false;
+	return !dentry_cmp(dentry, name->name, name->len);
+}
+
+/**
+ * d_alloc_parallel - find or allocate a dentry for a shared-locked lookup
+ * @parent: parent dentry, its inode's i_lookup_rwsem held shared
+ * @name: hashed qstr of the name
+ *
+ * Returns a dentry from the dcache if there is one, waiting for a lookup
+ * of the same name in progress to finish first.  Otherwise a new dentry
+ * is returned with d_in_lookup() true; the caller must pass it to
+ * ->lookup() and then call d_lookup_done() on it.
+ */
+struct dentry *d_alloc_parallel(struct dentry *parent, const struct qstr *name)
+{
+	struct in_lookup_bucket *b = in_lookup_hash(name->hash);
+	struct dentry *new = d_alloc(parent, name);
+	struct hlist_bl_node *node;
+	struct dentry *dentry;
+	unsigned int seq;
+
+	if (unlikely(!new))
+		return ERR_PTR(-ENOMEM);
+retry:
+	seq = ACCESS_ONCE(b->seq);
+	smp_rmb();
+	dentry = d_lookup(parent, name);
+	if (dentry) {
+		dput(new);
+		return dentry;
+	}
+
+	rcu_read_lock();
+	hlist_bl_lock(&b->head);
+	/* a lookup finished after we missed in the dcache, look again */
+	if (unlikely(b->seq != seq)) {
+		hlist_bl_unlock(&b->head);
+		rcu_read_unlock();
+		goto retry;
+	}
+	hlist_bl_for_each_entry(dentry, node, &b->head, d_u.d_in_lookup_hash) {
+		if (dentry->d_parent != parent || !d_same_name(dentry, parent, name))
+			continue;
+		hlist_bl_unlock(&b->head);
+		if (!lockref_get_not_dead(&dentry->d_lockref)) {
+			rcu_read_unlock();
+			goto retry;
+		}
+		rcu_read_unlock();
+
+		wait_event(b->wait, !d_in_lookup(dentry));
+
+		spin_lock(&dentry->d_lock);
+		if (unlikely(d_unhashed(dentry) || dentry->d_parent != parent ||
+			     !d_same_name(dentry, parent, name))) {
+			/* ->lookup() used another dentry, or failed */
+			spin_unlock(&dentry->d_lock);
+			dput(dentry);
+			goto retry;
+		}
+		spin_unlock(&dentry->d_lock);
+		dput(new);
+		return dentry;
+	}
+	rcu_read_unlock();
+
+	/* nobody else can see new yet */
+	new->d_flags |= DCACHE_PAR_LOOKUP | DCACHE_RCUACCESS;
+	hlist_bl_add_head(&new->d_u.d_in_lookup_hash, &b->head);
+	hlist_bl_unlock(&b->head);
+	return new;
+}
+EXPORT_SYMBOL(d_alloc_parallel);
+
+/* dentry->d_lock held */
+static void __d_lookup_done(struct dentry *dentry)
+{
+	struct in_lookup_bucket *b = in_lookup_hash(dentry->d_name.hash);
+
+	hlist_bl_lock(&b->head);
+	dentry->d_flags &= ~DCACHE_PAR_LOOKUP;
+	__hlist_bl_del(&dentry->d_u.d_in_lookup_hash);
+	b->seq++;
+	hlist_bl_unlock(&b->head);
+	INIT_HLIST_NODE(&dentry->d_u.d_alias);
+	wake_up_all(&b->wait);
+}
+
+/**
+ * d_lookup_done - finish a lookup started by d_alloc_parallel()
+ * @dentry: the dentry passed to ->lookup()
+ *
+ * Wakes up everybody waiting to look up the same name.  The dentry may
+ * already be done if ->lookup() instantiated it.
+ */
+void d_lookup_done(struct dentry *dentry)
+{
+	spin_lock(&dentry->d_lock);
+	if (d_in_lookup(dentry))
+		__d_lookup_done(dentry);
+	spin_unlock(&dentry->d_lock);
+}
+EXPORT_SYMBOL(d_lookup_done);
+
 /**
  * d_hash_and_lookup - hash the qstr then search for a dentry
  * @dir: Directory to search in
@@ -3416,6 +3666,12 @@ static void __init dcache_init(void)
 	dentry_cache = KMEM_CACHE(dentry,
 		SLAB_RECLAIM_ACCOUNT|SLAB_PANIC|SLAB_MEM_SPREAD);
 
+	sysctl_negative_dentry_max = (totalram_pages / 20) *
+				     (PAGE_SIZE / sizeof(struct dentry));
+
+	for (loop = 0; loop < (1U << IN_LOOKUP_SHIFT); loop++)
+		init_waitqueue_head(&in_lookup_hashtable[loop].wait);
+
 	/* Hash may have been set up in dcache_init_early */
 	if (!hashdist)
 		return;
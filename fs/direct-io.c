@@ -37,6 +37,7 @@
 #include <linux/uio.h>
 #include <linux/atomic.h>
 #include <linux/prefetch.h>
+#include "internal.h"
 
 /*
  * How many user pages to map in one call to get_user_pages().  This determines
@@ -124,6 +125,7 @@ struct dio {
 	unsigned long refcount;		/* direct_io_worker() and bios */
 	struct bio *bio_list;		/* singly linked via bi_private */
 	struct task_struct *waiter;	/* waiting task (NULL if none) */
+	struct block_device *bio_bdev;	/* last bdev submitted to, for polling */
 
 	/* AIO related stuff */
 	struct kiocb *iocb;		/* kiocb */
@@ -394,6 +396,8 @@ static inline void dio_bio_submit(struct dio *dio, struct dio_submit *sdio)
 	if (dio->is_async && dio->rw == READ)
 		bio_set_pages_dirty(bio);
 
+	dio->bio_bdev = bio->bi_bdev;
+
 	if (sdio->submit_io)
 		sdio->submit_io(dio->rw, bio, dio->inode,
 			       sdio->logical_offset_in_bio);
@@ -437,7 +441,8 @@ static struct bio *dio_await_one(struct dio *dio)
 		__set_current_state(TASK_UNINTERRUPTIBLE);
 		dio->waiter = current;
 		spin_unlock_irqrestore(&dio->bio_lock, flags);
-		io_schedule();
+		if (!dio->bio_bdev || !blk_poll(bdev_get_queue(dio->bio_bdev)))
+			io_schedule();
 		/* wake up sets us TASK_RUNNING */
 		spin_lock_irqsave(&dio->bio_lock, flags);
 		dio->waiter = NULL;
@@ -1067,6 +1072,122 @@ static inline int drop_refcount(struct dio *dio)
 	return ret2;
 }
 
+/*
+ * Small synchronous reads that map to a single extent don't need any of
+ * the dio state machine: the user pages go into one bio on the stack,
+ * we wait for it and are done.
+ */
+bool dio_read_simple_ok(struct kiocb *iocb, struct iov_iter *iter,
+			loff_t offset, unsigned blkbits, loff_t i_size)
+{
+	size_t count = iov_iter_count(iter);
+
+	if (iov_iter_rw(iter) != READ || !is_sync_kiocb(iocb) || !count)
+		return false;
+	if ((offset | iov_iter_alignment(iter)) & ((1 << blkbits) - 1))
+		return false;
+	if (offset + count > i_size)
+		return false;
+	return iov_iter_npages(iter, DIO_INLINE_BIO_VECS + 1) <=
+		DIO_INLINE_BIO_VECS;
+}
+
+/*
+ * Returns -ENOTBLK before any I/O was issued if the caller has to fall
+ * back to the full path, @iter is only advanced on success.
+ */
+ssize_t dio_read_simple(struct block_device *bdev, sector_t sector,
+			struct iov_iter *iter)
+{
+	struct bio_vec vecs[DIO_INLINE_BIO_VECS];
+	struct page *pages[DIO_INLINE_BIO_VECS];
+	size_t count = iov_iter_count(iter);
+	struct iov_iter i = *iter;
+	int nr_pages = 0, n;
+	struct bio bio;
+	ssize_t ret;
+
+	bio_init(&bio);
+	bio.bi_io_vec = vecs;
+	bio.bi_max_vecs = DIO_INLINE_BIO_VECS;
+	bio.bi_bdev = bdev;
+	bio.bi_iter.bi_sector = sector;
+
+	while (iov_iter_count(&i)) {
+		size_t start, len;
+
+		if (nr_pages == DIO_INLINE_BIO_VECS) {
+			ret = -ENOTBLK;
+			goto out_release;
+		}
+		ret = iov_iter_get_pages(&i, pages + nr_pages, LONG_MAX,
+					 DIO_INLINE_BIO_VECS - nr_pages, &start);
+		if (ret <= 0) {
+			ret = -ENOTBLK;
+			goto out_release;
+		}
+		iov_iter_advance(&i, ret);
+
+		n = nr_pages + DIV_ROUND_UP(ret + start, PAGE_SIZE);
+		for (; nr_pages < n; nr_pages++) {
+			len = min_t(size_t, ret, PAGE_SIZE - start);
+			if (bio_add_page(&bio, pages[nr_pages], len,
+					 start) != len) {
+				/* queue limits, let the full path split it */
+				nr_pages = n;
+				ret = -ENOTBLK;
+				goto out_release;
+			}
+			ret -= len;
+			start = 0;
+		}
+	}
+
+	ret = submit_bio_wait(READ, &bio);
+	if (!ret) {
+		iov_iter_advance(iter, count);
+		ret = count;
+	}
+
+out_release:
+	for (n = 0; n < nr_pages; n++) {
+		if (ret > 0 && !PageCompound(pages[n]))
+			set_page_dirty_lock(pages[n]);
+		page_cache_release(pages[n]);
+	}
+	return ret;
+}
+
+/*
+ * Single extent read: ask the filesystem for the mapping of the whole
+ * range and only go the simple way if it is backed by written blocks.
+ */
+static ssize_t dio_read_mapped(struct inode *inode, struct iov_iter *iter,
+			       loff_t offset, get_block_t get_block)
+{
+	unsigned blkbits = inode->i_blkbits;
+	size_t count = iov_iter_count(iter);
+	struct buffer_head map_bh = { 0, };
+	ssize_t ret;
+
+	if (offset & ((1 << blkbits) - 1))
+		return -ENOTBLK;
+
+	map_bh.b_size = ALIGN(count, 1 << blkbits);
+	ret = get_block(inode, offset >> blkbits, &map_bh, 0);
+	if (ret)
+		return -ENOTBLK;
+	if (!buffer_mapped(&map_bh) || buffer_new(&map_bh) ||
+	    buffer_unwritten(&map_bh) || map_bh.b_size < count)
+		return -ENOTBLK;
+
+	atomic_inc(&inode->i_dio_count);
+	ret = dio_read_simple(map_bh.b_bdev,
+			      map_bh.b_blocknr << (blkbits - 9), iter);
+	inode_dio_done(inode);
+	return ret;
+}
+
 /*
  * This is a library function for use by filesystem drivers.
  *
@@ -1127,6 +1248,14 @@ do_blockdev_direct_IO(struct kiocb *iocb, struct inode *inode,
 	if (iov_iter_rw(iter) == READ && !iov_iter_count(iter))
 		return 0;
 
+	if (!end_io && !submit_io && !(flags & DIO_LOCKING) &&
+	    dio_read_simple_ok(iocb, iter, offset, blkbits,
+			       i_size_read(inode))) {
+		retval = dio_read_mapped(inode, iter, offset, get_block);
+		if (retval != -ENOTBLK)
+			goto out;
+	}
+
 	dio = kmem_cache_alloc(dio_cache, GFP_KERNEL);
 	retval = -ENOMEM;
 	if (!dio)
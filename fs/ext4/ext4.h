@@ -945,6 +945,9 @@ struct ext4_inode_info {
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
 
+	/* Transaction that has to be fully committed to fsync the inode */
+	tid_t i_fc_ineligible_tid;
+
 #ifdef CONFIG_QUOTA
 	struct dquot *i_dquot[MAXQUOTAS];
 #endif
@@ -1004,6 +1007,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DIOREAD_NOLOCK	0x400000 /* Enable support for dio read nolocking */
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
+#define EXT4_MOUNT_FAST_COMMIT		0x2000000 /* Fast commits for fsync */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1260,6 +1264,8 @@ struct ext4_sb_info {
 	struct percpu_counter s_freeinodes_counter;
 	struct percpu_counter s_dirs_counter;
 	struct percpu_counter s_dirtyclusters_counter;
+	struct percpu_counter s_dax_pmd_faults;	/* DAX faults mapped by PMDs */
+	struct percpu_counter s_dax_pte_faults;	/* and by PTEs */
 	struct blockgroup_lock *s_blockgroup_lock;
 	struct proc_dir_entry *s_proc;
 	struct kobject s_kobj;
@@ -1276,6 +1282,11 @@ struct ext4_sb_info {
 	u32 s_max_batch_time;
 	u32 s_min_batch_time;
 	struct block_device *journal_bdev;
+
+	/* Fast commits */
+	tid_t s_fc_ineligible_tid;		/* needs a full commit */
+	int s_fc_ineligible;			/* s_fc_ineligible_tid is valid */
+	int s_fc_replay_blocks;			/* valid blocks found by recovery */
 #ifdef CONFIG_QUOTA
 	char *s_qf_names[EXT4_MAXQUOTAS];	/* Names of quota files with journalled quota */
 	int s_jquota_fmt;			/* Format of quota to use */
@@ -1309,6 +1320,7 @@ struct ext4_sb_info {
 	unsigned int s_mb_stats;
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
+	unsigned int s_mb_optimize_scan;
 	unsigned int s_max_dir_size_kb;
 	/* where last allocation was done - for stream allocation */
 	unsigned long s_mb_last_group;
@@ -1333,6 +1345,19 @@ struct ext4_sb_info {
 	/* locality groups */
 	struct ext4_locality_group __percpu *s_locality_groups;
 
+	/*
+	 * Initialized groups indexed by the order of their largest free
+	 * extent and by the order of their average fragment size, so that
+	 * cr 0 and cr 1 can pick a group without walking all of them.
+	 * Each list has its own lock, s_mb_cpu_group is where the linear
+	 * scan of cr 2 and 3 starts on each cpu.
+	 */
+	struct list_head *s_mb_largest_free_orders;
+	rwlock_t *s_mb_largest_free_orders_locks;
+	struct list_head *s_mb_avg_fragment_size;
+	rwlock_t *s_mb_avg_fragment_size_locks;
+	ext4_group_t __percpu *s_mb_cpu_group;
+
 	/* for write statistics */
 	unsigned long s_sectors_written_start;
 	u64 s_kbytes_written;
@@ -1450,6 +1475,7 @@ enum {
 	EXT4_STATE_MAY_INLINE_DATA,	/* may have in-inode data */
 	EXT4_STATE_ORDERED_MODE,	/* data=ordered mode */
 	EXT4_STATE_EXT_PRECACHED,	/* extents have been precached */
+	EXT4_STATE_FC_INELIGIBLE,	/* i_fc_ineligible_tid is valid */
 };
 
 #define EXT4_INODE_BIT_FNS(name, field, offset)				\
@@ -2190,6 +2216,15 @@ extern int ext4_check_all_de(struct inode *dir, struct buffer_head *bh,
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 
+/* fast_commit.c */
+extern void ext4_fc_mark_ineligible(struct super_block *sb,
+				    struct inode *inode, handle_t *handle);
+extern int ext4_fc_commit(journal_t *journal, struct inode *inode,
+			  tid_t commit_tid);
+extern int ext4_fc_replay(journal_t *journal, struct buffer_head *bh,
+			  enum passtype pass, int off, tid_t expected_tid);
+extern void ext4_fc_init(struct super_block *sb, journal_t *journal);
+
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
 			  dx_hash_info *hinfo);
@@ -2641,7 +2676,11 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_free;	/* total free blocks */
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
+	ext4_grpblk_t	bb_avg_fragment_size_order;/* order of avg frag size */
+	ext4_group_t	bb_group;	/* group number */
 	struct          list_head bb_prealloc_list;
+	struct          list_head bb_largest_free_order_node;
+	struct          list_head bb_avg_fragment_size_node;
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
 #endif
@@ -5535,6 +5535,10 @@ ext4_swap_extents(handle_t *handle, struct inode *inode1,
 	BUG_ON(!mutex_is_locked(&inode1->i_mutex));
 	BUG_ON(!mutex_is_locked(&inode1->i_mutex));
 
+	/* replaying one side alone would leave blocks owned twice */
+	ext4_fc_mark_ineligible(inode1->i_sb, inode1, handle);
+	ext4_fc_mark_ineligible(inode2->i_sb, inode2, handle);
+
 	*erp = ext4_es_remove_extent(inode1, lblk1, count);
 	if (unlikely(*erp))
 		return 0;
@@ -0,0 +1,472 @@
+/*
+ * fs/ext4/fast_commit.c
+ *
+ * Fast commits for fsync().
+ *
+ * A full jbd2 commit writes every metadata block the running transaction
+ * touched.  For the common case of fsync() on a regular file that only
+ * rewrote or appended data, all recovery needs is the inode itself and
+ * the blocks its extents now cover.  A fast commit logs the raw on-disk
+ * inode into the jbd2 fast commit area instead, and replay writes it
+ * back to the inode table and marks its extents in the block bitmaps.
+ *
+ * Anything replay can't redo from the inode alone - directory entries,
+ * inode or block frees, xattr blocks, extent index blocks, group
+ * initialisation - marks the inode or the whole filesystem ineligible
+ * for the running transaction, and fsync() then waits for a full commit
+ * as before.  Full commits still happen on the usual schedule and empty
+ * the fast commit area.
+ */
+
+#include <linux/fs.h>
+#include <linux/crc32.h>
+#include <linux/blkdev.h>
+#include <linux/quotaops.h>
+#include <linux/slab.h>
+
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+#include "fast_commit.h"
+
+/* A block must fit the head, one inode record and the tail */
+static unsigned int ext4_fc_max_record_bytes(struct super_block *sb)
+{
+	return 3 * sizeof(struct ext4_fc_tl) + sizeof(struct ext4_fc_head) +
+		sizeof(struct ext4_fc_inode) + EXT4_INODE_SIZE(sb) +
+		sizeof(struct ext4_fc_tail);
+}
+
+/*
+ * Note that the running transaction does something replay can't redo.
+ * With @inode, only fast commits of that inode are affected, otherwise
+ * all of them are.
+ */
+void ext4_fc_mark_ineligible(struct super_block *sb, struct inode *inode,
+			     handle_t *handle)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	tid_t tid;
+
+	if (!test_opt(sb, FAST_COMMIT) || !ext4_handle_valid(handle))
+		return;
+
+	tid = handle->h_transaction->t_tid;
+	if (inode) {
+		EXT4_I(inode)->i_fc_ineligible_tid = tid;
+		smp_wmb();
+		ext4_set_inode_state(inode, EXT4_STATE_FC_INELIGIBLE);
+	} else {
+		sbi->s_fc_ineligible_tid = tid;
+		smp_wmb();
+		sbi->s_fc_ineligible = 1;
+	}
+}
+
+static bool ext4_fc_eligible(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	if (!S_ISREG(inode->i_mode) ||
+	    !ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS) ||
+	    ext4_has_inline_data(inode) || ext4_should_journal_data(inode) ||
+	    sb_any_quota_loaded(sb))
+		return false;
+
+	if (sbi->s_fc_ineligible) {
+		smp_rmb();
+		if (sbi->s_fc_ineligible_tid == tid)
+			return false;
+	}
+	if (ext4_test_inode_state(inode, EXT4_STATE_FC_INELIGIBLE)) {
+		smp_rmb();
+		if (EXT4_I(inode)->i_fc_ineligible_tid == tid)
+			return false;
+	}
+	return true;
+}
+
+static u8 *ext4_fc_add_tlv(u8 *dst, u16 tag, u16 len, const void *val,
+			   const void *val2, u16 len2)
+{
+	struct ext4_fc_tl tl;
+
+	tl.fc_tag = cpu_to_le16(tag);
+	tl.fc_len = cpu_to_le16(len + len2);
+	memcpy(dst, &tl, sizeof(tl));
+	dst += sizeof(tl);
+	memcpy(dst, val, len);
+	dst += len;
+	if (len2) {
+		memcpy(dst, val2, len2);
+		dst += len2;
+	}
+	return dst;
+}
+
+/*
+ * Copy the on-disk inode once all of its data is on disk.  The copy is
+ * only good for a fast commit if nothing got dirty behind our back and
+ * the extents still fit in i_block.
+ */
+static int ext4_fc_copy_inode(struct inode *inode, struct ext4_inode *raw)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	struct ext4_extent_header *eh;
+	struct ext4_iloc iloc;
+	int ret;
+
+	ret = filemap_write_and_wait(inode->i_mapping);
+	if (ret)
+		return ret;
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		return ret;
+
+	spin_lock(&ei->i_raw_lock);
+	memcpy(raw, ext4_raw_inode(&iloc), EXT4_INODE_SIZE(inode->i_sb));
+	spin_unlock(&ei->i_raw_lock);
+	brelse(iloc.bh);
+
+	if (mapping_tagged(inode->i_mapping, PAGECACHE_TAG_DIRTY) ||
+	    mapping_tagged(inode->i_mapping, PAGECACHE_TAG_WRITEBACK) ||
+	    atomic_read(&ei->i_unwritten))
+		return -EAGAIN;
+
+	eh = (struct ext4_extent_header *)raw->i_block;
+	if (eh->eh_magic != EXT4_EXT_MAGIC || eh->eh_depth)
+		return -EAGAIN;
+	return 0;
+}
+
+static int ext4_fc_write_block(journal_t *journal, struct inode *inode,
+			       struct ext4_inode *raw, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_fc_inode fc_inode;
+	struct ext4_fc_head head;
+	struct ext4_fc_tail tail;
+	struct buffer_head *bh;
+	bool first = journal->j_fc_off == 0;
+	u8 *start, *dst;
+	int write_op = WRITE_SYNC;
+	int ret;
+
+	ret = jbd2_fc_get_buf(journal, &bh);
+	if (ret)
+		return ret;
+
+	lock_buffer(bh);
+	start = dst = (u8 *)bh->b_data;
+	memset(start, 0, bh->b_size);
+
+	if (first) {
+		head.fc_features = 0;
+		head.fc_tid = cpu_to_le32(tid);
+		dst = ext4_fc_add_tlv(dst, EXT4_FC_TAG_HEAD, sizeof(head),
+				      &head, NULL, 0);
+	}
+
+	fc_inode.fc_ino = cpu_to_le32(inode->i_ino);
+	dst = ext4_fc_add_tlv(dst, EXT4_FC_TAG_INODE, sizeof(fc_inode),
+			      &fc_inode, raw, EXT4_INODE_SIZE(sb));
+
+	tail.fc_tid = cpu_to_le32(tid);
+	tail.fc_crc = 0;
+	dst = ext4_fc_add_tlv(dst, EXT4_FC_TAG_TAIL, sizeof(tail),
+			      &tail, NULL, 0);
+	tail.fc_crc = cpu_to_le32(crc32_le(~0, start, dst - start -
+					   sizeof(tail.fc_crc)));
+	memcpy(dst - sizeof(tail.fc_crc), &tail.fc_crc, sizeof(tail.fc_crc));
+
+	set_buffer_uptodate(bh);
+	set_buffer_dirty(bh);
+	unlock_buffer(bh);
+
+	/*
+	 * The data went to the filesystem device, get it out of the cache
+	 * first if that isn't where the journal lives.
+	 */
+	if (journal->j_flags & JBD2_BARRIER) {
+		if (journal->j_fs_dev != journal->j_dev) {
+			ret = blkdev_issue_flush(journal->j_fs_dev, GFP_NOFS,
+						 NULL);
+			if (ret)
+				goto out;
+		}
+		write_op = WRITE_FLUSH_FUA;
+	}
+
+	ret = __sync_dirty_buffer(bh, write_op);
+out:
+	brelse(bh);
+	return ret;
+}
+
+/**
+ * ext4_fc_commit - make an inode durable without a full journal commit
+ * @journal:	the filesystem journal
+ * @inode:	inode being fsync()ed
+ * @commit_tid:	transaction holding the inode's last change
+ *
+ * Returns 0 once the inode and its data are safely in the fast commit
+ * area.  On any other return the caller has to wait for @commit_tid to
+ * commit instead.
+ */
+int ext4_fc_commit(journal_t *journal, struct inode *inode, tid_t commit_tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_inode *raw;
+	int ret;
+
+	if (!test_opt(sb, FAST_COMMIT) || !test_opt(sb, DELALLOC) ||
+	    !ext4_fc_eligible(inode, commit_tid))
+		return -EAGAIN;
+
+	raw = kmalloc(EXT4_INODE_SIZE(sb), GFP_NOFS);
+	if (!raw)
+		return -ENOMEM;
+
+	/* i_mutex keeps buffered writes from allocating while we copy */
+	mutex_lock(&inode->i_mutex);
+	ret = ext4_fc_copy_inode(inode, raw);
+	if (ret)
+		goto out;
+
+	ret = jbd2_fc_begin_commit(journal, commit_tid);
+	if (ret)
+		goto out;
+
+	/* the inode may have become ineligible until we got the area */
+	if (ext4_fc_eligible(inode, commit_tid))
+		ret = ext4_fc_write_block(journal, inode, raw, commit_tid);
+	else
+		ret = -EAGAIN;
+
+	jbd2_fc_end_commit(journal);
+out:
+	mutex_unlock(&inode->i_mutex);
+	kfree(raw);
+	return ret;
+}
+
+static int ext4_fc_mark_blocks_used(struct super_block *sb,
+				    ext4_fsblk_t pblk, unsigned int len)
+{
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bitmap_bh, *gd_bh;
+	ext4_group_t group;
+	ext4_grpblk_t bit;
+	unsigned int n, i, newly_used;
+
+	while (len) {
+		ext4_get_group_no_and_offset(sb, pblk, &group, &bit);
+		n = min_t(unsigned int, len, EXT4_BLOCKS_PER_GROUP(sb) - bit);
+
+		gdp = ext4_get_group_desc(sb, group, &gd_bh);
+		if (!gdp)
+			return -EIO;
+		/* groups are initialised by full commits only */
+		if (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT))
+			return -EIO;
+
+		bitmap_bh = sb_bread(sb, ext4_block_bitmap(sb, gdp));
+		if (!bitmap_bh)
+			return -EIO;
+
+		newly_used = 0;
+		for (i = 0; i < n; i++)
+			if (!ext4_test_and_set_bit(bit + i, bitmap_bh->b_data))
+				newly_used++;
+
+		if (newly_used) {
+			ext4_free_group_clusters_set(sb, gdp,
+				ext4_free_group_clusters(sb, gdp) - newly_used);
+			ext4_block_bitmap_csum_set(sb, group, gdp, bitmap_bh);
+			ext4_group_desc_csum_set(sb, group, gdp);
+			mark_buffer_dirty(bitmap_bh);
+			mark_buffer_dirty(gd_bh);
+		}
+		brelse(bitmap_bh);
+
+		pblk += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb, unsigned long ino,
+				struct ext4_inode *raw)
+{
+	struct ext4_extent_header *eh;
+	struct ext4_extent *ex;
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	unsigned long offset;
+	ext4_group_t group;
+	int i, ret;
+
+	eh = (struct ext4_extent_header *)raw->i_block;
+	if (eh->eh_magic != EXT4_EXT_MAGIC || eh->eh_depth ||
+	    le16_to_cpu(eh->eh_entries) > le16_to_cpu(eh->eh_max) ||
+	    le16_to_cpu(eh->eh_max) > (sizeof(raw->i_block) - sizeof(*eh)) /
+				      sizeof(struct ext4_extent))
+		return -EIO;
+
+	group = (ino - 1) / EXT4_INODES_PER_GROUP(sb);
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) *
+		EXT4_INODE_SIZE(sb);
+	gdp = ext4_get_group_desc(sb, group, NULL);
+	if (!gdp)
+		return -EIO;
+
+	bh = sb_bread(sb, ext4_inode_table(sb, gdp) +
+		      offset / EXT4_BLOCK_SIZE(sb));
+	if (!bh)
+		return -EIO;
+	memcpy(bh->b_data + offset % EXT4_BLOCK_SIZE(sb), raw,
+	       EXT4_INODE_SIZE(sb));
+	mark_buffer_dirty(bh);
+	brelse(bh);
+
+	ex = EXT_FIRST_EXTENT(eh);
+	for (i = 0; i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+		ret = ext4_fc_mark_blocks_used(sb, ext4_ext_pblock(ex),
+					       ext4_ext_get_actual_len(ex));
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+/*
+ * Walk the records of a fast commit block.  With @replay unset only
+ * check that the block is a complete fast commit of @tid.
+ */
+static int ext4_fc_walk_block(struct super_block *sb, struct buffer_head *bh,
+			      int off, tid_t tid, bool replay)
+{
+	u8 *start = (u8 *)bh->b_data, *pos = start, *end = start + bh->b_size;
+	struct ext4_fc_inode fc_inode;
+	struct ext4_fc_head head;
+	struct ext4_fc_tail tail;
+	struct ext4_fc_tl tl;
+	unsigned int len;
+	int ret;
+
+	while (pos + sizeof(tl) <= end) {
+		memcpy(&tl, pos, sizeof(tl));
+		len = le16_to_cpu(tl.fc_len);
+		if (pos + sizeof(tl) + len > end)
+			return -EINVAL;
+
+		switch (le16_to_cpu(tl.fc_tag)) {
+		case EXT4_FC_TAG_HEAD:
+			if (off || pos != start || len != sizeof(head))
+				return -EINVAL;
+			memcpy(&head, pos + sizeof(tl), sizeof(head));
+			if (le32_to_cpu(head.fc_tid) != tid ||
+			    head.fc_features)
+				return -EINVAL;
+			break;
+		case EXT4_FC_TAG_INODE:
+			if (!off && pos == start)
+				return -EINVAL;
+			if (len != sizeof(fc_inode) + EXT4_INODE_SIZE(sb))
+				return -EINVAL;
+			memcpy(&fc_inode, pos + sizeof(tl), sizeof(fc_inode));
+			if (le32_to_cpu(fc_inode.fc_ino) < EXT4_FIRST_INO(sb) ||
+			    !ext4_valid_inum(sb, le32_to_cpu(fc_inode.fc_ino)))
+				return -EINVAL;
+			if (!replay)
+				break;
+			ret = ext4_fc_replay_inode(sb,
+				le32_to_cpu(fc_inode.fc_ino),
+				(struct ext4_inode *)(pos + sizeof(tl) +
+						      sizeof(fc_inode)));
+			if (ret)
+				return ret;
+			break;
+		case EXT4_FC_TAG_TAIL:
+			if (len != sizeof(tail))
+				return -EINVAL;
+			memcpy(&tail, pos + sizeof(tl), sizeof(tail));
+			if (le32_to_cpu(tail.fc_tid) != tid)
+				return -EINVAL;
+			if (le32_to_cpu(tail.fc_crc) !=
+			    crc32_le(~0, start, pos + sizeof(tl) +
+				     offsetof(struct ext4_fc_tail, fc_crc) -
+				     start))
+				return -EINVAL;
+			return 0;
+		default:
+			return -EINVAL;
+		}
+		pos += sizeof(tl) + len;
+	}
+	return -EINVAL;
+}
+
+/*
+ * jbd2 recovery callback.  The scan pass finds how many blocks from the
+ * start of the area are valid fast commits of @expected_tid, the replay
+ * pass redoes exactly those.
+ */
+int ext4_fc_replay(journal_t *journal, struct buffer_head *bh,
+		   enum passtype pass, int off, tid_t expected_tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int ret;
+
+	if (pass == PASS_SCAN) {
+		if (!off)
+			sbi->s_fc_replay_blocks = 0;
+		if (ext4_fc_walk_block(sb, bh, off, expected_tid, false))
+			return 1;
+		sbi->s_fc_replay_blocks = off + 1;
+		return 0;
+	}
+
+	if (pass != PASS_REPLAY || off >= sbi->s_fc_replay_blocks)
+		return 1;
+
+	ret = ext4_fc_walk_block(sb, bh, off, expected_tid, true);
+	if (ret) {
+		ext4_msg(sb, KERN_ERR, "fast commit replay failed at block "
+			 "%d (%d)", off, ret);
+		return ret;
+	}
+	return 0;
+}
+
+/*
+ * Turn the journal feature on for the "fast_commit" mount option, if
+ * the filesystem can use it.  Failures just leave fast commits off.
+ */
+void ext4_fc_init(struct super_block *sb, journal_t *journal)
+{
+	if (!test_opt(sb, FAST_COMMIT))
+		return;
+
+	if (EXT4_HAS_RO_COMPAT_FEATURE(sb, EXT4_FEATURE_RO_COMPAT_BIGALLOC) ||
+	    test_opt(sb, DATA_FLAGS) == EXT4_MOUNT_JOURNAL_DATA ||
+	    ext4_fc_max_record_bytes(sb) > sb->s_blocksize) {
+		ext4_msg(sb, KERN_WARNING, "fast_commit not supported with "
+			 "bigalloc, data=journal or inodes this large");
+		goto disable;
+	}
+
+	if (!jbd2_journal_set_features(journal, 0, 0,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT)) {
+		ext4_msg(sb, KERN_WARNING,
+			 "could not set up the fast commit area");
+		goto disable;
+	}
+	return;
+
+disable:
+	clear_opt(sb, FAST_COMMIT);
+}
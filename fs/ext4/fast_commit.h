@@ -0,0 +1,47 @@
+/*
+ * fs/ext4/fast_commit.h
+ *
+ * On-disk format of the ext4 fast commit area
+ */
+
+#ifndef __FAST_COMMIT_H__
+#define __FAST_COMMIT_H__
+
+/*
+ * Each fast commit takes one block of the jbd2 fast commit area.  The
+ * block is a run of tag-length-value records ending with a tail:
+ *
+ *	[HEAD]		first block of the area only
+ *	INODE ...
+ *	TAIL		tid and crc32 of the block up to the crc
+ *
+ * All records belong to the running transaction whose tid they carry.
+ * Anything after the tail is unused.
+ */
+#define EXT4_FC_TAG_HEAD	0x0001
+#define EXT4_FC_TAG_INODE	0x0002
+#define EXT4_FC_TAG_TAIL	0x0003
+
+/* Record header, fc_len is the length of the value that follows */
+struct ext4_fc_tl {
+	__le16 fc_tag;
+	__le16 fc_len;
+};
+
+struct ext4_fc_head {
+	__le32 fc_features;
+	__le32 fc_tid;
+};
+
+/* Followed by the raw on-disk inode, EXT4_INODE_SIZE() bytes */
+struct ext4_fc_inode {
+	__le32 fc_ino;
+	__u8 fc_raw_inode[0];
+};
+
+struct ext4_fc_tail {
+	__le32 fc_tid;
+	__le32 fc_crc;
+};
+
+#endif /* __FAST_COMMIT_H__ */
@@ -194,8 +194,26 @@ out:
 #ifdef CONFIG_FS_DAX
 static int ext4_dax_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 {
-	return dax_fault(vma, vmf, ext4_get_block);
+	struct inode *inode = file_inode(vma->vm_file);
+	int result;
+
+	result = dax_fault(vma, vmf, ext4_get_block);
 					/* Is this the right get_block? */
+	if (result & VM_FAULT_NOPAGE)
+		percpu_counter_inc(&EXT4_SB(inode->i_sb)->s_dax_pte_faults);
+	return result;
+}
+
+static int ext4_dax_pmd_fault(struct vm_area_struct *vma, unsigned long addr,
+						pmd_t *pmd, unsigned int flags)
+{
+	struct inode *inode = file_inode(vma->vm_file);
+	int result;
+
+	result = dax_pmd_fault(vma, addr, pmd, flags, ext4_get_block);
+	if (result & VM_FAULT_NOPAGE)
+		percpu_counter_inc(&EXT4_SB(inode->i_sb)->s_dax_pmd_faults);
+	return result;
 }
 
 static int ext4_dax_mkwrite(struct vm_area_struct *vma, struct vm_fault *vmf)
@@ -205,6 +223,7 @@ static int ext4_dax_mkwrite(struct vm_area_struct *vma, struct vm_fault *vmf)
 
 static const struct vm_operations_struct ext4_dax_vm_ops = {
 	.fault		= ext4_dax_fault,
+	.pmd_fault	= ext4_dax_pmd_fault,
 	.page_mkwrite	= ext4_dax_mkwrite,
 	.pfn_mkwrite	= dax_pfn_mkwrite,
 };
@@ -230,7 +249,7 @@ static int ext4_file_mmap(struct file *file, struct vm_area_struct *vma)
 	file_accessed(file);
 	if (IS_DAX(file_inode(file))) {
 		vma->vm_ops = &ext4_dax_vm_ops;
-		vma->vm_flags |= VM_MIXEDMAP;
+		vma->vm_flags |= VM_MIXEDMAP | VM_HUGEPAGE;
 	} else {
 		vma->vm_ops = &ext4_file_vm_ops;
 	}
@@ -905,6 +905,7 @@ got:
 		ext4_lock_group(sb, group);
 		if (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) {
 			gdp->bg_flags &= cpu_to_le16(~EXT4_BG_BLOCK_UNINIT);
+			ext4_fc_mark_ineligible(sb, NULL, handle);
 			ext4_free_group_clusters_set(sb, gdp,
 				ext4_free_clusters_after_init(sb, group, gdp));
 			ext4_block_bitmap_csum_set(sb, group, gdp,
@@ -1032,6 +1033,8 @@ got:
 
 	ext4_clear_state_flags(ei); /* Only relevant on 32-bit archs */
 	ext4_set_inode_state(inode, EXT4_STATE_NEW);
+	/* replay can't allocate the inode or add its name */
+	ext4_fc_mark_ineligible(sb, inode, handle);
 
 	ei->i_extra_isize = EXT4_SB(sb)->s_want_extra_isize;
 #ifdef CONFIG_EXT4_FS_ENCRYPTION
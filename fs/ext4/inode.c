@@ -5255,6 +5255,11 @@ retry_alloc:
 		ret = VM_FAULT_SIGBUS;
 		goto out;
 	}
+	/*
+	 * Blocks get allocated here before the page is dirty and without
+	 * i_mutex, a fast commit could log them before their data.
+	 */
+	ext4_fc_mark_ineligible(inode->i_sb, inode, handle);
 	ret = __block_page_mkwrite(vma, vmf, get_block);
 	if (!ret && ext4_should_journal_data(inode)) {
 		if (ext4_walk_page_buffers(handle, page_buffers(page), 0,
@@ -703,18 +703,82 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int old = grp->bb_largest_free_order;
+	int new = -1; /* uninit */
 	int i;
-	int bits;
-
-	grp->bb_largest_free_order = -1; /* uninit */
 
-	bits = sb->s_blocksize_bits + 1;
-	for (i = bits; i >= 0; i--) {
+	for (i = MB_NUM_ORDERS(sb) - 1; i >= 0; i--) {
 		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+			new = i;
 			break;
 		}
 	}
+
+	/*
+	 * The group only moves between the order lists when its largest
+	 * extent changes order, which most allocations and frees don't do.
+	 */
+	if (new == old)
+		return;
+
+	if (old >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[old]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[old]);
+	}
+	grp->bb_largest_free_order = new;
+	if (new >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[new]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[new]);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[new]);
+	}
+}
+
+static int mb_avg_fragment_size_order(struct super_block *sb,
+				      ext4_grpblk_t len)
+{
+	int order;
+
+	order = fls(len) - 2;
+	if (order < 0)
+		return 0;
+	if (order >= MB_NUM_ORDERS(sb))
+		order = MB_NUM_ORDERS(sb) - 1;
+	return order;
+}
+
+/*
+ * Keep the group on the list matching the order of its average free
+ * fragment size. Must be called with the group locked, after bb_free
+ * and bb_fragments have been updated.
+ */
+static void
+mb_update_avg_fragment_size(struct super_block *sb, struct ext4_group_info *grp)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int old = grp->bb_avg_fragment_size_order;
+	int new = -1;
+
+	if (grp->bb_free && grp->bb_fragments)
+		new = mb_avg_fragment_size_order(sb,
+					grp->bb_free / grp->bb_fragments);
+	if (new == old)
+		return;
+
+	if (old >= 0) {
+		write_lock(&sbi->s_mb_avg_fragment_size_locks[old]);
+		list_del_init(&grp->bb_avg_fragment_size_node);
+		write_unlock(&sbi->s_mb_avg_fragment_size_locks[old]);
+	}
+	grp->bb_avg_fragment_size_order = new;
+	if (new >= 0) {
+		write_lock(&sbi->s_mb_avg_fragment_size_locks[new]);
+		list_add_tail(&grp->bb_avg_fragment_size_node,
+			      &sbi->s_mb_avg_fragment_size[new]);
+		write_unlock(&sbi->s_mb_avg_fragment_size_locks[new]);
+	}
 }
 
 static noinline_for_stack
@@ -766,6 +830,7 @@ void ext4_mb_generate_buddy(struct super_block *sb,
 		set_bit(EXT4_GROUP_INFO_BBITMAP_CORRUPT_BIT, &grp->bb_state);
 	}
 	mb_set_largest_free_order(sb, grp);
+	mb_update_avg_fragment_size(sb, grp);
 
 	clear_bit(EXT4_GROUP_INFO_NEED_INIT_BIT, &(grp->bb_state));
 
@@ -1484,6 +1549,7 @@ static void mb_free_blocks(struct inode *inode, struct ext4_buddy *e4b,
 
 done:
 	mb_set_largest_free_order(sb, e4b->bd_info);
+	mb_update_avg_fragment_size(sb, e4b->bd_info);
 	mb_check_buddy(e4b);
 }
 
@@ -1608,6 +1674,7 @@ static int mb_mark_used(struct ext4_buddy *e4b, struct ext4_free_extent *ex)
 		e4b->bd_info->bb_counters[ord]++;
 	}
 	mb_set_largest_free_order(e4b->bd_sb, e4b->bd_info);
+	mb_update_avg_fragment_size(e4b->bd_sb, e4b->bd_info);
 
 	ext4_set_bits(e4b->bd_bitmap, ex->fe_start, len0);
 	mb_check_buddy(e4b);
@@ -2073,11 +2140,144 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Check @group for a suitable extent under criteria @cr. Returns an
+ * error only if the buddy could not be loaded, the outcome of the scan
+ * is left in ac->ac_status.
+ */
+static int ext4_mb_scan_group(struct ext4_allocation_context *ac,
+			      ext4_group_t group, int cr)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_buddy e4b;
+	int err;
+
+	/* This now checks without needing the buddy page */
+	if (!ext4_mb_good_group(ac, group, cr))
+		return 0;
+
+	err = ext4_mb_load_buddy(sb, group, &e4b);
+	if (err)
+		return err;
+
+	ext4_lock_group(sb, group);
+
+	/*
+	 * We need to check again after locking the
+	 * block group
+	 */
+	if (!ext4_mb_good_group(ac, group, cr)) {
+		ext4_unlock_group(sb, group);
+		ext4_mb_unload_buddy(&e4b);
+		return 0;
+	}
+
+	ac->ac_groups_scanned++;
+	if (cr == 0 && ac->ac_2order < sb->s_blocksize_bits+2)
+		ext4_mb_simple_scan_group(ac, &e4b);
+	else if (cr == 1 && sbi->s_stripe &&
+			!(ac->ac_g_ex.fe_len % sbi->s_stripe))
+		ext4_mb_scan_aligned(ac, &e4b);
+	else
+		ext4_mb_complex_scan_group(ac, &e4b);
+
+	ext4_unlock_group(sb, group);
+	ext4_mb_unload_buddy(&e4b);
+	return 0;
+}
+
+/*
+ * Add @grp to the candidates if the cached summary says it can satisfy
+ * the request. Groups whose lock is held are only remembered in @busy,
+ * so that parallel allocators spread over the groups instead of queueing
+ * on the first one of a list. Called with the list lock held, so this
+ * must not sleep: groups are only on the lists once initialized.
+ */
+static void ext4_mb_add_candidate(struct ext4_allocation_context *ac,
+				  struct ext4_group_info *grp, int cr,
+				  ext4_group_t ngroups, ext4_group_t *groups,
+				  int *nr, ext4_group_t *busy)
+{
+	ext4_group_t group = grp->bb_group;
+
+	if (group >= ngroups || group == ac->ac_g_ex.fe_group ||
+	    EXT4_MB_GRP_NEED_INIT(grp) || !ext4_mb_good_group(ac, group, cr))
+		return;
+
+	if (spin_is_locked(ext4_group_lock_ptr(ac->ac_sb, group))) {
+		if (*busy == ngroups)
+			*busy = group;
+		return;
+	}
+	groups[(*nr)++] = group;
+}
+
+/*
+ * Collect up to MB_SCAN_BATCH groups for cr 0 from the largest free order
+ * lists, or for cr 1 from the average fragment size lists, starting at the
+ * order of the request. The goal group always comes first to keep the
+ * allocation close to the rest of the file.
+ */
+static int ext4_mb_find_candidates(struct ext4_allocation_context *ac, int cr,
+				   ext4_group_t ngroups, ext4_group_t *groups)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_info *grp;
+	ext4_group_t busy = ngroups;
+	int order, nr = 0;
+
+	if (ac->ac_g_ex.fe_group < ngroups &&
+	    ext4_mb_good_group(ac, ac->ac_g_ex.fe_group, cr))
+		groups[nr++] = ac->ac_g_ex.fe_group;
+
+	if (cr == 0) {
+		for (order = ac->ac_2order; order < MB_NUM_ORDERS(sb) &&
+					    nr < MB_SCAN_BATCH; order++) {
+			if (list_empty(&sbi->s_mb_largest_free_orders[order]))
+				continue;
+			read_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+			list_for_each_entry(grp,
+					&sbi->s_mb_largest_free_orders[order],
+					bb_largest_free_order_node) {
+				ext4_mb_add_candidate(ac, grp, cr, ngroups,
+						      groups, &nr, &busy);
+				if (nr == MB_SCAN_BATCH)
+					break;
+			}
+			read_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+		}
+	} else {
+		order = mb_avg_fragment_size_order(sb, ac->ac_g_ex.fe_len);
+		for (; order < MB_NUM_ORDERS(sb) && nr < MB_SCAN_BATCH;
+		     order++) {
+			if (list_empty(&sbi->s_mb_avg_fragment_size[order]))
+				continue;
+			read_lock(&sbi->s_mb_avg_fragment_size_locks[order]);
+			list_for_each_entry(grp,
+					&sbi->s_mb_avg_fragment_size[order],
+					bb_avg_fragment_size_node) {
+				ext4_mb_add_candidate(ac, grp, cr, ngroups,
+						      groups, &nr, &busy);
+				if (nr == MB_SCAN_BATCH)
+					break;
+			}
+			read_unlock(&sbi->s_mb_avg_fragment_size_locks[order]);
+		}
+	}
+
+	if (nr <= 1 && busy != ngroups)
+		groups[nr++] = busy;
+	return nr;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
+	ext4_group_t groups[MB_SCAN_BATCH];
 	ext4_group_t ngroups, group, i;
-	int cr;
+	int cr, nr;
 	int err = 0;
 	struct ext4_sb_info *sbi;
 	struct super_block *sb;
@@ -2138,11 +2338,34 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 repeat:
 	for (; cr < 4 && ac->ac_status == AC_STATUS_CONTINUE; cr++) {
 		ac->ac_criteria = cr;
+
+		/*
+		 * cr 0 and cr 1 only look at the groups the order lists
+		 * say can satisfy the request. Groups that were never
+		 * loaded are not on the lists, cr 2 walks over them.
+		 */
+		if (cr < 2 && sbi->s_mb_optimize_scan) {
+			nr = ext4_mb_find_candidates(ac, cr, ngroups, groups);
+			for (i = 0; i < nr; i++) {
+				cond_resched();
+				err = ext4_mb_scan_group(ac, groups[i], cr);
+				if (err)
+					goto out;
+				if (ac->ac_status != AC_STATUS_CONTINUE)
+					break;
+			}
+			continue;
+		}
+
 		/*
-		 * searching for the right group start
-		 * from the goal value specified
+		 * searching for the right group start from the goal
+		 * value specified, or from where this cpu last found
+		 * space once the cheap criteria failed
 		 */
 		group = ac->ac_g_ex.fe_group;
+		if (cr >= 2 && sbi->s_mb_optimize_scan &&
+		    !(ac->ac_flags & EXT4_MB_STREAM_ALLOC))
+			group = *raw_cpu_ptr(sbi->s_mb_cpu_group);
 
 		for (i = 0; i < ngroups; group++, i++) {
 			cond_resched();
@@ -2153,40 +2376,16 @@ repeat:
 			if (group >= ngroups)
 				group = 0;
 
-			/* This now checks without needing the buddy page */
-			if (!ext4_mb_good_group(ac, group, cr))
-				continue;
-
-			err = ext4_mb_load_buddy(sb, group, &e4b);
+			err = ext4_mb_scan_group(ac, group, cr);
 			if (err)
 				goto out;
 
-			ext4_lock_group(sb, group);
-
-			/*
-			 * We need to check again after locking the
-			 * block group
-			 */
-			if (!ext4_mb_good_group(ac, group, cr)) {
-				ext4_unlock_group(sb, group);
-				ext4_mb_unload_buddy(&e4b);
-				continue;
-			}
-
-			ac->ac_groups_scanned++;
-			if (cr == 0 && ac->ac_2order < sb->s_blocksize_bits+2)
-				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 && sbi->s_stripe &&
-					!(ac->ac_g_ex.fe_len % sbi->s_stripe))
-				ext4_mb_scan_aligned(ac, &e4b);
-			else
-				ext4_mb_complex_scan_group(ac, &e4b);
-
-			ext4_unlock_group(sb, group);
-			ext4_mb_unload_buddy(&e4b);
-
-			if (ac->ac_status != AC_STATUS_CONTINUE)
+			if (ac->ac_status != AC_STATUS_CONTINUE) {
+				if (sbi->s_mb_optimize_scan)
+					*raw_cpu_ptr(sbi->s_mb_cpu_group) =
+						group;
 				break;
+			}
 		}
 	}
 
@@ -2423,6 +2622,10 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_avg_fragment_size_order = -1;
+	meta_group_info[i]->bb_group = group;
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_avg_fragment_size_node);
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2572,6 +2775,40 @@ int ext4_mb_init(struct super_block *sb)
 		goto out;
 	}
 
+	sbi->s_mb_largest_free_orders =
+		kmalloc(MB_NUM_ORDERS(sb) * sizeof(struct list_head),
+			GFP_KERNEL);
+	sbi->s_mb_largest_free_orders_locks =
+		kmalloc(MB_NUM_ORDERS(sb) * sizeof(rwlock_t), GFP_KERNEL);
+	sbi->s_mb_avg_fragment_size =
+		kmalloc(MB_NUM_ORDERS(sb) * sizeof(struct list_head),
+			GFP_KERNEL);
+	sbi->s_mb_avg_fragment_size_locks =
+		kmalloc(MB_NUM_ORDERS(sb) * sizeof(rwlock_t), GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders ||
+	    !sbi->s_mb_largest_free_orders_locks ||
+	    !sbi->s_mb_avg_fragment_size ||
+	    !sbi->s_mb_avg_fragment_size_locks) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < MB_NUM_ORDERS(sb); i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		rwlock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+		INIT_LIST_HEAD(&sbi->s_mb_avg_fragment_size[i]);
+		rwlock_init(&sbi->s_mb_avg_fragment_size_locks[i]);
+	}
+
+	/* spread the cpus over the groups for the cr 2 and 3 scans */
+	sbi->s_mb_cpu_group = alloc_percpu(ext4_group_t);
+	if (sbi->s_mb_cpu_group == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for_each_possible_cpu(i)
+		*per_cpu_ptr(sbi->s_mb_cpu_group, i) = div_u64((u64)i *
+			ext4_get_groups_count(sb), nr_cpu_ids);
+
 	ret = ext4_groupinfo_create_slab(sb->s_blocksize);
 	if (ret < 0)
 		goto out;
@@ -2599,6 +2836,7 @@ int ext4_mb_init(struct super_block *sb)
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
+	sbi->s_mb_optimize_scan = MB_DEFAULT_OPTIMIZE_SCAN;
 	/*
 	 * The default group preallocation is 512, which for 4k block
 	 * sizes translates to 2 megabytes.  However for bigalloc file
@@ -2655,6 +2893,16 @@ out_free_locality_groups:
 	free_percpu(sbi->s_locality_groups);
 	sbi->s_locality_groups = NULL;
 out:
+	free_percpu(sbi->s_mb_cpu_group);
+	sbi->s_mb_cpu_group = NULL;
+	kfree(sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = NULL;
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = NULL;
+	kfree(sbi->s_mb_avg_fragment_size);
+	sbi->s_mb_avg_fragment_size = NULL;
+	kfree(sbi->s_mb_avg_fragment_size_locks);
+	sbi->s_mb_avg_fragment_size_locks = NULL;
 	kfree(sbi->s_mb_offsets);
 	sbi->s_mb_offsets = NULL;
 	kfree(sbi->s_mb_maxs);
@@ -2710,6 +2958,10 @@ int ext4_mb_release(struct super_block *sb)
 			kfree(sbi->s_group_info[i]);
 		kvfree(sbi->s_group_info);
 	}
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	kfree(sbi->s_mb_avg_fragment_size);
+	kfree(sbi->s_mb_avg_fragment_size_locks);
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
 	iput(sbi->s_buddy_cache);
@@ -2738,6 +2990,7 @@ int ext4_mb_release(struct super_block *sb)
 	}
 
 	free_percpu(sbi->s_locality_groups);
+	free_percpu(sbi->s_mb_cpu_group);
 
 	return 0;
 }
@@ -2940,6 +3193,8 @@ ext4_mb_mark_diskspace_used(struct ext4_allocation_context *ac,
 		ext4_free_group_clusters_set(sb, gdp,
 					     ext4_free_clusters_after_init(sb,
 						ac->ac_b_ex.fe_group, gdp));
+		/* fast commit replay only sets bits in initialised bitmaps */
+		ext4_fc_mark_ineligible(sb, NULL, handle);
 	}
 	len = ext4_free_group_clusters(sb, gdp) - ac->ac_b_ex.fe_len;
 	ext4_free_group_clusters_set(sb, gdp, len);
@@ -4656,6 +4911,7 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 	}
 
 	sbi = EXT4_SB(sb);
+	ext4_fc_mark_ineligible(sb, inode, handle);
 	if (!(flags & EXT4_FREE_BLOCKS_VALIDATED) &&
 	    !ext4_data_block_valid(sbi, block, count)) {
 		ext4_error(sb, "Freeing blocks not in datazone - "
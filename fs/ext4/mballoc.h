@@ -89,6 +89,22 @@ extern ushort ext4_mballoc_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * pick groups for cr 0 and cr 1 from the per-order lists instead of
+ * scanning them one after the other
+ */
+#define MB_DEFAULT_OPTIMIZE_SCAN	1
+
+/*
+ * number of orders in the largest free order and average fragment
+ * size lists
+ */
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
+/*
+ * how many groups cr 0 and cr 1 take from the order lists per pass
+ */
+#define MB_SCAN_BATCH			16
 
 struct ext4_free_data {
 	/* MUST be the first member */
@@ -2903,6 +2903,8 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 	if (!sbi->s_journal || is_bad_inode(inode))
 		return 0;
 
+	ext4_fc_mark_ineligible(sb, inode, handle);
+
 	WARN_ON_ONCE(!(inode->i_state & (I_NEW | I_FREEING)) &&
 		     !mutex_is_locked(&inode->i_mutex));
 	/*
@@ -3170,6 +3172,7 @@ static int ext4_unlink(struct inode *dir, struct dentry *dentry)
 	dir->i_ctime = dir->i_mtime = ext4_current_time(dir);
 	ext4_update_dx_flag(dir);
 	ext4_mark_inode_dirty(handle, dir);
+	ext4_fc_mark_ineligible(dir->i_sb, inode, handle);
 	drop_nlink(inode);
 	if (!inode->i_nlink)
 		ext4_orphan_add(handle, inode);
@@ -3361,6 +3364,7 @@ retry:
 
 	inode->i_ctime = ext4_current_time(inode);
 	ext4_inc_count(handle, inode);
+	ext4_fc_mark_ineligible(dir->i_sb, inode, handle);
 	ihold(inode);
 
 	err = ext4_add_entry(handle, dentry, inode);
@@ -3692,6 +3696,10 @@ static int ext4_rename(struct inode *old_dir, struct dentry *old_dentry,
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
 
+	ext4_fc_mark_ineligible(old.dir->i_sb, old.inode, handle);
+	if (new.inode)
+		ext4_fc_mark_ineligible(old.dir->i_sb, new.inode, handle);
+
 	if (S_ISDIR(old.inode->i_mode)) {
 		if (new.inode) {
 			retval = -ENOTEMPTY;
@@ -3860,6 +3868,9 @@ static int ext4_cross_rename(struct inode *old_dir, struct dentry *old_dentry,
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
 
+	ext4_fc_mark_ineligible(old.dir->i_sb, old.inode, handle);
+	ext4_fc_mark_ineligible(old.dir->i_sb, new.inode, handle);
+
 	if (S_ISDIR(old.inode->i_mode)) {
 		old.is_dir = true;
 		retval = ext4_rename_dir_prepare(handle, &old);
@@ -1443,6 +1443,7 @@ static int ext4_flex_group_add(struct super_block *sb,
 		err = PTR_ERR(handle);
 		goto exit;
 	}
+	ext4_fc_mark_ineligible(sb, NULL, handle);
 
 	BUFFER_TRACE(sbi->s_sbh, "get_write_access");
 	err = ext4_journal_get_write_access(handle, sbi->s_sbh);
@@ -1656,6 +1657,7 @@ static int ext4_group_extend_no_check(struct super_block *sb,
 		ext4_warning(sb, "error %d on journal start", err);
 		return err;
 	}
+	ext4_fc_mark_ineligible(sb, NULL, handle);
 
 	BUFFER_TRACE(EXT4_SB(sb)->s_sbh, "get_write_access");
 	err = ext4_journal_get_write_access(handle, EXT4_SB(sb)->s_sbh);
@@ -1816,6 +1818,7 @@ static int ext4_convert_meta_bg(struct super_block *sb, struct inode *inode)
 	handle = ext4_journal_start_sb(sb, EXT4_HT_RESIZE, credits);
 	if (IS_ERR(handle))
 		return PTR_ERR(handle);
+	ext4_fc_mark_ineligible(sb, NULL, handle);
 
 	BUFFER_TRACE(sbi->s_sbh, "get_write_access");
 	err = ext4_journal_get_write_access(handle, sbi->s_sbh);
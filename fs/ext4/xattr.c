@@ -1108,6 +1108,8 @@ ext4_xattr_set_handle(handle_t *handle, struct inode *inode, int name_index,
 	down_write(&EXT4_I(inode)->xattr_sem);
 	no_expand = ext4_test_inode_state(inode, EXT4_STATE_NO_EXPAND);
 	ext4_set_inode_state(inode, EXT4_STATE_NO_EXPAND);
+	/* xattr blocks are not in the fast commit record */
+	ext4_fc_mark_ineligible(inode->i_sb, inode, handle);
 
 	error = ext4_reserve_inode_write(handle, inode, &is.iloc);
 	if (error)
@@ -30,6 +30,7 @@ static struct kmem_cache *extent_node_slab;
 
 static void f2fs_read_end_io(struct bio *bio, int err)
 {
+	struct f2fs_sb_info *sbi = bio->bi_private;
 	struct bio_vec *bvec;
 	int i;
 
@@ -44,6 +45,7 @@ static void f2fs_read_end_io(struct bio *bio, int err)
 		}
 		unlock_page(page);
 	}
+	atomic_dec(&sbi->nr_read_bios);
 	bio_put(bio);
 }
 
@@ -98,9 +100,10 @@ static void __submit_merged_bio(struct f2fs_bio_info *io)
 	if (!io->bio)
 		return;
 
-	if (is_read_io(fio->rw))
+	if (is_read_io(fio->rw)) {
+		atomic_inc(&io->sbi->nr_read_bios);
 		trace_f2fs_submit_read_bio(io->sbi->sb, fio, io->bio);
-	else
+	} else
 		trace_f2fs_submit_write_bio(io->sbi->sb, fio, io->bio);
 
 	submit_bio(fio->rw, io->bio);
@@ -150,6 +153,8 @@ int f2fs_submit_page_bio(struct f2fs_sb_info *sbi, struct page *page,
 		return -EFAULT;
 	}
 
+	if (is_read_io(fio->rw))
+		atomic_inc(&sbi->nr_read_bios);
 	submit_bio(fio->rw, bio);
 	return 0;
 }
@@ -1345,6 +1350,7 @@ static int f2fs_read_data_page(struct file *file, struct page *page)
 	int ret = -EAGAIN;
 
 	trace_f2fs_readpage(page, DATA);
+	f2fs_update_time(F2FS_I_SB(inode));
 
 	/* If the file has inline data, try to read it directly */
 	if (f2fs_has_inline_data(inode))
@@ -1361,6 +1367,8 @@ static int f2fs_read_data_pages(struct file *file,
 {
 	struct inode *inode = file->f_mapping->host;
 
+	f2fs_update_time(F2FS_I_SB(inode));
+
 	/* If the file has inline data, skip readpages */
 	if (f2fs_has_inline_data(inode))
 		return 0;
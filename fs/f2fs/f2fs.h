@@ -321,6 +321,7 @@ struct extent_tree {
 #define FADVISE_LOST_PINO_BIT	0x02
 
 #define DEF_DIR_LEVEL		0
+#define DEF_IDLE_INTERVAL	5	/* seconds */
 
 struct f2fs_inode_info {
 	struct inode vfs_inode;		/* serve a vfs inode */
@@ -668,6 +669,9 @@ struct f2fs_sb_info {
 	block_t last_valid_block_count;		/* for recovery */
 	u32 s_next_generation;			/* for NFS support */
 	atomic_t nr_pages[NR_COUNT_TYPE];	/* # of pages, see count_type */
+	atomic_t nr_read_bios;			/* # of in-flight read bios */
+	unsigned long last_time;		/* jiffies of last user request */
+	unsigned int idle_interval;		/* idle time before bg gc (sec) */
 
 	struct f2fs_mount_info mount_opt;	/* mount options */
 
@@ -934,6 +938,16 @@ static inline void inc_page_count(struct f2fs_sb_info *sbi, int count_type)
 	set_sbi_flag(sbi, SBI_IS_DIRTY);
 }
 
+/* note a user request, for the idle test of the background gc */
+static inline void f2fs_update_time(struct f2fs_sb_info *sbi)
+{
+	unsigned long now = jiffies;
+
+	/* avoid dirtying the cacheline on every call */
+	if (READ_ONCE(sbi->last_time) != now)
+		WRITE_ONCE(sbi->last_time, now);
+}
+
 static inline void inode_inc_dirty_pages(struct inode *inode)
 {
 	atomic_inc(&F2FS_I(inode)->dirty_pages);
@@ -52,9 +52,11 @@ static int gc_thread_func(void *data)
 		 * [GC triggering condition]
 		 * 0. GC is not conducted currently.
 		 * 1. There are enough dirty segments.
-		 * 2. IO subsystem is idle by checking the # of writeback pages.
+		 * 2. IO subsystem is idle by checking the # of our in-flight
+		 *    reads and writeback pages.
 		 * 3. IO subsystem is idle by checking the # of requests in
 		 *    bdev's request list.
+		 * 4. No user request has come in for idle_interval seconds.
 		 *
 		 * Note) We have to avoid triggering GCs frequently.
 		 * Because it is possible that some segments can be
@@ -101,10 +101,24 @@ static inline bool has_enough_invalid_blocks(struct f2fs_sb_info *sbi)
 	return false;
 }
 
+/*
+ * The device counts as idle once none of our I/O is in flight, nobody
+ * else's is queued (as far as a request_fn queue can tell us; blk-mq
+ * keeps no such count) and no user request has come in for
+ * idle_interval seconds.
+ */
 static inline int is_idle(struct f2fs_sb_info *sbi)
 {
 	struct block_device *bdev = sbi->sb->s_bdev;
 	struct request_queue *q = bdev_get_queue(bdev);
 	struct request_list *rl = &q->root_rl;
-	return !(rl->count[BLK_RW_SYNC]) && !(rl->count[BLK_RW_ASYNC]);
+
+	if (get_pages(sbi, F2FS_WRITEBACK) || atomic_read(&sbi->nr_read_bios))
+		return 0;
+
+	if (!q->mq_ops && (rl->count[BLK_RW_SYNC] || rl->count[BLK_RW_ASYNC]))
+		return 0;
+
+	return time_after(jiffies, READ_ONCE(sbi->last_time) +
+					sbi->idle_interval * HZ);
 }
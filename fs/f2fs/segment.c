@@ -269,6 +269,8 @@ void commit_inmem_pages(struct inode *inode, bool abort)
  */
 void f2fs_balance_fs(struct f2fs_sb_info *sbi)
 {
+	f2fs_update_time(sbi);
+
 	/*
 	 * We should do GC or end up with checkpoint, if there are so many dirty
 	 * dir/node pages without enough free segments.
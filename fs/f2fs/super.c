@@ -206,6 +206,7 @@ F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, min_fsync_blocks, min_fsync_blocks);
 F2FS_RW_ATTR(NM_INFO, f2fs_nm_info, ram_thresh, ram_thresh);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, max_victim_search, max_victim_search);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, dir_level, dir_level);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, idle_interval, idle_interval);
 
 #define ATTR_LIST(name) (&f2fs_attr_##name.attr)
 static struct attribute *f2fs_attrs[] = {
@@ -221,6 +222,7 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(min_fsync_blocks),
 	ATTR_LIST(max_victim_search),
 	ATTR_LIST(dir_level),
+	ATTR_LIST(idle_interval),
 	ATTR_LIST(ram_thresh),
 	NULL,
 };
@@ -917,8 +919,11 @@ static void init_sb_info(struct f2fs_sb_info *sbi)
 
 	for (i = 0; i < NR_COUNT_TYPE; i++)
 		atomic_set(&sbi->nr_pages[i], 0);
+	atomic_set(&sbi->nr_read_bios, 0);
 
 	sbi->dir_level = DEF_DIR_LEVEL;
+	sbi->idle_interval = DEF_IDLE_INTERVAL;
+	sbi->last_time = jiffies;
 	clear_sbi_flag(sbi, SBI_NEED_FSCK);
 }
 
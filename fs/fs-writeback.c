@@ -1246,10 +1246,38 @@ static noinline void block_dump___mark_inode_dirty(struct inode *inode)
  * blockdev inode.
  */
 #define I_DIRTY_INODE (I_DIRTY_SYNC | I_DIRTY_DATASYNC)
+/*
+ * An inode goes on sb->s_inodes_sync when its pages are first dirtied.
+ * Pages can only get under writeback after being dirty, so that list has
+ * every inode sync may have to wait for.  wait_sb_inodes() takes inodes
+ * off again once they have neither dirty nor writeback pages.
+ */
+static void inode_sync_list_add(struct inode *inode)
+{
+	struct super_block *sb = inode->i_sb;
+
+	spin_lock(&sb->s_inodes_sync_lock);
+	spin_lock(&inode->i_lock);
+	if (list_empty(&inode->i_sync_list) && !(inode->i_state & I_FREEING))
+		list_add_tail(&inode->i_sync_list, &sb->s_inodes_sync);
+	spin_unlock(&inode->i_lock);
+	spin_unlock(&sb->s_inodes_sync_lock);
+}
+
+void inode_sync_list_del(struct inode *inode)
+{
+	struct super_block *sb = inode->i_sb;
+
+	spin_lock(&sb->s_inodes_sync_lock);
+	list_del_init(&inode->i_sync_list);
+	spin_unlock(&sb->s_inodes_sync_lock);
+}
+
 void __mark_inode_dirty(struct inode *inode, int flags)
 {
 	struct super_block *sb = inode->i_sb;
 	struct backing_dev_info *bdi = NULL;
+	bool track_sync = false;
 	int dirtytime;
 
 	trace_writeback_mark_inode_dirty(inode, flags);
@@ -1289,6 +1317,9 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 	if ((inode->i_state & flags) != flags) {
 		const int was_dirty = inode->i_state & I_DIRTY;
 
+		track_sync = (flags & I_DIRTY_PAGES) &&
+			     !(inode->i_state & I_DIRTY_PAGES) &&
+			     list_empty(&inode->i_sync_list);
 		if (flags & I_DIRTY_INODE)
 			inode->i_state &= ~I_DIRTY_TIME;
 		inode->i_state |= flags;
@@ -1349,18 +1380,20 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 
 			if (wakeup_bdi)
 				bdi_wakeup_thread_delayed(bdi);
-			return;
+			goto out;
 		}
 	}
 out_unlock_inode:
 	spin_unlock(&inode->i_lock);
-
+out:
+	if (track_sync)
+		inode_sync_list_add(inode);
 }
 EXPORT_SYMBOL(__mark_inode_dirty);
 
 static void wait_sb_inodes(struct super_block *sb)
 {
-	struct inode *inode, *old_inode = NULL;
+	LIST_HEAD(sync_list);
 
 	/*
 	 * We need to be protected against the filesystem going from
@@ -1368,7 +1401,9 @@ static void wait_sb_inodes(struct super_block *sb)
 	 */
 	WARN_ON(!rwsem_is_locked(&sb->s_umount));
 
-	spin_lock(&inode_sb_list_lock);
+	/* the inodes being waited on are off the list, one waiter at a time */
+	mutex_lock(&sb->s_sync_lock);
+	spin_lock(&sb->s_inodes_sync_lock);
 
 	/*
 	 * Data integrity sync. Must wait for all pages under writeback,
@@ -1376,39 +1411,45 @@ static void wait_sb_inodes(struct super_block *sb)
 	 * call, but which had writeout started before we write it out.
 	 * In which case, the inode may not be on the dirty list, but
 	 * we still have to wait for that writeout.
+	 *
+	 * Only inodes that had pages dirtied are on s_inodes_sync, so we
+	 * don't have to look at every cached inode.
 	 */
-	list_for_each_entry(inode, &sb->s_inodes, i_sb_list) {
+	list_splice_init(&sb->s_inodes_sync, &sync_list);
+	while (!list_empty(&sync_list)) {
+		struct inode *inode = list_first_entry(&sync_list, struct inode,
+						       i_sync_list);
 		struct address_space *mapping = inode->i_mapping;
 
+		list_move_tail(&inode->i_sync_list, &sb->s_inodes_sync);
+
 		spin_lock(&inode->i_lock);
-		if ((inode->i_state & (I_FREEING|I_WILL_FREE|I_NEW)) ||
-		    (mapping->nrpages == 0)) {
+		if (inode->i_state & (I_FREEING|I_WILL_FREE|I_NEW)) {
+			spin_unlock(&inode->i_lock);
+			continue;
+		}
+		if (!mapping_tagged(mapping, PAGECACHE_TAG_WRITEBACK)) {
+			/* nothing to wait for, and clean: forget about it */
+			if (!(inode->i_state & I_DIRTY_PAGES) &&
+			    !mapping_tagged(mapping, PAGECACHE_TAG_DIRTY))
+				list_del_init(&inode->i_sync_list);
 			spin_unlock(&inode->i_lock);
 			continue;
 		}
 		__iget(inode);
 		spin_unlock(&inode->i_lock);
-		spin_unlock(&inode_sb_list_lock);
-
-		/*
-		 * We hold a reference to 'inode' so it couldn't have been
-		 * removed from s_inodes list while we dropped the
-		 * inode_sb_list_lock.  We cannot iput the inode now as we can
-		 * be holding the last reference and we cannot iput it under
-		 * inode_sb_list_lock. So we keep the reference and iput it
-		 * later.
-		 */
-		iput(old_inode);
-		old_inode = inode;
+		spin_unlock(&sb->s_inodes_sync_lock);
 
 		filemap_fdatawait(mapping);
 
 		cond_resched();
 
-		spin_lock(&inode_sb_list_lock);
+		iput(inode);
+
+		spin_lock(&sb->s_inodes_sync_lock);
 	}
-	spin_unlock(&inode_sb_list_lock);
-	iput(old_inode);
+	spin_unlock(&sb->s_inodes_sync_lock);
+	mutex_unlock(&sb->s_sync_lock);
 }
 
 /**
@@ -25,7 +25,7 @@ MODULE_ALIAS("devname:fuse");
 
 static struct kmem_cache *fuse_req_cachep;
 
-static struct fuse_conn *fuse_get_conn(struct file *file)
+static struct fuse_dev *fuse_get_dev(struct file *file)
 {
 	/*
 	 * Lockless access is OK, because file->private data is set
@@ -34,6 +34,13 @@ static struct fuse_conn *fuse_get_conn(struct file *file)
 	return file->private_data;
 }
 
+static struct fuse_conn *fuse_get_conn(struct file *file)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+
+	return fud ? fud->fc : NULL;
+}
+
 static void fuse_request_init(struct fuse_req *req, struct page **pages,
 			      struct fuse_page_desc *page_descs,
 			      unsigned npages)
@@ -319,17 +326,38 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
+static inline unsigned int fuse_req_hash(u64 unique)
+{
+	/* unique IDs are handed out sequentially */
+	return unique & (FUSE_PQ_HASH_SIZE - 1);
+}
+
+/*
+ * Requests go to the device bound to the issuing CPU if there is one,
+ * so they are read by a daemon thread running on the same CPU.
+ * Everything else is shared by all devices of the connection.
+ */
 static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
+	struct fuse_dev *fud = NULL;
+
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
+	if (fc->cpu_devs)
+		fud = fc->cpu_devs[raw_smp_processor_id()];
+	if (fud)
+		list_add_tail(&req->list, &fud->pending);
+	else
+		list_add_tail(&req->list, &fc->pending);
 	req->state = FUSE_REQ_PENDING;
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
+	if (fud)
+		wake_up(&fud->waitq);
+	else
+		wake_up(&fc->waitq);
 	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 }
 
@@ -1070,21 +1098,40 @@ static int forget_pending(struct fuse_conn *fc)
 	return fc->forget_list_head.next != NULL;
 }
 
-static int request_pending(struct fuse_conn *fc)
+/* Pending list the next request for @fud comes from, if any */
+static struct list_head *fuse_dev_pending(struct fuse_dev *fud)
 {
-	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts) ||
+	if (!list_empty(&fud->pending))
+		return &fud->pending;
+	if (!list_empty(&fud->fc->pending))
+		return &fud->fc->pending;
+	return NULL;
+}
+
+static int request_pending(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+
+	return fuse_dev_pending(fud) || !list_empty(&fc->interrupts) ||
 		forget_pending(fc);
 }
 
-/* Wait until a request is available on the pending list */
-static void request_wait(struct fuse_conn *fc)
-__releases(fc->lock)
-__acquires(fc->lock)
+/*
+ * Wait until a request is available on the pending list.  A device
+ * bound to a CPU waits for its own requests as well as shared ones.
+ */
+static void request_wait(struct fuse_dev *fud)
+__releases(fud->fc->lock)
+__acquires(fud->fc->lock)
 {
+	struct fuse_conn *fc = fud->fc;
 	DECLARE_WAITQUEUE(wait, current);
+	DECLARE_WAITQUEUE(cpu_wait, current);
 
 	add_wait_queue_exclusive(&fc->waitq, &wait);
-	while (fc->connected && !request_pending(fc)) {
+	if (fud->cpu >= 0)
+		add_wait_queue_exclusive(&fud->waitq, &cpu_wait);
+	while (fc->connected && !request_pending(fud)) {
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (signal_pending(current))
 			break;
@@ -1094,6 +1141,8 @@ __acquires(fc->lock)
 		spin_lock(&fc->lock);
 	}
 	set_current_state(TASK_RUNNING);
+	if (fud->cpu >= 0)
+		remove_wait_queue(&fud->waitq, &cpu_wait);
 	remove_wait_queue(&fc->waitq, &wait);
 }
 
@@ -1262,6 +1311,8 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
 	int err;
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct list_head *pending;
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
@@ -1270,15 +1321,15 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	spin_lock(&fc->lock);
 	err = -EAGAIN;
 	if ((file->f_flags & O_NONBLOCK) && fc->connected &&
-	    !request_pending(fc))
+	    !request_pending(fud))
 		goto err_unlock;
 
-	request_wait(fc);
+	request_wait(fud);
 	err = -ENODEV;
 	if (!fc->connected)
 		goto err_unlock;
 	err = -ERESTARTSYS;
-	if (!request_pending(fc))
+	if (!request_pending(fud))
 		goto err_unlock;
 
 	if (!list_empty(&fc->interrupts)) {
@@ -1287,15 +1338,16 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		return fuse_read_interrupt(fc, cs, nbytes, req);
 	}
 
+	pending = fuse_dev_pending(fud);
 	if (forget_pending(fc)) {
-		if (list_empty(&fc->pending) || fc->forget_batch-- > 0)
+		if (!pending || fc->forget_batch-- > 0)
 			return fuse_read_forget(fc, cs, nbytes);
 
 		if (fc->forget_batch <= -8)
 			fc->forget_batch = 16;
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
+	req = list_entry(pending->next, struct fuse_req, list);
 	req->state = FUSE_REQ_READING;
 	list_move(&req->list, &fc->io);
 
@@ -1332,7 +1384,8 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		request_end(fc, req);
 	else {
 		req->state = FUSE_REQ_SENT;
-		list_move_tail(&req->list, &fc->processing);
+		list_move_tail(&req->list,
+			       &fc->processing[fuse_req_hash(in->h.unique)]);
 		if (req->interrupted)
 			queue_interrupt(fc, req);
 		spin_unlock(&fc->lock);
@@ -1348,7 +1401,7 @@ static int fuse_dev_open(struct inode *inode, struct file *file)
 {
 	/*
 	 * The fuse device's file's private_data is used to hold
-	 * the fuse_conn(ection) when it is mounted, and is used to
+	 * the fuse_dev when it is mounted or cloned, and is used to
 	 * keep track of whether the file has been mounted already.
 	 */
 	file->private_data = NULL;
@@ -1833,11 +1886,23 @@ static int fuse_notify(struct fuse_conn *fc, enum fuse_notify_code code,
 static struct fuse_req *request_find(struct fuse_conn *fc, u64 unique)
 {
 	struct fuse_req *req;
+	int i;
 
-	list_for_each_entry(req, &fc->processing, list) {
-		if (req->in.h.unique == unique || req->intr_unique == unique)
+	list_for_each_entry(req, &fc->processing[fuse_req_hash(unique)], list) {
+		if (req->in.h.unique == unique)
 			return req;
 	}
+
+	/*
+	 * An interrupt reply carries the unique ID of the interrupt, not
+	 * that of the request it was hashed by.  These are rare.
+	 */
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++) {
+		list_for_each_entry(req, &fc->processing[i], list) {
+			if (req->intr_unique == unique)
+				return req;
+		}
+	}
 	return NULL;
 }
 
@@ -2061,16 +2126,20 @@ out:
 static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_conn *fc;
+	if (!fud)
 		return POLLERR;
 
+	fc = fud->fc;
 	poll_wait(file, &fc->waitq, wait);
+	if (fud->cpu >= 0)
+		poll_wait(file, &fud->waitq, wait);
 
 	spin_lock(&fc->lock);
 	if (!fc->connected)
 		mask = POLLERR;
-	else if (request_pending(fc))
+	else if (request_pending(fud))
 		mask |= POLLIN | POLLRDNORM;
 	spin_unlock(&fc->lock);
 
@@ -2136,10 +2205,16 @@ static void end_queued_requests(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
+	struct fuse_dev *fud;
+	int i;
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
+	list_for_each_entry(fud, &fc->devices, entry)
+		list_splice_tail_init(&fud->pending, &fc->pending);
 	end_requests(fc, &fc->pending);
-	end_requests(fc, &fc->processing);
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++)
+		end_requests(fc, &fc->processing[i]);
 	while (forget_pending(fc))
 		kfree(dequeue_forget(fc, 1, NULL));
 }
@@ -2196,25 +2271,156 @@ void fuse_abort_conn(struct fuse_conn *fc)
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+/*
+ * Stop queueing requests for the CPU @fud serves, and hand the ones
+ * still waiting on it to the other devices.  Called with fc->lock held.
+ */
+static void fuse_dev_unbind(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+
+	if (fud->cpu < 0)
+		return;
+
+	fc->cpu_devs[fud->cpu] = NULL;
+	fud->cpu = -1;
+	if (!list_empty(&fud->pending)) {
+		list_splice_tail_init(&fud->pending, &fc->pending);
+		wake_up(&fc->waitq);
+	}
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (fc) {
+	struct fuse_dev *fud = fuse_get_dev(file);
+	if (fud) {
+		struct fuse_conn *fc = fud->fc;
+
 		spin_lock(&fc->lock);
-		fc->connected = 0;
-		fc->blocked = 0;
-		fuse_set_initialized(fc);
-		end_queued_requests(fc);
-		end_polls(fc);
-		wake_up_all(&fc->blocked_waitq);
+		fuse_dev_unbind(fud);
+		/* the connection goes away with its last device */
+		if (list_is_singular(&fc->devices)) {
+			fc->connected = 0;
+			fc->blocked = 0;
+			fuse_set_initialized(fc);
+			end_queued_requests(fc);
+			end_polls(fc);
+			wake_up_all(&fc->blocked_waitq);
+		}
 		spin_unlock(&fc->lock);
-		fuse_conn_put(fc);
+		fuse_dev_free(fud);
 	}
 
 	return 0;
 }
 EXPORT_SYMBOL_GPL(fuse_dev_release);
 
+/*
+ * A clone made by a thread that is pinned to a single CPU serves the
+ * requests issued on that CPU, unless another device already does.
+ */
+static void fuse_dev_bind(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_dev **cpu_devs = NULL;
+	int cpu;
+
+	if (cpumask_weight(tsk_cpus_allowed(current)) != 1)
+		return;
+	cpu = cpumask_first(tsk_cpus_allowed(current));
+
+	if (!ACCESS_ONCE(fc->cpu_devs))
+		cpu_devs = kcalloc(nr_cpu_ids, sizeof(*cpu_devs), GFP_KERNEL);
+
+	spin_lock(&fc->lock);
+	if (!fc->cpu_devs) {
+		fc->cpu_devs = cpu_devs;
+		cpu_devs = NULL;
+	}
+	if (fc->cpu_devs && !fc->cpu_devs[cpu]) {
+		fc->cpu_devs[cpu] = fud;
+		fud->cpu = cpu;
+	}
+	spin_unlock(&fc->lock);
+	kfree(cpu_devs);
+}
+
+static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
+{
+	struct fuse_dev *fud;
+
+	if (new->private_data)
+		return -EINVAL;
+
+	fud = fuse_dev_alloc(fc);
+	if (!fud)
+		return -ENOMEM;
+
+	fuse_dev_bind(fud);
+	new->private_data = fud;
+
+	return 0;
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	int err = -ENOTTY;
+
+	if (cmd == FUSE_DEV_IOC_BACKING_OPEN ||
+	    cmd == FUSE_DEV_IOC_BACKING_CLOSE) {
+		struct fuse_conn *fc = fuse_get_conn(file);
+		struct fuse_backing_map map;
+		__u32 backing_id;
+
+		if (!fc)
+			return -EPERM;
+		if (!fc->passthrough)
+			return -EOPNOTSUPP;
+
+		if (cmd == FUSE_DEV_IOC_BACKING_OPEN) {
+			if (copy_from_user(&map, (void __user *) arg,
+					   sizeof(map)))
+				return -EFAULT;
+			return fuse_backing_open(fc, &map);
+		}
+
+		if (get_user(backing_id, (__u32 __user *) arg))
+			return -EFAULT;
+		return fuse_backing_close(fc, backing_id);
+	}
+
+	if (cmd == FUSE_DEV_IOC_CLONE) {
+		int oldfd;
+
+		err = -EFAULT;
+		if (!get_user(oldfd, (__u32 __user *) arg)) {
+			struct file *old = fget(oldfd);
+
+			err = -EINVAL;
+			if (old) {
+				struct fuse_conn *fc = NULL;
+
+				/*
+				 * Check against file->f_op because CUSE
+				 * uses the same ioctl handler.
+				 */
+				if (old->f_op == file->f_op &&
+				    old->f_cred->user_ns == file->f_cred->user_ns)
+					fc = fuse_get_conn(old);
+
+				if (fc) {
+					mutex_lock(&fuse_mutex);
+					err = fuse_device_clone(fc, file);
+					mutex_unlock(&fuse_mutex);
+				}
+				fput(old);
+			}
+		}
+	}
+	return err;
+}
+
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
 	struct fuse_conn *fc = fuse_get_conn(file);
@@ -2236,6 +2442,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl = fuse_dev_ioctl,
+	.compat_ioctl   = fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
@@ -22,6 +22,7 @@
 #include <linux/rbtree.h>
 #include <linux/poll.h>
 #include <linux/workqueue.h>
+#include <linux/idr.h>
 
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
@@ -155,6 +156,9 @@ struct fuse_file {
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
 
+	/** Backing file for passthrough I/O, or NULL */
+	struct file *passthrough;
+
 	/** Has flock been performed on this file? */
 	bool flock:1;
 };
@@ -380,6 +384,34 @@ struct fuse_req {
 	struct file *stolen_file;
 };
 
+/** Size of the hash the processing requests are kept in */
+#define FUSE_PQ_HASH_BITS 8
+#define FUSE_PQ_HASH_SIZE (1 << FUSE_PQ_HASH_BITS)
+
+/**
+ * An open /dev/fuse file serving a connection
+ *
+ * This is the file passed at mount time, or one attached to the same
+ * connection with FUSE_DEV_IOC_CLONE.  A clone made by a thread pinned
+ * to a single CPU serves the requests issued on that CPU.
+ */
+struct fuse_dev {
+	/** Fuse connection for this device */
+	struct fuse_conn *fc;
+
+	/** list entry on fc->devices */
+	struct list_head entry;
+
+	/** CPU whose requests are queued here, or -1 */
+	int cpu;
+
+	/** Requests issued on @cpu waiting to be read from this device */
+	struct list_head pending;
+
+	/** Readers of this device are waiting on this */
+	wait_queue_head_t waitq;
+};
+
 /**
  * A Fuse connection.
  *
@@ -417,8 +449,17 @@ struct fuse_conn {
 	/** The list of pending requests */
 	struct list_head pending;
 
-	/** The list of requests being processed */
-	struct list_head processing;
+	/** Devices attached to this connection */
+	struct list_head devices;
+
+	/** Device bound to each CPU, allocated on the first binding */
+	struct fuse_dev **cpu_devs;
+
+	/** The requests being processed, hashed by unique ID */
+	struct list_head processing[FUSE_PQ_HASH_SIZE];
+
+	/** Backing files registered for passthrough, by backing_id */
+	struct idr backing_files;
 
 	/** The list of requests under I/O */
 	struct list_head io;
@@ -499,6 +540,9 @@ struct fuse_conn {
 	/** write-back cache policy (default is write-through) */
 	unsigned writeback_cache:1;
 
+	/** Can file I/O be passed through to a backing file? */
+	unsigned passthrough:1;
+
 	/*
 	 * The following bitfields are only for optimization purposes
 	 * and hence races in setting them will not cause malfunction
@@ -826,6 +870,12 @@ void fuse_conn_init(struct fuse_conn *fc);
  */
 void fuse_conn_put(struct fuse_conn *fc);
 
+/**
+ * Allocate a device attached to @fc, and free it again
+ */
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc);
+void fuse_dev_free(struct fuse_dev *fud);
+
 /**
  * Add connection to control filesystem
  */
@@ -909,4 +959,14 @@ int fuse_do_setattr(struct inode *inode, struct iattr *attr,
 
 void fuse_set_initialized(struct fuse_conn *fc);
 
+/* passthrough.c */
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map);
+int fuse_backing_close(struct fuse_conn *fc, int backing_id);
+void fuse_backing_files_free(struct fuse_conn *fc);
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct fuse_open_out *openarg);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,186 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough of file I/O to a backing file.
+ *
+ * The daemon registers an open file with FUSE_DEV_IOC_BACKING_OPEN and
+ * gets back a backing_id.  Replying to OPEN with FOPEN_PASSTHROUGH and
+ * that backing_id makes read, write and mmap on the fuse file go
+ * straight to the backing file, without a round trip to the daemon.
+ * Everything else, including metadata and permission checks at open
+ * time, is still handled by the daemon.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/uio.h>
+
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map)
+{
+	struct file *file;
+	int id;
+
+	/* the backing file is accessed with the credentials of the opener */
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (map->flags || map->padding)
+		return -EINVAL;
+
+	file = fget(map->fd);
+	if (!file)
+		return -EBADF;
+
+	id = -EINVAL;
+	if (!file->f_op->read_iter || !file->f_op->write_iter)
+		goto out_fput;
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->lock);
+	id = idr_alloc_cyclic(&fc->backing_files, file, 1, 0, GFP_ATOMIC);
+	spin_unlock(&fc->lock);
+	idr_preload_end();
+	if (id < 0)
+		goto out_fput;
+
+	return id;
+
+out_fput:
+	fput(file);
+	return id;
+}
+
+int fuse_backing_close(struct fuse_conn *fc, int backing_id)
+{
+	struct file *file;
+
+	if (backing_id <= 0)
+		return -EINVAL;
+
+	spin_lock(&fc->lock);
+	file = idr_find(&fc->backing_files, backing_id);
+	if (file)
+		idr_remove(&fc->backing_files, backing_id);
+	spin_unlock(&fc->lock);
+
+	if (!file)
+		return -ENOENT;
+
+	/* files opened with this backing_id keep their own reference */
+	fput(file);
+	return 0;
+}
+
+static int fuse_backing_put(int id, void *p, void *data)
+{
+	fput(p);
+	return 0;
+}
+
+void fuse_backing_files_free(struct fuse_conn *fc)
+{
+	idr_for_each(&fc->backing_files, fuse_backing_put, NULL);
+	idr_destroy(&fc->backing_files);
+}
+
+/*
+ * Called on a successful OPEN reply.  An unknown backing_id is not an
+ * error: the file is then simply opened without passthrough.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct fuse_open_out *openarg)
+{
+	struct file *file = NULL;
+
+	if (!(ff->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	ff->open_flags &= ~FOPEN_PASSTHROUGH;
+	if (!fc->passthrough || openarg->backing_id <= 0)
+		return;
+
+	spin_lock(&fc->lock);
+	file = idr_find(&fc->backing_files, openarg->backing_id);
+	if (file)
+		get_file(file);
+	spin_unlock(&fc->lock);
+
+	if (file) {
+		ff->passthrough = file;
+		/* the backing file does the caching */
+		ff->open_flags &= ~FOPEN_DIRECT_IO;
+		ff->open_flags |= FOPEN_PASSTHROUGH;
+	}
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	ssize_t ret;
+
+	ret = vfs_iter_read(ff->passthrough, to, &iocb->ki_pos);
+	if (ret >= 0)
+		file_accessed(file);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct fuse_file *ff = file->private_data;
+	loff_t pos;
+	ssize_t ret;
+
+	mutex_lock(&inode->i_mutex);
+	if (file->f_flags & O_APPEND)
+		iocb->ki_pos = i_size_read(file_inode(ff->passthrough));
+
+	pos = iocb->ki_pos;
+	ret = vfs_iter_write(ff->passthrough, from, &iocb->ki_pos);
+	if (ret > 0) {
+		/*
+		 * Drop cached pages of the range, so that opens without
+		 * passthrough do not read stale data.
+		 */
+		invalidate_inode_pages2_range(inode->i_mapping,
+				pos >> PAGE_CACHE_SHIFT,
+				(iocb->ki_pos - 1) >> PAGE_CACHE_SHIFT);
+		fuse_write_update_size(inode, iocb->ki_pos);
+		fuse_invalidate_attr(inode);
+	}
+	mutex_unlock(&inode->i_mutex);
+
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough;
+	int ret;
+
+	if (!backing->f_op->mmap)
+		return -ENODEV;
+
+	/* the mapping is set up by, and then belongs to, the backing file */
+	vma->vm_file = get_file(backing);
+	ret = backing->f_op->mmap(backing, vma);
+	if (ret) {
+		vma->vm_file = file;
+		fput(backing);
+	} else {
+		fput(file);
+	}
+	file_accessed(file);
+
+	return ret;
+}
@@ -28,24 +28,29 @@
  *   inode->i_state, inode->i_hash, __iget()
  * Inode LRU list locks protect:
  *   inode->i_sb->s_inode_lru, inode->i_lru
- * inode_sb_list_lock protects:
- *   sb->s_inodes, inode->i_sb_list
+ * sb->s_inode_lists[cpu].lock protects:
+ *   that list, inode->i_sb_list of the inodes on it
  * bdi->wb.list_lock protects:
  *   bdi->wb.b_{dirty,io,more_io,dirty_time}, inode->i_wb_list
+ * sb->s_inodes_sync_lock protects:
+ *   sb->s_inodes_sync, inode->i_sync_list
  * inode_hash_lock protects:
  *   inode_hashtable, inode->i_hash
  *
  * Lock ordering:
  *
- * inode_sb_list_lock
+ * sb->s_inode_lists[cpu].lock
  *   inode->i_lock
  *     Inode LRU list locks
  *
  * bdi->wb.list_lock
  *   inode->i_lock
  *
+ * sb->s_inodes_sync_lock
+ *   inode->i_lock
+ *
  * inode_hash_lock
- *   inode_sb_list_lock
+ *   sb->s_inode_lists[cpu].lock
  *   inode->i_lock
  *
  * iunique_lock
@@ -57,8 +62,6 @@ static unsigned int i_hash_shift __read_mostly;
 static struct hlist_head *inode_hashtable __read_mostly;
 static __cacheline_aligned_in_smp DEFINE_SPINLOCK(inode_hash_lock);
 
-__cacheline_aligned_in_smp DEFINE_SPINLOCK(inode_sb_list_lock);
-
 /*
  * Empty aops. Can be used for the cases where the user does not
  * define any of the address_space operations.
@@ -162,6 +165,9 @@ int inode_init_always(struct super_block *sb, struct inode *inode)
 
 	mutex_init(&inode->i_mutex);
 	lockdep_set_class(&inode->i_mutex, &sb->s_type->i_mutex_key);
+	init_rwsem(&inode->i_lookup_rwsem);
+	lockdep_set_class(&inode->i_lookup_rwsem,
+			  &sb->s_type->i_lookup_rwsem_key);
 
 	atomic_set(&inode->i_dio_count, 0);
 
@@ -358,6 +364,7 @@ void inode_init_once(struct inode *inode)
 	INIT_HLIST_NODE(&inode->i_hash);
 	INIT_LIST_HEAD(&inode->i_devices);
 	INIT_LIST_HEAD(&inode->i_wb_list);
+	INIT_LIST_HEAD(&inode->i_sync_list);
 	INIT_LIST_HEAD(&inode->i_lru);
 	address_space_init_once(&inode->i_data);
 	i_size_ordered_init(inode);
@@ -424,21 +431,38 @@ static void inode_lru_list_del(struct inode *inode)
  */
 void inode_sb_list_add(struct inode *inode)
 {
-	spin_lock(&inode_sb_list_lock);
-	list_add(&inode->i_sb_list, &inode->i_sb->s_inodes);
-	spin_unlock(&inode_sb_list_lock);
+	struct sb_inode_list *ilist = raw_cpu_ptr(inode->i_sb->s_inode_lists);
+
+	spin_lock(&ilist->lock);
+	list_add(&inode->i_sb_list, &ilist->head);
+	inode->i_sb_list_head = ilist;
+	spin_unlock(&ilist->lock);
 }
 EXPORT_SYMBOL_GPL(inode_sb_list_add);
 
 static inline void inode_sb_list_del(struct inode *inode)
 {
+	struct sb_inode_list *ilist = inode->i_sb_list_head;
+
 	if (!list_empty(&inode->i_sb_list)) {
-		spin_lock(&inode_sb_list_lock);
+		spin_lock(&ilist->lock);
 		list_del_init(&inode->i_sb_list);
-		spin_unlock(&inode_sb_list_lock);
+		spin_unlock(&ilist->lock);
 	}
 }
 
+bool sb_has_inodes(struct super_block *sb)
+{
+	struct sb_inode_list *ilist;
+	int cpu;
+
+	for_each_sb_inode_list(sb, cpu, ilist) {
+		if (!list_empty(&ilist->head))
+			return true;
+	}
+	return false;
+}
+
 static unsigned long hash(struct super_block *sb, unsigned long hashval)
 {
 	unsigned long tmp;
@@ -527,6 +551,8 @@ static void evict(struct inode *inode)
 
 	if (!list_empty(&inode->i_wb_list))
 		inode_wb_list_del(inode);
+	if (!list_empty(&inode->i_sync_list))
+		inode_sync_list_del(inode);
 
 	inode_sb_list_del(inode);
 
@@ -590,25 +616,29 @@ static void dispose_list(struct list_head *head)
 void evict_inodes(struct super_block *sb)
 {
 	struct inode *inode, *next;
+	struct sb_inode_list *ilist;
 	LIST_HEAD(dispose);
+	int cpu;
 
-	spin_lock(&inode_sb_list_lock);
-	list_for_each_entry_safe(inode, next, &sb->s_inodes, i_sb_list) {
-		if (atomic_read(&inode->i_count))
-			continue;
+	for_each_sb_inode_list(sb, cpu, ilist) {
+		spin_lock(&ilist->lock);
+		list_for_each_entry_safe(inode, next, &ilist->head, i_sb_list) {
+			if (atomic_read(&inode->i_count))
+				continue;
 
-		spin_lock(&inode->i_lock);
-		if (inode->i_state & (I_NEW | I_FREEING | I_WILL_FREE)) {
+			spin_lock(&inode->i_lock);
+			if (inode->i_state & (I_NEW | I_FREEING | I_WILL_FREE)) {
+				spin_unlock(&inode->i_lock);
+				continue;
+			}
+
+			inode->i_state |= I_FREEING;
+			inode_lru_list_del(inode);
 			spin_unlock(&inode->i_lock);
-			continue;
+			list_add(&inode->i_lru, &dispose);
 		}
-
-		inode->i_state |= I_FREEING;
-		inode_lru_list_del(inode);
-		spin_unlock(&inode->i_lock);
-		list_add(&inode->i_lru, &dispose);
+		spin_unlock(&ilist->lock);
 	}
-	spin_unlock(&inode_sb_list_lock);
 
 	dispose_list(&dispose);
 }
@@ -627,32 +657,36 @@ int invalidate_inodes(struct super_block *sb, bool kill_dirty)
 {
 	int busy = 0;
 	struct inode *inode, *next;
+	struct sb_inode_list *ilist;
 	LIST_HEAD(dispose);
+	int cpu;
 
-	spin_lock(&inode_sb_list_lock);
-	list_for_each_entry_safe(inode, next, &sb->s_inodes, i_sb_list) {
-		spin_lock(&inode->i_lock);
-		if (inode->i_state & (I_NEW | I_FREEING | I_WILL_FREE)) {
-			spin_unlock(&inode->i_lock);
-			continue;
-		}
-		if (inode->i_state & I_DIRTY_ALL && !kill_dirty) {
-			spin_unlock(&inode->i_lock);
-			busy = 1;
-			continue;
-		}
-		if (atomic_read(&inode->i_count)) {
+	for_each_sb_inode_list(sb, cpu, ilist) {
+		spin_lock(&ilist->lock);
+		list_for_each_entry_safe(inode, next, &ilist->head, i_sb_list) {
+			spin_lock(&inode->i_lock);
+			if (inode->i_state & (I_NEW | I_FREEING | I_WILL_FREE)) {
+				spin_unlock(&inode->i_lock);
+				continue;
+			}
+			if (inode->i_state & I_DIRTY_ALL && !kill_dirty) {
+				spin_unlock(&inode->i_lock);
+				busy = 1;
+				continue;
+			}
+			if (atomic_read(&inode->i_count)) {
+				spin_unlock(&inode->i_lock);
+				busy = 1;
+				continue;
+			}
+
+			inode->i_state |= I_FREEING;
+			inode_lru_list_del(inode);
 			spin_unlock(&inode->i_lock);
-			busy = 1;
-			continue;
+			list_add(&inode->i_lru, &dispose);
 		}
-
-		inode->i_state |= I_FREEING;
-		inode_lru_list_del(inode);
-		spin_unlock(&inode->i_lock);
-		list_add(&inode->i_lru, &dispose);
+		spin_unlock(&ilist->lock);
 	}
-	spin_unlock(&inode_sb_list_lock);
 
 	dispose_list(&dispose);
 
@@ -850,7 +884,7 @@ EXPORT_SYMBOL(get_next_ino);
  *	@sb: superblock
  *
  *	Allocates a new inode for given superblock.
- *	Inode wont be chained in superblock s_inodes list
+ *	Inode wont be chained in the superblock inode lists
  *	This means :
  *	- fs can't be unmount
  *	- quotas, fsnotify, writeback can't work
@@ -884,8 +918,6 @@ struct inode *new_inode(struct super_block *sb)
 {
 	struct inode *inode;
 
-	spin_lock_prefetch(&inode_sb_list_lock);
-
 	inode = new_inode_pseudo(sb);
 	if (inode)
 		inode_sb_list_add(inode);
@@ -15,6 +15,8 @@ struct linux_binprm;
 struct path;
 struct mount;
 struct shrink_control;
+struct kstat;
+struct statx;
 
 /*
  * block_dev.c
@@ -35,6 +37,18 @@ static inline int __sync_blockdev(struct block_device *bdev, int wait)
 }
 #endif
 
+/*
+ * direct-io.c
+ */
+#ifdef CONFIG_BLOCK
+#define DIO_INLINE_BIO_VECS	4
+
+extern bool dio_read_simple_ok(struct kiocb *iocb, struct iov_iter *iter,
+			       loff_t offset, unsigned blkbits, loff_t i_size);
+extern ssize_t dio_read_simple(struct block_device *bdev, sector_t sector,
+			       struct iov_iter *iter);
+#endif
+
 /*
  * buffer.c
  */
@@ -111,7 +125,16 @@ extern int open_check_o_direct(struct file *f);
 /*
  * inode.c
  */
-extern spinlock_t inode_sb_list_lock;
+extern bool sb_has_inodes(struct super_block *sb);
+
+/*
+ * Walk the per-cpu inode lists of a superblock, the walker takes
+ * ilist->lock itself.
+ */
+#define for_each_sb_inode_list(sb, cpu, ilist)				\
+	for ((cpu) = -1;						\
+	     ((cpu) = cpumask_next((cpu), cpu_possible_mask)) < nr_cpu_ids && \
+	     ((ilist) = per_cpu_ptr((sb)->s_inode_lists, (cpu)));)
 extern long prune_icache_sb(struct super_block *sb, struct shrink_control *sc);
 extern void inode_add_lru(struct inode *inode);
 
@@ -119,6 +142,7 @@ extern void inode_add_lru(struct inode *inode);
  * fs-writeback.c
  */
 extern void inode_wb_list_del(struct inode *inode);
+extern void inode_sync_list_del(struct inode *inode);
 
 extern long get_nr_dirty_inodes(void);
 extern void evict_inodes(struct super_block *);
@@ -130,6 +154,7 @@ extern int invalidate_inodes(struct super_block *, bool);
 extern struct dentry *__d_alloc(struct super_block *, const struct qstr *);
 extern int d_set_mounted(struct dentry *dentry);
 extern long prune_dcache_sb(struct super_block *sb, struct shrink_control *sc);
+extern void prune_dcache_negative_work(struct work_struct *work);
 
 /*
  * read_write.c
@@ -141,6 +166,11 @@ extern int rw_verify_area(int, struct file *, const loff_t *, size_t);
  */
 extern const struct file_operations pipefifo_fops;
 
+/*
+ * stat.c
+ */
+extern void kstat_to_statx(const struct kstat *stat, struct statx *tmp);
+
 /*
  * fs_pin.c
  */
@@ -0,0 +1,978 @@
+/*
+ * Shared application/kernel submission and completion ring pairs, for
+ * supporting fast/efficient IO.
+ *
+ * A note on the read/write ordering memory barriers that are matched between
+ * the application and kernel side. When the application reads the CQ ring
+ * tail, it must use an appropriate smp_rmb() to order with the smp_wmb()
+ * the kernel uses after writing the tail. Failure to do so could cause a
+ * delay in when the application notices that completion events available.
+ * This isn't a fatal condition. Likewise, the application must use an
+ * appropriate smp_wmb() both before writing the SQ tail, and after writing
+ * the SQ tail. The first one orders the sqe writes with the tail write, and
+ * the latter is paired with the smp_rmb() the kernel will issue before
+ * reading the SQ tail on submission.
+ *
+ * Unlike fs/aio.c, requests are never copied in through a syscall: the
+ * application fills in sqes in memory it shares with the kernel and bumps
+ * the SQ tail. With IORING_SETUP_SQPOLL a kernel thread picks them up, so
+ * neither submission nor reaping needs a syscall while that thread is busy.
+ *
+ * O_DIRECT reads and writes are issued inline and complete through
+ * ->ki_complete, exactly like fs/aio.c does. Everything else (buffered
+ * files, sockets, fsync) would block the submitter, so it is punted to a
+ * per-ring unbound workqueue that runs on behalf of the submitting mm.
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/errno.h>
+#include <linux/syscalls.h>
+#include <linux/compat.h>
+#include <linux/uio.h>
+
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/fdtable.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/mmu_context.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/kthread.h>
+#include <linux/blkdev.h>
+#include <linux/anon_inodes.h>
+#include <linux/percpu-refcount.h>
+#include <linux/poll.h>
+#include <linux/cred.h>
+
+#include <asm/uaccess.h>
+
+#include <linux/io_uring.h>
+
+#include "internal.h"
+
+#define IORING_MAX_ENTRIES	4096
+
+struct io_uring {
+	u32 head ____cacheline_aligned_in_smp;
+	u32 tail ____cacheline_aligned_in_smp;
+};
+
+struct io_sq_ring {
+	struct io_uring		r;
+	u32			ring_mask;
+	u32			ring_entries;
+	u32			dropped;
+	u32			flags;
+	u32			array[];
+};
+
+struct io_cq_ring {
+	struct io_uring		r;
+	u32			ring_mask;
+	u32			ring_entries;
+	u32			overflow;
+	struct io_uring_cqe	cqes[];
+};
+
+struct io_ring_ctx {
+	struct percpu_ref	refs;
+	unsigned int		flags;
+
+	/* SQ ring */
+	struct io_sq_ring	*sq_ring;
+	unsigned		cached_sq_head;
+	unsigned		sq_entries;
+	unsigned		sq_mask;
+	unsigned long		sq_thread_idle;
+	struct io_uring_sqe	*sq_sqes;
+
+	/* IO offload */
+	struct workqueue_struct	*sqo_wq;
+	struct task_struct	*sqo_thread;	/* if using sq thread polling */
+	struct mm_struct	*sqo_mm;
+	wait_queue_head_t	sqo_wait;
+	const struct cred	*creds;
+	bool			compat;
+
+	/* CQ ring */
+	struct io_cq_ring	*cq_ring;
+	unsigned		cached_cq_tail;
+	unsigned		cq_entries;
+	unsigned		cq_mask;
+	wait_queue_head_t	cq_wait;
+	spinlock_t		completion_lock;
+
+	struct completion	ctx_done;
+
+	/* serializes submitters against each other and against teardown */
+	struct mutex		uring_lock;
+};
+
+struct io_kiocb {
+	struct kiocb		rw;
+	struct io_ring_ctx	*ctx;
+	u64			user_data;
+	struct work_struct	work;
+	struct io_uring_sqe	sqe;	/* private copy, the ring slot is reused */
+};
+
+typedef ssize_t (rw_iter_op)(struct kiocb *, struct iov_iter *);
+
+static struct kmem_cache *req_cachep;
+
+static const struct file_operations io_uring_fops;
+
+static void io_ring_ctx_ref_free(struct percpu_ref *ref)
+{
+	struct io_ring_ctx *ctx = container_of(ref, struct io_ring_ctx, refs);
+
+	complete(&ctx->ctx_done);
+}
+
+static struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
+{
+	struct io_ring_ctx *ctx;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return NULL;
+
+	if (percpu_ref_init(&ctx->refs, io_ring_ctx_ref_free, 0, GFP_KERNEL)) {
+		kfree(ctx);
+		return NULL;
+	}
+
+	ctx->flags = p->flags;
+	init_waitqueue_head(&ctx->sqo_wait);
+	init_waitqueue_head(&ctx->cq_wait);
+	init_completion(&ctx->ctx_done);
+	mutex_init(&ctx->uring_lock);
+	spin_lock_init(&ctx->completion_lock);
+	return ctx;
+}
+
+static unsigned io_cqring_events(struct io_cq_ring *ring)
+{
+	return READ_ONCE(ring->r.tail) - READ_ONCE(ring->r.head);
+}
+
+/*
+ * Post a completion event. Callable from any context, including the
+ * ->ki_complete() callback run from IRQ context for direct IO.
+ */
+static void io_cqring_add_event(struct io_ring_ctx *ctx, u64 user_data,
+				long res)
+{
+	struct io_cq_ring *ring = ctx->cq_ring;
+	struct io_uring_cqe *cqe;
+	unsigned long flags;
+	unsigned tail;
+
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+
+	/*
+	 * Note: the application must read the head before writing the
+	 * cqe it consumed, we only ever read it here.
+	 */
+	tail = ctx->cached_cq_tail;
+	if (tail - READ_ONCE(ring->r.head) == ring->ring_entries) {
+		WRITE_ONCE(ring->overflow, ring->overflow + 1);
+	} else {
+		cqe = &ring->cqes[tail & ctx->cq_mask];
+		WRITE_ONCE(cqe->user_data, user_data);
+		WRITE_ONCE(cqe->res, res);
+		WRITE_ONCE(cqe->flags, 0);
+		ctx->cached_cq_tail++;
+
+		/* order cqe stores with ring update */
+		smp_wmb();
+		WRITE_ONCE(ring->r.tail, ctx->cached_cq_tail);
+	}
+
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+
+	if (waitqueue_active(&ctx->cq_wait))
+		wake_up(&ctx->cq_wait);
+}
+
+static struct io_kiocb *io_get_req(struct io_ring_ctx *ctx)
+{
+	struct io_kiocb *req;
+
+	if (!percpu_ref_tryget(&ctx->refs))
+		return NULL;
+
+	req = kmem_cache_alloc(req_cachep, GFP_KERNEL);
+	if (!req) {
+		percpu_ref_put(&ctx->refs);
+		return NULL;
+	}
+
+	req->ctx = ctx;
+	req->rw.ki_filp = NULL;
+	return req;
+}
+
+static void io_free_req(struct io_kiocb *req)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+
+	if (req->rw.ki_filp)
+		fput(req->rw.ki_filp);
+	kmem_cache_free(req_cachep, req);
+	percpu_ref_put(&ctx->refs);
+}
+
+static void io_complete_req(struct io_kiocb *req, long res)
+{
+	/*
+	 * There's no easy way to restart the syscall since other IO may
+	 * already be running. Just fail this IO with EINTR, like aio does.
+	 */
+	if (unlikely(res == -ERESTARTSYS || res == -ERESTARTNOINTR ||
+		     res == -ERESTARTNOHAND || res == -ERESTART_RESTARTBLOCK))
+		res = -EINTR;
+
+	io_cqring_add_event(req->ctx, req->user_data, res);
+	io_free_req(req);
+}
+
+static void io_complete_rw(struct kiocb *kiocb, long res, long res2)
+{
+	struct io_kiocb *req = container_of(kiocb, struct io_kiocb, rw);
+
+	io_complete_req(req, res);
+}
+
+static int io_import_iovec(struct io_ring_ctx *ctx, int rw,
+			   const struct io_uring_sqe *sqe,
+			   struct iovec **iovec, struct iov_iter *iter)
+{
+	void __user *buf = (void __user *) (unsigned long) sqe->addr;
+
+#ifdef CONFIG_COMPAT
+	if (ctx->compat)
+		return compat_import_iovec(rw, buf, sqe->len, UIO_FASTIOV,
+					   iovec, iter);
+#endif
+	return import_iovec(rw, buf, sqe->len, UIO_FASTIOV, iovec, iter);
+}
+
+static ssize_t io_issue_rw(struct io_kiocb *req, int rw)
+{
+	struct kiocb *kiocb = &req->rw;
+	struct file *file = kiocb->ki_filp;
+	struct iovec inline_vecs[UIO_FASTIOV], *iovec = inline_vecs;
+	struct iov_iter iter;
+	rw_iter_op *iter_op;
+	fmode_t mode;
+	ssize_t ret;
+
+	if (rw == READ) {
+		mode	= FMODE_READ;
+		iter_op	= file->f_op->read_iter;
+	} else {
+		mode	= FMODE_WRITE;
+		iter_op	= file->f_op->write_iter;
+	}
+
+	if (unlikely(!(file->f_mode & mode)))
+		return -EBADF;
+	if (!iter_op)
+		return -EINVAL;
+
+	ret = io_import_iovec(req->ctx, rw, &req->sqe, &iovec, &iter);
+	if (ret)
+		return ret;
+
+	ret = rw_verify_area(rw, file, &kiocb->ki_pos, iov_iter_count(&iter));
+	if (ret >= 0) {
+		if (rw == WRITE)
+			file_start_write(file);
+		ret = iter_op(kiocb, &iter);
+		if (rw == WRITE)
+			file_end_write(file);
+	}
+	kfree(iovec);
+	return ret;
+}
+
+static int io_fsync(struct io_kiocb *req)
+{
+	const struct io_uring_sqe *sqe = &req->sqe;
+	loff_t end = sqe->off + sqe->len;
+
+	if (unlikely(sqe->fsync_flags & ~IORING_FSYNC_DATASYNC))
+		return -EINVAL;
+	if (unlikely(sqe->addr))
+		return -EINVAL;
+
+	return vfs_fsync_range(req->rw.ki_filp, sqe->off,
+			       end > 0 ? end : LLONG_MAX,
+			       sqe->fsync_flags & IORING_FSYNC_DATASYNC);
+}
+
+/*
+ * Runs from the ring workqueue, on behalf of the task that set up the
+ * ring. Everything here is allowed to block.
+ */
+static void io_sq_wq_submit_work(struct work_struct *work)
+{
+	struct io_kiocb *req = container_of(work, struct io_kiocb, work);
+	struct io_ring_ctx *ctx = req->ctx;
+	struct mm_struct *mm = ctx->sqo_mm;
+	const struct cred *old_cred;
+	mm_segment_t old_fs;
+	long ret;
+
+	old_cred = override_creds(ctx->creds);
+
+	/* the submitter may have exited, don't resurrect its mm */
+	if (!atomic_inc_not_zero(&mm->mm_users)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	use_mm(mm);
+	old_fs = get_fs();
+	set_fs(USER_DS);
+
+	switch (req->sqe.opcode) {
+	case IORING_OP_READV:
+		ret = io_issue_rw(req, READ);
+		break;
+	case IORING_OP_WRITEV:
+		ret = io_issue_rw(req, WRITE);
+		break;
+	case IORING_OP_FSYNC:
+		ret = io_fsync(req);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	set_fs(old_fs);
+	unuse_mm(mm);
+	mmput(mm);
+out:
+	revert_creds(old_cred);
+	io_complete_req(req, ret);
+}
+
+static int io_submit_sqe(struct io_ring_ctx *ctx,
+			 const struct io_uring_sqe *sqe)
+{
+	struct io_kiocb *req;
+	struct file *file;
+	int rw;
+
+	req = io_get_req(ctx);
+	if (unlikely(!req))
+		return -EAGAIN;
+
+	memcpy(&req->sqe, sqe, sizeof(req->sqe));
+	req->user_data = req->sqe.user_data;
+
+	if (unlikely(req->sqe.flags || req->sqe.ioprio))
+		goto err_inval;
+
+	switch (req->sqe.opcode) {
+	case IORING_OP_NOP:
+		io_complete_req(req, 0);
+		return 0;
+	case IORING_OP_READV:
+	case IORING_OP_WRITEV:
+	case IORING_OP_FSYNC:
+		break;
+	default:
+		goto err_inval;
+	}
+
+	file = fget(req->sqe.fd);
+	if (unlikely(!file)) {
+		io_free_req(req);
+		return -EBADF;
+	}
+
+	req->rw.ki_filp = file;
+	req->rw.ki_pos = req->sqe.off;
+	req->rw.ki_flags = iocb_flags(file);
+	req->rw.ki_complete = NULL;
+
+	/*
+	 * Direct IO never blocks for the data transfer itself, issue it
+	 * inline and let the completion come back through ->ki_complete.
+	 */
+	if (req->sqe.opcode != IORING_OP_FSYNC &&
+	    (req->rw.ki_flags & IOCB_DIRECT)) {
+		ssize_t ret;
+
+		rw = req->sqe.opcode == IORING_OP_READV ? READ : WRITE;
+		req->rw.ki_complete = io_complete_rw;
+		ret = io_issue_rw(req, rw);
+		if (ret != -EIOCBQUEUED)
+			io_complete_rw(&req->rw, ret, 0);
+		return 0;
+	}
+
+	INIT_WORK(&req->work, io_sq_wq_submit_work);
+	queue_work(ctx->sqo_wq, &req->work);
+	return 0;
+
+err_inval:
+	io_free_req(req);
+	return -EINVAL;
+}
+
+static void io_commit_sqring(struct io_ring_ctx *ctx)
+{
+	struct io_sq_ring *ring = ctx->sq_ring;
+
+	if (ctx->cached_sq_head != READ_ONCE(ring->r.head)) {
+		/*
+		 * Ensure any loads from the SQEs are done at this point,
+		 * since once we write the new head, the application could
+		 * write new data to them.
+		 */
+		smp_store_release(&ring->r.head, ctx->cached_sq_head);
+	}
+}
+
+/*
+ * Fetch an sqe, if one is available. Note that sqe_ptr will point to memory
+ * that is mapped by userspace. This means that care needs to be taken to
+ * ensure that reads are stable, as we cannot rely on userspace always
+ * being a good citizen. That's why io_submit_sqe() copies it first.
+ */
+static const struct io_uring_sqe *io_get_sqring(struct io_ring_ctx *ctx)
+{
+	struct io_sq_ring *ring = ctx->sq_ring;
+	unsigned head;
+
+	head = ctx->cached_sq_head;
+	/* make sure SQ entry isn't read before tail */
+	if (head == smp_load_acquire(&ring->r.tail))
+		return NULL;
+
+	while (head != READ_ONCE(ring->r.tail)) {
+		unsigned idx = READ_ONCE(ring->array[head & ctx->sq_mask]);
+
+		ctx->cached_sq_head = ++head;
+		if (likely(idx < ctx->sq_entries))
+			return &ctx->sq_sqes[idx];
+
+		/* drop invalid entries */
+		WRITE_ONCE(ring->dropped, ring->dropped + 1);
+	}
+
+	return NULL;
+}
+
+/*
+ * Consume up to @to_submit sqes. A request that fails before it could be
+ * queued still counts as submitted and gets its error posted to the CQ
+ * ring, so the application always finds out through user_data.
+ */
+static int io_ring_submit(struct io_ring_ctx *ctx, unsigned int to_submit)
+{
+	const struct io_uring_sqe *sqe;
+	int submitted = 0;
+
+	while (submitted < to_submit) {
+		int ret;
+
+		sqe = io_get_sqring(ctx);
+		if (!sqe)
+			break;
+
+		ret = io_submit_sqe(ctx, sqe);
+		if (ret == -EAGAIN && !submitted) {
+			/* out of memory, let the application retry */
+			ctx->cached_sq_head--;
+			io_commit_sqring(ctx);
+			return ret;
+		}
+		if (ret)
+			io_cqring_add_event(ctx, READ_ONCE(sqe->user_data), ret);
+		submitted++;
+	}
+
+	io_commit_sqring(ctx);
+	return submitted;
+}
+
+static bool io_sq_has_work(struct io_ring_ctx *ctx)
+{
+	return ctx->cached_sq_head != READ_ONCE(ctx->sq_ring->r.tail);
+}
+
+static int io_sq_thread(void *data)
+{
+	struct io_ring_ctx *ctx = data;
+	struct mm_struct *cur_mm = NULL;
+	const struct cred *old_cred;
+	mm_segment_t old_fs;
+	unsigned long timeout;
+	DEFINE_WAIT(wait);
+
+	old_fs = get_fs();
+	set_fs(USER_DS);
+	old_cred = override_creds(ctx->creds);
+
+	timeout = jiffies + ctx->sq_thread_idle;
+	while (!kthread_should_stop()) {
+		if (!io_sq_has_work(ctx)) {
+			/*
+			 * Keep spinning while we're inside the idle window,
+			 * this is what lets submission skip the syscall.
+			 */
+			if (time_before(jiffies, timeout)) {
+				cond_resched();
+				continue;
+			}
+
+			/* drop the mm while sleeping, it may go away */
+			if (cur_mm) {
+				unuse_mm(cur_mm);
+				mmput(cur_mm);
+				cur_mm = NULL;
+			}
+
+			prepare_to_wait(&ctx->sqo_wait, &wait,
+					TASK_INTERRUPTIBLE);
+
+			/* tell userspace we may need a wakeup call */
+			ctx->sq_ring->flags |= IORING_SQ_NEED_WAKEUP;
+			smp_mb();
+
+			if (!io_sq_has_work(ctx) && !kthread_should_stop())
+				schedule();
+			finish_wait(&ctx->sqo_wait, &wait);
+
+			ctx->sq_ring->flags &= ~IORING_SQ_NEED_WAKEUP;
+			timeout = jiffies + ctx->sq_thread_idle;
+			continue;
+		}
+
+		if (!cur_mm) {
+			if (!atomic_inc_not_zero(&ctx->sqo_mm->mm_users)) {
+				/* owner is gone, wait to be stopped */
+				set_current_state(TASK_INTERRUPTIBLE);
+				if (!kthread_should_stop())
+					schedule();
+				__set_current_state(TASK_RUNNING);
+				continue;
+			}
+			use_mm(ctx->sqo_mm);
+			cur_mm = ctx->sqo_mm;
+		}
+
+		mutex_lock(&ctx->uring_lock);
+		io_ring_submit(ctx, ctx->sq_entries);
+		mutex_unlock(&ctx->uring_lock);
+
+		timeout = jiffies + ctx->sq_thread_idle;
+	}
+
+	if (cur_mm) {
+		unuse_mm(cur_mm);
+		mmput(cur_mm);
+	}
+	revert_creds(old_cred);
+	set_fs(old_fs);
+
+	return 0;
+}
+
+static int io_cqring_wait(struct io_ring_ctx *ctx, unsigned min_events,
+			  const sigset_t __user *sig, size_t sigsz)
+{
+	struct io_cq_ring *ring = ctx->cq_ring;
+	sigset_t ksigmask, sigsaved;
+	int ret = 0;
+
+	if (io_cqring_events(ring) >= min_events)
+		return 0;
+
+	if (sig) {
+		if (sigsz != sizeof(sigset_t))
+			return -EINVAL;
+		if (copy_from_user(&ksigmask, sig, sizeof(ksigmask)))
+			return -EFAULT;
+		sigsaved = current->blocked;
+		set_current_blocked(&ksigmask);
+	}
+
+	ret = wait_event_interruptible(ctx->cq_wait,
+				io_cqring_events(ring) >= min_events);
+	if (ret == -ERESTARTSYS)
+		ret = -EINTR;
+
+	/*
+	 * As in epoll_pwait(), leave the signal mask alone on -EINTR so the
+	 * signal gets delivered on the way out, it's restored afterwards.
+	 */
+	if (sig) {
+		if (ret == -EINTR) {
+			memcpy(&current->saved_sigmask, &sigsaved,
+			       sizeof(sigsaved));
+			set_restore_sigmask();
+		} else
+			set_current_blocked(&sigsaved);
+	}
+
+	return ret;
+}
+
+static void *io_mem_alloc(size_t size)
+{
+	gfp_t gfp_flags = GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN | __GFP_COMP;
+
+	return (void *) __get_free_pages(gfp_flags, get_order(size));
+}
+
+static void io_mem_free(void *ptr)
+{
+	struct page *page;
+
+	if (!ptr)
+		return;
+
+	page = virt_to_head_page(ptr);
+	__free_pages(page, compound_order(page));
+}
+
+static void io_ring_ctx_free(struct io_ring_ctx *ctx)
+{
+	if (ctx->sqo_wq)
+		destroy_workqueue(ctx->sqo_wq);
+	if (ctx->sqo_mm)
+		mmdrop(ctx->sqo_mm);
+	if (ctx->creds)
+		put_cred(ctx->creds);
+
+	io_mem_free(ctx->sq_ring);
+	io_mem_free(ctx->sq_sqes);
+	io_mem_free(ctx->cq_ring);
+
+	percpu_ref_exit(&ctx->refs);
+	kfree(ctx);
+}
+
+static void io_ring_ctx_wait_and_kill(struct io_ring_ctx *ctx)
+{
+	if (ctx->sqo_thread) {
+		kthread_stop(ctx->sqo_thread);
+		ctx->sqo_thread = NULL;
+	}
+
+	mutex_lock(&ctx->uring_lock);
+	percpu_ref_kill(&ctx->refs);
+	mutex_unlock(&ctx->uring_lock);
+
+	/* wait for all in-flight requests to post their completions */
+	wait_for_completion(&ctx->ctx_done);
+	io_ring_ctx_free(ctx);
+}
+
+static int io_uring_release(struct inode *inode, struct file *file)
+{
+	struct io_ring_ctx *ctx = file->private_data;
+
+	file->private_data = NULL;
+	io_ring_ctx_wait_and_kill(ctx);
+	return 0;
+}
+
+static unsigned int io_uring_poll(struct file *file, poll_table *wait)
+{
+	struct io_ring_ctx *ctx = file->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(file, &ctx->cq_wait, wait);
+	/* See comment at the top of this file */
+	smp_rmb();
+	if (READ_ONCE(ctx->sq_ring->r.tail) - ctx->cached_sq_head !=
+	    ctx->sq_ring->ring_entries)
+		mask |= POLLOUT | POLLWRNORM;
+	if (READ_ONCE(ctx->cq_ring->r.head) != ctx->cached_cq_tail)
+		mask |= POLLIN | POLLRDNORM;
+
+	return mask;
+}
+
+static int io_uring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	loff_t offset = (loff_t) vma->vm_pgoff << PAGE_SHIFT;
+	unsigned long sz = vma->vm_end - vma->vm_start;
+	struct io_ring_ctx *ctx = file->private_data;
+	unsigned long pfn;
+	struct page *page;
+	void *ptr;
+
+	switch (offset) {
+	case IORING_OFF_SQ_RING:
+		ptr = ctx->sq_ring;
+		break;
+	case IORING_OFF_SQES:
+		ptr = ctx->sq_sqes;
+		break;
+	case IORING_OFF_CQ_RING:
+		ptr = ctx->cq_ring;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	page = virt_to_head_page(ptr);
+	if (sz > (PAGE_SIZE << compound_order(page)))
+		return -EINVAL;
+
+	pfn = virt_to_phys(ptr) >> PAGE_SHIFT;
+	return remap_pfn_range(vma, vma->vm_start, pfn, sz, vma->vm_page_prot);
+}
+
+SYSCALL_DEFINE6(io_uring_enter, unsigned int, fd, u32, to_submit,
+		u32, min_complete, u32, flags, const sigset_t __user *, sig,
+		size_t, sigsz)
+{
+	struct io_ring_ctx *ctx;
+	long ret = -EBADF;
+	int submitted = 0;
+	struct fd f;
+
+	if (flags & ~(IORING_ENTER_GETEVENTS | IORING_ENTER_SQ_WAKEUP))
+		return -EINVAL;
+
+	f = fdget(fd);
+	if (!f.file)
+		return -EBADF;
+
+	ret = -EOPNOTSUPP;
+	if (f.file->f_op != &io_uring_fops)
+		goto out_fput;
+
+	ret = -ENXIO;
+	ctx = f.file->private_data;
+	if (!percpu_ref_tryget(&ctx->refs))
+		goto out_fput;
+
+	/*
+	 * For SQ polling, the thread will do all submissions and completions.
+	 * Just return the requested submit count, and wake the thread if
+	 * we were asked to.
+	 */
+	if (ctx->flags & IORING_SETUP_SQPOLL) {
+		if (flags & IORING_ENTER_SQ_WAKEUP)
+			wake_up(&ctx->sqo_wait);
+		submitted = to_submit;
+		goto out_ctx;
+	}
+
+	ret = 0;
+	if (to_submit) {
+		to_submit = min(to_submit, ctx->sq_entries);
+
+		mutex_lock(&ctx->uring_lock);
+		submitted = io_ring_submit(ctx, to_submit);
+		mutex_unlock(&ctx->uring_lock);
+
+		if (submitted < 0) {
+			ret = submitted;
+			goto out_ctx;
+		}
+	}
+	if (flags & IORING_ENTER_GETEVENTS) {
+		min_complete = min(min_complete, ctx->cq_entries);
+		ret = io_cqring_wait(ctx, min_complete, sig, sigsz);
+	}
+
+out_ctx:
+	percpu_ref_put(&ctx->refs);
+out_fput:
+	fdput(f);
+	return submitted ? submitted : ret;
+}
+
+static const struct file_operations io_uring_fops = {
+	.release	= io_uring_release,
+	.mmap		= io_uring_mmap,
+	.poll		= io_uring_poll,
+	.llseek		= noop_llseek,
+};
+
+static int io_allocate_scq_urings(struct io_ring_ctx *ctx,
+				  struct io_uring_params *p)
+{
+	struct io_sq_ring *sq_ring;
+	struct io_cq_ring *cq_ring;
+	size_t size;
+
+	size = sizeof(struct io_sq_ring) + p->sq_entries * sizeof(u32);
+	sq_ring = io_mem_alloc(size);
+	if (!sq_ring)
+		return -ENOMEM;
+
+	ctx->sq_ring = sq_ring;
+	sq_ring->ring_mask = p->sq_entries - 1;
+	sq_ring->ring_entries = p->sq_entries;
+	ctx->sq_mask = sq_ring->ring_mask;
+	ctx->sq_entries = sq_ring->ring_entries;
+
+	size = sizeof(struct io_uring_sqe) * p->sq_entries;
+	ctx->sq_sqes = io_mem_alloc(size);
+	if (!ctx->sq_sqes)
+		return -ENOMEM;
+
+	size = sizeof(struct io_cq_ring) +
+		p->cq_entries * sizeof(struct io_uring_cqe);
+	cq_ring = io_mem_alloc(size);
+	if (!cq_ring)
+		return -ENOMEM;
+
+	ctx->cq_ring = cq_ring;
+	cq_ring->ring_mask = p->cq_entries - 1;
+	cq_ring->ring_entries = p->cq_entries;
+	ctx->cq_mask = cq_ring->ring_mask;
+	ctx->cq_entries = cq_ring->ring_entries;
+	return 0;
+}
+
+static int io_sq_offload_start(struct io_ring_ctx *ctx,
+			       struct io_uring_params *p)
+{
+	int ret;
+
+	atomic_inc(&current->mm->mm_count);
+	ctx->sqo_mm = current->mm;
+	ctx->creds = get_current_cred();
+	ctx->compat = is_compat_task();
+
+	/* Do QD, or 2 * CPUS, whatever is smallest */
+	ctx->sqo_wq = alloc_workqueue("io_ring-wq", WQ_UNBOUND | WQ_FREEZABLE,
+			min(ctx->sq_entries - 1, 2 * num_online_cpus()));
+	if (!ctx->sqo_wq)
+		return -ENOMEM;
+
+	if (ctx->flags & IORING_SETUP_SQPOLL) {
+		ret = -EPERM;
+		if (!capable(CAP_SYS_ADMIN))
+			return ret;
+
+		ctx->sq_thread_idle = msecs_to_jiffies(p->sq_thread_idle);
+		if (!ctx->sq_thread_idle)
+			ctx->sq_thread_idle = HZ;
+
+		ctx->sqo_thread = kthread_create(io_sq_thread, ctx,
+						 "io_uring-sq");
+		if (IS_ERR(ctx->sqo_thread)) {
+			ret = PTR_ERR(ctx->sqo_thread);
+			ctx->sqo_thread = NULL;
+			return ret;
+		}
+		wake_up_process(ctx->sqo_thread);
+	} else if (p->sq_thread_idle) {
+		/* only meaningful with IORING_SETUP_SQPOLL */
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int io_uring_create(unsigned entries, struct io_uring_params *p)
+{
+	struct io_ring_ctx *ctx;
+	int ret;
+
+	if (!entries || entries > IORING_MAX_ENTRIES)
+		return -EINVAL;
+
+	/*
+	 * Use twice as many entries for the CQ ring. It's possible for the
+	 * application to drive a higher depth than the size of the SQ ring,
+	 * since the sqes are only used at submission time. This allows for
+	 * some flexibility in overcommitting a bit.
+	 */
+	p->sq_entries = roundup_pow_of_two(entries);
+	p->cq_entries = 2 * p->sq_entries;
+
+	ctx = io_ring_ctx_alloc(p);
+	if (!ctx)
+		return -ENOMEM;
+
+	ret = io_allocate_scq_urings(ctx, p);
+	if (ret)
+		goto err;
+
+	ret = io_sq_offload_start(ctx, p);
+	if (ret)
+		goto err;
+
+	ret = anon_inode_getfd("[io_uring]", &io_uring_fops, ctx,
+			       O_RDWR | O_CLOEXEC);
+	if (ret < 0)
+		goto err;
+
+	memset(&p->sq_off, 0, sizeof(p->sq_off));
+	p->sq_off.head = offsetof(struct io_sq_ring, r.head);
+	p->sq_off.tail = offsetof(struct io_sq_ring, r.tail);
+	p->sq_off.ring_mask = offsetof(struct io_sq_ring, ring_mask);
+	p->sq_off.ring_entries = offsetof(struct io_sq_ring, ring_entries);
+	p->sq_off.flags = offsetof(struct io_sq_ring, flags);
+	p->sq_off.dropped = offsetof(struct io_sq_ring, dropped);
+	p->sq_off.array = offsetof(struct io_sq_ring, array);
+
+	memset(&p->cq_off, 0, sizeof(p->cq_off));
+	p->cq_off.head = offsetof(struct io_cq_ring, r.head);
+	p->cq_off.tail = offsetof(struct io_cq_ring, r.tail);
+	p->cq_off.ring_mask = offsetof(struct io_cq_ring, ring_mask);
+	p->cq_off.ring_entries = offsetof(struct io_cq_ring, ring_entries);
+	p->cq_off.overflow = offsetof(struct io_cq_ring, overflow);
+	p->cq_off.cqes = offsetof(struct io_cq_ring, cqes);
+	return ret;
+err:
+	io_ring_ctx_wait_and_kill(ctx);
+	return ret;
+}
+
+/*
+ * Sets up an aio uring context, and returns the fd. Applications asks for a
+ * ring size, we return the actual sq/cq ring sizes (among other things) in the
+ * params structure passed in.
+ */
+SYSCALL_DEFINE2(io_uring_setup, u32, entries,
+		struct io_uring_params __user *, params)
+{
+	struct io_uring_params p;
+	long ret;
+	int i;
+
+	if (copy_from_user(&p, params, sizeof(p)))
+		return -EFAULT;
+	for (i = 0; i < ARRAY_SIZE(p.resv); i++) {
+		if (p.resv[i])
+			return -EINVAL;
+	}
+
+	if (p.flags & ~IORING_SETUP_SQPOLL)
+		return -EINVAL;
+
+	ret = io_uring_create(entries, &p);
+	if (ret < 0)
+		return ret;
+
+	if (copy_to_user(params, &p, sizeof(p)))
+		return -EFAULT;
+
+	return ret;
+}
+
+static int __init io_uring_init(void)
+{
+	req_cachep = KMEM_CACHE(io_kiocb, SLAB_HWCACHE_ALIGN | SLAB_PANIC);
+	return 0;
+}
+__initcall(io_uring_init);
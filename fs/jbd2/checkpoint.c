@@ -23,6 +23,7 @@
 #include <linux/errno.h>
 #include <linux/slab.h>
 #include <linux/blkdev.h>
+#include <linux/sort.h>
 #include <trace/events/jbd2.h>
 
 /*
@@ -111,10 +112,13 @@ static int __try_to_free_cp_buf(struct journal_head *jh)
 void __jbd2_log_wait_for_space(journal_t *journal)
 {
 	int nblocks, space_left;
+	ktime_t start = ktime_set(0, 0);
 	/* assert_spin_locked(&journal->j_state_lock); */
 
 	nblocks = jbd2_space_needed(journal);
 	while (jbd2_log_space_left(journal) < nblocks) {
+		if (!start.tv64)
+			start = ktime_get();
 		write_unlock(&journal->j_state_lock);
 		mutex_lock(&journal->j_checkpoint_mutex);
 
@@ -176,6 +180,127 @@ void __jbd2_log_wait_for_space(journal_t *journal)
 		}
 		mutex_unlock(&journal->j_checkpoint_mutex);
 	}
+
+	if (start.tv64) {
+		u64 stall = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		spin_lock(&journal->j_history_lock);
+		journal->j_stats.ts_chkpt_stalls++;
+		journal->j_stats.ts_chkpt_stall_ns += stall;
+		spin_unlock(&journal->j_history_lock);
+	}
+}
+
+/*
+ * Wake up the checkpoint thread if the log is filling up.  Called after
+ * each commit, which is what eats log space.
+ */
+void jbd2_log_kick_checkpoint(journal_t *journal)
+{
+	if (journal->j_chkpt_task && jbd2_log_need_bg_checkpoint(journal, false))
+		wake_up(&journal->j_wait_chkpt);
+}
+
+static int jbd2_bh_cmp(const void *a, const void *b)
+{
+	const struct buffer_head *bh_a = *(const struct buffer_head **)a;
+	const struct buffer_head *bh_b = *(const struct buffer_head **)b;
+
+	if (bh_a->b_blocknr < bh_b->b_blocknr)
+		return -1;
+	return bh_a->b_blocknr > bh_b->b_blocknr;
+}
+
+/*
+ * Background checkpoint, run by the checkpoint thread.
+ *
+ * Unlike jbd2_log_do_checkpoint(), which writes out the oldest
+ * transaction and waits for anything in its way, this collects the dirty
+ * buffers of as many checkpoint transactions as fit in one batch, skips
+ * the ones that are busy and writes the rest in block order.  Buffers
+ * still part of a newer transaction are left to the commit.
+ *
+ * Returns the number of buffers written, 0 if there was nothing to do.
+ * Called with j_checkpoint_mutex held.
+ */
+int jbd2_log_do_bg_checkpoint(journal_t *journal)
+{
+	struct buffer_head **bhs = journal->j_bg_chkpt_bhs;
+	struct journal_head *jh, *first_jh;
+	transaction_t *transaction;
+	struct blk_plug plug;
+	int i, count = 0;
+
+	if (jbd2_cleanup_journal_tail(journal) < 0)
+		return -EIO;
+
+	spin_lock(&journal->j_list_lock);
+	transaction = journal->j_checkpoint_transactions;
+	if (!transaction) {
+		spin_unlock(&journal->j_list_lock);
+		return 0;
+	}
+
+	do {
+		first_jh = jh = transaction->t_checkpoint_list;
+		while (jh && count < JBD2_BG_NR_BATCH) {
+			struct buffer_head *bh = jh2bh(jh);
+
+			if (!jh->b_transaction && buffer_dirty(bh) &&
+			    !buffer_locked(bh)) {
+				get_bh(bh);
+				bhs[count++] = bh;
+			}
+			jh = jh->b_cpnext;
+			if (jh == first_jh)
+				break;
+		}
+		transaction = transaction->t_cpnext;
+	} while (transaction != journal->j_checkpoint_transactions &&
+		 count < JBD2_BG_NR_BATCH);
+
+	for (i = 0; i < count; i++) {
+		jh = bh2jh(bhs[i]);
+		jh->b_cp_transaction->t_chp_stats.cs_written++;
+		__buffer_relink_io(jh);
+	}
+	spin_unlock(&journal->j_list_lock);
+
+	if (!count)
+		return 0;
+
+	sort(bhs, count, sizeof(*bhs), jbd2_bh_cmp, NULL);
+
+	blk_start_plug(&plug);
+	for (i = 0; i < count; i++)
+		write_dirty_buffer(bhs[i], WRITE);
+	blk_finish_plug(&plug);
+
+	for (i = 0; i < count; i++)
+		wait_on_buffer(bhs[i]);
+
+	/*
+	 * Buffers that failed stay on the io list, the next foreground
+	 * checkpoint will find the error and abort the journal.
+	 */
+	spin_lock(&journal->j_list_lock);
+	for (i = 0; i < count; i++) {
+		if (buffer_jbd(bhs[i]))
+			__try_to_free_cp_buf(bh2jh(bhs[i]));
+	}
+	spin_unlock(&journal->j_list_lock);
+
+	for (i = 0; i < count; i++) {
+		BUFFER_TRACE(bhs[i], "brelse");
+		__brelse(bhs[i]);
+	}
+
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_chkpt_bg_written += count;
+	spin_unlock(&journal->j_history_lock);
+
+	jbd2_cleanup_journal_tail(journal);
+	return count;
 }
 
 static void
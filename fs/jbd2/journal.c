@@ -221,6 +221,7 @@ loop:
 		write_unlock(&journal->j_state_lock);
 		del_timer_sync(&journal->j_commit_timer);
 		jbd2_journal_commit_transaction(journal);
+		jbd2_log_kick_checkpoint(journal);
 		write_lock(&journal->j_state_lock);
 		goto loop;
 	}
@@ -283,6 +284,63 @@ end_loop:
 	return 0;
 }
 
+/*
+ * The checkpoint thread writes back checkpoint buffers in the background
+ * once the log gets half full, see jbd2_log_do_bg_checkpoint().  It lets
+ * go of j_checkpoint_mutex between batches so that a handle waiting for
+ * log space can still checkpoint itself.
+ */
+static int jbd2_checkpoint_thread(void *arg)
+{
+	journal_t *journal = arg;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(journal->j_wait_chkpt,
+				jbd2_log_need_bg_checkpoint(journal, false) ||
+				kthread_should_stop());
+
+		while (!kthread_should_stop() && !is_journal_aborted(journal) &&
+		       jbd2_log_need_bg_checkpoint(journal, true)) {
+			int ret;
+
+			mutex_lock(&journal->j_checkpoint_mutex);
+			ret = jbd2_log_do_bg_checkpoint(journal);
+			mutex_unlock(&journal->j_checkpoint_mutex);
+			if (ret <= 0)
+				break;
+			cond_resched();
+		}
+	}
+	return 0;
+}
+
+static void jbd2_journal_start_chkpt_thread(journal_t *journal)
+{
+	struct task_struct *t;
+
+	journal->j_bg_chkpt_bhs = kmalloc_array(JBD2_BG_NR_BATCH,
+					sizeof(struct buffer_head *),
+					GFP_KERNEL);
+	if (!journal->j_bg_chkpt_bhs)
+		goto fail;
+
+	t = kthread_run(jbd2_checkpoint_thread, journal, "jbd2-ckpt/%s",
+			journal->j_devname);
+	if (IS_ERR(t)) {
+		kfree(journal->j_bg_chkpt_bhs);
+		journal->j_bg_chkpt_bhs = NULL;
+		goto fail;
+	}
+	journal->j_chkpt_task = t;
+	return;
+
+fail:
+	/* Not fatal, handles checkpoint themselves as before */
+	printk(KERN_WARNING "JBD2: no checkpoint thread for %s\n",
+	       journal->j_devname);
+}
+
 static int jbd2_journal_start_thread(journal_t *journal)
 {
 	struct task_struct *t;
@@ -293,11 +351,21 @@ static int jbd2_journal_start_thread(journal_t *journal)
 		return PTR_ERR(t);
 
 	wait_event(journal->j_wait_done_commit, journal->j_task != NULL);
+
+	if (!journal->j_chkpt_task)
+		jbd2_journal_start_chkpt_thread(journal);
 	return 0;
 }
 
 static void journal_kill_thread(journal_t *journal)
 {
+	if (journal->j_chkpt_task) {
+		kthread_stop(journal->j_chkpt_task);
+		journal->j_chkpt_task = NULL;
+		kfree(journal->j_bg_chkpt_bhs);
+		journal->j_bg_chkpt_bhs = NULL;
+	}
+
 	write_lock(&journal->j_state_lock);
 	journal->j_flags |= JBD2_UNMOUNT;
 
@@ -754,6 +822,99 @@ wait_commit:
 }
 EXPORT_SYMBOL(jbd2_complete_transaction);
 
+/*
+ * Fast commits let the filesystem log its own compact records for the
+ * running transaction in the fast commit area instead of committing the
+ * whole transaction.  Fast and full commits exclude each other: a full
+ * commit empties the area when it is done, so a fast commit must neither
+ * run during one nor belong to the transaction being committed.
+ *
+ * jbd2_fc_begin_commit() returns -EALREADY if @tid is not the running
+ * transaction any more, the caller then waits for the full commit.
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	DEFINE_WAIT(wait);
+
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return -EOPNOTSUPP;
+
+	write_lock(&journal->j_state_lock);
+	while (journal->j_flags & (JBD2_FAST_COMMIT_ONGOING |
+				   JBD2_FULL_COMMIT_ONGOING)) {
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		write_unlock(&journal->j_state_lock);
+		schedule();
+		write_lock(&journal->j_state_lock);
+		finish_wait(&journal->j_fc_wait, &wait);
+	}
+
+	if (!journal->j_running_transaction ||
+	    journal->j_running_transaction->t_tid != tid ||
+	    is_journal_aborted(journal)) {
+		write_unlock(&journal->j_state_lock);
+		return -EALREADY;
+	}
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+
+	/*
+	 * Recovery only looks at the fast commit area if the log is not
+	 * marked empty, same as for the first commit after a flush.
+	 */
+	if (journal->j_flags & JBD2_FLUSHED) {
+		mutex_lock(&journal->j_checkpoint_mutex);
+		jbd2_journal_update_sb_log_tail(journal,
+						journal->j_tail_sequence,
+						journal->j_tail,
+						WRITE_FUA);
+		mutex_unlock(&journal->j_checkpoint_mutex);
+	}
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+
+void jbd2_fc_end_commit(journal_t *journal)
+{
+	write_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
+}
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+
+/*
+ * Get the next free block of the fast commit area, only valid between
+ * jbd2_fc_begin_commit() and jbd2_fc_end_commit().  Returns -ENOSPC once
+ * the area is used up, the caller then falls back to a full commit.
+ */
+int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bh_out)
+{
+	unsigned long long pblock;
+	unsigned long blocknr;
+	struct buffer_head *bh;
+	int err;
+
+	if (journal->j_fc_first + journal->j_fc_off >= journal->j_fc_last)
+		return -ENOSPC;
+
+	blocknr = journal->j_fc_first + journal->j_fc_off;
+	err = jbd2_journal_bmap(journal, blocknr, &pblock);
+	if (err)
+		return err;
+
+	bh = __getblk(journal->j_dev, pblock, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+
+	journal->j_fc_off++;
+	*bh_out = bh;
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_get_buf);
+
 /*
  * Log buffer allocation routines:
  */
@@ -955,6 +1116,11 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 		   "each up to %u blocks\n",
 		   s->stats->ts_tid, s->stats->ts_requested,
 		   s->journal->j_max_transaction_buffers);
+	seq_printf(seq, "%lu waits for log space, %lluus waiting in total\n",
+		   s->stats->ts_chkpt_stalls,
+		   div_u64(s->stats->ts_chkpt_stall_ns, 1000));
+	seq_printf(seq, "%lu blocks written by the checkpoint thread\n",
+		   s->stats->ts_chkpt_bg_written);
 	if (s->stats->ts_tid == 0)
 		return 0;
 	seq_printf(seq, "average: \n  %ums waiting for transaction\n",
@@ -1081,6 +1247,8 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_done_commit);
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
+	init_waitqueue_head(&journal->j_fc_wait);
+	init_waitqueue_head(&journal->j_wait_chkpt);
 	init_waitqueue_head(&journal->j_wait_reserved);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
@@ -1267,6 +1435,32 @@ static void journal_fail_superblock (journal_t *journal)
 	journal->j_sb_buffer = NULL;
 }
 
+/*
+ * The fast commit area takes the last s_num_fc_blks blocks of the
+ * journal, so the log proper ends where it starts.
+ */
+static int jbd2_journal_init_fc_area(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long num_fc_blks = be32_to_cpu(sb->s_num_fc_blks);
+
+	if (!num_fc_blks)
+		num_fc_blks = JBD2_DEFAULT_FAST_COMMIT_BLOCKS;
+
+	if (journal->j_last - journal->j_first <
+	    num_fc_blks + JBD2_MIN_JOURNAL_BLOCKS) {
+		printk(KERN_ERR "JBD2: Journal too short for %lu fast "
+		       "commit blocks.\n", num_fc_blks);
+		return -EINVAL;
+	}
+
+	journal->j_fc_last = journal->j_last;
+	journal->j_fc_first = journal->j_last - num_fc_blks;
+	journal->j_fc_off = 0;
+	journal->j_last = journal->j_fc_first;
+	return 0;
+}
+
 /*
  * Given a journal_t structure, initialise the various fields for
  * startup of a new journaling session.  We use this both when creating
@@ -1291,9 +1485,16 @@ static int journal_reset(journal_t *journal)
 	journal->j_first = first;
 	journal->j_last = last;
 
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT) &&
+	    jbd2_journal_init_fc_area(journal)) {
+		journal_fail_superblock(journal);
+		return -EINVAL;
+	}
+
 	journal->j_head = first;
 	journal->j_tail = first;
-	journal->j_free = last - first;
+	journal->j_free = journal->j_last - first;
 
 	journal->j_tail_sequence = journal->j_transaction_sequence;
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
@@ -1596,6 +1797,10 @@ static int load_superblock(journal_t *journal)
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return jbd2_journal_init_fc_area(journal);
+
 	return 0;
 }
 
@@ -1813,6 +2018,7 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 #define COMPAT_FEATURE_ON(f) \
 		((compat & (f)) && !(sb->s_feature_compat & cpu_to_be32(f)))
 	journal_superblock_t *sb;
+	bool fc_on;
 
 	if (jbd2_journal_check_used_features(journal, compat, ro, incompat))
 		return 1;
@@ -1836,6 +2042,24 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 
 	sb = journal->j_superblock;
 
+	/*
+	 * The fast commit area is taken off the end of the log, which is
+	 * only safe while the log is empty, i.e. right after journal load.
+	 */
+	fc_on = INCOMPAT_FEATURE_ON(JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	if (fc_on) {
+		write_lock(&journal->j_state_lock);
+		if (journal->j_running_transaction ||
+		    journal->j_head != journal->j_first ||
+		    journal->j_tail != journal->j_first ||
+		    jbd2_journal_init_fc_area(journal)) {
+			write_unlock(&journal->j_state_lock);
+			return 0;
+		}
+		journal->j_free = journal->j_last - journal->j_first;
+		write_unlock(&journal->j_state_lock);
+	}
+
 	/* If enabling v3 checksums, update superblock */
 	if (INCOMPAT_FEATURE_ON(JBD2_FEATURE_INCOMPAT_CSUM_V3)) {
 		sb->s_checksum_type = JBD2_CRC32C_CHKSUM;
@@ -1870,6 +2094,13 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 	sb->s_feature_ro_compat |= cpu_to_be32(ro);
 	sb->s_feature_incompat  |= cpu_to_be32(incompat);
 
+	/* Recovery must know about the area before it is first used */
+	if (fc_on) {
+		mutex_lock(&journal->j_checkpoint_mutex);
+		jbd2_write_superblock(journal, WRITE_FUA);
+		mutex_unlock(&journal->j_checkpoint_mutex);
+	}
+
 	return 1;
 #undef COMPAT_FEATURE_ON
 #undef INCOMPAT_FEATURE_ON
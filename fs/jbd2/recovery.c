@@ -38,7 +38,6 @@ struct recovery_info
 	int		nr_revoke_hits;
 };
 
-enum passtype {PASS_SCAN, PASS_REVOKE, PASS_REPLAY};
 static int do_one_pass(journal_t *journal,
 				struct recovery_info *info, enum passtype pass);
 static int scan_revoke_records(journal_t *, struct buffer_head *,
@@ -233,6 +232,51 @@ do {									\
 		var -= ((journal)->j_last - (journal)->j_first);	\
 } while (0)
 
+/*
+ * Hand the fast commit area to the filesystem, block by block, until it
+ * tells us the valid part has ended.  Fast commit blocks only count for
+ * the transaction after the last one found complete in the log.
+ */
+static int fc_do_one_pass(journal_t *journal,
+			  struct recovery_info *info, enum passtype pass)
+{
+	unsigned long next_fc_block = journal->j_fc_first;
+	unsigned long long blocknr;
+	struct buffer_head *bh;
+	int err = 0;
+
+	if (!journal->j_fc_replay_callback)
+		return 0;
+
+	while (next_fc_block < journal->j_fc_last) {
+		err = jbd2_journal_bmap(journal, next_fc_block, &blocknr);
+		if (err)
+			break;
+
+		bh = __bread(journal->j_dev, blocknr, journal->j_blocksize);
+		if (!bh) {
+			printk(KERN_ERR "JBD2: Failed to read fast commit "
+			       "block at offset %lu\n", next_fc_block);
+			err = -EIO;
+			break;
+		}
+
+		err = journal->j_fc_replay_callback(journal, bh, pass,
+					next_fc_block - journal->j_fc_first,
+					info->end_transaction);
+		brelse(bh);
+		if (err)
+			break;
+		next_fc_block++;
+	}
+
+	if (err > 0)
+		err = 0;
+	if (err)
+		jbd_debug(3, "Fast commit replay: stopped, err = %d\n", err);
+	return err;
+}
+
 /**
  * jbd2_journal_recover - recovers a on-disk journal
  * @journal: the journal to recover
@@ -269,10 +313,16 @@ int jbd2_journal_recover(journal_t *journal)
 	}
 
 	err = do_one_pass(journal, &info, PASS_SCAN);
+	if (!err && JBD2_HAS_INCOMPAT_FEATURE(journal,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		err = fc_do_one_pass(journal, &info, PASS_SCAN);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REVOKE);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REPLAY);
+	if (!err && JBD2_HAS_INCOMPAT_FEATURE(journal,
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		err = fc_do_one_pass(journal, &info, PASS_REPLAY);
 
 	jbd_debug(1, "JBD2: recovery, exit status %d, "
 		  "recovered transactions %u to %u\n",
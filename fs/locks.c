@@ -129,6 +129,8 @@
 #include <linux/hashtable.h>
 #include <linux/percpu.h>
 #include <linux/lglock.h>
+#include <linux/interval_tree_generic.h>
+#include <linux/notifier.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/filelock.h>
@@ -140,6 +142,22 @@
 #define IS_LEASE(fl)	(fl->fl_flags & (FL_LEASE|FL_DELEG|FL_LAYOUT))
 #define IS_OFDLCK(fl)	(fl->fl_flags & FL_OFDLCK)
 
+/*
+ * POSIX locks are kept on flc_posix in owner order for the merge logic in
+ * __posix_lock_file, and in addition indexed by range in flc_posix_tree so
+ * that conflict checks only visit the locks that actually overlap.
+ */
+#define POSIX_LOCK_START(fl)	((fl)->fl_start)
+#define POSIX_LOCK_LAST(fl)	((fl)->fl_end)
+
+INTERVAL_TREE_DEFINE(struct file_lock, fl_rb, loff_t, fl_subtree_last,
+		     POSIX_LOCK_START, POSIX_LOCK_LAST, static, posix_lock_tree)
+
+#define posix_lock_for_each_overlap(fl, ctx, start, end)		\
+	for (fl = posix_lock_tree_iter_first(&(ctx)->flc_posix_tree,	\
+					     start, end);		\
+	     fl; fl = posix_lock_tree_iter_next(fl, start, end))
+
 static bool lease_breaking(struct file_lock *fl)
 {
 	return fl->fl_flags & (FL_UNLOCK_PENDING | FL_DOWNGRADE_PENDING);
@@ -217,6 +235,7 @@ locks_get_lock_context(struct inode *inode, int type)
 	spin_lock_init(&new->flc_lock);
 	INIT_LIST_HEAD(&new->flc_flock);
 	INIT_LIST_HEAD(&new->flc_posix);
+	new->flc_posix_tree = RB_ROOT;
 	INIT_LIST_HEAD(&new->flc_lease);
 
 	/*
@@ -235,6 +254,7 @@ locks_free_lock_context(struct file_lock_context *ctx)
 	if (ctx) {
 		WARN_ON_ONCE(!list_empty(&ctx->flc_flock));
 		WARN_ON_ONCE(!list_empty(&ctx->flc_posix));
+		WARN_ON_ONCE(!RB_EMPTY_ROOT(&ctx->flc_posix_tree));
 		WARN_ON_ONCE(!list_empty(&ctx->flc_lease));
 		kmem_cache_free(flctx_cache, ctx);
 	}
@@ -244,6 +264,7 @@ static void locks_init_lock_heads(struct file_lock *fl)
 {
 	INIT_HLIST_NODE(&fl->fl_link);
 	INIT_LIST_HEAD(&fl->fl_list);
+	RB_CLEAR_NODE(&fl->fl_rb);
 	INIT_LIST_HEAD(&fl->fl_block);
 	init_waitqueue_head(&fl->fl_wait);
 }
@@ -709,6 +730,34 @@ locks_delete_lock_ctx(struct file_lock *fl, struct list_head *dispose)
 		locks_free_lock(fl);
 }
 
+static void
+locks_insert_posix_ctx(struct file_lock_context *ctx, struct file_lock *fl,
+		       struct list_head *before)
+{
+	posix_lock_tree_insert(fl, &ctx->flc_posix_tree);
+	locks_insert_lock_ctx(fl, before);
+}
+
+static void
+locks_delete_posix_ctx(struct file_lock_context *ctx, struct file_lock *fl,
+		       struct list_head *dispose)
+{
+	posix_lock_tree_remove(fl, &ctx->flc_posix_tree);
+	RB_CLEAR_NODE(&fl->fl_rb);
+	locks_delete_lock_ctx(fl, dispose);
+}
+
+/* Change the range of a lock that is already on flc_posix */
+static void
+locks_posix_set_range(struct file_lock_context *ctx, struct file_lock *fl,
+		      loff_t start, loff_t end)
+{
+	posix_lock_tree_remove(fl, &ctx->flc_posix_tree);
+	fl->fl_start = start;
+	fl->fl_end = end;
+	posix_lock_tree_insert(fl, &ctx->flc_posix_tree);
+}
+
 /* Determine if lock sys_fl blocks lock caller_fl. Common functionality
  * checks for shared/exclusive status of overlapping locks.
  */
@@ -769,7 +818,7 @@ posix_test_lock(struct file *filp, struct file_lock *fl)
 	}
 
 	spin_lock(&ctx->flc_lock);
-	list_for_each_entry(cfl, &ctx->flc_posix, fl_list) {
+	posix_lock_for_each_overlap(cfl, ctx, fl->fl_start, fl->fl_end) {
 		if (posix_locks_conflict(fl, cfl)) {
 			locks_copy_conflock(fl, cfl);
 			if (cfl->fl_nspid)
@@ -939,6 +988,7 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 	struct file_lock *left = NULL;
 	struct file_lock *right = NULL;
 	struct file_lock_context *ctx;
+	loff_t start, end;
 	int error;
 	bool added = false;
 	LIST_HEAD(dispose);
@@ -967,7 +1017,8 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 	 * blocker's list of waiters and the global blocked_hash.
 	 */
 	if (request->fl_type != F_UNLCK) {
-		list_for_each_entry(fl, &ctx->flc_posix, fl_list) {
+		posix_lock_for_each_overlap(fl, ctx, request->fl_start,
+					    request->fl_end) {
 			if (!posix_locks_conflict(request, fl))
 				continue;
 			if (conflock)
@@ -1025,18 +1076,16 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 			 * lock yielding from the lower start address of both
 			 * locks to the higher end address.
 			 */
-			if (fl->fl_start > request->fl_start)
-				fl->fl_start = request->fl_start;
-			else
-				request->fl_start = fl->fl_start;
-			if (fl->fl_end < request->fl_end)
-				fl->fl_end = request->fl_end;
-			else
-				request->fl_end = fl->fl_end;
+			start = min(fl->fl_start, request->fl_start);
+			end = max(fl->fl_end, request->fl_end);
 			if (added) {
-				locks_delete_lock_ctx(fl, &dispose);
+				locks_posix_set_range(ctx, request, start, end);
+				locks_delete_posix_ctx(ctx, fl, &dispose);
 				continue;
 			}
+			request->fl_start = start;
+			request->fl_end = end;
+			locks_posix_set_range(ctx, fl, start, end);
 			request = fl;
 			added = true;
 		} else {
@@ -1063,7 +1112,8 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 				 * one (This may happen several times).
 				 */
 				if (added) {
-					locks_delete_lock_ctx(fl, &dispose);
+					locks_delete_posix_ctx(ctx, fl,
+							       &dispose);
 					continue;
 				}
 				/*
@@ -1079,8 +1129,9 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 				locks_copy_lock(new_fl, request);
 				request = new_fl;
 				new_fl = NULL;
-				locks_insert_lock_ctx(request, &fl->fl_list);
-				locks_delete_lock_ctx(fl, &dispose);
+				locks_insert_posix_ctx(ctx, request,
+						       &fl->fl_list);
+				locks_delete_posix_ctx(ctx, fl, &dispose);
 				added = true;
 			}
 		}
@@ -1108,7 +1159,7 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 			goto out;
 		}
 		locks_copy_lock(new_fl, request);
-		locks_insert_lock_ctx(new_fl, &fl->fl_list);
+		locks_insert_posix_ctx(ctx, new_fl, &fl->fl_list);
 		fl = new_fl;
 		new_fl = NULL;
 	}
@@ -1120,13 +1171,15 @@ static int __posix_lock_file(struct inode *inode, struct file_lock *request, str
 			left = new_fl2;
 			new_fl2 = NULL;
 			locks_copy_lock(left, right);
-			locks_insert_lock_ctx(left, &fl->fl_list);
+			locks_insert_posix_ctx(ctx, left, &fl->fl_list);
 		}
-		right->fl_start = request->fl_end + 1;
+		locks_posix_set_range(ctx, right, request->fl_end + 1,
+				      right->fl_end);
 		locks_wake_up_blocks(right);
 	}
 	if (left) {
-		left->fl_end = request->fl_start - 1;
+		locks_posix_set_range(ctx, left, left->fl_start,
+				      request->fl_start - 1);
 		locks_wake_up_blocks(left);
 	}
  out:
@@ -1781,6 +1834,38 @@ int generic_setlease(struct file *filp, long arg, struct file_lock **flp,
 }
 EXPORT_SYMBOL(generic_setlease);
 
+/*
+ * Kernel users that keep files open on their own, like the nfsd file
+ * cache, need to know when someone is about to set a lease, since their
+ * opens would conflict with it.
+ */
+static struct srcu_notifier_head lease_notifier_chain;
+
+static inline void
+lease_notifier_chain_init(void)
+{
+	srcu_init_notifier_head(&lease_notifier_chain);
+}
+
+static inline void
+setlease_notifier(long arg, struct file_lock *lease)
+{
+	if (arg != F_UNLCK)
+		srcu_notifier_call_chain(&lease_notifier_chain, arg, lease);
+}
+
+int lease_register_notifier(struct notifier_block *nb)
+{
+	return srcu_notifier_chain_register(&lease_notifier_chain, nb);
+}
+EXPORT_SYMBOL_GPL(lease_register_notifier);
+
+void lease_unregister_notifier(struct notifier_block *nb)
+{
+	srcu_notifier_chain_unregister(&lease_notifier_chain, nb);
+}
+EXPORT_SYMBOL_GPL(lease_unregister_notifier);
+
 /**
  * vfs_setlease        -       sets a lease on an open file
  * @filp:	file pointer
@@ -1801,6 +1886,8 @@ EXPORT_SYMBOL(generic_setlease);
 int
 vfs_setlease(struct file *filp, long arg, struct file_lock **lease, void **priv)
 {
+	if (lease)
+		setlease_notifier(arg, *lease);
 	if (filp->f_op->setlease)
 		return filp->f_op->setlease(filp, arg, lease, priv);
 	else
@@ -2694,6 +2781,8 @@ static int __init filelock_init(void)
 
 	lg_lock_init(&file_lock_lglock, "file_lock_lglock");
 
+	lease_notifier_chain_init();
+
 	for_each_possible_cpu(i)
 		INIT_HLIST_HEAD(per_cpu_ptr(&file_lock_list, i));
 
@@ -1315,6 +1315,30 @@ static void follow_dotdot(struct nameidata *nd)
 	nd->inode = nd->path.dentry->d_inode;
 }
 
+/*
+ * Filesystems with FS_PARALLEL_LOOKUP have lookup_slow() call ->lookup()
+ * with only i_lookup_rwsem of the directory held shared, not i_mutex.
+ * Everything else that calls into the filesystem to look up or change
+ * names in such a directory, still under i_mutex, takes i_lookup_rwsem
+ * exclusive on top of it.
+ */
+static inline bool dir_parallel_lookup(struct inode *dir)
+{
+	return dir->i_sb->s_type->fs_flags & FS_PARALLEL_LOOKUP;
+}
+
+static inline void dir_lookup_lock(struct inode *dir, int subclass)
+{
+	if (dir_parallel_lookup(dir))
+		down_write_nested(&dir->i_lookup_rwsem, subclass);
+}
+
+static inline void dir_lookup_unlock(struct inode *dir)
+{
+	if (dir_parallel_lookup(dir))
+		up_write(&dir->i_lookup_rwsem);
+}
+
 /*
  * This looks up the name in dcache, possibly revalidates the old dentry and
  * allocates a new one if not found or not valid.  In the need_lookup argument
@@ -1387,11 +1411,60 @@ static struct dentry *__lookup_hash(struct qstr *name,
 	bool need_lookup;
 	struct dentry *dentry;
 
+	dir_lookup_lock(base->d_inode, 0);
 	dentry = lookup_dcache(name, base, flags, &need_lookup);
-	if (!need_lookup)
-		return dentry;
+	if (need_lookup)
+		dentry = lookup_real(base->d_inode, dentry, flags);
+	dir_lookup_unlock(base->d_inode);
+	return dentry;
+}
 
-	return lookup_real(base->d_inode, dentry, flags);
+/*
+ * Lookup in a FS_PARALLEL_LOOKUP directory, lookups of other names in
+ * it go on at the same time.  d_alloc_parallel() makes sure there is only
+ * one lookup of the same name.
+ */
+static struct dentry *lookup_parallel(struct qstr *name, struct dentry *dir,
+				      unsigned int flags)
+{
+	struct inode *inode = dir->d_inode;
+	struct dentry *dentry, *old;
+	int error;
+
+	down_read(&inode->i_lookup_rwsem);
+again:
+	dentry = d_alloc_parallel(dir, name);
+	if (IS_ERR(dentry))
+		goto out;
+
+	if (!d_in_lookup(dentry)) {
+		if (!(dentry->d_flags & DCACHE_OP_REVALIDATE))
+			goto out;
+		error = d_revalidate(dentry, flags);
+		if (likely(error > 0))
+			goto out;
+		if (!error)
+			d_invalidate(dentry);
+		dput(dentry);
+		if (!error)
+			goto again;
+		dentry = ERR_PTR(error);
+		goto out;
+	}
+
+	/* Don't create child dentry for a dead directory. */
+	if (unlikely(IS_DEADDIR(inode)))
+		old = ERR_PTR(-ENOENT);
+	else
+		old = inode->i_op->lookup(inode, dentry, flags);
+	d_lookup_done(dentry);
+	if (unlikely(old)) {
+		dput(dentry);
+		dentry = old;
+	}
+out:
+	up_read(&inode->i_lookup_rwsem);
+	return dentry;
 }
 
 /*
@@ -1497,9 +1570,13 @@ static int lookup_slow(struct nameidata *nd, struct path *path)
 	parent = nd->path.dentry;
 	BUG_ON(nd->inode != parent->d_inode);
 
-	mutex_lock(&parent->d_inode->i_mutex);
-	dentry = __lookup_hash(&nd->last, parent, nd->flags);
-	mutex_unlock(&parent->d_inode->i_mutex);
+	if (dir_parallel_lookup(parent->d_inode)) {
+		dentry = lookup_parallel(&nd->last, parent, nd->flags);
+	} else {
+		mutex_lock(&parent->d_inode->i_mutex);
+		dentry = __lookup_hash(&nd->last, parent, nd->flags);
+		mutex_unlock(&parent->d_inode->i_mutex);
+	}
 	if (IS_ERR(dentry))
 		return PTR_ERR(dentry);
 	path->mnt = nd->path.mnt;
@@ -2287,6 +2364,7 @@ mountpoint_last(struct nameidata *nd, struct path *path)
 	}
 
 	mutex_lock(&dir->d_inode->i_mutex);
+	dir_lookup_lock(dir->d_inode, 0);
 	dentry = d_lookup(dir, &nd->last);
 	if (!dentry) {
 		/*
@@ -2297,16 +2375,19 @@ mountpoint_last(struct nameidata *nd, struct path *path)
 		dentry = d_alloc(dir, &nd->last);
 		if (!dentry) {
 			error = -ENOMEM;
+			dir_lookup_unlock(dir->d_inode);
 			mutex_unlock(&dir->d_inode->i_mutex);
 			goto out;
 		}
 		dentry = lookup_real(dir->d_inode, dentry, nd->flags);
 		error = PTR_ERR(dentry);
 		if (IS_ERR(dentry)) {
+			dir_lookup_unlock(dir->d_inode);
 			mutex_unlock(&dir->d_inode->i_mutex);
 			goto out;
 		}
 	}
+	dir_lookup_unlock(dir->d_inode);
 	mutex_unlock(&dir->d_inode->i_mutex);
 
 done:
@@ -2556,7 +2637,9 @@ int vfs_create(struct inode *dir, struct dentry *dentry, umode_t mode,
 	error = security_inode_create(dir, dentry, mode);
 	if (error)
 		return error;
+	dir_lookup_lock(dir, 0);
 	error = dir->i_op->create(dir, dentry, mode, want_excl);
+	dir_lookup_unlock(dir);
 	if (!error)
 		fsnotify_create(dir, dentry);
 	return error;
@@ -2854,26 +2937,34 @@ static int lookup_open(struct nameidata *nd, struct path *path,
 	bool need_lookup;
 
 	*opened &= ~FILE_CREATED;
+	dir_lookup_lock(dir_inode, 0);
 	dentry = lookup_dcache(&nd->last, dir, nd->flags, &need_lookup);
-	if (IS_ERR(dentry))
+	if (IS_ERR(dentry)) {
+		dir_lookup_unlock(dir_inode);
 		return PTR_ERR(dentry);
+	}
 
 	/* Cached positive dentry: will open in f_op->open */
-	if (!need_lookup && dentry->d_inode)
+	if (!need_lookup && dentry->d_inode) {
+		dir_lookup_unlock(dir_inode);
 		goto out_no_open;
+	}
 
 	if ((nd->flags & LOOKUP_OPEN) && dir_inode->i_op->atomic_open) {
-		return atomic_open(nd, dentry, path, file, op, got_write,
-				   need_lookup, opened);
+		error = atomic_open(nd, dentry, path, file, op, got_write,
+				    need_lookup, opened);
+		dir_lookup_unlock(dir_inode);
+		return error;
 	}
 
 	if (need_lookup) {
 		BUG_ON(dentry->d_inode);
 
 		dentry = lookup_real(dir_inode, dentry, nd->flags);
-		if (IS_ERR(dentry))
-			return PTR_ERR(dentry);
 	}
+	dir_lookup_unlock(dir_inode);
+	if (IS_ERR(dentry))
+		return PTR_ERR(dentry);
 
 	/* Negative dentry, just create the file */
 	if (!dentry->d_inode && (op->open_flag & O_CREAT)) {
@@ -3439,7 +3530,9 @@ int vfs_mknod(struct inode *dir, struct dentry *dentry, umode_t mode, dev_t dev)
 	if (error)
 		return error;
 
+	dir_lookup_lock(dir, 0);
 	error = dir->i_op->mknod(dir, dentry, mode, dev);
+	dir_lookup_unlock(dir);
 	if (!error)
 		fsnotify_create(dir, dentry);
 	return error;
@@ -3529,7 +3622,9 @@ int vfs_mkdir(struct inode *dir, struct dentry *dentry, umode_t mode)
 	if (max_links && dir->i_nlink >= max_links)
 		return -EMLINK;
 
+	dir_lookup_lock(dir, 0);
 	error = dir->i_op->mkdir(dir, dentry, mode);
+	dir_lookup_unlock(dir);
 	if (!error)
 		fsnotify_mkdir(dir, dentry);
 	return error;
@@ -3613,7 +3708,9 @@ int vfs_rmdir(struct inode *dir, struct dentry *dentry)
 		goto out;
 
 	shrink_dcache_parent(dentry);
+	dir_lookup_lock(dir, 0);
 	error = dir->i_op->rmdir(dir, dentry);
+	dir_lookup_unlock(dir);
 	if (error)
 		goto out;
 
@@ -3730,7 +3827,9 @@ int vfs_unlink(struct inode *dir, struct dentry *dentry, struct inode **delegate
 			error = try_break_deleg(target, delegated_inode);
 			if (error)
 				goto out;
+			dir_lookup_lock(dir, 0);
 			error = dir->i_op->unlink(dir, dentry);
+			dir_lookup_unlock(dir);
 			if (!error) {
 				dont_mount(dentry);
 				detach_mounts(dentry);
@@ -3857,7 +3956,9 @@ int vfs_symlink(struct inode *dir, struct dentry *dentry, const char *oldname)
 	if (error)
 		return error;
 
+	dir_lookup_lock(dir, 0);
 	error = dir->i_op->symlink(dir, dentry, oldname);
+	dir_lookup_unlock(dir);
 	if (!error)
 		fsnotify_create(dir, dentry);
 	return error;
@@ -3957,8 +4058,11 @@ int vfs_link(struct dentry *old_dentry, struct inode *dir, struct dentry *new_de
 		error = -EMLINK;
 	else {
 		error = try_break_deleg(inode, delegated_inode);
-		if (!error)
+		if (!error) {
+			dir_lookup_lock(dir, 0);
 			error = dir->i_op->link(old_dentry, dir, new_dentry);
+			dir_lookup_unlock(dir);
+		}
 	}
 
 	if (!error && (inode->i_state & I_LINKABLE)) {
@@ -4192,6 +4296,10 @@ int vfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		if (error)
 			goto out;
 	}
+	/* both directories are locked by our caller, any order will do */
+	dir_lookup_lock(old_dir, 0);
+	if (new_dir != old_dir)
+		dir_lookup_lock(new_dir, SINGLE_DEPTH_NESTING);
 	if (!old_dir->i_op->rename2) {
 		error = old_dir->i_op->rename(old_dir, old_dentry,
 					      new_dir, new_dentry);
@@ -4201,7 +4309,7 @@ int vfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 					       new_dir, new_dentry, flags);
 	}
 	if (error)
-		goto out;
+		goto out_unlock;
 
 	if (!(flags & RENAME_EXCHANGE) && target) {
 		if (is_dir)
@@ -4215,6 +4323,10 @@ int vfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 		else
 			d_exchange(old_dentry, new_dentry);
 	}
+out_unlock:
+	if (new_dir != old_dir)
+		dir_lookup_unlock(new_dir);
+	dir_lookup_unlock(old_dir);
 out:
 	if (!is_dir || (flags & RENAME_EXCHANGE))
 		unlock_two_nondirectories(source, target);
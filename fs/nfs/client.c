@@ -180,6 +180,7 @@ struct nfs_client *nfs_alloc_client(const struct nfs_client_initdata *cl_init)
 	clp->cl_rpcclient = ERR_PTR(-EINVAL);
 
 	clp->cl_proto = cl_init->proto;
+	clp->cl_nconnect = cl_init->nconnect;
 	clp->cl_net = get_net(cl_init->net);
 
 	cred = rpc_lookup_machine_cred("*");
@@ -596,6 +597,9 @@ int nfs_create_rpc_client(struct nfs_client *clp,
 		.authflavor	= flavor,
 	};
 
+	/* datagram transports gain nothing from extra sockets */
+	if (clp->cl_proto != XPRT_TRANSPORT_UDP)
+		args.nconnect = clp->cl_nconnect;
 	if (test_bit(NFS_CS_DISCRTRY, &clp->cl_flags))
 		args.flags |= RPC_CLNT_CREATE_DISCRTRY;
 	if (test_bit(NFS_CS_NO_RETRANS_TIMEOUT, &clp->cl_flags))
@@ -749,6 +753,7 @@ static int nfs_init_server(struct nfs_server *server,
 		.addrlen = data->nfs_server.addrlen,
 		.nfs_mod = nfs_mod,
 		.proto = data->nfs_server.protocol,
+		.nconnect = data->nconnect,
 		.net = data->net,
 	};
 	struct rpc_timeout timeparms;
@@ -639,11 +639,25 @@ int nfs_getattr(struct vfsmount *mnt, struct dentry *dentry, struct kstat *stat)
 {
 	struct inode *inode = dentry->d_inode;
 	int need_atime = NFS_I(inode)->cache_validity & NFS_INO_INVALID_ATIME;
+	u32 request_mask = stat->request_mask;
+	unsigned int query_flags = stat->query_flags & AT_STATX_SYNC_TYPE;
 	int err = 0;
 
 	trace_nfs_getattr_enter(inode);
+
+	/*
+	 * The type, inode number and device never change, so they can be
+	 * returned from the cache.  So can everything else if the caller
+	 * asked us not to talk to the server.
+	 */
+	if (query_flags == AT_STATX_DONT_SYNC ||
+	    !(request_mask & ~(STATX_TYPE | STATX_INO)))
+		goto out_fill;
+
 	/* Flush out writes to the server in order to update c/mtime.  */
-	if (S_ISREG(inode->i_mode)) {
+	if (S_ISREG(inode->i_mode) &&
+	    (request_mask & (STATX_MTIME | STATX_CTIME | STATX_SIZE |
+			     STATX_BLOCKS))) {
 		nfs_inode_dio_wait(inode);
 		err = filemap_write_and_wait(inode->i_mapping);
 		if (err)
@@ -660,16 +674,19 @@ int nfs_getattr(struct vfsmount *mnt, struct dentry *dentry, struct kstat *stat)
 	 *    no point in checking those.
 	 */
  	if ((mnt->mnt_flags & MNT_NOATIME) ||
- 	    ((mnt->mnt_flags & MNT_NODIRATIME) && S_ISDIR(inode->i_mode)))
+ 	    ((mnt->mnt_flags & MNT_NODIRATIME) && S_ISDIR(inode->i_mode)) ||
+	    !(request_mask & STATX_ATIME))
 		need_atime = 0;
 
-	if (need_atime || nfs_need_revalidate_inode(inode)) {
+	if (need_atime || query_flags == AT_STATX_FORCE_SYNC ||
+	    nfs_need_revalidate_inode(inode)) {
 		struct nfs_server *server = NFS_SERVER(inode);
 
 		if (server->caps & NFS_CAP_READDIRPLUS)
 			nfs_request_parent_use_readdirplus(dentry);
 		err = __nfs_revalidate_inode(server, inode);
 	}
+out_fill:
 	if (!err) {
 		generic_fillattr(inode, stat);
 		stat->ino = nfs_compat_user_ino64(NFS_FILEID(inode));
@@ -72,6 +72,7 @@ struct nfs_client_initdata {
 	struct nfs_subversion *nfs_mod;
 	int proto;
 	u32 minorversion;
+	unsigned int nconnect;
 	struct net *net;
 };
 
@@ -82,6 +83,7 @@ struct nfs_parsed_mount_data {
 	int			flags;
 	unsigned int		rsize, wsize;
 	unsigned int		timeo, retrans;
+	unsigned int		nconnect;
 	unsigned int		acregmin, acregmax,
 				acdirmin, acdirmax;
 	unsigned int		namlen;
@@ -103,6 +103,7 @@ enum {
 	Opt_mountport,
 	Opt_mountvers,
 	Opt_minorversion,
+	Opt_nconnect,
 
 	/* Mount options that take string arguments */
 	Opt_nfsvers,
@@ -168,6 +169,7 @@ static const match_table_t nfs_mount_option_tokens = {
 	{ Opt_mountport, "mountport=%s" },
 	{ Opt_mountvers, "mountvers=%s" },
 	{ Opt_minorversion, "minorversion=%s" },
+	{ Opt_nconnect, "nconnect=%s" },
 
 	{ Opt_nfsvers, "nfsvers=%s" },
 	{ Opt_nfsvers, "vers=%s" },
@@ -680,6 +682,8 @@ static void nfs_show_mount_options(struct seq_file *m, struct nfs_server *nfss,
 
 	seq_printf(m, ",timeo=%lu", 10U * nfss->client->cl_timeout->to_initval / HZ);
 	seq_printf(m, ",retrans=%u", nfss->client->cl_timeout->to_retries);
+	if (clp->cl_nconnect > 1)
+		seq_printf(m, ",nconnect=%u", clp->cl_nconnect);
 	seq_printf(m, ",sec=%s", nfs_pseudoflavour_to_name(nfss->client->cl_auth->au_flavor));
 
 	if (version != 4)
@@ -1357,6 +1361,12 @@ static int nfs_parse_mount_options(char *raw,
 				goto out_invalid_value;
 			mnt->retrans = option;
 			break;
+		case Opt_nconnect:
+			if (nfs_get_option_ul(args, &option) ||
+			    option < 1 || option > RPC_MAX_NCONNECT)
+				goto out_invalid_value;
+			mnt->nconnect = option;
+			break;
 		case Opt_acregmin:
 			if (nfs_get_option_ul(args, &option))
 				goto out_invalid_value;
@@ -82,5 +82,6 @@ void	nfsd_reply_cache_shutdown(void);
 int	nfsd_cache_lookup(struct svc_rqst *);
 void	nfsd_cache_update(struct svc_rqst *, int, __be32 *);
 int	nfsd_reply_cache_stats_open(struct inode *, struct file *);
+void	nfsd_reply_cache_counts(unsigned int *, unsigned int *, unsigned int *);
 
 #endif /* NFSCACHE_H */
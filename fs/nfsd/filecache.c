@@ -0,0 +1,439 @@
+/*
+ * Open file cache.
+ *
+ * NFSv2/3 READ, WRITE and COMMIT, and NFSv4 I/O with the anonymous
+ * stateid, carry no open state, so without this every such RPC does a
+ * dentry_open() and fput() of the file.  Instead, recently used files
+ * are kept open and closed again once they have been idle for a while,
+ * when memory gets tight, when the server shuts down, or when something
+ * needs the open gone: a lease being set on the inode, or nfsd itself
+ * unlinking or renaming over the file.
+ */
+
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/file.h>
+#include <linux/workqueue.h>
+#include <linux/sunrpc/svc_xprt.h>
+
+#include "nfsd.h"
+#include "vfs.h"
+#include "filecache.h"
+
+#define NFSDDBG_FACILITY	NFSDDBG_FH
+
+#define NFSD_FILE_HASH_BITS	12
+#define NFSD_FILE_HASH_SIZE	(1 << NFSD_FILE_HASH_BITS)
+
+/* how often the cache is scanned, and how long an idle file stays open */
+#define NFSD_FILE_GC_INTERVAL	(2 * HZ)
+
+/* above this many entries, all idle files are closed on each scan */
+#define NFSD_FILE_LRU_LIMIT	(NFSD_FILE_HASH_SIZE << 2)
+
+#define NFSD_FILE_MAY_MASK	(NFSD_MAY_READ | NFSD_MAY_WRITE)
+
+struct nfsd_fcache_bucket {
+	struct hlist_head	nfb_head;
+	spinlock_t		nfb_lock;
+} ____cacheline_aligned_in_smp;
+
+static struct nfsd_fcache_bucket	*nfsd_file_hashtbl;
+static struct kmem_cache		*nfsd_file_slab;
+static atomic_t				nfsd_file_count;
+
+static void nfsd_file_gc_worker(struct work_struct *work);
+static DECLARE_DELAYED_WORK(nfsd_file_gc_work, nfsd_file_gc_worker);
+
+static unsigned long nfsd_file_shrinker_count(struct shrinker *shrink,
+					      struct shrink_control *sc);
+static unsigned long nfsd_file_shrinker_scan(struct shrinker *shrink,
+					     struct shrink_control *sc);
+
+static struct shrinker nfsd_file_shrinker = {
+	.scan_objects = nfsd_file_shrinker_scan,
+	.count_objects = nfsd_file_shrinker_count,
+	.seeks = 1,
+};
+
+static unsigned int
+nfsd_file_hash(struct inode *inode)
+{
+	return hash_ptr(inode, NFSD_FILE_HASH_BITS);
+}
+
+static void
+nfsd_file_free(struct nfsd_file *nf)
+{
+	fput(nf->nf_file);
+	kmem_cache_free(nfsd_file_slab, nf);
+}
+
+void
+nfsd_file_put(struct nfsd_file *nf)
+{
+	if (atomic_dec_and_test(&nf->nf_ref))
+		nfsd_file_free(nf);
+}
+
+/*
+ * Take @nf out of the hash and queue it on @dispose, which then owns the
+ * hash table's reference.  Called with the bucket lock held.
+ */
+static void
+nfsd_file_unhash(struct nfsd_file *nf, struct list_head *dispose)
+{
+	if (!test_and_clear_bit(NFSD_FILE_HASHED, &nf->nf_flags))
+		return;
+	hlist_del_init(&nf->nf_node);
+	atomic_dec(&nfsd_file_count);
+	list_add(&nf->nf_dispose, dispose);
+}
+
+static void
+nfsd_file_dispose_list(struct list_head *dispose)
+{
+	struct nfsd_file *nf;
+
+	while (!list_empty(dispose)) {
+		nf = list_first_entry(dispose, struct nfsd_file, nf_dispose);
+		list_del(&nf->nf_dispose);
+		nfsd_file_put(nf);
+	}
+}
+
+/*
+ * Like nfsd_file_dispose_list(), but also wait for the final fput of
+ * the files, which is otherwise deferred when called from a kthread.
+ */
+static void
+nfsd_file_dispose_list_sync(struct list_head *dispose)
+{
+	if (list_empty(dispose))
+		return;
+	nfsd_file_dispose_list(dispose);
+	flush_delayed_fput();
+}
+
+/*
+ * Close the idle files in the cache.  With @all, every idle file goes;
+ * otherwise only those not used for at least @idle jiffies.  Returns
+ * the number of files closed.
+ */
+static unsigned long
+nfsd_file_prune(unsigned long idle, bool all, unsigned long nr_to_scan)
+{
+	LIST_HEAD(dispose);
+	struct nfsd_file *nf;
+	struct hlist_node *tmp;
+	unsigned long freed = 0;
+	unsigned int i;
+
+	for (i = 0; i < NFSD_FILE_HASH_SIZE && freed < nr_to_scan; i++) {
+		struct nfsd_fcache_bucket *b = &nfsd_file_hashtbl[i];
+
+		if (hlist_empty(&b->nfb_head))
+			continue;
+		spin_lock(&b->nfb_lock);
+		hlist_for_each_entry_safe(nf, tmp, &b->nfb_head, nf_node) {
+			/* only the hash table's reference left? */
+			if (atomic_read(&nf->nf_ref) > 1)
+				continue;
+			if (!all && time_before(jiffies, nf->nf_time + idle))
+				continue;
+			nfsd_file_unhash(nf, &dispose);
+			freed++;
+		}
+		spin_unlock(&b->nfb_lock);
+	}
+	nfsd_file_dispose_list(&dispose);
+	return freed;
+}
+
+static void
+nfsd_file_gc_worker(struct work_struct *work)
+{
+	bool all = atomic_read(&nfsd_file_count) > NFSD_FILE_LRU_LIMIT;
+
+	nfsd_file_prune(NFSD_FILE_GC_INTERVAL, all, ULONG_MAX);
+	if (atomic_read(&nfsd_file_count))
+		schedule_delayed_work(&nfsd_file_gc_work,
+				      NFSD_FILE_GC_INTERVAL);
+}
+
+static unsigned long
+nfsd_file_shrinker_count(struct shrinker *shrink, struct shrink_control *sc)
+{
+	return atomic_read(&nfsd_file_count);
+}
+
+static unsigned long
+nfsd_file_shrinker_scan(struct shrinker *shrink, struct shrink_control *sc)
+{
+	return nfsd_file_prune(0, true, sc->nr_to_scan);
+}
+
+static void
+__nfsd_file_close_inode(struct inode *inode, struct list_head *dispose)
+{
+	struct nfsd_fcache_bucket *b = &nfsd_file_hashtbl[nfsd_file_hash(inode)];
+	struct nfsd_file *nf;
+	struct hlist_node *tmp;
+
+	spin_lock(&b->nfb_lock);
+	hlist_for_each_entry_safe(nf, tmp, &b->nfb_head, nf_node) {
+		if (nf->nf_inode == inode)
+			nfsd_file_unhash(nf, dispose);
+	}
+	spin_unlock(&b->nfb_lock);
+}
+
+/**
+ * nfsd_file_close_inode - drop the cached opens of an inode
+ * @inode: inode of the file
+ *
+ * Files still in use by an RPC are closed when that RPC is done with them.
+ */
+void
+nfsd_file_close_inode(struct inode *inode)
+{
+	LIST_HEAD(dispose);
+
+	__nfsd_file_close_inode(inode, &dispose);
+	nfsd_file_dispose_list(&dispose);
+}
+
+/**
+ * nfsd_file_close_inode_sync - drop the cached opens of an inode, now
+ * @inode: inode of the file
+ *
+ * As nfsd_file_close_inode(), but the files not in use are really
+ * closed by the time this returns.
+ */
+void
+nfsd_file_close_inode_sync(struct inode *inode)
+{
+	LIST_HEAD(dispose);
+
+	__nfsd_file_close_inode(inode, &dispose);
+	nfsd_file_dispose_list_sync(&dispose);
+}
+
+/*
+ * A lease can't be granted while we hold the file open, so get out of
+ * the way of anyone setting one, nfsd's own delegations included.
+ */
+static int
+nfsd_file_lease_notifier_call(struct notifier_block *nb, unsigned long arg,
+			      void *data)
+{
+	struct file_lock *fl = data;
+
+	if (fl->fl_flags & FL_LEASE)
+		nfsd_file_close_inode_sync(file_inode(fl->fl_file));
+	return 0;
+}
+
+static struct notifier_block nfsd_file_lease_notifier = {
+	.notifier_call = nfsd_file_lease_notifier_call,
+};
+
+/**
+ * nfsd_file_cache_purge - close all the cached files of a namespace
+ * @net: network namespace being shut down, or NULL for all of them
+ */
+void
+nfsd_file_cache_purge(struct net *net)
+{
+	LIST_HEAD(dispose);
+	struct nfsd_file *nf;
+	struct hlist_node *tmp;
+	unsigned int i;
+
+	if (!nfsd_file_hashtbl)
+		return;
+
+	for (i = 0; i < NFSD_FILE_HASH_SIZE; i++) {
+		struct nfsd_fcache_bucket *b = &nfsd_file_hashtbl[i];
+
+		spin_lock(&b->nfb_lock);
+		hlist_for_each_entry_safe(nf, tmp, &b->nfb_head, nf_node) {
+			if (!net || nf->nf_net == net)
+				nfsd_file_unhash(nf, &dispose);
+		}
+		spin_unlock(&b->nfb_lock);
+	}
+	nfsd_file_dispose_list_sync(&dispose);
+}
+
+int
+nfsd_file_cache_init(void)
+{
+	unsigned int i;
+	int ret;
+
+	if (nfsd_file_hashtbl)
+		return 0;
+
+	nfsd_file_hashtbl = kcalloc(NFSD_FILE_HASH_SIZE,
+				    sizeof(*nfsd_file_hashtbl), GFP_KERNEL);
+	if (!nfsd_file_hashtbl)
+		return -ENOMEM;
+	for (i = 0; i < NFSD_FILE_HASH_SIZE; i++) {
+		INIT_HLIST_HEAD(&nfsd_file_hashtbl[i].nfb_head);
+		spin_lock_init(&nfsd_file_hashtbl[i].nfb_lock);
+	}
+
+	ret = -ENOMEM;
+	nfsd_file_slab = kmem_cache_create("nfsd_file",
+				sizeof(struct nfsd_file), 0, 0, NULL);
+	if (!nfsd_file_slab)
+		goto out_free_hash;
+
+	ret = register_shrinker(&nfsd_file_shrinker);
+	if (ret)
+		goto out_free_slab;
+
+	ret = lease_register_notifier(&nfsd_file_lease_notifier);
+	if (ret)
+		goto out_shrinker;
+
+	atomic_set(&nfsd_file_count, 0);
+	return 0;
+
+out_shrinker:
+	unregister_shrinker(&nfsd_file_shrinker);
+out_free_slab:
+	kmem_cache_destroy(nfsd_file_slab);
+	nfsd_file_slab = NULL;
+out_free_hash:
+	kfree(nfsd_file_hashtbl);
+	nfsd_file_hashtbl = NULL;
+	printk(KERN_ERR "nfsd: failed to allocate file cache\n");
+	return ret;
+}
+
+void
+nfsd_file_cache_shutdown(void)
+{
+	if (!nfsd_file_hashtbl)
+		return;
+
+	lease_unregister_notifier(&nfsd_file_lease_notifier);
+	unregister_shrinker(&nfsd_file_shrinker);
+	cancel_delayed_work_sync(&nfsd_file_gc_work);
+	nfsd_file_cache_purge(NULL);
+
+	kmem_cache_destroy(nfsd_file_slab);
+	nfsd_file_slab = NULL;
+	kfree(nfsd_file_hashtbl);
+	nfsd_file_hashtbl = NULL;
+}
+
+static struct nfsd_file *
+nfsd_file_find_locked(struct nfsd_fcache_bucket *b, struct inode *inode,
+		      unsigned char may, struct net *net)
+{
+	struct nfsd_file *nf;
+
+	hlist_for_each_entry(nf, &b->nfb_head, nf_node) {
+		if (nf->nf_inode == inode && nf->nf_may == may &&
+		    nf->nf_net == net) {
+			nf->nf_time = jiffies;
+			atomic_inc(&nf->nf_ref);
+			return nf;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * nfsd_file_acquire - get an open file for a stateless RPC
+ * @rqstp: the RPC
+ * @fhp: filehandle of a regular file
+ * @may_flags: NFSD_MAY_ flags, as for nfsd_open()
+ * @nfp: on success, the file to use; release it with nfsd_file_put()
+ *
+ * The filehandle is verified on every call, a cache hit or not.
+ */
+__be32
+nfsd_file_acquire(struct svc_rqst *rqstp, struct svc_fh *fhp,
+		  unsigned int may_flags, struct nfsd_file **nfp)
+{
+	struct net *net = SVC_NET(rqstp);
+	unsigned char may = may_flags & NFSD_FILE_MAY_MASK;
+	struct nfsd_fcache_bucket *b;
+	struct nfsd_file *nf, *new;
+	struct inode *inode;
+	struct file *file;
+	unsigned int hashval;
+	__be32 status;
+
+	status = fh_verify(rqstp, fhp, S_IFREG,
+			   may_flags | NFSD_MAY_OWNER_OVERRIDE);
+	if (status)
+		return status;
+
+	inode = d_inode(fhp->fh_dentry);
+	hashval = nfsd_file_hash(inode);
+	b = &nfsd_file_hashtbl[hashval];
+
+	spin_lock(&b->nfb_lock);
+	nf = nfsd_file_find_locked(b, inode, may, net);
+	spin_unlock(&b->nfb_lock);
+	if (nf)
+		goto found;
+
+	status = nfsd_open(rqstp, fhp, S_IFREG, may_flags, &file);
+	if (status)
+		return status;
+
+	new = kmem_cache_alloc(nfsd_file_slab, GFP_KERNEL);
+	if (!new) {
+		nfsd_close(file);
+		return nfserr_jukebox;
+	}
+	new->nf_file = file;
+	new->nf_inode = inode;
+	new->nf_net = net;
+	new->nf_flags = 1 << NFSD_FILE_HASHED;
+	new->nf_hashval = hashval;
+	new->nf_may = may;
+	atomic_set(&new->nf_ref, 2);	/* the hash table's and ours */
+	new->nf_time = jiffies;
+	INIT_LIST_HEAD(&new->nf_dispose);
+
+	spin_lock(&b->nfb_lock);
+	nf = nfsd_file_find_locked(b, inode, may, net);
+	if (!nf) {
+		hlist_add_head(&new->nf_node, &b->nfb_head);
+		spin_unlock(&b->nfb_lock);
+		/* the first entry starts the idle scan */
+		if (atomic_inc_return(&nfsd_file_count) == 1)
+			schedule_delayed_work(&nfsd_file_gc_work,
+					      NFSD_FILE_GC_INTERVAL);
+		*nfp = new;
+		return nfs_ok;
+	}
+	spin_unlock(&b->nfb_lock);
+
+	/* raced with another open of the same file: use that one */
+	nfsd_file_free(new);
+found:
+	/* the checks nfsd_open() makes on the inode at every open */
+	status = nfserr_perm;
+	if (IS_APPEND(inode) && (may_flags & NFSD_MAY_WRITE))
+		goto out_put;
+	if (mandatory_lock(inode))
+		goto out_put;
+	status = nfserrno(nfsd_open_break_lease(inode, may_flags));
+	if (status)
+		goto out_put;
+
+	*nfp = nf;
+	return nfs_ok;
+
+out_put:
+	nfsd_file_put(nf);
+	return status;
+}
@@ -0,0 +1,36 @@
+#ifndef _FS_NFSD_FILECACHE_H
+#define _FS_NFSD_FILECACHE_H
+
+#include <linux/fs.h>
+
+/*
+ * An open struct file kept around between RPCs, so that stateless READ,
+ * WRITE and COMMIT don't have to open and close the file each time.
+ *
+ * Entries are keyed on (net, inode, access).  The hash table holds one
+ * reference; each user takes another for the duration of the RPC.
+ */
+struct nfsd_file {
+	struct hlist_node	nf_node;
+	struct list_head	nf_dispose;
+	struct file		*nf_file;
+	struct inode		*nf_inode;
+	struct net		*nf_net;
+	unsigned long		nf_flags;
+#define NFSD_FILE_HASHED	(0)
+	unsigned int		nf_hashval;
+	unsigned char		nf_may;
+	atomic_t		nf_ref;
+	unsigned long		nf_time;	/* jiffies of last use */
+};
+
+int nfsd_file_cache_init(void);
+void nfsd_file_cache_shutdown(void);
+void nfsd_file_cache_purge(struct net *net);
+void nfsd_file_close_inode(struct inode *inode);
+void nfsd_file_close_inode_sync(struct inode *inode);
+__be32 nfsd_file_acquire(struct svc_rqst *rqstp, struct svc_fh *fhp,
+			 unsigned int may_flags, struct nfsd_file **nfp);
+void nfsd_file_put(struct nfsd_file *nf);
+
+#endif /* _FS_NFSD_FILECACHE_H */
@@ -48,6 +48,7 @@
 #include "cache.h"
 #include "netns.h"
 #include "pnfs.h"
+#include "filecache.h"
 
 #ifdef CONFIG_NFSD_V4_SECURITY_LABEL
 #include <linux/security.h>
@@ -3423,7 +3424,7 @@ nfsd4_encode_read(struct nfsd4_compoundres *resp, __be32 nfserr,
 	struct xdr_stream *xdr = &resp->xdr;
 	struct file *file = read->rd_filp;
 	int starting_len = xdr->buf->len;
-	struct raparms *ra;
+	struct nfsd_file *nf = NULL;
 	__be32 *p;
 	__be32 err;
 
@@ -3446,10 +3447,11 @@ nfsd4_encode_read(struct nfsd4_compoundres *resp, __be32 nfserr,
 	maxcount = min_t(unsigned long, maxcount, read->rd_length);
 
 	if (!read->rd_filp) {
-		err = nfsd_get_tmp_read_open(resp->rqstp, read->rd_fhp,
-						&file, &ra);
+		err = nfsd_file_acquire(resp->rqstp, read->rd_fhp,
+					NFSD_MAY_READ, &nf);
 		if (err)
 			goto err_truncate;
+		file = nf->nf_file;
 	}
 
 	if (file->f_op->splice_read && test_bit(RQ_SPLICE_OK, &resp->rqstp->rq_flags))
@@ -3458,7 +3460,7 @@ nfsd4_encode_read(struct nfsd4_compoundres *resp, __be32 nfserr,
 		err = nfsd4_encode_readv(resp, read, file, maxcount);
 
 	if (!read->rd_filp)
-		nfsd_put_tmp_read_open(file, ra);
+		nfsd_file_put(nf);
 
 err_truncate:
 	if (err)
@@ -13,6 +13,8 @@
 #include <linux/highmem.h>
 #include <linux/log2.h>
 #include <linux/hash.h>
+#include <linux/percpu.h>
+#include <linux/percpu_counter.h>
 #include <net/checksum.h>
 
 #include "nfsd.h"
@@ -27,10 +29,17 @@
  */
 #define TARGET_BUCKET_SIZE	64
 
+/*
+ * Don't go below this many buckets per possible CPU: every nfsd thread
+ * running a non-idempotent call holds a bucket lock, and their number
+ * scales with the CPUs rather than with memory.
+ */
+#define MIN_BUCKETS_PER_CPU	64
+
 struct nfsd_drc_bucket {
 	struct list_head lru_head;
 	spinlock_t cache_lock;
-};
+} ____cacheline_aligned_in_smp;
 
 static struct nfsd_drc_bucket	*drc_hashtbl;
 static struct kmem_cache	*drc_slab;
@@ -43,18 +52,42 @@ static unsigned int		maskbits;
 static unsigned int		drc_hashsize;
 
 /*
- * Stats and other tracking of on the duplicate reply cache. All of these and
- * the "rc" fields in nfsdstats are protected by the cache_lock
+ * Stats and other tracking of on the duplicate reply cache.  Those
+ * touched on every call are per-CPU, so that lookups in different
+ * buckets don't share a cacheline; they are only summed when read.
  */
 
 /* total number of entries */
-static atomic_t			num_drc_entries;
+static struct percpu_counter	num_drc_entries;
+
+struct nfsd_drc_stats {
+	unsigned int	hits;
+	unsigned int	misses;
+	unsigned int	nocache;
+	/* cache misses due only to checksum comparison failures */
+	unsigned int	payload_misses;
+	/* amount of memory (in bytes) currently consumed by the DRC */
+	long		mem_usage;
+};
 
-/* cache misses due only to checksum comparison failures */
-static unsigned int		payload_misses;
+static DEFINE_PER_CPU(struct nfsd_drc_stats, drc_stats);
 
-/* amount of memory (in bytes) currently consumed by the DRC */
-static unsigned int		drc_mem_usage;
+#define drc_stats_add(field, n)	this_cpu_add(drc_stats.field, n)
+
+#define drc_stats_sum(field)						\
+({									\
+	typeof(drc_stats.field) __sum = 0;				\
+	int __cpu;							\
+									\
+	for_each_possible_cpu(__cpu)					\
+		__sum += per_cpu(drc_stats, __cpu).field;		\
+	__sum;								\
+})
+
+/*
+ * The chain length stats are protected by nothing; they are only a hint,
+ * and written only when they change.
+ */
 
 /* longest hash chain seen */
 static unsigned int		longest_chain;
@@ -117,7 +150,8 @@ nfsd_cache_size_limit(void)
 static unsigned int
 nfsd_hashsize(unsigned int limit)
 {
-	return roundup_pow_of_two(limit / TARGET_BUCKET_SIZE);
+	return roundup_pow_of_two(max(limit / TARGET_BUCKET_SIZE,
+				      num_possible_cpus() * MIN_BUCKETS_PER_CPU));
 }
 
 static u32
@@ -144,12 +178,12 @@ static void
 nfsd_reply_cache_free_locked(struct svc_cacherep *rp)
 {
 	if (rp->c_type == RC_REPLBUFF && rp->c_replvec.iov_base) {
-		drc_mem_usage -= rp->c_replvec.iov_len;
+		drc_stats_add(mem_usage, -(long)rp->c_replvec.iov_len);
 		kfree(rp->c_replvec.iov_base);
 	}
 	list_del(&rp->c_lru);
-	atomic_dec(&num_drc_entries);
-	drc_mem_usage -= sizeof(*rp);
+	percpu_counter_dec(&num_drc_entries);
+	drc_stats_add(mem_usage, -(long)sizeof(*rp));
 	kmem_cache_free(drc_slab, rp);
 }
 
@@ -168,14 +202,19 @@ int nfsd_reply_cache_init(void)
 	int status = 0;
 
 	max_drc_entries = nfsd_cache_size_limit();
-	atomic_set(&num_drc_entries, 0);
 	hashsize = nfsd_hashsize(max_drc_entries);
 	maskbits = ilog2(hashsize);
 
-	status = register_shrinker(&nfsd_reply_cache_shrinker);
+	status = percpu_counter_init(&num_drc_entries, 0, GFP_KERNEL);
 	if (status)
 		return status;
 
+	status = register_shrinker(&nfsd_reply_cache_shrinker);
+	if (status) {
+		percpu_counter_destroy(&num_drc_entries);
+		return status;
+	}
+
 	drc_slab = kmem_cache_create("nfsd_drc", sizeof(struct svc_cacherep),
 					0, 0, NULL);
 	if (!drc_slab)
@@ -221,6 +260,8 @@ void nfsd_reply_cache_shutdown(void)
 		kmem_cache_destroy(drc_slab);
 		drc_slab = NULL;
 	}
+
+	percpu_counter_destroy(&num_drc_entries);
 }
 
 /*
@@ -232,7 +273,9 @@ lru_put_end(struct nfsd_drc_bucket *b, struct svc_cacherep *rp)
 {
 	rp->c_timestamp = jiffies;
 	list_move_tail(&rp->c_lru, &b->lru_head);
-	schedule_delayed_work(&cache_cleaner, RC_EXPIRE);
+	/* test first, to keep every call off the work's cacheline */
+	if (!delayed_work_pending(&cache_cleaner))
+		schedule_delayed_work(&cache_cleaner, RC_EXPIRE);
 }
 
 static long
@@ -248,7 +291,7 @@ prune_bucket(struct nfsd_drc_bucket *b)
 		 */
 		if (rp->c_state == RC_INPROG)
 			continue;
-		if (atomic_read(&num_drc_entries) <= max_drc_entries &&
+		if (percpu_counter_read(&num_drc_entries) <= max_drc_entries &&
 		    time_before(jiffies, rp->c_timestamp + RC_EXPIRE))
 			break;
 		nfsd_reply_cache_free_locked(rp);
@@ -298,7 +341,7 @@ cache_cleaner_func(struct work_struct *unused)
 static unsigned long
 nfsd_reply_cache_count(struct shrinker *shrink, struct shrink_control *sc)
 {
-	return atomic_read(&num_drc_entries);
+	return percpu_counter_read_positive(&num_drc_entries);
 }
 
 static unsigned long
@@ -347,7 +390,7 @@ nfsd_cache_match(struct svc_rqst *rqstp, __wsum csum, struct svc_cacherep *rp)
 		return false;
 	/* compare checksum of NFS data */
 	if (csum != rp->c_csum) {
-		++payload_misses;
+		drc_stats_add(payload_misses, 1);
 		return false;
 	}
 
@@ -387,12 +430,13 @@ nfsd_cache_search(struct nfsd_drc_bucket *b, struct svc_rqst *rqstp,
 	/* tally hash chain length stats */
 	if (entries > longest_chain) {
 		longest_chain = entries;
-		longest_chain_cachesize = atomic_read(&num_drc_entries);
+		longest_chain_cachesize = percpu_counter_read_positive(&num_drc_entries);
 	} else if (entries == longest_chain) {
 		/* prefer to keep the smallest cachesize possible here */
-		longest_chain_cachesize = min_t(unsigned int,
-				longest_chain_cachesize,
-				atomic_read(&num_drc_entries));
+		unsigned int size = percpu_counter_read_positive(&num_drc_entries);
+
+		if (size < longest_chain_cachesize)
+			longest_chain_cachesize = size;
 	}
 
 	return ret;
@@ -422,7 +466,7 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 
 	rqstp->rq_cacherep = NULL;
 	if (type == RC_NOCACHE) {
-		nfsdstats.rcnocache++;
+		drc_stats_add(nocache, 1);
 		return rtn;
 	}
 
@@ -435,8 +479,8 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 	rp = nfsd_reply_cache_alloc();
 	spin_lock(&b->cache_lock);
 	if (likely(rp)) {
-		atomic_inc(&num_drc_entries);
-		drc_mem_usage += sizeof(*rp);
+		percpu_counter_inc(&num_drc_entries);
+		drc_stats_add(mem_usage, sizeof(*rp));
 	}
 
 	/* go ahead and prune the cache */
@@ -455,7 +499,7 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 		goto out;
 	}
 
-	nfsdstats.rcmisses++;
+	drc_stats_add(misses, 1);
 	rqstp->rq_cacherep = rp;
 	rp->c_state = RC_INPROG;
 	rp->c_xid = xid;
@@ -471,7 +515,7 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 
 	/* release any buffer */
 	if (rp->c_type == RC_REPLBUFF) {
-		drc_mem_usage -= rp->c_replvec.iov_len;
+		drc_stats_add(mem_usage, -(long)rp->c_replvec.iov_len);
 		kfree(rp->c_replvec.iov_base);
 		rp->c_replvec.iov_base = NULL;
 	}
@@ -481,7 +525,7 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 	return rtn;
 
 found_entry:
-	nfsdstats.rchits++;
+	drc_stats_add(hits, 1);
 	/* We found a matching entry which is either in progress or done. */
 	age = jiffies - rp->c_timestamp;
 	lru_put_end(b, rp);
@@ -581,7 +625,7 @@ nfsd_cache_update(struct svc_rqst *rqstp, int cachetype, __be32 *statp)
 		return;
 	}
 	spin_lock(&b->cache_lock);
-	drc_mem_usage += bufsize;
+	drc_stats_add(mem_usage, bufsize);
 	lru_put_end(b, rp);
 	rp->c_secure = test_bit(RQ_SECURE, &rqstp->rq_flags);
 	rp->c_type = cachetype;
@@ -618,14 +662,14 @@ nfsd_cache_append(struct svc_rqst *rqstp, struct kvec *data)
 static int nfsd_reply_cache_stats_show(struct seq_file *m, void *v)
 {
 	seq_printf(m, "max entries:           %u\n", max_drc_entries);
-	seq_printf(m, "num entries:           %u\n",
-			atomic_read(&num_drc_entries));
+	seq_printf(m, "num entries:           %lld\n",
+			percpu_counter_sum_positive(&num_drc_entries));
 	seq_printf(m, "hash buckets:          %u\n", 1 << maskbits);
-	seq_printf(m, "mem usage:             %u\n", drc_mem_usage);
-	seq_printf(m, "cache hits:            %u\n", nfsdstats.rchits);
-	seq_printf(m, "cache misses:          %u\n", nfsdstats.rcmisses);
-	seq_printf(m, "not cached:            %u\n", nfsdstats.rcnocache);
-	seq_printf(m, "payload misses:        %u\n", payload_misses);
+	seq_printf(m, "mem usage:             %ld\n", drc_stats_sum(mem_usage));
+	seq_printf(m, "cache hits:            %u\n", drc_stats_sum(hits));
+	seq_printf(m, "cache misses:          %u\n", drc_stats_sum(misses));
+	seq_printf(m, "not cached:            %u\n", drc_stats_sum(nocache));
+	seq_printf(m, "payload misses:        %u\n", drc_stats_sum(payload_misses));
 	seq_printf(m, "longest chain len:     %u\n", longest_chain);
 	seq_printf(m, "cachesize at longest:  %u\n", longest_chain_cachesize);
 	return 0;
@@ -635,3 +679,12 @@ int nfsd_reply_cache_stats_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, nfsd_reply_cache_stats_show, NULL);
 }
+
+/* For the "rc" line of /proc/net/rpc/nfsd */
+void nfsd_reply_cache_counts(unsigned int *hits, unsigned int *misses,
+			     unsigned int *nocache)
+{
+	*hits = drc_stats_sum(hits);
+	*misses = drc_stats_sum(misses);
+	*nocache = drc_stats_sum(nocache);
+}
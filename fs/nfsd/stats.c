@@ -27,6 +27,7 @@
 #include <net/net_namespace.h>
 
 #include "nfsd.h"
+#include "cache.h"
 
 struct nfsd_stats	nfsdstats;
 struct svc_stat		nfsd_svcstats = {
@@ -35,12 +36,14 @@ struct svc_stat		nfsd_svcstats = {
 
 static int nfsd_proc_show(struct seq_file *seq, void *v)
 {
+	unsigned int rchits, rcmisses, rcnocache;
 	int i;
 
+	nfsd_reply_cache_counts(&rchits, &rcmisses, &rcnocache);
 	seq_printf(seq, "rc %u %u %u\nfh %u %u %u %u %u\nio %u %u\n",
-		      nfsdstats.rchits,
-		      nfsdstats.rcmisses,
-		      nfsdstats.rcnocache,
+		      rchits,
+		      rcmisses,
+		      rcnocache,
 		      nfsdstats.fh_stale,
 		      nfsdstats.fh_lookup,
 		      nfsdstats.fh_anon,
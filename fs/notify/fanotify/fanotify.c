@@ -1,6 +1,7 @@
 #include <linux/fanotify.h>
 #include <linux/fdtable.h>
 #include <linux/fsnotify_backend.h>
+#include <linux/hash.h>
 #include <linux/init.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h> /* UINT_MAX */
@@ -27,13 +28,27 @@ static bool should_merge(struct fsnotify_event *old_fsn,
 	return false;
 }
 
-/* and the list better be locked by something too! */
-static int fanotify_merge(struct list_head *list, struct fsnotify_event *event)
+static unsigned int fanotify_event_hash(struct fsnotify_event *fse)
 {
-	struct fsnotify_event *test_event;
-	bool do_merge = false;
+	struct fanotify_event_info *event = FANOTIFY_E(fse);
 
-	pr_debug("%s: list=%p event=%p\n", __func__, list, event);
+	return hash_long((unsigned long)fse->inode ^
+			 (unsigned long)event->path.dentry ^
+			 (unsigned long)event->tgid, FANOTIFY_MERGE_HASH_BITS);
+}
+
+/*
+ * Queued events are hashed by the object and process they are about, so
+ * that finding one to merge with does not mean walking the whole queue.
+ * Called with the notification_mutex held.
+ */
+static int fanotify_merge(struct fsnotify_group *group,
+			  struct fsnotify_event *event)
+{
+	struct fanotify_event_info *test_event;
+	struct hlist_head *hlist;
+
+	pr_debug("%s: group=%p event=%p\n", __func__, group, event);
 
 #ifdef CONFIG_FANOTIFY_ACCESS_PERMISSIONS
 	/*
@@ -45,18 +60,18 @@ static int fanotify_merge(struct list_head *list, struct fsnotify_event *event)
 		return 0;
 #endif
 
-	list_for_each_entry_reverse(test_event, list, list) {
-		if (should_merge(test_event, event)) {
-			do_merge = true;
-			break;
+	hlist = &group->fanotify_data.merge_hash[fanotify_event_hash(event)];
+	/* newest first, as the queue used to be searched */
+	hlist_for_each_entry(test_event, hlist, merge_list) {
+		if (should_merge(&test_event->fse, event)) {
+			test_event->fse.mask |= event->mask;
+			return 1;
 		}
 	}
 
-	if (!do_merge)
-		return 0;
-
-	test_event->mask |= event->mask;
-	return 1;
+	/* the event is going to be queued */
+	hlist_add_head(&FANOTIFY_E(event)->merge_list, hlist);
+	return 0;
 }
 
 #ifdef CONFIG_FANOTIFY_ACCESS_PERMISSIONS
@@ -173,6 +188,7 @@ struct fanotify_event_info *fanotify_alloc_event(struct inode *inode, u32 mask,
 		return NULL;
 init: __maybe_unused
 	fsnotify_init_event(&event->fse, inode, mask);
+	INIT_HLIST_NODE(&event->merge_list);
 	event->tgid = get_pid(task_tgid(current));
 	if (path) {
 		event->path = *path;
@@ -244,6 +260,7 @@ static void fanotify_free_group_priv(struct fsnotify_group *group)
 	user = group->fanotify_data.user;
 	atomic_dec(&user->fanotify_listeners);
 	free_uid(user);
+	kfree(group->fanotify_data.merge_hash);
 }
 
 static void fanotify_free_event(struct fsnotify_event *fsn_event)
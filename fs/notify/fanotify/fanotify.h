@@ -18,8 +18,13 @@ struct fanotify_event_info {
 	 */
 	struct path path;
 	struct pid *tgid;
+	/* in group->fanotify_data.merge_hash while queued */
+	struct hlist_node merge_list;
 };
 
+#define FANOTIFY_MERGE_HASH_BITS	7
+#define FANOTIFY_MERGE_HASH_SIZE	(1 << FANOTIFY_MERGE_HASH_BITS)
+
 #ifdef CONFIG_FANOTIFY_ACCESS_PERMISSIONS
 /*
  * Structure for permission fanotify events. It gets allocated and freed in
@@ -46,5 +51,11 @@ static inline struct fanotify_event_info *FANOTIFY_E(struct fsnotify_event *fse)
 	return container_of(fse, struct fanotify_event_info, fse);
 }
 
+/* Called with the notification_mutex held when the event is dequeued */
+static inline void fanotify_unhash_event(struct fsnotify_event *fse)
+{
+	hlist_del_init(&FANOTIFY_E(fse)->merge_list);
+}
+
 struct fanotify_event_info *fanotify_alloc_event(struct inode *inode, u32 mask,
 						 struct path *path);
@@ -83,10 +83,14 @@ void fsnotify_destroy_event(struct fsnotify_group *group,
  * event off the queue to deal with.  The function returns 0 if the event was
  * added to the queue, 1 if the event was merged with some other queued event,
  * 2 if the queue of events has overflown.
+ *
+ * @merge is called with the notification_mutex held, also when the queue is
+ * empty, so that a group which indexes its queued events can add @event to
+ * its index when it is not merged.
  */
 int fsnotify_add_event(struct fsnotify_group *group,
 		       struct fsnotify_event *event,
-		       int (*merge)(struct list_head *,
+		       int (*merge)(struct fsnotify_group *,
 				    struct fsnotify_event *))
 {
 	int ret = 0;
@@ -107,8 +111,8 @@ int fsnotify_add_event(struct fsnotify_group *group,
 		goto queue;
 	}
 
-	if (!list_empty(list) && merge) {
-		ret = merge(list, event);
+	if (merge) {
+		ret = merge(group, event);
 		if (ret) {
 			mutex_unlock(&group->notification_mutex);
 			return ret;
@@ -196,7 +196,7 @@ int ovl_set_attr(struct dentry *upperdentry, struct kstat *stat)
 static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 			      struct dentry *dentry, struct path *lowerpath,
 			      struct kstat *stat, struct iattr *attr,
-			      const char *link)
+			      const char *link, bool metacopy)
 {
 	struct inode *wdir = workdir->d_inode;
 	struct inode *udir = upperdir->d_inode;
@@ -223,7 +223,7 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out2;
 
-	if (S_ISREG(stat->mode)) {
+	if (S_ISREG(stat->mode) && !metacopy) {
 		struct path upperpath;
 		ovl_path_upper(dentry, &upperpath);
 		BUG_ON(upperpath.dentry != NULL);
@@ -238,8 +238,23 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out_cleanup;
 
+	if (metacopy) {
+		err = ovl_do_setxattr(newdentry, OVL_XATTR_METACOPY, "y", 1, 0);
+		if (err)
+			goto out_cleanup;
+	}
+
 	mutex_lock(&newdentry->d_inode->i_mutex);
-	err = ovl_set_attr(newdentry, stat);
+	if (metacopy) {
+		/* sparse, so that stat reports the size of the lower data */
+		struct iattr sattr = {
+			.ia_valid = ATTR_SIZE,
+			.ia_size = stat->size,
+		};
+		err = notify_change(newdentry, &sattr, NULL);
+	}
+	if (!err)
+		err = ovl_set_attr(newdentry, stat);
 	if (!err && attr)
 		err = notify_change(newdentry, attr, NULL);
 	mutex_unlock(&newdentry->d_inode->i_mutex);
@@ -250,6 +265,8 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out_cleanup;
 
+	if (metacopy)
+		ovl_dentry_set_metacopy(dentry, true);
 	ovl_dentry_update(dentry, newdentry);
 	newdentry = NULL;
 
@@ -270,6 +287,47 @@ out_cleanup:
 	goto out;
 }
 
+/*
+ * Complete a metadata-only copy up: fill the upper file with the lower
+ * data and drop the metacopy mark.  A zero @stat->size means the caller
+ * is about to truncate the file, so there's nothing to copy.
+ */
+static int ovl_copy_up_meta_data(struct dentry *dentry, struct path *lowerpath,
+				 struct kstat *stat)
+{
+	struct path upperpath;
+	struct kstat ustat;
+	int err;
+
+	ovl_path_upper(dentry, &upperpath);
+	err = vfs_getattr(&upperpath, &ustat);
+	if (err)
+		return err;
+
+	err = ovl_copy_up_data(lowerpath, &upperpath, stat->size);
+	if (err)
+		return err;
+
+	mutex_lock(&upperpath.dentry->d_inode->i_mutex);
+	if (!stat->size) {
+		struct iattr attr = {
+			.ia_valid = ATTR_SIZE,
+			.ia_size = 0,
+		};
+		err = notify_change(upperpath.dentry, &attr, NULL);
+	}
+	/* writing the data must not change what the user has set */
+	if (!err)
+		err = ovl_set_timestamps(upperpath.dentry, &ustat);
+	mutex_unlock(&upperpath.dentry->d_inode->i_mutex);
+	if (!err)
+		err = ovl_do_removexattr(upperpath.dentry, OVL_XATTR_METACOPY);
+	if (!err)
+		ovl_dentry_set_metacopy(dentry, false);
+
+	return err;
+}
+
 /*
  * Copy up a single dentry
  *
@@ -287,7 +345,7 @@ out_cleanup:
  */
 int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 		    struct path *lowerpath, struct kstat *stat,
-		    struct iattr *attr)
+		    struct iattr *attr, bool metacopy)
 {
 	struct dentry *workdir = ovl_workdir(dentry);
 	int err;
@@ -342,10 +400,12 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 	}
 	upperdentry = ovl_dentry_upper(dentry);
 	if (upperdentry) {
-		unlock_rename(workdir, upperdir);
 		err = 0;
+		if (!metacopy && ovl_dentry_is_metacopy(dentry))
+			err = ovl_copy_up_meta_data(dentry, lowerpath, stat);
+		unlock_rename(workdir, upperdir);
 		/* Raced with another copy-up?  Do the setattr here */
-		if (attr) {
+		if (!err && attr) {
 			mutex_lock(&upperdentry->d_inode->i_mutex);
 			err = notify_change(upperdentry, attr, NULL);
 			mutex_unlock(&upperdentry->d_inode->i_mutex);
@@ -353,8 +413,11 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 		goto out_put_cred;
 	}
 
+	/* only worth it when there is data to skip */
+	metacopy = metacopy && S_ISREG(stat->mode) && stat->size &&
+		   ovl_can_metacopy(dentry);
 	err = ovl_copy_up_locked(workdir, upperdir, dentry, lowerpath,
-				 stat, attr, link);
+				 stat, attr, link, metacopy);
 	if (!err) {
 		/* Restore timestamps on parent (best effort) */
 		ovl_set_timestamps(upperdir, &pstat);
@@ -384,7 +447,7 @@ int ovl_copy_up(struct dentry *dentry)
 		struct kstat stat;
 		enum ovl_path_type type = ovl_path_type(dentry);
 
-		if (OVL_TYPE_UPPER(type))
+		if (OVL_TYPE_UPPER(type) && !ovl_dentry_is_metacopy(dentry))
 			break;
 
 		next = dget(dentry);
@@ -403,7 +466,8 @@ int ovl_copy_up(struct dentry *dentry)
 		ovl_path_lower(next, &lowerpath);
 		err = vfs_getattr(&lowerpath, &stat);
 		if (!err)
-			err = ovl_copy_up_one(parent, next, &lowerpath, &stat, NULL);
+			err = ovl_copy_up_one(parent, next, &lowerpath, &stat,
+					      NULL, false);
 
 		dput(parent);
 		dput(next);
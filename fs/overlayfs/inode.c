@@ -19,6 +19,7 @@ static int ovl_copy_up_last(struct dentry *dentry, struct iattr *attr,
 	struct dentry *parent;
 	struct kstat stat;
 	struct path lowerpath;
+	bool metacopy;
 
 	parent = dget_parent(dentry);
 	err = ovl_copy_up(parent);
@@ -33,7 +34,10 @@ static int ovl_copy_up_last(struct dentry *dentry, struct iattr *attr,
 	if (no_data)
 		stat.size = 0;
 
-	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat, attr);
+	/* the data can wait, unless the file is being truncated */
+	metacopy = !no_data && !(attr && (attr->ia_valid & ATTR_SIZE));
+	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat, attr,
+			      metacopy);
 
 out_dput_parent:
 	dput(parent);
@@ -49,6 +53,13 @@ int ovl_setattr(struct dentry *dentry, struct iattr *attr)
 	if (err)
 		goto out;
 
+	/* truncating a metadata-only copy needs the data in place first */
+	if ((attr->ia_valid & ATTR_SIZE) && ovl_dentry_is_metacopy(dentry)) {
+		err = ovl_copy_up(dentry);
+		if (err)
+			goto out_drop_write;
+	}
+
 	upperdentry = ovl_dentry_upper(dentry);
 	if (upperdentry) {
 		mutex_lock(&upperdentry->d_inode->i_mutex);
@@ -57,6 +68,7 @@ int ovl_setattr(struct dentry *dentry, struct iattr *attr)
 	} else {
 		err = ovl_copy_up_last(dentry, attr, false);
 	}
+out_drop_write:
 	ovl_drop_write(dentry);
 out:
 	return err;
@@ -66,9 +78,20 @@ static int ovl_getattr(struct vfsmount *mnt, struct dentry *dentry,
 			 struct kstat *stat)
 {
 	struct path realpath;
+	struct kstat lowerstat;
+	int err;
 
 	ovl_path_real(dentry, &realpath);
-	return vfs_getattr(&realpath, stat);
+	err = vfs_getattr(&realpath, stat);
+	if (err || !ovl_dentry_is_metacopy(dentry))
+		return err;
+
+	/* the data, and the space it takes, is still in the lower layer */
+	ovl_path_lower(dentry, &realpath);
+	err = vfs_getattr(&realpath, &lowerstat);
+	if (!err)
+		stat->blocks = lowerstat.blocks;
+	return err;
 }
 
 int ovl_permission(struct inode *inode, int mask)
@@ -222,9 +245,11 @@ int ovl_setxattr(struct dentry *dentry, const char *name,
 	if (ovl_is_private_xattr(name))
 		goto out_drop_write;
 
-	err = ovl_copy_up(dentry);
-	if (err)
-		goto out_drop_write;
+	if (!ovl_dentry_upper(dentry)) {
+		err = ovl_copy_up_last(dentry, NULL, false);
+		if (err)
+			goto out_drop_write;
+	}
 
 	upperdentry = ovl_dentry_upper(dentry);
 	err = vfs_setxattr(upperdentry, name, value, size, flags);
@@ -239,7 +264,8 @@ static bool ovl_need_xattr_filter(struct dentry *dentry,
 				  enum ovl_path_type type)
 {
 	if ((type & (__OVL_PATH_PURE | __OVL_PATH_UPPER)) == __OVL_PATH_UPPER)
-		return S_ISDIR(dentry->d_inode->i_mode);
+		return S_ISDIR(dentry->d_inode->i_mode) ||
+		       S_ISREG(dentry->d_inode->i_mode);
 	else
 		return false;
 }
@@ -307,7 +333,7 @@ int ovl_removexattr(struct dentry *dentry, const char *name)
 		if (err < 0)
 			goto out_drop_write;
 
-		err = ovl_copy_up(dentry);
+		err = ovl_copy_up_last(dentry, NULL, false);
 		if (err)
 			goto out_drop_write;
 
@@ -345,6 +371,11 @@ static int ovl_dentry_open(struct dentry *dentry, struct file *file,
 	bool want_write = false;
 
 	type = ovl_path_real(dentry, &realpath);
+	if (ovl_dentry_is_metacopy(dentry)) {
+		/* only the metadata has been copied up so far */
+		ovl_path_lower(dentry, &realpath);
+		type &= ~__OVL_PATH_UPPER;
+	}
 	if (ovl_open_need_copy_up(file->f_flags, type, realpath.dentry)) {
 		want_write = true;
 		err = ovl_want_write(dentry);
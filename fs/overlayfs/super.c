@@ -30,6 +30,7 @@ struct ovl_config {
 	char *lowerdir;
 	char *upperdir;
 	char *workdir;
+	bool metacopy;
 };
 
 /* private information held for overlayfs's superblock */
@@ -56,6 +57,7 @@ struct ovl_entry {
 		};
 		struct rcu_head rcu;
 	};
+	bool metacopy;	/* upper has metadata only, data is in lowerstack[0] */
 	unsigned numlower;
 	struct path lowerstack[];
 };
@@ -205,6 +207,30 @@ void ovl_dentry_set_opaque(struct dentry *dentry, bool opaque)
 	oe->opaque = opaque;
 }
 
+bool ovl_dentry_is_metacopy(struct dentry *dentry)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+	return READ_ONCE(oe->metacopy);
+}
+
+void ovl_dentry_set_metacopy(struct dentry *dentry, bool metacopy)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+
+	/*
+	 * Make sure the upper data is complete before anyone is told to
+	 * use it instead of the lower file.
+	 */
+	smp_wmb();
+	WRITE_ONCE(oe->metacopy, metacopy);
+}
+
+bool ovl_can_metacopy(struct dentry *dentry)
+{
+	struct ovl_fs *ofs = dentry->d_sb->s_fs_info;
+	return ofs->config.metacopy;
+}
+
 void ovl_dentry_update(struct dentry *dentry, struct dentry *upperdentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -259,6 +285,22 @@ static bool ovl_is_opaquedir(struct dentry *dentry)
 	return false;
 }
 
+static bool ovl_is_metacopy(struct dentry *dentry)
+{
+	int res;
+	char val;
+	struct inode *inode = dentry->d_inode;
+
+	if (!S_ISREG(inode->i_mode) || !inode->i_op->getxattr)
+		return false;
+
+	res = inode->i_op->getxattr(dentry, OVL_XATTR_METACOPY, &val, 1);
+	if (res == 1 && val == 'y')
+		return true;
+
+	return false;
+}
+
 static void ovl_dentry_release(struct dentry *dentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -338,6 +380,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	unsigned int ctr = 0;
 	struct inode *inode = NULL;
 	bool upperopaque = false;
+	bool metacopy = false;
 	struct dentry *this, *prev = NULL;
 	unsigned int i;
 	int err;
@@ -356,6 +399,8 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 				upperopaque = true;
 			} else if (poe->numlower && ovl_is_opaquedir(this)) {
 				upperopaque = true;
+			} else if (poe->numlower && ovl_is_metacopy(this)) {
+				metacopy = true;
 			}
 		}
 		upperdentry = prev = this;
@@ -395,6 +440,22 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 		if (i < poe->numlower - 1 && ovl_is_opaquedir(this))
 			opaque = true;
 
+		/*
+		 * The data of a metadata-only copy up is in the lower file
+		 * of the same name; renames and links always copy the data
+		 * up first, so the name cannot have changed.
+		 */
+		if (metacopy) {
+			if (!S_ISREG(this->d_inode->i_mode)) {
+				dput(this);
+				break;
+			}
+			stack[ctr].dentry = this;
+			stack[ctr].mnt = lowerpath.mnt;
+			ctr++;
+			break;
+		}
+
 		if (prev && (!S_ISDIR(prev->d_inode->i_mode) ||
 			     !S_ISDIR(this->d_inode->i_mode))) {
 			/*
@@ -420,6 +481,13 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 			break;
 	}
 
+	err = -EIO;
+	if (metacopy && !ctr) {
+		pr_warn_ratelimited("overlayfs: no lower data for metacopy file %pd2\n",
+				    upperdentry);
+		goto out_put;
+	}
+
 	oe = ovl_alloc_entry(ctr);
 	err = -ENOMEM;
 	if (!oe)
@@ -439,6 +507,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	}
 
 	oe->opaque = upperopaque;
+	oe->metacopy = metacopy;
 	oe->__upperdentry = upperdentry;
 	memcpy(oe->lowerstack, stack, sizeof(struct path) * ctr);
 	kfree(stack);
@@ -522,6 +591,8 @@ static int ovl_show_options(struct seq_file *m, struct dentry *dentry)
 		seq_printf(m, ",upperdir=%s", ufs->config.upperdir);
 		seq_printf(m, ",workdir=%s", ufs->config.workdir);
 	}
+	if (ufs->config.metacopy)
+		seq_puts(m, ",metacopy=on");
 	return 0;
 }
 
@@ -546,6 +617,8 @@ enum {
 	OPT_LOWERDIR,
 	OPT_UPPERDIR,
 	OPT_WORKDIR,
+	OPT_METACOPY_ON,
+	OPT_METACOPY_OFF,
 	OPT_ERR,
 };
 
@@ -553,6 +626,8 @@ static const match_table_t ovl_tokens = {
 	{OPT_LOWERDIR,			"lowerdir=%s"},
 	{OPT_UPPERDIR,			"upperdir=%s"},
 	{OPT_WORKDIR,			"workdir=%s"},
+	{OPT_METACOPY_ON,		"metacopy=on"},
+	{OPT_METACOPY_OFF,		"metacopy=off"},
 	{OPT_ERR,			NULL}
 };
 
@@ -613,6 +688,14 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 				return -ENOMEM;
 			break;
 
+		case OPT_METACOPY_ON:
+			config->metacopy = true;
+			break;
+
+		case OPT_METACOPY_OFF:
+			config->metacopy = false;
+			break;
+
 		default:
 			pr_err("overlayfs: unrecognized mount option \"%s\" or missing value\n", p);
 			return -EINVAL;
@@ -115,20 +115,48 @@ void pipe_wait(struct pipe_inode_info *pipe)
 	pipe_lock(pipe);
 }
 
+static struct page *anon_pipe_get_page(struct pipe_inode_info *pipe)
+{
+	int i;
+
+	for (i = 0; i < PIPE_TMP_PAGES; i++) {
+		struct page *page = pipe->tmp_page[i];
+
+		if (page) {
+			pipe->tmp_page[i] = NULL;
+			return page;
+		}
+	}
+
+	return alloc_page(GFP_HIGHUSER);
+}
+
+/*
+ * If nobody else uses this page and there is room in the pipe's small
+ * allocation cache, keep it for the next write.  Otherwise just release
+ * our reference to it.
+ */
+static void anon_pipe_put_page(struct pipe_inode_info *pipe,
+			       struct page *page)
+{
+	int i;
+
+	if (page_count(page) == 1) {
+		for (i = 0; i < PIPE_TMP_PAGES; i++) {
+			if (!pipe->tmp_page[i]) {
+				pipe->tmp_page[i] = page;
+				return;
+			}
+		}
+	}
+
+	page_cache_release(page);
+}
+
 static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
 				  struct pipe_buffer *buf)
 {
-	struct page *page = buf->page;
-
-	/*
-	 * If nobody else uses this page, and we don't already have a
-	 * temporary page, let's keep track of it as a one-deep
-	 * allocation cache. (Otherwise just release our reference to it)
-	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
-		pipe->tmp_page = page;
-	else
-		page_cache_release(page);
+	anon_pipe_put_page(pipe, buf->page);
 }
 
 /**
@@ -231,14 +259,14 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 	size_t total_len = iov_iter_count(to);
 	struct file *filp = iocb->ki_filp;
 	struct pipe_inode_info *pipe = filp->private_data;
-	int do_wakeup;
+	int do_wakeup, do_fasync;
 	ssize_t ret;
 
 	/* Null read succeeds. */
 	if (unlikely(total_len == 0))
 		return 0;
 
-	do_wakeup = 0;
+	do_wakeup = do_fasync = 0;
 	ret = 0;
 	__pipe_lock(pipe);
 	for (;;) {
@@ -278,12 +306,19 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 			}
 
 			if (!buf->len) {
+				/*
+				 * Writers only sleep on a full pipe, so
+				 * only the first slot freed needs to wake
+				 * them, unless someone is polling.
+				 */
+				if (bufs == pipe->buffers || pipe->poll_usage)
+					do_wakeup = 1;
 				buf->ops = NULL;
 				ops->release(pipe, buf);
 				curbuf = (curbuf + 1) & (pipe->buffers - 1);
 				pipe->curbuf = curbuf;
 				pipe->nrbufs = --bufs;
-				do_wakeup = 1;
+				do_fasync = 1;
 			}
 			total_len -= chars;
 			if (!total_len)
@@ -313,17 +348,21 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 		}
 		if (do_wakeup) {
 			wake_up_interruptible_sync_poll(&pipe->wait, POLLOUT | POLLWRNORM);
- 			kill_fasync(&pipe->fasync_writers, SIGIO, POLL_OUT);
+			do_wakeup = 0;
+		}
+		if (do_fasync) {
+			kill_fasync(&pipe->fasync_writers, SIGIO, POLL_OUT);
+			do_fasync = 0;
 		}
 		pipe_wait(pipe);
 	}
 	__pipe_unlock(pipe);
 
 	/* Signal writers asynchronously that there is more room. */
-	if (do_wakeup) {
+	if (do_wakeup)
 		wake_up_interruptible_sync_poll(&pipe->wait, POLLOUT | POLLWRNORM);
+	if (do_fasync)
 		kill_fasync(&pipe->fasync_writers, SIGIO, POLL_OUT);
-	}
 	if (ret > 0)
 		file_accessed(filp);
 	return ret;
@@ -340,7 +379,7 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 	struct file *filp = iocb->ki_filp;
 	struct pipe_inode_info *pipe = filp->private_data;
 	ssize_t ret = 0;
-	int do_wakeup = 0;
+	int do_wakeup = 0, do_fasync = 0;
 	size_t total_len = iov_iter_count(from);
 	ssize_t chars;
 
@@ -375,7 +414,9 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				error = -EFAULT;
 				goto out;
 			}
-			do_wakeup = 1;
+			/* not empty, so no reader is sleeping on it */
+			do_wakeup = pipe->poll_usage;
+			do_fasync = 1;
 			buf->len += chars;
 			ret = chars;
 			if (!iov_iter_count(from))
@@ -396,25 +437,26 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		if (bufs < pipe->buffers) {
 			int newbuf = (pipe->curbuf + bufs) & (pipe->buffers-1);
 			struct pipe_buffer *buf = pipe->bufs + newbuf;
-			struct page *page = pipe->tmp_page;
+			struct page *page;
 			int copied;
 
-			if (!page) {
-				page = alloc_page(GFP_HIGHUSER);
-				if (unlikely(!page)) {
-					ret = ret ? : -ENOMEM;
-					break;
-				}
-				pipe->tmp_page = page;
+			page = anon_pipe_get_page(pipe);
+			if (unlikely(!page)) {
+				ret = ret ? : -ENOMEM;
+				break;
 			}
 			/* Always wake up, even if the copy fails. Otherwise
 			 * we lock up (O_NONBLOCK-)readers that sleep due to
-			 * syscall merging.
-			 * FIXME! Is this really true?
+			 * syscall merging.  Readers only sleep on an empty
+			 * pipe, though, so just the first buffer added to
+			 * one needs to wake them, unless someone is polling.
 			 */
-			do_wakeup = 1;
+			if (!bufs || pipe->poll_usage)
+				do_wakeup = 1;
+			do_fasync = 1;
 			copied = copy_page_from_iter(page, 0, PAGE_SIZE, from);
 			if (unlikely(copied < PAGE_SIZE && iov_iter_count(from))) {
+				anon_pipe_put_page(pipe, page);
 				if (!ret)
 					ret = -EFAULT;
 				break;
@@ -432,7 +474,6 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				buf->flags = PIPE_BUF_FLAG_PACKET;
 			}
 			pipe->nrbufs = ++bufs;
-			pipe->tmp_page = NULL;
 
 			if (!iov_iter_count(from))
 				break;
@@ -451,19 +492,22 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		}
 		if (do_wakeup) {
 			wake_up_interruptible_sync_poll(&pipe->wait, POLLIN | POLLRDNORM);
-			kill_fasync(&pipe->fasync_readers, SIGIO, POLL_IN);
 			do_wakeup = 0;
 		}
+		if (do_fasync) {
+			kill_fasync(&pipe->fasync_readers, SIGIO, POLL_IN);
+			do_fasync = 0;
+		}
 		pipe->waiting_writers++;
 		pipe_wait(pipe);
 		pipe->waiting_writers--;
 	}
 out:
 	__pipe_unlock(pipe);
-	if (do_wakeup) {
+	if (do_wakeup)
 		wake_up_interruptible_sync_poll(&pipe->wait, POLLIN | POLLRDNORM);
+	if (do_fasync)
 		kill_fasync(&pipe->fasync_readers, SIGIO, POLL_IN);
-	}
 	if (ret > 0 && sb_start_write_trylock(file_inode(filp)->i_sb)) {
 		int err = file_update_time(filp);
 		if (err)
@@ -504,6 +548,10 @@ pipe_poll(struct file *filp, poll_table *wait)
 	struct pipe_inode_info *pipe = filp->private_data;
 	int nrbufs;
 
+	/* from now on every change to the pipe must wake up the waiters */
+	if (!pipe->poll_usage)
+		WRITE_ONCE(pipe->poll_usage, true);
+
 	poll_wait(filp, &pipe->wait, wait);
 
 	/* Reading only -- no need for acquiring the semaphore.  */
@@ -613,8 +661,10 @@ void free_pipe_info(struct pipe_inode_info *pipe)
 		if (buf->ops)
 			buf->ops->release(pipe, buf);
 	}
-	if (pipe->tmp_page)
-		__free_page(pipe->tmp_page);
+	for (i = 0; i < PIPE_TMP_PAGES; i++) {
+		if (pipe->tmp_page[i])
+			__free_page(pipe->tmp_page[i]);
+	}
 	kfree(pipe->bufs);
 	kfree(pipe);
 }
@@ -1000,6 +1050,9 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long nr_pages)
 	kfree(pipe->bufs);
 	pipe->bufs = bufs;
 	pipe->buffers = nr_pages;
+
+	/* a writer sleeping on a full pipe may have room now */
+	wake_up_interruptible(&pipe->wait);
 	return nr_pages * PAGE_SIZE;
 }
 
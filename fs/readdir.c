@@ -18,9 +18,14 @@
 #include <linux/security.h>
 #include <linux/syscalls.h>
 #include <linux/unistd.h>
+#include <linux/namei.h>
+#include <linux/fs_struct.h>
+#include <linux/slab.h>
 
 #include <asm/uaccess.h>
 
+#include "internal.h"
+
 int iterate_dir(struct file *file, struct dir_context *ctx)
 {
 	struct inode *inode = file_inode(file);
@@ -307,3 +312,209 @@ SYSCALL_DEFINE3(getdents64, unsigned int, fd,
 	fdput(f);
 	return error;
 }
+
+/*
+ * getdents_statx() works in two passes: the entries are first collected
+ * into a kernel buffer by ->iterate() with the directory locked as usual,
+ * then each one is looked up and stat()ed, so that the filesystem is not
+ * re-entered from within its own readdir.
+ */
+#define GETDENTS_STATX_BUFSIZE	(4 * PAGE_SIZE)
+
+struct getdents_statx_entry {
+	u64		ino;
+	loff_t		offset;
+	unsigned short	namlen;
+	unsigned char	d_type;
+	char		name[0];
+};
+
+struct getdents_statx_callback {
+	struct dir_context ctx;
+	char *buf;
+	unsigned int used;
+	unsigned int size;
+	unsigned int count;
+	int error;
+};
+
+static int filldir_statx(struct dir_context *ctx, const char *name, int namlen,
+			 loff_t offset, u64 ino, unsigned int d_type)
+{
+	struct getdents_statx_callback *buf =
+		container_of(ctx, struct getdents_statx_callback, ctx);
+	struct getdents_statx_entry *de;
+	int reclen = ALIGN(offsetof(struct linux_dirent_statx, d_name) +
+			   namlen + 1, sizeof(u64));
+	int size = ALIGN(offsetof(struct getdents_statx_entry, name) + namlen,
+			 sizeof(u64));
+
+	buf->error = -EINVAL;	/* only used if we fail.. */
+	if (reclen > buf->count || size > buf->size - buf->used)
+		return -EINVAL;
+
+	de = (void *)buf->buf + buf->used;
+	de->ino = ino;
+	de->offset = offset;
+	de->namlen = namlen;
+	de->d_type = d_type;
+	memcpy(de->name, name, namlen);
+	buf->used += size;
+	buf->count -= reclen;
+	return 0;
+}
+
+/* Like follow_dotdot(), but never leaves the caller's root */
+static void getdents_statx_dotdot(struct path *path)
+{
+	struct path root;
+	struct dentry *parent;
+
+	get_fs_root(current->fs, &root);
+	while (!path_equal(path, &root)) {
+		if (path->dentry != path->mnt->mnt_root) {
+			parent = dget_parent(path->dentry);
+			dput(path->dentry);
+			path->dentry = parent;
+			break;
+		}
+		if (!follow_up(path))
+			break;
+	}
+	path_put(&root);
+}
+
+static int getdents_statx_lookup(struct file *file,
+				 struct getdents_statx_entry *de,
+				 struct path *path)
+{
+	struct dentry *dir = file->f_path.dentry;
+	struct dentry *dentry;
+
+	*path = file->f_path;
+	path_get(path);
+	if (de->namlen == 1 && de->name[0] == '.')
+		return 0;
+	if (de->namlen == 2 && de->name[0] == '.' && de->name[1] == '.') {
+		getdents_statx_dotdot(path);
+		goto mounts;
+	}
+
+	mutex_lock(&dir->d_inode->i_mutex);
+	dentry = lookup_one_len(de->name, dir, de->namlen);
+	mutex_unlock(&dir->d_inode->i_mutex);
+	if (IS_ERR(dentry)) {
+		path_put(path);
+		return PTR_ERR(dentry);
+	}
+	dput(path->dentry);
+	path->dentry = dentry;
+	if (d_is_negative(dentry)) {
+		/* removed since it was read */
+		path_put(path);
+		return -ENOENT;
+	}
+mounts:
+	while (d_mountpoint(path->dentry) && follow_down_one(path))
+		;
+	return 0;
+}
+
+static int getdents_statx_fill(struct file *file,
+			       struct getdents_statx_callback *buf,
+			       struct linux_dirent_statx __user *dirent,
+			       u32 mask, unsigned int flags)
+{
+	struct linux_dirent_statx d;
+	struct getdents_statx_entry *de, *next;
+	unsigned int pos = 0;
+	int written = 0;
+
+	while (pos < buf->used) {
+		int reclen;
+		struct kstat stat;
+		struct path path;
+
+		de = (void *)buf->buf + pos;
+		pos += ALIGN(offsetof(struct getdents_statx_entry, name) +
+			     de->namlen, sizeof(u64));
+		next = (void *)buf->buf + pos;
+		reclen = ALIGN(offsetof(struct linux_dirent_statx, d_name) +
+			       de->namlen + 1, sizeof(u64));
+
+		memset(&d.d_stx, 0, sizeof(d.d_stx));
+		if (!getdents_statx_lookup(file, de, &path)) {
+			if (!vfs_getattr_mask(&path, &stat, mask, flags))
+				kstat_to_statx(&stat, &d.d_stx);
+			path_put(&path);
+		}
+
+		d.d_ino = de->ino;
+		d.d_off = pos < buf->used ? next->offset : buf->ctx.pos;
+		d.d_reclen = reclen;
+		d.d_type = de->d_type;
+		memset(d.__spare, 0, sizeof(d.__spare));
+
+		if (copy_to_user(dirent, &d, sizeof(d)) ||
+		    copy_to_user(dirent->d_name, de->name, de->namlen) ||
+		    __put_user(0, dirent->d_name + de->namlen))
+			return -EFAULT;
+
+		dirent = (void __user *)dirent + reclen;
+		written += reclen;
+		cond_resched();
+	}
+	return written;
+}
+
+/**
+ * sys_getdents_statx - read directory entries along with their attributes
+ * @fd: directory to read
+ * @dirent: buffer for struct linux_dirent_statx records
+ * @count: size of @dirent
+ * @mask: STATX_* attributes wanted for each entry
+ * @flags: AT_STATX_SYNC_* synchronisation wanted
+ *
+ * Equivalent to getdents64() followed by fstatat(fd, name,
+ * AT_SYMLINK_NOFOLLOW) on every entry returned, without a path walk from
+ * userspace for each of them.
+ */
+SYSCALL_DEFINE5(getdents_statx, unsigned int, fd,
+		struct linux_dirent_statx __user *, dirent,
+		unsigned int, count, unsigned int, mask, unsigned int, flags)
+{
+	struct fd f;
+	struct getdents_statx_callback buf = {
+		.ctx.actor = filldir_statx,
+		.count = count,
+	};
+	int error;
+
+	if (mask & STATX__RESERVED)
+		return -EINVAL;
+	if ((flags & ~AT_STATX_SYNC_TYPE) ||
+	    (flags & AT_STATX_SYNC_TYPE) == AT_STATX_SYNC_TYPE)
+		return -EINVAL;
+	if (!access_ok(VERIFY_WRITE, dirent, count))
+		return -EFAULT;
+
+	buf.size = min_t(unsigned int, count, GETDENTS_STATX_BUFSIZE);
+	buf.buf = kmalloc(buf.size, GFP_KERNEL);
+	if (!buf.buf)
+		return -ENOMEM;
+
+	f = fdget(fd);
+	error = -EBADF;
+	if (!f.file)
+		goto out;
+
+	error = iterate_dir(f.file, &buf.ctx);
+	if (error >= 0)
+		error = buf.error;
+	if (buf.used)
+		error = getdents_statx_fill(f.file, &buf, dirent, mask, flags);
+	fdput(f);
+out:
+	kfree(buf.buf);
+	return error;
+}
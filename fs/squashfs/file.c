@@ -47,6 +47,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -497,7 +498,160 @@ out:
 	return 0;
 }
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Readahead.  Every whole datablock covered by the readahead window is
+ * gathered into page cache pages here and handed to a work item which
+ * decompresses it directly into them, so with the multi-threaded
+ * decompressors the blocks of a large readahead are decompressed in
+ * parallel rather than one at a time in the reading task.  Fragments,
+ * sparse blocks and anything that can't be gathered in one go go through
+ * squashfs_readpage() as before.
+ */
+struct squashfs_readahead {
+	struct work_struct	work;
+	struct inode		*inode;
+	u64			block;
+	int			bsize;
+	int			pages;
+	struct page		*page[0];
+};
+
+static void squashfs_readahead_work(struct work_struct *work)
+{
+	struct squashfs_readahead *ra = container_of(work,
+					struct squashfs_readahead, work);
+
+	squashfs_readahead_block(ra->inode, ra->block, ra->bsize, ra->page,
+								ra->pages);
+	kfree(ra);
+}
+
+/*
+ * Try to queue the datablock containing @page, taking any other pages of
+ * the block from the front of @pages.  Returns 0 if @page was consumed,
+ * or an error if the caller should fall back to squashfs_readpage().
+ */
+static int squashfs_readahead_queue(struct inode *inode, struct page *page,
+	struct list_head *pages)
+{
+	struct address_space *mapping = inode->i_mapping;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int index = page->index >> shift;
+	pgoff_t file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	pgoff_t start = (pgoff_t) index << shift;
+	pgoff_t end = min_t(pgoff_t, start + (1 << shift) - 1, file_end);
+	struct squashfs_readahead *ra;
+	u64 block = 0;
+	int i, n, bsize;
+
+	if (page->index > file_end)
+		return -EINVAL;
+
+	if (index >= (i_size_read(inode) >> msblk->block_log) &&
+	    squashfs_i(inode)->fragment_block != SQUASHFS_INVALID_BLK)
+		return -EINVAL;
+
+	bsize = read_blocklist(inode, index, &block);
+	if (bsize <= 0)
+		return -EINVAL;
+
+	n = end - start + 1;
+	ra = kmalloc(sizeof(*ra) + n * sizeof(struct page *), GFP_KERNEL);
+	if (ra == NULL)
+		return -ENOMEM;
+
+	if (add_to_page_cache_lru(page, mapping, page->index, GFP_KERNEL)) {
+		page_cache_release(page);
+		kfree(ra);
+		return 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		pgoff_t idx = start + i;
+		struct page *p = NULL;
+
+		if (idx == page->index) {
+			ra->page[i] = page;
+			continue;
+		}
+
+		if (idx > page->index && !list_empty(pages) &&
+				list_entry(pages->prev, struct page,
+						lru)->index == idx) {
+			p = list_entry(pages->prev, struct page, lru);
+			list_del(&p->lru);
+			if (add_to_page_cache_lru(p, mapping, idx, GFP_KERNEL)) {
+				page_cache_release(p);
+				goto abort;
+			}
+		} else {
+			p = grab_cache_page_nowait(mapping, idx);
+			if (p == NULL)
+				goto abort;
+			if (PageUptodate(p)) {
+				unlock_page(p);
+				page_cache_release(p);
+				goto abort;
+			}
+		}
+		ra->page[i] = p;
+	}
+
+	INIT_WORK(&ra->work, squashfs_readahead_work);
+	ra->inode = inode;
+	ra->block = block;
+	ra->bsize = bsize;
+	ra->pages = n;
+	queue_work(system_unbound_wq, &ra->work);
+	return 0;
+
+abort:
+	/*
+	 * Part of this block is already cached or being read by someone
+	 * else.  Leave the other pages gathered so far for a later read and
+	 * read @page the normal way, which copes with partial blocks.
+	 */
+	while (i--) {
+		if (ra->page[i] == page)
+			continue;
+		unlock_page(ra->page[i]);
+		page_cache_release(ra->page[i]);
+	}
+	kfree(ra);
+
+	squashfs_readpage(NULL, page);
+	page_cache_release(page);
+	return 0;
+}
+
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+
+	while (!list_empty(pages)) {
+		struct page *page = list_entry(pages->prev, struct page, lru);
+
+		list_del(&page->lru);
+		if (squashfs_readahead_queue(inode, page, pages) == 0)
+			continue;
+
+		if (add_to_page_cache_lru(page, mapping, page->index,
+							GFP_KERNEL) == 0)
+			squashfs_readpage(file, page);
+		page_cache_release(page);
+	}
+
+	return 0;
+}
+#endif
+
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+	.readpages = squashfs_readpages,
+#endif
 };
@@ -137,6 +137,49 @@ out:
 }
 
 
+/*
+ * Decompress a datablock straight into a complete set of locked page cache
+ * pages gathered by readahead.  The pages are unlocked and released
+ * whatever the outcome; on failure they are left !Uptodate so that a later
+ * squashfs_readpage() retries and reports the error.
+ */
+int squashfs_readahead_block(struct inode *inode, u64 block, int bsize,
+	struct page **page, int pages)
+{
+	struct squashfs_page_actor *actor;
+	int i, bytes, res = -ENOMEM;
+	void *pageaddr;
+
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor) {
+		res = squashfs_read_data(inode->i_sb, block, bsize, NULL,
+								actor);
+		kfree(actor);
+	}
+
+	if (res >= 0) {
+		/* Last page may have trailing bytes not filled */
+		bytes = res % PAGE_CACHE_SIZE;
+		if (bytes) {
+			pageaddr = kmap_atomic(page[pages - 1]);
+			memset(pageaddr + bytes, 0, PAGE_CACHE_SIZE - bytes);
+			kunmap_atomic(pageaddr);
+		}
+	}
+
+	for (i = 0; i < pages; i++) {
+		if (res >= 0) {
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+
+	return res < 0 ? res : 0;
+}
+
+
 static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
 	int pages, struct page **page)
 {
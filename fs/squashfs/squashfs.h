@@ -72,6 +72,8 @@ void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
+extern int squashfs_readahead_block(struct inode *, u64, int, struct page **,
+				int);
 
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
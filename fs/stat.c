@@ -18,6 +18,8 @@
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
 
+#include "internal.h"
+
 void generic_fillattr(struct inode *inode, struct kstat *stat)
 {
 	stat->dev = inode->i_sb->s_dev;
@@ -49,10 +51,20 @@ EXPORT_SYMBOL(generic_fillattr);
  * no attributes to any user.  Any other code probably wants
  * vfs_getattr.
  */
-int vfs_getattr_nosec(struct path *path, struct kstat *stat)
+static int __vfs_getattr(struct path *path, struct kstat *stat,
+			 u32 request_mask, unsigned int query_flags)
 {
 	struct inode *inode = path->dentry->d_inode;
 
+	/*
+	 * ->getattr() may look at request_mask and query_flags to skip work
+	 * for fields the caller does not want; those that don't just fill
+	 * in the basic stats.
+	 */
+	stat->request_mask = request_mask & STATX_ALL;
+	stat->result_mask = STATX_BASIC_STATS;
+	stat->query_flags = query_flags;
+
 	if (inode->i_op->getattr)
 		return inode->i_op->getattr(path->mnt, path->dentry, stat);
 
@@ -60,16 +72,43 @@ int vfs_getattr_nosec(struct path *path, struct kstat *stat)
 	return 0;
 }
 
+int vfs_getattr_nosec(struct path *path, struct kstat *stat)
+{
+	return __vfs_getattr(path, stat, STATX_BASIC_STATS,
+			     AT_STATX_SYNC_AS_STAT);
+}
+
 EXPORT_SYMBOL(vfs_getattr_nosec);
 
-int vfs_getattr(struct path *path, struct kstat *stat)
+/**
+ * vfs_getattr_mask - getattr for a subset of the attributes
+ * @path: file to get attributes from
+ * @stat: structure to return attributes in
+ * @request_mask: STATX_* attributes the caller is interested in
+ * @query_flags: AT_STATX_SYNC_* synchronisation wanted
+ *
+ * Like vfs_getattr(), but lets the filesystem skip expensive work, such
+ * as revalidating attributes with a server, for fields not in
+ * @request_mask.  On return stat->result_mask tells which fields hold
+ * valid data.
+ */
+int vfs_getattr_mask(struct path *path, struct kstat *stat,
+		     u32 request_mask, unsigned int query_flags)
 {
 	int retval;
 
 	retval = security_inode_getattr(path);
 	if (retval)
 		return retval;
-	return vfs_getattr_nosec(path, stat);
+	return __vfs_getattr(path, stat, request_mask, query_flags);
+}
+
+EXPORT_SYMBOL(vfs_getattr_mask);
+
+int vfs_getattr(struct path *path, struct kstat *stat)
+{
+	return vfs_getattr_mask(path, stat, STATX_BASIC_STATS,
+				AT_STATX_SYNC_AS_STAT);
 }
 
 EXPORT_SYMBOL(vfs_getattr);
@@ -445,6 +484,99 @@ SYSCALL_DEFINE4(fstatat64, int, dfd, const char __user *, filename,
 }
 #endif /* __ARCH_WANT_STAT64 || __ARCH_WANT_COMPAT_STAT64 */
 
+void kstat_to_statx(const struct kstat *stat, struct statx *tmp)
+{
+	memset(tmp, 0, sizeof(*tmp));
+
+	tmp->stx_mask = stat->result_mask;
+	tmp->stx_blksize = stat->blksize;
+	tmp->stx_nlink = stat->nlink;
+	tmp->stx_uid = from_kuid_munged(current_user_ns(), stat->uid);
+	tmp->stx_gid = from_kgid_munged(current_user_ns(), stat->gid);
+	tmp->stx_mode = stat->mode;
+	tmp->stx_ino = stat->ino;
+	tmp->stx_size = stat->size;
+	tmp->stx_blocks = stat->blocks;
+	tmp->stx_atime.tv_sec = stat->atime.tv_sec;
+	tmp->stx_atime.tv_nsec = stat->atime.tv_nsec;
+	tmp->stx_ctime.tv_sec = stat->ctime.tv_sec;
+	tmp->stx_ctime.tv_nsec = stat->ctime.tv_nsec;
+	tmp->stx_mtime.tv_sec = stat->mtime.tv_sec;
+	tmp->stx_mtime.tv_nsec = stat->mtime.tv_nsec;
+	tmp->stx_rdev_major = MAJOR(stat->rdev);
+	tmp->stx_rdev_minor = MINOR(stat->rdev);
+	tmp->stx_dev_major = MAJOR(stat->dev);
+	tmp->stx_dev_minor = MINOR(stat->dev);
+}
+
+static int cp_statx(const struct kstat *stat, struct statx __user *buffer)
+{
+	struct statx tmp;
+
+	kstat_to_statx(stat, &tmp);
+	return copy_to_user(buffer, &tmp, sizeof(tmp)) ? -EFAULT : 0;
+}
+
+static int vfs_statx(int dfd, const char __user *filename, unsigned flags,
+		     struct kstat *stat, u32 request_mask)
+{
+	struct path path;
+	unsigned int lookup_flags = 0;
+	int error;
+
+	if (flags & ~(AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_EMPTY_PATH |
+		      AT_STATX_SYNC_TYPE))
+		return -EINVAL;
+	if ((flags & AT_STATX_SYNC_TYPE) == AT_STATX_SYNC_TYPE)
+		return -EINVAL;
+
+	if (!(flags & AT_SYMLINK_NOFOLLOW))
+		lookup_flags |= LOOKUP_FOLLOW;
+	if (flags & AT_EMPTY_PATH)
+		lookup_flags |= LOOKUP_EMPTY;
+retry:
+	error = user_path_at(dfd, filename, lookup_flags, &path);
+	if (error)
+		return error;
+
+	error = vfs_getattr_mask(&path, stat, request_mask,
+				 flags & AT_STATX_SYNC_TYPE);
+	path_put(&path);
+	if (retry_estale(error, lookup_flags)) {
+		lookup_flags |= LOOKUP_REVAL;
+		goto retry;
+	}
+	return error;
+}
+
+/**
+ * sys_statx - System call to get enhanced stats
+ * @dfd: Base directory to pathwalk from *or* fd to stat.
+ * @filename: File to stat or "" with AT_EMPTY_PATH
+ * @flags: AT_* flags to control pathwalk.
+ * @mask: Parts of statx struct actually required.
+ * @buffer: Result buffer.
+ *
+ * Note that fstat() can be emulated by setting dfd to the fd of interest,
+ * supplying "" as the filename and setting AT_EMPTY_PATH in the flags.
+ */
+SYSCALL_DEFINE5(statx, int, dfd, const char __user *, filename,
+		unsigned, flags, unsigned int, mask,
+		struct statx __user *, buffer)
+{
+	struct kstat stat;
+	int error;
+
+	if (mask & STATX__RESERVED)
+		return -EINVAL;
+
+	error = vfs_statx(dfd, filename, flags, &stat, mask);
+	if (error)
+		return error;
+
+	return cp_statx(&stat, buffer);
+}
+
 /* Caller is here responsible for sufficient locking (ie. inode->i_lock) */
 void __inode_add_bytes(struct inode *inode, loff_t bytes)
 {
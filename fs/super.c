@@ -146,6 +146,8 @@ static void destroy_super(struct super_block *s)
 	int i;
 	list_lru_destroy(&s->s_dentry_lru);
 	list_lru_destroy(&s->s_inode_lru);
+	free_percpu(s->s_inode_lists);
+	percpu_counter_destroy(&s->s_nr_dentry_negative);
 	for (i = 0; i < SB_FREEZE_LEVELS; i++)
 		percpu_counter_destroy(&s->s_writers.counter[i]);
 	security_sb_free(s);
@@ -190,12 +192,23 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags)
 	s->s_flags = flags;
 	INIT_HLIST_NODE(&s->s_instances);
 	INIT_HLIST_BL_HEAD(&s->s_anon);
-	INIT_LIST_HEAD(&s->s_inodes);
+	s->s_inode_lists = alloc_percpu(struct sb_inode_list);
+	if (!s->s_inode_lists)
+		goto fail;
+	for_each_possible_cpu(i) {
+		struct sb_inode_list *ilist = per_cpu_ptr(s->s_inode_lists, i);
+
+		spin_lock_init(&ilist->lock);
+		INIT_LIST_HEAD(&ilist->head);
+	}
 
 	if (list_lru_init_memcg(&s->s_dentry_lru))
 		goto fail;
 	if (list_lru_init_memcg(&s->s_inode_lru))
 		goto fail;
+	if (percpu_counter_init(&s->s_nr_dentry_negative, 0, GFP_KERNEL) < 0)
+		goto fail;
+	INIT_WORK(&s->s_dentry_trim_work, prune_dcache_negative_work);
 
 	init_rwsem(&s->s_umount);
 	lockdep_set_class(&s->s_umount, &type->s_umount_key);
@@ -219,6 +232,9 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags)
 	atomic_set(&s->s_active, 1);
 	mutex_init(&s->s_vfs_rename_mutex);
 	lockdep_set_class(&s->s_vfs_rename_mutex, &type->s_vfs_rename_key);
+	mutex_init(&s->s_sync_lock);
+	spin_lock_init(&s->s_inodes_sync_lock);
+	INIT_LIST_HEAD(&s->s_inodes_sync);
 	mutex_init(&s->s_dquot.dqio_mutex);
 	mutex_init(&s->s_dquot.dqonoff_mutex);
 	s->s_maxbytes = MAX_NON_LFS;
@@ -284,6 +300,8 @@ void deactivate_locked_super(struct super_block *s)
 		cleancache_invalidate_fs(s);
 		unregister_shrinker(&s->s_shrink);
 		fs->kill_sb(s);
+		/* all dentries are gone, nothing can queue it again */
+		cancel_work_sync(&s->s_dentry_trim_work);
 
 		/*
 		 * Since list_lru_destroy() may sleep, we cannot call it from
@@ -399,7 +417,7 @@ void generic_shutdown_super(struct super_block *sb)
 		sync_filesystem(sb);
 		sb->s_flags &= ~MS_ACTIVE;
 
-		fsnotify_unmount_inodes(&sb->s_inodes);
+		fsnotify_unmount_inodes(sb);
 
 		evict_inodes(sb);
 
@@ -411,7 +429,7 @@ void generic_shutdown_super(struct super_block *sb)
 		if (sop->put_super)
 			sop->put_super(sb);
 
-		if (!list_empty(&sb->s_inodes)) {
+		if (sb_has_inodes(sb)) {
 			printk("VFS: Busy inodes after unmount of %s. "
 			   "Self-destruct in 5 seconds.  Have a nice day...\n",
 			   sb->s_id);
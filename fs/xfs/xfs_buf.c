@@ -1596,6 +1596,8 @@ xfs_buftarg_shrink_scan(
 		xfs_buf_rele(bp);
 	}
 
+	XFS_STATS_INC(xb_lru_scans);
+	XFS_STATS_ADD(xb_lru_freed, freed);
 	return freed;
 }
 
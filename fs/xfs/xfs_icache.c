@@ -39,6 +39,19 @@
 
 STATIC void __xfs_inode_clear_reclaim_tag(struct xfs_mount *mp,
 				struct xfs_perag *pag, struct xfs_inode *ip);
+STATIC int xfs_reclaim_inodes_ag(struct xfs_mount *mp, int flags, int nid,
+				int *nr_to_scan);
+
+/*
+ * The node the memory of the inode comes from, which is what memory
+ * pressure on a node wants back.
+ */
+static inline int
+xfs_inode_nid(
+	struct xfs_inode	*ip)
+{
+	return page_to_nid(virt_to_head_page(ip));
+}
 
 /*
  * Allocate and initialise an xfs_inode.
@@ -698,15 +711,21 @@ xfs_inode_ag_iterator_tag(
  */
 static void
 xfs_reclaim_work_queue(
-	struct xfs_mount        *mp)
+	struct xfs_mount        *mp,
+	int			nid)
 {
+	struct xfs_reclaim_node	*rn = &mp->m_reclaim_nodes[nid];
+	int			cpu;
 
-	rcu_read_lock();
-	if (radix_tree_tagged(&mp->m_perag_tree, XFS_ICI_RECLAIM_TAG)) {
-		queue_delayed_work(mp->m_reclaim_workqueue, &mp->m_reclaim_work,
+	if (atomic_read(&rn->rn_reclaimable) <= 0)
+		return;
+
+	/* run the pass on the node whose inodes it frees */
+	cpu = cpumask_any_and(cpumask_of_node(nid), cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = WORK_CPU_UNBOUND;
+	queue_delayed_work_on(cpu, mp->m_reclaim_workqueue, &rn->rn_work,
 			msecs_to_jiffies(xfs_syncd_centisecs / 6 * 10));
-	}
-	rcu_read_unlock();
 }
 
 /*
@@ -715,16 +734,60 @@ xfs_reclaim_work_queue(
  * seconds, as well as being kicked by the inode cache shrinker when memory
  * goes low. It scans as quickly as possible avoiding locked inodes or those
  * already being flushed, and once done schedules a future pass.
+ *
+ * There is one worker per node, each only reclaiming the inodes of its node.
  */
-void
+STATIC void
 xfs_reclaim_worker(
 	struct work_struct *work)
 {
-	struct xfs_mount *mp = container_of(to_delayed_work(work),
-					struct xfs_mount, m_reclaim_work);
+	struct xfs_reclaim_node	*rn = container_of(to_delayed_work(work),
+					struct xfs_reclaim_node, rn_work);
+	int			nr_to_scan = INT_MAX;
+
+	XFS_STATS_INC(xs_reclaim_bg_passes);
+	xfs_reclaim_inodes_ag(rn->rn_mount, SYNC_TRYLOCK, rn->rn_nid,
+			      &nr_to_scan);
+	xfs_reclaim_work_queue(rn->rn_mount, rn->rn_nid);
+}
 
-	xfs_reclaim_inodes(mp, SYNC_TRYLOCK);
-	xfs_reclaim_work_queue(mp);
+int
+xfs_reclaim_nodes_init(
+	struct xfs_mount	*mp)
+{
+	int			nid;
+
+	mp->m_reclaim_nodes = kmem_zalloc(nr_node_ids *
+				sizeof(struct xfs_reclaim_node), KM_MAYFAIL);
+	if (!mp->m_reclaim_nodes)
+		return -ENOMEM;
+
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		struct xfs_reclaim_node	*rn = &mp->m_reclaim_nodes[nid];
+
+		INIT_DELAYED_WORK(&rn->rn_work, xfs_reclaim_worker);
+		rn->rn_mount = mp;
+		rn->rn_nid = nid;
+		atomic_set(&rn->rn_reclaimable, 0);
+	}
+	return 0;
+}
+
+void
+xfs_reclaim_nodes_free(
+	struct xfs_mount	*mp)
+{
+	kmem_free(mp->m_reclaim_nodes);
+}
+
+void
+xfs_reclaim_work_cancel(
+	struct xfs_mount	*mp)
+{
+	int			nid;
+
+	for (nid = 0; nid < nr_node_ids; nid++)
+		cancel_delayed_work_sync(&mp->m_reclaim_nodes[nid].rn_work);
 }
 
 static void
@@ -732,6 +795,9 @@ __xfs_inode_set_reclaim_tag(
 	struct xfs_perag	*pag,
 	struct xfs_inode	*ip)
 {
+	struct xfs_mount	*mp = ip->i_mount;
+	int			nid = xfs_inode_nid(ip);
+
 	radix_tree_tag_set(&pag->pag_ici_root,
 			   XFS_INO_TO_AGINO(ip->i_mount, ip->i_ino),
 			   XFS_ICI_RECLAIM_TAG);
@@ -744,13 +810,15 @@ __xfs_inode_set_reclaim_tag(
 				XFS_ICI_RECLAIM_TAG);
 		spin_unlock(&ip->i_mount->m_perag_lock);
 
-		/* schedule periodic background inode reclaim */
-		xfs_reclaim_work_queue(ip->i_mount);
-
 		trace_xfs_perag_set_reclaim(ip->i_mount, pag->pag_agno,
 							-1, _RET_IP_);
 	}
 	pag->pag_ici_reclaimable++;
+	pag->pag_ici_node[nid].pr_reclaimable++;
+
+	/* schedule periodic background inode reclaim */
+	if (atomic_inc_return(&mp->m_reclaim_nodes[nid].rn_reclaimable) == 1)
+		xfs_reclaim_work_queue(mp, nid);
 }
 
 /*
@@ -780,6 +848,10 @@ __xfs_inode_clear_reclaim(
 	xfs_perag_t	*pag,
 	xfs_inode_t	*ip)
 {
+	int		nid = xfs_inode_nid(ip);
+
+	pag->pag_ici_node[nid].pr_reclaimable--;
+	atomic_dec(&ip->i_mount->m_reclaim_nodes[nid].rn_reclaimable);
 	pag->pag_ici_reclaimable--;
 	if (!pag->pag_ici_reclaimable) {
 		/* clear the reclaim tag from the perag radix tree */
@@ -1013,11 +1085,16 @@ out:
  * corrupted, we still want to try to reclaim all the inodes. If we don't,
  * then a shut down during filesystem unmount reclaim walk leak all the
  * unreclaimed inodes.
+ *
+ * If @nid is not NUMA_NO_NODE, only the inodes allocated on that node are
+ * reclaimed, and the walk uses the per-node lock and cursor of each AG so
+ * that it never waits for reclaim running on behalf of another node.
  */
 STATIC int
 xfs_reclaim_inodes_ag(
 	struct xfs_mount	*mp,
 	int			flags,
+	int			nid,
 	int			*nr_to_scan)
 {
 	struct xfs_perag	*pag;
@@ -1034,18 +1111,30 @@ restart:
 		unsigned long	first_index = 0;
 		int		done = 0;
 		int		nr_found = 0;
+		struct mutex	*lock = &pag->pag_ici_reclaim_lock;
+		unsigned long	*cursor = &pag->pag_ici_reclaim_cursor;
 
 		ag = pag->pag_agno + 1;
 
+		if (nid != NUMA_NO_NODE) {
+			/* nothing of this node to reclaim in this AG */
+			if (!pag->pag_ici_node[nid].pr_reclaimable) {
+				xfs_perag_put(pag);
+				continue;
+			}
+			lock = &pag->pag_ici_node[nid].pr_lock;
+			cursor = &pag->pag_ici_node[nid].pr_cursor;
+		}
+
 		if (trylock) {
-			if (!mutex_trylock(&pag->pag_ici_reclaim_lock)) {
+			if (!mutex_trylock(lock)) {
 				skipped++;
 				xfs_perag_put(pag);
 				continue;
 			}
-			first_index = pag->pag_ici_reclaim_cursor;
+			first_index = *cursor;
 		} else
-			mutex_lock(&pag->pag_ici_reclaim_lock);
+			mutex_lock(lock);
 
 		do {
 			struct xfs_inode *batch[XFS_LOOKUP_BATCH];
@@ -1070,7 +1159,13 @@ restart:
 			for (i = 0; i < nr_found; i++) {
 				struct xfs_inode *ip = batch[i];
 
-				if (done || xfs_reclaim_inode_grab(ip, flags))
+				if (done) {
+					batch[i] = NULL;
+				} else if (nid != NUMA_NO_NODE &&
+					   xfs_inode_nid(ip) != nid) {
+					XFS_STATS_INC(xs_reclaim_node_skipped);
+					batch[i] = NULL;
+				} else if (xfs_reclaim_inode_grab(ip, flags))
 					batch[i] = NULL;
 
 				/*
@@ -1113,10 +1208,10 @@ restart:
 		} while (nr_found && !done && *nr_to_scan > 0);
 
 		if (trylock && !done)
-			pag->pag_ici_reclaim_cursor = first_index;
+			*cursor = first_index;
 		else
-			pag->pag_ici_reclaim_cursor = 0;
-		mutex_unlock(&pag->pag_ici_reclaim_lock);
+			*cursor = 0;
+		mutex_unlock(lock);
 		xfs_perag_put(pag);
 	}
 
@@ -1128,6 +1223,7 @@ restart:
 	 * than spin trying to execute reclaim.
 	 */
 	if (skipped && (flags & SYNC_WAIT) && *nr_to_scan > 0) {
+		XFS_STATS_INC(xs_reclaim_waits);
 		trylock = 0;
 		goto restart;
 	}
@@ -1141,7 +1237,7 @@ xfs_reclaim_inodes(
 {
 	int		nr_to_scan = INT_MAX;
 
-	return xfs_reclaim_inodes_ag(mp, mode, &nr_to_scan);
+	return xfs_reclaim_inodes_ag(mp, mode, NUMA_NO_NODE, &nr_to_scan);
 }
 
 /*
@@ -1152,37 +1248,34 @@ xfs_reclaim_inodes(
  * reclaim of inodes. That means if we come across dirty inodes, we wait for
  * them to be cleaned, which we hope will not be very long due to the
  * background walker having already kicked the IO off on those dirty inodes.
+ *
+ * Only the inodes of the node under pressure are scanned.
  */
 long
 xfs_reclaim_inodes_nr(
 	struct xfs_mount	*mp,
+	int			nid,
 	int			nr_to_scan)
 {
 	/* kick background reclaimer and push the AIL */
-	xfs_reclaim_work_queue(mp);
+	xfs_reclaim_work_queue(mp, nid);
 	xfs_ail_push_all(mp->m_ail);
 
-	return xfs_reclaim_inodes_ag(mp, SYNC_TRYLOCK | SYNC_WAIT, &nr_to_scan);
+	XFS_STATS_INC(xs_reclaim_node_scans);
+	return xfs_reclaim_inodes_ag(mp, SYNC_TRYLOCK | SYNC_WAIT, nid,
+				     &nr_to_scan);
 }
 
 /*
- * Return the number of reclaimable inodes in the filesystem for
- * the shrinker to determine how much to reclaim.
+ * Return the number of reclaimable inodes allocated on @nid for the
+ * shrinker to determine how much to reclaim.
  */
 int
 xfs_reclaim_inodes_count(
-	struct xfs_mount	*mp)
+	struct xfs_mount	*mp,
+	int			nid)
 {
-	struct xfs_perag	*pag;
-	xfs_agnumber_t		ag = 0;
-	int			reclaimable = 0;
-
-	while ((pag = xfs_perag_get_tag(mp, ag, XFS_ICI_RECLAIM_TAG))) {
-		ag = pag->pag_agno + 1;
-		reclaimable += pag->pag_ici_reclaimable;
-		xfs_perag_put(pag);
-	}
-	return reclaimable;
+	return max(atomic_read(&mp->m_reclaim_nodes[nid].rn_reclaimable), 0);
 }
 
 STATIC int
@@ -55,11 +55,13 @@ int xfs_iget(struct xfs_mount *mp, struct xfs_trans *tp, xfs_ino_t ino,
 struct xfs_inode * xfs_inode_alloc(struct xfs_mount *mp, xfs_ino_t ino);
 void xfs_inode_free(struct xfs_inode *ip);
 
-void xfs_reclaim_worker(struct work_struct *work);
+int xfs_reclaim_nodes_init(struct xfs_mount *mp);
+void xfs_reclaim_nodes_free(struct xfs_mount *mp);
+void xfs_reclaim_work_cancel(struct xfs_mount *mp);
 
 int xfs_reclaim_inodes(struct xfs_mount *mp, int mode);
-int xfs_reclaim_inodes_count(struct xfs_mount *mp);
-long xfs_reclaim_inodes_nr(struct xfs_mount *mp, int nr_to_scan);
+int xfs_reclaim_inodes_count(struct xfs_mount *mp, int nid);
+long xfs_reclaim_inodes_nr(struct xfs_mount *mp, int nid, int nr_to_scan);
 
 void xfs_inode_set_reclaim_tag(struct xfs_inode *ip);
 
@@ -31,6 +31,8 @@
 #include "xfs_log.h"
 #include "xfs_log_priv.h"
 
+#include <linux/list_sort.h>
+
 /*
  * Allocate a new ticket. Failing to get a new ticket makes it really hard to
  * recover, so we don't allow failure here. Also, we allocate in a context that
@@ -273,6 +275,12 @@ insert:
  * if the change requires additional log metadata. If it does, take that space
  * as well. Remove the amount of space we added to the checkpoint ticket from
  * the current transaction ticket so that the accounting works out correctly.
+ *
+ * Everything is staged on the per-cpu structure of the current cpu and only
+ * moved to the context by the push, which can't run until we are done as we
+ * hold the context lock. The only shared state touched here is the commit
+ * order, and the context space counter once this cpu has accumulated enough
+ * to matter for the background push decision.
  */
 static void
 xlog_cil_insert_items(
@@ -282,9 +290,12 @@ xlog_cil_insert_items(
 	struct xfs_cil		*cil = log->l_cilp;
 	struct xfs_cil_ctx	*ctx = cil->xc_ctx;
 	struct xfs_log_item_desc *lidp;
+	struct xlog_cil_pcp	*pcp;
 	int			len = 0;
 	int			diff_iovecs = 0;
 	int			iclog_space;
+	int			hdrs;
+	uint			order;
 
 	ASSERT(tp);
 
@@ -294,12 +305,19 @@ xlog_cil_insert_items(
 	 */
 	xlog_cil_insert_format_items(log, tp, &len, &diff_iovecs);
 
+	/* account for space used by new iovec headers  */
+	len += diff_iovecs * sizeof(xlog_op_header_t);
+
+	pcp = get_cpu_ptr(cil->xc_pcp);
+
 	/*
-	 * Now (re-)position everything modified at the tail of the CIL.
-	 * We do this here so we only need to take the CIL lock once during
-	 * the transaction commit.
+	 * Now stamp everything modified with the commit order, so the push
+	 * can write the items out in the order they were last modified.
+	 * Items already staged by an earlier commit stay on whatever cpu
+	 * list they are on; they are locked by this transaction, so no one
+	 * else can be adding them to a list at the same time.
 	 */
-	spin_lock(&cil->xc_cil_lock);
+	order = atomic_inc_return(&ctx->order_id);
 	list_for_each_entry(lidp, &tp->t_items, lid_trans) {
 		struct xfs_log_item	*lip = lidp->lid_item;
 
@@ -307,47 +325,109 @@ xlog_cil_insert_items(
 		if (!(lidp->lid_flags & XFS_LID_DIRTY))
 			continue;
 
-		list_move_tail(&lip->li_cil, &cil->xc_cil);
+		lip->li_order_id = order;
+		if (list_empty(&lip->li_cil))
+			list_add_tail(&lip->li_cil, &pcp->log_items);
 	}
 
-	/* account for space used by new iovec headers  */
-	len += diff_iovecs * sizeof(xlog_op_header_t);
-	ctx->nvecs += diff_iovecs;
+	pcp->nvecs += diff_iovecs;
 
 	/* attach the transaction to the CIL if it has any busy extents */
 	if (!list_empty(&tp->t_busy))
-		list_splice_init(&tp->t_busy, &ctx->busy_extents);
+		list_splice_init(&tp->t_busy, &pcp->busy_extents);
 
 	/*
 	 * Now transfer enough transaction reservation to the context ticket
 	 * for the checkpoint. The context ticket is special - the unit
 	 * reservation has to grow as well as the current reservation as we
 	 * steal from tickets so we can correctly determine the space used
-	 * during the transaction commit.
+	 * during the transaction commit. The first commit into the context
+	 * takes the initial unit reservation.
 	 */
-	if (ctx->ticket->t_curr_res == 0) {
-		ctx->ticket->t_curr_res = ctx->ticket->t_unit_res;
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags) &&
+	    test_and_clear_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
+		pcp->curr_res += ctx->ticket->t_unit_res;
 		tp->t_ticket->t_curr_res -= ctx->ticket->t_unit_res;
 	}
 
-	/* do we need space for more log record headers? */
+	/*
+	 * do we need space for more log record headers? Each cpu accounts
+	 * for the headers its own share of the checkpoint needs, rounded up,
+	 * which is never less than the whole checkpoint needs.
+	 */
 	iclog_space = log->l_iclog_size - log->l_iclog_hsize;
-	if (len > 0 && (ctx->space_used / iclog_space !=
-				(ctx->space_used + len) / iclog_space)) {
-		int hdrs;
-
-		hdrs = (len + iclog_space - 1) / iclog_space;
+	hdrs = DIV_ROUND_UP(pcp->space_used + len, iclog_space) -
+	       DIV_ROUND_UP(pcp->space_used, iclog_space);
+	if (len > 0 && hdrs) {
 		/* need to take into account split region headers, too */
 		hdrs *= log->l_iclog_hsize + sizeof(struct xlog_op_header);
-		ctx->ticket->t_unit_res += hdrs;
-		ctx->ticket->t_curr_res += hdrs;
+		pcp->unit_res += hdrs;
+		pcp->curr_res += hdrs;
 		tp->t_ticket->t_curr_res -= hdrs;
 		ASSERT(tp->t_ticket->t_curr_res >= len);
 	}
 	tp->t_ticket->t_curr_res -= len;
-	ctx->space_used += len;
+	pcp->space_used += len;
+
+	/*
+	 * Fold the space into the context once this cpu has used its share
+	 * of the limit, so the background push check sees it.
+	 */
+	if (pcp->space_used - pcp->space_folded >
+	    XLOG_CIL_SPACE_LIMIT(log) / num_online_cpus()) {
+		atomic_add(pcp->space_used - pcp->space_folded,
+			   &ctx->space_used);
+		pcp->space_folded = pcp->space_used;
+	}
+
+	put_cpu_ptr(cil->xc_pcp);
+}
+
+static int
+xlog_cil_order_cmp(
+	void			*priv,
+	struct list_head	*a,
+	struct list_head	*b)
+{
+	struct xfs_log_item	*l1 = container_of(a, struct xfs_log_item,
+						   li_cil);
+	struct xfs_log_item	*l2 = container_of(b, struct xfs_log_item,
+						   li_cil);
+
+	return (int)(l1->li_order_id - l2->li_order_id);
+}
 
-	spin_unlock(&cil->xc_cil_lock);
+/*
+ * Move everything staged on the cpus into the context being pushed, and
+ * hand the dirty items back on @items in commit order. Called with the
+ * context lock held exclusively, so no commit is staging anything.
+ */
+static void
+xlog_cil_pcp_aggregate(
+	struct xfs_cil		*cil,
+	struct xfs_cil_ctx	*ctx,
+	struct list_head	*items)
+{
+	int			cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct xlog_cil_pcp	*pcp = per_cpu_ptr(cil->xc_pcp, cpu);
+
+		ctx->ticket->t_unit_res += pcp->unit_res;
+		ctx->ticket->t_curr_res += pcp->curr_res;
+		ctx->nvecs += pcp->nvecs;
+		atomic_add(pcp->space_used - pcp->space_folded,
+			   &ctx->space_used);
+		list_splice_init(&pcp->busy_extents, &ctx->busy_extents);
+		list_splice_tail_init(&pcp->log_items, items);
+
+		pcp->space_used = 0;
+		pcp->space_folded = 0;
+		pcp->curr_res = 0;
+		pcp->unit_res = 0;
+		pcp->nvecs = 0;
+	}
+	list_sort(NULL, items, xlog_cil_order_cmp);
 }
 
 static void
@@ -438,6 +518,7 @@ xlog_cil_push(
 	struct xfs_log_vec	lvhdr = { NULL };
 	xfs_lsn_t		commit_lsn;
 	xfs_lsn_t		push_seq;
+	LIST_HEAD(log_items);
 
 	if (!cil)
 		return 0;
@@ -457,7 +538,7 @@ xlog_cil_push(
 	 * move on to a new sequence number and so we have to be able to push
 	 * this sequence again later.
 	 */
-	if (list_empty(&cil->xc_cil)) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
 		cil->xc_push_seq = 0;
 		spin_unlock(&cil->xc_push_lock);
 		goto out_skip;
@@ -499,16 +580,17 @@ xlog_cil_push(
 
 	/*
 	 * pull all the log vectors off the items in the CIL, and
-	 * remove the items from the CIL. We don't need the CIL lock
-	 * here because it's only needed on the transaction commit
-	 * side which is currently locked out by the flush lock.
+	 * remove the items from the CIL. We don't need any lock here
+	 * for the per-cpu staging because the transaction commit side
+	 * is currently locked out by the flush lock.
 	 */
+	xlog_cil_pcp_aggregate(cil, ctx, &log_items);
 	lv = NULL;
 	num_iovecs = 0;
-	while (!list_empty(&cil->xc_cil)) {
+	while (!list_empty(&log_items)) {
 		struct xfs_log_item	*item;
 
-		item = list_first_entry(&cil->xc_cil,
+		item = list_first_entry(&log_items,
 					struct xfs_log_item, li_cil);
 		list_del_init(&item->li_cil);
 		if (!ctx->lv_chain)
@@ -531,6 +613,7 @@ xlog_cil_push(
 	new_ctx->sequence = ctx->sequence + 1;
 	new_ctx->cil = cil;
 	cil->xc_ctx = new_ctx;
+	set_bit(XLOG_CIL_EMPTY, &cil->xc_flags);
 
 	/*
 	 * The switch is now done, so we can drop the context lock and move out
@@ -687,13 +770,14 @@ xlog_cil_push_background(
 	 * The cil won't be empty because we are called while holding the
 	 * context lock so whatever we added to the CIL will still be there
 	 */
-	ASSERT(!list_empty(&cil->xc_cil));
+	ASSERT(!test_bit(XLOG_CIL_EMPTY, &cil->xc_flags));
 
 	/*
 	 * don't do a background push if we haven't used up all the
-	 * space available yet.
+	 * space available yet. Only the space each cpu has folded into
+	 * the context is seen here, the rest is picked up by the push.
 	 */
-	if (cil->xc_ctx->space_used < XLOG_CIL_SPACE_LIMIT(log))
+	if (atomic_read(&cil->xc_ctx->space_used) < XLOG_CIL_SPACE_LIMIT(log))
 		return;
 
 	spin_lock(&cil->xc_push_lock);
@@ -731,7 +815,8 @@ xlog_cil_push_now(
 	 * there's no work we need to do.
 	 */
 	spin_lock(&cil->xc_push_lock);
-	if (list_empty(&cil->xc_cil) || push_seq <= cil->xc_push_seq) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags) ||
+	    push_seq <= cil->xc_push_seq) {
 		spin_unlock(&cil->xc_push_lock);
 		return;
 	}
@@ -749,7 +834,7 @@ xlog_cil_empty(
 	bool		empty = false;
 
 	spin_lock(&cil->xc_push_lock);
-	if (list_empty(&cil->xc_cil))
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags))
 		empty = true;
 	spin_unlock(&cil->xc_push_lock);
 	return empty;
@@ -892,7 +977,7 @@ restart:
 	 * we would have found the context on the committing list.
 	 */
 	if (sequence == cil->xc_current_sequence &&
-	    !list_empty(&cil->xc_cil)) {
+	    !test_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
 		spin_unlock(&cil->xc_push_lock);
 		goto restart;
 	}
@@ -951,6 +1036,7 @@ xlog_cil_init(
 {
 	struct xfs_cil	*cil;
 	struct xfs_cil_ctx *ctx;
+	int		cpu;
 
 	cil = kmem_zalloc(sizeof(*cil), KM_SLEEP|KM_MAYFAIL);
 	if (!cil)
@@ -962,10 +1048,22 @@ xlog_cil_init(
 		return -ENOMEM;
 	}
 
+	cil->xc_pcp = alloc_percpu(struct xlog_cil_pcp);
+	if (!cil->xc_pcp) {
+		kmem_free(ctx);
+		kmem_free(cil);
+		return -ENOMEM;
+	}
+	for_each_possible_cpu(cpu) {
+		struct xlog_cil_pcp	*pcp = per_cpu_ptr(cil->xc_pcp, cpu);
+
+		INIT_LIST_HEAD(&pcp->busy_extents);
+		INIT_LIST_HEAD(&pcp->log_items);
+	}
+
 	INIT_WORK(&cil->xc_push_work, xlog_cil_push_work);
-	INIT_LIST_HEAD(&cil->xc_cil);
 	INIT_LIST_HEAD(&cil->xc_committing);
-	spin_lock_init(&cil->xc_cil_lock);
+	set_bit(XLOG_CIL_EMPTY, &cil->xc_flags);
 	spin_lock_init(&cil->xc_push_lock);
 	init_rwsem(&cil->xc_ctx_lock);
 	init_waitqueue_head(&cil->xc_commit_wait);
@@ -992,7 +1090,8 @@ xlog_cil_destroy(
 		kmem_free(log->l_cilp->xc_ctx);
 	}
 
-	ASSERT(list_empty(&log->l_cilp->xc_cil));
+	ASSERT(test_bit(XLOG_CIL_EMPTY, &log->l_cilp->xc_flags));
+	free_percpu(log->l_cilp->xc_pcp);
 	kmem_free(log->l_cilp);
 }
 
@@ -252,7 +252,8 @@ struct xfs_cil_ctx {
 	xfs_lsn_t		commit_lsn;	/* chkpt commit record lsn */
 	struct xlog_ticket	*ticket;	/* chkpt ticket */
 	int			nvecs;		/* number of regions */
-	int			space_used;	/* aggregate size of regions */
+	atomic_t		space_used;	/* aggregate size of regions */
+	atomic_t		order_id;	/* item commit order */
 	struct list_head	busy_extents;	/* busy extents in chkpt */
 	struct xfs_log_vec	*lv_chain;	/* logvecs being pushed */
 	struct xfs_log_callback	log_cb;		/* completion callback hook. */
@@ -275,10 +276,29 @@ struct xfs_cil_ctx {
  * the commit LSN to be determined as well. This should make synchronous
  * operations almost as efficient as the old logging methods.
  */
+/*
+ * Transaction commits stage their items and accounting on the cpu they run
+ * on, so that committing doesn't need a lock shared by all cpus. The push
+ * folds everything into the context it is checkpointing, and sorts the
+ * items back into commit order.
+ */
+struct xlog_cil_pcp {
+	int			space_used;	/* formatted bytes */
+	int			space_folded;	/* of which in ctx->space_used */
+	int			curr_res;	/* stolen for the ctx ticket */
+	int			unit_res;	/* of which unit reservation */
+	int			nvecs;		/* number of regions */
+	struct list_head	busy_extents;	/* busy extents */
+	struct list_head	log_items;	/* dirty log items */
+};
+
+/* cil->xc_flags */
+#define XLOG_CIL_EMPTY		0	/* nothing committed to this ctx */
+
 struct xfs_cil {
 	struct xlog		*xc_log;
-	struct list_head	xc_cil;
-	spinlock_t		xc_cil_lock;
+	unsigned long		xc_flags;
+	struct xlog_cil_pcp __percpu *xc_pcp;
 
 	struct rw_semaphore	xc_ctx_lock ____cacheline_aligned_in_smp;
 	struct xfs_cil_ctx	*xc_ctx;
@@ -191,6 +191,7 @@ xfs_initialize_perag(
 	xfs_ino_t	ino;
 	xfs_sb_t	*sbp = &mp->m_sb;
 	int		error = -ENOMEM;
+	int		nid;
 
 	/*
 	 * Walk the current per-ag tree so we don't try to initialise AGs
@@ -206,13 +207,16 @@ xfs_initialize_perag(
 		if (!first_initialised)
 			first_initialised = index;
 
-		pag = kmem_zalloc(sizeof(*pag), KM_MAYFAIL);
+		pag = kmem_zalloc(sizeof(*pag) + nr_node_ids *
+				  sizeof(struct xfs_perag_reclaim), KM_MAYFAIL);
 		if (!pag)
 			goto out_unwind;
 		pag->pag_agno = index;
 		pag->pag_mount = mp;
 		spin_lock_init(&pag->pag_ici_lock);
 		mutex_init(&pag->pag_ici_reclaim_lock);
+		for (nid = 0; nid < nr_node_ids; nid++)
+			mutex_init(&pag->pag_ici_node[nid].pr_lock);
 		INIT_RADIX_TREE(&pag->pag_ici_root, GFP_ATOMIC);
 		spin_lock_init(&pag->pag_buf_lock);
 		pag->pag_buf_tree = RB_ROOT;
@@ -1010,7 +1014,7 @@ xfs_unmountfs(
 	 * reclaim just to be sure. We can stop background inode reclaim
 	 * here as well if it is still running.
 	 */
-	cancel_delayed_work_sync(&mp->m_reclaim_work);
+	xfs_reclaim_work_cancel(mp);
 	xfs_reclaim_inodes(mp, SYNC_WAIT);
 
 	xfs_qm_unmount(mp);
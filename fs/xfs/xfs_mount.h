@@ -159,7 +159,7 @@ typedef struct xfs_mount {
 	struct mutex		m_icsb_mutex;	/* balancer sync lock */
 #endif
 	struct xfs_mru_cache	*m_filestream;  /* per-mount filestream data */
-	struct delayed_work	m_reclaim_work;	/* background inode reclaim */
+	struct xfs_reclaim_node	*m_reclaim_nodes; /* per-node inode reclaim */
 	struct delayed_work	m_eofblocks_work; /* background eof blocks
 						     trimming */
 	bool			m_update_sb;	/* sb needs update in mount */
@@ -333,6 +333,24 @@ typedef struct xfs_mod_sb {
  * Per-ag incore structure, copies of information in agf and agi, to improve the
  * performance of allocation group selection.
  */
+/*
+ * Inode reclaim driven by memory pressure on one node only reclaims the
+ * inodes allocated on that node, and only serialises against reclaimers
+ * of the same node.
+ */
+struct xfs_perag_reclaim {
+	struct mutex	pr_lock;	/* serialisation point */
+	unsigned long	pr_cursor;	/* reclaim restart point */
+	int		pr_reclaimable;	/* reclaimable inodes on this node */
+};
+
+struct xfs_reclaim_node {
+	struct delayed_work	rn_work;	/* background inode reclaim */
+	struct xfs_mount	*rn_mount;
+	int			rn_nid;
+	atomic_t		rn_reclaimable;	/* reclaimable inodes */
+};
+
 typedef struct xfs_perag {
 	struct xfs_mount *pag_mount;	/* owner filesystem */
 	xfs_agnumber_t	pag_agno;	/* AG this structure belongs to */
@@ -376,6 +394,9 @@ typedef struct xfs_perag {
 	/* for rcu-safe freeing */
 	struct rcu_head	rcu_head;
 	int		pagb_count;	/* pagb slots in use */
+
+	/* per-node inode reclaim state, nr_node_ids entries */
+	struct xfs_perag_reclaim pag_ici_node[];
 } xfs_perag_t;
 
 extern int	xfs_log_sbcount(xfs_mount_t *);
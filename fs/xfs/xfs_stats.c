@@ -62,6 +62,7 @@ static int xfs_stat_proc_show(struct seq_file *m, void *v)
 		{ "fibt2",		XFSSTAT_END_FIBT_V2		},
 		/* we print both series of quota information together */
 		{ "qm",			XFSSTAT_END_QM			},
+		{ "reclaim",		XFSSTAT_END_RECLAIM		},
 	};
 
 	/* Loop over all stats groups */
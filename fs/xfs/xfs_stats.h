@@ -209,6 +209,13 @@ struct xfsstats {
 #define XFSSTAT_END_QM			(XFSSTAT_END_XQMSTAT+2)
 	__uint32_t		xs_qm_dquot;
 	__uint32_t		xs_qm_dquot_unused;
+#define XFSSTAT_END_RECLAIM		(XFSSTAT_END_QM+6)
+	__uint32_t		xs_reclaim_node_scans;
+	__uint32_t		xs_reclaim_node_skipped;
+	__uint32_t		xs_reclaim_waits;
+	__uint32_t		xs_reclaim_bg_passes;
+	__uint32_t		xb_lru_scans;
+	__uint32_t		xb_lru_freed;
 /* Extra precision counters */
 	__uint64_t		xs_xstrat_bytes;
 	__uint64_t		xs_write_bytes;
@@ -1045,6 +1045,7 @@ xfs_fs_put_super(
 	xfs_freesb(mp);
 	xfs_icsb_destroy_counters(mp);
 	xfs_destroy_mount_workqueues(mp);
+	xfs_reclaim_nodes_free(mp);
 	xfs_close_devices(mp);
 	xfs_free_fsname(mp);
 	kfree(mp);
@@ -1418,7 +1419,6 @@ xfs_fs_fill_super(
 	spin_lock_init(&mp->m_sb_lock);
 	mutex_init(&mp->m_growlock);
 	atomic_set(&mp->m_active_trans, 0);
-	INIT_DELAYED_WORK(&mp->m_reclaim_work, xfs_reclaim_worker);
 	INIT_DELAYED_WORK(&mp->m_eofblocks_work, xfs_eofblocks_worker);
 	mp->m_kobj.kobject.kset = xfs_kset;
 
@@ -1445,10 +1445,14 @@ xfs_fs_fill_super(
 	if (error)
 		goto out_free_fsname;
 
-	error = xfs_init_mount_workqueues(mp);
+	error = xfs_reclaim_nodes_init(mp);
 	if (error)
 		goto out_close_devices;
 
+	error = xfs_init_mount_workqueues(mp);
+	if (error)
+		goto out_free_reclaim_nodes;
+
 	error = xfs_icsb_init_counters(mp);
 	if (error)
 		goto out_destroy_workqueues;
@@ -1510,6 +1514,8 @@ xfs_fs_fill_super(
 	xfs_icsb_destroy_counters(mp);
 out_destroy_workqueues:
 	xfs_destroy_mount_workqueues(mp);
+ out_free_reclaim_nodes:
+	xfs_reclaim_nodes_free(mp);
  out_close_devices:
 	xfs_close_devices(mp);
  out_free_fsname:
@@ -1539,7 +1545,7 @@ xfs_fs_nr_cached_objects(
 	struct super_block	*sb,
 	struct shrink_control	*sc)
 {
-	return xfs_reclaim_inodes_count(XFS_M(sb));
+	return xfs_reclaim_inodes_count(XFS_M(sb), sc->nid);
 }
 
 static long
@@ -1547,7 +1553,7 @@ xfs_fs_free_cached_objects(
 	struct super_block	*sb,
 	struct shrink_control	*sc)
 {
-	return xfs_reclaim_inodes_nr(XFS_M(sb), sc->nr_to_scan);
+	return xfs_reclaim_inodes_nr(XFS_M(sb), sc->nid, sc->nr_to_scan);
 }
 
 static const struct super_operations xfs_super_operations = {
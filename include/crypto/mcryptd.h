@@ -92,7 +92,12 @@ struct mcryptd_alg_cstate {
 
 struct mcryptd_alg_state {
 	struct mcryptd_alg_cstate __percpu *alg_cstate;
-	unsigned long (*flusher)(struct mcryptd_alg_cstate *cstate);
+	/*
+	 * Complete the jobs whose flush time has come, or all of them
+	 * with @force, e.g. when the cpu has nothing else to do.
+	 */
+	unsigned long (*flusher)(struct mcryptd_alg_cstate *cstate,
+				 bool force);
 };
 
 /* return delay in jiffies from current time */
@@ -14,6 +14,7 @@
 
 #include <linux/types.h>
 #include <linux/list.h>
+#include <linux/init.h>
 
 typedef u64 async_cookie_t;
 typedef void (*async_func_t) (void *data, async_cookie_t cookie);
@@ -47,4 +48,27 @@ extern void async_synchronize_cookie(async_cookie_t cookie);
 extern void async_synchronize_cookie_domain(async_cookie_t cookie,
 					    struct async_domain *domain);
 extern bool current_is_async(void);
+
+/*
+ * device_initcall_async - run a driver's initcall asynchronously
+ *
+ * For built-in drivers whose init does not need to be done before the
+ * initcalls that follow it, e.g. ones that only register a driver for
+ * slow-to-probe hardware.  Boot waits for all of them before the init
+ * sections are freed, as modules do before theirs.
+ */
+#define device_initcall_async(fn)					\
+	static void __init __async_##fn(void *data, async_cookie_t cookie) \
+	{								\
+		int ret = fn();						\
+									\
+		if (ret)						\
+			pr_warn("async initcall %s returned %d\n", #fn, ret); \
+	}								\
+	static int __init __async_init_##fn(void)			\
+	{								\
+		async_schedule(__async_##fn, NULL);			\
+		return 0;						\
+	}								\
+	device_initcall(__async_init_##fn)
 #endif
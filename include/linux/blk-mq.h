@@ -37,6 +37,7 @@ struct blk_mq_hw_ctx {
 	struct blk_flush_queue	*fq;
 
 	void			*driver_data;
+	void			*sched_data;	/* IO scheduler private data */
 
 	struct blk_mq_ctxmap	ctx_map;
 
@@ -52,6 +53,10 @@ struct blk_mq_hw_ctx {
 #define BLK_MQ_MAX_DISPATCH_ORDER	10
 	unsigned long		dispatched[BLK_MQ_MAX_DISPATCH_ORDER];
 
+	unsigned long		poll_considered;
+	unsigned long		poll_invoked;
+	unsigned long		poll_success;
+
 	unsigned int		numa_node;
 	unsigned int		queue_num;
 
@@ -96,6 +101,7 @@ typedef void (exit_request_fn)(void *, struct request *, unsigned int,
 
 typedef void (busy_iter_fn)(struct blk_mq_hw_ctx *, struct request *, void *,
 		bool);
+typedef int (poll_fn)(struct blk_mq_hw_ctx *);
 
 struct blk_mq_ops {
 	/*
@@ -115,6 +121,13 @@ struct blk_mq_ops {
 
 	softirq_done_fn		*complete;
 
+	/*
+	 * Called to poll for completion on the hardware queue, instead of
+	 * waiting for the interrupt. Returns the number of completions
+	 * reaped, or a negative value to tell the caller to stop polling.
+	 */
+	poll_fn			*poll;
+
 	/*
 	 * Called when the block layer side of a hardware queue has been
 	 * set up, allowing the driver to allocate/init matching structures.
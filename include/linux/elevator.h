@@ -8,6 +8,7 @@
 
 struct io_cq;
 struct elevator_type;
+struct blk_mq_hw_ctx;
 
 typedef int (elevator_merge_fn) (struct request_queue *, struct request **,
 				 struct bio *);
@@ -70,6 +71,24 @@ struct elevator_ops
 	elevator_exit_fn *elevator_exit_fn;
 };
 
+/*
+ * Operations for schedulers sitting in front of blk-mq hardware queues.
+ * The scheduler keeps one instance of its queueing state per hardware
+ * context, since requests carry a tag from the hctx they were allocated on.
+ */
+struct elevator_mq_ops {
+	int (*init_sched)(struct request_queue *, struct elevator_type *);
+	void (*exit_sched)(struct elevator_queue *);
+	int (*init_hctx)(struct elevator_queue *, struct blk_mq_hw_ctx *,
+			 unsigned int);
+	void (*exit_hctx)(struct blk_mq_hw_ctx *, unsigned int);
+
+	bool (*bio_merge)(struct blk_mq_hw_ctx *, struct bio *);
+	void (*insert_requests)(struct blk_mq_hw_ctx *, struct list_head *);
+	struct request *(*dispatch_request)(struct blk_mq_hw_ctx *);
+	bool (*has_work)(struct blk_mq_hw_ctx *);
+};
+
 #define ELV_NAME_MAX	(16)
 
 struct elv_fs_entry {
@@ -88,6 +107,8 @@ struct elevator_type
 
 	/* fields provided by elevator implementation */
 	struct elevator_ops ops;
+	struct elevator_mq_ops mq_ops;
+	bool uses_mq;		/* blk-mq scheduler, uses mq_ops */
 	size_t icq_size;	/* see iocontext.h */
 	size_t icq_align;	/* ditto */
 	struct elv_fs_entry *elevator_attrs;
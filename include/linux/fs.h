@@ -30,6 +30,7 @@
 #include <linux/lockdep.h>
 #include <linux/percpu-rwsem.h>
 #include <linux/blk_types.h>
+#include <linux/workqueue.h>
 
 #include <asm/byteorder.h>
 #include <uapi/linux/fs.h>
@@ -629,6 +630,7 @@ struct inode {
 	/* Misc */
 	unsigned long		i_state;
 	struct mutex		i_mutex;
+	struct rw_semaphore	i_lookup_rwsem;	/* see FS_PARALLEL_LOOKUP */
 
 	unsigned long		dirtied_when;	/* jiffies of first dirtying */
 	unsigned long		dirtied_time_when;
@@ -637,6 +639,8 @@ struct inode {
 	struct list_head	i_wb_list;	/* backing dev IO list */
 	struct list_head	i_lru;		/* inode LRU list */
 	struct list_head	i_sb_list;
+	struct sb_inode_list	*i_sb_list_head;	/* list i_sb_list is on */
+	struct list_head	i_sync_list;	/* may have pages to wait on */
 	union {
 		struct hlist_head	i_dentry;
 		struct rcu_head		i_rcu;
@@ -962,6 +966,8 @@ int locks_in_grace(struct net *);
 struct file_lock {
 	struct file_lock *fl_next;	/* singly linked list for this inode  */
 	struct list_head fl_list;	/* link into file_lock_context */
+	struct rb_node fl_rb;		/* node in flc_posix_tree */
+	loff_t fl_subtree_last;		/* max fl_end in fl_rb subtree */
 	struct hlist_node fl_link;	/* node in global lists */
 	struct list_head fl_block;	/* circular list of blocked processes */
 	fl_owner_t fl_owner;
@@ -996,6 +1002,7 @@ struct file_lock_context {
 	spinlock_t		flc_lock;
 	struct list_head	flc_flock;
 	struct list_head	flc_posix;
+	struct rb_root		flc_posix_tree;	/* flc_posix by range */
 	struct list_head	flc_lease;
 };
 
@@ -1047,6 +1054,9 @@ extern void lease_get_mtime(struct inode *, struct timespec *time);
 extern int generic_setlease(struct file *, long, struct file_lock **, void **priv);
 extern int vfs_setlease(struct file *, long, struct file_lock **, void **);
 extern int lease_modify(struct file_lock *, int, struct list_head *);
+struct notifier_block;
+extern int lease_register_notifier(struct notifier_block *);
+extern void lease_unregister_notifier(struct notifier_block *);
 struct files_struct;
 extern void show_fd_locks(struct seq_file *f,
 			 struct file *filp, struct files_struct *files);
@@ -1181,6 +1191,16 @@ static inline int vfs_setlease(struct file *filp, long arg,
 	return -EINVAL;
 }
 
+struct notifier_block;
+static inline int lease_register_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+
+static inline void lease_unregister_notifier(struct notifier_block *nb)
+{
+}
+
 static inline int lease_modify(struct file_lock *fl, int arg,
 			       struct list_head *dispose)
 {
@@ -1258,6 +1278,15 @@ struct sb_writers {
 #endif
 };
 
+/*
+ * Inodes of a superblock are linked on one list per cpu, so that adding
+ * and removing them doesn't bounce a single lock around.
+ */
+struct sb_inode_list {
+	spinlock_t		lock;
+	struct list_head	head;
+};
+
 struct super_block {
 	struct list_head	s_list;		/* Keep this first */
 	dev_t			s_dev;		/* search index; _not_ kdev_t */
@@ -1280,7 +1309,7 @@ struct super_block {
 #endif
 	const struct xattr_handler **s_xattr;
 
-	struct list_head	s_inodes;	/* all inodes */
+	struct sb_inode_list __percpu *s_inode_lists;	/* all inodes */
 	struct hlist_bl_head	s_anon;		/* anonymous dentries for (nfs) exporting */
 	struct list_head	s_mounts;	/* list of mounts; _not_ for fs use */
 	struct block_device	*s_bdev;
@@ -1309,6 +1338,11 @@ struct super_block {
 	 */
 	struct mutex s_vfs_rename_mutex;	/* Kludge */
 
+	/* Inodes that may have pages under writeback, for sync */
+	struct mutex		s_sync_lock;
+	spinlock_t		s_inodes_sync_lock;
+	struct list_head	s_inodes_sync;
+
 	/*
 	 * Filesystem subtype.  If non-empty the filesystem type field
 	 * in /proc/mounts will be "type.subtype"
@@ -1339,6 +1373,10 @@ struct super_block {
 	struct workqueue_struct *s_dio_done_wq;
 	struct hlist_head s_pins;
 
+	/* Unused negative dentries, trimmed by s_dentry_trim_work */
+	struct percpu_counter s_nr_dentry_negative;
+	struct work_struct s_dentry_trim_work;
+
 	/*
 	 * Keep the lru lists last in the structure so they always sit on their
 	 * own individual cachelines.
@@ -1897,6 +1935,7 @@ struct file_system_type {
 #define FS_HAS_SUBTYPE		4
 #define FS_USERNS_MOUNT		8	/* Can be mounted by userns root */
 #define FS_USERNS_DEV_MOUNT	16 /* A userns mount does not imply MNT_NODEV */
+#define FS_PARALLEL_LOOKUP	32 /* ->lookup() of a directory can run concurrently */
 #define FS_RENAME_DOES_D_MOVE	32768	/* FS will handle d_move() during rename() internally. */
 	struct dentry *(*mount) (struct file_system_type *, int,
 		       const char *, void *);
@@ -1913,6 +1952,7 @@ struct file_system_type {
 	struct lock_class_key i_lock_key;
 	struct lock_class_key i_mutex_key;
 	struct lock_class_key i_mutex_dir_key;
+	struct lock_class_key i_lookup_rwsem_key;
 };
 
 #define MODULE_ALIAS_FS(NAME) MODULE_ALIAS("fs-" NAME)
@@ -2629,6 +2669,17 @@ int dax_zero_page_range(struct inode *, loff_t from, unsigned len, get_block_t);
 int dax_truncate_page(struct inode *, loff_t from, get_block_t);
 int dax_fault(struct vm_area_struct *, struct vm_fault *, get_block_t);
 int dax_pfn_mkwrite(struct vm_area_struct *, struct vm_fault *);
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+int dax_pmd_fault(struct vm_area_struct *, unsigned long addr, pmd_t *,
+				unsigned int flags, get_block_t);
+#else
+static inline int dax_pmd_fault(struct vm_area_struct *vma,
+				unsigned long addr, pmd_t *pmd,
+				unsigned int flags, get_block_t gb)
+{
+	return VM_FAULT_FALLBACK;
+}
+#endif
 #define dax_mkwrite(vma, vmf, gb)	dax_fault(vma, vmf, gb)
 
 #ifdef CONFIG_BLOCK
@@ -2688,6 +2739,7 @@ extern int generic_readlink(struct dentry *, char __user *, int);
 extern void generic_fillattr(struct inode *, struct kstat *);
 int vfs_getattr_nosec(struct path *path, struct kstat *stat);
 extern int vfs_getattr(struct path *, struct kstat *);
+extern int vfs_getattr_mask(struct path *, struct kstat *, u32, unsigned int);
 void __inode_add_bytes(struct inode *inode, loff_t bytes);
 void inode_add_bytes(struct inode *inode, loff_t bytes);
 void __inode_sub_bytes(struct inode *inode, loff_t bytes);
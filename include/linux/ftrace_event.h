@@ -421,6 +421,7 @@ enum event_trigger_type {
 	ETT_SNAPSHOT		= (1 << 1),
 	ETT_STACKTRACE		= (1 << 2),
 	ETT_EVENT_ENABLE	= (1 << 3),
+	ETT_EVENT_HIST		= (1 << 4),
 };
 
 extern int filter_match_preds(struct event_filter *filter, void *rec);
@@ -434,7 +435,8 @@ extern int call_filter_check_discard(struct ftrace_event_call *call, void *rec,
 extern enum event_trigger_type event_triggers_call(struct ftrace_event_file *file,
 						   void *rec);
 extern void event_triggers_post_call(struct ftrace_event_file *file,
-				     enum event_trigger_type tt);
+				     enum event_trigger_type tt,
+				     void *rec);
 
 /**
  * ftrace_trigger_soft_disabled - do triggers and test if soft disabled
@@ -517,7 +519,7 @@ event_trigger_unlock_commit(struct ftrace_event_file *file,
 		trace_buffer_unlock_commit(buffer, event, irq_flags, pc);
 
 	if (tt)
-		event_triggers_post_call(file, tt);
+		event_triggers_post_call(file, tt, entry);
 }
 
 /**
@@ -550,7 +552,7 @@ event_trigger_unlock_commit_regs(struct ftrace_event_file *file,
 						irq_flags, pc, regs);
 
 	if (tt)
-		event_triggers_post_call(file, tt);
+		event_triggers_post_call(file, tt, entry);
 }
 
 #ifdef CONFIG_BPF_SYSCALL
@@ -622,6 +624,12 @@ perf_trace_buf_submit(void *raw_data, int size, int rctx, u64 addr,
 {
 	perf_tp_event(addr, count, raw_data, size, regs, head, rctx, task);
 }
+
+extern void perf_trace_run_bpf_submit(void *raw_data, int size, int rctx,
+				      struct ftrace_event_call *call, u64 addr,
+				      u64 count, struct pt_regs *regs,
+				      struct hlist_head *head,
+				      struct task_struct *task);
 #endif
 
 #endif /* _LINUX_FTRACE_EVENT_H */
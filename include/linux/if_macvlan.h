@@ -11,15 +11,21 @@
 
 #if IS_ENABLED(CONFIG_MACVTAP)
 struct socket *macvtap_get_socket(struct file *);
+struct skb_array *macvtap_get_skb_array(struct file *);
 #else
 #include <linux/err.h>
 #include <linux/errno.h>
 struct file;
 struct socket;
+struct skb_array;
 static inline struct socket *macvtap_get_socket(struct file *f)
 {
 	return ERR_PTR(-EINVAL);
 }
+static inline struct skb_array *macvtap_get_skb_array(struct file *f)
+{
+	return ERR_PTR(-EINVAL);
+}
 #endif /* CONFIG_MACVTAP */
 
 struct macvlan_port;
@@ -182,6 +182,7 @@ struct irq_data {
  * IRQD_IRQ_MASKED		- Masked state of the interrupt
  * IRQD_IRQ_INPROGRESS		- In progress state of the interrupt
  * IRQD_WAKEUP_ARMED		- Wakeup mode armed
+ * IRQD_AFFINITY_MANAGED	- Affinity is managed by the kernel
  */
 enum {
 	IRQD_TRIGGER_MASK		= 0xf,
@@ -196,6 +197,7 @@ enum {
 	IRQD_IRQ_MASKED			= (1 << 17),
 	IRQD_IRQ_INPROGRESS		= (1 << 18),
 	IRQD_WAKEUP_ARMED		= (1 << 19),
+	IRQD_AFFINITY_MANAGED		= (1 << 20),
 };
 
 static inline bool irqd_is_setaffinity_pending(struct irq_data *d)
@@ -223,6 +225,11 @@ static inline void irqd_mark_affinity_was_set(struct irq_data *d)
 	d->state_use_accessors |= IRQD_AFFINITY_SET;
 }
 
+static inline bool irqd_affinity_is_managed(struct irq_data *d)
+{
+	return d->state_use_accessors & IRQD_AFFINITY_MANAGED;
+}
+
 static inline u32 irqd_get_trigger_type(struct irq_data *d)
 {
 	return d->state_use_accessors & IRQD_TRIGGER_MASK;
@@ -69,6 +69,7 @@ extern void *jbd2_alloc(size_t size, gfp_t flags);
 extern void jbd2_free(void *ptr, size_t size);
 
 #define JBD2_MIN_JOURNAL_BLOCKS 1024
+#define JBD2_DEFAULT_FAST_COMMIT_BLOCKS 256
 
 #ifdef __KERNEL__
 
@@ -269,7 +270,8 @@ typedef struct journal_superblock_s
 /* 0x0050 */
 	__u8	s_checksum_type;	/* checksum type */
 	__u8	s_padding2[3];
-	__u32	s_padding[42];
+	__be32	s_num_fc_blks;		/* Number of fast commit blocks */
+	__u32	s_padding[41];
 	__be32	s_checksum;		/* crc32c(superblock) */
 
 /* 0x0100 */
@@ -294,6 +296,7 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
 #define JBD2_FEATURE_INCOMPAT_CSUM_V2		0x00000008
 #define JBD2_FEATURE_INCOMPAT_CSUM_V3		0x00000010
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT	0x00000020
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
@@ -302,13 +305,17 @@ typedef struct journal_superblock_s
 					JBD2_FEATURE_INCOMPAT_64BIT | \
 					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
 					JBD2_FEATURE_INCOMPAT_CSUM_V2 | \
-					JBD2_FEATURE_INCOMPAT_CSUM_V3)
+					JBD2_FEATURE_INCOMPAT_CSUM_V3 | \
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
 
 #ifdef __KERNEL__
 
 #include <linux/fs.h>
 #include <linux/sched.h>
 
+/* Recovery passes, also handed to the fast commit replay callback */
+enum passtype {PASS_SCAN, PASS_REVOKE, PASS_REPLAY};
+
 enum jbd_state_bits {
 	BH_JBD			/* Has an attached ext3 journal_head */
 	  = BH_PrivateStart,
@@ -670,6 +677,11 @@ struct transaction_stats_s {
 	unsigned long		ts_tid;
 	unsigned long		ts_requested;
 	struct transaction_run_stats_s run;
+	/* handles that had to wait for log space, and for how long */
+	unsigned long		ts_chkpt_stalls;
+	u64			ts_chkpt_stall_ns;
+	/* buffers written back by the checkpoint thread */
+	unsigned long		ts_chkpt_bg_written;
 };
 
 static inline unsigned long
@@ -682,6 +694,7 @@ jbd2_time_diff(unsigned long start, unsigned long end)
 }
 
 #define JBD2_NR_BATCH	64
+#define JBD2_BG_NR_BATCH	(JBD2_NR_BATCH * 8)
 
 /**
  * struct journal_s - The journal_s type is the concrete type associated with
@@ -731,6 +744,9 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  *     commit
  * @j_uuid: Uuid of client object.
  * @j_task: Pointer to the current commit thread for this journal
+ * @j_chkpt_task: Background checkpoint thread for this journal
+ * @j_wait_chkpt: Wait queue to wake up the checkpoint thread
+ * @j_bg_chkpt_bhs: Buffers being written by the checkpoint thread
  * @j_max_transaction_buffers:  Maximum number of metadata buffers to allow in a
  *     single compound commit transaction
  * @j_commit_interval: What is the maximum transaction lifetime before we begin
@@ -751,6 +767,13 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_proc_entry: procfs entry for the jbd statistics directory
  * @j_stats: Overall statistics
  * @j_private: An opaque pointer to fs-private information.
+ * @j_fc_first: first block of the fast commit area
+ * @j_fc_last: one past the last block of the fast commit area
+ * @j_fc_off: number of fast commit blocks used since the last full commit
+ * @j_fc_wait: wait queue for fast and full commits to exclude each other
+ * @j_fc_replay_callback: called for each fast commit block during recovery
+ * @j_fc_cleanup_callback: called when a full commit makes the fast commit
+ *	area free again
  */
 
 struct journal_s
@@ -920,6 +943,15 @@ struct journal_s
 	/* Pointer to the current commit thread for this journal */
 	struct task_struct	*j_task;
 
+	/*
+	 * Background checkpointing, which writes back old transactions
+	 * before handles run out of log space.  j_bg_chkpt_bhs is
+	 * owned by the checkpoint thread.
+	 */
+	struct task_struct	*j_chkpt_task;
+	wait_queue_head_t	j_wait_chkpt;
+	struct buffer_head	**j_bg_chkpt_bhs;
+
 	/*
 	 * Maximum number of metadata buffers to allow in a single compound
 	 * commit transaction
@@ -982,6 +1014,31 @@ struct journal_s
 	/* Failed journal commit ID */
 	unsigned int		j_failed_commit;
 
+	/*
+	 * Fast commit area, carved off the end of the log when
+	 * JBD2_FEATURE_INCOMPAT_FAST_COMMIT is set. Fast commits write
+	 * filesystem private records for the running transaction there,
+	 * a full commit empties it again. [j_state_lock]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_last;
+	unsigned long		j_fc_off;
+	wait_queue_head_t	j_fc_wait;
+
+	/*
+	 * Called for each fast commit block in the scan and replay passes
+	 * of recovery, with the tid a valid block must belong to. Returns
+	 * 0 to get the next block, 1 to end the pass or a negative error.
+	 */
+	int			(*j_fc_replay_callback)(journal_t *,
+							struct buffer_head *,
+							enum passtype pass,
+							int off,
+							tid_t expected_tid);
+
+	/* Called after a full commit, once the fast commit area is free */
+	void			(*j_fc_cleanup_callback)(journal_t *);
+
 	/*
 	 * An opaque pointer to fs-private information.  ext3 puts its
 	 * superblock pointer here
@@ -1007,6 +1064,8 @@ struct journal_s
 #define JBD2_ABORT_ON_SYNCDATA_ERR	0x040	/* Abort the journal on file
 						 * data write error in ordered
 						 * mode */
+#define JBD2_FAST_COMMIT_ONGOING	0x080	/* Fast commit is in progress */
+#define JBD2_FULL_COMMIT_ONGOING	0x100	/* Full commit is in progress */
 
 /*
  * Function declarations for the journaling transaction and buffer
@@ -1151,6 +1210,10 @@ extern int	   jbd2_journal_set_features
 		   (journal_t *, unsigned long, unsigned long, unsigned long);
 extern void	   jbd2_journal_clear_features
 		   (journal_t *, unsigned long, unsigned long, unsigned long);
+extern int	   jbd2_fc_begin_commit(journal_t *journal, tid_t tid);
+extern void	   jbd2_fc_end_commit(journal_t *journal);
+extern int	   jbd2_fc_get_buf(journal_t *journal,
+				   struct buffer_head **bh_out);
 extern int	   jbd2_journal_load       (journal_t *journal);
 extern int	   jbd2_journal_destroy    (journal_t *);
 extern int	   jbd2_journal_recover    (journal_t *journal);
@@ -1245,6 +1308,8 @@ int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
 int jbd2_complete_transaction(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
+int jbd2_log_do_bg_checkpoint(journal_t *journal);
+void jbd2_log_kick_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
@@ -1341,6 +1406,20 @@ static inline unsigned long jbd2_log_space_left(journal_t *journal)
 	return free;
 }
 
+/*
+ * The checkpoint thread starts once less than half of the log is free and
+ * keeps going until three quarters are, so that handles rarely have to
+ * checkpoint in __jbd2_log_wait_for_space() themselves.
+ */
+static inline bool jbd2_log_need_bg_checkpoint(journal_t *journal,
+					       bool started)
+{
+	unsigned long size = journal->j_last - journal->j_first;
+	unsigned long want = started ? size - size / 4 : size / 2;
+
+	return journal->j_checkpoint_transactions && journal->j_free < want;
+}
+
 /*
  * Definitions which augment the buffer_head layer
  */
@@ -0,0 +1,98 @@
+#ifndef KVM_DIRTY_RING_H
+#define KVM_DIRTY_RING_H
+
+#include <linux/kvm.h>
+
+/*
+ * struct kvm_dirty_ring:
+ *
+ * @dirty_index:	free running counter of the next entry to publish,
+ *			only advanced by the vcpu that owns the ring
+ * @reset_index:	free running counter of the next entry to reset,
+ *			only advanced by KVM_RESET_DIRTY_RINGS
+ * @size:		number of entries, always a power of two
+ * @soft_limit:		usage at which the vcpu exits to userspace with
+ *			KVM_EXIT_DIRTY_RING_FULL; the remaining entries absorb
+ *			whatever gets dirtied before the exit happens
+ * @dirty_gfns:		the ring itself, shared with userspace
+ */
+struct kvm_dirty_ring {
+	u32 dirty_index;
+	u32 reset_index;
+	u32 size;
+	u32 soft_limit;
+	struct kvm_dirty_gfn *dirty_gfns;
+};
+
+struct kvm;
+struct kvm_vcpu;
+
+/*
+ * Entries kept free below the ring size: a few for the gfns a single
+ * exit can touch, plus whatever the cpu logs in hardware before KVM
+ * gets to look at it (e.g. the PML buffer on Intel).
+ */
+#define KVM_DIRTY_RING_RSVD_ENTRIES	64
+#define KVM_DIRTY_RING_MAX_ENTRIES	65536
+
+#ifndef KVM_CPU_DIRTY_LOG_SIZE
+#define KVM_CPU_DIRTY_LOG_SIZE		0
+#endif
+
+#ifdef CONFIG_HAVE_KVM_DIRTY_RING
+
+static inline u32 kvm_dirty_ring_get_rsvd_entries(void)
+{
+	return KVM_DIRTY_RING_RSVD_ENTRIES + KVM_CPU_DIRTY_LOG_SIZE;
+}
+
+bool kvm_page_in_dirty_ring(struct kvm *kvm, unsigned long pgoff);
+int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, u32 size);
+void kvm_dirty_ring_free(struct kvm_dirty_ring *ring);
+int kvm_dirty_ring_push(struct kvm_vcpu *vcpu, u32 slot, u64 offset);
+int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring);
+bool kvm_dirty_ring_soft_full(struct kvm_dirty_ring *ring);
+struct page *kvm_dirty_ring_get_page(struct kvm_dirty_ring *ring, u32 offset);
+
+#else /* CONFIG_HAVE_KVM_DIRTY_RING */
+
+static inline bool kvm_page_in_dirty_ring(struct kvm *kvm, unsigned long pgoff)
+{
+	return false;
+}
+
+static inline int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, u32 size)
+{
+	return 0;
+}
+
+static inline void kvm_dirty_ring_free(struct kvm_dirty_ring *ring)
+{
+}
+
+static inline int kvm_dirty_ring_push(struct kvm_vcpu *vcpu, u32 slot,
+				      u64 offset)
+{
+	return -ENOSPC;
+}
+
+static inline int kvm_dirty_ring_reset(struct kvm *kvm,
+				       struct kvm_dirty_ring *ring)
+{
+	return 0;
+}
+
+static inline bool kvm_dirty_ring_soft_full(struct kvm_dirty_ring *ring)
+{
+	return false;
+}
+
+static inline struct page *kvm_dirty_ring_get_page(struct kvm_dirty_ring *ring,
+						   u32 offset)
+{
+	return NULL;
+}
+
+#endif /* CONFIG_HAVE_KVM_DIRTY_RING */
+
+#endif	/* KVM_DIRTY_RING_H */
@@ -63,6 +63,8 @@ enum mem_cgroup_events_index {
 	MEMCG_HIGH,
 	MEMCG_MAX,
 	MEMCG_OOM,
+	MEMCG_RECLAIM_STALL,	/* # of direct reclaim stalls at high/max */
+	MEMCG_RECLAIM_STALL_USEC, /* time spent in those stalls */
 	MEMCG_NR_EVENTS,
 };
 
@@ -73,6 +75,27 @@ void mem_cgroup_events(struct mem_cgroup *memcg,
 
 bool mem_cgroup_low(struct mem_cgroup *root, struct mem_cgroup *memcg);
 
+/*
+ * Reclaim up to @nr_pages from @memcg and its descendants on behalf of
+ * userspace (memory.reclaim), regardless of how far the group is from
+ * its limits. memory.low protection is honoured. Returns the number of
+ * pages reclaimed, or -EINTR if a signal arrived before any progress.
+ */
+long mem_cgroup_reclaim(struct mem_cgroup *memcg, unsigned long nr_pages);
+
+/*
+ * Account a charge that had to enter direct reclaim because it went
+ * over memory.high or memory.max. @start is the local_clock() value
+ * taken before reclaim.
+ */
+static inline void mem_cgroup_reclaim_stall(struct mem_cgroup *memcg,
+					    u64 start)
+{
+	mem_cgroup_events(memcg, MEMCG_RECLAIM_STALL, 1);
+	mem_cgroup_events(memcg, MEMCG_RECLAIM_STALL_USEC,
+			  div_u64(local_clock() - start, NSEC_PER_USEC));
+}
+
 int mem_cgroup_try_charge(struct page *page, struct mm_struct *mm,
 			  gfp_t gfp_mask, struct mem_cgroup **memcgp);
 void mem_cgroup_commit_charge(struct page *page, struct mem_cgroup *memcg,
@@ -207,6 +230,17 @@ static inline bool mem_cgroup_low(struct mem_cgroup *root,
 	return false;
 }
 
+static inline long mem_cgroup_reclaim(struct mem_cgroup *memcg,
+				      unsigned long nr_pages)
+{
+	return 0;
+}
+
+static inline void mem_cgroup_reclaim_stall(struct mem_cgroup *memcg,
+					    u64 start)
+{
+}
+
 static inline int mem_cgroup_try_charge(struct page *page, struct mm_struct *mm,
 					gfp_t gfp_mask,
 					struct mem_cgroup **memcgp)
@@ -22,12 +22,114 @@ static inline int page_is_file_cache(struct page *page)
 	return !PageSwapBacked(page);
 }
 
+#ifdef CONFIG_LRU_GEN
+
+extern bool lru_gen_enabled;
+extern void lru_gen_enable_lruvec(struct lruvec *lruvec);
+
+static inline int lru_gen_from_seq(unsigned long seq)
+{
+	return seq % MAX_NR_GENS;
+}
+
+/*
+ * Returns the generation @page is on, or -1 if it is not on a
+ * multi-gen LRU list.
+ */
+static inline int page_lru_gen(struct page *page)
+{
+	return (int)((READ_ONCE(page->flags) & LRU_GEN_MASK) >> LRU_GEN_PGOFF) - 1;
+}
+
+/*
+ * The other bits in page->flags are updated atomically behind our
+ * back, so the generation has to be swapped in with cmpxchg.
+ */
+static inline void page_set_lru_gen(struct page *page, int gen)
+{
+	unsigned long old_flags, flags;
+
+	do {
+		old_flags = flags = READ_ONCE(page->flags);
+		flags &= ~LRU_GEN_MASK;
+		flags |= (gen + 1UL) << LRU_GEN_PGOFF;
+	} while (cmpxchg(&page->flags, old_flags, flags) != old_flags);
+}
+
+/*
+ * Puts @page on a multi-gen LRU list if @lruvec uses them.  Pages that
+ * were active start in the youngest generation, the rest in the second
+ * oldest, so they have to be found accessed by the next aging in order
+ * to outlive the oldest generation.
+ *
+ * PG_active is left alone: the memcg and zone LRU size statistics stay
+ * indexed by page_lru().
+ */
+static inline bool lru_gen_add_page(struct page *page, struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int type = page_is_file_cache(page);
+	unsigned long seq;
+	int gen;
+
+	if (PageUnevictable(page))
+		return false;
+
+	if (unlikely(!lrugen->enabled)) {
+		if (!READ_ONCE(lru_gen_enabled))
+			return false;
+		lru_gen_enable_lruvec(lruvec);
+		if (!lrugen->enabled)
+			return false;
+	}
+
+	if (PageActive(page))
+		seq = lrugen->max_seq;
+	else
+		seq = lrugen->min_seq[type] + 1;
+	gen = lru_gen_from_seq(seq);
+
+	page_set_lru_gen(page, gen);
+	lrugen->nr_pages[gen][type] += hpage_nr_pages(page);
+	list_add(&page->lru, &lrugen->lists[gen][type]);
+	return true;
+}
+
+static inline bool lru_gen_del_page(struct page *page, struct lruvec *lruvec)
+{
+	int gen = page_lru_gen(page);
+
+	if (gen < 0)
+		return false;
+
+	page_set_lru_gen(page, -1);
+	lruvec->lrugen.nr_pages[gen][page_is_file_cache(page)] -=
+		hpage_nr_pages(page);
+	list_del(&page->lru);
+	return true;
+}
+
+#else /* CONFIG_LRU_GEN */
+
+static inline bool lru_gen_add_page(struct page *page, struct lruvec *lruvec)
+{
+	return false;
+}
+
+static inline bool lru_gen_del_page(struct page *page, struct lruvec *lruvec)
+{
+	return false;
+}
+
+#endif /* CONFIG_LRU_GEN */
+
 static __always_inline void add_page_to_lru_list(struct page *page,
 				struct lruvec *lruvec, enum lru_list lru)
 {
 	int nr_pages = hpage_nr_pages(page);
 	mem_cgroup_update_lru_size(lruvec, lru, nr_pages);
-	list_add(&page->lru, &lruvec->lists[lru]);
+	if (!lru_gen_add_page(page, lruvec))
+		list_add(&page->lru, &lruvec->lists[lru]);
 	__mod_zone_page_state(lruvec_zone(lruvec), NR_LRU_BASE + lru, nr_pages);
 }
 
@@ -36,7 +138,8 @@ static __always_inline void del_page_from_lru_list(struct page *page,
 {
 	int nr_pages = hpage_nr_pages(page);
 	mem_cgroup_update_lru_size(lruvec, lru, -nr_pages);
-	list_del(&page->lru);
+	if (!lru_gen_del_page(page, lruvec))
+		list_del(&page->lru);
 	__mod_zone_page_state(lruvec_zone(lruvec), NR_LRU_BASE + lru, -nr_pages);
 }
 
@@ -213,9 +213,48 @@ struct zone_reclaim_stat {
 	unsigned long		recent_scanned[2];
 };
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-generational LRU sorts the evictable pages of a lruvec into
+ * generations instead of the active/inactive lists.  The aging creates
+ * a new youngest generation and promotes pages found accessed by
+ * walking the page tables of the processes in the memcg; the eviction
+ * reclaims from the oldest generation.  At least MIN_NR_GENS and at most
+ * MAX_NR_GENS generations exist at a time, and a generation number is
+ * mapped to a list by seq % MAX_NR_GENS (see lru_gen_from_seq()).
+ *
+ * Anon and file pages share max_seq but age out independently, hence
+ * the separate min_seq.  Everything is protected by zone->lru_lock.
+ */
+#define MIN_NR_GENS		2U
+#define MAX_NR_GENS		4U
+
+#define LRU_GEN_ANON		0
+#define LRU_GEN_FILE		1
+#define ANON_AND_FILE		2
+
+struct lru_gen_struct {
+	/* the aging increments the youngest generation number */
+	unsigned long max_seq;
+	/* the eviction increments the oldest generation numbers */
+	unsigned long min_seq[ANON_AND_FILE];
+	/* the birth time of each generation in jiffies */
+	unsigned long timestamps[MAX_NR_GENS];
+	/* the multi-gen LRU lists */
+	struct list_head lists[MAX_NR_GENS][ANON_AND_FILE];
+	/* the number of pages on each of the above lists */
+	long nr_pages[MAX_NR_GENS][ANON_AND_FILE];
+	/* whether the lists above are in use instead of lruvec->lists[] */
+	bool enabled;
+};
+#endif
+
 struct lruvec {
 	struct list_head lists[NR_LRU_LISTS];
 	struct zone_reclaim_stat reclaim_stat;
+#ifdef CONFIG_LRU_GEN
+	struct lru_gen_struct lrugen;
+#endif
 #ifdef CONFIG_MEMCG
 	struct zone *zone;
 #endif
@@ -249,15 +288,91 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * The pcp lists cache every order up to PAGE_ALLOC_COSTLY_ORDER, one
+ * list per migrate type and order, plus a single list of pageblock
+ * sized pages for THP.  The order-0 lists come first, so lists[] is
+ * still indexed by the migrate type alone for them.
+ */
+#define NR_LOWORDER_PCP_LISTS	(MIGRATE_PCPTYPES * (PAGE_ALLOC_COSTLY_ORDER + 1))
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define NR_PCP_THP		1
+#else
+#define NR_PCP_THP		0
+#endif
+#define NR_PCP_LISTS		(NR_LOWORDER_PCP_LISTS + NR_PCP_THP)
+
+/*
+ * pcp->high is scaled between high_min and high_max: each batch freed
+ * without an allocation in between doubles the headroom through
+ * free_factor, an allocation brings it back down, and a zone under its
+ * low watermark is drained in pcp->batch sized chunks rather than in
+ * one go.
+ */
+#define PCP_FREE_FACTOR_MAX	5
+
 struct per_cpu_pages {
-	int count;		/* number of pages in the list */
+	int count;		/* number of pages in the lists */
 	int high;		/* high watermark, emptying needed */
+	int high_min;		/* lowest that high is scaled down to */
+	int high_max;		/* highest that high is scaled up to */
 	int batch;		/* chunk size for buddy add/remove */
+	u8 free_factor;		/* batches freed since the last allocation */
 
-	/* Lists of pages, one per migrate type stored on the pcp-lists */
-	struct list_head lists[MIGRATE_PCPTYPES];
+	/* Lists of pages, one per migrate type and order */
+	struct list_head lists[NR_PCP_LISTS];
 };
 
+static inline bool pcp_allowed_order(unsigned int order)
+{
+	if (order <= PAGE_ALLOC_COSTLY_ORDER)
+		return true;
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (order == pageblock_order)
+		return true;
+#endif
+	return false;
+}
+
+static inline unsigned int order_to_pindex(int migratetype, unsigned int order)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (order > PAGE_ALLOC_COSTLY_ORDER)
+		return NR_LOWORDER_PCP_LISTS;
+#endif
+	return order * MIGRATE_PCPTYPES + migratetype;
+}
+
+static inline unsigned int pindex_to_order(unsigned int pindex)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (pindex == NR_LOWORDER_PCP_LISTS)
+		return pageblock_order;
+#endif
+	return pindex / MIGRATE_PCPTYPES;
+}
+
+/* the number of pages that may sit on the pcp lists before a drain */
+static inline int pcp_high(struct per_cpu_pages *pcp)
+{
+	int high = pcp->high_min + (pcp->batch << pcp->free_factor);
+
+	return min(high, pcp->high_max);
+}
+
+/* called by the free path each time a batch goes onto the pcp lists */
+static inline void pcp_note_free(struct per_cpu_pages *pcp)
+{
+	if (pcp->free_factor < PCP_FREE_FACTOR_MAX)
+		pcp->free_factor++;
+}
+
+/* called by the allocation path when it takes from the pcp lists */
+static inline void pcp_note_alloc(struct per_cpu_pages *pcp)
+{
+	pcp->free_factor >>= 1;
+}
+
 struct per_cpu_pageset {
 	struct per_cpu_pages pcp;
 #ifdef CONFIG_NUMA
@@ -762,6 +877,14 @@ typedef struct pglist_data {
 	/* Number of pages migrated during the rate limiting time interval */
 	unsigned long numabalancing_migrate_nr_pages;
 #endif
+
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+	/*
+	 * If memory initialisation on large machines is deferred then this
+	 * is the first PFN that needs to be initialised.
+	 */
+	unsigned long first_deferred_pfn;
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
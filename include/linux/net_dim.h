@@ -0,0 +1,80 @@
+/*
+ * Dynamic interrupt moderation (net_dim) - Definitions
+ *
+ * net_dim picks an interrupt coalescing profile for a NIC completion
+ * queue from the traffic it sees.  The driver feeds it a sample of its
+ * packet, byte and interrupt (event) counters on every NAPI completion;
+ * once every NET_DIM_NEVENTS events net_dim compares the rates of the
+ * last interval with those of the one before and moves one profile to
+ * the left (less moderation, lower latency) or to the right (more
+ * moderation, higher packet rates), or parks on the profile that gave
+ * the best result.
+ *
+ * Changing the moderation usually means talking to the device, so a new
+ * profile is applied from a work item, through the ->apply callback the
+ * driver passed to net_dim_init().  Profiles are identified by their
+ * index, 0 to NET_DIM_PARAMS_NUM_PROFILES - 1; the driver either maps
+ * them to its own values or uses the defaults of net_dim_get_profile().
+ *
+ * net_dim() does no locking: it is meant to be called from the NAPI
+ * poll of the queue, which serializes it.
+ */
+
+#ifndef _LINUX_NET_DIM_H
+#define _LINUX_NET_DIM_H
+
+#include <linux/ktime.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+#define NET_DIM_PARAMS_NUM_PROFILES	5
+#define NET_DIM_NEVENTS			64
+
+struct net_dim_cq_moder {
+	u16	usec;
+	u16	pkts;
+};
+
+struct net_dim_sample {
+	ktime_t	time;
+	u32	pkt_ctr;
+	u32	byte_ctr;
+	u16	event_ctr;
+};
+
+struct net_dim_stats {
+	int	ppms;	/* packets per msec */
+	int	bpms;	/* bytes per msec */
+	int	epms;	/* events per msec */
+};
+
+struct net_dim {
+	u8			state;
+	struct net_dim_stats	prev_stats;
+	struct net_dim_sample	start_sample;
+	struct work_struct	work;
+	void			(*apply)(struct net_dim *dim,
+					 unsigned int profile_ix);
+	u8			profile_ix;
+	u8			tune_state;
+	u8			steps_right;
+	u8			steps_left;
+	u8			tired;
+};
+
+static inline void net_dim_sample(u16 event_ctr, u64 packets, u64 bytes,
+				  struct net_dim_sample *s)
+{
+	s->time	     = ktime_get();
+	s->pkt_ctr   = packets;
+	s->byte_ctr  = bytes;
+	s->event_ctr = event_ctr;
+}
+
+void net_dim_init(struct net_dim *dim, unsigned int profile_ix,
+		  void (*apply)(struct net_dim *dim, unsigned int profile_ix));
+void net_dim(struct net_dim *dim, struct net_dim_sample *end_sample);
+void net_dim_cancel(struct net_dim *dim);
+struct net_dim_cq_moder net_dim_get_profile(unsigned int profile_ix);
+
+#endif /* _LINUX_NET_DIM_H */
@@ -100,9 +100,15 @@ struct nvme_dev {
 	u32 stripe_size;
 	u32 page_size;
 	u16 oncs;
+	u16 oacs;
+	u32 sgls;
 	u16 abort_limit;
 	u8 event_limit;
 	u8 vwc;
+	u32 *dbbuf_dbs;
+	dma_addr_t dbbuf_dbs_dma_addr;
+	u32 *dbbuf_eis;
+	dma_addr_t dbbuf_eis_dma_addr;
 };
 
 /*
@@ -134,6 +140,7 @@ struct nvme_iod {
 	unsigned long private;	/* For the use of the submitter of the I/O */
 	int npages;		/* In the PRP list. 0 means small pool in use */
 	int offset;		/* Of PRP list */
+	int nr_sgl;		/* SGL descriptors, 0 if PRPs are used */
 	int nents;		/* Used in scatterlist */
 	int length;		/* Of data, in bytes */
 	dma_addr_t first_dma;
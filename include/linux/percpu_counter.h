@@ -41,13 +41,38 @@ void percpu_counter_destroy(struct percpu_counter *fbc);
 void percpu_counter_set(struct percpu_counter *fbc, s64 amount);
 void __percpu_counter_add(struct percpu_counter *fbc, s64 amount, s32 batch);
 s64 __percpu_counter_sum(struct percpu_counter *fbc);
-int percpu_counter_compare(struct percpu_counter *fbc, s64 rhs);
+int __percpu_counter_compare(struct percpu_counter *fbc, s64 rhs, s32 batch);
+s32 percpu_counter_limit_batch(struct percpu_counter *fbc, s64 limit);
+
+static inline int percpu_counter_compare(struct percpu_counter *fbc, s64 rhs)
+{
+	return __percpu_counter_compare(fbc, rhs, percpu_counter_batch);
+}
 
 static inline void percpu_counter_add(struct percpu_counter *fbc, s64 amount)
 {
 	__percpu_counter_add(fbc, amount, percpu_counter_batch);
 }
 
+/*
+ * For counters checked against @limit with percpu_counter_compare_limit():
+ * the batch shrinks as the counter gets close to @limit, so the comparison
+ * rarely has to sum up the per-cpu counts.
+ */
+static inline void percpu_counter_add_limit(struct percpu_counter *fbc,
+					    s64 amount, s64 limit)
+{
+	__percpu_counter_add(fbc, amount,
+			     percpu_counter_limit_batch(fbc, limit));
+}
+
+static inline int percpu_counter_compare_limit(struct percpu_counter *fbc,
+					       s64 limit)
+{
+	return __percpu_counter_compare(fbc, limit,
+					percpu_counter_limit_batch(fbc, limit));
+}
+
 static inline s64 percpu_counter_sum_positive(struct percpu_counter *fbc)
 {
 	s64 ret = __percpu_counter_sum(fbc);
@@ -116,6 +141,18 @@ static inline int percpu_counter_compare(struct percpu_counter *fbc, s64 rhs)
 		return 0;
 }
 
+static inline int
+__percpu_counter_compare(struct percpu_counter *fbc, s64 rhs, s32 batch)
+{
+	return percpu_counter_compare(fbc, rhs);
+}
+
+static inline int percpu_counter_compare_limit(struct percpu_counter *fbc,
+					       s64 limit)
+{
+	return percpu_counter_compare(fbc, limit);
+}
+
 static inline void
 percpu_counter_add(struct percpu_counter *fbc, s64 amount)
 {
@@ -130,6 +167,12 @@ __percpu_counter_add(struct percpu_counter *fbc, s64 amount, s32 batch)
 	percpu_counter_add(fbc, amount);
 }
 
+static inline void
+percpu_counter_add_limit(struct percpu_counter *fbc, s64 amount, s64 limit)
+{
+	percpu_counter_add(fbc, amount);
+}
+
 static inline s64 percpu_counter_read(struct percpu_counter *fbc)
 {
 	return fbc->count;
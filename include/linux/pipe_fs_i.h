@@ -17,6 +17,9 @@
  *	@flags: pipe buffer flags. See above.
  *	@private: private data owned by the ops.
  **/
+/* Number of released pages a pipe keeps around for its writers */
+#define PIPE_TMP_PAGES	4
+
 struct pipe_buffer {
 	struct page *page;
 	unsigned int offset, len;
@@ -32,11 +35,12 @@ struct pipe_buffer {
  *	@nrbufs: the number of non-empty pipe buffers in this pipe
  *	@buffers: total number of buffers (should be a power of 2)
  *	@curbuf: the current pipe buffer entry
- *	@tmp_page: cached released page
+ *	@tmp_page: cached released pages, reused by the next writes
  *	@readers: number of current readers of this pipe
  *	@writers: number of current writers of this pipe
  *	@files: number of struct file referring this pipe (protected by ->i_lock)
  *	@waiting_writers: number of writers blocked waiting for room
+ *	@poll_usage: the pipe has been polled, wake waiters on every change
  *	@r_counter: reader counter
  *	@w_counter: writer counter
  *	@fasync_readers: reader side fasync
@@ -51,9 +55,10 @@ struct pipe_inode_info {
 	unsigned int writers;
 	unsigned int files;
 	unsigned int waiting_writers;
+	bool poll_usage;
 	unsigned int r_counter;
 	unsigned int w_counter;
-	struct page *tmp_page;
+	struct page *tmp_page[PIPE_TMP_PAGES];
 	struct fasync_struct *fasync_readers;
 	struct fasync_struct *fasync_writers;
 	struct pipe_buffer *bufs;
@@ -0,0 +1,69 @@
+/*
+ * RCU-based infrastructure for lightweight reader-writer locking
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you can access it online at
+ * http://www.gnu.org/licenses/gpl-2.0.html.
+ */
+
+#ifndef _LINUX_RCU_SYNC_H_
+#define _LINUX_RCU_SYNC_H_
+
+#include <linux/types.h>
+#include <linux/wait.h>
+
+/*
+ * Structure to mediate between updaters and fastpath-using readers.
+ * Readers that find the rcu_sync idle may use their fast path, within
+ * an RCU-sched read-side critical section (preemption disabled).  An
+ * updater's rcu_sync_enter() returns only once all such readers have
+ * finished, and the fast path stays disabled until a grace period
+ * after the matching rcu_sync_exit().
+ */
+struct rcu_sync {
+	int			gp_state;
+	int			gp_count;
+	wait_queue_head_t	gp_wait;
+
+	int			cb_state;
+	struct rcu_head		cb_head;
+};
+
+/**
+ * rcu_sync_is_idle() - Are readers permitted to use their fastpaths?
+ * @rsp: Pointer to rcu_sync structure to use for synchronization
+ *
+ * Returns true if readers are permitted to use their fastpaths.
+ * Must be invoked with preemption disabled.
+ */
+static inline bool rcu_sync_is_idle(struct rcu_sync *rsp)
+{
+	return !ACCESS_ONCE(rsp->gp_state); /* GP_IDLE */
+}
+
+extern void rcu_sync_init(struct rcu_sync *rsp);
+extern void rcu_sync_enter(struct rcu_sync *rsp);
+extern void rcu_sync_exit(struct rcu_sync *rsp);
+extern void rcu_sync_dtor(struct rcu_sync *rsp);
+
+#define __RCU_SYNC_INITIALIZER(name) {					\
+		.gp_state = 0,						\
+		.gp_count = 0,						\
+		.gp_wait = __WAIT_QUEUE_HEAD_INITIALIZER(name.gp_wait),	\
+		.cb_state = 0,						\
+	}
+
+#define DEFINE_RCU_SYNC(name)	\
+	struct rcu_sync name = __RCU_SYNC_INITIALIZER(name)
+
+#endif /* _LINUX_RCU_SYNC_H_ */
@@ -30,6 +30,7 @@ struct rw_semaphore {
 	raw_spinlock_t wait_lock;
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	struct optimistic_spin_queue osq; /* spinner MCS lock */
+	bool handoff;	/* a starved writer waits, no lock stealing */
 	/*
 	 * Write owner. Used as a speculative check to see
 	 * if the owner is running on the cpu.
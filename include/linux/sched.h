@@ -607,6 +607,7 @@ struct thread_group_cputimer {
 };
 
 #include <linux/rwsem.h>
+#include <linux/percpu-rwsem.h>
 struct autogroup;
 
 /*
@@ -742,19 +743,6 @@ struct signal_struct {
 	unsigned audit_tty_log_passwd;
 	struct tty_audit_buf *tty_audit_buf;
 #endif
-#ifdef CONFIG_CGROUPS
-	/*
-	 * group_rwsem prevents new tasks from entering the threadgroup and
-	 * member tasks from exiting,a more specifically, setting of
-	 * PF_EXITING.  fork and exit paths are protected with this rwsem
-	 * using threadgroup_change_begin/end().  Users which require
-	 * threadgroup to remain stable should use threadgroup_[un]lock()
-	 * which also takes care of exec path.  Currently, cgroup is the
-	 * only user.
-	 */
-	struct rw_semaphore group_rwsem;
-#endif
-
 	oom_flags_t oom_flags;
 	short oom_score_adj;		/* OOM kill score adjustment */
 	short oom_score_adj_min;	/* OOM kill score adjustment min value.
@@ -820,7 +808,7 @@ struct user_struct {
 	struct hlist_node uidhash_node;
 	kuid_t uid;
 
-#ifdef CONFIG_PERF_EVENTS
+#if defined(CONFIG_PERF_EVENTS) || defined(CONFIG_NET)
 	atomic_long_t locked_vm;
 #endif
 };
@@ -989,6 +977,9 @@ struct sched_domain {
 	u64 max_newidle_lb_cost;
 	unsigned long next_decay_max_lb_cost;
 
+	/* select_idle_cpu() scan cost, only maintained on the LLC domain */
+	u64 avg_scan_cost;
+
 #ifdef CONFIG_SCHEDSTATS
 	/* load_balance() stats */
 	unsigned int lb_count[CPU_MAX_IDLE_TYPES];
@@ -1290,6 +1281,50 @@ union rcu_special {
 };
 struct rcu_node;
 
+/*
+ * Wake-queues are lists of tasks with a pending wakeup, whose
+ * callers have already marked the task as woken internally,
+ * and can thus carry on. A common use case is being able to
+ * do the wakeups once the corresponding user lock has been
+ * released.
+ *
+ * We hold reference to each task in the list across the wakeup,
+ * thus guaranteeing that the memory is still valid by the time
+ * the actual wakeups are performed in wake_up_q().
+ *
+ * One per task suffices, because there's never a need for a task to be
+ * in two wake queues simultaneously; it is forbidden to abandon a task
+ * in a wake queue (a call to wake_up_q() _must_ follow), so if a task is
+ * already in a wake queue, the wakeup will happen soon and the second
+ * waker can just skip it.
+ *
+ * The WAKE_Q macro declares and initializes the list head.
+ * wake_up_q() does NOT reinitialize the list; it's expected to be
+ * called near the end of a function, where the fact that the queue is
+ * not used again will be easy to see by inspection.
+ *
+ * Note that this can cause spurious wakeups. schedule() callers
+ * must ensure the call is done inside a loop, confirming that the
+ * wakeup condition has in fact occurred.
+ */
+struct wake_q_node {
+	struct wake_q_node *next;
+};
+
+struct wake_q_head {
+	struct wake_q_node *first;
+	struct wake_q_node **lastp;
+};
+
+#define WAKE_Q_TAIL ((struct wake_q_node *) 0x01)
+
+#define WAKE_Q(name)					\
+	struct wake_q_head name = { WAKE_Q_TAIL, &name.first }
+
+extern void wake_q_add(struct wake_q_head *head,
+		       struct task_struct *task);
+extern void wake_up_q(struct wake_q_head *head);
+
 enum perf_event_task_context {
 	perf_invalid_context = -1,
 	perf_hw_context = 0,
@@ -1356,6 +1391,12 @@ struct task_struct {
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 	struct sched_info sched_info;
 #endif
+#ifdef CONFIG_PSI
+	/* Pressure stall state */
+	unsigned int psi_flags;
+	/* Migrated during wakeup, psi_enqueue() restores stall state */
+	unsigned int sched_psi_wake_requeue;
+#endif
 
 	struct list_head tasks;
 #ifdef CONFIG_SMP
@@ -1519,6 +1560,8 @@ struct task_struct {
 	/* Protection of the PI data structures: */
 	raw_spinlock_t pi_lock;
 
+	struct wake_q_node wake_q;
+
 #ifdef CONFIG_RT_MUTEXES
 	/* PI waiters blocked on a rt_mutex held by this task */
 	struct rb_root pi_waiters;
@@ -1531,6 +1574,10 @@ struct task_struct {
 	/* mutex deadlock detection */
 	struct mutex_waiter *blocked_on;
 #endif
+#ifdef CONFIG_HOTPLUG_CPU
+	/* get_online_cpus() nesting, see kernel/cpu.c */
+	int cpuhp_ref;
+#endif
 #ifdef CONFIG_TRACE_IRQFLAGS
 	unsigned int irq_events;
 	unsigned long hardirq_enable_ip;
@@ -1654,6 +1701,8 @@ struct task_struct {
 	unsigned long numa_faults_locality[3];
 
 	unsigned long numa_pages_migrated;
+	/* placements that left the group node for memory bandwidth */
+	unsigned long numa_bw_spread;
 #endif /* CONFIG_NUMA_BALANCING */
 
 	struct rcu_head rcu;
@@ -1992,6 +2041,7 @@ extern void thread_group_cputime_adjusted(struct task_struct *p, cputime_t *ut,
 #define PF_KTHREAD	0x00200000	/* I am a kernel thread */
 #define PF_RANDOMIZE	0x00400000	/* randomize virtual address space */
 #define PF_SWAPWRITE	0x00800000	/* Allowed to write to swap */
+#define PF_MEMSTALL	0x01000000	/* Stalled due to lack of memory */
 #define PF_NO_SETAFFINITY 0x04000000	/* Userland is not allowed to meddle with cpus_allowed */
 #define PF_MCE_EARLY    0x08000000      /* Early kill for mce process policy */
 #define PF_MUTEX_TESTER	0x20000000	/* Thread belongs to the rt mutex tester */
@@ -2251,7 +2301,6 @@ static inline void wake_up_nohz_cpu(int cpu) { }
 
 #ifdef CONFIG_NO_HZ_FULL
 extern bool sched_can_stop_tick(void);
-extern u64 scheduler_tick_max_deferment(void);
 #else
 static inline bool sched_can_stop_tick(void) { return false; }
 #endif
@@ -2649,13 +2698,24 @@ static inline void unlock_task_sighand(struct task_struct *tsk,
 }
 
 #ifdef CONFIG_CGROUPS
+/*
+ * cgroup_threadgroup_rwsem prevents new tasks from entering a threadgroup
+ * and member tasks from exiting, more specifically, setting of
+ * PF_EXITING.  fork and exit paths are protected with this rwsem using
+ * threadgroup_change_begin/end().  It is a single percpu_rw_semaphore
+ * for all threadgroups, so that those read-side paths only touch a
+ * per-CPU counter, at the price of threadgroup_lock() excluding changes
+ * to every threadgroup.  Currently, cgroup is the only writer.
+ */
+extern struct percpu_rw_semaphore cgroup_threadgroup_rwsem;
+
 static inline void threadgroup_change_begin(struct task_struct *tsk)
 {
-	down_read(&tsk->signal->group_rwsem);
+	percpu_down_read(&cgroup_threadgroup_rwsem);
 }
 static inline void threadgroup_change_end(struct task_struct *tsk)
 {
-	up_read(&tsk->signal->group_rwsem);
+	percpu_up_read(&cgroup_threadgroup_rwsem);
 }
 
 /**
@@ -2673,10 +2733,13 @@ static inline void threadgroup_change_end(struct task_struct *tsk)
  *
  * de_thread() does threadgroup_change_{begin|end}() when a non-leader
  * sub-thread becomes a new leader.
+ *
+ * All threadgroups share cgroup_threadgroup_rwsem, so this actually locks
+ * every threadgroup in the system.
  */
 static inline void threadgroup_lock(struct task_struct *tsk)
 {
-	down_write(&tsk->signal->group_rwsem);
+	percpu_down_write(&cgroup_threadgroup_rwsem);
 }
 
 /**
@@ -2687,7 +2750,7 @@ static inline void threadgroup_lock(struct task_struct *tsk)
  */
 static inline void threadgroup_unlock(struct task_struct *tsk)
 {
-	up_write(&tsk->signal->group_rwsem);
+	percpu_up_write(&cgroup_threadgroup_rwsem);
 }
 #else
 static inline void threadgroup_change_begin(struct task_struct *tsk) {}
@@ -3025,6 +3088,18 @@ static inline void set_task_cpu(struct task_struct *p, unsigned int cpu)
 
 #endif /* CONFIG_SMP */
 
+/*
+ * In order to reduce various lock holder preemption latencies provide an
+ * interface to see if a vCPU is currently running or not.
+ *
+ * This allows us to terminate optimistic spin loops and block, analogous to
+ * the native optimistic spin heuristic of testing if the lock owner task is
+ * running or not.
+ */
+#ifndef vcpu_is_preempted
+# define vcpu_is_preempted(cpu)	false
+#endif
+
 extern long sched_setaffinity(pid_t pid, const struct cpumask *new_mask);
 extern long sched_getaffinity(pid_t pid, struct cpumask *mask);
 
@@ -3107,4 +3182,13 @@ static inline unsigned long rlimit_max(unsigned int limit)
 	return task_rlimit_max(current, limit);
 }
 
+#ifdef CONFIG_CPU_FREQ
+struct update_util_data {
+	void (*func)(struct update_util_data *data,
+		     u64 time, unsigned long util, unsigned long max);
+};
+
+void cpufreq_set_update_util_data(int cpu, struct update_util_data *data);
+#endif /* CONFIG_CPU_FREQ */
+
 #endif
@@ -290,6 +290,38 @@ void *__kmalloc(size_t size, gfp_t flags);
 void *kmem_cache_alloc(struct kmem_cache *, gfp_t flags);
 void kmem_cache_free(struct kmem_cache *, void *);
 
+/*
+ * Bulk allocation and freeing operations.  Callers that handle objects in
+ * batches should use these so the allocator can amortize its per-call
+ * cost; the generic versions simply loop over the single-object calls.
+ *
+ * kmem_cache_alloc_bulk() either fills all of @p or frees what it got
+ * and returns false.
+ */
+static inline void kmem_cache_free_bulk(struct kmem_cache *s, size_t size,
+					void **p)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		kmem_cache_free(s, p[i]);
+}
+
+static inline bool kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags,
+					 size_t size, void **p)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		p[i] = kmem_cache_alloc(s, flags);
+		if (unlikely(!p[i])) {
+			kmem_cache_free_bulk(s, i, p);
+			return false;
+		}
+	}
+	return true;
+}
+
 #ifdef CONFIG_NUMA
 void *__kmalloc_node(size_t size, gfp_t flags, int node);
 void *kmem_cache_alloc_node(struct kmem_cache *, gfp_t flags, int node);
@@ -32,6 +32,9 @@ struct kstat {
 	struct timespec	ctime;
 	unsigned long	blksize;
 	unsigned long long	blocks;
+	u32		request_mask;	/* STATX_* the caller asked for */
+	u32		result_mask;	/* STATX_* the filesystem filled in */
+	unsigned int	query_flags;	/* AT_STATX_SYNC_* */
 };
 
 #endif
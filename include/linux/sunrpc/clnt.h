@@ -28,6 +28,12 @@
 
 struct rpc_inode;
 
+/*
+ * Upper bound on the number of transports an rpc_clnt will spread its
+ * requests across (see rpc_create_args.nconnect).
+ */
+#define RPC_MAX_NCONNECT	16
+
 /*
  * The high-level client handle
  */
@@ -38,6 +44,9 @@ struct rpc_clnt {
 	struct list_head	cl_tasks;	/* List of tasks */
 	spinlock_t		cl_lock;	/* spinlock */
 	struct rpc_xprt __rcu *	cl_xprt;	/* transport */
+	unsigned int		cl_nr_extra_xprt;
+	atomic_t		cl_xprt_rr;	/* round-robin cursor */
+	struct rpc_xprt *	cl_extra_xprt[RPC_MAX_NCONNECT - 1];
 	struct rpc_procinfo *	cl_procinfo;	/* procedure info */
 	u32			cl_prog,	/* RPC program number */
 				cl_vers,	/* RPC version number */
@@ -120,6 +129,7 @@ struct rpc_create_args {
 	unsigned long		flags;
 	char			*client_name;
 	struct svc_xprt		*bc_xprt;	/* NFSv4.1 backchannel */
+	unsigned int		nconnect;	/* transports to open, 0 == 1 */
 };
 
 /* Values for "flags" field */
@@ -146,6 +156,8 @@ int		rpc_switch_client_transport(struct rpc_clnt *,
 				struct xprt_create *,
 				const struct rpc_timeout *);
 
+struct rpc_xprt	*rpc_clnt_pick_xprt(struct rpc_clnt *);
+
 void		rpc_shutdown_client(struct rpc_clnt *);
 void		rpc_release_client(struct rpc_clnt *);
 void		rpc_task_release_client(struct rpc_task *);
@@ -350,6 +350,17 @@ extern void check_move_unevictable_pages(struct page **, int nr_pages);
 
 extern int kswapd_run(int nid);
 extern void kswapd_stop(int nid);
+
+/* linux/mm/lru_gen.c */
+#ifdef CONFIG_LRU_GEN
+extern void lru_gen_age_memcg(struct mem_cgroup *memcg);
+extern unsigned long lru_gen_isolate_pages(struct lruvec *lruvec, int type,
+					   unsigned long nr_to_scan,
+					   struct list_head *dst,
+					   unsigned long *nr_scanned,
+					   isolate_mode_t mode);
+#endif
+
 #ifdef CONFIG_MEMCG
 extern int mem_cgroup_swappiness(struct mem_cgroup *mem);
 #else
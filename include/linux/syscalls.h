@@ -66,6 +66,11 @@ struct perf_event_attr;
 struct file_handle;
 struct sigaltstack;
 union bpf_attr;
+struct io_uring_params;
+struct spawn_action;
+struct statx;
+struct linux_dirent_statx;
+struct prefetch_range;
 
 #include <linux/types.h>
 #include <linux/aio_abi.h>
@@ -884,4 +889,24 @@ asmlinkage long sys_execveat(int dfd, const char __user *filename,
 			const char __user *const __user *argv,
 			const char __user *const __user *envp, int flags);
 
+asmlinkage long sys_io_uring_setup(u32 entries,
+				struct io_uring_params __user *p);
+asmlinkage long sys_io_uring_enter(unsigned int fd, u32 to_submit,
+				u32 min_complete, u32 flags,
+				const sigset_t __user *sig, size_t sigsz);
+asmlinkage long sys_userfaultfd(int flags);
+asmlinkage long sys_spawn(const char __user *filename,
+			  const char __user *const __user *argv,
+			  const char __user *const __user *envp,
+			  const struct spawn_action __user *actions,
+			  unsigned int nr_actions, unsigned int flags);
+asmlinkage long sys_statx(int dfd, const char __user *path, unsigned flags,
+			  unsigned mask, struct statx __user *buffer);
+asmlinkage long sys_getdents_statx(unsigned int fd,
+				struct linux_dirent_statx __user *dirent,
+				unsigned int count, unsigned int mask,
+				unsigned int flags);
+asmlinkage long sys_prefetch(int fd, const struct prefetch_range __user *ranges,
+			     unsigned int nr_ranges, unsigned int flags);
+
 #endif
@@ -56,6 +56,11 @@
  *      This returns a pointer to the bus name a la pci_name from which
  *      the caller can then copy.
  * @set_vq_affinity: set the affinity for a virtqueue.
+ * @set_vq_managed_affinity: pin the interrupt of a virtqueue to a cpumask.
+ *	vq: the virtqueue
+ *	mask: the cpumask, or NULL to release the interrupt
+ *	Only done if the virtqueue has an interrupt of its own; the mask has
+ *	to stay valid until called again with NULL or the vqs are deleted.
  */
 typedef void vq_callback_t(struct virtqueue *);
 struct virtio_config_ops {
@@ -76,6 +81,8 @@ struct virtio_config_ops {
 	int (*finalize_features)(struct virtio_device *vdev);
 	const char *(*bus_name)(struct virtio_device *vdev);
 	int (*set_vq_affinity)(struct virtqueue *vq, int cpu);
+	int (*set_vq_managed_affinity)(struct virtqueue *vq,
+				       const struct cpumask *mask);
 };
 
 /* If driver didn't advertise the feature, it will never appear. */
@@ -205,6 +212,24 @@ int virtqueue_set_affinity(struct virtqueue *vq, int cpu)
 	return 0;
 }
 
+/**
+ * virtqueue_set_managed_affinity - pin the interrupt of a virtqueue
+ * @vq: the virtqueue
+ * @mask: the cpus, e.g. the blk-mq hctx->cpumask the virtqueue serves
+ *
+ * Like virtqueue_set_affinity(), this is best-effort, but the affinity is
+ * owned by the kernel afterwards, see irq_set_managed_affinity().
+ */
+static inline
+int virtqueue_set_managed_affinity(struct virtqueue *vq,
+				   const struct cpumask *mask)
+{
+	struct virtio_device *vdev = vq->vdev;
+	if (vdev->config->set_vq_managed_affinity)
+		return vdev->config->set_vq_managed_affinity(vq, mask);
+	return 0;
+}
+
 /* Memory accessors */
 static inline u16 virtio16_to_cpu(struct virtio_device *vdev, __virtio16 val)
 {
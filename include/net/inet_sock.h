@@ -124,6 +124,8 @@ struct inet_cork {
 	__u8			ttl;
 	__s16			tos;
 	char			priority;
+	__u16			gso_size;
+	u64			transmit_time;
 };
 
 struct inet_cork_full {
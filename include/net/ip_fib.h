@@ -194,8 +194,16 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 		     struct fib_result *res, int fib_flags);
 int fib_table_insert(struct fib_table *, struct fib_config *);
 int fib_table_delete(struct fib_table *, struct fib_config *);
+
+/* restricts a route dump, zero fields match everything */
+struct fib_dump_filter {
+	u32			table_id;
+	int			ifindex;
+};
+
 int fib_table_dump(struct fib_table *table, struct sk_buff *skb,
-		   struct netlink_callback *cb);
+		   struct netlink_callback *cb,
+		   const struct fib_dump_filter *filter);
 int fib_table_flush(struct fib_table *table);
 struct fib_table *fib_trie_unmerge(struct fib_table *main_tb);
 void fib_table_flush_external(struct fib_table *table);
@@ -12,12 +12,19 @@
 #include <linux/netfilter/nf_conntrack_tuple_common.h>
 #include <net/netfilter/nf_conntrack_extend.h>
 
+enum nf_ct_ecache_state {
+	NFCT_ECACHE_UNKNOWN,		/* destroy event not sent */
+	NFCT_ECACHE_DESTROY_FAIL,	/* tried but failed to send destroy event */
+	NFCT_ECACHE_DESTROY_SENT,	/* sent destroy event after failure */
+};
+
 struct nf_conntrack_ecache {
 	unsigned long cache;	/* bitops want long */
 	unsigned long missed;	/* missed events */
 	u16 ctmask;		/* bitmask of ct events to be delivered */
 	u16 expmask;		/* bitmask of expect events to be delivered */
 	u32 portid;		/* netlink portid of destroyer */
+	enum nf_ct_ecache_state state; /* ecache worker redelivery state */
 };
 
 static inline struct nf_conntrack_ecache *
@@ -110,7 +117,9 @@ nf_conntrack_eventmask_report(unsigned int eventmask,
 	if (e == NULL)
 		goto out_unlock;
 
-	if (nf_ct_is_confirmed(ct) && !nf_ct_is_dying(ct)) {
+	/* The dying bit is set before the destroy event is sent */
+	if (nf_ct_is_confirmed(ct) &&
+	    (!nf_ct_is_dying(ct) || eventmask & (1 << IPCT_DESTROY))) {
 		struct nf_ct_event item = {
 			.ct 	= ct,
 			.portid	= e->portid ? e->portid : portid,
@@ -129,11 +138,13 @@ nf_conntrack_eventmask_report(unsigned int eventmask,
 				/* This is a destroy event that has been
 				 * triggered by a process, we store the PORTID
 				 * to include it in the retransmission. */
-				if (eventmask & (1 << IPCT_DESTROY) &&
-				    e->portid == 0 && portid != 0)
-					e->portid = portid;
-				else
+				if (eventmask & (1 << IPCT_DESTROY)) {
+					if (e->portid == 0 && portid != 0)
+						e->portid = portid;
+					e->state = NFCT_ECACHE_DESTROY_FAIL;
+				} else {
 					e->missed |= eventmask;
+				}
 			} else
 				e->missed &= ~missed;
 			spin_unlock_bh(&ct->lock);
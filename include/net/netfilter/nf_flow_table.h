@@ -0,0 +1,138 @@
+#ifndef _NF_FLOW_TABLE_H
+#define _NF_FLOW_TABLE_H
+
+#include <linux/in.h>
+#include <linux/in6.h>
+#include <linux/netdevice.h>
+#include <linux/rhashtable.h>
+#include <linux/rcupdate.h>
+#include <linux/workqueue.h>
+#include <linux/netfilter/nf_conntrack_tuple_common.h>
+#include <net/dst.h>
+
+struct nf_conn;
+
+/*
+ * A flow table caches everything needed to forward packets of an
+ * established connection: the route, the NAT mangling and the output
+ * device.  Packets hitting an entry bypass the rest of the IP forwarding
+ * path and the netfilter hooks, conntrack included.
+ */
+struct nf_flowtable {
+	struct rhashtable		rhashtable;
+	struct delayed_work		gc_work;
+	unsigned int			flags;
+	struct net			*net;
+
+	/* deferred ndo_flow_offload calls, these may sleep */
+	spinlock_t			hw_lock;
+	struct list_head		hw_list;
+	struct work_struct		hw_work;
+};
+
+enum nf_flowtable_flags {
+	NF_FLOWTABLE_F_HW		= 0x1,
+};
+
+enum flow_offload_tuple_dir {
+	FLOW_OFFLOAD_DIR_ORIGINAL = IP_CT_DIR_ORIGINAL,
+	FLOW_OFFLOAD_DIR_REPLY = IP_CT_DIR_REPLY,
+	FLOW_OFFLOAD_DIR_MAX = IP_CT_DIR_MAX
+};
+
+struct flow_offload_tuple {
+	union {
+		struct in_addr		src_v4;
+		struct in6_addr		src_v6;
+	};
+	union {
+		struct in_addr		dst_v4;
+		struct in6_addr		dst_v6;
+	};
+	struct {
+		__be16			src_port;
+		__be16			dst_port;
+	};
+
+	int				iifidx;
+
+	u8				l3proto;
+	u8				l4proto;
+
+	/* All members above are the lookup key, keep dir first below */
+	u8				dir;
+
+	u16				mtu;
+	int				oifidx;
+
+	struct dst_entry		*dst_cache;
+};
+
+struct flow_offload_tuple_rhash {
+	struct rhash_head		node;
+	struct flow_offload_tuple	tuple;
+};
+
+/* Bits in flow_offload->flags */
+enum nf_flow_flags {
+	NF_FLOW_SNAT,
+	NF_FLOW_DNAT,
+	NF_FLOW_TEARDOWN,	/* hand back to conntrack at next gc run */
+	NF_FLOW_DYING,		/* unhashed, waiting to be freed */
+	NF_FLOW_HW,		/* installed in hardware */
+};
+
+struct flow_offload {
+	struct flow_offload_tuple_rhash		tuplehash[FLOW_OFFLOAD_DIR_MAX];
+	struct nf_conn				*ct;
+	unsigned long				flags;
+	unsigned long				timeout;
+	struct list_head			hw_list;
+	struct rcu_head				rcu_head;
+};
+
+/* idle time after which a flow is handed back to conntrack */
+#define NF_FLOW_TIMEOUT (30 * HZ)
+
+struct nf_flow_route {
+	struct {
+		struct dst_entry	*dst;
+		int			ifindex;
+	} tuple[FLOW_OFFLOAD_DIR_MAX];
+};
+
+struct flow_offload *flow_offload_alloc(struct nf_conn *ct,
+					struct nf_flow_route *route);
+void flow_offload_free(struct flow_offload *flow);
+
+int flow_offload_add(struct nf_flowtable *flow_table,
+		     struct flow_offload *flow);
+void flow_offload_del(struct nf_flowtable *flow_table,
+		      struct flow_offload *flow);
+struct flow_offload_tuple_rhash *
+flow_offload_lookup(struct nf_flowtable *flow_table,
+		    struct flow_offload_tuple *tuple);
+
+static inline void flow_offload_teardown(struct flow_offload *flow)
+{
+	set_bit(NF_FLOW_TEARDOWN, &flow->flags);
+}
+
+static inline void flow_offload_refresh(struct flow_offload *flow)
+{
+	flow->timeout = jiffies + NF_FLOW_TIMEOUT;
+}
+
+static inline struct flow_offload *
+flow_offload_from_tuplehash(struct flow_offload_tuple_rhash *tuplehash)
+{
+	int dir = tuplehash->tuple.dir;
+
+	return container_of(tuplehash, struct flow_offload, tuplehash[dir]);
+}
+
+int nf_flow_table_init(struct nf_flowtable *flow_table, struct net *net,
+		       unsigned int flags);
+void nf_flow_table_free(struct nf_flowtable *flow_table);
+
+#endif /* _NF_FLOW_TABLE_H */
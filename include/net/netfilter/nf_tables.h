@@ -156,6 +156,7 @@ struct nft_userdata {
  *	struct nft_set_elem - generic representation of set elements
  *
  *	@key: element key
+ *	@key_end: closing element key
  *	@priv: element private data and extensions
  */
 struct nft_set_elem {
@@ -163,6 +164,10 @@ struct nft_set_elem {
 		u32		buf[NFT_DATA_VALUE_MAXLEN / sizeof(u32)];
 		struct nft_data	val;
 	} key;
+	union {
+		u32		buf[NFT_DATA_VALUE_MAXLEN / sizeof(u32)];
+		struct nft_data	val;
+	} key_end;
 	void			*priv;
 };
 
@@ -183,11 +188,15 @@ struct nft_set_iter {
  *	@klen: key length
  *	@dlen: data length
  *	@size: number of set elements
+ *	@field_len: length of each field in concatenation, bytes
+ *	@field_count: number of concatenated fields in element
  */
 struct nft_set_desc {
 	unsigned int		klen;
 	unsigned int		dlen;
 	unsigned int		size;
+	u8			field_len[NFT_REG32_COUNT];
+	u8			field_count;
 };
 
 /**
@@ -226,6 +235,7 @@ struct nft_expr;
  *	@activate: activate new element in the next generation
  *	@deactivate: deactivate element in the next generation
  *	@remove: remove element from set
+ *	@commit: publish pending changes after a transaction (optional)
  *	@walk: iterate over all set elemeennts
  *	@privsize: function to return size of set private data
  *	@init: initialize private data of new set instance
@@ -256,6 +266,7 @@ struct nft_set_ops {
 						      const struct nft_set_elem *elem);
 	void				(*remove)(const struct nft_set *set,
 						  const struct nft_set_elem *elem);
+	void				(*commit)(const struct nft_set *set);
 	void				(*walk)(const struct nft_ctx *ctx,
 						const struct nft_set *set,
 						struct nft_set_iter *iter);
@@ -297,6 +308,9 @@ void nft_unregister_set(struct nft_set_ops *ops);
  * 	@flags: set flags
  * 	@klen: key length
  * 	@dlen: data length
+ *	@field_len: length of each field in concatenation, bytes
+ *	@field_count: number of concatenated fields in element
+ *	@pending_update: list node for sets to commit at the end of a transaction
  * 	@data: private set data
  */
 struct nft_set {
@@ -317,6 +331,9 @@ struct nft_set {
 	u16				flags;
 	u8				klen;
 	u8				dlen;
+	u8				field_len[NFT_REG32_COUNT];
+	u8				field_count;
+	struct list_head		pending_update;
 	unsigned char			data[]
 		__attribute__((aligned(__alignof__(u64))));
 };
@@ -366,6 +383,7 @@ void nf_tables_unbind_set(const struct nft_ctx *ctx, struct nft_set *set,
  *	enum nft_set_extensions - set extension type IDs
  *
  *	@NFT_SET_EXT_KEY: element key
+ *	@NFT_SET_EXT_KEY_END: upper bound element key, for ranges
  *	@NFT_SET_EXT_DATA: mapping data
  *	@NFT_SET_EXT_FLAGS: element flags
  *	@NFT_SET_EXT_TIMEOUT: element timeout
@@ -376,6 +394,7 @@ void nf_tables_unbind_set(const struct nft_ctx *ctx, struct nft_set *set,
  */
 enum nft_set_extensions {
 	NFT_SET_EXT_KEY,
+	NFT_SET_EXT_KEY_END,
 	NFT_SET_EXT_DATA,
 	NFT_SET_EXT_FLAGS,
 	NFT_SET_EXT_TIMEOUT,
@@ -468,6 +487,11 @@ static inline struct nft_data *nft_set_ext_key(const struct nft_set_ext *ext)
 	return nft_set_ext(ext, NFT_SET_EXT_KEY);
 }
 
+static inline struct nft_data *nft_set_ext_key_end(const struct nft_set_ext *ext)
+{
+	return nft_set_ext(ext, NFT_SET_EXT_KEY_END);
+}
+
 static inline struct nft_data *nft_set_ext_data(const struct nft_set_ext *ext)
 {
 	return nft_set_ext(ext, NFT_SET_EXT_DATA);
@@ -512,8 +536,8 @@ static inline struct nft_set_ext *nft_set_elem_ext(const struct nft_set *set,
 
 void *nft_set_elem_init(const struct nft_set *set,
 			const struct nft_set_ext_tmpl *tmpl,
-			const u32 *key, const u32 *data,
-			u64 timeout, gfp_t gfp);
+			const u32 *key, const u32 *key_end,
+			const u32 *data, u64 timeout, gfp_t gfp);
 void nft_set_elem_destroy(const struct nft_set *set, void *elem);
 
 /**
@@ -731,6 +755,7 @@ enum nft_chain_flags {
  *	@level: length of longest path to this chain
  *	@flags: bitmask of enum nft_chain_flags
  *	@name: name of the chain
+ *	@jit: compiled rules, indexed by generation cursor
  */
 struct nft_chain {
 	struct list_head		rules;
@@ -741,6 +766,9 @@ struct nft_chain {
 	u16				level;
 	u8				flags;
 	char				name[NFT_CHAIN_MAXNAMELEN];
+#ifdef CONFIG_NF_TABLES_JIT
+	struct bpf_prog __rcu		*jit[2];
+#endif
 };
 
 enum nft_chain_type {
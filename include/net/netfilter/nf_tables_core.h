@@ -7,6 +7,14 @@ void nf_tables_core_module_exit(void);
 int nft_immediate_module_init(void);
 void nft_immediate_module_exit(void);
 
+struct nft_immediate_expr {
+	struct nft_data		data;
+	enum nft_registers	dreg:8;
+	u8			dlen;
+};
+
+extern const struct nft_expr_ops nft_imm_ops;
+
 struct nft_cmp_fast_expr {
 	u32			data;
 	enum nft_registers	sreg:8;
@@ -52,4 +60,32 @@ extern const struct nft_expr_ops nft_payload_fast_ops;
 int nft_payload_module_init(void);
 void nft_payload_module_exit(void);
 
+/* State shared between nft_do_chain() and a compiled chain.  The
+ * program returns the verdict code; on anything but NFT_CONTINUE it
+ * also stores the rule that issued the verdict so the interpreter can
+ * resume after it when coming back from a jump.
+ */
+struct nft_jit_ctx {
+	struct nft_regs			*regs;
+	const struct nft_pktinfo	*pkt;
+	const unsigned char		*nh;
+	const unsigned char		*th;
+	const unsigned char		*tail;
+	const struct nft_rule		*rule;
+	unsigned int			rulenum;
+};
+
+#ifdef CONFIG_NF_TABLES_JIT
+void nft_jit_commit(struct net *net);
+void nft_jit_chain_destroy(struct nft_chain *chain);
+#else
+static inline void nft_jit_commit(struct net *net)
+{
+}
+
+static inline void nft_jit_chain_destroy(struct nft_chain *chain)
+{
+}
+#endif
+
 #endif /* _NET_NF_TABLES_CORE_H */
@@ -27,6 +27,8 @@ enum qdisc_state_t {
 	__QDISC_STATE_SCHED,
 	__QDISC_STATE_DEACTIVATED,
 	__QDISC_STATE_THROTTLED,
+	__QDISC_STATE_RUNNING,	/* TCQ_F_NOLOCK qdiscs only */
+	__QDISC_STATE_MISSED,	/* TCQ_F_NOLOCK qdiscs only */
 };
 
 /*
@@ -61,6 +63,10 @@ struct Qdisc {
 				      */
 #define TCQ_F_WARN_NONWC	(1 << 16)
 #define TCQ_F_CPUSTATS		0x20 /* run using percpu statistics */
+#define TCQ_F_NOLOCK		0x40 /* qdisc does not require the root lock:
+				      * enqueue and dequeue do their own
+				      * locking, uses percpu statistics.
+				      */
 	u32			limit;
 	const struct Qdisc_ops	*ops;
 	struct qdisc_size_table	__rcu *stab;
@@ -101,11 +107,31 @@ struct Qdisc {
 
 static inline bool qdisc_is_running(const struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK)
+		return test_bit(__QDISC_STATE_RUNNING, &qdisc->state);
 	return (qdisc->__state & __QDISC___STATE_RUNNING) ? true : false;
 }
 
 static inline bool qdisc_run_begin(struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK) {
+		if (!test_and_set_bit(__QDISC_STATE_RUNNING, &qdisc->state))
+			goto nolock_owned;
+
+		/* Someone else is running the qdisc: tell it to look again
+		 * before it stops, in case it already missed our packet, and
+		 * retry in case it stopped in the meantime.
+		 */
+		smp_mb__before_atomic();
+		set_bit(__QDISC_STATE_MISSED, &qdisc->state);
+		smp_mb__after_atomic();
+		if (test_and_set_bit(__QDISC_STATE_RUNNING, &qdisc->state))
+			return false;
+nolock_owned:
+		clear_bit(__QDISC_STATE_MISSED, &qdisc->state);
+		smp_mb__after_atomic();
+		return true;
+	}
 	if (qdisc_is_running(qdisc))
 		return false;
 	qdisc->__state |= __QDISC___STATE_RUNNING;
@@ -114,6 +140,13 @@ static inline bool qdisc_run_begin(struct Qdisc *qdisc)
 
 static inline void qdisc_run_end(struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK) {
+		clear_bit(__QDISC_STATE_RUNNING, &qdisc->state);
+		smp_mb__after_atomic();
+		if (unlikely(test_bit(__QDISC_STATE_MISSED, &qdisc->state)))
+			__netif_schedule(qdisc);
+		return;
+	}
 	qdisc->__state &= ~__QDISC___STATE_RUNNING;
 }
 
@@ -264,8 +297,23 @@ static inline void qdisc_cb_private_validate(const struct sk_buff *skb, int sz)
 	BUILD_BUG_ON(sizeof(qcb->data) < sz);
 }
 
+static inline int qdisc_qlen_cpu(const struct Qdisc *q)
+{
+	int i, qlen = 0;
+
+	for_each_possible_cpu(i)
+		qlen += per_cpu_ptr(q->cpu_qstats, i)->qlen;
+
+	return qlen;
+}
+
+/* TCQ_F_NOLOCK qdiscs keep their queue length in the percpu statistics,
+ * q->q.qlen only accounts for a requeued skb there.
+ */
 static inline int qdisc_qlen(const struct Qdisc *q)
 {
+	if (q->flags & TCQ_F_NOLOCK)
+		return q->q.qlen + qdisc_qlen_cpu(q);
 	return q->q.qlen;
 }
 
@@ -397,6 +445,7 @@ struct Qdisc *qdisc_alloc(struct netdev_queue *dev_queue,
 			  const struct Qdisc_ops *ops);
 struct Qdisc *qdisc_create_dflt(struct netdev_queue *dev_queue,
 				const struct Qdisc_ops *ops, u32 parentid);
+void qdisc_set_nolock(struct Qdisc *qdisc);
 void __qdisc_calculate_pkt_len(struct sk_buff *skb,
 			       const struct qdisc_size_table *stab);
 bool tcf_destroy(struct tcf_proto *tp, bool force);
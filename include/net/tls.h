@@ -0,0 +1,184 @@
+/*
+ * Kernel TLS (record layer) support.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ */
+
+#ifndef _TLS_OFFLOAD_H
+#define _TLS_OFFLOAD_H
+
+#include <linux/types.h>
+#include <linux/skbuff.h>
+#include <linux/scatterlist.h>
+#include <linux/crypto.h>
+#include <net/tcp.h>
+
+#include <uapi/linux/tls.h>
+
+/* Maximum data size carried in a TLS record */
+#define TLS_MAX_PAYLOAD_SIZE		((size_t)1 << 14)
+
+#define TLS_HEADER_SIZE			5
+#define TLS_NONCE_OFFSET		TLS_HEADER_SIZE
+
+#define TLS_AAD_SPACE_SIZE		13
+
+#define TLS_RECORD_TYPE_DATA		0x17
+
+/* Largest on-the-wire record we build: header, explicit IV, data, tag */
+#define TLS_MAX_RECORD_SIZE		(TLS_HEADER_SIZE +		\
+					 TLS_CIPHER_AES_GCM_128_IV_SIZE +	\
+					 TLS_MAX_PAYLOAD_SIZE +		\
+					 TLS_CIPHER_AES_GCM_128_TAG_SIZE)
+#define TLS_MAX_RECORD_PAGES		DIV_ROUND_UP(TLS_MAX_RECORD_SIZE, \
+						     PAGE_SIZE)
+
+struct tls_sw_context {
+	struct crypto_aead *aead_send;
+
+	/* Sending context */
+	char aad_space[TLS_AAD_SPACE_SIZE];
+
+	unsigned int sg_plaintext_size;
+	int sg_plaintext_num_elem;
+	struct scatterlist sg_plaintext_data[MAX_SKB_FRAGS];
+
+	unsigned int sg_encrypted_size;
+	int sg_encrypted_num_elem;
+	struct scatterlist sg_encrypted_data[TLS_MAX_RECORD_PAGES];
+
+	struct scatterlist sg_aad[1];
+};
+
+struct cipher_context {
+	u16 prepend_size;
+	u16 tag_size;
+	u16 overhead_size;
+	u16 iv_size;
+	char *iv;
+	u16 rec_seq_size;
+	char *rec_seq;
+};
+
+struct tls_context {
+	union {
+		struct tls_crypto_info crypto_send;
+		struct tls12_crypto_info_aes_gcm_128 crypto_send_aes_gcm_128;
+	};
+
+	void *priv_ctx;
+
+	struct cipher_context tx;
+
+	/* Record currently being pushed into TCP, and the offset into its
+	 * first unsent scatterlist entry.
+	 */
+	struct scatterlist *partially_sent_record;
+	u16 partially_sent_offset;
+	bool in_tcp_sendpages;
+
+	/* Original TCP callbacks, restored or chained to on teardown */
+	const struct proto *sk_proto;
+	void (*sk_write_space)(struct sock *sk);
+};
+
+int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx);
+int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size);
+int tls_sw_sendpage(struct sock *sk, struct page *page,
+		    int offset, size_t size, int flags);
+void tls_sw_free_tx_resources(struct sock *sk);
+
+int tls_push_sg(struct sock *sk, struct tls_context *ctx,
+		struct scatterlist *sg, u16 first_offset,
+		int flags);
+int tls_push_partial_record(struct sock *sk, struct tls_context *ctx,
+			    int flags);
+void tls_free_partial_record(struct tls_context *ctx);
+
+static inline bool tls_is_partially_sent_record(struct tls_context *ctx)
+{
+	return !!ctx->partially_sent_record;
+}
+
+static inline void tls_err_abort(struct sock *sk)
+{
+	sk->sk_err = EBADMSG;
+	sk->sk_error_report(sk);
+}
+
+static inline bool tls_bigint_increment(unsigned char *seq, int len)
+{
+	int i;
+
+	for (i = len - 1; i >= 0; i--) {
+		++seq[i];
+		if (seq[i] != 0)
+			break;
+	}
+
+	return (i == -1);
+}
+
+static inline void tls_advance_record_sn(struct sock *sk,
+					 struct cipher_context *ctx)
+{
+	if (tls_bigint_increment(ctx->rec_seq, ctx->rec_seq_size))
+		tls_err_abort(sk);
+	tls_bigint_increment(ctx->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+			     ctx->iv_size);
+}
+
+static inline void tls_fill_prepend(struct tls_context *ctx,
+				    char *buf,
+				    size_t plaintext_len,
+				    unsigned char record_type)
+{
+	size_t pkt_len, iv_size = ctx->tx.iv_size;
+
+	pkt_len = plaintext_len + iv_size + ctx->tx.tag_size;
+
+	/* The explicit nonce follows the record header, so buf must have
+	 * room for TLS_HEADER_SIZE + iv_size bytes.
+	 */
+	buf[0] = record_type;
+	buf[1] = TLS_VERSION_MAJOR(ctx->crypto_send.version);
+	buf[2] = TLS_VERSION_MINOR(ctx->crypto_send.version);
+	/* The record IV doubles as the explicit nonce (RFC 5288) */
+	buf[3] = pkt_len >> 8;
+	buf[4] = pkt_len & 0xFF;
+	memcpy(buf + TLS_NONCE_OFFSET,
+	       ctx->tx.iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE, iv_size);
+}
+
+static inline void tls_make_aad(char *buf,
+				size_t size,
+				char *record_sequence,
+				int record_sequence_size,
+				unsigned char record_type)
+{
+	memcpy(buf, record_sequence, record_sequence_size);
+
+	buf[8] = record_type;
+	buf[9] = TLS_1_2_VERSION_MAJOR;
+	buf[10] = TLS_1_2_VERSION_MINOR;
+	buf[11] = size >> 8;
+	buf[12] = size & 0xFF;
+}
+
+static inline struct tls_context *tls_get_ctx(const struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+
+	return icsk->icsk_ulp_data;
+}
+
+static inline struct tls_sw_context *tls_sw_ctx(
+		const struct tls_context *tls_ctx)
+{
+	return (struct tls_sw_context *)tls_ctx->priv_ctx;
+}
+
+#endif /* _TLS_OFFLOAD_H */
@@ -161,6 +161,9 @@ void udp_set_csum(bool nocheck, struct sk_buff *skb,
 struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *skb,
 				 struct udphdr *uh);
 int udp_gro_complete(struct sk_buff *skb, int nhoff);
+struct sk_buff *__udp_gso_segment(struct sk_buff *gso_skb,
+				  netdev_features_t features);
+void udp_gro_enable(void);
 
 static inline struct udphdr *udp_gro_udphdr(struct sk_buff *skb)
 {
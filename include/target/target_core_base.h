@@ -5,7 +5,7 @@
 #include <linux/configfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/blkdev.h>
-#include <linux/percpu_ida.h>
+#include <linux/sbitmap.h>
 #include <scsi/scsi_cmnd.h>
 #include <net/sock.h>
 #include <net/tcp.h>
@@ -494,6 +494,9 @@ struct se_cmd {
 	int			sam_task_attr;
 	/* Used for se_sess->sess_tag_pool */
 	unsigned int		map_tag;
+	unsigned int		map_cpu;
+	/* CPU the command was set up on; keeps its state and completion there */
+	int			cpuid;
 	/* Transport protocol dependent state, see transport_state_table */
 	enum transport_state_table t_state;
 	unsigned		cmd_wait_set:1;
@@ -626,7 +629,7 @@ struct se_session {
 	spinlock_t		sess_cmd_lock;
 	struct kref		sess_kref;
 	void			*sess_cmd_map;
-	struct percpu_ida	sess_tag_pool;
+	struct sbitmap_queue	sess_tag_pool;
 };
 
 struct se_device;
@@ -740,6 +743,11 @@ struct se_dev_stat_grps {
 	struct config_group scsi_lu_group;
 };
 
+struct se_device_queue {
+	struct list_head	state_list;
+	spinlock_t		lock;
+} ____cacheline_aligned_in_smp;
+
 struct se_device {
 #define SE_DEV_LINK_MAGIC			0xfeeddeef
 	u32			dev_link_magic;
@@ -772,7 +780,6 @@ struct se_device {
 	atomic_t		dev_qf_count;
 	int			export_count;
 	spinlock_t		delayed_cmd_lock;
-	spinlock_t		execute_task_lock;
 	spinlock_t		dev_reservation_lock;
 	unsigned int		dev_reservation_flags;
 #define DRF_SPC2_RESERVATIONS			0x00000001
@@ -792,7 +799,9 @@ struct se_device {
 	struct workqueue_struct *tmr_wq;
 	struct work_struct	qf_work_queue;
 	struct list_head	delayed_cmd_list;
-	struct list_head	state_list;
+	/* Per-CPU lists of executing commands, indexed by se_cmd->cpuid */
+	struct se_device_queue	*queues;
+	unsigned int		queue_cnt;
 	struct list_head	qf_cmd_list;
 	struct list_head	g_dev_node;
 	/* Pointer to associated SE HBA */
@@ -82,15 +82,19 @@ TRACE_EVENT(timer_expire_entry,
 		__field( void *,	timer	)
 		__field( unsigned long,	now	)
 		__field( void *,	function)
+		__field( unsigned long,	expires	)
 	),
 
 	TP_fast_assign(
 		__entry->timer		= timer;
 		__entry->now		= jiffies;
 		__entry->function	= timer->function;
+		__entry->expires	= timer->expires;
 	),
 
-	TP_printk("timer=%p function=%pf now=%lu", __entry->timer, __entry->function,__entry->now)
+	TP_printk("timer=%p function=%pf now=%lu expires=%lu [late=%ld]",
+		  __entry->timer, __entry->function, __entry->now,
+		  __entry->expires, (long)__entry->now - (long)__entry->expires)
 );
 
 /**
@@ -709,9 +709,23 @@ __SYSCALL(__NR_memfd_create, sys_memfd_create)
 __SYSCALL(__NR_bpf, sys_bpf)
 #define __NR_execveat 281
 __SC_COMP(__NR_execveat, sys_execveat, compat_sys_execveat)
+#define __NR_io_uring_setup 282
+__SYSCALL(__NR_io_uring_setup, sys_io_uring_setup)
+#define __NR_io_uring_enter 283
+__SYSCALL(__NR_io_uring_enter, sys_io_uring_enter)
+#define __NR_userfaultfd 284
+__SYSCALL(__NR_userfaultfd, sys_userfaultfd)
+#define __NR_spawn 285
+__SYSCALL(__NR_spawn, sys_spawn)
+#define __NR_statx 286
+__SYSCALL(__NR_statx, sys_statx)
+#define __NR_getdents_statx 287
+__SYSCALL(__NR_getdents_statx, sys_getdents_statx)
+#define __NR_prefetch 288
+__SYSCALL(__NR_prefetch, sys_prefetch)
 
 #undef __NR_syscalls
-#define __NR_syscalls 282
+#define __NR_syscalls 289
 
 /*
  * All syscalls below here should go away really,
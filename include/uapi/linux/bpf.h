@@ -113,6 +113,11 @@ enum bpf_map_type {
 	BPF_MAP_TYPE_UNSPEC,
 	BPF_MAP_TYPE_HASH,
 	BPF_MAP_TYPE_ARRAY,
+	BPF_MAP_TYPE_PERCPU_HASH,
+	BPF_MAP_TYPE_PERCPU_ARRAY,
+	BPF_MAP_TYPE_STACK_TRACE,
+	BPF_MAP_TYPE_PERF_EVENT_ARRAY,
+	BPF_MAP_TYPE_PROG_ARRAY,
 };
 
 enum bpf_prog_type {
@@ -121,6 +126,8 @@ enum bpf_prog_type {
 	BPF_PROG_TYPE_KPROBE,
 	BPF_PROG_TYPE_SCHED_CLS,
 	BPF_PROG_TYPE_SCHED_ACT,
+	BPF_PROG_TYPE_XDP,
+	BPF_PROG_TYPE_TRACEPOINT,
 };
 
 #define BPF_PSEUDO_MAP_FD	1
@@ -130,12 +137,22 @@ enum bpf_prog_type {
 #define BPF_NOEXIST	1 /* create new element if it didn't exist */
 #define BPF_EXIST	2 /* update existing element */
 
+/* flags for BPF_MAP_CREATE command */
+#define BPF_F_PREALLOC	(1U << 0) /* allocate all hash elements up front */
+
+/* flags for BPF_FUNC_get_stackid */
+#define BPF_F_SKIP_FIELD_MASK	0xffULL
+#define BPF_F_USER_STACK	(1ULL << 8)
+#define BPF_F_FAST_STACK_CMP	(1ULL << 9)
+#define BPF_F_REUSE_STACKID	(1ULL << 10)
+
 union bpf_attr {
 	struct { /* anonymous struct used by BPF_MAP_CREATE command */
 		__u32	map_type;	/* one of enum bpf_map_type */
 		__u32	key_size;	/* size of key in bytes */
 		__u32	value_size;	/* size of value in bytes */
 		__u32	max_entries;	/* max number of entries in a map */
+		__u32	map_flags;	/* BPF_F_* flags */
 	};
 
 	struct { /* anonymous struct used by BPF_MAP_*_ELEM commands */
@@ -210,6 +227,60 @@ enum bpf_func_id {
 	 * Return: 0 on success
 	 */
 	BPF_FUNC_l4_csum_replace,
+
+	/**
+	 * bpf_get_stackid(ctx, map, flags) - walk the stack and store it in map
+	 * @ctx: struct pt_regs *
+	 * @map: pointer to a BPF_MAP_TYPE_STACK_TRACE map
+	 * @flags: bits 0-7 - number of frames to skip
+	 *         BPF_F_USER_STACK - collect the user space stack
+	 *         BPF_F_FAST_STACK_CMP - compare stacks by hash only
+	 *         BPF_F_REUSE_STACKID - overwrite a colliding stack
+	 * Return: >= 0 stackid on success, < 0 on error
+	 */
+	BPF_FUNC_get_stackid,
+
+	/**
+	 * bpf_perf_event_output(ctx, map, index, data, size) - output raw sample
+	 * @ctx: struct pt_regs *
+	 * @map: pointer to a BPF_MAP_TYPE_PERF_EVENT_ARRAY map
+	 * @index: index of the event in the map, must run on its cpu
+	 * @data: pointer to the data on the stack
+	 * @size: size of @data
+	 * Return: 0 on success
+	 */
+	BPF_FUNC_perf_event_output,
+
+	/**
+	 * bpf_xdp_load_bytes(ctx, offset, to, len) - load bytes from packet
+	 * @ctx: pointer to struct xdp_md
+	 * @offset: offset within packet from the start of the MAC header
+	 * @to: pointer to the stack where to copy bytes to
+	 * @len: number of bytes to copy
+	 * Return: 0 on success
+	 */
+	BPF_FUNC_xdp_load_bytes,
+
+	/**
+	 * bpf_xdp_store_bytes(ctx, offset, from, len) - store bytes into packet
+	 * @ctx: pointer to struct xdp_md
+	 * @offset: offset within packet from the start of the MAC header
+	 * @from: pointer where to copy bytes from
+	 * @len: number of bytes to store into packet
+	 * Return: 0 on success
+	 */
+	BPF_FUNC_xdp_store_bytes,
+
+	/**
+	 * bpf_tail_call(ctx, prog_array_map, index) - jump into another BPF program
+	 * @ctx: context pointer passed to next program
+	 * @prog_array_map: pointer to map which type is BPF_MAP_TYPE_PROG_ARRAY
+	 * @index: index inside array that selects specific program to run
+	 * Return: 0 on success, the next program does not return to the caller.
+	 * On failure (empty slot, index out of range, or too many nested tail
+	 * calls) the caller continues with the next instruction.
+	 */
+	BPF_FUNC_tail_call,
 	__BPF_FUNC_MAX_ID,
 };
 
@@ -228,4 +299,23 @@ struct __sk_buff {
 	__u32 priority;
 };
 
+/* User return codes for XDP prog type.
+ * A valid XDP program must return one of these defined values. All other
+ * return codes are reserved for future use. Unknown return codes will result
+ * in packet drop.
+ */
+enum xdp_action {
+	XDP_ABORTED = 0,
+	XDP_DROP,
+	XDP_PASS,
+	XDP_TX,
+};
+
+/* user accessible metadata for XDP packet hook
+ * new fields must be added to the end of this structure
+ */
+struct xdp_md {
+	__u32 len;
+};
+
 #endif /* _UAPI__LINUX_BPF_H__ */
@@ -240,6 +240,12 @@ typedef struct elf64_hdr {
 #define PF_W		0x2
 #define PF_X		0x1
 
+/*
+ * OS specific (PF_MASKOS) p_flags: fault in the file contents of this
+ * read-only PT_LOAD segment at exec time instead of on first access.
+ */
+#define PF_LINUX_PREFAULT	0x00100000
+
 typedef struct elf32_phdr{
   Elf32_Word	p_type;
   Elf32_Off	p_offset;
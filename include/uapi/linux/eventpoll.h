@@ -26,6 +26,13 @@
 #define EPOLL_CTL_DEL 2
 #define EPOLL_CTL_MOD 3
 
+/*
+ * Wake up only one of the epoll instances that wait on the target file,
+ * for EPOLL_CTL_ADD only. Instances that are busy are skipped, and the
+ * one woken goes to the back of the line.
+ */
+#define EPOLLEXCLUSIVE (1 << 28)
+
 /*
  * Request the handling of system wakeup events so as to prevent system suspends
  * from happening while those events are being processed.
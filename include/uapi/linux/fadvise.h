@@ -1,6 +1,8 @@
 #ifndef FADVISE_H_INCLUDED
 #define FADVISE_H_INCLUDED
 
+#include <linux/types.h>
+
 #define POSIX_FADV_NORMAL	0 /* No further special treatment.  */
 #define POSIX_FADV_RANDOM	1 /* Expect random page references.  */
 #define POSIX_FADV_SEQUENTIAL	2 /* Expect sequential page references.  */
@@ -18,4 +20,15 @@
 #define POSIX_FADV_NOREUSE	5 /* Data will be accessed once.  */
 #endif
 
+/*
+ * A byte range for prefetch(), which starts POSIX_FADV_WILLNEED style
+ * readahead on up to PREFETCH_MAX_RANGES of them at once.
+ */
+struct prefetch_range {
+	__u64	offset;
+	__u64	len;
+};
+
+#define PREFETCH_MAX_RANGES	1024
+
 #endif	/* FADVISE_H_INCLUDED */
@@ -183,6 +183,7 @@ struct kvm_s390_skeys {
 #define KVM_EXIT_EPR              23
 #define KVM_EXIT_SYSTEM_EVENT     24
 #define KVM_EXIT_S390_STSI        25
+#define KVM_EXIT_DIRTY_RING_FULL  26
 
 /* For KVM_EXIT_INTERNAL_ERROR */
 /* Emulate instruction failed. */
@@ -372,6 +373,27 @@ struct kvm_coalesced_mmio_ring {
 	((PAGE_SIZE - sizeof(struct kvm_coalesced_mmio_ring)) / \
 	 sizeof(struct kvm_coalesced_mmio))
 
+/*
+ * Per-vcpu dirty ring, available with KVM_CAP_DIRTY_LOG_RING and mapped
+ * at KVM_DIRTY_LOG_PAGE_OFFSET of the vcpu fd.  KVM sets
+ * KVM_DIRTY_GFN_F_DIRTY once an entry is published; userspace collects
+ * entries in ring order, sets KVM_DIRTY_GFN_F_RESET on them and calls
+ * KVM_RESET_DIRTY_RINGS to hand them back and re-arm dirty tracking.
+ */
+#ifndef KVM_DIRTY_LOG_PAGE_OFFSET
+#define KVM_DIRTY_LOG_PAGE_OFFSET 0
+#endif
+
+#define KVM_DIRTY_GFN_F_DIRTY	(1 << 0)
+#define KVM_DIRTY_GFN_F_RESET	(1 << 1)
+#define KVM_DIRTY_GFN_F_MASK	0x3
+
+struct kvm_dirty_gfn {
+	__u32 flags;
+	__u32 slot;	/* memslot id */
+	__u64 offset;	/* gfn offset within the slot */
+};
+
 /* for KVM_TRANSLATE */
 struct kvm_translation {
 	/* in */
@@ -813,6 +835,7 @@ struct kvm_ppc_smmu_info {
 #define KVM_CAP_MIPS_MSA 112
 #define KVM_CAP_S390_INJECT_IRQ 113
 #define KVM_CAP_S390_IRQ_STATE 114
+#define KVM_CAP_DIRTY_LOG_RING 115
 
 #ifdef KVM_CAP_IRQ_ROUTING
 
@@ -1198,6 +1221,8 @@ struct kvm_s390_ucas_mapping {
 /* Available with KVM_CAP_S390_IRQ_STATE */
 #define KVM_S390_SET_IRQ_STATE	  _IOW(KVMIO, 0xb5, struct kvm_s390_irq_state)
 #define KVM_S390_GET_IRQ_STATE	  _IOW(KVMIO, 0xb6, struct kvm_s390_irq_state)
+/* Available with KVM_CAP_DIRTY_LOG_RING */
+#define KVM_RESET_DIRTY_RINGS	  _IO(KVMIO,   0xb7)
 
 #define KVM_DEV_ASSIGN_ENABLE_IOMMU	(1 << 0)
 #define KVM_DEV_ASSIGN_PCI_2_3		(1 << 1)
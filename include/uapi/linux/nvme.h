@@ -90,6 +90,9 @@ enum {
 	NVME_CTRL_ONCS_WRITE_UNCORRECTABLE	= 1 << 1,
 	NVME_CTRL_ONCS_DSM			= 1 << 2,
 	NVME_CTRL_VWC_PRESENT			= 1 << 0,
+	NVME_CTRL_OACS_DBBUF_SUPP		= 1 << 8,
+	NVME_CTRL_SGLS_SUPP			= 1 << 0,
+	NVME_CTRL_SGLS_SUPP_DWORD_ALIGN		= 1 << 1,
 };
 
 struct nvme_lbaf {
@@ -243,6 +246,27 @@ struct nvme_common_command {
 	__le32			cdw10[6];
 };
 
+/*
+ * Scatter/gather list descriptor; the type is the descriptor format in
+ * the upper four bits.  A segment descriptor points to a list of
+ * descriptors, the last segment one to the final list.
+ */
+struct nvme_sgl_desc {
+	__le64			addr;
+	__le32			length;
+	__u8			rsvd[3];
+	__u8			type;
+};
+
+enum {
+	NVME_SGL_FMT_DATA_DESC		= 0x00,
+	NVME_SGL_FMT_SEG_DESC		= 0x02,
+	NVME_SGL_FMT_LAST_SEG_DESC	= 0x03,
+};
+
+/* Command flags: PRPs by default, or SGLs with a contiguous metadata buffer */
+#define NVME_CMD_SGL_METABUF	(1 << 6)
+
 struct nvme_rw_command {
 	__u8			opcode;
 	__u8			flags;
@@ -250,8 +274,13 @@ struct nvme_rw_command {
 	__le32			nsid;
 	__u64			rsvd2;
 	__le64			metadata;
-	__le64			prp1;
-	__le64			prp2;
+	union {
+		struct {
+			__le64	prp1;
+			__le64	prp2;
+		};
+		struct nvme_sgl_desc	sgl;
+	};
 	__le64			slba;
 	__le16			length;
 	__le16			control;
@@ -325,6 +354,7 @@ enum nvme_admin_opcode {
 	nvme_admin_async_event		= 0x0c,
 	nvme_admin_activate_fw		= 0x10,
 	nvme_admin_download_fw		= 0x11,
+	nvme_admin_dbbuf		= 0x7C,
 	nvme_admin_format_nvm		= 0x80,
 	nvme_admin_security_send	= 0x81,
 	nvme_admin_security_recv	= 0x82,
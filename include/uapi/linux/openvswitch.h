@@ -73,6 +73,12 @@ enum ovs_datapath_cmd {
  * datapath.  Always present in notifications.
  * @OVS_DP_ATTR_MEGAFLOW_STATS: Statistics about mega flow masks usage for the
  * datapath. Always present in notifications.
+ * @OVS_DP_ATTR_MASKS_CACHE_SIZE: Size of the per-cpu cache that maps a
+ * packet hash to the mask that matched it last.  Must be zero, to disable
+ * the cache, or a power of two.  Always present in notifications.
+ * @OVS_DP_ATTR_MASKS_HIT: Array of __u64, the number of lookups that matched
+ * each mask since the masks were last reordered, in lookup order.  At most
+ * %OVS_DP_MASKS_HIT_MAX entries.  Always present in notifications.
  *
  * These attributes follow the &struct ovs_header within the Generic Netlink
  * payload for %OVS_DP_* commands.
@@ -84,11 +90,15 @@ enum ovs_datapath_attr {
 	OVS_DP_ATTR_STATS,		/* struct ovs_dp_stats */
 	OVS_DP_ATTR_MEGAFLOW_STATS,	/* struct ovs_dp_megaflow_stats */
 	OVS_DP_ATTR_USER_FEATURES,	/* OVS_DP_F_*  */
+	OVS_DP_ATTR_MASKS_CACHE_SIZE,	/* u32 number of cache entries */
+	OVS_DP_ATTR_MASKS_HIT,		/* __u64 per mask, in lookup order */
 	__OVS_DP_ATTR_MAX
 };
 
 #define OVS_DP_ATTR_MAX (__OVS_DP_ATTR_MAX - 1)
 
+#define OVS_DP_MASKS_HIT_MAX 256
+
 struct ovs_dp_stats {
 	__u64 n_hit;             /* Number of flow table matches. */
 	__u64 n_missed;          /* Number of flow table misses. */
@@ -100,7 +110,7 @@ struct ovs_dp_megaflow_stats {
 	__u64 n_mask_hit;	 /* Number of masks used for flow lookups. */
 	__u32 n_masks;		 /* Number of masks for the datapath. */
 	__u32 pad0;		 /* Pad for future expension. */
-	__u64 pad1;		 /* Pad for future expension. */
+	__u64 n_cache_hit;	 /* Number of cache matches for flow lookups. */
 	__u64 pad2;		 /* Pad for future expension. */
 };
 
@@ -175,6 +175,9 @@ enum {
 	TCA_TBF_PRATE64,
 	TCA_TBF_BURST,
 	TCA_TBF_PBURST,
+	TCA_TBF_GROUP,		/* u32, shared rate group id */
+	TCA_TBF_GROUP_RATE64,	/* u64, group rate in bytes per second */
+	TCA_TBF_GROUP_WINDOW,	/* u32, group burst window in usec */
 	__TCA_TBF_MAX,
 };
 
@@ -190,4 +190,12 @@ struct prctl_mm_map {
 # define PR_FP_MODE_FR		(1 << 0)	/* 64b FP registers */
 # define PR_FP_MODE_FRE		(1 << 1)	/* 32b compatibility */
 
+/*
+ * Give the process its own hash table for private futexes, sized for
+ * the given number of threads.  Only allowed while single threaded.
+ */
+#define PR_FUTEX_HASH		47
+# define PR_FUTEX_HASH_SET	1
+# define PR_FUTEX_HASH_GET	2
+
 #endif /* _LINUX_PRCTL_H */
@@ -0,0 +1,21 @@
+#ifndef _UAPI_LINUX_SPAWN_H
+#define _UAPI_LINUX_SPAWN_H
+
+#include <linux/types.h>
+
+/*
+ * File actions done in order by the child of spawn(2) before it execs.
+ */
+#define SPAWN_ACTION_CLOSE	1	/* close(fd) */
+#define SPAWN_ACTION_DUP2	2	/* dup2(fd, newfd) */
+
+struct spawn_action {
+	__u32	type;
+	__s32	fd;
+	__s32	newfd;
+	__u32	reserved;	/* must be zero */
+};
+
+#define SPAWN_MAX_ACTIONS	64
+
+#endif /* _UAPI_LINUX_SPAWN_H */
@@ -174,7 +174,8 @@ struct taskstats {
 
 enum {
 	TASKSTATS_CMD_UNSPEC = 0,	/* Reserved */
-	TASKSTATS_CMD_GET,		/* user->kernel request/get-response */
+	TASKSTATS_CMD_GET,		/* user->kernel request/get-response,
+					 * with NLM_F_DUMP for all tasks */
 	TASKSTATS_CMD_NEW,		/* kernel->user event */
 	__TASKSTATS_CMD_MAX,
 };
@@ -112,6 +112,8 @@ enum {
 #define TCP_FASTOPEN		23	/* Enable FastOpen on listeners */
 #define TCP_TIMESTAMP		24
 #define TCP_NOTSENT_LOWAT	25	/* limit number of unsent bytes in write queue */
+#define TCP_ZEROCOPY_RECEIVE	26	/* map received pages, see below */
+#define TCP_ULP			27	/* Attach a ULP to a TCP connection */
 
 struct tcp_repair_opt {
 	__u32	opt_code;
@@ -154,6 +156,7 @@ struct tcp_info {
 	__u8	tcpi_backoff;
 	__u8	tcpi_options;
 	__u8	tcpi_snd_wscale : 4, tcpi_rcv_wscale : 4;
+	__u8	tcpi_delivery_rate_app_limited:1;
 
 	__u32	tcpi_rto;
 	__u32	tcpi_ato;
@@ -189,6 +192,10 @@ struct tcp_info {
 
 	__u64	tcpi_pacing_rate;
 	__u64	tcpi_max_pacing_rate;
+
+	__u32	tcpi_min_rtt;
+	__u32	tcpi_delivered;
+	__u64	tcpi_delivery_rate;
 };
 
 /* for TCP_MD5SIG socket option */
@@ -202,4 +209,18 @@ struct tcp_md5sig {
 	__u8	tcpm_key[TCP_MD5SIG_MAXKEYLEN];		/* key (binary) */
 };
 
+/* getsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, ...)
+ *
+ * Maps up to @length bytes of in-order received data into a region
+ * returned by mmap() on the socket, starting at @address, instead of
+ * copying them. Only whole pages of payload can be mapped. On return
+ * @length holds the number of bytes mapped and @recv_skip_hint the
+ * number of bytes to read() before the next call can map more.
+ */
+struct tcp_zerocopy_receive {
+	__u64 address;		/* in: address of mapping */
+	__u32 length;		/* in/out: number of bytes to map/mapped */
+	__u32 recv_skip_hint;	/* out: amount of bytes to skip */
+};
+
 #endif /* _UAPI_LINUX_TCP_H */
@@ -0,0 +1,56 @@
+#ifndef _UAPI_TRACE_MMAP_H_
+#define _UAPI_TRACE_MMAP_H_
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/**
+ * struct trace_buffer_meta - Ring-buffer Meta-page description
+ * @meta_page_size:	Size of this meta-page.
+ * @meta_struct_len:	Size of this structure.
+ * @subbuf_size:	Size of each sub-buffer.
+ * @nr_subbufs:		Number of sub-buffers in the ring-buffer, including the reader.
+ * @reader.lost_events:	Number of events lost at the time of the reader swap.
+ * @reader.id:		subbuf ID of the current reader. ID range [0 : @nr_subbufs - 1]
+ * @reader.read:	Number of bytes read on the reader subbuf.
+ * @entries:		Number of entries in the ring-buffer.
+ * @overrun:		Number of entries lost in the ring-buffer.
+ * @read:		Number of entries that have been read.
+ *
+ * The meta-page is the first page of a trace_pipe_raw mapping.  It is
+ * followed by the @nr_subbufs sub-buffers, in ID order.  Each
+ * sub-buffer starts with the usual page header (time stamp and
+ * commit), as described in events/header_page.
+ */
+struct trace_buffer_meta {
+	__u32		meta_page_size;
+	__u32		meta_struct_len;
+
+	__u32		subbuf_size;
+	__u32		nr_subbufs;
+
+	struct {
+		__u64	lost_events;
+		__u32	id;
+		__u32	read;
+	} reader;
+
+	__u64	entries;
+	__u64	overrun;
+	__u64	read;
+
+	__u64	Reserved1;
+	__u64	Reserved2;
+};
+
+/*
+ * Tell the kernel that the current reader sub-buffer has been consumed
+ * and refresh the meta-page.  If the reader still had unread data it
+ * is marked as read and kept, so that events committed since the last
+ * call can be picked up; otherwise the next sub-buffer with data is
+ * swapped in and reader.id changes.  Reading a new reader starts at
+ * reader.read.
+ */
+#define TRACE_MMAP_IOCTL_GET_READER		_IO('R', 0x20)
+
+#endif /* _UAPI_TRACE_MMAP_H_ */
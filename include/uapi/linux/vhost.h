@@ -45,6 +45,10 @@ struct vhost_vring_addr {
 	/* Log writes to used structure, at offset calculated from specified
 	 * address. Address must be 32 bit aligned. */
 	__u64 log_guest_addr;
+	/* With VIRTIO_F_RING_PACKED, desc_user_addr is the descriptor ring,
+	 * avail_user_addr the driver event suppression structure and
+	 * used_user_addr the device one.  Used descriptors are written to
+	 * the descriptor ring, so log_guest_addr is its guest address. */
 };
 
 struct vhost_memory_region {
@@ -98,7 +102,10 @@ struct vhost_memory {
 #define VHOST_SET_VRING_NUM _IOW(VHOST_VIRTIO, 0x10, struct vhost_vring_state)
 /* Set addresses for the ring. */
 #define VHOST_SET_VRING_ADDR _IOW(VHOST_VIRTIO, 0x11, struct vhost_vring_addr)
-/* Base value where queue looks for available descriptors */
+/* Base value where queue looks for available descriptors.  For packed rings
+ * this index runs freely past the ring size: the descriptor position is the
+ * index modulo the (power of two) ring size, the wrap counter is set on even
+ * laps. */
 #define VHOST_SET_VRING_BASE _IOW(VHOST_VIRTIO, 0x12, struct vhost_vring_state)
 /* Get accessor: reads index, writes value in num */
 #define VHOST_GET_VRING_BASE _IOWR(VHOST_VIRTIO, 0x12, struct vhost_vring_state)
@@ -112,6 +119,12 @@ struct vhost_memory {
 #define VHOST_SET_VRING_CALL _IOW(VHOST_VIRTIO, 0x21, struct vhost_vring_file)
 /* Set eventfd to signal an error */
 #define VHOST_SET_VRING_ERR _IOW(VHOST_VIRTIO, 0x22, struct vhost_vring_file)
+/* Set busy loop timeout (in us) */
+#define VHOST_SET_VRING_BUSYLOOP_TIMEOUT _IOW(VHOST_VIRTIO, 0x23,	\
+					 struct vhost_vring_state)
+/* Get busy loop timeout (in us) */
+#define VHOST_GET_VRING_BUSYLOOP_TIMEOUT _IOW(VHOST_VIRTIO, 0x24,	\
+					 struct vhost_vring_state)
 
 /* VHOST_NET specific defines */
 
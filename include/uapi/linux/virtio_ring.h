@@ -41,6 +41,13 @@
 /* This means the buffer contains a list of buffer descriptors. */
 #define VRING_DESC_F_INDIRECT	4
 
+/*
+ * Mark a descriptor as available or used in packed ring.
+ * Notice: they are defined as shifts instead of shifted values.
+ */
+#define VRING_PACKED_DESC_F_AVAIL	7
+#define VRING_PACKED_DESC_F_USED	15
+
 /* The Host uses this in used->flags to advise the Guest: don't kick me when
  * you add a buffer.  It's unreliable, so it's simply an optimization.  Guest
  * will still kick if it's out of buffers. */
@@ -50,6 +57,23 @@
  * optimization.  */
 #define VRING_AVAIL_F_NO_INTERRUPT	1
 
+/* Enable events in packed ring. */
+#define VRING_PACKED_EVENT_FLAG_ENABLE	0x0
+/* Disable events in packed ring. */
+#define VRING_PACKED_EVENT_FLAG_DISABLE	0x1
+/*
+ * Enable events for a specific descriptor in packed ring.
+ * (as specified by Descriptor Ring Change Event Offset/Wrap Counter).
+ * Only valid if VIRTIO_RING_F_EVENT_IDX has been negotiated.
+ */
+#define VRING_PACKED_EVENT_FLAG_DESC	0x2
+
+/*
+ * Wrap counter bit shift in event suppression structure
+ * of packed ring.
+ */
+#define VRING_PACKED_EVENT_F_WRAP_CTR	15
+
 /* We support indirect buffer descriptors */
 #define VIRTIO_RING_F_INDIRECT_DESC	28
 
@@ -168,4 +192,50 @@ static inline int vring_need_event(__u16 event_idx, __u16 new_idx, __u16 old)
 	return (__u16)(new_idx - event_idx - 1) < (__u16)(new_idx - old);
 }
 
+/* The packed ring layout uses a single ring of descriptors, written by the
+ * driver to make buffers available and overwritten in place by the device
+ * to mark them used.  A wrap counter, flipped each time an index goes
+ * around the ring, is mirrored in the AVAIL and USED flag bits so either
+ * side can tell fresh descriptors from stale ones without a shared index.
+ * The packed layout is only defined for VIRTIO_F_VERSION_1, so all fields
+ * are little-endian.
+ *
+ * struct vring_packed
+ * {
+ *	// The descriptor ring (16 bytes each)
+ *	struct vring_packed_desc desc[num];
+ *
+ *	// Driver event suppression, written by the driver.
+ *	struct vring_packed_desc_event driver;
+ *
+ *	// Device event suppression, written by the device.
+ *	struct vring_packed_desc_event device;
+ * };
+ */
+struct vring_packed_desc_event {
+	/* Descriptor Ring Change Event Offset/Wrap Counter. */
+	__le16 off_wrap;
+	/* Descriptor Ring Change Event Flags. */
+	__le16 flags;
+};
+
+struct vring_packed_desc {
+	/* Buffer Address. */
+	__le64 addr;
+	/* Buffer Length. */
+	__le32 len;
+	/* Buffer ID. */
+	__le16 id;
+	/* The flags depending on descriptor type. */
+	__le16 flags;
+};
+
+#define VRING_PACKED_EVENT_ALIGN_SIZE 4
+
+static inline unsigned vring_packed_size(unsigned int num)
+{
+	return sizeof(struct vring_packed_desc) * num +
+		2 * sizeof(struct vring_packed_desc_event);
+}
+
 #endif /* _UAPI_LINUX_VIRTIO_RING_H */
@@ -853,6 +853,40 @@ out:
 	return found;
 }
 
+#ifdef CONFIG_AUDITSYSCALL
+/*
+ * Gather the syscall masks of all entry and exit rules, so that syscalls
+ * no rule asks for can skip the filter lists.  Rules added later only set
+ * bits; a rebuild after a removal only clears bits no rule needs.
+ * Called with audit_filter_mutex held.
+ */
+static void audit_update_syscall_mask(struct audit_krule *added)
+{
+	static const int lists[] = { AUDIT_FILTER_ENTRY, AUDIT_FILTER_EXIT };
+	u32 mask[AUDIT_BITMASK_SIZE] = { 0 };
+	struct audit_krule *r;
+	int i, l;
+
+	if (added) {
+		if (added->listnr != AUDIT_FILTER_ENTRY &&
+		    added->listnr != AUDIT_FILTER_EXIT)
+			return;
+		for (i = 0; i < AUDIT_BITMASK_SIZE; i++)
+			WRITE_ONCE(audit_syscall_mask[i],
+				   audit_syscall_mask[i] | added->mask[i]);
+		return;
+	}
+
+	for (l = 0; l < ARRAY_SIZE(lists); l++) {
+		list_for_each_entry(r, &audit_rules_list[lists[l]], list)
+			for (i = 0; i < AUDIT_BITMASK_SIZE; i++)
+				mask[i] |= r->mask[i];
+	}
+	for (i = 0; i < AUDIT_BITMASK_SIZE; i++)
+		WRITE_ONCE(audit_syscall_mask[i], mask[i]);
+}
+#endif
+
 static u64 prio_low = ~0ULL/2;
 static u64 prio_high = ~0ULL/2 - 1;
 
@@ -906,6 +940,11 @@ static inline int audit_add_rule(struct audit_entry *entry)
 		}
 	}
 
+#ifdef CONFIG_AUDITSYSCALL
+	/* before the rule becomes visible to the syscall filters */
+	audit_update_syscall_mask(&entry->rule);
+#endif
+
 	entry->rule.prio = ~0ULL;
 	if (entry->rule.listnr == AUDIT_FILTER_EXIT) {
 		if (entry->rule.flags & AUDIT_FILTER_PREPEND)
@@ -982,6 +1021,8 @@ static inline int audit_del_rule(struct audit_entry *entry)
 
 	if (!audit_match_signal(entry))
 		audit_signals--;
+
+	audit_update_syscall_mask(NULL);
 #endif
 	mutex_unlock(&audit_filter_mutex);
 
@@ -94,6 +94,9 @@ int audit_n_rules;
 /* determines whether we collect data for signals sent */
 int audit_signals;
 
+/* syscalls named by any entry or exit rule, see audit_update_syscall_mask() */
+u32 audit_syscall_mask[AUDIT_BITMASK_SIZE];
+
 struct audit_aux_data {
 	struct audit_aux_data	*next;
 	int			type;
@@ -739,6 +742,16 @@ static int audit_in_mask(const struct audit_krule *rule, unsigned long val)
 	return rule->mask[word] & bit;
 }
 
+/* Could any syscall entry or exit rule match syscall number @major? */
+static inline bool audit_syscall_in_rules(int major)
+{
+	int word = AUDIT_WORD(major);
+
+	if (major < 0 || word >= AUDIT_BITMASK_SIZE)
+		return true;
+	return READ_ONCE(audit_syscall_mask[word]) & AUDIT_BIT(major);
+}
+
 /* At syscall entry and exit time, this filter is called if the
  * audit_state is not low enough that auditing cannot take place, but is
  * also not high enough that we already know we have to write an audit
@@ -1517,7 +1530,14 @@ void __audit_syscall_entry(int major, unsigned long a1, unsigned long a2,
 	context->dummy = !audit_n_rules;
 	if (!context->dummy && state == AUDIT_BUILD_CONTEXT) {
 		context->prio = 0;
-		state = audit_filter_syscall(tsk, context, &audit_filter_list[AUDIT_FILTER_ENTRY]);
+		/*
+		 * No entry or exit rule can match this syscall, so there is
+		 * nothing to collect for the exit filters either.
+		 */
+		if (!audit_syscall_in_rules(major))
+			context->dummy = 1;
+		else
+			state = audit_filter_syscall(tsk, context, &audit_filter_list[AUDIT_FILTER_ENTRY]);
 	}
 	if (state == AUDIT_DISABLED)
 		return;
@@ -13,27 +13,151 @@
 #include <linux/jhash.h>
 #include <linux/filter.h>
 #include <linux/vmalloc.h>
+#include <linux/percpu.h>
+#include "percpu_freelist.h"
 
 struct bpf_htab {
 	struct bpf_map map;
 	struct hlist_head *buckets;
+	void *elems;	/* BPF_F_PREALLOC: all elements, in one block */
+	struct pcpu_freelist freelist;
 	spinlock_t lock;
 	u32 count;	/* number of elements in this hashtable */
 	u32 n_buckets;	/* number of hash buckets */
 	u32 elem_size;	/* size of each element in bytes */
 };
 
-/* each htab element is struct htab_elem + key + value */
+/* each htab element is struct htab_elem + key + value, per-cpu maps
+ * store a pointer to the per-cpu copies of the value instead
+ */
 struct htab_elem {
 	struct hlist_node hash_node;
-	struct rcu_head rcu;
+	union {
+		struct rcu_head rcu;
+		struct pcpu_freelist_node fnode;	/* prealloc only */
+	};
+	struct bpf_htab *htab;
 	u32 hash;
 	char key[0] __aligned(8);
 };
 
+static bool htab_is_percpu(const struct bpf_htab *htab)
+{
+	return htab->map.map_type == BPF_MAP_TYPE_PERCPU_HASH;
+}
+
+static bool htab_is_prealloc(const struct bpf_htab *htab)
+{
+	return htab->map.map_flags & BPF_F_PREALLOC;
+}
+
+static inline struct htab_elem *get_htab_elem(struct bpf_htab *htab, int i)
+{
+	return (struct htab_elem *) (htab->elems + i * htab->elem_size);
+}
+
+static inline void htab_elem_set_ptr(struct htab_elem *l, u32 key_size,
+				     void __percpu *pptr)
+{
+	*(void __percpu **)(l->key + key_size) = pptr;
+}
+
+static inline void __percpu *htab_elem_get_ptr(struct htab_elem *l, u32 key_size)
+{
+	return *(void __percpu **)(l->key + key_size);
+}
+
+/* number of preallocated elements: one spare per cpu on top of
+ * max_entries, so that replacing an existing key in a full map still
+ * finds a free element
+ */
+static u32 htab_prealloc_nr(const struct bpf_htab *htab)
+{
+	return htab->map.max_entries + num_possible_cpus();
+}
+
+static void prealloc_destroy(struct bpf_htab *htab)
+{
+	u32 i;
+
+	if (htab_is_percpu(htab))
+		for (i = 0; i < htab_prealloc_nr(htab); i++)
+			free_percpu(htab_elem_get_ptr(get_htab_elem(htab, i),
+						      round_up(htab->map.key_size, 8)));
+
+	vfree(htab->elems);
+	pcpu_freelist_destroy(&htab->freelist);
+}
+
+static int prealloc_init(struct bpf_htab *htab)
+{
+	u32 num_entries = htab_prealloc_nr(htab);
+	u32 i;
+	int err = -ENOMEM;
+
+	if ((u64) num_entries * htab->elem_size > U32_MAX)
+		return -E2BIG;
+
+	htab->elems = vzalloc(num_entries * htab->elem_size);
+	if (!htab->elems)
+		return -ENOMEM;
+
+	if (htab_is_percpu(htab)) {
+		u32 size = round_up(htab->map.value_size, 8);
+
+		for (i = 0; i < num_entries; i++) {
+			void __percpu *pptr;
+
+			pptr = __alloc_percpu_gfp(size, 8, GFP_USER | __GFP_NOWARN);
+			if (!pptr)
+				goto free_elems;
+			htab_elem_set_ptr(get_htab_elem(htab, i),
+					  round_up(htab->map.key_size, 8), pptr);
+		}
+	}
+
+	for (i = 0; i < num_entries; i++)
+		get_htab_elem(htab, i)->htab = htab;
+
+	err = pcpu_freelist_init(&htab->freelist);
+	if (err)
+		goto free_elems;
+
+	pcpu_freelist_populate(&htab->freelist,
+			       htab->elems + offsetof(struct htab_elem, fnode),
+			       htab->elem_size, num_entries);
+	return 0;
+
+free_elems:
+	if (htab_is_percpu(htab))
+		for (i = 0; i < num_entries; i++)
+			free_percpu(htab_elem_get_ptr(get_htab_elem(htab, i),
+						      round_up(htab->map.key_size, 8)));
+	vfree(htab->elems);
+	return err;
+}
+
+/* get an element for a new key, called with htab->lock held when
+ * preallocated
+ */
+static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab)
+{
+	struct pcpu_freelist_node *node;
+
+	if (!htab_is_prealloc(htab))
+		return kmalloc(htab->elem_size, GFP_ATOMIC | __GFP_NOWARN);
+
+	node = pcpu_freelist_pop(&htab->freelist);
+	if (!node)
+		return NULL;
+
+	return container_of(node, struct htab_elem, fnode);
+}
+
 /* Called from syscall */
 static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 {
+	bool percpu = attr->map_type == BPF_MAP_TYPE_PERCPU_HASH;
 	struct bpf_htab *htab;
 	int err, i;
 
@@ -42,16 +166,19 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 		return ERR_PTR(-ENOMEM);
 
 	/* mandatory map attributes */
+	htab->map.map_type = attr->map_type;
 	htab->map.key_size = attr->key_size;
 	htab->map.value_size = attr->value_size;
 	htab->map.max_entries = attr->max_entries;
+	htab->map.map_flags = attr->map_flags;
 
 	/* check sanity of attributes.
 	 * value_size == 0 may be allowed in the future to use map as a set
 	 */
 	err = -EINVAL;
 	if (htab->map.max_entries == 0 || htab->map.key_size == 0 ||
-	    htab->map.value_size == 0)
+	    htab->map.value_size == 0 ||
+	    (attr->map_flags & ~BPF_F_PREALLOC))
 		goto free_htab;
 
 	/* hash table size must be power of 2 */
@@ -64,6 +191,10 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 		 */
 		goto free_htab;
 
+	if (percpu && round_up(htab->map.value_size, 8) > PCPU_MIN_UNIT_SIZE)
+		/* make sure the size for pcpu_alloc() is reasonable */
+		goto free_htab;
+
 	err = -ENOMEM;
 	/* prevent zero size kmalloc and check for u32 overflow */
 	if (htab->n_buckets == 0 ||
@@ -86,10 +217,22 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 	htab->count = 0;
 
 	htab->elem_size = sizeof(struct htab_elem) +
-			  round_up(htab->map.key_size, 8) +
-			  htab->map.value_size;
+			  round_up(htab->map.key_size, 8);
+	if (percpu)
+		htab->elem_size += sizeof(void *);
+	else
+		htab->elem_size += htab->map.value_size;
+
+	if (htab_is_prealloc(htab)) {
+		err = prealloc_init(htab);
+		if (err)
+			goto free_buckets;
+	}
+
 	return &htab->map;
 
+free_buckets:
+	kvfree(htab->buckets);
 free_htab:
 	kfree(htab);
 	return ERR_PTR(err);
@@ -117,12 +260,10 @@ static struct htab_elem *lookup_elem_raw(struct hlist_head *head, u32 hash,
 	return NULL;
 }
 
-/* Called from syscall or from eBPF program */
-static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
+static struct htab_elem *__htab_map_lookup_elem(struct bpf_map *map, void *key)
 {
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 	struct hlist_head *head;
-	struct htab_elem *l;
 	u32 hash, key_size;
 
 	/* Must be called with rcu_read_lock. */
@@ -134,7 +275,13 @@ static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
 
 	head = select_bucket(htab, hash);
 
-	l = lookup_elem_raw(head, hash, key, key_size);
+	return lookup_elem_raw(head, hash, key, key_size);
+}
+
+/* Called from syscall or from eBPF program */
+static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct htab_elem *l = __htab_map_lookup_elem(map, key);
 
 	if (l)
 		return l->key + round_up(map->key_size, 8);
@@ -142,6 +289,41 @@ static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
 	return NULL;
 }
 
+/* Called from eBPF program, returns this cpu's copy of the value */
+static void *htab_percpu_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct htab_elem *l = __htab_map_lookup_elem(map, key);
+
+	if (l)
+		return this_cpu_ptr(htab_elem_get_ptr(l, round_up(map->key_size, 8)));
+
+	return NULL;
+}
+
+int bpf_percpu_hash_copy(struct bpf_map *map, void *key, void *value)
+{
+	struct htab_elem *l;
+	void __percpu *pptr;
+	u32 size;
+	int cpu, off = 0;
+
+	l = __htab_map_lookup_elem(map, key);
+	if (!l)
+		return -ENOENT;
+
+	/* we cannot take a consistent snapshot of all cpus, copy them one
+	 * by one while programs may still be updating their own copy
+	 */
+	size = round_up(map->value_size, 8);
+	pptr = htab_elem_get_ptr(l, round_up(map->key_size, 8));
+	for_each_possible_cpu(cpu) {
+		memcpy(value + off, per_cpu_ptr(pptr, cpu), size);
+		off += size;
+	}
+
+	return 0;
+}
+
 /* Called from syscall */
 static int htab_map_get_next_key(struct bpf_map *map, void *key, void *next_key)
 {
@@ -200,6 +382,32 @@ find_first_elem:
 	return -ENOENT;
 }
 
+static void htab_elem_free(struct bpf_htab *htab, struct htab_elem *l)
+{
+	if (htab_is_percpu(htab))
+		free_percpu(htab_elem_get_ptr(l, round_up(htab->map.key_size, 8)));
+	kfree(l);
+}
+
+static void htab_elem_free_rcu(struct rcu_head *head)
+{
+	struct htab_elem *l = container_of(head, struct htab_elem, rcu);
+
+	htab_elem_free(l->htab, l);
+}
+
+/* Called with htab->lock held once @l is unlinked. Preallocated elements
+ * go straight back to the freelist and may be reused while an rcu reader
+ * still looks at them, exactly like an update in place.
+ */
+static void free_htab_elem(struct bpf_htab *htab, struct htab_elem *l)
+{
+	if (htab_is_prealloc(htab))
+		pcpu_freelist_push(&htab->freelist, &l->fnode);
+	else
+		call_rcu(&l->rcu, htab_elem_free_rcu);
+}
+
 /* Called from syscall or from eBPF program */
 static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 				u64 map_flags)
@@ -217,16 +425,19 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 
 	WARN_ON_ONCE(!rcu_read_lock_held());
 
-	/* allocate new element outside of lock */
-	l_new = kmalloc(htab->elem_size, GFP_ATOMIC);
+	/* allocate new element outside of lock, with BPF_F_PREALLOC an
+	 * empty freelist means the map is full
+	 */
+	l_new = alloc_htab_elem(htab);
 	if (!l_new)
-		return -ENOMEM;
+		return htab_is_prealloc(htab) ? -E2BIG : -ENOMEM;
 
 	key_size = map->key_size;
 
 	memcpy(l_new->key, key, key_size);
 	memcpy(l_new->key + round_up(key_size, 8), value, map->value_size);
 
+	l_new->htab = htab;
 	l_new->hash = htab_map_hash(l_new->key, key_size);
 
 	/* bpf_map_update_elem() can be called in_irq() */
@@ -262,7 +473,7 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 	hlist_add_head_rcu(&l_new->hash_node, head);
 	if (l_old) {
 		hlist_del_rcu(&l_old->hash_node);
-		kfree_rcu(l_old, rcu);
+		free_htab_elem(htab, l_old);
 	} else {
 		htab->count++;
 	}
@@ -271,10 +482,146 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 	return 0;
 err:
 	spin_unlock_irqrestore(&htab->lock, flags);
-	kfree(l_new);
+	if (htab_is_prealloc(htab))
+		pcpu_freelist_push(&htab->freelist, &l_new->fnode);
+	else
+		kfree(l_new);
+	return ret;
+}
+
+/* with @onallcpus, @value holds one value per possible cpu, as passed in
+ * through the syscall. Otherwise a program updates only its own cpu's copy
+ */
+static void pcpu_copy_value(struct bpf_htab *htab, void __percpu *pptr,
+			    void *value, bool onallcpus)
+{
+	if (!onallcpus) {
+		memcpy(this_cpu_ptr(pptr), value, htab->map.value_size);
+	} else {
+		u32 size = round_up(htab->map.value_size, 8);
+		int off = 0, cpu;
+
+		for_each_possible_cpu(cpu) {
+			memcpy(per_cpu_ptr(pptr, cpu), value + off, size);
+			off += size;
+		}
+	}
+}
+
+static int __htab_percpu_map_update_elem(struct bpf_map *map, void *key,
+					 void *value, u64 map_flags,
+					 bool onallcpus)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	u32 key_size = map->key_size, value_size;
+	struct htab_elem *l_new, *l_old;
+	struct hlist_head *head;
+	void __percpu *pptr;
+	unsigned long flags;
+	u32 hash;
+	int ret;
+
+	if (map_flags > BPF_EXIST)
+		/* unknown flags */
+		return -EINVAL;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	hash = htab_map_hash(key, key_size);
+	value_size = round_up(map->value_size, 8);
+
+	/* bpf_map_update_elem() can be called in_irq() */
+	spin_lock_irqsave(&htab->lock, flags);
+
+	head = select_bucket(htab, hash);
+
+	l_old = lookup_elem_raw(head, hash, key, key_size);
+
+	if (!l_old && unlikely(htab->count >= map->max_entries)) {
+		/* if elem with this 'key' doesn't exist and we've reached
+		 * max_entries limit, fail insertion of new elem
+		 */
+		ret = -E2BIG;
+		goto out;
+	}
+
+	if (l_old && map_flags == BPF_NOEXIST) {
+		/* elem already exists */
+		ret = -EEXIST;
+		goto out;
+	}
+
+	if (!l_old && map_flags == BPF_EXIST) {
+		/* elem doesn't exist, cannot update it */
+		ret = -ENOENT;
+		goto out;
+	}
+
+	ret = 0;
+	if (l_old) {
+		/* per-cpu values are updated in place */
+		pcpu_copy_value(htab, htab_elem_get_ptr(l_old, round_up(key_size, 8)),
+				value, onallcpus);
+		goto out;
+	}
+
+	if (htab_is_prealloc(htab)) {
+		int cpu;
+
+		ret = -E2BIG;
+		l_new = alloc_htab_elem(htab);
+		if (!l_new)
+			goto out;
+
+		/* clear what a previous user of the element left behind */
+		pptr = htab_elem_get_ptr(l_new, round_up(key_size, 8));
+		if (!onallcpus)
+			for_each_possible_cpu(cpu)
+				memset(per_cpu_ptr(pptr, cpu), 0, value_size);
+	} else {
+		ret = -ENOMEM;
+		l_new = alloc_htab_elem(htab);
+		if (!l_new)
+			goto out;
+
+		pptr = __alloc_percpu_gfp(value_size, 8,
+					  GFP_ATOMIC | __GFP_NOWARN);
+		if (!pptr) {
+			kfree(l_new);
+			goto out;
+		}
+	}
+
+	/* the other cpus' copies start out zeroed */
+	pcpu_copy_value(htab, pptr, value, onallcpus);
+
+	memcpy(l_new->key, key, key_size);
+	htab_elem_set_ptr(l_new, round_up(key_size, 8), pptr);
+	l_new->htab = htab;
+	l_new->hash = hash;
+
+	hlist_add_head_rcu(&l_new->hash_node, head);
+	htab->count++;
+	ret = 0;
+out:
+	spin_unlock_irqrestore(&htab->lock, flags);
 	return ret;
 }
 
+/* Called from eBPF program */
+static int htab_percpu_map_update_elem(struct bpf_map *map, void *key,
+				       void *value, u64 map_flags)
+{
+	return __htab_percpu_map_update_elem(map, key, value, map_flags, false);
+}
+
+/* Called from syscall */
+int bpf_percpu_hash_update(struct bpf_map *map, void *key, void *value,
+			   u64 map_flags)
+{
+	return __htab_percpu_map_update_elem(map, key, value, map_flags, true);
+}
+
 /* Called from syscall or from eBPF program */
 static int htab_map_delete_elem(struct bpf_map *map, void *key)
 {
@@ -300,7 +647,7 @@ static int htab_map_delete_elem(struct bpf_map *map, void *key)
 	if (l) {
 		hlist_del_rcu(&l->hash_node);
 		htab->count--;
-		kfree_rcu(l, rcu);
+		free_htab_elem(htab, l);
 		ret = 0;
 	}
 
@@ -320,7 +667,7 @@ static void delete_all_elements(struct bpf_htab *htab)
 		hlist_for_each_entry_safe(l, n, head, hash_node) {
 			hlist_del_rcu(&l->hash_node);
 			htab->count--;
-			kfree(l);
+			htab_elem_free(htab, l);
 		}
 	}
 }
@@ -337,10 +684,15 @@ static void htab_map_free(struct bpf_map *map)
 	 */
 	synchronize_rcu();
 
-	/* some of kfree_rcu() callbacks for elements of this map may not have
-	 * executed. It's ok. Proceed to free residual elements and map itself
+	/* wait for the rcu callbacks of deleted elements, they look at the
+	 * map to free per-cpu values. Then free residual elements and the
+	 * map itself
 	 */
-	delete_all_elements(htab);
+	rcu_barrier();
+	if (htab_is_prealloc(htab))
+		prealloc_destroy(htab);
+	else
+		delete_all_elements(htab);
 	kvfree(htab->buckets);
 	kfree(htab);
 }
@@ -359,9 +711,24 @@ static struct bpf_map_type_list htab_type __read_mostly = {
 	.type = BPF_MAP_TYPE_HASH,
 };
 
+static const struct bpf_map_ops htab_percpu_ops = {
+	.map_alloc = htab_map_alloc,
+	.map_free = htab_map_free,
+	.map_get_next_key = htab_map_get_next_key,
+	.map_lookup_elem = htab_percpu_map_lookup_elem,
+	.map_update_elem = htab_percpu_map_update_elem,
+	.map_delete_elem = htab_map_delete_elem,
+};
+
+static struct bpf_map_type_list htab_percpu_type __read_mostly = {
+	.ops = &htab_percpu_ops,
+	.type = BPF_MAP_TYPE_PERCPU_HASH,
+};
+
 static int __init register_htab_map(void)
 {
 	bpf_register_map_type(&htab_type);
+	bpf_register_map_type(&htab_percpu_type);
 	return 0;
 }
 late_initcall(register_htab_map);
@@ -159,15 +159,36 @@ put_callchain_entry(int rctx)
 struct perf_callchain_entry *
 perf_callchain(struct perf_event *event, struct pt_regs *regs)
 {
-	int rctx;
-	struct perf_callchain_entry *entry;
-
-	int kernel = !event->attr.exclude_callchain_kernel;
-	int user   = !event->attr.exclude_callchain_user;
+	bool kernel = !event->attr.exclude_callchain_kernel;
+	bool user   = !event->attr.exclude_callchain_user;
+	/* Disallow cross-task user callchains. */
+	bool crosstask = event->ctx->task && event->ctx->task != current;
 
 	if (!kernel && !user)
 		return NULL;
 
+	return get_perf_callchain(regs, kernel, user, crosstask, true);
+}
+
+/**
+ * get_perf_callchain - unwind the stack at @regs into a callchain buffer
+ * @regs:	registers to start from
+ * @kernel:	record the kernel part of the stack
+ * @user:	record the user part of the stack
+ * @crosstask:	@regs belong to another task, the user stack is skipped
+ * @add_mark:	insert PERF_CONTEXT_KERNEL/USER markers
+ *
+ * The returned entry is a per-cpu buffer, only valid until interrupts or
+ * preemption are enabled again. The buffers must have been set up with
+ * get_callchain_buffers().
+ */
+struct perf_callchain_entry *
+get_perf_callchain(struct pt_regs *regs, bool kernel, bool user,
+		   bool crosstask, bool add_mark)
+{
+	int rctx;
+	struct perf_callchain_entry *entry;
+
 	entry = get_callchain_entry(&rctx);
 	if (rctx == -1)
 		return NULL;
@@ -178,7 +199,8 @@ perf_callchain(struct perf_event *event, struct pt_regs *regs)
 	entry->nr = 0;
 
 	if (kernel && !user_mode(regs)) {
-		perf_callchain_store(entry, PERF_CONTEXT_KERNEL);
+		if (add_mark)
+			perf_callchain_store(entry, PERF_CONTEXT_KERNEL);
 		perf_callchain_kernel(entry, regs);
 	}
 
@@ -191,13 +213,11 @@ perf_callchain(struct perf_event *event, struct pt_regs *regs)
 		}
 
 		if (regs) {
-			/*
-			 * Disallow cross-task user callchains.
-			 */
-			if (event->ctx->task && event->ctx->task != current)
+			if (crosstask)
 				goto exit_put;
 
-			perf_callchain_store(entry, PERF_CONTEXT_USER);
+			if (add_mark)
+				perf_callchain_store(entry, PERF_CONTEXT_USER);
 			perf_callchain_user(entry, regs);
 		}
 	}
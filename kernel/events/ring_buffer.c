@@ -102,12 +102,30 @@ out:
 	preempt_enable();
 }
 
+static bool __always_inline
+ring_buffer_has_space(unsigned long head, unsigned long tail,
+		      unsigned long data_size, unsigned int size,
+		      bool backward)
+{
+	if (!backward)
+		return CIRC_SPACE(head, tail, data_size) >= size;
+	else
+		return CIRC_SPACE(tail, head, data_size) >= size;
+}
+
+/*
+ * A backward ring buffer is written from the end towards the start:
+ * ->data_head moves down, so the most recent record always starts at
+ * data_head and the buffer can be parsed from there even after it has
+ * wrapped while in overwrite mode.
+ */
 int perf_output_begin(struct perf_output_handle *handle,
 		      struct perf_event *event, unsigned int size)
 {
 	struct ring_buffer *rb;
 	unsigned long tail, offset, head;
 	int have_lost, page_shift;
+	bool backward;
 	struct {
 		struct perf_event_header header;
 		u64			 id;
@@ -125,8 +143,13 @@ int perf_output_begin(struct perf_output_handle *handle,
 	if (unlikely(!rb))
 		goto out;
 
-	if (unlikely(!rb->nr_pages))
+	if (unlikely(rb->paused)) {
+		if (rb->nr_pages)
+			local_inc(&rb->lost);
 		goto out;
+	}
+
+	backward = unlikely(is_write_backward(event));
 
 	handle->rb    = rb;
 	handle->event = event;
@@ -144,7 +167,9 @@ int perf_output_begin(struct perf_output_handle *handle,
 		tail = ACCESS_ONCE(rb->user_page->data_tail);
 		offset = head = local_read(&rb->head);
 		if (!rb->overwrite &&
-		    unlikely(CIRC_SPACE(head, tail, perf_data_size(rb)) < size))
+		    unlikely(!ring_buffer_has_space(head, tail,
+						    perf_data_size(rb),
+						    size, backward)))
 			goto fail;
 
 		/*
@@ -159,9 +184,21 @@ int perf_output_begin(struct perf_output_handle *handle,
 		 * See perf_output_put_handle().
 		 */
 
-		head += size;
+		if (!backward)
+			head += size;
+		else
+			head -= size;
 	} while (local_cmpxchg(&rb->head, offset, head) != offset);
 
+	/*
+	 * The record goes at the new, lower head when writing backward;
+	 * negate head so the wakeup accounting below sees it grow.
+	 */
+	if (backward) {
+		offset = head;
+		head = (u64)(-head);
+	}
+
 	/*
 	 * We rely on the implied barrier() by local_cmpxchg() to ensure
 	 * none of the data stores below can be lifted up by the compiler.
@@ -239,6 +276,13 @@ ring_buffer_init(struct ring_buffer *rb, long watermark, int flags)
 
 	atomic_set(&rb->refcount, 1);
 
+	/*
+	 * perf_output_begin() only checks rb->paused, therefore
+	 * rb->paused must be true if we have no pages for output.
+	 */
+	if (!rb->nr_pages)
+		rb->paused = 1;
+
 	INIT_LIST_HEAD(&rb->event_list);
 	spin_lock_init(&rb->event_lock);
 }
@@ -416,8 +460,9 @@ static struct page *rb_alloc_aux_page(int node, int order)
 {
 	struct page *page;
 
-	if (order > MAX_ORDER)
-		order = MAX_ORDER;
+	/* MAX_ORDER itself is one past the largest order the buddy allocator has */
+	if (order >= MAX_ORDER)
+		order = MAX_ORDER - 1;
 
 	do {
 		page = alloc_pages_node(node, PERF_AUX_GFP, order);
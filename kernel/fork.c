@@ -58,6 +58,8 @@
 #include <linux/tsacct_kern.h>
 #include <linux/cn_proc.h>
 #include <linux/freezer.h>
+#include <linux/task_work.h>
+#include <linux/spawn.h>
 #include <linux/delayacct.h>
 #include <linux/taskstats_kern.h>
 #include <linux/random.h>
@@ -374,6 +376,7 @@ static struct task_struct *dup_task_struct(struct task_struct *orig)
 #endif
 	tsk->splice_pipe = NULL;
 	tsk->task_frag.page = NULL;
+	tsk->wake_q.next = NULL;
 
 	account_kernel_stack(ti, 1);
 
@@ -449,7 +452,8 @@ static int dup_mmap(struct mm_struct *mm, struct mm_struct *oldmm)
 		tmp->vm_mm = mm;
 		if (anon_vma_fork(tmp, mpnt))
 			goto fail_nomem_anon_vma_fork;
-		tmp->vm_flags &= ~VM_LOCKED;
+		tmp->vm_flags &= ~(VM_LOCKED|VM_UFFD_MISSING|VM_UFFD_WP);
+		tmp->vm_userfaultfd_ctx = NULL_VM_UFFD_CTX;
 		tmp->vm_next = tmp->vm_prev = NULL;
 		file = tmp->vm_file;
 		if (file) {
@@ -598,6 +602,9 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p)
 	mm_init_owner(mm, p);
 	mmu_notifier_mm_init(mm);
 	clear_tlb_flush_pending(mm);
+#ifdef CONFIG_FUTEX
+	mm->futex_hash = NULL;
+#endif
 #if defined(CONFIG_TRANSPARENT_HUGEPAGE) && !USE_SPLIT_PMD_PTLOCKS
 	mm->pmd_huge_pte = NULL;
 #endif
@@ -690,6 +697,7 @@ void mmput(struct mm_struct *mm)
 	if (atomic_dec_and_test(&mm->mm_users)) {
 		uprobe_clear_state(mm);
 		exit_aio(mm);
+		futex_mm_release(mm);
 		ksm_exit(mm);
 		khugepaged_exit(mm); /* must run before exit_mmap */
 		exit_mmap(mm);
@@ -1144,10 +1152,6 @@ static int copy_signal(unsigned long clone_flags, struct task_struct *tsk)
 	tty_audit_fork(sig);
 	sched_autogroup_fork(sig);
 
-#ifdef CONFIG_CGROUPS
-	init_rwsem(&sig->group_rwsem);
-#endif
-
 	sig->oom_score_adj = current->signal->oom_score_adj;
 	sig->oom_score_adj_min = current->signal->oom_score_adj_min;
 
@@ -1405,6 +1409,9 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 #ifdef CONFIG_DEBUG_MUTEXES
 	p->blocked_on = NULL; /* not blocked yet */
 #endif
+#ifdef CONFIG_HOTPLUG_CPU
+	p->cpuhp_ref = 0;
+#endif
 #ifdef CONFIG_BCACHE
 	p->sequential_io	= 0;
 	p->sequential_io_avg	= 0;
@@ -1801,6 +1808,174 @@ SYSCALL_DEFINE5(clone, unsigned long, clone_flags, unsigned long, newsp,
 }
 #endif
 
+/*
+ * spawn(2) creates a child that shares the parent's mm like vfork(), so
+ * nothing of the address space is copied, and that runs the exec from a
+ * task_work before it ever returns to user space.  The request is shared
+ * by the parent and the child, as a killed parent stops waiting for it.
+ */
+struct spawn_request {
+	struct callback_head	work;
+	atomic_t		ref;
+	struct filename		*filename;
+	const char __user *const __user *argv;
+	const char __user *const __user *envp;
+	int			error;
+	unsigned int		nr_actions;
+	struct spawn_action	actions[];
+};
+
+static void spawn_request_put(struct spawn_request *req)
+{
+	if (atomic_dec_and_test(&req->ref)) {
+		if (req->filename)
+			putname(req->filename);
+		kfree(req);
+	}
+}
+
+static int spawn_do_actions(struct spawn_request *req)
+{
+	unsigned int i;
+	long ret;
+
+	for (i = 0; i < req->nr_actions; i++) {
+		struct spawn_action *a = &req->actions[i];
+
+		switch (a->type) {
+		case SPAWN_ACTION_CLOSE:
+			ret = sys_close(a->fd);
+			break;
+		case SPAWN_ACTION_DUP2:
+			ret = sys_dup2(a->fd, a->newfd);
+			break;
+		default:
+			ret = -EINVAL;
+			break;
+		}
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+static void spawn_exec_work(struct callback_head *work)
+{
+	struct spawn_request *req = container_of(work, struct spawn_request,
+						 work);
+	struct filename *filename;
+	int ret;
+
+	/* run by exit_task_work(), the child was killed before it got here */
+	if (current->flags & PF_EXITING) {
+		req->error = -EINTR;
+		spawn_request_put(req);
+		return;
+	}
+
+	ret = spawn_do_actions(req);
+	if (!ret) {
+		filename = req->filename;
+		req->filename = NULL;
+		ret = do_execve(filename, req->argv, req->envp);
+	}
+	if (!ret) {
+		spawn_request_put(req);
+		return;
+	}
+
+	/* seen by the parent once mm_release() completes the vfork */
+	req->error = ret;
+	spawn_request_put(req);
+	do_exit(127 << 8);
+}
+
+SYSCALL_DEFINE6(spawn, const char __user *, filename,
+		const char __user *const __user *, argv,
+		const char __user *const __user *, envp,
+		const struct spawn_action __user *, actions,
+		unsigned int, nr_actions, unsigned int, flags)
+{
+	unsigned long clone_flags = CLONE_VM | CLONE_VFORK | SIGCHLD;
+	struct spawn_request *req;
+	struct task_struct *p;
+	struct completion vfork;
+	struct pid *pid;
+	unsigned int i;
+	int trace = 0;
+	long nr;
+
+	if (flags || nr_actions > SPAWN_MAX_ACTIONS)
+		return -EINVAL;
+
+	req = kzalloc(sizeof(*req) + nr_actions * sizeof(req->actions[0]),
+		      GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+	atomic_set(&req->ref, 1);
+	init_task_work(&req->work, spawn_exec_work);
+	req->argv = argv;
+	req->envp = envp;
+	req->nr_actions = nr_actions;
+
+	nr = -EFAULT;
+	if (copy_from_user(req->actions, actions,
+			   nr_actions * sizeof(req->actions[0])))
+		goto out;
+	nr = -EINVAL;
+	for (i = 0; i < nr_actions; i++)
+		if (req->actions[i].reserved)
+			goto out;
+
+	req->filename = getname(filename);
+	if (IS_ERR(req->filename)) {
+		nr = PTR_ERR(req->filename);
+		req->filename = NULL;
+		goto out;
+	}
+
+	if (unlikely(ptrace_event_enabled(current, PTRACE_EVENT_VFORK)))
+		trace = PTRACE_EVENT_VFORK;
+
+	p = copy_process(clone_flags, 0, 0, NULL, NULL, trace);
+	if (IS_ERR(p)) {
+		nr = PTR_ERR(p);
+		goto out;
+	}
+
+	trace_sched_process_fork(current, p);
+
+	pid = get_task_pid(p, PIDTYPE_PID);
+	nr = pid_vnr(pid);
+
+	p->vfork_done = &vfork;
+	init_completion(&vfork);
+	get_task_struct(p);
+
+	/* the child has not run yet, so this cannot fail */
+	atomic_inc(&req->ref);
+	task_work_add(p, &req->work, true);
+
+	wake_up_new_task(p);
+
+	if (unlikely(trace))
+		ptrace_event_pid(trace, pid);
+
+	if (!wait_for_vfork_done(p, &vfork)) {
+		ptrace_event_pid(PTRACE_EVENT_VFORK_DONE, pid);
+		if (req->error) {
+			/* the child is exiting, reap it so it does not linger */
+			sys_wait4(nr, NULL, __WALL, NULL);
+			nr = req->error;
+		}
+	}
+
+	put_pid(pid);
+out:
+	spawn_request_put(req);
+	return nr;
+}
+
 #ifndef ARCH_MIN_MMSTRUCT_ALIGN
 #define ARCH_MIN_MMSTRUCT_ALIGN 0
 #endif
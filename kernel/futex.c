@@ -64,6 +64,8 @@
 #include <linux/hugetlb.h>
 #include <linux/freezer.h>
 #include <linux/bootmem.h>
+#include <linux/vmalloc.h>
+#include <linux/prctl.h>
 
 #include <asm/futex.h>
 
@@ -258,6 +260,17 @@ static unsigned long __read_mostly futex_hashsize;
 
 static struct futex_hash_bucket *futex_queues;
 
+/*
+ * A process can ask for its own table for private futexes, allocated on
+ * the node it runs on, so that they no longer share buckets (and bucket
+ * locks bouncing between nodes) with every other process in the system.
+ * Shared futexes always use the global table.
+ */
+struct futex_private_hash {
+	unsigned long mask;
+	struct futex_hash_bucket queues[];
+};
+
 static inline void futex_get_mm(union futex_key *key)
 {
 	atomic_inc(&key->private.mm->mm_count);
@@ -311,6 +324,14 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
+
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))) {
+		struct futex_private_hash *fph;
+
+		fph = READ_ONCE(key->private.mm->futex_hash);
+		if (fph)
+			return &fph->queues[hash & fph->mask];
+	}
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
@@ -1090,9 +1111,11 @@ static void __unqueue_futex(struct futex_q *q)
 
 /*
  * The hash bucket lock must be held when this is called.
- * Afterwards, the futex_q must not be accessed.
+ * Afterwards, the futex_q must not be accessed. Callers
+ * must ensure to later call wake_up_q() for the actual
+ * wakeups to occur.
  */
-static void wake_futex(struct futex_q *q)
+static void mark_wake_futex(struct wake_q_head *wake_q, struct futex_q *q)
 {
 	struct task_struct *p = q->task;
 
@@ -1100,14 +1123,10 @@ static void wake_futex(struct futex_q *q)
 		return;
 
 	/*
-	 * We set q->lock_ptr = NULL _before_ we wake up the task. If
-	 * a non-futex wake up happens on another CPU then the task
-	 * might exit and p would dereference a non-existing task
-	 * struct. Prevent this by holding a reference on p across the
-	 * wake up.
+	 * Queue the task for later wakeup for after we've released
+	 * the hb->lock. wake_q_add() grabs reference to p.
 	 */
-	get_task_struct(p);
-
+	wake_q_add(wake_q, p);
 	__unqueue_futex(q);
 	/*
 	 * The waiting task can free the futex_q as soon as
@@ -1117,9 +1136,6 @@ static void wake_futex(struct futex_q *q)
 	 */
 	smp_wmb();
 	q->lock_ptr = NULL;
-
-	wake_up_state(p, TASK_NORMAL);
-	put_task_struct(p);
 }
 
 static int wake_futex_pi(u32 __user *uaddr, u32 uval, struct futex_q *this)
@@ -1217,6 +1233,7 @@ futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 	struct futex_q *this, *next;
 	union futex_key key = FUTEX_KEY_INIT;
 	int ret;
+	WAKE_Q(wake_q);
 
 	if (!bitset)
 		return -EINVAL;
@@ -1244,13 +1261,14 @@ futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 			if (!(this->bitset & bitset))
 				continue;
 
-			wake_futex(this);
+			mark_wake_futex(&wake_q, this);
 			if (++ret >= nr_wake)
 				break;
 		}
 	}
 
 	spin_unlock(&hb->lock);
+	wake_up_q(&wake_q);
 out_put_key:
 	put_futex_key(&key);
 out:
@@ -1269,6 +1287,7 @@ futex_wake_op(u32 __user *uaddr1, unsigned int flags, u32 __user *uaddr2,
 	struct futex_hash_bucket *hb1, *hb2;
 	struct futex_q *this, *next;
 	int ret, op_ret;
+	WAKE_Q(wake_q);
 
 retry:
 	ret = get_futex_key(uaddr1, flags & FLAGS_SHARED, &key1, VERIFY_READ);
@@ -1320,7 +1339,7 @@ retry_private:
 				ret = -EINVAL;
 				goto out_unlock;
 			}
-			wake_futex(this);
+			mark_wake_futex(&wake_q, this);
 			if (++ret >= nr_wake)
 				break;
 		}
@@ -1334,7 +1353,7 @@ retry_private:
 					ret = -EINVAL;
 					goto out_unlock;
 				}
-				wake_futex(this);
+				mark_wake_futex(&wake_q, this);
 				if (++op_ret >= nr_wake2)
 					break;
 			}
@@ -1344,6 +1363,7 @@ retry_private:
 
 out_unlock:
 	double_unlock_hb(hb1, hb2);
+	wake_up_q(&wake_q);
 out_put_keys:
 	put_futex_key(&key2);
 out_put_key1:
@@ -1503,6 +1523,7 @@ static int futex_requeue(u32 __user *uaddr1, unsigned int flags,
 	struct futex_pi_state *pi_state = NULL;
 	struct futex_hash_bucket *hb1, *hb2;
 	struct futex_q *this, *next;
+	WAKE_Q(wake_q);
 
 	if (requeue_pi) {
 		/*
@@ -1679,7 +1700,7 @@ retry_private:
 		 * woken by futex_unlock_pi().
 		 */
 		if (++task_count <= nr_wake && !requeue_pi) {
-			wake_futex(this);
+			mark_wake_futex(&wake_q, this);
 			continue;
 		}
 
@@ -1719,6 +1740,7 @@ retry_private:
 out_unlock:
 	free_pi_state(pi_state);
 	double_unlock_hb(hb1, hb2);
+	wake_up_q(&wake_q);
 	hb_waiters_dec(hb2);
 
 	/*
@@ -2252,6 +2274,193 @@ static long futex_wait_restart(struct restart_block *restart)
 }
 
 
+/**
+ * unqueue_multiple() - Remove several futex_q from their hash buckets
+ * @qs:		the futex_q array
+ * @count:	number of entries, all of them queued
+ *
+ * Drops the key references like unqueue_me().
+ *
+ * Return: index of the first futex_q that had been woken, or -1 if none was.
+ */
+static int unqueue_multiple(struct futex_q *qs, int count)
+{
+	int ret = -1;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!unqueue_me(&qs[i]) && ret < 0)
+			ret = i;
+	}
+	return ret;
+}
+
+/**
+ * futex_wait_multiple_setup() - Prepare to wait on several futexes
+ * @wb:		the futex addresses and expected values
+ * @qs:		the associated futex_q
+ * @count:	number of entries in @wb and @qs
+ * @flags:	futex flags (FLAGS_SHARED, etc.)
+ * @woken:	index of an already woken futex_q, if 1 is returned
+ *
+ * Each futex is checked and queued with its hash bucket locked, in array
+ * order, exactly as futex_wait_setup() does for one.  The task state is set
+ * before the first one is queued, so a wakeup on any of them while the
+ * later ones are set up is not lost.
+ *
+ * Return:
+ *  0 - all futex_q are queued, with key references held;
+ *  1 - one of them was woken during setup, nothing is queued;
+ * <0 - -EFAULT or -EWOULDBLOCK, nothing is queued
+ */
+static int futex_wait_multiple_setup(struct futex_wait_block *wb,
+				     struct futex_q *qs, int count,
+				     unsigned int flags, int *woken)
+{
+	struct futex_hash_bucket *hb;
+	u32 __user *uaddr;
+	u32 uval;
+	int ret, i, j;
+
+retry:
+	for (i = 0; i < count; i++) {
+		uaddr = (u32 __user *)(unsigned long)wb[i].uaddr;
+		ret = get_futex_key(uaddr, flags & FLAGS_SHARED, &qs[i].key,
+				    VERIFY_READ);
+		if (unlikely(ret)) {
+			while (--i >= 0)
+				put_futex_key(&qs[i].key);
+			return ret;
+		}
+	}
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	for (i = 0; i < count; i++) {
+		uaddr = (u32 __user *)(unsigned long)wb[i].uaddr;
+
+		hb = queue_lock(&qs[i]);
+		ret = get_futex_value_locked(&uval, uaddr);
+		if (!ret && uval == wb[i].val) {
+			queue_me(&qs[i], hb);
+			continue;
+		}
+		queue_unlock(hb);
+		__set_current_state(TASK_RUNNING);
+
+		*woken = unqueue_multiple(qs, i);
+		for (j = i; j < count; j++)
+			put_futex_key(&qs[j].key);
+		if (*woken >= 0)
+			return 1;
+		if (!ret)
+			return -EWOULDBLOCK;
+
+		ret = get_user(uval, uaddr);
+		if (ret)
+			return ret;
+		goto retry;
+	}
+
+	return 0;
+}
+
+static int futex_wait_multiple(u32 __user *uaddr, unsigned int flags,
+			       u32 count, ktime_t *abs_time)
+{
+	struct hrtimer_sleeper timeout, *to = NULL;
+	struct futex_wait_block *wb;
+	struct futex_q *qs;
+	int ret, woken = -1, i;
+
+	if (!count || count > FUTEX_WAIT_MULTIPLE_MAX)
+		return -EINVAL;
+
+	wb = kmalloc_array(count, sizeof(*wb), GFP_KERNEL);
+	qs = kmalloc_array(count, sizeof(*qs), GFP_KERNEL);
+	ret = -ENOMEM;
+	if (!wb || !qs)
+		goto out_free;
+
+	ret = -EFAULT;
+	if (copy_from_user(wb, uaddr, count * sizeof(*wb)))
+		goto out_free;
+
+	ret = -EINVAL;
+	for (i = 0; i < count; i++) {
+		if (!wb[i].bitset)
+			goto out_free;
+		qs[i] = futex_q_init;
+		qs[i].bitset = wb[i].bitset;
+	}
+
+	if (abs_time) {
+		to = &timeout;
+
+		hrtimer_init_on_stack(&to->timer, (flags & FLAGS_CLOCKRT) ?
+				      CLOCK_REALTIME : CLOCK_MONOTONIC,
+				      HRTIMER_MODE_ABS);
+		hrtimer_init_sleeper(to, current);
+		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
+					     current->timer_slack_ns);
+	}
+
+retry:
+	ret = futex_wait_multiple_setup(wb, qs, count, flags, &woken);
+	if (ret) {
+		if (ret > 0)
+			ret = woken;
+		goto out;
+	}
+
+	/* Arm the timer */
+	if (to) {
+		hrtimer_start_expires(&to->timer, HRTIMER_MODE_ABS);
+		if (!hrtimer_active(&to->timer))
+			to->task = NULL;
+	}
+
+	/*
+	 * If any of the futex_q has been removed from its hash list, another
+	 * task has tried to wake us, and we can skip the call to schedule().
+	 */
+	for (i = 0; i < count; i++) {
+		if (plist_node_empty(&qs[i].list))
+			break;
+	}
+	if (i == count && (!to || to->task))
+		freezable_schedule();
+	__set_current_state(TASK_RUNNING);
+
+	/* unqueue_multiple() drops the key refs */
+	ret = unqueue_multiple(qs, count);
+	if (ret >= 0)
+		goto out;
+	ret = -ETIMEDOUT;
+	if (to && !to->task)
+		goto out;
+
+	/*
+	 * We expect signal_pending(current), but we might be the
+	 * victim of a spurious wakeup as well.
+	 */
+	if (!signal_pending(current))
+		goto retry;
+
+	/* the timeout is absolute, so the syscall can simply be restarted */
+	ret = -ERESTARTSYS;
+
+out:
+	if (to) {
+		hrtimer_cancel(&to->timer);
+		destroy_hrtimer_on_stack(&to->timer);
+	}
+out_free:
+	kfree(qs);
+	kfree(wb);
+	return ret;
+}
+
 /*
  * Userspace tried a 0 -> TID atomic transition of the futex value
  * and failed. The kernel side here does the whole locking operation:
@@ -2923,7 +3132,8 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 
 	if (op & FUTEX_CLOCK_REALTIME) {
 		flags |= FLAGS_CLOCKRT;
-		if (cmd != FUTEX_WAIT_BITSET && cmd != FUTEX_WAIT_REQUEUE_PI)
+		if (cmd != FUTEX_WAIT_BITSET && cmd != FUTEX_WAIT_REQUEUE_PI &&
+		    cmd != FUTEX_WAIT_MULTIPLE)
 			return -ENOSYS;
 	}
 
@@ -2942,6 +3152,8 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 		val3 = FUTEX_BITSET_MATCH_ANY;
 	case FUTEX_WAIT_BITSET:
 		return futex_wait(uaddr, flags, val, timeout, val3);
+	case FUTEX_WAIT_MULTIPLE:
+		return futex_wait_multiple(uaddr, flags, val, timeout);
 	case FUTEX_WAKE:
 		val3 = FUTEX_BITSET_MATCH_ANY;
 	case FUTEX_WAKE_BITSET:
@@ -2980,7 +3192,8 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
 		      cmd == FUTEX_WAIT_BITSET ||
-		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
+		      cmd == FUTEX_WAIT_REQUEUE_PI ||
+		      cmd == FUTEX_WAIT_MULTIPLE)) {
 		if (copy_from_user(&ts, utime, sizeof(ts)) != 0)
 			return -EFAULT;
 		if (!timespec_valid(&ts))
@@ -3002,6 +3215,88 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	return do_futex(uaddr, op, val, tp, uaddr2, val2, val3);
 }
 
+static void futex_hash_init_buckets(struct futex_hash_bucket *hb,
+				    unsigned long nr)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr; i++) {
+		atomic_set(&hb[i].waiters, 0);
+		plist_head_init(&hb[i].chain);
+		spin_lock_init(&hb[i].lock);
+	}
+}
+
+static int futex_hash_set(unsigned long nr_threads)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_private_hash *fph;
+	unsigned long nr;
+	size_t size;
+	int node = numa_node_id();
+
+	if (!nr_threads)
+		nr_threads = num_online_cpus();
+	nr_threads = min(nr_threads, futex_hashsize);
+	nr = clamp_t(unsigned long, roundup_pow_of_two(4 * nr_threads),
+		     16, futex_hashsize);
+	size = sizeof(*fph) + nr * sizeof(fph->queues[0]);
+
+	fph = kzalloc_node(size, GFP_KERNEL | __GFP_NOWARN, node);
+	if (!fph)
+		fph = vzalloc_node(size, node);
+	if (!fph)
+		return -ENOMEM;
+
+	fph->mask = nr - 1;
+	futex_hash_init_buckets(fph->queues, nr);
+
+	/*
+	 * Waiters already queued in the global table would never be found
+	 * by wakers hashing into the new one, so only switch while we are
+	 * the only user of the mm and own no PI futexes.  Nobody else can
+	 * be waiting on a private futex of this mm then.
+	 */
+	down_write(&mm->mmap_sem);
+	if (mm->futex_hash || atomic_read(&mm->mm_users) != 1 ||
+	    !list_empty(&current->pi_state_list)) {
+		up_write(&mm->mmap_sem);
+		kvfree(fph);
+		return -EBUSY;
+	}
+	WRITE_ONCE(mm->futex_hash, fph);
+	up_write(&mm->mmap_sem);
+
+	return 0;
+}
+
+int futex_hash_prctl(unsigned long arg2, unsigned long arg3)
+{
+	struct futex_private_hash *fph;
+
+	switch (arg2) {
+	case PR_FUTEX_HASH_SET:
+		return futex_hash_set(arg3);
+	case PR_FUTEX_HASH_GET:
+		if (arg3)
+			return -EINVAL;
+		fph = READ_ONCE(current->mm->futex_hash);
+		return fph ? fph->mask + 1 : 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Called when the last user of the mm is gone, so no futex operation
+ * can look at the table any more.
+ */
+void futex_mm_release(struct mm_struct *mm)
+{
+	kvfree(mm->futex_hash);
+	mm->futex_hash = NULL;
+}
+
 static void __init futex_detect_cmpxchg(void)
 {
 #ifndef CONFIG_HAVE_FUTEX_CMPXCHG
@@ -3025,7 +3320,6 @@ static void __init futex_detect_cmpxchg(void)
 static int __init futex_init(void)
 {
 	unsigned int futex_shift;
-	unsigned long i;
 
 #if CONFIG_BASE_SMALL
 	futex_hashsize = 16;
@@ -3041,12 +3335,7 @@ static int __init futex_init(void)
 	futex_hashsize = 1UL << futex_shift;
 
 	futex_detect_cmpxchg();
-
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	futex_hash_init_buckets(futex_queues, futex_hashsize);
 
 	return 0;
 }
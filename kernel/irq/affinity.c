@@ -0,0 +1,182 @@
+/*
+ * linux/kernel/irq/affinity.c
+ *
+ * Spreading of multi-queue device interrupts over the cpus, and cpu
+ * hotplug handling of kernel managed interrupt affinities.
+ */
+
+#include <linux/irq.h>
+#include <linux/interrupt.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+
+#include "internals.h"
+
+/*
+ * Move cpus_per_vec cpus from nmsk to irqmsk, keeping sibling threads
+ * of a core on the same vector.
+ */
+static void irq_spread_init_one(struct cpumask *irqmsk, struct cpumask *nmsk,
+				int cpus_per_vec)
+{
+	const struct cpumask *siblmsk;
+	int cpu, sibl;
+
+	while (cpus_per_vec > 0) {
+		cpu = cpumask_first(nmsk);
+		if (cpu >= nr_cpu_ids)
+			return;
+
+		cpumask_clear_cpu(cpu, nmsk);
+		cpumask_set_cpu(cpu, irqmsk);
+		cpus_per_vec--;
+
+		siblmsk = topology_thread_cpumask(cpu);
+		for (sibl = -1; cpus_per_vec > 0; ) {
+			sibl = cpumask_next(sibl, siblmsk);
+			if (sibl >= nr_cpu_ids)
+				break;
+			if (!cpumask_test_and_clear_cpu(sibl, nmsk))
+				continue;
+			cpumask_set_cpu(sibl, irqmsk);
+			cpus_per_vec--;
+		}
+	}
+}
+
+/**
+ * irq_create_affinity_masks - spread interrupt vectors over the cpus
+ * @nvec:	number of vectors to spread
+ *
+ * Hands out the online cpus node by node, so that no vector spans two
+ * nodes as long as there are at least as many vectors as nodes, and
+ * within a node core by core, so that sibling threads share a vector.
+ * With more vectors than cpus the masks repeat.
+ *
+ * Returns a kcalloc()ed array of @nvec masks, to be kfree()d by the
+ * caller, or NULL if it cannot be allocated.
+ */
+struct cpumask *irq_create_affinity_masks(int nvec)
+{
+	int node, nodes, curvec, lastvec, ncpus, vecs_to_assign;
+	int cpus_per_vec, extra_vecs, v;
+	struct cpumask *masks;
+	cpumask_var_t nmsk;
+
+	if (nvec <= 0)
+		return NULL;
+
+	masks = kcalloc(nvec, sizeof(*masks), GFP_KERNEL);
+	if (!masks)
+		return NULL;
+
+	if (!zalloc_cpumask_var(&nmsk, GFP_KERNEL)) {
+		kfree(masks);
+		return NULL;
+	}
+
+	get_online_cpus();
+
+	nodes = 0;
+	for_each_online_node(node)
+		if (cpumask_intersects(cpumask_of_node(node), cpu_online_mask))
+			nodes++;
+
+	/* Fewer vectors than nodes: each vector gets whole nodes */
+	if (nvec <= nodes) {
+		curvec = 0;
+		for_each_online_node(node) {
+			if (!cpumask_intersects(cpumask_of_node(node),
+						cpu_online_mask))
+				continue;
+			cpumask_or(&masks[curvec], &masks[curvec],
+				   cpumask_of_node(node));
+			cpumask_and(&masks[curvec], &masks[curvec],
+				    cpu_online_mask);
+			if (++curvec == nvec)
+				curvec = 0;
+		}
+		goto out;
+	}
+
+	curvec = 0;
+	for_each_online_node(node) {
+		int vecs_per_node;
+
+		cpumask_and(nmsk, cpu_online_mask, cpumask_of_node(node));
+		ncpus = cpumask_weight(nmsk);
+		if (!ncpus)
+			continue;
+
+		/* Share the vectors left evenly among the nodes left */
+		vecs_per_node = (nvec - curvec) / nodes--;
+		vecs_to_assign = min(vecs_per_node, ncpus);
+
+		/* Account for rounding errors */
+		cpus_per_vec = ncpus / vecs_to_assign;
+		extra_vecs = ncpus - vecs_to_assign * cpus_per_vec;
+
+		lastvec = curvec + vecs_to_assign;
+		for (v = 0; curvec < lastvec; curvec++, v++)
+			irq_spread_init_one(&masks[curvec], nmsk,
+					    cpus_per_vec + (v < extra_vecs));
+	}
+
+	/* More vectors than cpus: start over with the masks handed out */
+	for (v = 0; curvec < nvec; curvec++, v++)
+		cpumask_copy(&masks[curvec], &masks[v]);
+
+out:
+	put_online_cpus();
+	free_cpumask_var(nmsk);
+	return masks;
+}
+EXPORT_SYMBOL_GPL(irq_create_affinity_masks);
+
+#ifdef CONFIG_HOTPLUG_CPU
+/*
+ * The architecture breaks the affinity of an interrupt whose cpus all
+ * went offline, and the queue map behind a managed mask may have been
+ * rebuilt for the new set of online cpus.  Once the dust has settled,
+ * point every managed interrupt at its mask again.
+ */
+static void irq_affinity_restore_managed(void)
+{
+	struct irq_desc *desc;
+	struct irq_data *data;
+	unsigned int irq;
+
+	for_each_irq_desc(irq, desc) {
+		if (!desc)
+			continue;
+
+		raw_spin_lock_irq(&desc->lock);
+		data = irq_desc_get_irq_data(desc);
+		if (irqd_affinity_is_managed(data) && desc->affinity_hint &&
+		    cpumask_intersects(desc->affinity_hint, cpu_online_mask) &&
+		    !cpumask_equal(data->affinity, desc->affinity_hint))
+			irq_set_affinity_locked(data, desc->affinity_hint, false);
+		raw_spin_unlock_irq(&desc->lock);
+	}
+}
+
+static int irq_affinity_cpu_callback(struct notifier_block *nfb,
+				     unsigned long action, void *hcpu)
+{
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DEAD:
+		irq_affinity_restore_managed();
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static int __init irq_affinity_init(void)
+{
+	/* run after the block layer has remapped its queues */
+	hotcpu_notifier(irq_affinity_cpu_callback, -10);
+	return 0;
+}
+core_initcall(irq_affinity_init);
+#endif
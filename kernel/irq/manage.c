@@ -256,6 +256,37 @@ int irq_set_affinity_hint(unsigned int irq, const struct cpumask *m)
 }
 EXPORT_SYMBOL_GPL(irq_set_affinity_hint);
 
+/**
+ *	irq_set_managed_affinity - pin an interrupt to a set of cpus
+ *	@irq:	Interrupt to pin
+ *	@m:	cpumask, or NULL to hand the interrupt back
+ *
+ *	Like irq_set_affinity_hint(), but the affinity is owned by the
+ *	kernel from now on: it can no longer be changed through
+ *	/proc/irq/N/smp_affinity, and it is restored from @m whenever cpu
+ *	hotplug has moved the interrupt away.  For queue interrupts whose
+ *	mask follows a queue map, like blk-mq's hctx->cpumask; as with the
+ *	hint, @m has to stay valid until this is called again with NULL.
+ */
+int irq_set_managed_affinity(unsigned int irq, const struct cpumask *m)
+{
+	unsigned long flags;
+	struct irq_desc *desc = irq_get_desc_lock(irq, &flags, IRQ_GET_DESC_CHECK_GLOBAL);
+
+	if (!desc)
+		return -EINVAL;
+	desc->affinity_hint = m;
+	if (m)
+		irqd_set(&desc->irq_data, IRQD_AFFINITY_MANAGED);
+	else
+		irqd_clear(&desc->irq_data, IRQD_AFFINITY_MANAGED);
+	irq_put_desc_unlock(desc, flags);
+	if (m)
+		__irq_set_affinity(irq, m, false);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(irq_set_managed_affinity);
+
 static void irq_affinity_notify(struct work_struct *work)
 {
 	struct irq_affinity_notify *notify =
@@ -338,6 +369,13 @@ setup_affinity(unsigned int irq, struct irq_desc *desc, struct cpumask *mask)
 	if (!irq_can_set_affinity(irq))
 		return 0;
 
+	/* A managed mask is already where the driver wants it */
+	if (irqd_affinity_is_managed(&desc->irq_data) && desc->affinity_hint &&
+	    cpumask_intersects(desc->affinity_hint, cpu_online_mask)) {
+		irq_do_set_affinity(&desc->irq_data, desc->affinity_hint, false);
+		return 0;
+	}
+
 	/*
 	 * Preserve an userspace affinity setup, but make sure that
 	 * one of the targets is online.
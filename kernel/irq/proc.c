@@ -98,6 +98,10 @@ static ssize_t write_irq_affinity(int type, struct file *file,
 	if (!irq_can_set_affinity(irq) || no_irq_affinity)
 		return -EIO;
 
+	/* the kernel keeps managed interrupts aligned with its queue maps */
+	if (irqd_affinity_is_managed(irq_get_irq_data(irq)))
+		return -EIO;
+
 	if (!alloc_cpumask_var(&new_value, GFP_KERNEL))
 		return -ENOMEM;
 
@@ -218,6 +218,72 @@ static struct lock_torture_ops spin_lock_irq_ops = {
 	.name		= "spin_lock_irq"
 };
 
+/*
+ * The ticket_spin_lock and queued_spin_lock types bypass spinlock_t and
+ * run the bare lock algorithms, so that the two can be compared on the
+ * same machine whatever arch_spinlock_t is configured to be.
+ */
+static struct {
+	atomic_t next;
+	atomic_t owner;
+} torture_ticketlock = { ATOMIC_INIT(0), ATOMIC_INIT(0) };
+
+static int torture_ticket_lock_write_lock(void) __acquires(torture_ticketlock)
+{
+	int ticket;
+
+	preempt_disable();
+	ticket = atomic_inc_return(&torture_ticketlock.next) - 1;
+	while (atomic_read(&torture_ticketlock.owner) != ticket)
+		cpu_relax();
+	smp_mb();
+	return 0;
+}
+
+static void torture_ticket_lock_write_unlock(void) __releases(torture_ticketlock)
+{
+	smp_mb__before_atomic();
+	atomic_inc(&torture_ticketlock.owner);
+	preempt_enable();
+}
+
+static struct lock_torture_ops ticket_lock_ops = {
+	.writelock	= torture_ticket_lock_write_lock,
+	.write_delay	= torture_spin_lock_write_delay,
+	.writeunlock	= torture_ticket_lock_write_unlock,
+	.readlock       = NULL,
+	.read_delay     = NULL,
+	.readunlock     = NULL,
+	.name		= "ticket_spin_lock"
+};
+
+#ifdef CONFIG_QUEUED_SPINLOCKS
+static struct qspinlock torture_qspinlock = __ARCH_SPIN_LOCK_UNLOCKED;
+
+static int torture_queued_lock_write_lock(void) __acquires(torture_qspinlock)
+{
+	preempt_disable();
+	queued_spin_lock(&torture_qspinlock);
+	return 0;
+}
+
+static void torture_queued_lock_write_unlock(void) __releases(torture_qspinlock)
+{
+	queued_spin_unlock(&torture_qspinlock);
+	preempt_enable();
+}
+
+static struct lock_torture_ops queued_lock_ops = {
+	.writelock	= torture_queued_lock_write_lock,
+	.write_delay	= torture_spin_lock_write_delay,
+	.writeunlock	= torture_queued_lock_write_unlock,
+	.readlock       = NULL,
+	.read_delay     = NULL,
+	.readunlock     = NULL,
+	.name		= "queued_spin_lock"
+};
+#endif
+
 static DEFINE_RWLOCK(torture_rwlock);
 
 static int torture_rwlock_write_lock(void) __acquires(torture_rwlock)
@@ -640,6 +706,10 @@ static int __init lock_torture_init(void)
 	static struct lock_torture_ops *torture_ops[] = {
 		&lock_busted_ops,
 		&spin_lock_ops, &spin_lock_irq_ops,
+		&ticket_lock_ops,
+#ifdef CONFIG_QUEUED_SPINLOCKS
+		&queued_lock_ops,
+#endif
 		&rw_lock_ops, &rw_lock_irq_ops,
 		&mutex_lock_ops,
 		&rwsem_lock_ops,
@@ -15,6 +15,8 @@
 #include <linux/export.h>
 #include <linux/sched/rt.h>
 #include <linux/osq_lock.h>
+#include <linux/debugfs.h>
+#include <linux/percpu.h>
 
 #include "rwsem.h"
 
@@ -65,8 +67,72 @@
  *	 are only waiters but none active (5th case above), and attempt to
  *	 steal the lock.
  *
+ * Note: Writers that spin on a running owner steal the lock from the queue.
+ *	 A writer at the head of the queue that waited longer than
+ *	 RWSEM_WAIT_TIMEOUT sets sem->handoff, which stops all spinning and
+ *	 stealing until it got the lock.
  */
 
+#define RWSEM_WAIT_TIMEOUT	DIV_ROUND_UP(HZ, 250)
+
+enum rwsem_spin_stat_item {
+	RWSEM_STAT_READ_SPIN,	/* reader got the lock spinning */
+	RWSEM_STAT_READ_SLEEP,	/* reader was queued */
+	RWSEM_STAT_WRITE_SPIN,	/* writer got the lock spinning */
+	RWSEM_STAT_WRITE_SLEEP,	/* writer was queued */
+	RWSEM_STAT_HANDOFF,	/* writer turned lock stealing off */
+	NR_RWSEM_STATS
+};
+
+#ifdef CONFIG_RWSEM_SPIN_STAT
+static DEFINE_PER_CPU(unsigned long, rwsem_spin_stats[NR_RWSEM_STATS]);
+
+static inline void rwsem_stat_inc(enum rwsem_spin_stat_item item)
+{
+	this_cpu_inc(rwsem_spin_stats[item]);
+}
+
+static int rwsem_stat_get(void *data, u64 *val)
+{
+	int item = (long)data;
+	int cpu;
+
+	*val = 0;
+	for_each_possible_cpu(cpu)
+		*val += per_cpu(rwsem_spin_stats[item], cpu);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(rwsem_stat_fops, rwsem_stat_get, NULL, "%llu\n");
+
+static const char * const rwsem_stat_names[NR_RWSEM_STATS] = {
+	[RWSEM_STAT_READ_SPIN]		= "read_spin",
+	[RWSEM_STAT_READ_SLEEP]		= "read_sleep",
+	[RWSEM_STAT_WRITE_SPIN]		= "write_spin",
+	[RWSEM_STAT_WRITE_SLEEP]	= "write_sleep",
+	[RWSEM_STAT_HANDOFF]		= "handoff",
+};
+
+static int __init rwsem_stat_init(void)
+{
+	struct dentry *dir;
+	long i;
+
+	dir = debugfs_create_dir("rwsem_spin", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	for (i = 0; i < NR_RWSEM_STATS; i++)
+		debugfs_create_file(rwsem_stat_names[i], 0444, dir,
+				    (void *)i, &rwsem_stat_fops);
+	return 0;
+}
+fs_initcall(rwsem_stat_init);
+#else
+static inline void rwsem_stat_inc(enum rwsem_spin_stat_item item)
+{
+}
+#endif
+
 /*
  * Initialize an rwsem:
  */
@@ -85,6 +151,7 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	INIT_LIST_HEAD(&sem->wait_list);
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	sem->owner = NULL;
+	sem->handoff = false;
 	osq_lock_init(&sem->osq);
 #endif
 }
@@ -116,10 +183,13 @@ enum rwsem_wake_type {
  * - there must be someone on the queue
  * - the spinlock must be held by the caller
  * - woken process blocks are discarded from the list after having task zeroed
- * - writers are only woken if downgrading is false
+ * - writers are only marked woken if downgrading is false
+ * - the tasks are only queued on @wake_q, the caller wakes them with
+ *   wake_up_q() once the spinlock has been dropped
  */
 static struct rw_semaphore *
-__rwsem_do_wake(struct rw_semaphore *sem, enum rwsem_wake_type wake_type)
+__rwsem_mark_wake(struct rw_semaphore *sem,
+		  enum rwsem_wake_type wake_type, struct wake_q_head *wake_q)
 {
 	struct rwsem_waiter *waiter;
 	struct task_struct *tsk;
@@ -129,12 +199,13 @@ __rwsem_do_wake(struct rw_semaphore *sem, enum rwsem_wake_type wake_type)
 	waiter = list_entry(sem->wait_list.next, struct rwsem_waiter, list);
 	if (waiter->type == RWSEM_WAITING_FOR_WRITE) {
 		if (wake_type == RWSEM_WAKE_ANY)
-			/* Wake writer at the front of the queue, but do not
-			 * grant it the lock yet as we want other writers
-			 * to be able to steal it.  Readers, on the other hand,
+			/* Mark writer at the front of the queue for wakeup,
+			 * but do not grant it the lock yet as we want other
+			 * writers to be able to steal it until the caller
+			 * actually wakes it.  Readers, on the other hand,
 			 * will block as they will notice the queued writer.
 			 */
-			wake_up_process(waiter->task);
+			wake_q_add(wake_q, waiter->task);
 		goto out;
 	}
 
@@ -187,17 +258,15 @@ __rwsem_do_wake(struct rw_semaphore *sem, enum rwsem_wake_type wake_type)
 		waiter = list_entry(next, struct rwsem_waiter, list);
 		next = waiter->list.next;
 		tsk = waiter->task;
+
+		wake_q_add(wake_q, tsk);
 		/*
-		 * Make sure we do not wakeup the next reader before
-		 * setting the nil condition to grant the next reader;
-		 * otherwise we could miss the wakeup on the other
-		 * side and end up sleeping again. See the pairing
-		 * in rwsem_down_read_failed().
+		 * Ensure that the last operation is setting the reader
+		 * waiter to nil such that rwsem_down_read_failed() cannot
+		 * race with do_exit() by always holding a reference count
+		 * to the task to wakeup.
 		 */
-		smp_mb();
-		waiter->task = NULL;
-		wake_up_process(tsk);
-		put_task_struct(tsk);
+		smp_store_release(&waiter->task, NULL);
 	} while (--loop);
 
 	sem->wait_list.next = next;
@@ -207,54 +276,6 @@ __rwsem_do_wake(struct rw_semaphore *sem, enum rwsem_wake_type wake_type)
 	return sem;
 }
 
-/*
- * Wait for the read lock to be granted
- */
-__visible
-struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
-{
-	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
-	struct rwsem_waiter waiter;
-	struct task_struct *tsk = current;
-
-	/* set up my own style of waitqueue */
-	waiter.task = tsk;
-	waiter.type = RWSEM_WAITING_FOR_READ;
-	get_task_struct(tsk);
-
-	raw_spin_lock_irq(&sem->wait_lock);
-	if (list_empty(&sem->wait_list))
-		adjustment += RWSEM_WAITING_BIAS;
-	list_add_tail(&waiter.list, &sem->wait_list);
-
-	/* we're now waiting on the lock, but no longer actively locking */
-	count = rwsem_atomic_update(adjustment, sem);
-
-	/* If there are no active locks, wake the front queued process(es).
-	 *
-	 * If there are no writers and we are first in the queue,
-	 * wake our own waiter to join the existing active readers !
-	 */
-	if (count == RWSEM_WAITING_BIAS ||
-	    (count > RWSEM_WAITING_BIAS &&
-	     adjustment != -RWSEM_ACTIVE_READ_BIAS))
-		sem = __rwsem_do_wake(sem, RWSEM_WAKE_ANY);
-
-	raw_spin_unlock_irq(&sem->wait_lock);
-
-	/* wait to be given the lock */
-	while (true) {
-		set_task_state(tsk, TASK_UNINTERRUPTIBLE);
-		if (!waiter.task)
-			break;
-		schedule();
-	}
-
-	__set_task_state(tsk, TASK_RUNNING);
-	return sem;
-}
-EXPORT_SYMBOL(rwsem_down_read_failed);
-
 static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem)
 {
 	/*
@@ -285,6 +306,10 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 		if (!(count == 0 || count == RWSEM_WAITING_BIAS))
 			return false;
 
+		/* a starved writer waits for the lock to be handed over */
+		if (READ_ONCE(sem->handoff))
+			return false;
+
 		old = cmpxchg(&sem->count, count, count + RWSEM_ACTIVE_WRITE_BIAS);
 		if (old == count) {
 			rwsem_set_owner(sem);
@@ -300,7 +325,7 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 	struct task_struct *owner;
 	bool ret = true;
 
-	if (need_resched())
+	if (need_resched() || READ_ONCE(sem->handoff))
 		return false;
 
 	rcu_read_lock();
@@ -318,7 +343,11 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 		goto done;
 	}
 
-	ret = owner->on_cpu;
+	/*
+	 * Don't spin on an owner that isn't running, either because it is
+	 * not on a cpu or because that cpu is a preempted vCPU.
+	 */
+	ret = owner->on_cpu && !vcpu_is_preempted(task_cpu(owner));
 done:
 	rcu_read_unlock();
 	return ret;
@@ -339,8 +368,12 @@ bool rwsem_spin_on_owner(struct rw_semaphore *sem, struct task_struct *owner)
 		 */
 		barrier();
 
-		/* abort spinning when need_resched or owner is not running */
-		if (!owner->on_cpu || need_resched()) {
+		/*
+		 * abort spinning when need_resched or owner is not running or
+		 * owner's cpu is preempted.
+		 */
+		if (!owner->on_cpu || need_resched() ||
+		    vcpu_is_preempted(task_cpu(owner))) {
 			rcu_read_unlock();
 			return false;
 		}
@@ -409,13 +442,139 @@ done:
 	return taken;
 }
 
+/*
+ * Spin for the read lock while a running writer holds it.
+ *
+ * The read bias added by down_read() is still in place, so no other
+ * writer can take the lock while we spin: the fast path, lock stealing
+ * and the queued writer all need the active count to drop to zero. Only
+ * the writer we found can release it, and once it has done so with no
+ * one queued the count is positive and the read lock is ours. If there
+ * are waiters we fall back to the queue, which grants the lock right
+ * away if it is still free.
+ */
+static bool rwsem_optimistic_spin_read(struct rw_semaphore *sem)
+{
+	struct task_struct *owner;
+	bool taken = false;
+
+	preempt_disable();
+
+	owner = READ_ONCE(sem->owner);
+	if (!owner || !rwsem_can_spin_on_owner(sem))
+		goto done;
+
+	rwsem_spin_on_owner(sem, owner);
+
+	/* pairs with the release of the lock by the writer */
+	if (smp_load_acquire(&sem->count) > 0)
+		taken = true;
+done:
+	preempt_enable();
+	return taken;
+}
+
+/*
+ * A writer that waited too long at the head of the queue turns off lock
+ * stealing, so that the lock is handed to it once the holders are gone.
+ * Called with wait_lock held.
+ */
+static inline bool rwsem_set_handoff(struct rw_semaphore *sem,
+				     struct rwsem_waiter *waiter,
+				     unsigned long timeout)
+{
+	if (sem->handoff || time_before(jiffies, timeout) ||
+	    list_first_entry(&sem->wait_list, struct rwsem_waiter, list) != waiter)
+		return false;
+
+	WRITE_ONCE(sem->handoff, true);
+	rwsem_stat_inc(RWSEM_STAT_HANDOFF);
+	return true;
+}
+
+static inline void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+	WRITE_ONCE(sem->handoff, false);
+}
+
 #else
 static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 {
 	return false;
 }
+
+static bool rwsem_optimistic_spin_read(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static inline bool rwsem_set_handoff(struct rw_semaphore *sem,
+				     struct rwsem_waiter *waiter,
+				     unsigned long timeout)
+{
+	return false;
+}
+
+static inline void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+}
 #endif
 
+/*
+ * Wait for the read lock to be granted
+ */
+__visible
+struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
+{
+	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
+	struct rwsem_waiter waiter;
+	struct task_struct *tsk = current;
+	WAKE_Q(wake_q);
+
+	if (rwsem_optimistic_spin_read(sem)) {
+		rwsem_stat_inc(RWSEM_STAT_READ_SPIN);
+		return sem;
+	}
+	rwsem_stat_inc(RWSEM_STAT_READ_SLEEP);
+
+	/* set up my own style of waitqueue */
+	waiter.task = tsk;
+	waiter.type = RWSEM_WAITING_FOR_READ;
+
+	raw_spin_lock_irq(&sem->wait_lock);
+	if (list_empty(&sem->wait_list))
+		adjustment += RWSEM_WAITING_BIAS;
+	list_add_tail(&waiter.list, &sem->wait_list);
+
+	/* we're now waiting on the lock, but no longer actively locking */
+	count = rwsem_atomic_update(adjustment, sem);
+
+	/* If there are no active locks, wake the front queued process(es).
+	 *
+	 * If there are no writers and we are first in the queue,
+	 * wake our own waiter to join the existing active readers !
+	 */
+	if (count == RWSEM_WAITING_BIAS ||
+	    (count > RWSEM_WAITING_BIAS &&
+	     adjustment != -RWSEM_ACTIVE_READ_BIAS))
+		sem = __rwsem_mark_wake(sem, RWSEM_WAKE_ANY, &wake_q);
+
+	raw_spin_unlock_irq(&sem->wait_lock);
+	wake_up_q(&wake_q);
+
+	/* wait to be given the lock */
+	while (true) {
+		set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+		if (!waiter.task)
+			break;
+		schedule();
+	}
+
+	__set_task_state(tsk, TASK_RUNNING);
+	return sem;
+}
+EXPORT_SYMBOL(rwsem_down_read_failed);
+
 /*
  * Wait until we successfully acquire the write lock
  */
@@ -424,14 +583,19 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 {
 	long count;
 	bool waiting = true; /* any queued threads before us */
+	bool handoff = false;
+	unsigned long timeout;
 	struct rwsem_waiter waiter;
 
 	/* undo write bias from down_write operation, stop active locking */
 	count = rwsem_atomic_update(-RWSEM_ACTIVE_WRITE_BIAS, sem);
 
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_optimistic_spin(sem))
+	if (rwsem_optimistic_spin(sem)) {
+		rwsem_stat_inc(RWSEM_STAT_WRITE_SPIN);
 		return sem;
+	}
+	rwsem_stat_inc(RWSEM_STAT_WRITE_SLEEP);
 
 	/*
 	 * Optimistic spinning failed, proceed to the slowpath
@@ -439,6 +603,7 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	 */
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_WRITE;
+	timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 
 	raw_spin_lock_irq(&sem->wait_lock);
 
@@ -457,8 +622,19 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 		 * no active writers, the lock must be read owned; so we try to
 		 * wake any read locks that were queued ahead of us.
 		 */
-		if (count > RWSEM_WAITING_BIAS)
-			sem = __rwsem_do_wake(sem, RWSEM_WAKE_READERS);
+		if (count > RWSEM_WAITING_BIAS) {
+			WAKE_Q(wake_q);
+
+			sem = __rwsem_mark_wake(sem, RWSEM_WAKE_READERS,
+						&wake_q);
+			/*
+			 * The wakeups are normally issued after wait_lock
+			 * is dropped, but as we keep it to try for the write
+			 * lock here, waking the readers now costs about the
+			 * same as dropping and retaking it.
+			 */
+			wake_up_q(&wake_q);
+		}
 
 	} else
 		count = rwsem_atomic_update(RWSEM_WAITING_BIAS, sem);
@@ -468,6 +644,8 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	while (true) {
 		if (rwsem_try_write_lock(count, sem))
 			break;
+		if (!handoff)
+			handoff = rwsem_set_handoff(sem, &waiter, timeout);
 		raw_spin_unlock_irq(&sem->wait_lock);
 
 		/* Block until there are no active lockers. */
@@ -480,6 +658,8 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	}
 	__set_current_state(TASK_RUNNING);
 
+	if (handoff)
+		rwsem_clear_handoff(sem);
 	list_del(&waiter.list);
 	raw_spin_unlock_irq(&sem->wait_lock);
 
@@ -495,14 +675,16 @@ __visible
 struct rw_semaphore *rwsem_wake(struct rw_semaphore *sem)
 {
 	unsigned long flags;
+	WAKE_Q(wake_q);
 
 	raw_spin_lock_irqsave(&sem->wait_lock, flags);
 
 	/* do nothing if list empty */
 	if (!list_empty(&sem->wait_list))
-		sem = __rwsem_do_wake(sem, RWSEM_WAKE_ANY);
+		sem = __rwsem_mark_wake(sem, RWSEM_WAKE_ANY, &wake_q);
 
 	raw_spin_unlock_irqrestore(&sem->wait_lock, flags);
+	wake_up_q(&wake_q);
 
 	return sem;
 }
@@ -517,14 +699,16 @@ __visible
 struct rw_semaphore *rwsem_downgrade_wake(struct rw_semaphore *sem)
 {
 	unsigned long flags;
+	WAKE_Q(wake_q);
 
 	raw_spin_lock_irqsave(&sem->wait_lock, flags);
 
 	/* do nothing if list empty */
 	if (!list_empty(&sem->wait_list))
-		sem = __rwsem_do_wake(sem, RWSEM_WAKE_READ_OWNED);
+		sem = __rwsem_mark_wake(sem, RWSEM_WAKE_READ_OWNED, &wake_q);
 
 	raw_spin_unlock_irqrestore(&sem->wait_lock, flags);
+	wake_up_q(&wake_q);
 
 	return sem;
 }
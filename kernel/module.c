@@ -292,6 +292,37 @@ static bool each_symbol_in_section(const struct symsearch *arr,
 	return false;
 }
 
+static bool each_symbol_in_module(struct module *mod,
+				  bool (*fn)(const struct symsearch *syms,
+					     struct module *owner,
+					     void *data),
+				  void *data)
+{
+	struct symsearch arr[] = {
+		{ mod->syms, mod->syms + mod->num_syms, mod->crcs,
+		  NOT_GPL_ONLY, false },
+		{ mod->gpl_syms, mod->gpl_syms + mod->num_gpl_syms,
+		  mod->gpl_crcs,
+		  GPL_ONLY, false },
+		{ mod->gpl_future_syms,
+		  mod->gpl_future_syms + mod->num_gpl_future_syms,
+		  mod->gpl_future_crcs,
+		  WILL_BE_GPL_ONLY, false },
+#ifdef CONFIG_UNUSED_SYMBOLS
+		{ mod->unused_syms,
+		  mod->unused_syms + mod->num_unused_syms,
+		  mod->unused_crcs,
+		  NOT_GPL_ONLY, true },
+		{ mod->unused_gpl_syms,
+		  mod->unused_gpl_syms + mod->num_unused_gpl_syms,
+		  mod->unused_gpl_crcs,
+		  GPL_ONLY, true },
+#endif
+	};
+
+	return each_symbol_in_section(arr, ARRAY_SIZE(arr), mod, fn, data);
+}
+
 /* Returns true as soon as fn returns true, otherwise false. */
 bool each_symbol_section(bool (*fn)(const struct symsearch *arr,
 				    struct module *owner,
@@ -322,32 +353,10 @@ bool each_symbol_section(bool (*fn)(const struct symsearch *arr,
 		return true;
 
 	list_for_each_entry_rcu(mod, &modules, list) {
-		struct symsearch arr[] = {
-			{ mod->syms, mod->syms + mod->num_syms, mod->crcs,
-			  NOT_GPL_ONLY, false },
-			{ mod->gpl_syms, mod->gpl_syms + mod->num_gpl_syms,
-			  mod->gpl_crcs,
-			  GPL_ONLY, false },
-			{ mod->gpl_future_syms,
-			  mod->gpl_future_syms + mod->num_gpl_future_syms,
-			  mod->gpl_future_crcs,
-			  WILL_BE_GPL_ONLY, false },
-#ifdef CONFIG_UNUSED_SYMBOLS
-			{ mod->unused_syms,
-			  mod->unused_syms + mod->num_unused_syms,
-			  mod->unused_crcs,
-			  NOT_GPL_ONLY, true },
-			{ mod->unused_gpl_syms,
-			  mod->unused_gpl_syms + mod->num_unused_gpl_syms,
-			  mod->unused_gpl_crcs,
-			  GPL_ONLY, true },
-#endif
-		};
-
 		if (mod->state == MODULE_STATE_UNFORMED)
 			continue;
 
-		if (each_symbol_in_section(arr, ARRAY_SIZE(arr), mod, fn, data))
+		if (each_symbol_in_module(mod, fn, data))
 			return true;
 	}
 	return false;
@@ -1215,6 +1224,47 @@ static inline int same_magic(const char *amagic, const char *bmagic,
 #endif /* CONFIG_MODVERSIONS */
 
 /* Resolve a symbol for this module.  I.e. if we find one, record usage. */
+#ifdef CONFIG_MODULE_UNLOAD
+/*
+ * The symbols a module needs from other modules mostly come from a few of
+ * them, which it already holds references on after the first symbol.
+ * Looking there first saves a search through every loaded module.  Exported
+ * names are unique, so this finds the same symbol find_symbol() would.
+ * Must hold module_mutex.
+ */
+static const struct kernel_symbol *find_symbol_in_uses(struct module *mod,
+						       const char *name,
+						       struct module **owner,
+						       const unsigned long **crc,
+						       bool gplok)
+{
+	struct find_symbol_arg fsa;
+	struct module_use *use;
+
+	fsa.name = name;
+	fsa.gplok = gplok;
+	fsa.warn = true;
+
+	list_for_each_entry(use, &mod->target_list, target_list) {
+		if (each_symbol_in_module(use->target, find_symbol_in_section,
+					  &fsa)) {
+			*owner = fsa.owner;
+			*crc = fsa.crc;
+			return fsa.sym;
+		}
+	}
+	return NULL;
+}
+#else
+static inline const struct kernel_symbol *
+find_symbol_in_uses(struct module *mod, const char *name,
+		    struct module **owner, const unsigned long **crc,
+		    bool gplok)
+{
+	return NULL;
+}
+#endif
+
 static const struct kernel_symbol *resolve_symbol(struct module *mod,
 						  const struct load_info *info,
 						  const char *name,
@@ -1223,6 +1273,7 @@ static const struct kernel_symbol *resolve_symbol(struct module *mod,
 	struct module *owner;
 	const struct kernel_symbol *sym;
 	const unsigned long *crc;
+	bool gplok = !(mod->taints & (1 << TAINT_PROPRIETARY_MODULE));
 	int err;
 
 	/*
@@ -1232,8 +1283,9 @@ static const struct kernel_symbol *resolve_symbol(struct module *mod,
 	 */
 	sched_annotate_sleep();
 	mutex_lock(&module_mutex);
-	sym = find_symbol(name, &owner, &crc,
-			  !(mod->taints & (1 << TAINT_PROPRIETARY_MODULE)), true);
+	sym = find_symbol_in_uses(mod, name, &owner, &crc, gplok);
+	if (!sym)
+		sym = find_symbol(name, &owner, &crc, gplok, true);
 	if (!sym)
 		goto unlock;
 
@@ -46,6 +46,7 @@
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -1492,6 +1493,62 @@ static int console_trylock_for_printk(void)
 	return 1;
 }
 
+/*
+ * Console output is normally left to printk_kthread, so that a burst of
+ * messages does not keep whichever CPU happens to call printk busy on a
+ * slow console.  It is done synchronously before the thread is running,
+ * while the system is going down, during an oops or panic, and when
+ * printk.synchronous is set.
+ */
+static bool printk_sync;
+module_param_named(synchronous, printk_sync, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *printk_kthread __read_mostly;
+static atomic_t printk_kthread_pending = ATOMIC_INIT(0);
+
+static bool printk_offload(void)
+{
+	return printk_kthread && !printk_sync && !oops_in_progress &&
+	       system_state == SYSTEM_RUNNING;
+}
+
+static void printk_kthread_wake(void)
+{
+	atomic_set(&printk_kthread_pending, 1);
+	smp_mb__after_atomic();
+	wake_up_process(printk_kthread);
+}
+
+static int printk_kthread_func(void *data)
+{
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!atomic_read(&printk_kthread_pending))
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		/* messages stored after this are seen below or wake us again */
+		atomic_set(&printk_kthread_pending, 0);
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(task)) {
+		pr_warn("printk: unable to start console thread, printing synchronously\n");
+		return PTR_ERR(task);
+	}
+	printk_kthread = task;
+	return 0;
+}
+late_initcall(printk_kthread_init);
+
 int printk_delay_msec __read_mostly;
 
 static inline void printk_delay(void)
@@ -1760,7 +1817,9 @@ asmlinkage int vprintk_emit(int facility, int level,
 	local_irq_restore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched) {
+	if (!in_sched && printk_offload()) {
+		printk_kthread_wake();
+	} else if (!in_sched) {
 		lockdep_off();
 		/*
 		 * Disable preemption to avoid being preempted while holding
@@ -2611,8 +2670,10 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
+		if (printk_offload())
+			printk_kthread_wake();
 		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		else if (console_trylock())
 			console_unlock();
 	}
 
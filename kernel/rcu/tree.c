@@ -52,10 +52,10 @@
 #include <linux/kthread.h>
 #include <linux/prefetch.h>
 #include <linux/delay.h>
-#include <linux/stop_machine.h>
 #include <linux/random.h>
 #include <linux/ftrace_event.h>
 #include <linux/suspend.h>
+#include <linux/slab.h>
 
 #include "tree.h"
 #include "rcu.h"
@@ -70,6 +70,7 @@ MODULE_ALIAS("rcutree");
 
 static struct lock_class_key rcu_node_class[RCU_NUM_LVLS];
 static struct lock_class_key rcu_fqs_class[RCU_NUM_LVLS];
+static struct lock_class_key rcu_exp_class[RCU_NUM_LVLS];
 
 /*
  * In order to export the rcu_state name to the tracing tools, it
@@ -157,6 +158,7 @@ static void rcu_cleanup_dead_rnp(struct rcu_node *rnp_leaf);
 static void rcu_boost_kthread_setaffinity(struct rcu_node *rnp, int outgoingcpu);
 static void invoke_rcu_core(void);
 static void invoke_rcu_callbacks(struct rcu_state *rsp, struct rcu_data *rdp);
+static void rcu_report_exp_rdp(struct rcu_state *rsp, struct rcu_data *rdp);
 
 /* rcuc/rcub kthread realtime priority */
 static int kthread_prio = CONFIG_RCU_KTHREAD_PRIO;
@@ -209,6 +211,9 @@ static int rcu_gp_in_progress(struct rcu_state *rsp)
  */
 void rcu_sched_qs(void)
 {
+	if (unlikely(__this_cpu_read(rcu_sched_data.exp_pending)))
+		rcu_report_exp_rdp(&rcu_sched_state,
+				   this_cpu_ptr(&rcu_sched_data));
 	if (!__this_cpu_read(rcu_sched_data.passed_quiesce)) {
 		trace_rcu_grace_period(TPS("rcu_sched"),
 				       __this_cpu_read(rcu_sched_data.gpnum),
@@ -3053,14 +3058,178 @@ EXPORT_SYMBOL_GPL(call_rcu_bh);
  * but this change will require some way of tagging the lazy RCU
  * callbacks in the list of pending callbacks. Until then, this
  * function may only be called from __kfree_rcu().
+ *
+ * Rather than queueing one callback per object, the pointers are
+ * gathered per CPU into page-sized blocks, and each batch waits for
+ * a single grace period before being freed from a workqueue.  If no
+ * page can be had, the rcu_head is chained on a per-CPU list instead,
+ * which goes through the same grace period.
+ */
+#define KFREE_DRAIN_JIFFIES	(HZ / 50)
+#define KFREE_BULK_MAX_ENTR \
+	((PAGE_SIZE - 2 * sizeof(void *)) / sizeof(void *))
+
+struct kfree_rcu_bulk_data {
+	unsigned long nr_records;
+	struct kfree_rcu_bulk_data *next;
+	void *records[KFREE_BULK_MAX_ENTR];
+};
+
+/*
+ * Per-CPU kfree_rcu() state.  Objects accumulate in ->bhead/->head
+ * until the monitor hands them over to ->bhead_free/->head_free, which
+ * wait for a grace period and are then freed by ->free_work.  Only one
+ * batch per CPU waits for a grace period at any given time.
+ */
+struct kfree_rcu_cpu {
+	spinlock_t lock;
+	struct kfree_rcu_bulk_data *bhead;
+	struct rcu_head *head;
+	struct kfree_rcu_bulk_data *bhead_free;
+	struct rcu_head *head_free;
+	struct rcu_head rcu;
+	struct work_struct free_work;
+	struct delayed_work monitor_work;
+	bool monitor_todo;
+	bool batch_in_flight;
+};
+
+static DEFINE_PER_CPU(struct kfree_rcu_cpu, krc);
+
+/* Free a batch whose grace period has elapsed, in process context. */
+static void kfree_rcu_free_work(struct work_struct *work)
+{
+	struct kfree_rcu_cpu *krcp = container_of(work, struct kfree_rcu_cpu,
+						  free_work);
+	struct kfree_rcu_bulk_data *bhead, *bnext;
+	struct rcu_head *head, *next;
+	unsigned long flags;
+	unsigned long i;
+
+	spin_lock_irqsave(&krcp->lock, flags);
+	bhead = krcp->bhead_free;
+	krcp->bhead_free = NULL;
+	head = krcp->head_free;
+	krcp->head_free = NULL;
+	spin_unlock_irqrestore(&krcp->lock, flags);
+
+	for (; bhead; bhead = bnext) {
+		bnext = bhead->next;
+		for (i = 0; i < bhead->nr_records; i++)
+			kfree(bhead->records[i]);
+		free_page((unsigned long)bhead);
+		cond_resched();
+	}
+
+	for (; head; head = next) {
+		next = head->next;
+		kfree((void *)head - (unsigned long)head->func);
+	}
+
+	spin_lock_irqsave(&krcp->lock, flags);
+	krcp->batch_in_flight = false;
+	spin_unlock_irqrestore(&krcp->lock, flags);
+}
+
+/* The batch's grace period has elapsed, leave the freeing to a worker. */
+static void kfree_rcu_batch_gp_done(struct rcu_head *rcu)
+{
+	struct kfree_rcu_cpu *krcp = container_of(rcu, struct kfree_rcu_cpu,
+						  rcu);
+
+	schedule_work(&krcp->free_work);
+}
+
+/*
+ * Hand the pending objects over to a grace period, unless the previous
+ * batch is still waiting for its own, in which case try again later.
  */
+static void kfree_rcu_monitor(struct work_struct *work)
+{
+	struct kfree_rcu_cpu *krcp = container_of(work, struct kfree_rcu_cpu,
+						  monitor_work.work);
+	unsigned long flags;
+
+	spin_lock_irqsave(&krcp->lock, flags);
+	if (krcp->batch_in_flight) {
+		schedule_delayed_work(&krcp->monitor_work, KFREE_DRAIN_JIFFIES);
+		spin_unlock_irqrestore(&krcp->lock, flags);
+		return;
+	}
+	krcp->bhead_free = krcp->bhead;
+	krcp->bhead = NULL;
+	krcp->head_free = krcp->head;
+	krcp->head = NULL;
+	krcp->batch_in_flight = true;
+	krcp->monitor_todo = false;
+	spin_unlock_irqrestore(&krcp->lock, flags);
+
+	__call_rcu(&krcp->rcu, kfree_rcu_batch_gp_done, rcu_state_p, -1, 0);
+}
+
+/* Try to put @ptr into the current page-sized block, allocating one. */
+static bool kfree_rcu_bulk_add(struct kfree_rcu_cpu *krcp, void *ptr)
+{
+	struct kfree_rcu_bulk_data *bnode = krcp->bhead;
+
+	if (!bnode || bnode->nr_records == KFREE_BULK_MAX_ENTR) {
+		bnode = (struct kfree_rcu_bulk_data *)
+			__get_free_page(GFP_NOWAIT | __GFP_NOWARN);
+		if (!bnode)
+			return false;
+		bnode->nr_records = 0;
+		bnode->next = krcp->bhead;
+		krcp->bhead = bnode;
+	}
+	bnode->records[bnode->nr_records++] = ptr;
+	return true;
+}
+
 void kfree_call_rcu(struct rcu_head *head,
 		    void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, rcu_state_p, -1, 1);
+	struct kfree_rcu_cpu *krcp;
+	unsigned long flags;
+
+	/* Workqueues are needed to drain the batches. */
+	if (unlikely(!keventd_up())) {
+		__call_rcu(head, func, rcu_state_p, -1, 1);
+		return;
+	}
+
+	local_irq_save(flags);
+	krcp = this_cpu_ptr(&krc);
+	spin_lock(&krcp->lock);
+
+	if (!kfree_rcu_bulk_add(krcp, (void *)head - (unsigned long)func)) {
+		head->func = func;
+		head->next = krcp->head;
+		krcp->head = head;
+	}
+
+	if (!krcp->monitor_todo) {
+		krcp->monitor_todo = true;
+		schedule_delayed_work(&krcp->monitor_work, KFREE_DRAIN_JIFFIES);
+	}
+
+	spin_unlock(&krcp->lock);
+	local_irq_restore(flags);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
+static void __init kfree_rcu_batch_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct kfree_rcu_cpu *krcp = per_cpu_ptr(&krc, cpu);
+
+		spin_lock_init(&krcp->lock);
+		INIT_WORK(&krcp->free_work, kfree_rcu_free_work);
+		INIT_DELAYED_WORK(&krcp->monitor_work, kfree_rcu_monitor);
+	}
+}
+
 /*
  * Because a context switch is a grace period for RCU-sched and RCU-bh,
  * any blocking grace-period wait automatically implies a grace period
@@ -3216,21 +3385,221 @@ void cond_synchronize_rcu(unsigned long oldstate)
 }
 EXPORT_SYMBOL_GPL(cond_synchronize_rcu);
 
-static int synchronize_sched_expedited_cpu_stop(void *data)
+/* Adjust sequence number for start of update-side operation. */
+static void rcu_seq_start(unsigned long *sp)
+{
+	ACCESS_ONCE(*sp) = *sp + 1;
+	smp_mb(); /* Ensure update-side operation after counter increment. */
+	WARN_ON_ONCE(!(*sp & 0x1));
+}
+
+/* Adjust sequence number for end of update-side operation. */
+static void rcu_seq_end(unsigned long *sp)
+{
+	smp_mb(); /* Ensure update-side operation before counter increment. */
+	ACCESS_ONCE(*sp) = *sp + 1;
+	WARN_ON_ONCE(*sp & 0x1);
+}
+
+/*
+ * Take a snapshot of the update side's sequence number: the value it
+ * will have once a full update-side operation has elapsed after now.
+ */
+static unsigned long rcu_seq_snap(unsigned long *sp)
+{
+	unsigned long s;
+
+	smp_mb(); /* Caller's modifications seen first by other CPUs. */
+	s = (ACCESS_ONCE(*sp) + 3) & ~0x1;
+	smp_mb(); /* Above access must not bleed into critical section. */
+	return s;
+}
+
+/*
+ * Given a snapshot from rcu_seq_snap(), determine whether or not a
+ * full update-side operation has occurred.
+ */
+static bool rcu_seq_done(unsigned long *sp, unsigned long s)
+{
+	return ULONG_CMP_GE(ACCESS_ONCE(*sp), s);
+}
+
+/*
+ * Check to see if some other expedited grace period covering ours
+ * completed since the snapshot @s was taken, releasing @rnp if so.
+ */
+static bool sync_exp_work_done(struct rcu_state *rsp, struct rcu_node *rnp,
+			       atomic_long_t *stat, unsigned long s)
+{
+	if (rcu_seq_done(&rsp->expedited_sequence, s)) {
+		if (rnp)
+			mutex_unlock(&rnp->exp_funnel_mutex);
+		/* Ensure test happens before caller kfree(). */
+		smp_mb__before_atomic(); /* ^^^ */
+		atomic_long_inc(stat);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Funnel-lock acquisition for expedited grace periods.  Callers work
+ * their way from their own leaf rcu_node structure up to the root,
+ * holding at most two ->exp_funnel_mutex at a time, and give up as
+ * soon as an expedited grace period that covers their snapshot @s has
+ * completed.  Returns the root rcu_node structure with its
+ * ->exp_funnel_mutex held, or NULL if someone else did our work.
+ *
+ * Concurrent callers thus queue up at the lower levels of the tree,
+ * and only one of them per subtree reaches the root: whichever grace
+ * period is running when they get there covers all of them.
+ */
+static struct rcu_node *exp_funnel_lock(struct rcu_state *rsp, unsigned long s)
 {
+	struct rcu_node *rnp0;
+	struct rcu_node *rnp1 = NULL;
+
 	/*
-	 * There must be a full memory barrier on each affected CPU
-	 * between the time that try_stop_cpus() is called and the
-	 * time that it returns.
-	 *
-	 * In the current initial implementation of cpu_stop, the
-	 * above condition is already met when the control reaches
-	 * this point and the following smp_mb() is not strictly
-	 * necessary.  Do smp_mb() anyway for documentation and
-	 * robustness against future implementation changes.
+	 * First try directly acquiring the root lock in order to reduce
+	 * latency in the common case where expedited grace periods are
+	 * rare.  Checking mutex_is_locked() first avoids hammering the
+	 * root's cacheline under heavy load.
 	 */
-	smp_mb(); /* See above comment block. */
-	return 0;
+	rnp0 = rcu_get_root(rsp);
+	if (!mutex_is_locked(&rnp0->exp_funnel_mutex) &&
+	    mutex_trylock(&rnp0->exp_funnel_mutex)) {
+		if (sync_exp_work_done(rsp, rnp0, &rsp->expedited_workdone0, s))
+			return NULL;
+		return rnp0;
+	}
+
+	/*
+	 * The mapping from CPU to rcu_node structure need not be exact,
+	 * as it only promotes locality, so migration is harmless here.
+	 */
+	rnp0 = per_cpu_ptr(rsp->rda, raw_smp_processor_id())->mynode;
+	for (; rnp0 != NULL; rnp0 = rnp0->parent) {
+		if (sync_exp_work_done(rsp, rnp1, &rsp->expedited_workdone1, s))
+			return NULL;
+		mutex_lock(&rnp0->exp_funnel_mutex);
+		if (rnp1)
+			mutex_unlock(&rnp1->exp_funnel_mutex);
+		rnp1 = rnp0;
+	}
+	if (sync_exp_work_done(rsp, rnp1, &rsp->expedited_workdone2, s))
+		return NULL;
+	return rnp1;
+}
+
+/*
+ * Report an expedited quiescent state for the specified rcu_data
+ * structure, waking up the task driving the expedited grace period
+ * if this was the last CPU it was waiting on.  Reports for
+ * CPUs the current expedited grace period is not waiting on are
+ * ignored, so this may be invoked more than once per CPU.
+ */
+static void rcu_report_exp_rdp(struct rcu_state *rsp, struct rcu_data *rdp)
+{
+	if (!xchg(&rdp->exp_pending, 0))
+		return;
+	if (atomic_dec_and_test(&rsp->expedited_need_qs))
+		wake_up(&rsp->expedited_wq);
+}
+
+/*
+ * IPI handler for expedited RCU-sched grace periods.  An idle CPU, or
+ * one interrupted directly from idle or nohz_full usermode, is already
+ * in a quiescent state.  Otherwise the CPU is forced through the
+ * scheduler, and rcu_sched_qs() reports the quiescent state on the
+ * next context switch.
+ */
+static void sync_sched_exp_handler(void *data)
+{
+	struct rcu_state *rsp = data;
+	struct rcu_data *rdp = this_cpu_ptr(rsp->rda);
+
+	if (!ACCESS_ONCE(rdp->exp_pending))
+		return;
+	if (rcu_is_cpu_rrupt_from_idle()) {
+		rcu_report_exp_rdp(rsp, rdp);
+		return;
+	}
+	resched_cpu(smp_processor_id());
+}
+
+/*
+ * Select the CPUs that the expedited grace period must wait on and
+ * IPI them.  The rcu_node tree is walked leaf by leaf, and CPUs that
+ * are offline or in an extended quiescent state (dyntick-idle or
+ * nohz_full usermode) are left alone, as is the current CPU.
+ */
+static void sync_sched_exp_select_cpus(struct rcu_state *rsp)
+{
+	struct rcu_node *rnp;
+	int cpu;
+
+	/* One extra count so that the waiter is not woken before we finish. */
+	atomic_set(&rsp->expedited_need_qs, 1);
+	rcu_for_each_leaf_node(rsp, rnp) {
+		for (cpu = rnp->grplo; cpu <= rnp->grphi; cpu++) {
+			struct rcu_data *rdp = per_cpu_ptr(rsp->rda, cpu);
+			struct rcu_dynticks *rdtp = &per_cpu(rcu_dynticks, cpu);
+
+			if (!cpu_online(cpu) || cpu == raw_smp_processor_id() ||
+			    !(atomic_add_return(0, &rdtp->dynticks) & 0x1))
+				continue;
+
+			atomic_inc(&rsp->expedited_need_qs);
+			ACCESS_ONCE(rdp->exp_pending) = 1;
+			smp_mb(); /* ->exp_pending before the IPI. */
+			if (smp_call_function_single(cpu, sync_sched_exp_handler,
+						     rsp, 0))
+				rcu_report_exp_rdp(rsp, rdp); /* Went offline. */
+		}
+	}
+}
+
+/*
+ * Wait for all the CPUs selected by sync_sched_exp_select_cpus() to
+ * report a quiescent state, complaining about the laggards at stall
+ * warning intervals.
+ */
+static void synchronize_sched_expedited_wait(struct rcu_state *rsp)
+{
+	unsigned long jiffies_stall = rcu_jiffies_till_stall_check();
+	int cpu;
+	int ret;
+
+	if (atomic_dec_and_test(&rsp->expedited_need_qs))
+		return;
+
+	for (;;) {
+		ret = wait_event_timeout(rsp->expedited_wq,
+					 !atomic_read(&rsp->expedited_need_qs),
+					 jiffies_stall);
+		if (ret > 0)
+			return;
+		if (rcu_cpu_stall_suppress)
+			continue;
+
+		pr_err("INFO: %s detected expedited stalls on CPUs: {",
+		       rsp->name);
+		for_each_online_cpu(cpu) {
+			struct rcu_data *rdp = per_cpu_ptr(rsp->rda, cpu);
+
+			if (ACCESS_ONCE(rdp->exp_pending))
+				pr_cont(" %d", cpu);
+		}
+		pr_cont(" } %lu jiffies s: %lu\n",
+			jiffies_stall, rsp->expedited_sequence);
+		for_each_online_cpu(cpu) {
+			struct rcu_data *rdp = per_cpu_ptr(rsp->rda, cpu);
+
+			if (ACCESS_ONCE(rdp->exp_pending))
+				dump_cpu_task(cpu);
+		}
+		jiffies_stall = 3 * rcu_jiffies_till_stall_check() + 3;
+	}
 }
 
 /**
@@ -3244,58 +3613,22 @@ static int synchronize_sched_expedited_cpu_stop(void *data)
  * restructure your code to batch your updates, and then use a single
  * synchronize_sched() instead.
  *
- * This implementation can be thought of as an application of ticket
- * locking to RCU, with sync_sched_expedited_started and
- * sync_sched_expedited_done taking on the roles of the halves
- * of the ticket-lock word.  Each task atomically increments
- * sync_sched_expedited_started upon entry, snapshotting the old value,
- * then attempts to stop all the CPUs.  If this succeeds, then each
- * CPU will have executed a context switch, resulting in an RCU-sched
- * grace period.  We are then done, so we use atomic_cmpxchg() to
- * update sync_sched_expedited_done to match our snapshot -- but
- * only if someone else has not already advanced past our snapshot.
- *
- * On the other hand, if try_stop_cpus() fails, we check the value
- * of sync_sched_expedited_done.  If it has advanced past our
- * initial snapshot, then someone else must have forced a grace period
- * some time after we took our snapshot.  In this case, our work is
- * done for us, and we can simply return.  Otherwise, we try again,
- * but keep our initial snapshot for purposes of checking for someone
- * doing our work for us.
- *
- * If we fail too many times in a row, we fall back to synchronize_sched().
+ * The hammer is an IPI to each online CPU that is not in an extended
+ * quiescent state, selected by walking the rcu_node tree, so idle and
+ * nohz_full usermode CPUs are not disturbed.  Concurrent callers are
+ * funneled through the rcu_node tree's ->exp_funnel_mutex, and all
+ * callers that took their snapshot of ->expedited_sequence before an
+ * expedited grace period started are covered by it.
  */
 void synchronize_sched_expedited(void)
 {
-	cpumask_var_t cm;
-	bool cma = false;
-	int cpu;
-	long firstsnap, s, snap;
-	int trycount = 0;
+	unsigned long s;
+	struct rcu_node *rnp;
 	struct rcu_state *rsp = &rcu_sched_state;
 
-	/*
-	 * If we are in danger of counter wrap, just do synchronize_sched().
-	 * By allowing sync_sched_expedited_started to advance no more than
-	 * ULONG_MAX/8 ahead of sync_sched_expedited_done, we are ensuring
-	 * that more than 3.5 billion CPUs would be required to force a
-	 * counter wrap on a 32-bit system.  Quite a few more CPUs would of
-	 * course be required on a 64-bit system.
-	 */
-	if (ULONG_CMP_GE((ulong)atomic_long_read(&rsp->expedited_start),
-			 (ulong)atomic_long_read(&rsp->expedited_done) +
-			 ULONG_MAX / 8)) {
-		synchronize_sched();
-		atomic_long_inc(&rsp->expedited_wrap);
-		return;
-	}
+	/* Take a snapshot of the sequence number. */
+	s = rcu_seq_snap(&rsp->expedited_sequence);
 
-	/*
-	 * Take a ticket.  Note that atomic_inc_return() implies a
-	 * full memory barrier.
-	 */
-	snap = atomic_long_inc_return(&rsp->expedited_start);
-	firstsnap = snap;
 	if (!try_get_online_cpus()) {
 		/* CPU hotplug operation in flight, fall back to normal GP. */
 		wait_rcu_gp(call_rcu_sched);
@@ -3304,101 +3637,18 @@ void synchronize_sched_expedited(void)
 	}
 	WARN_ON_ONCE(cpu_is_offline(raw_smp_processor_id()));
 
-	/* Offline CPUs, idle CPUs, and any CPU we run on are quiescent. */
-	cma = zalloc_cpumask_var(&cm, GFP_KERNEL);
-	if (cma) {
-		cpumask_copy(cm, cpu_online_mask);
-		cpumask_clear_cpu(raw_smp_processor_id(), cm);
-		for_each_cpu(cpu, cm) {
-			struct rcu_dynticks *rdtp = &per_cpu(rcu_dynticks, cpu);
-
-			if (!(atomic_add_return(0, &rdtp->dynticks) & 0x1))
-				cpumask_clear_cpu(cpu, cm);
-		}
-		if (cpumask_weight(cm) == 0)
-			goto all_cpus_idle;
-	}
-
-	/*
-	 * Each pass through the following loop attempts to force a
-	 * context switch on each CPU.
-	 */
-	while (try_stop_cpus(cma ? cm : cpu_online_mask,
-			     synchronize_sched_expedited_cpu_stop,
-			     NULL) == -EAGAIN) {
+	rnp = exp_funnel_lock(rsp, s);
+	if (rnp == NULL) {
 		put_online_cpus();
-		atomic_long_inc(&rsp->expedited_tryfail);
-
-		/* Check to see if someone else did our work for us. */
-		s = atomic_long_read(&rsp->expedited_done);
-		if (ULONG_CMP_GE((ulong)s, (ulong)firstsnap)) {
-			/* ensure test happens before caller kfree */
-			smp_mb__before_atomic(); /* ^^^ */
-			atomic_long_inc(&rsp->expedited_workdone1);
-			free_cpumask_var(cm);
-			return;
-		}
-
-		/* No joy, try again later.  Or just synchronize_sched(). */
-		if (trycount++ < 10) {
-			udelay(trycount * num_online_cpus());
-		} else {
-			wait_rcu_gp(call_rcu_sched);
-			atomic_long_inc(&rsp->expedited_normal);
-			free_cpumask_var(cm);
-			return;
-		}
-
-		/* Recheck to see if someone else did our work for us. */
-		s = atomic_long_read(&rsp->expedited_done);
-		if (ULONG_CMP_GE((ulong)s, (ulong)firstsnap)) {
-			/* ensure test happens before caller kfree */
-			smp_mb__before_atomic(); /* ^^^ */
-			atomic_long_inc(&rsp->expedited_workdone2);
-			free_cpumask_var(cm);
-			return;
-		}
-
-		/*
-		 * Refetching sync_sched_expedited_started allows later
-		 * callers to piggyback on our grace period.  We retry
-		 * after they started, so our grace period works for them,
-		 * and they started after our first try, so their grace
-		 * period works for us.
-		 */
-		if (!try_get_online_cpus()) {
-			/* CPU hotplug operation in flight, use normal GP. */
-			wait_rcu_gp(call_rcu_sched);
-			atomic_long_inc(&rsp->expedited_normal);
-			free_cpumask_var(cm);
-			return;
-		}
-		snap = atomic_long_read(&rsp->expedited_start);
-		smp_mb(); /* ensure read is before try_stop_cpus(). */
+		return;  /* Someone else did our work for us. */
 	}
-	atomic_long_inc(&rsp->expedited_stoppedcpus);
 
-all_cpus_idle:
-	free_cpumask_var(cm);
-
-	/*
-	 * Everyone up to our most recent fetch is covered by our grace
-	 * period.  Update the counter, but only if our work is still
-	 * relevant -- which it won't be if someone who started later
-	 * than we did already did their update.
-	 */
-	do {
-		atomic_long_inc(&rsp->expedited_done_tries);
-		s = atomic_long_read(&rsp->expedited_done);
-		if (ULONG_CMP_GE((ulong)s, (ulong)snap)) {
-			/* ensure test happens before caller kfree */
-			smp_mb__before_atomic(); /* ^^^ */
-			atomic_long_inc(&rsp->expedited_done_lost);
-			break;
-		}
-	} while (atomic_long_cmpxchg(&rsp->expedited_done, s, snap) != s);
-	atomic_long_inc(&rsp->expedited_done_exit);
+	rcu_seq_start(&rsp->expedited_sequence);
+	sync_sched_exp_select_cpus(rsp);
+	synchronize_sched_expedited_wait(rsp);
+	rcu_seq_end(&rsp->expedited_sequence);
 
+	mutex_unlock(&rnp->exp_funnel_mutex);
 	put_online_cpus();
 }
 EXPORT_SYMBOL_GPL(synchronize_sched_expedited);
@@ -3961,6 +4211,11 @@ static void __init rcu_init_one(struct rcu_state *rsp,
 		"rcu_node_fqs_1",
 		"rcu_node_fqs_2",
 		"rcu_node_fqs_3" };  /* Match MAX_RCU_LVLS */
+	static const char * const exp[] = {
+		"rcu_node_exp_0",
+		"rcu_node_exp_1",
+		"rcu_node_exp_2",
+		"rcu_node_exp_3" };  /* Match MAX_RCU_LVLS */
 	static u8 fl_mask = 0x1;
 	int cpustride = 1;
 	int i;
@@ -3995,6 +4250,9 @@ static void __init rcu_init_one(struct rcu_state *rsp,
 			raw_spin_lock_init(&rnp->fqslock);
 			lockdep_set_class_and_name(&rnp->fqslock,
 						   &rcu_fqs_class[i], fqs[i]);
+			mutex_init(&rnp->exp_funnel_mutex);
+			lockdep_set_class_and_name(&rnp->exp_funnel_mutex,
+						   &rcu_exp_class[i], exp[i]);
 			rnp->gpnum = rsp->gpnum;
 			rnp->completed = rsp->completed;
 			rnp->qsmask = 0;
@@ -4020,6 +4278,7 @@ static void __init rcu_init_one(struct rcu_state *rsp,
 	}
 
 	init_waitqueue_head(&rsp->gp_wq);
+	init_waitqueue_head(&rsp->expedited_wq);
 	rnp = rsp->level[rcu_num_lvls - 1];
 	for_each_possible_cpu(i) {
 		while (i > rnp->grphi)
@@ -4118,6 +4377,7 @@ void __init rcu_init(void)
 	rcu_init_one(&rcu_bh_state, &rcu_bh_data);
 	rcu_init_one(&rcu_sched_state, &rcu_sched_data);
 	__rcu_init_preempt();
+	kfree_rcu_batch_init();
 	open_softirq(RCU_SOFTIRQ, rcu_process_callbacks);
 
 	/*
@@ -2483,7 +2483,9 @@ static int rcu_nocb_leader_stride = -1;
 module_param(rcu_nocb_leader_stride, int, 0444);
 
 /*
- * Initialize leader-follower relationships for all no-CBs CPU.
+ * Initialize leader-follower relationships for all no-CBs CPU.  A leader
+ * never takes followers from another NUMA node, so that the callbacks
+ * of a group, and the rcuo kthreads handling them, stay node-local.
  */
 static void __init rcu_organize_nocb_kthreads(struct rcu_state *rsp)
 {
@@ -2507,7 +2509,8 @@ static void __init rcu_organize_nocb_kthreads(struct rcu_state *rsp)
 	 */
 	for_each_cpu(cpu, rcu_nocb_mask) {
 		rdp = per_cpu_ptr(rsp->rda, cpu);
-		if (rdp->cpu >= nl) {
+		if (rdp->cpu >= nl ||
+		    cpu_to_node(rdp->cpu) != cpu_to_node(rdp_leader->cpu)) {
 			/* New leader, set up for followers & next leader. */
 			nl = DIV_ROUND_UP(rdp->cpu + 1, ls) * ls;
 			rdp->nocb_leader = rdp;
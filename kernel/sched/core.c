@@ -806,6 +806,7 @@ static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_queued(rq, p);
+	psi_enqueue(p, flags & ENQUEUE_WAKEUP);
 	p->sched_class->enqueue_task(rq, p, flags);
 }
 
@@ -813,6 +814,7 @@ static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_dequeued(rq, p);
+	psi_dequeue(p, flags & DEQUEUE_SLEEP);
 	p->sched_class->dequeue_task(rq, p, flags);
 }
 
@@ -1593,15 +1595,25 @@ void scheduler_ipi(void)
 	irq_exit();
 }
 
+/*
+ * Only the wakeup that finds the wake_list empty kicks the target; every
+ * wakeup queued before the target runs sched_ttwu_pending() rides on the
+ * same IPI.  A target polling in idle notices the list without one.
+ */
 static void ttwu_queue_remote(struct task_struct *p, int cpu)
 {
 	struct rq *rq = cpu_rq(cpu);
 
+	schedstat_inc(this_rq(), ttwu_queued);
+
 	if (llist_add(&p->wake_entry, &cpu_rq(cpu)->wake_list)) {
-		if (!set_nr_if_polling(rq->idle))
+		if (!set_nr_if_polling(rq->idle)) {
+			schedstat_inc(this_rq(), ttwu_queued_ipi);
 			smp_send_reschedule(cpu);
-		else
+		} else {
+			schedstat_inc(this_rq(), ttwu_queued_poll);
 			trace_sched_wake_idle_without_ipi(cpu);
+		}
 	}
 }
 
@@ -1711,6 +1723,7 @@ try_to_wake_up(struct task_struct *p, unsigned int state, int wake_flags)
 	cpu = select_task_rq(p, p->wake_cpu, SD_BALANCE_WAKE, wake_flags);
 	if (task_cpu(p) != cpu) {
 		wake_flags |= WF_MIGRATED;
+		psi_ttwu_dequeue(p);
 		set_task_cpu(p, cpu);
 	}
 #endif /* CONFIG_SMP */
@@ -1784,6 +1797,52 @@ int wake_up_state(struct task_struct *p, unsigned int state)
 	return try_to_wake_up(p, state, 0);
 }
 
+void wake_q_add(struct wake_q_head *head, struct task_struct *task)
+{
+	struct wake_q_node *node = &task->wake_q;
+
+	/*
+	 * Atomically grab the task, if ->wake_q is !nil already it means
+	 * its already queued (either by us or someone else) and will get the
+	 * wakeup due to that.
+	 *
+	 * This cmpxchg() implies a full barrier, which pairs with the write
+	 * barrier implied by the wakeup in wake_up_q().
+	 */
+	if (cmpxchg(&node->next, NULL, WAKE_Q_TAIL))
+		return;
+
+	get_task_struct(task);
+
+	/*
+	 * The head is context local, there can be no concurrency.
+	 */
+	*head->lastp = node;
+	head->lastp = &node->next;
+}
+
+void wake_up_q(struct wake_q_head *head)
+{
+	struct wake_q_node *node = head->first;
+
+	while (node != WAKE_Q_TAIL) {
+		struct task_struct *task;
+
+		task = container_of(node, struct task_struct, wake_q);
+		BUG_ON(!task);
+		/* task can safely be re-inserted now */
+		node = node->next;
+		task->wake_q.next = NULL;
+
+		/*
+		 * wake_up_process() implies a wmb() to pair with the queueing
+		 * in wake_q_add() so as not to miss wakeups.
+		 */
+		wake_up_process(task);
+		put_task_struct(task);
+	}
+}
+
 /*
  * This function clears the sched_dl_entity static params.
  */
@@ -1820,6 +1879,10 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	p->se.vruntime			= 0;
 #ifdef CONFIG_SMP
 	p->se.avg.decay_count		= 0;
+#endif
+#ifdef CONFIG_PSI
+	p->psi_flags			= 0;
+	p->sched_psi_wake_requeue	= 0;
 #endif
 	INIT_LIST_HEAD(&p->se.group_node);
 
@@ -1853,6 +1916,7 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	p->numa_scan_period = sysctl_numa_balancing_scan_delay;
 	p->numa_work.next = &p->numa_work;
 	p->numa_faults = NULL;
+	p->numa_bw_spread = 0;
 	p->last_task_numa_placement = 0;
 	p->last_sum_exec_runtime = 0;
 
@@ -1986,7 +2050,7 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 unsigned long to_ratio(u64 period, u64 runtime)
 {
 	if (runtime == RUNTIME_INF)
-		return 1ULL << 20;
+		return 1ULL << BW_SHIFT;
 
 	/*
 	 * Doing this here saves a lot of checks in all
@@ -1996,7 +2060,7 @@ unsigned long to_ratio(u64 period, u64 runtime)
 	if (period == 0)
 		return 0;
 
-	return div64_u64(runtime << 20, period);
+	return div64_u64(runtime << BW_SHIFT, period);
 }
 
 #ifdef CONFIG_SMP
@@ -2007,7 +2071,7 @@ inline struct dl_bw *dl_bw_of(int i)
 	return &cpu_rq(i)->rd->dl_bw;
 }
 
-static inline int dl_bw_cpus(int i)
+int dl_bw_cpus(int i)
 {
 	struct root_domain *rd = cpu_rq(i)->rd;
 	int cpus = 0;
@@ -2025,7 +2089,7 @@ inline struct dl_bw *dl_bw_of(int i)
 	return &cpu_rq(i)->dl.dl_bw;
 }
 
-static inline int dl_bw_cpus(int i)
+int dl_bw_cpus(int i)
 {
 	return 1;
 }
@@ -2064,15 +2128,15 @@ static int dl_overflow(struct task_struct *p, int policy,
 	cpus = dl_bw_cpus(task_cpu(p));
 	if (dl_policy(policy) && !task_has_dl_policy(p) &&
 	    !__dl_overflow(dl_b, cpus, 0, new_bw)) {
-		__dl_add(dl_b, new_bw);
+		__dl_add(dl_b, new_bw, cpus);
 		err = 0;
 	} else if (dl_policy(policy) && task_has_dl_policy(p) &&
 		   !__dl_overflow(dl_b, cpus, p->dl.dl_bw, new_bw)) {
-		__dl_clear(dl_b, p->dl.dl_bw);
-		__dl_add(dl_b, new_bw);
+		__dl_clear(dl_b, p->dl.dl_bw, cpus);
+		__dl_add(dl_b, new_bw, cpus);
 		err = 0;
 	} else if (!dl_policy(policy) && task_has_dl_policy(p)) {
-		__dl_clear(dl_b, p->dl.dl_bw);
+		__dl_clear(dl_b, p->dl.dl_bw, cpus);
 		err = 0;
 	}
 	raw_spin_unlock(&dl_b->lock);
@@ -2520,36 +2584,89 @@ void scheduler_tick(void)
 	rq->idle_balance = idle_cpu(cpu);
 	trigger_load_balance(rq);
 #endif
-	rq_last_tick_reset(rq);
 }
 
 #ifdef CONFIG_NO_HZ_FULL
-/**
- * scheduler_tick_max_deferment
- *
- * Keep at least one tick per second when a single
- * active task is running because the scheduler doesn't
- * yet completely support full dynticks environment.
- *
- * This makes sure that uptime, CFS vruntime, load
- * balancing, etc... continue to move forward, even
- * with a very low granularity.
- *
- * Return: Maximum deferment in nanoseconds.
- */
-u64 scheduler_tick_max_deferment(void)
+/*
+ * A busy full dynticks cpu doesn't run scheduler_tick().  Its curr still
+ * needs a task_tick() once in a while so that vruntime, load tracking
+ * and the other scheduler statistics move forward; do that from a
+ * housekeeping cpu instead of keeping a residual tick on the isolated
+ * one.
+ */
+struct tick_work {
+	int			cpu;
+	struct delayed_work	work;
+};
+
+static DEFINE_PER_CPU(struct tick_work, tick_work_cpu);
+
+static void sched_tick_queue(struct tick_work *twork)
 {
-	struct rq *rq = this_rq();
-	unsigned long next, now = ACCESS_ONCE(jiffies);
+	int cpu = cpumask_any_and(housekeeping_mask, cpu_online_mask);
 
-	next = rq->last_sched_tick + HZ;
+	if (cpu >= nr_cpu_ids)
+		cpu = WORK_CPU_UNBOUND;
 
-	if (time_before_eq(next, now))
-		return 0;
+	/*
+	 * Run the remote tick once per second (1Hz). This arbitrary
+	 * frequency is large enough to avoid overload but short enough
+	 * to keep scheduler internal stats reasonably up to date.
+	 */
+	queue_delayed_work_on(cpu, system_wq, &twork->work, HZ);
+}
 
-	return jiffies_to_nsecs(next - now);
+static void sched_tick_remote(struct work_struct *work)
+{
+	struct delayed_work *dwork = to_delayed_work(work);
+	struct tick_work *twork = container_of(dwork, struct tick_work, work);
+	int cpu = twork->cpu;
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+
+	/*
+	 * Handle the tick only if it appears the remote CPU is running in
+	 * full dynticks mode. The check is racy by nature, but missing a
+	 * tick or having one too much is no big deal because the scheduler
+	 * tick updates statistics and checks timeslices in a
+	 * time-independent way, regardless of when exactly it is running.
+	 */
+	if (!idle_cpu(cpu) && tick_nohz_tick_stopped_cpu(cpu)) {
+		struct task_struct *curr;
+
+		raw_spin_lock_irqsave(&rq->lock, flags);
+		update_rq_clock(rq);
+		curr = rq->curr;
+		curr->sched_class->task_tick(rq, curr, 0);
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+	}
+
+	sched_tick_queue(twork);
 }
-#endif
+
+static void sched_tick_start(int cpu)
+{
+	struct tick_work *twork = &per_cpu(tick_work_cpu, cpu);
+
+	if (!tick_nohz_full_cpu(cpu))
+		return;
+
+	twork->cpu = cpu;
+	INIT_DELAYED_WORK(&twork->work, sched_tick_remote);
+	sched_tick_queue(twork);
+}
+
+static void sched_tick_stop(int cpu)
+{
+	if (!tick_nohz_full_cpu(cpu))
+		return;
+
+	cancel_delayed_work_sync(&per_cpu(tick_work_cpu, cpu).work);
+}
+#else
+static inline void sched_tick_start(int cpu) { }
+static inline void sched_tick_stop(int cpu) { }
+#endif /* CONFIG_NO_HZ_FULL */
 
 notrace unsigned long get_parent_ip(unsigned long addr)
 {
@@ -2745,6 +2862,155 @@ again:
  * accordingly in case an event triggered the need for rescheduling (such as
  * an interrupt waking up a task) while preemption was disabled in __schedule().
  */
+#ifdef CONFIG_SCHED_CORE
+/*
+ * Core scheduling: a task of a tagged cpu cgroup only shares a core with
+ * tasks of the same group, an SMT sibling that would run anything else is
+ * forced idle instead.
+ *
+ * Every cpu publishes what it runs in rq->core_state and rq->core_cookie
+ * under the core_lock of the first sibling, nested inside its rq->lock;
+ * the siblings are inspected under that lock only.  A forced idle cpu
+ * keeps the cookie of the task it is waiting for, and a sibling forced
+ * idle before us wins over our own candidate, so two incompatible
+ * siblings take turns instead of starving each other.  RT and deadline
+ * tasks are never held back.
+ */
+enum {
+	SCHED_CORE_IDLE,
+	SCHED_CORE_RUNNING,
+	SCHED_CORE_FORCEIDLE,
+};
+
+static struct static_key sched_core_key = STATIC_KEY_INIT_FALSE;
+static DEFINE_MUTEX(sched_core_mutex);
+
+static inline bool sched_core_enabled(void)
+{
+	return static_key_false(&sched_core_key);
+}
+
+static unsigned long sched_core_cookie(struct task_struct *p)
+{
+	struct task_group *tg;
+
+	for (tg = task_group(p); tg; tg = tg->parent) {
+		if (tg->core_tagged)
+			return (unsigned long)tg;
+	}
+
+	return 0;
+}
+
+static bool sched_core_allowed(struct rq *rq, unsigned long cookie)
+{
+	int cpu = cpu_of(rq), i;
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (i == cpu || !cpu_online(i))
+			continue;
+		if (srq->core_state == SCHED_CORE_IDLE ||
+		    srq->core_cookie == cookie)
+			continue;
+		if (srq->core_state == SCHED_CORE_FORCEIDLE &&
+		    rq->core_state == SCHED_CORE_FORCEIDLE &&
+		    rq->core_forceidle_seq < srq->core_forceidle_seq)
+			continue;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Called from __schedule() with rq->lock held once @next has been picked;
+ * returns the task to actually run, which is the idle task if @next may
+ * not run next to what the siblings run.
+ */
+static struct task_struct *
+sched_core_pick(struct rq *rq, struct task_struct *next)
+{
+	int cpu = cpu_of(rq), i;
+	struct rq *leader = cpu_rq(cpumask_first(cpu_smt_mask(cpu)));
+	unsigned long cookie = 0;
+	unsigned int state;
+	bool changed;
+
+	raw_spin_lock(&leader->core_lock);
+
+	if (next == rq->idle) {
+		state = SCHED_CORE_IDLE;
+	} else {
+		cookie = sched_core_cookie(next);
+		if (next->sched_class != &fair_sched_class ||
+		    sched_core_allowed(rq, cookie))
+			state = SCHED_CORE_RUNNING;
+		else
+			state = SCHED_CORE_FORCEIDLE;
+	}
+
+	if (state == SCHED_CORE_FORCEIDLE) {
+		if (rq->core_state != SCHED_CORE_FORCEIDLE) {
+			rq->core_forceidle_start = rq_clock(rq);
+			rq->core_forceidle_seq = ++leader->core_forceidle_seq;
+		}
+	} else if (rq->core_state == SCHED_CORE_FORCEIDLE) {
+		rq->core_forceidle_sum += rq_clock(rq) -
+					  rq->core_forceidle_start;
+	}
+
+	changed = rq->core_state != state || rq->core_cookie != cookie;
+	rq->core_state = state;
+	rq->core_cookie = cookie;
+
+	/*
+	 * Let the siblings re-evaluate: a forced idle one may be able to
+	 * run now, and one running an incompatible task has to make way
+	 * for the RT or deadline task we just let through.
+	 */
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (!changed)
+			break;
+		if (i == cpu)
+			continue;
+		if (srq->core_state == SCHED_CORE_FORCEIDLE) {
+			if (set_nr_and_not_polling(srq->idle))
+				smp_send_reschedule(i);
+		} else if (srq->core_state == SCHED_CORE_RUNNING &&
+			   state == SCHED_CORE_RUNNING &&
+			   srq->core_cookie != cookie) {
+			resched_cpu(i);
+		}
+	}
+
+	raw_spin_unlock(&leader->core_lock);
+
+	if (state == SCHED_CORE_FORCEIDLE)
+		next = idle_sched_class.pick_next_task(rq, next);
+
+	return next;
+}
+
+static void sched_core_free_group(struct task_group *tg);
+#else
+static inline bool sched_core_enabled(void)
+{
+	return false;
+}
+
+static inline struct task_struct *
+sched_core_pick(struct rq *rq, struct task_struct *next)
+{
+	return next;
+}
+
+static inline void sched_core_free_group(struct task_group *tg) { }
+#endif /* CONFIG_SCHED_CORE */
+
 static void __sched __schedule(void)
 {
 	struct task_struct *prev, *next;
@@ -2801,6 +3067,8 @@ static void __sched __schedule(void)
 		update_rq_clock(rq);
 
 	next = pick_next_task(rq, prev);
+	if (sched_core_enabled())
+		next = sched_core_pick(rq, next);
 	clear_tsk_need_resched(prev);
 	clear_preempt_need_resched();
 	rq->clock_skip_update = 0;
@@ -3446,7 +3714,8 @@ recheck:
 			return -EINVAL;
 	}
 
-	if (attr->sched_flags & ~(SCHED_FLAG_RESET_ON_FORK))
+	if (attr->sched_flags &
+	    ~(SCHED_FLAG_RESET_ON_FORK | SCHED_FLAG_RECLAIM))
 		return -EINVAL;
 
 	/*
@@ -4723,7 +4992,7 @@ int task_can_attach(struct task_struct *p,
 			 * We will free resources in the source root_domain
 			 * later on (see set_cpus_allowed_dl()).
 			 */
-			__dl_add(dl_b, p->dl.dl_bw);
+			__dl_add(dl_b, p->dl.dl_bw, cpus);
 		}
 		raw_spin_unlock_irqrestore(&dl_b->lock, flags);
 		rcu_read_unlock_sched();
@@ -5293,9 +5562,14 @@ migration_call(struct notifier_block *nfb, unsigned long action, void *hcpu)
 			set_rq_online(rq);
 		}
 		raw_spin_unlock_irqrestore(&rq->lock, flags);
+		sched_tick_start(cpu);
 		break;
 
 #ifdef CONFIG_HOTPLUG_CPU
+	case CPU_DOWN_PREPARE:
+		sched_tick_stop(cpu);
+		break;
+
 	case CPU_DYING:
 		sched_ttwu_pending();
 		/* Update our root-domain */
@@ -5737,6 +6011,7 @@ DEFINE_PER_CPU(int, sd_llc_id);
 DEFINE_PER_CPU(struct sched_domain *, sd_numa);
 DEFINE_PER_CPU(struct sched_domain *, sd_busy);
 DEFINE_PER_CPU(struct sched_domain *, sd_asym);
+DEFINE_PER_CPU_SHARED_ALIGNED(int, sd_llc_idle_cores);
 
 static void update_top_cache_domain(int cpu)
 {
@@ -7045,6 +7320,22 @@ static int cpuset_cpu_inactive(struct notifier_block *nfb, unsigned long action,
 	return NOTIFY_OK;
 }
 
+#ifdef CONFIG_SCHED_SMT
+struct static_key sched_smt_present = STATIC_KEY_INIT_FALSE;
+
+static void __init sched_init_smt(void)
+{
+	/*
+	 * We've enumerated all CPUs and will assume that if any CPU
+	 * has SMT siblings, CPU0 will too.
+	 */
+	if (cpumask_weight(cpu_smt_mask(0)) > 1)
+		static_key_slow_inc(&sched_smt_present);
+}
+#else
+static inline void sched_init_smt(void) { }
+#endif
+
 void __init sched_init_smp(void)
 {
 	cpumask_var_t non_isolated_cpus;
@@ -7071,6 +7362,7 @@ void __init sched_init_smp(void)
 	hotcpu_notifier(cpuset_cpu_inactive, CPU_PRI_CPUSET_INACTIVE);
 
 	init_hrtick();
+	sched_init_smt();
 
 	/* Move init over to a non-isolated CPU */
 	if (set_cpus_allowed_ptr(current, non_isolated_cpus) < 0)
@@ -7107,6 +7399,7 @@ LIST_HEAD(task_groups);
 #endif
 
 DECLARE_PER_CPU(cpumask_var_t, load_balance_mask);
+DECLARE_PER_CPU(cpumask_var_t, select_idle_mask);
 
 void __init sched_init(void)
 {
@@ -7143,6 +7436,8 @@ void __init sched_init(void)
 	for_each_possible_cpu(i) {
 		per_cpu(load_balance_mask, i) = (cpumask_var_t)kzalloc_node(
 			cpumask_size(), GFP_KERNEL, cpu_to_node(i));
+		per_cpu(select_idle_mask, i) = (cpumask_var_t)kzalloc_node(
+			cpumask_size(), GFP_KERNEL, cpu_to_node(i));
 	}
 #endif /* CONFIG_CPUMASK_OFFSTACK */
 
@@ -7173,6 +7468,9 @@ void __init sched_init(void)
 
 		rq = cpu_rq(i);
 		raw_spin_lock_init(&rq->lock);
+#ifdef CONFIG_SCHED_CORE
+		raw_spin_lock_init(&rq->core_lock);
+#endif
 		rq->nr_running = 0;
 		rq->calc_load_active = 0;
 		rq->calc_load_update = jiffies + LOAD_FREQ;
@@ -7235,9 +7533,6 @@ void __init sched_init(void)
 #ifdef CONFIG_NO_HZ_COMMON
 		rq->nohz_flags = 0;
 #endif
-#ifdef CONFIG_NO_HZ_FULL
-		rq->last_sched_tick = 0;
-#endif
 #endif
 		init_rq_hrtick(rq);
 		atomic_set(&rq->nr_iowait, 0);
@@ -7280,6 +7575,8 @@ void __init sched_init(void)
 #endif
 	init_sched_fair_class();
 
+	psi_init();
+
 	scheduler_running = 1;
 }
 
@@ -7875,6 +8172,7 @@ static void sched_dl_do_global(void)
 
 		raw_spin_lock_irqsave(&dl_b->lock, flags);
 		dl_b->bw = new_bw;
+		__dl_update(dl_b, dl_bw_cpus(cpu));
 		raw_spin_unlock_irqrestore(&dl_b->lock, flags);
 
 		rcu_read_unlock_sched();
@@ -7997,6 +8295,7 @@ static void cpu_cgroup_css_free(struct cgroup_subsys_state *css)
 {
 	struct task_group *tg = css_tg(css);
 
+	sched_core_free_group(tg);
 	sched_destroy_group(tg);
 }
 
@@ -8340,7 +8639,75 @@ static u64 cpu_rt_period_read_uint(struct cgroup_subsys_state *css,
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHED_CORE
+/*
+ * The core state isn't maintained while nothing is tagged, forget what
+ * is left of it so that stale siblings don't hold anybody back.
+ */
+static void sched_core_reset(void)
+{
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+		raw_spinlock_t *lock;
+
+		lock = &cpu_rq(cpumask_first(cpu_smt_mask(cpu)))->core_lock;
+		raw_spin_lock_irqsave(lock, flags);
+		rq->core_state = SCHED_CORE_IDLE;
+		rq->core_cookie = 0;
+		raw_spin_unlock_irqrestore(lock, flags);
+	}
+}
+
+static u64 cpu_core_tag_read_u64(struct cgroup_subsys_state *css,
+				 struct cftype *cft)
+{
+	return css_tg(css)->core_tagged;
+}
+
+static int cpu_core_tag_write_u64(struct cgroup_subsys_state *css,
+				  struct cftype *cft, u64 val)
+{
+	struct task_group *tg = css_tg(css);
+
+	if (val > 1)
+		return -ERANGE;
+
+	mutex_lock(&sched_core_mutex);
+	if (tg->core_tagged != val) {
+		if (val && !static_key_enabled(&sched_core_key))
+			sched_core_reset();
+		if (val)
+			static_key_slow_inc(&sched_core_key);
+		else
+			static_key_slow_dec(&sched_core_key);
+		tg->core_tagged = val;
+	}
+	mutex_unlock(&sched_core_mutex);
+
+	return 0;
+}
+
+static void sched_core_free_group(struct task_group *tg)
+{
+	mutex_lock(&sched_core_mutex);
+	if (tg->core_tagged)
+		static_key_slow_dec(&sched_core_key);
+	mutex_unlock(&sched_core_mutex);
+}
+#endif /* CONFIG_SCHED_CORE */
+
 static struct cftype cpu_files[] = {
+#ifdef CONFIG_SCHED_CORE
+	{
+		.name = "tag",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_core_tag_read_u64,
+		.write_u64 = cpu_core_tag_write_u64,
+	},
+#endif
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
 		.name = "shares",
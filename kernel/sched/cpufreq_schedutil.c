@@ -0,0 +1,536 @@
+/*
+ * CPUFreq governor based on scheduler-provided CPU utilization data.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Instead of sampling the CPU load from a timer, the governor is called
+ * by the scheduler whenever the utilization of a CPU changes (see
+ * cpufreq_update_util()) and picks a frequency proportional to it, so a
+ * burst is reacted to as soon as the scheduler sees it.
+ *
+ * Frequency changes are rate limited per policy.  If the driver can
+ * switch frequencies without sleeping (->fast_switch()), the switch is
+ * done right away from scheduler context; otherwise the request is
+ * handed to a work item through an irq_work, as the scheduler paths run
+ * with the rq lock held.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpufreq.h>
+#include <linux/irq_work.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+
+#include "sched.h"
+
+/* Default rate limit, in multiples of the transition latency */
+#define SUGOV_LATENCY_MULTIPLIER	(1000)
+
+struct sugov_tunables {
+	unsigned int rate_limit_us;
+	int usage_count;
+};
+
+struct sugov_policy {
+	struct cpufreq_policy *policy;
+	struct sugov_tunables *tunables;
+
+	raw_spinlock_t update_lock;	/* For shared policies */
+	u64 last_freq_update_time;
+	unsigned int next_freq;
+
+	/* The next fields are only needed if fast switch cannot be used. */
+	struct irq_work irq_work;
+	struct work_struct work;
+	struct mutex work_lock;
+	bool work_in_progress;
+
+	bool need_freq_update;
+};
+
+struct sugov_cpu {
+	struct update_util_data update_util;
+	struct sugov_policy *sg_policy;
+
+	/* The fields below are only needed when sharing a policy. */
+	unsigned long util;
+	unsigned long max;
+	u64 last_update;
+};
+
+static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
+
+/* Used when the tunables are system-wide (no governor per policy) */
+static struct sugov_tunables *global_tunables;
+static DEFINE_MUTEX(global_tunables_lock);
+
+/************************ Governor internals ***********************/
+
+static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
+{
+	s64 delta_ns;
+
+	if (sg_policy->work_in_progress)
+		return false;
+
+	if (unlikely(sg_policy->need_freq_update)) {
+		sg_policy->need_freq_update = false;
+		/*
+		 * This happens when limits change, so forget the previous
+		 * next_freq value and force an update.
+		 */
+		sg_policy->next_freq = UINT_MAX;
+		return true;
+	}
+
+	delta_ns = time - sg_policy->last_freq_update_time;
+	return delta_ns >= (s64)sg_policy->tunables->rate_limit_us *
+			   NSEC_PER_USEC;
+}
+
+static void sugov_update_commit(struct sugov_policy *sg_policy, u64 time,
+				unsigned int next_freq)
+{
+	struct cpufreq_policy *policy = sg_policy->policy;
+
+	sg_policy->last_freq_update_time = time;
+
+	if (sg_policy->next_freq == next_freq)
+		return;
+
+	sg_policy->next_freq = next_freq;
+
+	if (policy->fast_switch_enabled) {
+		next_freq = cpufreq_driver_fast_switch(policy, next_freq);
+		if (next_freq)
+			policy->cur = next_freq;
+	} else {
+		sg_policy->work_in_progress = true;
+		irq_work_queue(&sg_policy->irq_work);
+	}
+}
+
+/**
+ * get_next_freq - Compute a new frequency for a given cpufreq policy.
+ * @policy: cpufreq policy object to compute the new frequency for.
+ * @util: Current CPU utilization.
+ * @max: CPU capacity.
+ *
+ * The frequency is proportional to the utilization, with a 25% headroom
+ * so that a CPU running flat out asks for more than it has and the
+ * maximum is reached before the utilization saturates:
+ *
+ * next_freq = 1.25 * max_freq * util / max
+ */
+static unsigned int get_next_freq(struct cpufreq_policy *policy,
+				  unsigned long util, unsigned long max)
+{
+	unsigned int freq = policy->cpuinfo.max_freq;
+
+	if (!max)
+		return freq;
+
+	return div64_u64((u64)(freq + (freq >> 2)) * util, max);
+}
+
+static void sugov_update_single(struct update_util_data *hook, u64 time,
+				unsigned long util, unsigned long max)
+{
+	struct sugov_cpu *sg_cpu = container_of(hook, struct sugov_cpu, update_util);
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	struct cpufreq_policy *policy = sg_policy->policy;
+	unsigned int next_f;
+
+	if (!sugov_should_update_freq(sg_policy, time))
+		return;
+
+	next_f = util == ULONG_MAX ? policy->cpuinfo.max_freq :
+			get_next_freq(policy, util, max);
+	sugov_update_commit(sg_policy, time, next_f);
+}
+
+static unsigned int sugov_next_freq_shared(struct sugov_policy *sg_policy,
+					   unsigned long util, unsigned long max)
+{
+	struct cpufreq_policy *policy = sg_policy->policy;
+	unsigned int max_f = policy->cpuinfo.max_freq;
+	u64 last_freq_update_time = sg_policy->last_freq_update_time;
+	unsigned int j;
+
+	if (util == ULONG_MAX)
+		return max_f;
+
+	for_each_cpu(j, policy->cpus) {
+		struct sugov_cpu *j_sg_cpu;
+		unsigned long j_util, j_max;
+		s64 delta_ns;
+
+		if (j == smp_processor_id())
+			continue;
+
+		j_sg_cpu = &per_cpu(sugov_cpu, j);
+		/*
+		 * If the CPU utilization was last updated well before the
+		 * previous frequency update, the CPU is probably idle now, so
+		 * don't let its stale utilization hold the frequency up.
+		 */
+		delta_ns = last_freq_update_time - j_sg_cpu->last_update;
+		if (delta_ns > TICK_NSEC)
+			continue;
+
+		j_util = j_sg_cpu->util;
+		if (j_util == ULONG_MAX)
+			return max_f;
+
+		j_max = j_sg_cpu->max;
+		if (j_util * max > j_max * util) {
+			util = j_util;
+			max = j_max;
+		}
+	}
+
+	return get_next_freq(policy, util, max);
+}
+
+static void sugov_update_shared(struct update_util_data *hook, u64 time,
+				unsigned long util, unsigned long max)
+{
+	struct sugov_cpu *sg_cpu = container_of(hook, struct sugov_cpu, update_util);
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	unsigned int next_f;
+
+	raw_spin_lock(&sg_policy->update_lock);
+
+	sg_cpu->util = util;
+	sg_cpu->max = max;
+	sg_cpu->last_update = time;
+
+	if (sugov_should_update_freq(sg_policy, time)) {
+		next_f = sugov_next_freq_shared(sg_policy, util, max);
+		sugov_update_commit(sg_policy, time, next_f);
+	}
+
+	raw_spin_unlock(&sg_policy->update_lock);
+}
+
+static void sugov_work(struct work_struct *work)
+{
+	struct sugov_policy *sg_policy = container_of(work, struct sugov_policy, work);
+
+	mutex_lock(&sg_policy->work_lock);
+	__cpufreq_driver_target(sg_policy->policy, sg_policy->next_freq,
+				CPUFREQ_RELATION_L);
+	mutex_unlock(&sg_policy->work_lock);
+
+	sg_policy->work_in_progress = false;
+}
+
+static void sugov_irq_work(struct irq_work *irq_work)
+{
+	struct sugov_policy *sg_policy;
+
+	sg_policy = container_of(irq_work, struct sugov_policy, irq_work);
+	schedule_work_on(smp_processor_id(), &sg_policy->work);
+}
+
+/************************** sysfs interface ************************/
+
+static ssize_t store_rate_limit_us(struct sugov_tunables *tunables,
+				   const char *buf, size_t count)
+{
+	unsigned int rate_limit_us;
+
+	if (kstrtouint(buf, 10, &rate_limit_us))
+		return -EINVAL;
+
+	tunables->rate_limit_us = rate_limit_us;
+	return count;
+}
+
+static ssize_t show_rate_limit_us_gov_sys(struct kobject *kobj,
+					  struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", global_tunables->rate_limit_us);
+}
+
+static ssize_t store_rate_limit_us_gov_sys(struct kobject *kobj,
+					   struct attribute *attr,
+					   const char *buf, size_t count)
+{
+	return store_rate_limit_us(global_tunables, buf, count);
+}
+
+static ssize_t show_rate_limit_us_gov_pol(struct cpufreq_policy *policy,
+					  char *buf)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+
+	return sprintf(buf, "%u\n", sg_policy->tunables->rate_limit_us);
+}
+
+static ssize_t store_rate_limit_us_gov_pol(struct cpufreq_policy *policy,
+					   const char *buf, size_t count)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+
+	return store_rate_limit_us(sg_policy->tunables, buf, count);
+}
+
+static struct global_attr rate_limit_us_gov_sys =
+	__ATTR(rate_limit_us, 0644, show_rate_limit_us_gov_sys,
+	       store_rate_limit_us_gov_sys);
+
+static struct freq_attr rate_limit_us_gov_pol =
+	__ATTR(rate_limit_us, 0644, show_rate_limit_us_gov_pol,
+	       store_rate_limit_us_gov_pol);
+
+static struct attribute *sugov_attributes_gov_sys[] = {
+	&rate_limit_us_gov_sys.attr,
+	NULL
+};
+
+static struct attribute_group sugov_attr_group_gov_sys = {
+	.attrs = sugov_attributes_gov_sys,
+	.name = "schedutil",
+};
+
+static struct attribute *sugov_attributes_gov_pol[] = {
+	&rate_limit_us_gov_pol.attr,
+	NULL
+};
+
+static struct attribute_group sugov_attr_group_gov_pol = {
+	.attrs = sugov_attributes_gov_pol,
+	.name = "schedutil",
+};
+
+static struct attribute_group *sugov_attr_group(void)
+{
+	if (have_governor_per_policy())
+		return &sugov_attr_group_gov_pol;
+	else
+		return &sugov_attr_group_gov_sys;
+}
+
+/********************** cpufreq governor interface *********************/
+
+static int sugov_init(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy;
+	struct sugov_tunables *tunables;
+	unsigned int lat;
+	int ret = 0;
+
+	/* State should be equivalent to EXIT */
+	if (policy->governor_data)
+		return -EBUSY;
+
+	sg_policy = kzalloc(sizeof(*sg_policy), GFP_KERNEL);
+	if (!sg_policy)
+		return -ENOMEM;
+
+	sg_policy->policy = policy;
+	init_irq_work(&sg_policy->irq_work, sugov_irq_work);
+	INIT_WORK(&sg_policy->work, sugov_work);
+	mutex_init(&sg_policy->work_lock);
+	raw_spin_lock_init(&sg_policy->update_lock);
+
+	mutex_lock(&global_tunables_lock);
+
+	if (global_tunables) {
+		if (WARN_ON(have_governor_per_policy())) {
+			ret = -EINVAL;
+			goto free_sg_policy;
+		}
+		policy->governor_data = sg_policy;
+		sg_policy->tunables = global_tunables;
+		global_tunables->usage_count++;
+		goto out;
+	}
+
+	tunables = kzalloc(sizeof(*tunables), GFP_KERNEL);
+	if (!tunables) {
+		ret = -ENOMEM;
+		goto free_sg_policy;
+	}
+
+	tunables->usage_count = 1;
+	tunables->rate_limit_us = SUGOV_LATENCY_MULTIPLIER;
+	lat = policy->cpuinfo.transition_latency / NSEC_PER_USEC;
+	if (lat)
+		tunables->rate_limit_us *= lat;
+
+	if (!have_governor_per_policy())
+		WARN_ON(cpufreq_get_global_kobject());
+
+	ret = sysfs_create_group(get_governor_parent_kobj(policy),
+				 sugov_attr_group());
+	if (ret)
+		goto fail;
+
+	policy->governor_data = sg_policy;
+	sg_policy->tunables = tunables;
+
+	if (!have_governor_per_policy())
+		global_tunables = tunables;
+
+out:
+	mutex_unlock(&global_tunables_lock);
+
+	cpufreq_enable_fast_switch(policy);
+	return 0;
+
+fail:
+	if (!have_governor_per_policy())
+		cpufreq_put_global_kobject();
+	kfree(tunables);
+
+free_sg_policy:
+	mutex_unlock(&global_tunables_lock);
+
+	mutex_destroy(&sg_policy->work_lock);
+	kfree(sg_policy);
+	pr_err("initialization failed (error %d)\n", ret);
+	return ret;
+}
+
+static int sugov_exit(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	struct sugov_tunables *tunables = sg_policy->tunables;
+
+	mutex_lock(&global_tunables_lock);
+
+	if (!--tunables->usage_count) {
+		sysfs_remove_group(get_governor_parent_kobj(policy),
+				   sugov_attr_group());
+		if (!have_governor_per_policy()) {
+			cpufreq_put_global_kobject();
+			global_tunables = NULL;
+		}
+		kfree(tunables);
+	}
+
+	mutex_unlock(&global_tunables_lock);
+
+	cpufreq_disable_fast_switch(policy);
+	policy->governor_data = NULL;
+	mutex_destroy(&sg_policy->work_lock);
+	kfree(sg_policy);
+	return 0;
+}
+
+static int sugov_start(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	sg_policy->last_freq_update_time = 0;
+	sg_policy->next_freq = UINT_MAX;
+	sg_policy->work_in_progress = false;
+	sg_policy->need_freq_update = false;
+
+	for_each_cpu(cpu, policy->cpus) {
+		struct sugov_cpu *sg_cpu = &per_cpu(sugov_cpu, cpu);
+
+		sg_cpu->sg_policy = sg_policy;
+		if (policy_is_shared(policy)) {
+			sg_cpu->util = ULONG_MAX;
+			sg_cpu->max = 0;
+			sg_cpu->last_update = 0;
+			sg_cpu->update_util.func = sugov_update_shared;
+		} else {
+			sg_cpu->update_util.func = sugov_update_single;
+		}
+		cpufreq_set_update_util_data(cpu, &sg_cpu->update_util);
+	}
+	return 0;
+}
+
+static int sugov_stop(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	for_each_cpu(cpu, policy->cpus)
+		cpufreq_set_update_util_data(cpu, NULL);
+
+	synchronize_sched();
+
+	irq_work_sync(&sg_policy->irq_work);
+	cancel_work_sync(&sg_policy->work);
+	return 0;
+}
+
+static int sugov_limits(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+
+	if (!policy->fast_switch_enabled) {
+		mutex_lock(&sg_policy->work_lock);
+
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy, policy->max,
+						CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy, policy->min,
+						CPUFREQ_RELATION_L);
+
+		mutex_unlock(&sg_policy->work_lock);
+	}
+
+	sg_policy->need_freq_update = true;
+	return 0;
+}
+
+static int sugov_governor(struct cpufreq_policy *policy, unsigned int event)
+{
+	if (event == CPUFREQ_GOV_POLICY_INIT) {
+		return sugov_init(policy);
+	} else if (policy->governor_data) {
+		switch (event) {
+		case CPUFREQ_GOV_POLICY_EXIT:
+			return sugov_exit(policy);
+		case CPUFREQ_GOV_START:
+			return sugov_start(policy);
+		case CPUFREQ_GOV_STOP:
+			return sugov_stop(policy);
+		case CPUFREQ_GOV_LIMITS:
+			return sugov_limits(policy);
+		}
+	}
+	return -EINVAL;
+}
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHEDUTIL
+static
+#endif
+struct cpufreq_governor cpufreq_gov_schedutil = {
+	.name = "schedutil",
+	.governor = sugov_governor,
+	.owner = THIS_MODULE,
+};
+
+static int __init sugov_module_init(void)
+{
+	return cpufreq_register_governor(&cpufreq_gov_schedutil);
+}
+
+static void __exit sugov_module_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_schedutil);
+}
+
+MODULE_DESCRIPTION("Utilization-based CPU frequency selection");
+MODULE_LICENSE("GPL");
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHEDUTIL
+fs_initcall(sugov_module_init);
+#else
+module_init(sugov_module_init);
+#endif
+module_exit(sugov_module_exit);
@@ -67,6 +67,7 @@ void init_dl_bw(struct dl_bw *dl_b)
 		dl_b->bw = to_ratio(global_rt_period(), global_rt_runtime());
 	raw_spin_unlock(&def_dl_bandwidth.dl_runtime_lock);
 	dl_b->total_bw = 0;
+	__dl_update(dl_b, 1);
 }
 
 void init_dl_rq(struct dl_rq *dl_rq)
@@ -647,6 +648,39 @@ int dl_runtime_exceeded(struct rq *rq, struct sched_dl_entity *dl_se)
 
 extern bool sched_rt_bandwidth_account(struct rt_rq *rt_rq);
 
+/*
+ * GRUB reclaiming: the budget of a SCHED_FLAG_RECLAIM task is not
+ * depleted as dq = -dt, but as
+ *
+ *   dq = -max{ u / Umax, 1 - Uextra } dt
+ *
+ * where u is the bandwidth of the task, Umax the bandwidth -deadline
+ * tasks are allowed to use on each cpu and Uextra the per-cpu part of
+ * Umax that no task has reserved (dl_b->extra_bw). The task can then use
+ * the unreserved capacity, scaled by its own utilization, but never more
+ * than Umax of a cpu, so admission control is still honoured.
+ *
+ * Being computed from the reserved rather than from the active
+ * bandwidth, Uextra does not account for the reservations of blocked
+ * tasks: that is pessimistic, never unsafe.
+ *
+ * Overflowing the product needs a delta of more than 2^(64 - 20) ns.
+ */
+static u64 grub_reclaim(u64 delta, struct rq *rq, struct sched_dl_entity *dl_se)
+{
+	struct dl_bw *dl_b = dl_bw_of(cpu_of(rq));
+	u64 u_extra = READ_ONCE(dl_b->extra_bw);
+	u64 u_act_min, u_act;
+
+	u_act_min = (dl_se->dl_bw * READ_ONCE(dl_b->bw_ratio)) >> RATIO_SHIFT;
+	if (u_act_min >= BW_UNIT || u_extra > BW_UNIT - u_act_min)
+		u_act = min_t(u64, u_act_min, BW_UNIT);
+	else
+		u_act = BW_UNIT - u_extra;
+
+	return (delta * u_act) >> BW_SHIFT;
+}
+
 /*
  * Update the current task's runtime statistics (provided it is still
  * a -deadline task and has not been removed from the dl_rq).
@@ -655,7 +689,7 @@ static void update_curr_dl(struct rq *rq)
 {
 	struct task_struct *curr = rq->curr;
 	struct sched_dl_entity *dl_se = &curr->dl;
-	u64 delta_exec;
+	u64 delta_exec, scaled_delta_exec;
 
 	if (!dl_task(curr) || !on_dl_rq(dl_se))
 		return;
@@ -672,6 +706,10 @@ static void update_curr_dl(struct rq *rq)
 	if (unlikely((s64)delta_exec <= 0))
 		return;
 
+	/* Kick cpufreq (see the comment in kernel/sched/sched.h). */
+	if (cpu_of(rq) == smp_processor_id())
+		cpufreq_trigger_update(rq_clock(rq));
+
 	schedstat_set(curr->se.statistics.exec_max,
 		      max(curr->se.statistics.exec_max, delta_exec));
 
@@ -683,7 +721,14 @@ static void update_curr_dl(struct rq *rq)
 
 	sched_rt_avg_update(rq, delta_exec);
 
-	dl_se->runtime -= dl_se->dl_yielded ? 0 : delta_exec;
+	if (dl_se->dl_yielded)
+		scaled_delta_exec = 0;
+	else if (unlikely(dl_se->flags & SCHED_FLAG_RECLAIM))
+		scaled_delta_exec = grub_reclaim(delta_exec, rq, dl_se);
+	else
+		scaled_delta_exec = delta_exec;
+
+	dl_se->runtime -= scaled_delta_exec;
 	if (dl_runtime_exceeded(rq, dl_se)) {
 		dl_se->dl_throttled = 1;
 		__dequeue_task_dl(rq, curr, 0);
@@ -949,11 +994,9 @@ static void dequeue_task_dl(struct rq *rq, struct task_struct *p, int flags)
  * Yield task semantic for -deadline tasks is:
  *
  *   get off from the CPU until our next instance, with
- *   a new runtime. This is of little use now, since we
- *   don't have a bandwidth reclaiming mechanism. Anyway,
- *   bandwidth reclaiming is planned for the future, and
- *   yield_task_dl will indicate that some spare budget
- *   is available for other task instances to use it.
+ *   a new runtime. The budget left is simply dropped: GRUB
+ *   (see grub_reclaim()) only hands out bandwidth nobody
+ *   reserved, not the unused runtime of other tasks.
  */
 static void yield_task_dl(struct rq *rq)
 {
@@ -1179,7 +1222,7 @@ static void task_dead_dl(struct task_struct *p)
 	 */
 	raw_spin_lock_irq(&dl_b->lock);
 	/* XXX we should retain the bw until 0-lag */
-	dl_b->total_bw -= p->dl.dl_bw;
+	__dl_clear(dl_b, p->dl.dl_bw, dl_bw_cpus(task_cpu(p)));
 	raw_spin_unlock_irq(&dl_b->lock);
 
 	hrtimer_cancel(timer);
@@ -1601,7 +1644,7 @@ static void set_cpus_allowed_dl(struct task_struct *p,
 		 * until we complete the update.
 		 */
 		raw_spin_lock(&src_dl_b->lock);
-		__dl_clear(src_dl_b, p->dl.dl_bw);
+		__dl_clear(src_dl_b, p->dl.dl_bw, dl_bw_cpus(cpu_of(rq)));
 		raw_spin_unlock(&src_dl_b->lock);
 	}
 
@@ -315,6 +315,9 @@ do {									\
 	P(cpu_load[2]);
 	P(cpu_load[3]);
 	P(cpu_load[4]);
+#ifdef CONFIG_SCHED_CORE
+	PN(core_forceidle_sum);
+#endif
 #undef P
 #undef PN
 
@@ -333,6 +336,9 @@ do {									\
 
 	P(ttwu_count);
 	P(ttwu_local);
+	P(ttwu_queued);
+	P(ttwu_queued_ipi);
+	P(ttwu_queued_poll);
 
 #undef P
 #undef P64
@@ -534,6 +540,9 @@ static void sched_show_numa(struct task_struct *p, struct seq_file *m)
 	task_unlock(p);
 
 	SEQ_printf(m, "numa_migrations, %ld\n", xchg(&p->numa_pages_migrated, 0));
+	SEQ_printf(m, "numa_preferred_nid, %d\n", p->numa_preferred_nid);
+	SEQ_printf(m, "numa_group_id, %d\n", task_numa_group_id(p));
+	SEQ_printf(m, "numa_bw_spread, %lu\n", p->numa_bw_spread);
 
 	for_each_online_node(node) {
 		for (i = 0; i < 2; i++) {
@@ -553,6 +562,10 @@ static void sched_show_numa(struct task_struct *p, struct seq_file *m)
 		}
 	}
 
+	for_each_online_node(node)
+		SEQ_printf(m, "numa_node_bw, %d, %lu, %d\n", node,
+			   numa_node_accesses(node), numa_node_saturated(node));
+
 	mpol_put(pol);
 #endif
 }
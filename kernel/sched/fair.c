@@ -810,6 +810,66 @@ unsigned int sysctl_numa_balancing_scan_size = 256;
 /* Scan @scan_size MB every @scan_period after an initial @scan_delay in ms */
 unsigned int sysctl_numa_balancing_scan_delay = 1000;
 
+/*
+ * A node that takes more than this percentage of its fair share of the
+ * NUMA hinting faults of the system is considered to saturate its memory
+ * bandwidth: tasks are not moved there and numa_group members stop
+ * consolidating on it. 0 disables the check.
+ */
+unsigned int sysctl_numa_balancing_bw_imbalance_pct = 0;
+
+/*
+ * The hinting faults are a sample of the memory accesses of every task,
+ * their per-node rate is used as a proxy for memory bandwidth pressure.
+ * The counts are halved every NUMA_BW_DECAY so they follow the current
+ * access pattern.
+ */
+#define NUMA_BW_DECAY		HZ
+#define NUMA_BW_MIN_FAULTS	256
+
+static atomic_long_t numa_node_faults[MAX_NUMNODES];
+static unsigned long numa_bw_next_decay;
+
+static void numa_node_account(int nid, int pages)
+{
+	unsigned long next = ACCESS_ONCE(numa_bw_next_decay);
+
+	if (time_after(jiffies, next) &&
+	    cmpxchg(&numa_bw_next_decay, next, jiffies + NUMA_BW_DECAY) == next) {
+		int node;
+
+		for_each_online_node(node)
+			atomic_long_set(&numa_node_faults[node],
+				atomic_long_read(&numa_node_faults[node]) / 2);
+	}
+
+	atomic_long_add(pages, &numa_node_faults[nid]);
+}
+
+unsigned long numa_node_accesses(int nid)
+{
+	return atomic_long_read(&numa_node_faults[nid]);
+}
+
+bool numa_node_saturated(int nid)
+{
+	unsigned int pct = ACCESS_ONCE(sysctl_numa_balancing_bw_imbalance_pct);
+	unsigned long total = 0;
+	int node;
+
+	if (!pct)
+		return false;
+
+	for_each_online_node(node)
+		total += numa_node_accesses(node);
+
+	if (total < NUMA_BW_MIN_FAULTS * num_online_nodes())
+		return false;
+
+	return (u64)numa_node_accesses(nid) * num_online_nodes() * 100 >
+	       (u64)total * pct;
+}
+
 static unsigned int task_nr_scan_windows(struct task_struct *p)
 {
 	unsigned long rss = 0;
@@ -1173,6 +1233,7 @@ struct task_numa_env {
 	int dst_cpu, dst_nid;
 
 	struct numa_stats src_stats, dst_stats;
+	bool dst_saturated;
 
 	int imbalance_pct;
 	int dist;
@@ -1334,6 +1395,10 @@ static void task_numa_compare(struct task_numa_env *env,
 		goto unlock;
 
 	if (!cur) {
+		/* Don't add to the memory traffic of a saturated node */
+		if (env->dst_saturated)
+			goto unlock;
+
 		/* Is there capacity at our destination? */
 		if (env->src_stats.nr_running <= env->src_stats.task_capacity &&
 		    !env->dst_stats.has_free_capacity)
@@ -1461,6 +1526,7 @@ static int task_numa_migrate(struct task_struct *p)
 	taskimp = task_weight(p, env.dst_nid, dist) - taskweight;
 	groupimp = group_weight(p, env.dst_nid, dist) - groupweight;
 	update_numa_stats(&env.dst_stats, env.dst_nid);
+	env.dst_saturated = numa_node_saturated(env.dst_nid);
 
 	/* Try to find a spot on the preferred nid. */
 	task_numa_find_cpu(&env, taskimp, groupimp);
@@ -1494,6 +1560,7 @@ static int task_numa_migrate(struct task_struct *p)
 			env.dist = dist;
 			env.dst_nid = nid;
 			update_numa_stats(&env.dst_stats, env.dst_nid);
+			env.dst_saturated = numa_node_saturated(env.dst_nid);
 			task_numa_find_cpu(&env, taskimp, groupimp);
 		}
 	}
@@ -1787,7 +1854,7 @@ static int preferred_group_nid(struct task_struct *p, int nid)
 
 static void task_numa_placement(struct task_struct *p)
 {
-	int seq, nid, max_nid = -1, max_group_nid = -1;
+	int seq, nid, max_nid = -1, max_group_nid = -1, task_max_nid;
 	unsigned long max_faults = 0, max_group_faults = 0;
 	unsigned long fault_types[2] = { 0, 0 };
 	unsigned long total_faults;
@@ -1878,7 +1945,20 @@ static void task_numa_placement(struct task_struct *p)
 	if (p->numa_group) {
 		update_numa_active_node_mask(p->numa_group);
 		spin_unlock_irq(group_lock);
+		task_max_nid = max_nid;
 		max_nid = preferred_group_nid(p, max_group_nid);
+
+		/*
+		 * When the node the group converges on saturates its memory
+		 * bandwidth, spread the group: let this task follow its own
+		 * faults, unless that node is saturated as well.
+		 */
+		if (task_max_nid != -1 && max_nid != task_max_nid &&
+		    numa_node_saturated(max_nid) &&
+		    !numa_node_saturated(task_max_nid)) {
+			max_nid = task_max_nid;
+			p->numa_bw_spread++;
+		}
 	}
 
 	if (max_faults) {
@@ -2103,6 +2183,7 @@ void task_numa_fault(int last_cpupid, int mem_node, int pages, int flags)
 	p->numa_faults[task_faults_idx(NUMA_MEMBUF, mem_node, priv)] += pages;
 	p->numa_faults[task_faults_idx(NUMA_CPUBUF, cpu_node, priv)] += pages;
 	p->numa_faults_locality[local] += pages;
+	numa_node_account(mem_node, pages);
 }
 
 static void reset_ptenuma_scan(struct task_struct *p)
@@ -2773,6 +2854,33 @@ static inline void subtract_blocked_load_contrib(struct cfs_rq *cfs_rq,
 		cfs_rq->blocked_load_avg = 0;
 }
 
+static inline void subtract_blocked_utilization_contrib(struct cfs_rq *cfs_rq,
+							long utilization_contrib)
+{
+	if (likely(utilization_contrib < cfs_rq->blocked_utilization_avg))
+		cfs_rq->blocked_utilization_avg -= utilization_contrib;
+	else
+		cfs_rq->blocked_utilization_avg = 0;
+}
+
+/*
+ * Tell cpufreq about a utilization change of the root cfs_rq of this cpu.
+ * Only the local cpu is reported, remote updates (e.g. the load balancer)
+ * are picked up at the next local one.
+ */
+static inline void cfs_rq_util_change(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+
+	if (&rq->cfs != cfs_rq || cpu_of(rq) != smp_processor_id())
+		return;
+
+	cpufreq_update_util(rq_clock(rq),
+			    cfs_rq->utilization_load_avg +
+			    cfs_rq->blocked_utilization_avg,
+			    SCHED_LOAD_SCALE);
+}
+
 static inline u64 cfs_rq_clock_task(struct cfs_rq *cfs_rq);
 
 /* Update a sched_entity's runnable average */
@@ -2808,6 +2916,7 @@ static inline void update_entity_load_avg(struct sched_entity *se,
 		cfs_rq->utilization_load_avg += utilization_delta;
 	} else {
 		subtract_blocked_load_contrib(cfs_rq, -contrib_delta);
+		subtract_blocked_utilization_contrib(cfs_rq, -utilization_delta);
 	}
 }
 
@@ -2830,14 +2939,25 @@ static void update_cfs_rq_blocked_load(struct cfs_rq *cfs_rq, int force_update)
 		subtract_blocked_load_contrib(cfs_rq, removed_load);
 	}
 
+	if (atomic_long_read(&cfs_rq->removed_utilization)) {
+		unsigned long removed_utilization;
+		removed_utilization =
+			atomic_long_xchg(&cfs_rq->removed_utilization, 0);
+		subtract_blocked_utilization_contrib(cfs_rq,
+						     removed_utilization);
+	}
+
 	if (decays) {
 		cfs_rq->blocked_load_avg = decay_load(cfs_rq->blocked_load_avg,
 						      decays);
+		cfs_rq->blocked_utilization_avg =
+			decay_load(cfs_rq->blocked_utilization_avg, decays);
 		atomic64_add(decays, &cfs_rq->decay_counter);
 		cfs_rq->last_decay = now;
 	}
 
 	__update_cfs_rq_tg_load_contrib(cfs_rq, force_update);
+	cfs_rq_util_change(cfs_rq);
 }
 
 /* Add the load generated by se into cfs_rq's child load-average */
@@ -2879,6 +2999,8 @@ static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
 	/* migrated tasks did not contribute to our blocked load */
 	if (wakeup) {
 		subtract_blocked_load_contrib(cfs_rq, se->avg.load_avg_contrib);
+		subtract_blocked_utilization_contrib(cfs_rq,
+					se->avg.utilization_avg_contrib);
 		update_entity_load_avg(se, 0);
 	}
 
@@ -2886,6 +3008,8 @@ static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
 	cfs_rq->utilization_load_avg += se->avg.utilization_avg_contrib;
 	/* we force update consideration on load-balancer moves */
 	update_cfs_rq_blocked_load(cfs_rq, !wakeup);
+	if (wakeup)
+		cfs_rq_util_change(cfs_rq);
 }
 
 /*
@@ -2905,8 +3029,11 @@ static inline void dequeue_entity_load_avg(struct cfs_rq *cfs_rq,
 	cfs_rq->utilization_load_avg -= se->avg.utilization_avg_contrib;
 	if (sleep) {
 		cfs_rq->blocked_load_avg += se->avg.load_avg_contrib;
+		cfs_rq->blocked_utilization_avg +=
+			se->avg.utilization_avg_contrib;
 		se->avg.decay_count = atomic64_read(&cfs_rq->decay_counter);
 	} /* migrations, e.g. sleep=0 leave decay_count == 0 */
+	cfs_rq_util_change(cfs_rq);
 }
 
 /*
@@ -4741,13 +4868,173 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 	return shallowest_idle_cpu != -1 ? shallowest_idle_cpu : least_loaded_cpu;
 }
 
+/* Working cpumask for select_idle_core() */
+DEFINE_PER_CPU(cpumask_var_t, select_idle_mask);
+
+#ifdef CONFIG_SCHED_SMT
+
+/*
+ * The has-idle-cores hint of an LLC lives in the per-cpu slot of its
+ * first cpu, see update_top_cache_domain().
+ */
+static inline void set_idle_cores(int cpu, int val)
+{
+	WRITE_ONCE(per_cpu(sd_llc_idle_cores, per_cpu(sd_llc_id, cpu)), val);
+}
+
+static inline bool test_idle_cores(int cpu)
+{
+	return READ_ONCE(per_cpu(sd_llc_idle_cores, per_cpu(sd_llc_id, cpu)));
+}
+
+/*
+ * Scans the local SMT mask to see if the entire core is idle, and records
+ * this in the LLC has-idle-cores hint. Called when a cpu goes idle.
+ *
+ * Since SMT siblings share all cache levels, inspecting this limited remote
+ * state should be fairly cheap.
+ */
+void __update_idle_core(struct rq *rq)
+{
+	int core = cpu_of(rq);
+	int cpu;
+
+	if (test_idle_cores(core))
+		return;
+
+	for_each_cpu(cpu, cpu_smt_mask(core)) {
+		if (cpu == core)
+			continue;
+
+		if (!idle_cpu(cpu))
+			return;
+	}
+
+	set_idle_cores(core, 1);
+}
+
+/*
+ * Scan the entire LLC domain for idle cores; this dynamically switches off
+ * if there are no idle cores left in the LLC, and is enabled again by the
+ * next core that goes fully idle in __update_idle_core().
+ */
+static int select_idle_core(struct task_struct *p, struct sched_domain *sd, int target)
+{
+	struct cpumask *cpus = this_cpu_cpumask_var_ptr(select_idle_mask);
+	int core, cpu;
+
+	if (!static_key_false(&sched_smt_present))
+		return -1;
+
+	if (!test_idle_cores(target))
+		return -1;
+
+	cpumask_and(cpus, sched_domain_span(sd), tsk_cpus_allowed(p));
+
+	for_each_cpu_wrap(core, cpus, target) {
+		bool idle = true;
+
+		for_each_cpu(cpu, cpu_smt_mask(core)) {
+			cpumask_clear_cpu(cpu, cpus);
+			if (!idle_cpu(cpu))
+				idle = false;
+		}
+
+		if (idle)
+			return core;
+	}
+
+	/*
+	 * Failed to find an idle core; stop looking for one.
+	 */
+	set_idle_cores(target, 0);
+
+	return -1;
+}
+
+/*
+ * Scan the local SMT mask for idle CPUs.
+ */
+static int select_idle_smt(struct task_struct *p, struct sched_domain *sd, int target)
+{
+	int cpu;
+
+	if (!static_key_false(&sched_smt_present))
+		return -1;
+
+	for_each_cpu(cpu, cpu_smt_mask(target)) {
+		if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+			continue;
+		if (idle_cpu(cpu))
+			return cpu;
+	}
+
+	return -1;
+}
+
+#else /* CONFIG_SCHED_SMT */
+
+static inline int select_idle_core(struct task_struct *p, struct sched_domain *sd, int target)
+{
+	return -1;
+}
+
+static inline int select_idle_smt(struct task_struct *p, struct sched_domain *sd, int target)
+{
+	return -1;
+}
+
+#endif /* CONFIG_SCHED_SMT */
+
+/*
+ * Scan the LLC domain for idle CPUs; this is dynamically regulated by
+ * comparing the average scan cost (tracked in sd->avg_scan_cost) against the
+ * average idle time for this rq (as found in rq->avg_idle).
+ */
+static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int target)
+{
+	struct sched_domain *this_sd;
+	u64 avg_cost, avg_idle = this_rq()->avg_idle;
+	u64 time, cost;
+	s64 delta;
+	int cpu;
+
+	this_sd = rcu_dereference(*this_cpu_ptr(&sd_llc));
+	if (!this_sd)
+		return -1;
+
+	avg_cost = this_sd->avg_scan_cost;
+
+	/*
+	 * Due to large variance we need a large fuzz factor; hackbench in
+	 * particularly is sensitive here.
+	 */
+	if ((avg_idle / 512) < avg_cost)
+		return -1;
+
+	time = local_clock();
+
+	for_each_cpu_wrap(cpu, sched_domain_span(sd), target) {
+		if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+			continue;
+		if (idle_cpu(cpu))
+			break;
+	}
+
+	time = local_clock() - time;
+	cost = this_sd->avg_scan_cost;
+	delta = (s64)(time - cost) / 8;
+	this_sd->avg_scan_cost += delta;
+
+	return cpu;
+}
+
 /*
  * Try and locate an idle CPU in the sched_domain.
  */
 static int select_idle_sibling(struct task_struct *p, int target)
 {
 	struct sched_domain *sd;
-	struct sched_group *sg;
 	int i = task_cpu(p);
 
 	if (idle_cpu(target))
@@ -4759,30 +5046,22 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	if (i != target && cpus_share_cache(i, target) && idle_cpu(i))
 		return i;
 
-	/*
-	 * Otherwise, iterate the domains and find an elegible idle cpu.
-	 */
 	sd = rcu_dereference(per_cpu(sd_llc, target));
-	for_each_lower_domain(sd) {
-		sg = sd->groups;
-		do {
-			if (!cpumask_intersects(sched_group_cpus(sg),
-						tsk_cpus_allowed(p)))
-				goto next;
+	if (!sd)
+		return target;
 
-			for_each_cpu(i, sched_group_cpus(sg)) {
-				if (i == target || !idle_cpu(i))
-					goto next;
-			}
+	i = select_idle_core(p, sd, target);
+	if ((unsigned)i < nr_cpu_ids)
+		return i;
+
+	i = select_idle_cpu(p, sd, target);
+	if ((unsigned)i < nr_cpu_ids)
+		return i;
+
+	i = select_idle_smt(p, sd, target);
+	if ((unsigned)i < nr_cpu_ids)
+		return i;
 
-			target = cpumask_first_and(sched_group_cpus(sg),
-					tsk_cpus_allowed(p));
-			goto done;
-next:
-			sg = sg->next;
-		} while (sg != sd->groups);
-	}
-done:
 	return target;
 }
 /*
@@ -4926,6 +5205,8 @@ migrate_task_rq_fair(struct task_struct *p, int next_cpu)
 		se->avg.decay_count = -__synchronize_entity_decay(se);
 		atomic_long_add(se->avg.load_avg_contrib,
 						&cfs_rq->removed_load);
+		atomic_long_add(se->avg.utilization_avg_contrib,
+						&cfs_rq->removed_utilization);
 	}
 
 	/* We have migrated, no longer consider this task hot */
@@ -7987,6 +8268,7 @@ void init_cfs_rq(struct cfs_rq *cfs_rq)
 #ifdef CONFIG_SMP
 	atomic64_set(&cfs_rq->decay_counter, 1);
 	atomic_long_set(&cfs_rq->removed_load, 0);
+	atomic_long_set(&cfs_rq->removed_utilization, 0);
 #endif
 }
 
@@ -9,6 +9,7 @@
 #include <linux/irq_work.h>
 #include <linux/tick.h>
 #include <linux/slab.h>
+#include <linux/psi.h>
 
 #include "cpupri.h"
 #include "cpudeadline.h"
@@ -27,6 +28,10 @@ extern unsigned long calc_load_update;
 extern atomic_long_t calc_load_tasks;
 
 extern long calc_load_fold_active(struct rq *this_rq);
+extern unsigned long calc_load(unsigned long load, unsigned long exp,
+			       unsigned long active);
+extern unsigned long calc_load_n(unsigned long load, unsigned long exp,
+				 unsigned long active, unsigned int n);
 extern void update_cpu_load_active(struct rq *this_rq);
 
 /*
@@ -171,22 +176,52 @@ static inline int dl_bandwidth_enabled(void)
 }
 
 extern struct dl_bw *dl_bw_of(int i);
+extern int dl_bw_cpus(int i);
 
+/*
+ * Bandwidths are fixed point numbers with BW_SHIFT fractional bits, as
+ * returned by to_ratio(). bw_ratio caches 1 / bw with RATIO_SHIFT bits,
+ * so that the reclaiming code can scale by it without a division.
+ */
+#define BW_SHIFT	20
+#define BW_UNIT		(1 << BW_SHIFT)
+#define RATIO_SHIFT	8
+
+/*
+ * extra_bw is the part of bw, on each cpu, that is not reserved by any
+ * task of the domain: GRUB lets SCHED_FLAG_RECLAIM tasks run into it
+ * (see grub_reclaim()). It is derived from bw and total_bw, and has to
+ * be refreshed with __dl_update() whenever one of them changes.
+ */
 struct dl_bw {
 	raw_spinlock_t lock;
 	u64 bw, total_bw;
+	u64 extra_bw, bw_ratio;
 };
 
 static inline
-void __dl_clear(struct dl_bw *dl_b, u64 tsk_bw)
+void __dl_update(struct dl_bw *dl_b, int cpus)
+{
+	u64 bw = dl_b->bw == -1 ? BW_UNIT : dl_b->bw;
+	u64 used = cpus ? div_u64(dl_b->total_bw, cpus) : dl_b->total_bw;
+
+	WRITE_ONCE(dl_b->bw_ratio,
+		   bw ? div64_u64(1ULL << (BW_SHIFT + RATIO_SHIFT), bw) : 0);
+	WRITE_ONCE(dl_b->extra_bw, bw > used ? bw - used : 0);
+}
+
+static inline
+void __dl_clear(struct dl_bw *dl_b, u64 tsk_bw, int cpus)
 {
 	dl_b->total_bw -= tsk_bw;
+	__dl_update(dl_b, cpus);
 }
 
 static inline
-void __dl_add(struct dl_bw *dl_b, u64 tsk_bw)
+void __dl_add(struct dl_bw *dl_b, u64 tsk_bw, int cpus)
 {
 	dl_b->total_bw += tsk_bw;
+	__dl_update(dl_b, cpus);
 }
 
 static inline
@@ -260,6 +295,10 @@ struct task_group {
 	struct autogroup *autogroup;
 #endif
 
+#ifdef CONFIG_SCHED_CORE
+	int core_tagged;
+#endif
+
 	struct cfs_bandwidth cfs_bandwidth;
 };
 
@@ -371,9 +410,15 @@ struct cfs_rq {
 	 * sched_entities on the rq.
 	 */
 	unsigned long runnable_load_avg, blocked_load_avg, utilization_load_avg;
+	/*
+	 * blocked_utilization_avg is the decaying running time of the blocked
+	 * sched_entities, so that utilization doesn't drop to zero the moment
+	 * a task goes to sleep and is carried over on migration like load.
+	 */
+	unsigned long blocked_utilization_avg;
 	atomic64_t decay_counter;
 	u64 last_decay;
-	atomic_long_t removed_load;
+	atomic_long_t removed_load, removed_utilization;
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* Required to track per-cpu representation of a task_group */
@@ -572,9 +617,6 @@ struct rq {
 #ifdef CONFIG_NO_HZ_COMMON
 	u64 nohz_stamp;
 	unsigned long nohz_flags;
-#endif
-#ifdef CONFIG_NO_HZ_FULL
-	unsigned long last_sched_tick;
 #endif
 	/* capture load from *all* tasks on this cpu: */
 	struct load_weight load;
@@ -676,6 +718,15 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/*
+	 * remote wakeups queued by this cpu, and of those the ones that
+	 * sent an IPI or found the target polling; the rest were merged
+	 * into an IPI already in flight
+	 */
+	unsigned int ttwu_queued;
+	unsigned int ttwu_queued_ipi;
+	unsigned int ttwu_queued_poll;
 #endif
 
 #ifdef CONFIG_SMP
@@ -686,6 +737,16 @@ struct rq {
 	/* Must be inspected within a rcu lock section */
 	struct cpuidle_state *idle_state;
 #endif
+
+#ifdef CONFIG_SCHED_CORE
+	/* SMT co-scheduling, see sched_core_pick() */
+	raw_spinlock_t core_lock;	/* of the first sibling only */
+	unsigned int core_state;
+	unsigned long core_cookie;
+	unsigned long core_forceidle_seq;
+	u64 core_forceidle_start;
+	u64 core_forceidle_sum;
+#endif
 };
 
 static inline int cpu_of(struct rq *rq)
@@ -756,6 +817,8 @@ enum numa_faults_stats {
 extern void sched_setnuma(struct task_struct *p, int node);
 extern int migrate_task_to(struct task_struct *p, int cpu);
 extern int migrate_swap(struct task_struct *, struct task_struct *);
+extern unsigned long numa_node_accesses(int nid);
+extern bool numa_node_saturated(int nid);
 #endif /* CONFIG_NUMA_BALANCING */
 
 #ifdef CONFIG_SMP
@@ -819,6 +882,7 @@ DECLARE_PER_CPU(int, sd_llc_id);
 DECLARE_PER_CPU(struct sched_domain *, sd_numa);
 DECLARE_PER_CPU(struct sched_domain *, sd_busy);
 DECLARE_PER_CPU(struct sched_domain *, sd_asym);
+DECLARE_PER_CPU_SHARED_ALIGNED(int, sd_llc_idle_cores);
 
 struct sched_group_capacity {
 	atomic_t ref;
@@ -1253,6 +1317,24 @@ static inline void idle_exit_fair(struct rq *rq) { }
 
 #endif
 
+#if defined(CONFIG_SMP) && defined(CONFIG_SCHED_SMT)
+
+extern struct static_key sched_smt_present;
+
+extern void __update_idle_core(struct rq *rq);
+
+static inline void update_idle_core(struct rq *rq)
+{
+	if (static_key_false(&sched_smt_present))
+		__update_idle_core(rq);
+}
+
+#else
+
+static inline void update_idle_core(struct rq *rq) { }
+
+#endif
+
 #ifdef CONFIG_CPU_IDLE
 static inline void idle_set_state(struct rq *rq,
 				  struct cpuidle_state *idle_state)
@@ -1335,13 +1417,6 @@ static inline void sub_nr_running(struct rq *rq, unsigned count)
 	rq->nr_running -= count;
 }
 
-static inline void rq_last_tick_reset(struct rq *rq)
-{
-#ifdef CONFIG_NO_HZ_FULL
-	rq->last_sched_tick = jiffies;
-#endif
-}
-
 extern void update_rq_clock(struct rq *rq);
 
 extern void activate_task(struct rq *rq, struct task_struct *p, int flags);
@@ -1734,3 +1809,49 @@ static inline u64 irq_time_read(int cpu)
 }
 #endif /* CONFIG_64BIT */
 #endif /* CONFIG_IRQ_TIME_ACCOUNTING */
+
+#ifdef CONFIG_CPU_FREQ
+DECLARE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
+
+/**
+ * cpufreq_update_util - Take a note about CPU utilization changes.
+ * @time: Current time.
+ * @util: Current utilization.
+ * @max: Utilization ceiling.
+ *
+ * This function is called by the scheduler on every invocation of
+ * update_cfs_rq_blocked_load() and on the enqueue and dequeue paths for
+ * the CPU whose utilization is being updated.  Callers of it must be on
+ * that CPU and hold its rq->lock.
+ *
+ * It can only be called from RCU-sched read-side critical sections, which
+ * the rq->lock with interrupts disabled provides.
+ */
+static inline void cpufreq_update_util(u64 time, unsigned long util, unsigned long max)
+{
+	struct update_util_data *data;
+
+	data = rcu_dereference_sched(*this_cpu_ptr(&cpufreq_update_util_data));
+	if (data)
+		data->func(data, time, util, max);
+}
+
+/**
+ * cpufreq_trigger_update - Trigger CPU performance state evaluation if needed.
+ * @time: Current time.
+ *
+ * The way cpufreq is currently arranged requires it to evaluate the CPU
+ * performance state (frequency/voltage) on a regular basis to prevent it from
+ * being stuck in a completely inadequate performance level for too long.
+ * That is not guaranteed to happen if the updates are only triggered from CFS,
+ * though, because they may not be coming in if RT or deadline tasks are active
+ * all the time.  Passing ULONG_MAX as @util asks for the maximum.
+ */
+static inline void cpufreq_trigger_update(u64 time)
+{
+	cpufreq_update_util(time, ULONG_MAX, 0);
+}
+#else
+static inline void cpufreq_update_util(u64 time, unsigned long util, unsigned long max) {}
+static inline void cpufreq_trigger_update(u64 time) {}
+#endif /* CONFIG_CPU_FREQ */
@@ -158,6 +158,82 @@ sched_info_switch(struct rq *rq,
 #define sched_info_switch(rq, t, next)		do { } while (0)
 #endif /* CONFIG_SCHEDSTATS || CONFIG_TASK_DELAY_ACCT */
 
+#ifdef CONFIG_PSI
+/*
+ * PSI tracks state that persists across sleeps, such as iowaits and
+ * memory stalls.  As a result, it has to distinguish between sleeps,
+ * where a task's runnable state changes, and requeues, where a task
+ * and its state are being moved between CPUs and runqueues.
+ */
+static inline void psi_enqueue(struct task_struct *p, bool wakeup)
+{
+	int clear = 0, set = TSK_RUNNING;
+
+	if (static_key_false(&psi_disabled))
+		return;
+
+	if (!wakeup || p->sched_psi_wake_requeue) {
+		if (p->flags & PF_MEMSTALL)
+			set |= TSK_MEMSTALL;
+		if (p->sched_psi_wake_requeue)
+			p->sched_psi_wake_requeue = 0;
+	} else {
+		if (p->psi_flags & TSK_IOWAIT)
+			clear |= TSK_IOWAIT;
+	}
+
+	psi_task_change(p, clear, set);
+}
+
+static inline void psi_dequeue(struct task_struct *p, bool sleep)
+{
+	int clear = TSK_RUNNING, set = 0;
+
+	if (static_key_false(&psi_disabled))
+		return;
+
+	if (!sleep) {
+		if (p->flags & PF_MEMSTALL)
+			clear |= TSK_MEMSTALL;
+	} else {
+		if (p->in_iowait)
+			set |= TSK_IOWAIT;
+	}
+
+	psi_task_change(p, clear, set);
+}
+
+/*
+ * Is the task being migrated during a wakeup?  Make sure to deregister
+ * its sleep-persistent psi states from the old queue, and let
+ * psi_enqueue() know it has to requeue.
+ *
+ * Called with p->pi_lock held and p off the runqueue, so task_rq()
+ * is stable until set_task_cpu().
+ */
+static inline void psi_ttwu_dequeue(struct task_struct *p)
+{
+	int clear;
+
+	if (static_key_false(&psi_disabled))
+		return;
+
+	clear = p->psi_flags & (TSK_IOWAIT | TSK_MEMSTALL);
+	if (unlikely(clear)) {
+		struct rq *rq = task_rq(p);
+
+		raw_spin_lock(&rq->lock);
+		psi_task_change(p, clear, 0);
+		p->sched_psi_wake_requeue = 1;
+		raw_spin_unlock(&rq->lock);
+	}
+}
+#else
+static inline void psi_enqueue(struct task_struct *p, bool wakeup) {}
+static inline void psi_dequeue(struct task_struct *p, bool sleep) {}
+static inline void psi_ttwu_dequeue(struct task_struct *p) {}
+#endif /* CONFIG_PSI */
+
 /*
  * The following are functions that support scheduler-internal time accounting.
  * These functions are generally called at the timer tick.  None of this depends
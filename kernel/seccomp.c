@@ -25,7 +25,13 @@
 #include <asm/syscall.h>
 #endif
 
+#if defined(CONFIG_HAVE_ARCH_SECCOMP_FILTER) && defined(NR_syscalls)
+/* Per-filter cache of syscalls that are always allowed */
+#define SECCOMP_CACHE_NR	NR_syscalls
+#endif
+
 #ifdef CONFIG_SECCOMP_FILTER
+#include <linux/bitmap.h>
 #include <linux/filter.h>
 #include <linux/pid.h>
 #include <linux/ptrace.h>
@@ -41,8 +47,10 @@
  *         outside of a lifetime-guarded section.  In general, this
  *         is only needed for handling filters shared across tasks.
  * @prev: points to a previously installed, or inherited, filter
- * @len: the number of instructions in the program
- * @insnsi: the BPF program instructions to evaluate
+ * @prog: the BPF program to evaluate
+ * @cache_arch: the audit arch @cache_allow was computed for
+ * @cache_allow: syscalls that this filter and all of its @prev filters
+ *               allow for @cache_arch, whatever the arguments are
  *
  * seccomp_filter objects are organized in a tree linked via the @prev
  * pointer.  For any task, it appears to be a singly-linked list starting
@@ -58,6 +66,10 @@ struct seccomp_filter {
 	atomic_t usage;
 	struct seccomp_filter *prev;
 	struct bpf_prog *prog;
+#ifdef SECCOMP_CACHE_NR
+	u32 cache_arch;
+	DECLARE_BITMAP(cache_allow, SECCOMP_CACHE_NR);
+#endif
 };
 
 /* Limit any path through the tree to 256KB worth of instructions. */
@@ -167,6 +179,120 @@ static int seccomp_check_filter(struct sock_filter *filter, unsigned int flen)
 	return 0;
 }
 
+#ifdef SECCOMP_CACHE_NR
+/**
+ * seccomp_is_const_allow - check if a filter allows a syscall regardless
+ *			    of its arguments
+ * @fp: filter, as checked and rewritten by seccomp_check_filter()
+ * @flen: length of filter
+ * @nr: system call number
+ * @arch: audit arch of the system call
+ *
+ * Emulates the filter with only the syscall number and arch known.  Any
+ * load of another field, or any instruction that is not understood here,
+ * makes the result depend on more than those and returns false.
+ */
+static bool seccomp_is_const_allow(struct sock_filter *fp, unsigned int flen,
+				   int nr, u32 arch)
+{
+	u32 A = 0;
+	int pc;
+
+	for (pc = 0; pc < flen; pc++) {
+		struct sock_filter *insn = &fp[pc];
+		u32 k = insn->k;
+		bool res;
+
+		switch (insn->code) {
+		/* BPF_LD | BPF_W | BPF_ABS after seccomp_check_filter() */
+		case BPF_LDX | BPF_W | BPF_ABS:
+			if (k == offsetof(struct seccomp_data, nr))
+				A = nr;
+			else if (k == offsetof(struct seccomp_data, arch))
+				A = arch;
+			else
+				return false;
+			continue;
+		case BPF_ALU | BPF_AND | BPF_K:
+			A &= k;
+			continue;
+		case BPF_RET | BPF_K:
+			return (k & SECCOMP_RET_ACTION) == SECCOMP_RET_ALLOW;
+		case BPF_JMP | BPF_JA:
+			pc += k;
+			continue;
+		case BPF_JMP | BPF_JEQ | BPF_K:
+			res = A == k;
+			break;
+		case BPF_JMP | BPF_JGE | BPF_K:
+			res = A >= k;
+			break;
+		case BPF_JMP | BPF_JGT | BPF_K:
+			res = A > k;
+			break;
+		case BPF_JMP | BPF_JSET | BPF_K:
+			res = A & k;
+			break;
+		default:
+			return false;
+		}
+		pc += res ? insn->jt : insn->jf;
+	}
+	/* bpf_check_classic() makes sure every path ends in a return */
+	return false;
+}
+
+static void seccomp_cache_prepare(struct seccomp_filter *filter,
+				  struct sock_filter *fp, unsigned int flen)
+{
+	int nr;
+
+	filter->cache_arch = syscall_get_arch();
+	for (nr = 0; nr < SECCOMP_CACHE_NR; nr++) {
+		if (seccomp_is_const_allow(fp, flen, nr, filter->cache_arch))
+			__set_bit(nr, filter->cache_allow);
+	}
+}
+
+/* A syscall is only cached as allowed if every filter in the list allows it */
+static void seccomp_cache_inherit(struct seccomp_filter *filter)
+{
+	struct seccomp_filter *prev = filter->prev;
+
+	if (!prev)
+		return;
+	if (prev->cache_arch == filter->cache_arch)
+		bitmap_and(filter->cache_allow, filter->cache_allow,
+			   prev->cache_allow, SECCOMP_CACHE_NR);
+	else
+		bitmap_zero(filter->cache_allow, SECCOMP_CACHE_NR);
+}
+
+static inline bool seccomp_cache_check_allow(struct seccomp_filter *f,
+					     struct seccomp_data *sd)
+{
+	return sd->arch == f->cache_arch &&
+	       sd->nr >= 0 && sd->nr < SECCOMP_CACHE_NR &&
+	       test_bit(sd->nr, f->cache_allow);
+}
+#else
+static inline void seccomp_cache_prepare(struct seccomp_filter *filter,
+					 struct sock_filter *fp,
+					 unsigned int flen)
+{
+}
+
+static inline void seccomp_cache_inherit(struct seccomp_filter *filter)
+{
+}
+
+static inline bool seccomp_cache_check_allow(struct seccomp_filter *f,
+					     struct seccomp_data *sd)
+{
+	return false;
+}
+#endif /* SECCOMP_CACHE_NR */
+
 /**
  * seccomp_run_filters - evaluates all seccomp filters against @syscall
  * @syscall: number of the current system call
@@ -191,6 +317,10 @@ static u32 seccomp_run_filters(struct seccomp_data *sd)
 		sd = &sd_local;
 	}
 
+	/* Syscalls that every filter allows whatever the arguments are */
+	if (seccomp_cache_check_allow(f, sd))
+		return SECCOMP_RET_ALLOW;
+
 	/*
 	 * All filters in the list are evaluated and the lowest BPF return
 	 * value always takes priority (ignoring the DATA).
@@ -407,6 +537,7 @@ static struct seccomp_filter *seccomp_prepare_filter(struct sock_fprog *fprog)
 	if (ret)
 		goto free_filter_prog;
 
+	seccomp_cache_prepare(filter, fp, fprog->len);
 	kfree(fp);
 	atomic_set(&filter->usage, 1);
 	filter->prog->len = new_len;
@@ -490,6 +621,7 @@ static long seccomp_attach_filter(unsigned int flags,
 	 * task reference.
 	 */
 	filter->prev = current->seccomp.filter;
+	seccomp_cache_inherit(filter);
 	current->seccomp.filter = filter;
 
 	/* Now that the new filter is in place, synchronize to all threads. */
@@ -158,6 +158,7 @@ cond_syscall(compat_sys_process_vm_writev);
 cond_syscall(sys_uselib);
 cond_syscall(sys_fadvise64);
 cond_syscall(sys_fadvise64_64);
+cond_syscall(sys_prefetch);
 cond_syscall(sys_madvise);
 cond_syscall(sys_setuid);
 cond_syscall(sys_setregid);
@@ -243,3 +244,10 @@ cond_syscall(sys_bpf);
 
 /* execveat */
 cond_syscall(sys_execveat);
+
+/* shared ring async io */
+cond_syscall(sys_io_uring_setup);
+cond_syscall(sys_io_uring_enter);
+
+/* userfaultfd */
+cond_syscall(sys_userfaultfd);
@@ -157,21 +157,30 @@ cpumask_var_t tick_nohz_full_mask;
 cpumask_var_t housekeeping_mask;
 bool tick_nohz_full_running;
 
-static bool can_stop_full_tick(void)
+static void tick_dep_note(struct tick_sched *ts, int dep)
+{
+	ts->tick_dep_last = dep;
+	ts->tick_dep_count[dep]++;
+}
+
+static bool can_stop_full_tick(struct tick_sched *ts)
 {
 	WARN_ON_ONCE(!irqs_disabled());
 
 	if (!sched_can_stop_tick()) {
+		tick_dep_note(ts, TICK_DEP_BIT_SCHED);
 		trace_tick_stop(0, "more than 1 task in runqueue\n");
 		return false;
 	}
 
 	if (!posix_cpu_timers_can_stop_tick(current)) {
+		tick_dep_note(ts, TICK_DEP_BIT_POSIX_TIMER);
 		trace_tick_stop(0, "posix timers running\n");
 		return false;
 	}
 
 	if (!perf_event_can_stop_tick()) {
+		tick_dep_note(ts, TICK_DEP_BIT_PERF_EVENTS);
 		trace_tick_stop(0, "perf events running\n");
 		return false;
 	}
@@ -183,6 +192,7 @@ static bool can_stop_full_tick(void)
 	 * sched_clock_stable is set.
 	 */
 	if (!sched_clock_stable()) {
+		tick_dep_note(ts, TICK_DEP_BIT_CLOCK_UNSTABLE);
 		trace_tick_stop(0, "unstable sched clock\n");
 		/*
 		 * Don't allow the user to think they can get
@@ -209,8 +219,10 @@ void __tick_nohz_full_check(void)
 
 	if (tick_nohz_full_cpu(smp_processor_id())) {
 		if (ts->tick_stopped && !is_idle_task(current)) {
-			if (!can_stop_full_tick())
+			if (!can_stop_full_tick(ts)) {
+				ts->tick_restarts++;
 				tick_nohz_restart_sched_tick(ts, ktime_get());
+			}
 		}
 	}
 }
@@ -285,7 +297,8 @@ void __tick_nohz_task_switch(struct task_struct *tsk)
 	if (!tick_nohz_full_cpu(smp_processor_id()))
 		goto out;
 
-	if (tick_nohz_tick_stopped() && !can_stop_full_tick())
+	if (tick_nohz_tick_stopped() &&
+	    !can_stop_full_tick(this_cpu_ptr(&tick_cpu_sched)))
 		tick_nohz_full_kick();
 
 out:
@@ -421,6 +434,13 @@ int tick_nohz_tick_stopped(void)
 	return __this_cpu_read(tick_cpu_sched.tick_stopped);
 }
 
+int tick_nohz_tick_stopped_cpu(int cpu)
+{
+	struct tick_sched *ts = per_cpu_ptr(&tick_cpu_sched, cpu);
+
+	return ts->tick_stopped;
+}
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -630,13 +650,6 @@ static ktime_t tick_nohz_stop_sched_tick(struct tick_sched *ts,
 			time_delta = KTIME_MAX;
 		}
 
-#ifdef CONFIG_NO_HZ_FULL
-		if (!ts->inidle) {
-			time_delta = min(time_delta,
-					 scheduler_tick_max_deferment());
-		}
-#endif
-
 		/*
 		 * calculate the expiry time for the next timer wheel
 		 * timer. delta_jiffies >= NEXT_TIMER_MAX_DELTA signals
@@ -728,7 +741,7 @@ static void tick_nohz_full_stop_tick(struct tick_sched *ts)
 	if (!ts->tick_stopped && ts->nohz_mode == NOHZ_MODE_INACTIVE)
 		return;
 
-	if (!can_stop_full_tick())
+	if (!can_stop_full_tick(ts))
 		return;
 
 	tick_nohz_stop_sched_tick(ts, ktime_get(), cpu);
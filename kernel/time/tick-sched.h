@@ -13,6 +13,15 @@ struct tick_device {
 	enum tick_device_mode mode;
 };
 
+/* Why a full dynticks cpu kept or restarted its tick */
+enum tick_dep_bits {
+	TICK_DEP_BIT_SCHED,
+	TICK_DEP_BIT_POSIX_TIMER,
+	TICK_DEP_BIT_PERF_EVENTS,
+	TICK_DEP_BIT_CLOCK_UNSTABLE,
+	TICK_DEP_NR,
+};
+
 enum tick_nohz_mode {
 	NOHZ_MODE_INACTIVE,
 	NOHZ_MODE_LOWRES,
@@ -38,6 +47,10 @@ enum tick_nohz_mode {
  * @iowait_sleeptime:	Sum of the time slept in idle with sched tick stopped, with IO outstanding
  * @sleep_length:	Duration of the current idle sleep
  * @do_timer_lst:	CPU was the last one doing do_timer before going idle
+ * @tick_dep_last:	Last reason a full dynticks CPU needed the tick
+ * @tick_dep_count:	Number of times each reason kept the tick running
+ * @tick_restarts:	Number of times the tick of a busy full dynticks
+ *			CPU was restarted
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -60,6 +73,11 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+#ifdef CONFIG_NO_HZ_FULL
+	int				tick_dep_last;
+	unsigned long			tick_dep_count[TICK_DEP_NR];
+	unsigned long			tick_restarts;
+#endif
 };
 
 extern struct tick_sched *tick_get_tick_sched(int cpu);
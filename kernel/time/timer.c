@@ -57,23 +57,54 @@ __visible u64 jiffies_64 __cacheline_aligned_in_smp = INITIAL_JIFFIES;
 EXPORT_SYMBOL(jiffies_64);
 
 /*
- * per-CPU timer vector definitions:
+ * The timer wheel has LVL_DEPTH levels of LVL_SIZE buckets each. The
+ * buckets of level 0 are one jiffy apart, every further level is
+ * LVL_CLK_DIV times coarser than the one below it. A timer is queued
+ * once, in the level whose range covers its timeout, with the expiry
+ * rounded up to the granularity of that level. It is never moved
+ * (cascaded) to a finer level afterwards, so a timer on an upper level
+ * fires up to one bucket width late. Almost all timeouts are cancelled
+ * long before they expire, and those that do expire rarely care about
+ * the exact tick.
+ *
+ * HZ 1000, LVL_DEPTH 9:
+ * Level Offset  Granularity            Range
+ *  0      0         1 ms                0 ms -         63 ms
+ *  1     64         8 ms               64 ms -        511 ms
+ *  2    128        64 ms              512 ms -       4095 ms (512ms - ~4s)
+ *  3    192       512 ms             4096 ms -      32767 ms (~4s - ~32s)
+ *  4    256      4096 ms (~4s)      32768 ms -     262143 ms (~32s - ~4m)
+ *  5    320     32768 ms (~32s)    262144 ms -    2097151 ms (~4m - ~34m)
+ *  6    384    262144 ms (~4m)    2097152 ms -   16777215 ms (~34m - ~4h)
+ *  7    448   2097152 ms (~34m)  16777216 ms -  134217727 ms (~4h - ~1d)
+ *  8    512  16777216 ms (~4h)  134217728 ms - 1073741822 ms (~1d - ~12d)
+ *
+ * Timeouts beyond the last level are clamped to WHEEL_TIMEOUT_MAX.
  */
-#define TVN_BITS (CONFIG_BASE_SMALL ? 4 : 6)
-#define TVR_BITS (CONFIG_BASE_SMALL ? 6 : 8)
-#define TVN_SIZE (1 << TVN_BITS)
-#define TVR_SIZE (1 << TVR_BITS)
-#define TVN_MASK (TVN_SIZE - 1)
-#define TVR_MASK (TVR_SIZE - 1)
-#define MAX_TVAL ((unsigned long)((1ULL << (TVR_BITS + 4*TVN_BITS)) - 1))
-
-struct tvec {
-	struct list_head vec[TVN_SIZE];
-};
+#define LVL_CLK_SHIFT	3
+#define LVL_CLK_DIV	(1UL << LVL_CLK_SHIFT)
+#define LVL_CLK_MASK	(LVL_CLK_DIV - 1)
+#define LVL_SHIFT(n)	((n) * LVL_CLK_SHIFT)
+#define LVL_GRAN(n)	(1UL << LVL_SHIFT(n))
+
+/* First timeout, relative to the wheel clock, that goes to level n */
+#define LVL_START(n)	((LVL_SIZE - 1) << (((n) - 1) * LVL_CLK_SHIFT))
+
+#define LVL_BITS	6
+#define LVL_SIZE	(1UL << LVL_BITS)
+#define LVL_MASK	(LVL_SIZE - 1)
+#define LVL_OFFS(n)	((n) * LVL_SIZE)
+
+#if HZ > 100
+# define LVL_DEPTH	9
+#else
+# define LVL_DEPTH	8
+#endif
 
-struct tvec_root {
-	struct list_head vec[TVR_SIZE];
-};
+#define WHEEL_TIMEOUT_CUTOFF	(LVL_START(LVL_DEPTH))
+#define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
+
+#define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
 struct tvec_base {
 	spinlock_t lock;
@@ -83,11 +114,8 @@ struct tvec_base {
 	unsigned long active_timers;
 	unsigned long all_timers;
 	int cpu;
-	struct tvec_root tv1;
-	struct tvec tv2;
-	struct tvec tv3;
-	struct tvec tv4;
-	struct tvec tv5;
+	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
+	struct list_head vectors[WHEEL_SIZE];
 } ____cacheline_aligned;
 
 /*
@@ -363,61 +391,83 @@ static bool catchup_timer_jiffies(struct tvec_base *base)
 	return false;
 }
 
-static void
-__internal_add_timer(struct tvec_base *base, struct timer_list *timer)
+/*
+ * Round @expires up to the granularity of level @lvl, so that a timer
+ * never fires early, and return the bucket it goes to. The jiffy at
+ * which that bucket is run is stored in @bucket_expiry.
+ */
+static inline unsigned int calc_index(unsigned long expires, unsigned int lvl,
+				      unsigned long *bucket_expiry)
 {
-	unsigned long expires = timer->expires;
-	unsigned long idx = expires - base->timer_jiffies;
-	struct list_head *vec;
-
-	if (idx < TVR_SIZE) {
-		int i = expires & TVR_MASK;
-		vec = base->tv1.vec + i;
-	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
-		int i = (expires >> TVR_BITS) & TVN_MASK;
-		vec = base->tv2.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
-		vec = base->tv3.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv4.vec + i;
-	} else if ((signed long) idx < 0) {
+	expires = (expires + LVL_GRAN(lvl) - 1) >> LVL_SHIFT(lvl);
+	*bucket_expiry = expires << LVL_SHIFT(lvl);
+	return LVL_OFFS(lvl) + (expires & LVL_MASK);
+}
+
+static unsigned int calc_wheel_index(unsigned long expires, unsigned long clk,
+				     unsigned long *bucket_expiry)
+{
+	unsigned long delta = expires - clk;
+	unsigned int lvl;
+
+	if ((long) delta < 0) {
 		/*
 		 * Can happen if you add a timer with expires == jiffies,
 		 * or you set a timer to go off in the past
 		 */
-		vec = base->tv1.vec + (base->timer_jiffies & TVR_MASK);
-	} else {
-		int i;
-		/* If the timeout is larger than MAX_TVAL (on 64-bit
-		 * architectures or with CONFIG_BASE_SMALL=1) then we
-		 * use the maximum timeout.
+		*bucket_expiry = clk;
+		return clk & LVL_MASK;
+	}
+
+	if (delta >= WHEEL_TIMEOUT_CUTOFF) {
+		/*
+		 * Beyond the range of the last level, which only happens
+		 * on 64-bit, use the maximum timeout.
 		 */
-		if (idx > MAX_TVAL) {
-			idx = MAX_TVAL;
-			expires = idx + base->timer_jiffies;
-		}
-		i = (expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv5.vec + i;
+		expires = clk + WHEEL_TIMEOUT_MAX;
+		delta = WHEEL_TIMEOUT_MAX;
 	}
+
+	for (lvl = 0; lvl < LVL_DEPTH - 1; lvl++)
+		if (delta < LVL_START(lvl + 1))
+			break;
+
+	return calc_index(expires, lvl, bucket_expiry);
+}
+
+/*
+ * Queue @timer on the wheel and return the jiffy at which its bucket
+ * expires.
+ */
+static unsigned long
+__internal_add_timer(struct tvec_base *base, struct timer_list *timer)
+{
+	unsigned long bucket_expiry;
+	unsigned int idx;
+
+	idx = calc_wheel_index(timer->expires, base->timer_jiffies,
+			       &bucket_expiry);
 	/*
 	 * Timers are FIFO:
 	 */
-	list_add_tail(&timer->entry, vec);
+	list_add_tail(&timer->entry, base->vectors + idx);
+	__set_bit(idx, base->pending_map);
+	return bucket_expiry;
 }
 
 static void internal_add_timer(struct tvec_base *base, struct timer_list *timer)
 {
+	unsigned long bucket_expiry;
+
 	(void)catchup_timer_jiffies(base);
-	__internal_add_timer(base, timer);
+	bucket_expiry = __internal_add_timer(base, timer);
 	/*
 	 * Update base->active_timers and base->next_timer
 	 */
 	if (!tbase_get_deferrable(timer->base)) {
 		if (!base->active_timers++ ||
-		    time_before(timer->expires, base->next_timer))
-			base->next_timer = timer->expires;
+		    time_before(bucket_expiry, base->next_timer))
+			base->next_timer = bucket_expiry;
 	}
 	base->all_timers++;
 
@@ -719,16 +769,37 @@ detach_expired_timer(struct timer_list *timer, struct tvec_base *base)
 	(void)catchup_timer_jiffies(base);
 }
 
+/*
+ * If @timer is the last one in its wheel bucket, the bucket is about to
+ * become empty and its pending bit is cleared. Timers that were already
+ * moved to the expiry list of __run_timers() have no bucket any more.
+ */
+static inline void wheel_clear_pending(struct timer_list *timer,
+				       struct tvec_base *base)
+{
+	struct list_head *head = timer->entry.next;
+
+	if (head == timer->entry.prev && head >= base->vectors &&
+	    head < base->vectors + WHEEL_SIZE)
+		__clear_bit(head - base->vectors, base->pending_map);
+}
+
 static int detach_if_pending(struct timer_list *timer, struct tvec_base *base,
 			     bool clear_pending)
 {
 	if (!timer_pending(timer))
 		return 0;
 
+	wheel_clear_pending(timer, base);
 	detach_timer(timer, clear_pending);
 	if (!tbase_get_deferrable(timer->base)) {
 		base->active_timers--;
-		if (timer->expires == base->next_timer)
+		/*
+		 * The bucket of the timer expires at or after
+		 * timer->expires, so if the timer may have been the
+		 * next one, recompute on the next lookup.
+		 */
+		if (!time_after(timer->expires, base->next_timer))
 			base->next_timer = base->timer_jiffies;
 	}
 	base->all_timers--;
@@ -742,7 +813,7 @@ static int detach_if_pending(struct timer_list *timer, struct tvec_base *base,
  * locked, and the base itself is locked too.
  *
  * So __run_timers/migrate_timers can safely modify all timers which could
- * be found on ->tvX lists.
+ * be found in the ->vectors buckets.
  *
  * When the timer's base is locked, and the timer removed from list, it is
  * possible to set timer->base = NULL and drop the lock: the timer remains
@@ -768,9 +839,12 @@ static struct tvec_base *lock_timer_base(struct timer_list *timer,
 	}
 }
 
+#define MOD_TIMER_PENDING_ONLY		0x01
+#define MOD_TIMER_REDUCE		0x02
+
 static inline int
 __mod_timer(struct timer_list *timer, unsigned long expires,
-						bool pending_only, int pinned)
+					unsigned int options, int pinned)
 {
 	struct tvec_base *base, *new_base;
 	unsigned long flags;
@@ -781,8 +855,14 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 
 	base = lock_timer_base(timer, &flags);
 
+	if ((options & MOD_TIMER_REDUCE) && timer_pending(timer) &&
+	    !time_before(expires, timer->expires)) {
+		ret = 1;
+		goto out_unlock;
+	}
+
 	ret = detach_if_pending(timer, base, false);
-	if (!ret && pending_only)
+	if (!ret && (options & MOD_TIMER_PENDING_ONLY))
 		goto out_unlock;
 
 	debug_activate(timer, expires);
@@ -829,7 +909,8 @@ out_unlock:
  */
 int mod_timer_pending(struct timer_list *timer, unsigned long expires)
 {
-	return __mod_timer(timer, expires, true, TIMER_NOT_PINNED);
+	return __mod_timer(timer, expires, MOD_TIMER_PENDING_ONLY,
+			   TIMER_NOT_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pending);
 
@@ -904,10 +985,37 @@ int mod_timer(struct timer_list *timer, unsigned long expires)
 	if (timer_pending(timer) && timer->expires == expires)
 		return 1;
 
-	return __mod_timer(timer, expires, false, TIMER_NOT_PINNED);
+	return __mod_timer(timer, expires, 0, TIMER_NOT_PINNED);
 }
 EXPORT_SYMBOL(mod_timer);
 
+/**
+ * timer_reduce - modify a timer's timeout if it would reduce the timeout
+ * @timer: the timer to be modified
+ * @expires: new timeout in jiffies
+ *
+ * timer_reduce() is very similar to mod_timer(), except that it will only
+ * modify a pending timer if that would reduce the expiration time (it will
+ * start a timer that isn't pending).
+ *
+ * This suits timers that are pushed back far more often than they fire:
+ * the caller records the real deadline elsewhere and the handler re-arms
+ * itself when it finds that it ran early.
+ *
+ * The return value is the same as for mod_timer().
+ */
+int timer_reduce(struct timer_list *timer, unsigned long expires)
+{
+	expires = apply_slack(timer, expires);
+
+	/* Nothing to do, without taking the base lock. */
+	if (timer_pending(timer) && !time_before(expires, timer->expires))
+		return 1;
+
+	return __mod_timer(timer, expires, MOD_TIMER_REDUCE, TIMER_NOT_PINNED);
+}
+EXPORT_SYMBOL(timer_reduce);
+
 /**
  * mod_timer_pinned - modify a timer's timeout
  * @timer: the timer to be modified
@@ -932,7 +1040,7 @@ int mod_timer_pinned(struct timer_list *timer, unsigned long expires)
 	if (timer->expires == expires && timer_pending(timer))
 		return 1;
 
-	return __mod_timer(timer, expires, false, TIMER_PINNED);
+	return __mod_timer(timer, expires, 0, TIMER_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pinned);
 
@@ -1104,27 +1212,6 @@ int del_timer_sync(struct timer_list *timer)
 EXPORT_SYMBOL(del_timer_sync);
 #endif
 
-static int cascade(struct tvec_base *base, struct tvec *tv, int index)
-{
-	/* cascade all the timers from tv up one level */
-	struct timer_list *timer, *tmp;
-	struct list_head tv_list;
-
-	list_replace_init(tv->vec + index, &tv_list);
-
-	/*
-	 * We are removing _all_ timers from the list, so we
-	 * don't have to detach them individually.
-	 */
-	list_for_each_entry_safe(timer, tmp, &tv_list, entry) {
-		BUG_ON(tbase_get_base(timer->base) != base);
-		/* No accounting, while moving them */
-		__internal_add_timer(base, timer);
-	}
-
-	return index;
-}
-
 static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 			  unsigned long data)
 {
@@ -1168,18 +1255,73 @@ static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 	}
 }
 
-#define INDEX(N) ((base->timer_jiffies >> (TVR_BITS + (N) * TVN_BITS)) & TVN_MASK)
+static void expire_timers(struct tvec_base *base, struct list_head *head)
+{
+	while (!list_empty(head)) {
+		struct timer_list *timer;
+		void (*fn)(unsigned long);
+		unsigned long data;
+		bool irqsafe;
+
+		timer = list_first_entry(head, struct timer_list, entry);
+		fn = timer->function;
+		data = timer->data;
+		irqsafe = tbase_get_irqsafe(timer->base);
+
+		timer_stats_account_timer(timer);
+
+		base->running_timer = timer;
+		detach_expired_timer(timer, base);
+
+		if (irqsafe) {
+			spin_unlock(&base->lock);
+			call_timer_fn(timer, fn, data);
+			spin_lock(&base->lock);
+		} else {
+			spin_unlock_irq(&base->lock);
+			call_timer_fn(timer, fn, data);
+			spin_lock_irq(&base->lock);
+		}
+	}
+}
+
+/*
+ * Move the buckets that expire at base->timer_jiffies to @heads. Level n
+ * only advances every LVL_CLK_DIV ticks of level n - 1, so the walk stops
+ * at the first level whose clock did not wrap.
+ */
+static int collect_expired_timers(struct tvec_base *base,
+				  struct list_head *heads)
+{
+	unsigned long clk = base->timer_jiffies;
+	unsigned int i, idx;
+	int levels = 0;
+
+	for (i = 0; i < LVL_DEPTH; i++) {
+		idx = (clk & LVL_MASK) + i * LVL_SIZE;
+
+		if (__test_and_clear_bit(idx, base->pending_map)) {
+			list_replace_init(base->vectors + idx, heads++);
+			levels++;
+		}
+		if (clk & LVL_CLK_MASK)
+			break;
+		clk >>= LVL_CLK_SHIFT;
+	}
+	return levels;
+}
 
 /**
  * __run_timers - run all expired timers (if any) on this CPU.
  * @base: the timer vector to be processed.
  *
- * This function cascades all vectors and executes all expired timer
- * vectors.
+ * This function executes all timers of the wheel buckets that expired
+ * since the last run.
  */
 static inline void __run_timers(struct tvec_base *base)
 {
-	struct timer_list *timer;
+	struct list_head heads[LVL_DEPTH];
+	int levels;
 
 	spin_lock_irq(&base->lock);
 	if (catchup_timer_jiffies(base)) {
@@ -1187,45 +1329,12 @@ static inline void __run_timers(struct tvec_base *base)
 		return;
 	}
 	while (time_after_eq(jiffies, base->timer_jiffies)) {
-		struct list_head work_list;
-		struct list_head *head = &work_list;
-		int index = base->timer_jiffies & TVR_MASK;
-
-		/*
-		 * Cascade timers:
-		 */
-		if (!index &&
-			(!cascade(base, &base->tv2, INDEX(0))) &&
-				(!cascade(base, &base->tv3, INDEX(1))) &&
-					!cascade(base, &base->tv4, INDEX(2)))
-			cascade(base, &base->tv5, INDEX(3));
+		levels = collect_expired_timers(base, heads);
 		++base->timer_jiffies;
-		list_replace_init(base->tv1.vec + index, head);
-		while (!list_empty(head)) {
-			void (*fn)(unsigned long);
-			unsigned long data;
-			bool irqsafe;
-
-			timer = list_first_entry(head, struct timer_list,entry);
-			fn = timer->function;
-			data = timer->data;
-			irqsafe = tbase_get_irqsafe(timer->base);
-
-			timer_stats_account_timer(timer);
-
-			base->running_timer = timer;
-			detach_expired_timer(timer, base);
-
-			if (irqsafe) {
-				spin_unlock(&base->lock);
-				call_timer_fn(timer, fn, data);
-				spin_lock(&base->lock);
-			} else {
-				spin_unlock_irq(&base->lock);
-				call_timer_fn(timer, fn, data);
-				spin_lock_irq(&base->lock);
-			}
-		}
+
+		/* the coarser levels hold the older timers, run them first */
+		while (levels--)
+			expire_timers(base, heads + levels);
 	}
 	base->running_timer = NULL;
 	spin_unlock_irq(&base->lock);
@@ -1237,74 +1346,67 @@ static inline void __run_timers(struct tvec_base *base)
  * is used on S/390 to stop all activity when a CPU is idle.
  * This function needs to be called with interrupts disabled.
  */
+static bool bucket_has_active(struct tvec_base *base, unsigned int idx)
+{
+	struct timer_list *timer;
+
+	list_for_each_entry(timer, base->vectors + idx, entry)
+		if (!tbase_get_deferrable(timer->base))
+			return true;
+	return false;
+}
+
+/*
+ * Search the buckets of one level, starting at @clk, for the first one
+ * holding a timer that is not deferrable. Returns the distance from @clk
+ * in buckets, or -1 if there is none.
+ */
+static int next_pending_bucket(struct tvec_base *base, unsigned int offset,
+			       unsigned int clk)
+{
+	unsigned int pos, start = offset + clk;
+	unsigned int end = offset + LVL_SIZE;
+
+	for (pos = find_next_bit(base->pending_map, end, start); pos < end;
+	     pos = find_next_bit(base->pending_map, end, pos + 1))
+		if (bucket_has_active(base, pos))
+			return pos - start;
+
+	for (pos = find_next_bit(base->pending_map, start, offset); pos < start;
+	     pos = find_next_bit(base->pending_map, start, pos + 1))
+		if (bucket_has_active(base, pos))
+			return pos + LVL_SIZE - start;
+
+	return -1;
+}
+
 static unsigned long __next_timer_interrupt(struct tvec_base *base)
 {
-	unsigned long timer_jiffies = base->timer_jiffies;
-	unsigned long expires = timer_jiffies + NEXT_TIMER_MAX_DELTA;
-	int index, slot, array, found = 0;
-	struct timer_list *nte;
-	struct tvec *varray[4];
-
-	/* Look for timer events in tv1. */
-	index = slot = timer_jiffies & TVR_MASK;
-	do {
-		list_for_each_entry(nte, base->tv1.vec + slot, entry) {
-			if (tbase_get_deferrable(nte->base))
-				continue;
-
-			found = 1;
-			expires = nte->expires;
-			/* Look at the cascade bucket(s)? */
-			if (!index || slot < index)
-				goto cascade;
-			return expires;
+	unsigned long clk = base->timer_jiffies;
+	unsigned long next = clk + NEXT_TIMER_MAX_DELTA;
+	unsigned int lvl, offset = 0;
+	unsigned long adj;
+
+	for (lvl = 0; lvl < LVL_DEPTH; lvl++, offset += LVL_SIZE) {
+		int pos = next_pending_bucket(base, offset, clk & LVL_MASK);
+
+		if (pos >= 0) {
+			unsigned long tmp = clk + (unsigned long) pos;
+
+			tmp <<= LVL_SHIFT(lvl);
+			if (time_before(tmp, next))
+				next = tmp;
 		}
-		slot = (slot + 1) & TVR_MASK;
-	} while (slot != index);
-
-cascade:
-	/* Calculate the next cascade event */
-	if (index)
-		timer_jiffies += TVR_SIZE - index;
-	timer_jiffies >>= TVR_BITS;
-
-	/* Check tv2-tv5. */
-	varray[0] = &base->tv2;
-	varray[1] = &base->tv3;
-	varray[2] = &base->tv4;
-	varray[3] = &base->tv5;
-
-	for (array = 0; array < 4; array++) {
-		struct tvec *varp = varray[array];
-
-		index = slot = timer_jiffies & TVN_MASK;
-		do {
-			list_for_each_entry(nte, varp->vec + slot, entry) {
-				if (tbase_get_deferrable(nte->base))
-					continue;
-
-				found = 1;
-				if (time_before(nte->expires, expires))
-					expires = nte->expires;
-			}
-			/*
-			 * Do we still search for the first timer or are
-			 * we looking up the cascade buckets ?
-			 */
-			if (found) {
-				/* Look at the cascade bucket(s)? */
-				if (!index || slot < index)
-					break;
-				return expires;
-			}
-			slot = (slot + 1) & TVN_MASK;
-		} while (slot != index);
-
-		if (index)
-			timer_jiffies += TVN_SIZE - index;
-		timer_jiffies >>= TVN_BITS;
+		/*
+		 * If this level's clock is not at a bucket boundary of
+		 * the next level, the current bucket of the next level
+		 * has been run already.
+		 */
+		adj = clk & LVL_CLK_MASK ? 1 : 0;
+		clk >>= LVL_CLK_SHIFT;
+		clk += adj;
 	}
-	return expires;
+	return next;
 }
 
 /*
@@ -1505,7 +1607,7 @@ signed long __sched schedule_timeout(signed long timeout)
 	expire = timeout + jiffies;
 
 	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
-	__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
+	__mod_timer(&timer, expire, 0, TIMER_NOT_PINNED);
 	schedule();
 	del_singleshot_timer_sync(&timer);
 
@@ -1576,14 +1678,9 @@ static void migrate_timers(int cpu)
 
 	BUG_ON(old_base->running_timer);
 
-	for (i = 0; i < TVR_SIZE; i++)
-		migrate_timer_list(new_base, old_base->tv1.vec + i);
-	for (i = 0; i < TVN_SIZE; i++) {
-		migrate_timer_list(new_base, old_base->tv2.vec + i);
-		migrate_timer_list(new_base, old_base->tv3.vec + i);
-		migrate_timer_list(new_base, old_base->tv4.vec + i);
-		migrate_timer_list(new_base, old_base->tv5.vec + i);
-	}
+	for (i = 0; i < WHEEL_SIZE; i++)
+		migrate_timer_list(new_base, old_base->vectors + i);
+	bitmap_zero(old_base->pending_map, WHEEL_SIZE);
 
 	old_base->active_timers = 0;
 	old_base->all_timers = 0;
@@ -1626,14 +1723,8 @@ static void __init init_timer_cpu(struct tvec_base *base, int cpu)
 	per_cpu(tvec_bases, cpu) = base;
 	spin_lock_init(&base->lock);
 
-	for (j = 0; j < TVN_SIZE; j++) {
-		INIT_LIST_HEAD(base->tv5.vec + j);
-		INIT_LIST_HEAD(base->tv4.vec + j);
-		INIT_LIST_HEAD(base->tv3.vec + j);
-		INIT_LIST_HEAD(base->tv2.vec + j);
-	}
-	for (j = 0; j < TVR_SIZE; j++)
-		INIT_LIST_HEAD(base->tv1.vec + j);
+	for (j = 0; j < WHEEL_SIZE; j++)
+		INIT_LIST_HEAD(base->vectors + j);
 
 	base->timer_jiffies = jiffies;
 	base->next_timer = base->timer_jiffies;
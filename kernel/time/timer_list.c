@@ -135,6 +135,15 @@ print_base(struct seq_file *m, struct hrtimer_clock_base *base, u64 now)
 	print_active_timers(m, base, now);
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+static const char * const tick_dep_names[TICK_DEP_NR] = {
+	[TICK_DEP_BIT_SCHED]		= "sched",
+	[TICK_DEP_BIT_POSIX_TIMER]	= "posix",
+	[TICK_DEP_BIT_PERF_EVENTS]	= "perf",
+	[TICK_DEP_BIT_CLOCK_UNSTABLE]	= "clock",
+};
+#endif
+
 static void print_cpu(struct seq_file *m, int cpu, u64 now)
 {
 	struct hrtimer_cpu_base *cpu_base = &per_cpu(hrtimer_bases, cpu);
@@ -186,6 +195,19 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 		P(last_jiffies);
 		P(next_jiffies);
 		P_ns(idle_expires);
+#ifdef CONFIG_NO_HZ_FULL
+		if (tick_nohz_full_cpu(cpu)) {
+			int dep;
+
+			P(tick_restarts);
+			for (dep = 0; dep < TICK_DEP_NR; dep++)
+				SEQ_printf(m, "  .tick_dep_%-6s: %Lu\n",
+					   tick_dep_names[dep],
+					   (unsigned long long)ts->tick_dep_count[dep]);
+			SEQ_printf(m, "  .%-15s: %s\n", "tick_dep_last",
+				   tick_dep_names[ts->tick_dep_last]);
+		}
+#endif
 		SEQ_printf(m, "jiffies: %Lu\n",
 			   (unsigned long long)jiffies);
 	}
@@ -282,7 +304,7 @@ static void timer_list_show_tickdevices_header(struct seq_file *m)
 
 static inline void timer_list_header(struct seq_file *m, u64 now)
 {
-	SEQ_printf(m, "Timer List Version: v0.7\n");
+	SEQ_printf(m, "Timer List Version: v0.8\n");
 	SEQ_printf(m, "HRTIMER_MAX_CLOCK_BASES: %d\n", HRTIMER_MAX_CLOCK_BASES);
 	SEQ_printf(m, "now at %Ld nsecs\n", (unsigned long long)now);
 	SEQ_printf(m, "\n");
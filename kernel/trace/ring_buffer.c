@@ -6,6 +6,7 @@
 #include <linux/ftrace_event.h>
 #include <linux/ring_buffer.h>
 #include <linux/trace_clock.h>
+#include <linux/trace_mmap.h>
 #include <linux/trace_seq.h>
 #include <linux/spinlock.h>
 #include <linux/irq_work.h>
@@ -352,6 +353,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* ID for external mapping */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -487,6 +489,12 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mapping, see ring_buffer_map() */
+	struct mutex			mapping_lock;
+	unsigned long			*subbuf_ids;	/* ID to subbuf addr */
+	struct trace_buffer_meta	*meta_page;
+	int				mapped;
 };
 
 struct ring_buffer {
@@ -1247,6 +1255,7 @@ rb_allocate_cpu_buffer(struct ring_buffer *buffer, int nr_pages, int cpu)
 	init_irq_work(&cpu_buffer->irq_work.work, rb_wake_up_waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.full_waiters);
+	mutex_init(&cpu_buffer->mapping_lock);
 
 	bpage = kzalloc_node(ALIGN(sizeof(*bpage), cache_line_size()),
 			    GFP_KERNEL, cpu_to_node(cpu));
@@ -4162,6 +4171,19 @@ unsigned long ring_buffer_size(struct ring_buffer *buffer, int cpu)
 }
 EXPORT_SYMBOL_GPL(ring_buffer_size);
 
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->reader.read = cpu_buffer->reader_page->read;
+	meta->reader.id = cpu_buffer->reader_page->id;
+	meta->reader.lost_events = cpu_buffer->lost_events;
+
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+}
+
 static void
 rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 {
@@ -4234,6 +4256,9 @@ void ring_buffer_reset_cpu(struct ring_buffer *buffer, int cpu)
 
 	arch_spin_unlock(&cpu_buffer->lock);
 
+	if (cpu_buffer->mapped)
+		rb_update_meta_page(cpu_buffer);
+
  out:
 	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
 
@@ -4347,6 +4372,11 @@ int ring_buffer_swap_cpu(struct ring_buffer *buffer_a,
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
 
+	/* A mapped buffer must stay where user space expects it */
+	ret = -EBUSY;
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped)
+		goto out;
+
 	ret = -EAGAIN;
 
 	if (ring_buffer_flags != RB_BUFFERS_ON)
@@ -4526,12 +4556,14 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 	/*
 	 * If this page has been partially read or
 	 * if len is not big enough to read the rest of the page or
-	 * a writer is still on the page, then
+	 * a writer is still on the page or
+	 * the buffer is mapped to user space, then
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
 	if (read || (len < (commit - read)) ||
-	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
+	    cpu_buffer->reader_page == cpu_buffer->commit_page ||
+	    cpu_buffer->mapped) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
 		unsigned int pos = 0;
@@ -4640,6 +4672,247 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+/*
+ * Give every sub-buffer an ID, the reader page being 0 and the others
+ * following in ring order from the head page, and fill in the static
+ * part of the meta page.  The IDs never change while the buffer is
+ * mapped: the reader swap exchanges buffer_pages, which keep their
+ * data page, and resizing and swapping are refused.
+ */
+static void rb_setup_ids_meta_page(struct ring_buffer_per_cpu *cpu_buffer,
+				   unsigned long *subbuf_ids)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+	struct buffer_page *first_subbuf, *subbuf;
+	int id = 0;
+
+	cpu_buffer->subbuf_ids = subbuf_ids;
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->nr_subbufs = cpu_buffer->nr_pages + 1;
+	meta->subbuf_size = PAGE_SIZE;
+
+	subbuf_ids[id] = (unsigned long)cpu_buffer->reader_page->page;
+	cpu_buffer->reader_page->id = id++;
+
+	/* In case of error, head will be NULL and only the reader is mapped */
+	first_subbuf = subbuf = rb_set_head_page(cpu_buffer);
+	while (subbuf) {
+		if (RB_WARN_ON(cpu_buffer, id > cpu_buffer->nr_pages))
+			break;
+
+		subbuf_ids[id] = (unsigned long)subbuf->page;
+		subbuf->id = id;
+
+		rb_inc_page(cpu_buffer, &subbuf);
+		id++;
+		if (subbuf == first_subbuf)
+			break;
+	}
+
+	rb_update_meta_page(cpu_buffer);
+}
+
+/**
+ * ring_buffer_map - prepare a per cpu buffer to be mapped to user space
+ * @buffer: the buffer to map
+ * @cpu: the cpu buffer to map
+ *
+ * Sets up the meta page and the sub-buffer IDs used by
+ * ring_buffer_map_page().  While a per cpu buffer is mapped it can not
+ * be resized or swapped, and ring_buffer_read_page() always copies.
+ * Mappings are counted; each successful call must be paired with
+ * ring_buffer_unmap().
+ *
+ * Returns 0 on success, negative errno otherwise.
+ */
+int ring_buffer_map(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long flags, *subbuf_ids;
+	void *meta;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (cpu_buffer->mapped) {
+		if (WARN_ON(cpu_buffer->mapped == INT_MAX))
+			ret = -EBUSY;
+		else
+			cpu_buffer->mapped++;
+		goto unlock;
+	}
+
+	/* prevent another thread from changing buffer sizes */
+	mutex_lock(&buffer->mutex);
+
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	meta = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!subbuf_ids || !meta) {
+		kfree(subbuf_ids);
+		free_page((unsigned long)meta);
+		ret = -ENOMEM;
+		goto unlock_resize;
+	}
+
+	atomic_inc(&buffer->resize_disabled);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->meta_page = meta;
+	rb_setup_ids_meta_page(cpu_buffer, subbuf_ids);
+	cpu_buffer->mapped = 1;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+ unlock_resize:
+	mutex_unlock(&buffer->mutex);
+ unlock:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_unmap - drop a user space mapping of a per cpu buffer
+ * @buffer: the buffer to unmap
+ * @cpu: the cpu buffer to unmap
+ *
+ * Releases the meta page once the last mapping is gone.
+ */
+void ring_buffer_unmap(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long flags;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (RB_WARN_ON(cpu_buffer, !cpu_buffer->mapped))
+		goto out;
+
+	if (--cpu_buffer->mapped)
+		goto out;
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	free_page((unsigned long)cpu_buffer->meta_page);
+	cpu_buffer->meta_page = NULL;
+	kfree(cpu_buffer->subbuf_ids);
+	cpu_buffer->subbuf_ids = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	atomic_dec(&buffer->resize_disabled);
+ out:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_page - get a page of a mapped per cpu buffer
+ * @buffer: the mapped buffer
+ * @cpu: the cpu buffer
+ * @pgoff: page offset within the mapping
+ *
+ * Offset 0 is the meta page, offset N is the sub-buffer with ID N - 1.
+ * The caller must hold a mapping (see ring_buffer_map()).
+ *
+ * Returns the page, or NULL if @pgoff is out of range.
+ */
+struct page *ring_buffer_map_page(struct ring_buffer *buffer, int cpu,
+				  unsigned long pgoff)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return NULL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	if (RB_WARN_ON(cpu_buffer, !cpu_buffer->mapped))
+		return NULL;
+
+	if (!pgoff)
+		return virt_to_page(cpu_buffer->meta_page);
+
+	if (pgoff > cpu_buffer->nr_pages + 1 ||
+	    !cpu_buffer->subbuf_ids[pgoff - 1])
+		return NULL;
+
+	return virt_to_page((void *)cpu_buffer->subbuf_ids[pgoff - 1]);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_page);
+
+/**
+ * ring_buffer_map_get_reader - consume the mapped reader page
+ * @buffer: the mapped buffer
+ * @cpu: the cpu buffer
+ *
+ * The mapped reader is what user space consumes in place.  If it still
+ * has unread data, all of it is marked as read and the page is kept,
+ * as the writer may still be adding to it and the user has to be able
+ * to pick that up.  Otherwise the next page with data, if any, is
+ * swapped in.  Either way the meta page is brought up to date.
+ *
+ * Returns 0 on success, -EINVAL if the cpu buffer is not mapped.
+ */
+int ring_buffer_map_get_reader(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long reader_size;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (!cpu_buffer->mapped) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (rb_per_cpu_empty(cpu_buffer))
+		goto update;
+
+	reader_size = rb_page_size(cpu_buffer->reader_page);
+	if (cpu_buffer->reader_page->read < reader_size) {
+		while (cpu_buffer->reader_page->read < reader_size)
+			rb_advance_reader(cpu_buffer);
+		goto update;
+	}
+
+	/* The reader is fully consumed, this swaps in the next page */
+	if (RB_WARN_ON(cpu_buffer, !rb_get_reader_page(cpu_buffer)))
+		goto update;
+
+ update:
+	/*
+	 * Events lost before the new reader are reported through the
+	 * meta page rather than flagged in the page's commit, which the
+	 * reader side of this buffer still relies on.
+	 */
+	rb_update_meta_page(cpu_buffer);
+	cpu_buffer->lost_events = 0;
+ out:
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 #ifdef CONFIG_HOTPLUG_CPU
 static int rb_cpu_notify(struct notifier_block *self,
 			 unsigned long action, void *hcpu)
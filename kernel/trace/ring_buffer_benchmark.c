@@ -4,6 +4,7 @@
  * Copyright (C) 2009 Steven Rostedt <srostedt@redhat.com>
  */
 #include <linux/ring_buffer.h>
+#include <linux/trace_mmap.h>
 #include <linux/completion.h>
 #include <linux/kthread.h>
 #include <linux/module.h>
@@ -36,6 +37,10 @@ static int disable_reader;
 module_param(disable_reader, uint, 0644);
 MODULE_PARM_DESC(disable_reader, "only run producer");
 
+static int read_mapped;
+module_param(read_mapped, uint, 0644);
+MODULE_PARM_DESC(read_mapped, "consume through the mapped reader pages");
+
 static int write_iteration = 50;
 module_param(write_iteration, uint, 0644);
 MODULE_PARM_DESC(write_iteration, "# of writes between timestamp readings");
@@ -75,6 +80,18 @@ enum event_status {
 	EVENT_DROPPED,
 };
 
+/*
+ * What a user space reader of trace_pipe_raw's mmap() would keep: the
+ * meta page, and the reader sub-buffer and how far into it we got.
+ */
+struct mapped_reader {
+	struct trace_buffer_meta	*meta;
+	unsigned int			id;
+	unsigned int			pos;
+};
+
+static DEFINE_PER_CPU(struct mapped_reader, mapped_readers);
+
 static enum event_status read_event(int cpu)
 {
 	struct ring_buffer_event *event;
@@ -95,16 +112,71 @@ static enum event_status read_event(int cpu)
 	return EVENT_FOUND;
 }
 
-static enum event_status read_page(int cpu)
+static void read_rb_page(int cpu, struct rb_page *rpage, unsigned long start,
+			 unsigned long commit)
 {
 	struct ring_buffer_event *event;
+	unsigned long i;
+	int *entry;
+	int inc;
+
+	for (i = start; i < commit && !kill_test; i += inc) {
+
+		if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
+			KILL_TEST();
+			break;
+		}
+
+		inc = -1;
+		event = (void *)&rpage->data[i];
+		switch (event->type_len) {
+		case RINGBUF_TYPE_PADDING:
+			/* failed writes may be discarded events */
+			if (!event->time_delta)
+				KILL_TEST();
+			inc = event->array[0] + 4;
+			break;
+		case RINGBUF_TYPE_TIME_EXTEND:
+			inc = 8;
+			break;
+		case 0:
+			entry = ring_buffer_event_data(event);
+			if (*entry != cpu) {
+				KILL_TEST();
+				break;
+			}
+			read++;
+			if (!event->array[0]) {
+				KILL_TEST();
+				break;
+			}
+			inc = event->array[0] + 4;
+			break;
+		default:
+			entry = ring_buffer_event_data(event);
+			if (*entry != cpu) {
+				KILL_TEST();
+				break;
+			}
+			read++;
+			inc = ((event->type_len + 1) * 4);
+		}
+		if (kill_test)
+			break;
+
+		if (inc <= 0) {
+			KILL_TEST();
+			break;
+		}
+	}
+}
+
+static enum event_status read_page(int cpu)
+{
 	struct rb_page *rpage;
 	unsigned long commit;
 	void *bpage;
-	int *entry;
 	int ret;
-	int inc;
-	int i;
 
 	bpage = ring_buffer_alloc_read_page(buffer, cpu);
 	if (!bpage)
@@ -115,67 +187,67 @@ static enum event_status read_page(int cpu)
 		rpage = bpage;
 		/* The commit may have missed event flags set, clear them */
 		commit = local_read(&rpage->commit) & 0xfffff;
-		for (i = 0; i < commit && !kill_test; i += inc) {
+		read_rb_page(cpu, rpage, 0, commit);
+	}
+	ring_buffer_free_read_page(buffer, bpage);
 
-			if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
-				KILL_TEST();
-				break;
-			}
+	if (ret < 0)
+		return EVENT_DROPPED;
+	return EVENT_FOUND;
+}
 
-			inc = -1;
-			event = (void *)&rpage->data[i];
-			switch (event->type_len) {
-			case RINGBUF_TYPE_PADDING:
-				/* failed writes may be discarded events */
-				if (!event->time_delta)
-					KILL_TEST();
-				inc = event->array[0] + 4;
-				break;
-			case RINGBUF_TYPE_TIME_EXTEND:
-				inc = 8;
-				break;
-			case 0:
-				entry = ring_buffer_event_data(event);
-				if (*entry != cpu) {
-					KILL_TEST();
-					break;
-				}
-				read++;
-				if (!event->array[0]) {
-					KILL_TEST();
-					break;
-				}
-				inc = event->array[0] + 4;
-				break;
-			default:
-				entry = ring_buffer_event_data(event);
-				if (*entry != cpu) {
-					KILL_TEST();
-					break;
-				}
-				read++;
-				inc = ((event->type_len + 1) * 4);
-			}
-			if (kill_test)
-				break;
+/*
+ * Consume the reader page in place, the way a user space reader of the
+ * mapping does it: parse from where we left off up to the commit, then
+ * hand it back and let the kernel tell us where to go next.
+ */
+static enum event_status read_mapped_page(int cpu)
+{
+	struct mapped_reader *mr = &per_cpu(mapped_readers, cpu);
+	struct rb_page *rpage;
+	unsigned long commit;
+	struct page *page;
 
-			if (inc <= 0) {
-				KILL_TEST();
-				break;
-			}
-		}
+	if (!mr->meta || ring_buffer_map_get_reader(buffer, cpu) < 0)
+		return EVENT_DROPPED;
+
+	if (mr->meta->reader.id != mr->id) {
+		mr->id = mr->meta->reader.id;
+		mr->pos = mr->meta->reader.read;
 	}
-	ring_buffer_free_read_page(buffer, bpage);
 
-	if (ret < 0)
+	page = ring_buffer_map_page(buffer, cpu, mr->id + 1);
+	if (!page) {
+		KILL_TEST();
+		return EVENT_DROPPED;
+	}
+
+	rpage = page_address(page);
+	commit = local_read(&rpage->commit);
+	/* read the commit before the data it covers */
+	smp_rmb();
+
+	if (mr->pos >= commit)
 		return EVENT_DROPPED;
+
+	read_rb_page(cpu, rpage, mr->pos, commit);
+	mr->pos = commit;
+
 	return EVENT_FOUND;
 }
 
 static void ring_buffer_consumer(void)
 {
-	/* toggle between reading pages and events */
-	read_events ^= 1;
+	int cpu;
+
+	if (read_mapped) {
+		/* the buffer was reset, start over from its reader page */
+		for_each_possible_cpu(cpu)
+			per_cpu(mapped_readers, cpu).id = UINT_MAX;
+	} else {
+		/* toggle between reading pages and events */
+		read_events ^= 1;
+	}
 
 	read = 0;
 	while (!reader_finish && !kill_test) {
@@ -188,7 +260,9 @@ static void ring_buffer_consumer(void)
 			for_each_online_cpu(cpu) {
 				enum event_status stat;
 
-				if (read_events)
+				if (read_mapped)
+					stat = read_mapped_page(cpu);
+				else if (read_events)
 					stat = read_event(cpu);
 				else
 					stat = read_page(cpu);
@@ -314,6 +388,7 @@ static void ring_buffer_producer(void)
 		trace_printk("Read:     (reader disabled)\n");
 	else
 		trace_printk("Read:     %ld  (by %s)\n", read,
+			read_mapped ? "mapped pages" :
 			read_events ? "events" : "pages");
 	trace_printk("Entries:  %lld\n", entries);
 	trace_printk("Total:    %lld\n", entries + overruns + read);
@@ -411,6 +486,37 @@ static int ring_buffer_producer_thread(void *arg)
 	return 0;
 }
 
+static void unmap_buffers(void)
+{
+	struct mapped_reader *mr;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		mr = &per_cpu(mapped_readers, cpu);
+		if (!mr->meta)
+			continue;
+		ring_buffer_unmap(buffer, cpu);
+		mr->meta = NULL;
+	}
+}
+
+static int map_buffers(void)
+{
+	int cpu, ret;
+
+	for_each_online_cpu(cpu) {
+		ret = ring_buffer_map(buffer, cpu);
+		if (ret) {
+			unmap_buffers();
+			return ret;
+		}
+		per_cpu(mapped_readers, cpu).meta =
+			page_address(ring_buffer_map_page(buffer, cpu, 0));
+	}
+
+	return 0;
+}
+
 static int __init ring_buffer_benchmark_init(void)
 {
 	int ret;
@@ -420,6 +526,12 @@ static int __init ring_buffer_benchmark_init(void)
 	if (!buffer)
 		return -ENOMEM;
 
+	if (read_mapped && !disable_reader) {
+		ret = map_buffers();
+		if (ret)
+			goto out_fail;
+	}
+
 	if (!disable_reader) {
 		consumer = kthread_create(ring_buffer_consumer_thread,
 					  NULL, "rb_consumer");
@@ -463,6 +575,7 @@ static int __init ring_buffer_benchmark_init(void)
 		kthread_stop(consumer);
 
  out_fail:
+	unmap_buffers();
 	ring_buffer_free(buffer);
 	return ret;
 }
@@ -472,6 +585,7 @@ static void __exit ring_buffer_benchmark_exit(void)
 	kthread_stop(producer);
 	if (consumer)
 		kthread_stop(consumer);
+	unmap_buffers();
 	ring_buffer_free(buffer);
 }
 
@@ -12,6 +12,7 @@
  *  Copyright (C) 2004 Nadia Yvette Chambers
  */
 #include <linux/ring_buffer.h>
+#include <linux/trace_mmap.h>
 #include <generated/utsrelease.h>
 #include <linux/stacktrace.h>
 #include <linux/writeback.h>
@@ -644,6 +645,7 @@ EXPORT_SYMBOL_GPL(tracing_snapshot);
 static int resize_buffer_duplicate_size(struct trace_buffer *trace_buf,
 					struct trace_buffer *size_buf, int cpu_id);
 static void set_buffer_entries(struct trace_buffer *buf, unsigned long val);
+static void free_snapshot(struct trace_array *tr);
 
 static int alloc_snapshot(struct trace_array *tr)
 {
@@ -651,6 +653,10 @@ static int alloc_snapshot(struct trace_array *tr)
 
 	if (!tr->allocated_snapshot) {
 
+		/* a mapped buffer can't be swapped with the snapshot */
+		if (atomic_read(&tr->mapped))
+			return -EBUSY;
+
 		/* allocate spare buffer */
 		ret = resize_buffer_duplicate_size(&tr->max_buffer,
 				   &tr->trace_buffer, RING_BUFFER_ALL_CPUS);
@@ -658,6 +664,13 @@ static int alloc_snapshot(struct trace_array *tr)
 			return ret;
 
 		tr->allocated_snapshot = true;
+
+		/* pairs with the barrier in tracing_buffers_mmap() */
+		smp_mb();
+		if (atomic_read(&tr->mapped)) {
+			free_snapshot(tr);
+			return -EBUSY;
+		}
 	}
 
 	return 0;
@@ -5815,12 +5828,111 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	return ret;
 }
 
+static long tracing_buffers_ioctl(struct file *file, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct ftrace_buffer_info *info = file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOTTY;
+
+	return ring_buffer_map_get_reader(iter->trace_buffer->buffer,
+					  iter->cpu_file);
+}
+
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	/* The buffer is already mapped, this only takes a reference */
+	WARN_ON(ring_buffer_map(iter->trace_buffer->buffer, iter->cpu_file));
+	atomic_inc(&iter->tr->mapped);
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	ring_buffer_unmap(iter->trace_buffer->buffer, iter->cpu_file);
+	atomic_dec(&iter->tr->mapped);
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+};
+
+/*
+ * Map the meta page and the sub-buffers of a per cpu buffer read-only,
+ * see include/uapi/linux/trace_mmap.h for the layout.
+ */
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	struct ring_buffer *buffer = iter->trace_buffer->buffer;
+	unsigned long i, nr_pages = vma_pages(vma);
+	struct page *page;
+	int ret;
+
+	if (vma->vm_flags & (VM_WRITE | VM_EXEC))
+		return -EPERM;
+
+	/*
+	 * The snapshot swaps the buffers underneath us.  Taking
+	 * trace_types_lock here would nest it inside mmap_sem, so
+	 * alloc_snapshot() and this check each other instead.
+	 */
+	atomic_inc(&iter->tr->mapped);
+#ifdef CONFIG_TRACER_MAX_TRACE
+	smp_mb();
+	if (iter->tr->allocated_snapshot) {
+		atomic_dec(&iter->tr->mapped);
+		return -EBUSY;
+	}
+#endif
+
+	ret = ring_buffer_map(buffer, iter->cpu_file);
+	if (ret) {
+		atomic_dec(&iter->tr->mapped);
+		return ret;
+	}
+
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_ops = &tracing_buffers_vmops;
+
+	for (i = 0; i < nr_pages; i++) {
+		page = ring_buffer_map_page(buffer, iter->cpu_file,
+					    vma->vm_pgoff + i);
+		if (!page) {
+			ret = -EINVAL;
+			break;
+		}
+
+		ret = vm_insert_page(vma, vma->vm_start + i * PAGE_SIZE, page);
+		if (ret)
+			break;
+	}
+
+	/* A failed mmap() does not call ->close() */
+	if (ret)
+		tracing_buffers_mmap_close(vma);
+
+	return ret;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.poll		= tracing_buffers_poll,
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
+	.unlocked_ioctl	= tracing_buffers_ioctl,
+	.mmap		= tracing_buffers_mmap,
 	.llseek		= no_llseek,
 };
 
@@ -297,6 +297,42 @@ void *perf_trace_buf_prepare(int size, unsigned short type,
 EXPORT_SYMBOL_GPL(perf_trace_buf_prepare);
 NOKPROBE_SYMBOL(perf_trace_buf_prepare);
 
+/*
+ * Run the BPF program attached to a tracepoint, if any, and hand the
+ * record to perf unless the program filtered it out.  The program gets
+ * the record as its context, so it reads the event's fields at the
+ * offsets given in the format file.  The first sizeof(void *) bytes,
+ * part of the common fields, hold the regs for the helpers to use in
+ * the meantime and are restored before the record goes out.
+ */
+void perf_trace_run_bpf_submit(void *raw_data, int size, int rctx,
+			       struct ftrace_event_call *call, u64 addr,
+			       u64 count, struct pt_regs *regs,
+			       struct hlist_head *head,
+			       struct task_struct *task)
+{
+	struct bpf_prog *prog = call->prog;
+	struct trace_entry saved;
+
+	BUILD_BUG_ON(sizeof(struct trace_entry) < sizeof(void *));
+
+	if (prog) {
+		saved = *(struct trace_entry *)raw_data;
+		*(struct pt_regs **)raw_data = regs;
+
+		if (!trace_call_bpf(prog, raw_data) || hlist_empty(head)) {
+			perf_swevent_put_recursion_context(rctx);
+			return;
+		}
+
+		*(struct trace_entry *)raw_data = saved;
+	}
+
+	perf_tp_event(addr, count, raw_data, size, regs, head, rctx, task);
+}
+EXPORT_SYMBOL_GPL(perf_trace_run_bpf_submit);
+NOKPROBE_SYMBOL(perf_trace_run_bpf_submit);
+
 #ifdef CONFIG_FUNCTION_TRACER
 static void
 perf_ftrace_function_call(unsigned long ip, unsigned long parent_ip,
@@ -0,0 +1,2378 @@
+/*
+ * trace_events_hist - trace event hist triggers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A hist trigger aggregates the events it sees into a tracing_map
+ * keyed on one or more event fields, summing a hitcount and any
+ * requested value fields per key.  The result is read back from the
+ * event's 'hist' file, so nothing has to go through the ring buffer:
+ *
+ *   hist:keys=<field1[,field2]>[:values=<field1[,field2,...]>]
+ *     [:sort=<field1[,field2]>][:size=#entries][:pause][:cont]
+ *     [:clear] [if <filter>]
+ *
+ * A key may be suffixed with .hex, .sym or .log2; .log2 buckets the
+ * key by power of two, which is what latency distributions want.
+ * Sort fields may be suffixed with .descending or .ascending.
+ *
+ * A trigger can also save values per key in variables, and a trigger
+ * on a later event can pick them up by looking up the same key in the
+ * first trigger's map.  That is how the time between two related
+ * events is measured without post-processing:
+ *
+ *   :<var>=<field|common_timestamp[.usecs]|$var>[-<field|...|$var>]
+ *   :onmatch(<system>.<event>).trace(<synthetic event>[,<param>,...])
+ *
+ * $var names a variable set earlier in the same trigger or, failing
+ * that, one set by the trigger on the onmatch() event.  The latter is
+ * consumed on use; if any of them isn't set for the current key, the
+ * event is ignored.  Otherwise the trace() action logs a synthetic
+ * event, created beforehand through the 'synthetic_events' file, with
+ * the given fields or variables as its parameters.
+ */
+
+#include <linux/module.h>
+#include <linux/kallsyms.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/tracefs.h>
+#include <linux/uaccess.h>
+
+#include "tracing_map.h"
+#include "trace.h"
+
+struct hist_field;
+struct hist_trigger_data;
+
+typedef u64 (*hist_field_fn_t) (struct hist_field *field, void *event);
+
+struct hist_field {
+	struct ftrace_event_field	*field;
+	unsigned long			flags;
+	hist_field_fn_t			fn;
+	unsigned int			size;
+	unsigned int			offset;
+	struct hist_trigger_data	*hist_data;
+};
+
+static u64 hist_field_counter(struct hist_field *field, void *event)
+{
+	return 1;
+}
+
+static u64 hist_field_string(struct hist_field *hist_field, void *event)
+{
+	char *addr = (char *)(event + hist_field->field->offset);
+
+	return (u64)(unsigned long)addr;
+}
+
+static u64 hist_field_dynstring(struct hist_field *hist_field, void *event)
+{
+	u32 str_item = *(u32 *)(event + hist_field->field->offset);
+	int str_loc = str_item & 0xffff;
+	char *addr = (char *)(event + str_loc);
+
+	return (u64)(unsigned long)addr;
+}
+
+static u64 hist_field_pstring(struct hist_field *hist_field, void *event)
+{
+	char **addr = (char **)(event + hist_field->field->offset);
+
+	return (u64)(unsigned long)*addr;
+}
+
+static u64 hist_field_timestamp(struct hist_field *hist_field, void *event);
+
+#define DEFINE_HIST_FIELD_FN(type)					\
+static u64 hist_field_##type(struct hist_field *hist_field, void *event)\
+{									\
+	type *addr = (type *)(event + hist_field->field->offset);	\
+									\
+	return (u64)*addr;						\
+}
+
+DEFINE_HIST_FIELD_FN(s64);
+DEFINE_HIST_FIELD_FN(u64);
+DEFINE_HIST_FIELD_FN(s32);
+DEFINE_HIST_FIELD_FN(u32);
+DEFINE_HIST_FIELD_FN(s16);
+DEFINE_HIST_FIELD_FN(u16);
+DEFINE_HIST_FIELD_FN(s8);
+DEFINE_HIST_FIELD_FN(u8);
+
+#define for_each_hist_field(i, hist_data)	\
+	for ((i) = 0; (i) < (hist_data)->n_fields; (i)++)
+
+#define for_each_hist_val_field(i, hist_data)	\
+	for ((i) = 0; (i) < (hist_data)->n_vals; (i)++)
+
+#define for_each_hist_key_field(i, hist_data)	\
+	for ((i) = (hist_data)->n_vals; (i) < (hist_data)->n_fields; (i)++)
+
+#define HITCOUNT_IDX		0
+#define HIST_KEY_SIZE_MAX	MAX_FILTER_STR_VAL
+#define HIST_DYN_STR_SIZE	64
+#define HIST_VAR_REFS_MAX	TRACING_MAP_VARS_MAX
+
+#define SYNTH_SYSTEM		"synthetic"
+#define SYNTH_FIELDS_MAX	16
+
+enum hist_field_flags {
+	HIST_FIELD_FL_HITCOUNT		= 1,
+	HIST_FIELD_FL_KEY		= 2,
+	HIST_FIELD_FL_STRING		= 4,
+	HIST_FIELD_FL_HEX		= 8,
+	HIST_FIELD_FL_SYM		= 16,
+	HIST_FIELD_FL_LOG2		= 32,
+	HIST_FIELD_FL_TIMESTAMP		= 64,
+	HIST_FIELD_FL_TIMESTAMP_USECS	= 128,
+};
+
+struct hist_trigger_attrs {
+	char		*keys_str;
+	char		*vals_str;
+	char		*sort_key_str;
+	char		*assignment_str[TRACING_MAP_VARS_MAX];
+	unsigned int	n_assignments;
+	char		*onmatch_str;
+	bool		pause;
+	bool		cont;
+	bool		clear;
+	unsigned int	map_bits;
+};
+
+enum hist_operand_type {
+	HIST_OPERAND_FIELD,
+	HIST_OPERAND_VAR,	/* a variable set earlier by this trigger */
+	HIST_OPERAND_VAR_REF,	/* a variable set by the onmatch() trigger */
+};
+
+struct hist_operand {
+	enum hist_operand_type	type;
+	struct hist_field	*field;
+	unsigned int		idx;
+};
+
+/* Either a single operand or the difference of two */
+struct hist_expr {
+	struct hist_operand	operands[2];
+	unsigned int		n_operands;
+};
+
+/* vars[i] of a hist trigger is variable i of its tracing_map */
+struct hist_var {
+	char			*name;
+	struct hist_expr	expr;
+};
+
+struct synth_event;
+
+struct hist_action {
+	char				*match_system;
+	char				*match_event;
+	char				*synth_name;
+	char				*param_str[SYNTH_FIELDS_MAX];
+	struct hist_operand		params[SYNTH_FIELDS_MAX];
+	unsigned int			n_params;
+	struct synth_event		*synth_event;
+	struct ftrace_event_file	*synth_file;
+};
+
+struct hist_trigger_data {
+	struct hist_field		*fields[TRACING_MAP_FIELDS_MAX];
+	unsigned int			n_vals;
+	unsigned int			n_keys;
+	unsigned int			n_fields;
+	unsigned int			key_size;
+	struct tracing_map_sort_key	sort_keys[TRACING_MAP_SORT_KEYS_MAX];
+	unsigned int			n_sort_keys;
+	struct ftrace_event_file	*event_file;
+	struct hist_trigger_attrs	*attrs;
+	struct tracing_map		*map;
+	struct hist_var			vars[TRACING_MAP_VARS_MAX];
+	unsigned int			n_vars;
+	/* indexes into match_data->vars[] */
+	unsigned int			var_refs[HIST_VAR_REFS_MAX];
+	unsigned int			n_var_refs;
+	struct hist_trigger_data	*match_data;
+	struct hist_action		*action;
+	/* number of triggers whose onmatch() refers to this one */
+	unsigned int			ref;
+};
+
+struct synth_field {
+	const char	*type;
+	char		*name;
+	bool		is_signed;
+};
+
+struct synth_event {
+	struct list_head		list;
+	char				*name;
+	struct synth_field		fields[SYNTH_FIELDS_MAX];
+	unsigned int			n_fields;
+	struct ftrace_event_class	class;
+	struct ftrace_event_call	call;
+};
+
+/* Every synthetic event field is logged as a u64 */
+struct synth_trace_event {
+	struct trace_entry	ent;
+	u64			fields[];
+};
+
+static u64 hist_field_timestamp(struct hist_field *hist_field, void *event)
+{
+	struct trace_array *tr = hist_field->hist_data->event_file->tr;
+	u64 ts;
+
+	ts = ring_buffer_time_stamp(tr->trace_buffer.buffer, smp_processor_id());
+	if (hist_field->flags & HIST_FIELD_FL_TIMESTAMP_USECS)
+		do_div(ts, NSEC_PER_USEC);
+
+	return ts;
+}
+
+static LIST_HEAD(synth_event_list);
+static DEFINE_MUTEX(synth_event_mutex);
+
+/* Bound synthetic events logged from triggers on synthetic events */
+#define SYNTH_NEST_MAX		4
+
+static DEFINE_PER_CPU(int, synth_trace_nest);
+
+static const struct synth_field_type {
+	const char	*name;
+	bool		is_signed;
+} synth_field_types[] = {
+	{ "s64",	true },
+	{ "u64",	false },
+	{ "s32",	true },
+	{ "u32",	false },
+	{ "s16",	true },
+	{ "u16",	false },
+	{ "s8",		true },
+	{ "u8",		false },
+	{ "int",	true },
+	{ "long",	true },
+	{ "pid_t",	true },
+	{ "bool",	false },
+};
+
+static int synth_event_define_fields(struct ftrace_event_call *call)
+{
+	struct synth_event *event = call->data;
+	unsigned int i, offset = offsetof(struct synth_trace_event, fields);
+	struct synth_field *field;
+	int ret = 0;
+
+	for (i = 0; i < event->n_fields; i++) {
+		field = &event->fields[i];
+		ret = trace_define_field(call, field->is_signed ? "s64" : "u64",
+					 field->name, offset, sizeof(u64),
+					 field->is_signed, FILTER_OTHER);
+		if (ret)
+			break;
+		offset += sizeof(u64);
+	}
+
+	return ret;
+}
+
+static enum print_line_t print_synth_event(struct trace_iterator *iter,
+					   int flags,
+					   struct trace_event *event)
+{
+	struct trace_seq *s = &iter->seq;
+	struct synth_trace_event *entry;
+	struct synth_event *se;
+	unsigned int i;
+
+	entry = (struct synth_trace_event *)iter->ent;
+	se = container_of(event, struct synth_event, call.event);
+
+	trace_seq_printf(s, "%s:", se->name);
+
+	for (i = 0; i < se->n_fields; i++) {
+		if (se->fields[i].is_signed)
+			trace_seq_printf(s, " %s=%lld", se->fields[i].name,
+					 (s64)entry->fields[i]);
+		else
+			trace_seq_printf(s, " %s=%llu", se->fields[i].name,
+					 entry->fields[i]);
+	}
+
+	trace_seq_putc(s, '\n');
+
+	return trace_handle_return(s);
+}
+
+static struct trace_event_functions synth_event_funcs = {
+	.trace		= print_synth_event,
+};
+
+#define LEN_OR_ZERO (len ? len - pos : 0)
+
+static int __set_synth_event_print_fmt(struct synth_event *event,
+				       char *buf, int len)
+{
+	unsigned int i;
+	int pos = 0;
+
+	pos += snprintf(buf + pos, LEN_OR_ZERO, "\"");
+
+	for (i = 0; i < event->n_fields; i++) {
+		pos += snprintf(buf + pos, LEN_OR_ZERO, "%s=%s%s",
+				event->fields[i].name,
+				event->fields[i].is_signed ? "%lld" : "%llu",
+				i == event->n_fields - 1 ? "" : " ");
+	}
+
+	pos += snprintf(buf + pos, LEN_OR_ZERO, "\"");
+
+	for (i = 0; i < event->n_fields; i++)
+		pos += snprintf(buf + pos, LEN_OR_ZERO,
+				", REC->%s", event->fields[i].name);
+
+	/* return the length of print_fmt */
+	return pos;
+}
+
+static int set_synth_event_print_fmt(struct synth_event *event)
+{
+	char *print_fmt;
+	int len;
+
+	/* First: called with 0 length to calculate the needed length */
+	len = __set_synth_event_print_fmt(event, NULL, 0);
+
+	print_fmt = kmalloc(len + 1, GFP_KERNEL);
+	if (!print_fmt)
+		return -ENOMEM;
+
+	/* Second: actually write the @print_fmt */
+	__set_synth_event_print_fmt(event, print_fmt, len + 1);
+	event->call.print_fmt = print_fmt;
+
+	return 0;
+}
+
+/*
+ * Synthetic events have no probe of their own to register: they are
+ * only ever logged by hist trigger actions, which check the event
+ * file's flags themselves.
+ */
+static int synth_event_reg(struct ftrace_event_call *call,
+			   enum trace_reg type, void *data)
+{
+	switch (type) {
+	case TRACE_REG_REGISTER:
+	case TRACE_REG_UNREGISTER:
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static void trace_synth(struct hist_action *action, u64 *vals)
+{
+	struct ftrace_event_file *file = action->synth_file;
+	struct synth_event *event = action->synth_event;
+	struct synth_trace_event *entry;
+	struct ring_buffer_event *rbe;
+	struct ring_buffer *buffer;
+	unsigned long irq_flags;
+	int pc, size;
+
+	if (this_cpu_inc_return(synth_trace_nest) > SYNTH_NEST_MAX)
+		goto out;
+
+	if (ftrace_trigger_soft_disabled(file))
+		goto out;
+
+	local_save_flags(irq_flags);
+	pc = preempt_count();
+
+	size = sizeof(*entry) + event->n_fields * sizeof(u64);
+
+	rbe = trace_event_buffer_lock_reserve(&buffer, file,
+					      event->call.event.type,
+					      size, irq_flags, pc);
+	if (!rbe)
+		goto out;
+
+	entry = ring_buffer_event_data(rbe);
+	memcpy(entry->fields, vals, event->n_fields * sizeof(u64));
+
+	event_trigger_unlock_commit(file, buffer, rbe, entry, irq_flags, pc);
+ out:
+	this_cpu_dec(synth_trace_nest);
+}
+
+static hist_field_fn_t select_value_fn(int field_size, int field_is_signed)
+{
+	hist_field_fn_t fn = NULL;
+
+	switch (field_size) {
+	case 8:
+		if (field_is_signed)
+			fn = hist_field_s64;
+		else
+			fn = hist_field_u64;
+		break;
+	case 4:
+		if (field_is_signed)
+			fn = hist_field_s32;
+		else
+			fn = hist_field_u32;
+		break;
+	case 2:
+		if (field_is_signed)
+			fn = hist_field_s16;
+		else
+			fn = hist_field_u16;
+		break;
+	case 1:
+		if (field_is_signed)
+			fn = hist_field_s8;
+		else
+			fn = hist_field_u8;
+		break;
+	}
+
+	return fn;
+}
+
+static int parse_map_size(char *str)
+{
+	unsigned long size, map_bits;
+	int ret;
+
+	strsep(&str, "=");
+	if (!str)
+		return -EINVAL;
+
+	ret = kstrtoul(str, 0, &size);
+	if (ret)
+		return ret;
+
+	map_bits = ilog2(roundup_pow_of_two(size));
+	if (map_bits < TRACING_MAP_BITS_MIN ||
+	    map_bits > TRACING_MAP_BITS_MAX)
+		return -EINVAL;
+
+	return map_bits;
+}
+
+static void destroy_hist_trigger_attrs(struct hist_trigger_attrs *attrs)
+{
+	unsigned int i;
+
+	if (!attrs)
+		return;
+
+	for (i = 0; i < attrs->n_assignments; i++)
+		kfree(attrs->assignment_str[i]);
+
+	kfree(attrs->onmatch_str);
+	kfree(attrs->sort_key_str);
+	kfree(attrs->keys_str);
+	kfree(attrs->vals_str);
+	kfree(attrs);
+}
+
+static struct hist_trigger_attrs *parse_hist_trigger_attrs(char *trigger_str)
+{
+	struct hist_trigger_attrs *attrs;
+	int ret = 0;
+
+	attrs = kzalloc(sizeof(*attrs), GFP_KERNEL);
+	if (!attrs)
+		return ERR_PTR(-ENOMEM);
+
+	while (trigger_str) {
+		char *str = strsep(&trigger_str, ":");
+
+		if ((strncmp(str, "key=", strlen("key=")) == 0) ||
+		    (strncmp(str, "keys=", strlen("keys=")) == 0)) {
+			attrs->keys_str = kstrdup(str, GFP_KERNEL);
+		} else if ((strncmp(str, "val=", strlen("val=")) == 0) ||
+			   (strncmp(str, "vals=", strlen("vals=")) == 0) ||
+			   (strncmp(str, "values=", strlen("values=")) == 0)) {
+			attrs->vals_str = kstrdup(str, GFP_KERNEL);
+		} else if (strncmp(str, "sort=", strlen("sort=")) == 0) {
+			attrs->sort_key_str = kstrdup(str, GFP_KERNEL);
+		} else if (strcmp(str, "pause") == 0) {
+			attrs->pause = true;
+		} else if ((strcmp(str, "cont") == 0) ||
+			   (strcmp(str, "continue") == 0)) {
+			attrs->cont = true;
+		} else if (strcmp(str, "clear") == 0) {
+			attrs->clear = true;
+		} else if (strncmp(str, "size=", strlen("size=")) == 0) {
+			int map_bits = parse_map_size(str);
+
+			if (map_bits < 0) {
+				ret = map_bits;
+				goto free;
+			}
+			attrs->map_bits = map_bits;
+		} else if (strncmp(str, "onmatch(", strlen("onmatch(")) == 0) {
+			if (attrs->onmatch_str) {
+				ret = -EINVAL;
+				goto free;
+			}
+			attrs->onmatch_str = kstrdup(str, GFP_KERNEL);
+		} else if (strchr(str, '=')) {
+			if (attrs->n_assignments == TRACING_MAP_VARS_MAX) {
+				ret = -EINVAL;
+				goto free;
+			}
+			attrs->assignment_str[attrs->n_assignments++] =
+				kstrdup(str, GFP_KERNEL);
+		} else {
+			ret = -EINVAL;
+			goto free;
+		}
+	}
+
+	if (!attrs->keys_str) {
+		ret = -EINVAL;
+		goto free;
+	}
+
+	return attrs;
+ free:
+	destroy_hist_trigger_attrs(attrs);
+
+	return ERR_PTR(ret);
+}
+
+static const char *hist_field_name(struct hist_field *hist_field)
+{
+	if (hist_field->flags & HIST_FIELD_FL_HITCOUNT)
+		return "hitcount";
+
+	if (hist_field->flags & HIST_FIELD_FL_TIMESTAMP)
+		return "common_timestamp";
+
+	return hist_field->field->name;
+}
+
+static void destroy_hist_fields(struct hist_trigger_data *hist_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < TRACING_MAP_FIELDS_MAX; i++) {
+		kfree(hist_data->fields[i]);
+		hist_data->fields[i] = NULL;
+	}
+}
+
+static struct hist_field *create_hist_field(struct ftrace_event_field *field,
+					    unsigned long flags)
+{
+	struct hist_field *hist_field;
+
+	hist_field = kzalloc(sizeof(*hist_field), GFP_KERNEL);
+	if (!hist_field)
+		return NULL;
+
+	if (flags & HIST_FIELD_FL_HITCOUNT) {
+		hist_field->fn = hist_field_counter;
+		goto out;
+	}
+
+	if (flags & HIST_FIELD_FL_TIMESTAMP) {
+		hist_field->fn = hist_field_timestamp;
+		hist_field->size = sizeof(u64);
+		goto out;
+	}
+
+	switch (field->filter_type) {
+	case FILTER_STATIC_STRING:
+		hist_field->fn = hist_field_string;
+		/* Leave room for the terminating NUL */
+		hist_field->size = field->size + 1;
+		break;
+	case FILTER_DYN_STRING:
+		hist_field->fn = hist_field_dynstring;
+		hist_field->size = HIST_DYN_STR_SIZE;
+		break;
+	case FILTER_PTR_STRING:
+		hist_field->fn = hist_field_pstring;
+		hist_field->size = HIST_DYN_STR_SIZE;
+		break;
+	default:
+		hist_field->fn = select_value_fn(field->size,
+						 field->is_signed);
+		if (!hist_field->fn) {
+			kfree(hist_field);
+			return NULL;
+		}
+		/* Numeric keys are always stored as a u64 */
+		hist_field->size = sizeof(u64);
+		goto out;
+	}
+
+	if (!(flags & HIST_FIELD_FL_KEY)) {
+		/* Strings can't be summed */
+		kfree(hist_field);
+		return NULL;
+	}
+	flags |= HIST_FIELD_FL_STRING;
+	hist_field->size = ALIGN(hist_field->size, sizeof(u64));
+ out:
+	hist_field->field = field;
+	hist_field->flags = flags;
+
+	return hist_field;
+}
+
+static int create_hitcount_val(struct hist_trigger_data *hist_data)
+{
+	hist_data->fields[HITCOUNT_IDX] =
+		create_hist_field(NULL, HIST_FIELD_FL_HITCOUNT);
+	if (!hist_data->fields[HITCOUNT_IDX])
+		return -ENOMEM;
+
+	hist_data->n_vals++;
+
+	if (WARN_ON(hist_data->n_vals > TRACING_MAP_VALS_MAX))
+		return -EINVAL;
+
+	return 0;
+}
+
+static int create_val_field(struct hist_trigger_data *hist_data,
+			    unsigned int val_idx,
+			    struct ftrace_event_file *file,
+			    char *field_name)
+{
+	struct ftrace_event_field *field;
+
+	if (WARN_ON(val_idx >= TRACING_MAP_VALS_MAX))
+		return -EINVAL;
+
+	field = trace_find_event_field(file->event_call, field_name);
+	if (!field)
+		return -EINVAL;
+
+	hist_data->fields[val_idx] = create_hist_field(field, 0);
+	if (!hist_data->fields[val_idx])
+		return -EINVAL;
+
+	++hist_data->n_vals;
+
+	return 0;
+}
+
+static int create_val_fields(struct hist_trigger_data *hist_data,
+			     struct ftrace_event_file *file)
+{
+	char *fields_str, *field_str;
+	unsigned int j = 1;
+	int ret;
+
+	ret = create_hitcount_val(hist_data);
+	if (ret)
+		return ret;
+
+	fields_str = hist_data->attrs->vals_str;
+	if (!fields_str)
+		return 0;
+
+	strsep(&fields_str, "=");
+	if (!fields_str)
+		return -EINVAL;
+
+	while ((field_str = strsep(&fields_str, ","))) {
+		/* hitcount is always there, listing it is optional */
+		if (strcmp(field_str, "hitcount") == 0)
+			continue;
+		if (j >= TRACING_MAP_VALS_MAX)
+			return -EINVAL;
+		ret = create_val_field(hist_data, j++, file, field_str);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int create_key_field(struct hist_trigger_data *hist_data,
+			    unsigned int key_idx,
+			    unsigned int key_offset,
+			    struct ftrace_event_file *file,
+			    char *field_str)
+{
+	struct ftrace_event_field *field;
+	unsigned long flags = HIST_FIELD_FL_KEY;
+	char *field_name;
+
+	if (WARN_ON(key_idx >= TRACING_MAP_FIELDS_MAX))
+		return -EINVAL;
+
+	field_name = strsep(&field_str, ".");
+	if (field_str) {
+		if (strcmp(field_str, "hex") == 0)
+			flags |= HIST_FIELD_FL_HEX;
+		else if (strcmp(field_str, "sym") == 0)
+			flags |= HIST_FIELD_FL_SYM;
+		else if (strcmp(field_str, "log2") == 0)
+			flags |= HIST_FIELD_FL_LOG2;
+		else
+			return -EINVAL;
+	}
+
+	field = trace_find_event_field(file->event_call, field_name);
+	if (!field)
+		return -EINVAL;
+
+	hist_data->fields[key_idx] = create_hist_field(field, flags);
+	if (!hist_data->fields[key_idx])
+		return -EINVAL;
+
+	/* Modifiers only make sense for numeric keys */
+	if ((hist_data->fields[key_idx]->flags & HIST_FIELD_FL_STRING) &&
+	    (flags & ~HIST_FIELD_FL_KEY))
+		return -EINVAL;
+
+	if (key_offset + hist_data->fields[key_idx]->size > HIST_KEY_SIZE_MAX)
+		return -EINVAL;
+
+	hist_data->fields[key_idx]->offset = key_offset;
+	hist_data->key_size += hist_data->fields[key_idx]->size;
+	hist_data->n_keys++;
+
+	return hist_data->fields[key_idx]->size;
+}
+
+static int create_key_fields(struct hist_trigger_data *hist_data,
+			     struct ftrace_event_file *file)
+{
+	unsigned int i, key_offset = 0, n_vals = hist_data->n_vals;
+	char *fields_str, *field_str;
+	int ret = -EINVAL;
+
+	fields_str = hist_data->attrs->keys_str;
+	if (!fields_str)
+		goto out;
+
+	strsep(&fields_str, "=");
+	if (!fields_str)
+		goto out;
+
+	for (i = n_vals; i < n_vals + TRACING_MAP_KEYS_MAX; i++) {
+		field_str = strsep(&fields_str, ",");
+		if (!field_str)
+			break;
+		ret = create_key_field(hist_data, i, key_offset,
+				       file, field_str);
+		if (ret < 0)
+			goto out;
+		key_offset += ret;
+	}
+	if (fields_str) {
+		ret = -EINVAL;
+		goto out;
+	}
+	ret = 0;
+ out:
+	return ret;
+}
+
+static int create_hist_fields(struct hist_trigger_data *hist_data,
+			      struct ftrace_event_file *file)
+{
+	int ret;
+
+	ret = create_val_fields(hist_data, file);
+	if (ret)
+		goto out;
+
+	ret = create_key_fields(hist_data, file);
+	if (ret)
+		goto out;
+
+	hist_data->n_fields = hist_data->n_vals + hist_data->n_keys;
+ out:
+	return ret;
+}
+
+static int is_descending(const char *str)
+{
+	if (!str)
+		return 0;
+
+	if (strcmp(str, "descending") == 0)
+		return 1;
+
+	if (strcmp(str, "ascending") == 0)
+		return 0;
+
+	return -EINVAL;
+}
+
+static int create_sort_keys(struct hist_trigger_data *hist_data)
+{
+	char *fields_str = hist_data->attrs->sort_key_str;
+	struct tracing_map_sort_key *sort_key;
+	int descending, ret = 0;
+	unsigned int i, j;
+
+	hist_data->n_sort_keys = 1; /* we always have at least one, hitcount */
+
+	if (!fields_str)
+		goto out;
+
+	strsep(&fields_str, "=");
+	if (!fields_str) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < TRACING_MAP_SORT_KEYS_MAX; i++) {
+		char *field_str, *field_name;
+
+		sort_key = &hist_data->sort_keys[i];
+
+		field_str = strsep(&fields_str, ",");
+		if (!field_str) {
+			if (i == 0)
+				ret = -EINVAL;
+			break;
+		}
+
+		if ((i == TRACING_MAP_SORT_KEYS_MAX - 1) && fields_str) {
+			ret = -EINVAL;
+			break;
+		}
+
+		field_name = strsep(&field_str, ".");
+		if (!field_name) {
+			ret = -EINVAL;
+			break;
+		}
+
+		descending = is_descending(field_str);
+		if (descending < 0) {
+			ret = descending;
+			break;
+		}
+		sort_key->descending = descending;
+
+		for_each_hist_field(j, hist_data) {
+			if (strcmp(field_name,
+				   hist_field_name(hist_data->fields[j])) == 0)
+				break;
+		}
+
+		if (j == hist_data->n_fields) {
+			ret = -EINVAL;
+			break;
+		}
+		sort_key->field_idx = j;
+	}
+
+	hist_data->n_sort_keys = i;
+ out:
+	return ret;
+}
+
+static struct hist_trigger_data *find_hist_data(struct ftrace_event_file *file)
+{
+	struct event_trigger_data *data;
+
+	list_for_each_entry_rcu(data, &file->triggers, list) {
+		if (data->cmd_ops->trigger_type == ETT_EVENT_HIST)
+			return data->private_data;
+	}
+
+	return NULL;
+}
+
+static int find_var(struct hist_trigger_data *hist_data, const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < hist_data->n_vars; i++) {
+		if (strcmp(hist_data->vars[i].name, name) == 0)
+			return i;
+	}
+
+	return -ENOENT;
+}
+
+static void destroy_operand(struct hist_operand *operand)
+{
+	kfree(operand->field);
+	operand->field = NULL;
+}
+
+static void destroy_expr(struct hist_expr *expr)
+{
+	unsigned int i;
+
+	for (i = 0; i < expr->n_operands; i++)
+		destroy_operand(&expr->operands[i]);
+}
+
+static int parse_var_ref(struct hist_trigger_data *hist_data, char *name,
+			 struct hist_operand *operand)
+{
+	unsigned int i;
+	int idx;
+
+	idx = find_var(hist_data, name);
+	if (idx >= 0) {
+		operand->type = HIST_OPERAND_VAR;
+		operand->idx = idx;
+		return 0;
+	}
+
+	if (!hist_data->match_data)
+		return -EINVAL;
+
+	idx = find_var(hist_data->match_data, name);
+	if (idx < 0)
+		return -EINVAL;
+
+	for (i = 0; i < hist_data->n_var_refs; i++) {
+		if (hist_data->var_refs[i] == idx)
+			break;
+	}
+
+	if (i == hist_data->n_var_refs) {
+		if (i == HIST_VAR_REFS_MAX)
+			return -EINVAL;
+		hist_data->var_refs[hist_data->n_var_refs++] = idx;
+	}
+
+	operand->type = HIST_OPERAND_VAR_REF;
+	operand->idx = i;
+
+	return 0;
+}
+
+static int parse_operand(struct hist_trigger_data *hist_data,
+			 struct ftrace_event_file *file,
+			 char *str, struct hist_operand *operand)
+{
+	struct ftrace_event_field *field = NULL;
+	unsigned long flags = 0;
+	char *field_name;
+
+	if (str[0] == '$')
+		return parse_var_ref(hist_data, str + 1, operand);
+
+	field_name = strsep(&str, ".");
+	if (strcmp(field_name, "common_timestamp") == 0) {
+		flags |= HIST_FIELD_FL_TIMESTAMP;
+		if (str && strcmp(str, "usecs") == 0)
+			flags |= HIST_FIELD_FL_TIMESTAMP_USECS;
+		else if (str)
+			return -EINVAL;
+	} else {
+		if (str)
+			return -EINVAL;
+		field = trace_find_event_field(file->event_call, field_name);
+		if (!field)
+			return -EINVAL;
+	}
+
+	operand->field = create_hist_field(field, flags);
+	if (!operand->field)
+		return -EINVAL;
+
+	operand->field->hist_data = hist_data;
+	operand->type = HIST_OPERAND_FIELD;
+
+	return 0;
+}
+
+static int parse_expr(struct hist_trigger_data *hist_data,
+		      struct ftrace_event_file *file,
+		      char *str, struct hist_expr *expr)
+{
+	char *operand_str;
+	int ret;
+
+	while ((operand_str = strsep(&str, "-"))) {
+		if (expr->n_operands == ARRAY_SIZE(expr->operands))
+			return -EINVAL;
+
+		ret = parse_operand(hist_data, file, operand_str,
+				    &expr->operands[expr->n_operands]);
+		if (ret)
+			return ret;
+
+		expr->n_operands++;
+	}
+
+	return 0;
+}
+
+static int create_var(struct hist_trigger_data *hist_data,
+		      struct ftrace_event_file *file,
+		      char *assignment_str)
+{
+	struct hist_var *var;
+	char *str, *name;
+	int ret;
+
+	if (!assignment_str)
+		return -ENOMEM;
+
+	str = kstrdup(assignment_str, GFP_KERNEL);
+	if (!str)
+		return -ENOMEM;
+
+	assignment_str = str;
+
+	name = strsep(&str, "=");
+	if (!str || !*name || find_var(hist_data, name) >= 0) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	var = &hist_data->vars[hist_data->n_vars];
+
+	ret = parse_expr(hist_data, file, str, &var->expr);
+	if (ret)
+		goto free_expr;
+
+	var->name = kstrdup(name, GFP_KERNEL);
+	if (!var->name) {
+		ret = -ENOMEM;
+		goto free_expr;
+	}
+
+	hist_data->n_vars++;
+ out:
+	kfree(assignment_str);
+
+	return ret;
+ free_expr:
+	destroy_expr(&var->expr);
+	memset(var, 0, sizeof(*var));
+	goto out;
+}
+
+static int create_vars(struct hist_trigger_data *hist_data,
+		       struct ftrace_event_file *file)
+{
+	struct hist_trigger_attrs *attrs = hist_data->attrs;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < attrs->n_assignments; i++) {
+		ret = create_var(hist_data, file, attrs->assignment_str[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void destroy_vars(struct hist_trigger_data *hist_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < hist_data->n_vars; i++) {
+		destroy_expr(&hist_data->vars[i].expr);
+		kfree(hist_data->vars[i].name);
+	}
+}
+
+static void destroy_action(struct hist_action *action)
+{
+	unsigned int i;
+
+	if (!action)
+		return;
+
+	if (action->synth_file)
+		trace_event_enable_disable(action->synth_file, 0, 1);
+
+	for (i = 0; i < action->n_params; i++) {
+		destroy_operand(&action->params[i]);
+		kfree(action->param_str[i]);
+	}
+
+	kfree(action->synth_name);
+	kfree(action->match_event);
+	kfree(action->match_system);
+	kfree(action);
+}
+
+/* onmatch(<system>.<event>).trace(<synthetic event>[,<param>,...]) */
+static struct hist_action *parse_action(char *onmatch_str)
+{
+	char *str, *match, *system, *params, *param;
+	struct hist_action *action;
+	int ret = -EINVAL;
+
+	if (!onmatch_str)
+		return ERR_PTR(-ENOMEM);
+
+	action = kzalloc(sizeof(*action), GFP_KERNEL);
+	if (!action)
+		return ERR_PTR(-ENOMEM);
+
+	str = kstrdup(onmatch_str, GFP_KERNEL);
+	if (!str) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	onmatch_str = str;
+
+	strsep(&str, "(");
+	match = strsep(&str, ")");
+	if (!match || !str)
+		goto free;
+
+	system = strsep(&match, ".");
+	if (!match || !*system || !*match)
+		goto free;
+
+	if (strncmp(str, ".trace(", strlen(".trace(")) != 0)
+		goto free;
+	str += strlen(".trace(");
+
+	params = strsep(&str, ")");
+	if (!str || *str)
+		goto free;
+
+	param = strsep(&params, ",");
+	if (!*param)
+		goto free;
+
+	ret = -ENOMEM;
+	action->match_system = kstrdup(system, GFP_KERNEL);
+	action->match_event = kstrdup(match, GFP_KERNEL);
+	action->synth_name = kstrdup(param, GFP_KERNEL);
+	if (!action->match_system || !action->match_event ||
+	    !action->synth_name)
+		goto free;
+
+	while ((param = strsep(&params, ","))) {
+		if (action->n_params == SYNTH_FIELDS_MAX || !*param) {
+			ret = -EINVAL;
+			goto free;
+		}
+		action->param_str[action->n_params] = kstrdup(param, GFP_KERNEL);
+		if (!action->param_str[action->n_params])
+			goto free;
+		action->n_params++;
+	}
+
+	kfree(onmatch_str);
+
+	return action;
+ free:
+	kfree(onmatch_str);
+	destroy_action(action);
+
+	return ERR_PTR(ret);
+}
+
+static bool compatible_keys(struct hist_trigger_data *a,
+			    struct hist_trigger_data *b)
+{
+	unsigned int i, j;
+
+	if (a->n_keys != b->n_keys || a->key_size != b->key_size)
+		return false;
+
+	for (i = a->n_vals, j = b->n_vals; i < a->n_fields; i++, j++) {
+		if (a->fields[i]->size != b->fields[j]->size ||
+		    (a->fields[i]->flags & HIST_FIELD_FL_STRING) !=
+		    (b->fields[j]->flags & HIST_FIELD_FL_STRING))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Find the hist trigger on the onmatch() event.  Its variables are
+ * looked up with this trigger's key, so the keys have to be laid out
+ * the same way in both.
+ */
+static int resolve_match(struct hist_trigger_data *hist_data,
+			 struct ftrace_event_file *file)
+{
+	struct hist_action *action = hist_data->action;
+	struct hist_trigger_data *match_data;
+	struct ftrace_event_file *match_file;
+
+	match_file = find_event_file(file->tr, action->match_system,
+				     action->match_event);
+	if (!match_file)
+		return -EINVAL;
+
+	match_data = find_hist_data(match_file);
+	if (!match_data || !compatible_keys(hist_data, match_data))
+		return -EINVAL;
+
+	hist_data->match_data = match_data;
+	match_data->ref++;
+
+	return 0;
+}
+
+static int create_action(struct hist_trigger_data *hist_data,
+			 struct ftrace_event_file *file)
+{
+	struct hist_action *action = hist_data->action;
+	struct ftrace_event_file *synth_file;
+	struct synth_event *event;
+	unsigned int i;
+	char *str;
+	int ret;
+
+	synth_file = find_event_file(file->tr, SYNTH_SYSTEM,
+				     action->synth_name);
+	if (!synth_file)
+		return -EINVAL;
+
+	event = synth_file->event_call->data;
+	if (action->n_params != event->n_fields)
+		return -EINVAL;
+
+	for (i = 0; i < action->n_params; i++) {
+		str = kstrdup(action->param_str[i], GFP_KERNEL);
+		if (!str)
+			return -ENOMEM;
+
+		ret = parse_operand(hist_data, file, str, &action->params[i]);
+		kfree(str);
+		if (ret)
+			return ret;
+	}
+
+	/* Keeps the synthetic event from being removed while in use */
+	ret = trace_event_enable_disable(synth_file, 1, 1);
+	if (ret)
+		return ret;
+
+	action->synth_event = event;
+	action->synth_file = synth_file;
+
+	return 0;
+}
+
+static void destroy_hist_data(struct hist_trigger_data *hist_data)
+{
+	if (!hist_data)
+		return;
+
+	if (hist_data->match_data)
+		hist_data->match_data->ref--;
+
+	destroy_action(hist_data->action);
+	destroy_vars(hist_data);
+	destroy_hist_trigger_attrs(hist_data->attrs);
+	destroy_hist_fields(hist_data);
+	tracing_map_destroy(hist_data->map);
+	kfree(hist_data);
+}
+
+static int create_tracing_map_fields(struct hist_trigger_data *hist_data)
+{
+	struct tracing_map *map = hist_data->map;
+	struct ftrace_event_field *field;
+	struct hist_field *hist_field;
+	int i, idx;
+
+	for_each_hist_field(i, hist_data) {
+		hist_field = hist_data->fields[i];
+		if (hist_field->flags & HIST_FIELD_FL_KEY) {
+			tracing_map_cmp_fn_t cmp_fn;
+
+			field = hist_field->field;
+
+			if (hist_field->flags & HIST_FIELD_FL_STRING)
+				cmp_fn = tracing_map_cmp_string;
+			else
+				cmp_fn = tracing_map_cmp_num(sizeof(u64),
+							     field->is_signed &&
+							     !(hist_field->flags &
+							       HIST_FIELD_FL_LOG2));
+			idx = tracing_map_add_key_field(map,
+							hist_field->offset,
+							cmp_fn);
+		} else {
+			idx = tracing_map_add_sum_field(map);
+		}
+
+		if (idx < 0)
+			return idx;
+	}
+
+	for (i = 0; i < hist_data->n_vars; i++) {
+		idx = tracing_map_add_var(map);
+		if (idx < 0)
+			return idx;
+	}
+
+	return 0;
+}
+
+static struct hist_trigger_data *
+create_hist_data(unsigned int map_bits,
+		 struct hist_trigger_attrs *attrs,
+		 struct ftrace_event_file *file)
+{
+	struct hist_trigger_data *hist_data;
+	unsigned int i;
+	int ret = 0;
+
+	hist_data = kzalloc(sizeof(*hist_data), GFP_KERNEL);
+	if (!hist_data)
+		return ERR_PTR(-ENOMEM);
+
+	hist_data->attrs = attrs;
+	hist_data->event_file = file;
+
+	ret = create_hist_fields(hist_data, file);
+	if (ret < 0)
+		goto free;
+
+	if (attrs->onmatch_str) {
+		hist_data->action = parse_action(attrs->onmatch_str);
+		if (IS_ERR(hist_data->action)) {
+			ret = PTR_ERR(hist_data->action);
+			hist_data->action = NULL;
+			goto free;
+		}
+
+		ret = resolve_match(hist_data, file);
+		if (ret)
+			goto free;
+	}
+
+	ret = create_vars(hist_data, file);
+	if (ret)
+		goto free;
+
+	if (hist_data->action) {
+		ret = create_action(hist_data, file);
+		if (ret)
+			goto free;
+	}
+
+	ret = create_sort_keys(hist_data);
+	if (ret < 0)
+		goto free;
+
+	hist_data->map = tracing_map_create(map_bits, hist_data->key_size);
+	if (IS_ERR(hist_data->map)) {
+		ret = PTR_ERR(hist_data->map);
+		hist_data->map = NULL;
+		goto free;
+	}
+
+	ret = create_tracing_map_fields(hist_data);
+	if (ret)
+		goto free;
+
+	for (i = 0; i < hist_data->n_sort_keys; i++)
+		tracing_map_set_sort_key(hist_data->map, i,
+					 hist_data->sort_keys[i].field_idx,
+					 hist_data->sort_keys[i].descending);
+
+	ret = tracing_map_init(hist_data->map);
+	if (ret)
+		goto free;
+ out:
+	return hist_data;
+ free:
+	hist_data->attrs = NULL;
+
+	destroy_hist_data(hist_data);
+
+	hist_data = ERR_PTR(ret);
+
+	goto out;
+}
+
+static void hist_trigger_elt_update(struct hist_trigger_data *hist_data,
+				    struct tracing_map_elt *elt,
+				    void *rec)
+{
+	struct hist_field *hist_field;
+	unsigned int i;
+	u64 hist_val;
+
+	for_each_hist_val_field(i, hist_data) {
+		hist_field = hist_data->fields[i];
+		hist_val = hist_field->fn(hist_field, rec);
+		tracing_map_update_sum(elt, i, hist_val);
+	}
+}
+
+static u64 hist_operand_eval(struct hist_operand *operand, void *rec,
+			     u64 *var_ref_vals, u64 *var_vals)
+{
+	switch (operand->type) {
+	case HIST_OPERAND_VAR:
+		return var_vals[operand->idx];
+	case HIST_OPERAND_VAR_REF:
+		return var_ref_vals[operand->idx];
+	default:
+		return operand->field->fn(operand->field, rec);
+	}
+}
+
+static u64 hist_expr_eval(struct hist_expr *expr, void *rec,
+			  u64 *var_ref_vals, u64 *var_vals)
+{
+	u64 val;
+
+	val = hist_operand_eval(&expr->operands[0], rec,
+				var_ref_vals, var_vals);
+	if (expr->n_operands > 1)
+		val -= hist_operand_eval(&expr->operands[1], rec,
+					 var_ref_vals, var_vals);
+
+	return val;
+}
+
+/*
+ * Collect the variables referenced from the onmatch() trigger's entry
+ * for this key.  They are only consumed if all of them are set, so
+ * that a partial match doesn't lose values for a later full one.
+ */
+static bool resolve_var_refs(struct hist_trigger_data *hist_data, void *key,
+			     u64 *var_ref_vals)
+{
+	struct tracing_map_elt *elt;
+	unsigned int i;
+
+	elt = tracing_map_lookup(hist_data->match_data->map, key);
+	if (!elt)
+		return false;
+
+	for (i = 0; i < hist_data->n_var_refs; i++) {
+		if (!tracing_map_var_set(elt, hist_data->var_refs[i]))
+			return false;
+	}
+
+	for (i = 0; i < hist_data->n_var_refs; i++)
+		var_ref_vals[i] = tracing_map_read_var_once(elt,
+							    hist_data->var_refs[i]);
+
+	return true;
+}
+
+static void hist_action_trace(struct hist_action *action, void *rec,
+			      u64 *var_ref_vals, u64 *var_vals)
+{
+	u64 vals[SYNTH_FIELDS_MAX];
+	unsigned int i;
+
+	for (i = 0; i < action->n_params; i++)
+		vals[i] = hist_operand_eval(&action->params[i], rec,
+					    var_ref_vals, var_vals);
+
+	trace_synth(action, vals);
+}
+
+static void event_hist_trigger(struct event_trigger_data *data, void *rec)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	char compound_key[HIST_KEY_SIZE_MAX];
+	u64 var_ref_vals[HIST_VAR_REFS_MAX];
+	u64 var_vals[TRACING_MAP_VARS_MAX];
+	struct hist_field *key_field;
+	struct tracing_map_elt *elt;
+	u64 field_contents;
+	unsigned int i;
+
+	if (!rec || READ_ONCE(hist_data->attrs->pause))
+		return;
+
+	memset(compound_key, 0, hist_data->key_size);
+
+	for_each_hist_key_field(i, hist_data) {
+		key_field = hist_data->fields[i];
+
+		field_contents = key_field->fn(key_field, rec);
+		if (key_field->flags & HIST_FIELD_FL_STRING) {
+			char *str = (char *)(unsigned long)field_contents;
+
+			if (!str)
+				continue;
+			strncpy(compound_key + key_field->offset, str,
+				key_field->size - 1);
+		} else {
+			/* Bucket the value by the power of two above it */
+			if (key_field->flags & HIST_FIELD_FL_LOG2)
+				field_contents = field_contents ?
+					fls64(field_contents - 1) : 0;
+			memcpy(compound_key + key_field->offset,
+			       &field_contents, sizeof(u64));
+		}
+	}
+
+	if (hist_data->n_var_refs &&
+	    !resolve_var_refs(hist_data, compound_key, var_ref_vals))
+		return;
+
+	elt = tracing_map_insert(hist_data->map, compound_key);
+	if (elt)
+		hist_trigger_elt_update(hist_data, elt, rec);
+
+	for (i = 0; i < hist_data->n_vars; i++) {
+		var_vals[i] = hist_expr_eval(&hist_data->vars[i].expr, rec,
+					     var_ref_vals, var_vals);
+		if (elt)
+			tracing_map_set_var(elt, i, var_vals[i]);
+	}
+
+	if (hist_data->action)
+		hist_action_trace(hist_data->action, rec,
+				  var_ref_vals, var_vals);
+}
+
+static void hist_trigger_print_key(struct seq_file *m,
+				   struct hist_trigger_data *hist_data,
+				   void *key,
+				   struct tracing_map_elt *elt)
+{
+	struct hist_field *key_field;
+	char str[KSYM_SYMBOL_LEN];
+	unsigned int i;
+	u64 uval;
+
+	seq_puts(m, "{ ");
+
+	for_each_hist_key_field(i, hist_data) {
+		key_field = hist_data->fields[i];
+
+		if (i > hist_data->n_vals)
+			seq_puts(m, ", ");
+
+		if (key_field->flags & HIST_FIELD_FL_STRING) {
+			seq_printf(m, "%s: %-50s", key_field->field->name,
+				   (char *)(key + key_field->offset));
+			continue;
+		}
+
+		uval = *(u64 *)(key + key_field->offset);
+		if (key_field->flags & HIST_FIELD_FL_HEX) {
+			seq_printf(m, "%s: %llx",
+				   key_field->field->name, uval);
+		} else if (key_field->flags & HIST_FIELD_FL_SYM) {
+			sprint_symbol_no_offset(str, uval);
+			seq_printf(m, "%s: [%llx] %-45s",
+				   key_field->field->name, uval, str);
+		} else if (key_field->flags & HIST_FIELD_FL_LOG2) {
+			seq_printf(m, "%s: ~ 2^%-2llu",
+				   key_field->field->name, uval);
+		} else if (key_field->field->is_signed) {
+			seq_printf(m, "%s: %10lld",
+				   key_field->field->name, (s64)uval);
+		} else {
+			seq_printf(m, "%s: %10llu",
+				   key_field->field->name, uval);
+		}
+	}
+
+	seq_puts(m, " }");
+}
+
+static void hist_trigger_entry_print(struct seq_file *m,
+				     struct hist_trigger_data *hist_data,
+				     void *key,
+				     struct tracing_map_elt *elt)
+{
+	unsigned int i;
+
+	hist_trigger_print_key(m, hist_data, key, elt);
+
+	seq_printf(m, " hitcount: %10llu",
+		   tracing_map_read_sum(elt, HITCOUNT_IDX));
+
+	for (i = 1; i < hist_data->n_vals; i++) {
+		seq_printf(m, "  %s: %10llu",
+			   hist_data->fields[i]->field->name,
+			   tracing_map_read_sum(elt, i));
+	}
+
+	seq_puts(m, "\n");
+}
+
+static int print_entries(struct seq_file *m,
+			 struct hist_trigger_data *hist_data)
+{
+	struct tracing_map_sort_entry **sort_entries = NULL;
+	struct tracing_map *map = hist_data->map;
+	int i, n_entries;
+
+	n_entries = tracing_map_sort_entries(map, &sort_entries);
+	if (n_entries < 0)
+		return n_entries;
+
+	for (i = 0; i < n_entries; i++)
+		hist_trigger_entry_print(m, hist_data,
+					 sort_entries[i]->key,
+					 sort_entries[i]->elt);
+
+	if (n_entries)
+		tracing_map_destroy_sort_entries(sort_entries, n_entries);
+
+	return n_entries;
+}
+
+static void hist_trigger_show(struct seq_file *m,
+			      struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	int n_entries;
+
+	seq_puts(m, "# event histogram\n#\n# trigger info: ");
+	data->ops->print(m, data->ops, data);
+	seq_puts(m, "\n");
+
+	n_entries = print_entries(m, hist_data);
+	if (n_entries < 0)
+		n_entries = 0;
+
+	seq_printf(m, "\nTotals:\n    Hits: %llu\n    Entries: %u\n    Dropped: %llu\n",
+		   (u64)atomic64_read(&hist_data->map->hits),
+		   n_entries, (u64)atomic64_read(&hist_data->map->drops));
+}
+
+static int hist_show(struct seq_file *m, void *v)
+{
+	struct event_trigger_data *data;
+	struct ftrace_event_file *event_file;
+	int ret = 0;
+
+	mutex_lock(&event_mutex);
+
+	event_file = event_file_data(m->private);
+	if (unlikely(!event_file)) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	list_for_each_entry_rcu(data, &event_file->triggers, list) {
+		if (data->cmd_ops->trigger_type == ETT_EVENT_HIST)
+			hist_trigger_show(m, data);
+	}
+
+ out_unlock:
+	mutex_unlock(&event_mutex);
+
+	return ret;
+}
+
+static int event_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hist_show, file);
+}
+
+const struct file_operations event_hist_fops = {
+	.open = event_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static const char *get_hist_field_flags(struct hist_field *hist_field)
+{
+	const char *flags_str = NULL;
+
+	if (hist_field->flags & HIST_FIELD_FL_HEX)
+		flags_str = "hex";
+	else if (hist_field->flags & HIST_FIELD_FL_SYM)
+		flags_str = "sym";
+	else if (hist_field->flags & HIST_FIELD_FL_LOG2)
+		flags_str = "log2";
+
+	return flags_str;
+}
+
+static void hist_field_print(struct seq_file *m, struct hist_field *hist_field)
+{
+	seq_printf(m, "%s", hist_field_name(hist_field));
+
+	if (hist_field->flags & HIST_FIELD_FL_KEY) {
+		const char *flags_str = get_hist_field_flags(hist_field);
+
+		if (flags_str)
+			seq_printf(m, ".%s", flags_str);
+	}
+}
+
+static int event_hist_trigger_print(struct seq_file *m,
+				    struct event_trigger_ops *ops,
+				    struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	struct hist_field *key_field;
+	unsigned int i;
+
+	seq_puts(m, "hist:keys=");
+
+	for_each_hist_key_field(i, hist_data) {
+		key_field = hist_data->fields[i];
+
+		if (i > hist_data->n_vals)
+			seq_puts(m, ",");
+
+		hist_field_print(m, key_field);
+	}
+
+	seq_puts(m, ":vals=");
+
+	for_each_hist_val_field(i, hist_data) {
+		if (i > HITCOUNT_IDX)
+			seq_puts(m, ",");
+		hist_field_print(m, hist_data->fields[i]);
+	}
+
+	seq_puts(m, ":sort=");
+
+	for (i = 0; i < hist_data->n_sort_keys; i++) {
+		struct tracing_map_sort_key *sort_key;
+
+		sort_key = &hist_data->sort_keys[i];
+
+		if (i > 0)
+			seq_puts(m, ",");
+
+		seq_printf(m, "%s",
+			   hist_field_name(hist_data->fields[sort_key->field_idx]));
+
+		if (sort_key->descending)
+			seq_puts(m, ".descending");
+	}
+
+	seq_printf(m, ":size=%u", (1 << hist_data->map->map_bits));
+
+	for (i = 0; i < hist_data->attrs->n_assignments; i++)
+		seq_printf(m, ":%s", hist_data->attrs->assignment_str[i]);
+
+	if (hist_data->attrs->onmatch_str)
+		seq_printf(m, ":%s", hist_data->attrs->onmatch_str);
+
+	if (data->filter_str)
+		seq_printf(m, " if %s", data->filter_str);
+
+	if (hist_data->attrs->pause)
+		seq_puts(m, " [paused]");
+	else
+		seq_puts(m, " [active]");
+
+	seq_putc(m, '\n');
+
+	return 0;
+}
+
+static void event_hist_trigger_free(struct event_trigger_ops *ops,
+				    struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+
+	if (WARN_ON_ONCE(data->ref <= 0))
+		return;
+
+	data->ref--;
+	if (!data->ref) {
+		/* Waits for running triggers before freeing the data */
+		trigger_data_free(data);
+		destroy_hist_data(hist_data);
+	}
+}
+
+static struct event_trigger_ops event_hist_trigger_ops = {
+	.func			= event_hist_trigger,
+	.print			= event_hist_trigger_print,
+	.init			= event_trigger_init,
+	.free			= event_hist_trigger_free,
+};
+
+static struct event_trigger_ops *event_hist_get_trigger_ops(char *cmd,
+							    char *param)
+{
+	return &event_hist_trigger_ops;
+}
+
+static void hist_clear(struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	bool paused;
+
+	paused = hist_data->attrs->pause;
+	hist_data->attrs->pause = true;
+
+	/* Make sure no trigger is still inserting before clearing */
+	synchronize_sched();
+
+	tracing_map_clear(hist_data->map);
+
+	hist_data->attrs->pause = paused;
+}
+
+/*
+ * Only one hist trigger may be attached to an event.  Writing a hist
+ * command with :pause, :cont or :clear to an event that already has
+ * one updates that trigger instead of adding a new one; in that case
+ * 0 is returned and the caller drops the new trigger data.
+ */
+static int hist_register_trigger(char *glob, struct event_trigger_ops *ops,
+				 struct event_trigger_data *data,
+				 struct ftrace_event_file *file)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	struct event_trigger_data *test;
+	int ret = 0;
+
+	list_for_each_entry_rcu(test, &file->triggers, list) {
+		if (test->cmd_ops->trigger_type == ETT_EVENT_HIST) {
+			struct hist_trigger_data *test_data;
+
+			test_data = test->private_data;
+			if (hist_data->attrs->pause)
+				test_data->attrs->pause = true;
+			else if (hist_data->attrs->cont)
+				test_data->attrs->pause = false;
+			else if (hist_data->attrs->clear)
+				hist_clear(test);
+			else
+				ret = -EEXIST;
+			goto out;
+		}
+	}
+
+	if (hist_data->attrs->cont || hist_data->attrs->clear) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	if (data->ops->init) {
+		ret = data->ops->init(data->ops, data);
+		if (ret < 0)
+			goto out;
+	}
+
+	list_add_rcu(&data->list, &file->triggers);
+	ret++;
+
+	update_cond_flag(file);
+	if (trace_event_trigger_enable_disable(file, 1) < 0) {
+		list_del_rcu(&data->list);
+		update_cond_flag(file);
+		ret--;
+	}
+ out:
+	return ret;
+}
+
+static void hist_unregister_trigger(char *glob, struct event_trigger_ops *ops,
+				    struct event_trigger_data *test,
+				    struct ftrace_event_file *file)
+{
+	struct event_trigger_data *data;
+	bool unregistered = false;
+
+	list_for_each_entry_rcu(data, &file->triggers, list) {
+		if (data->cmd_ops->trigger_type == ETT_EVENT_HIST) {
+			unregistered = true;
+			list_del_rcu(&data->list);
+			update_cond_flag(file);
+			trace_event_trigger_enable_disable(file, 0);
+			break;
+		}
+	}
+
+	if (unregistered && data->ops->free)
+		data->ops->free(data->ops, data);
+}
+
+static int event_hist_trigger_func(struct event_command *cmd_ops,
+				   struct ftrace_event_file *file,
+				   char *glob, char *cmd, char *param)
+{
+	unsigned int hist_trigger_bits = TRACING_MAP_BITS_DEFAULT;
+	struct event_trigger_data *trigger_data;
+	struct hist_trigger_attrs *attrs;
+	struct event_trigger_ops *trigger_ops;
+	struct hist_trigger_data *hist_data;
+	char *trigger;
+	int ret = 0;
+
+	if (!param)
+		return -EINVAL;
+
+	/* separate the trigger from the filter (k:v [if filter]) */
+	trigger = strsep(&param, " \t");
+	if (!trigger)
+		return -EINVAL;
+
+	attrs = parse_hist_trigger_attrs(trigger);
+	if (IS_ERR(attrs))
+		return PTR_ERR(attrs);
+
+	if (attrs->map_bits)
+		hist_trigger_bits = attrs->map_bits;
+
+	hist_data = create_hist_data(hist_trigger_bits, attrs, file);
+	if (IS_ERR(hist_data)) {
+		destroy_hist_trigger_attrs(attrs);
+		return PTR_ERR(hist_data);
+	}
+
+	trigger_ops = cmd_ops->get_trigger_ops(cmd, trigger);
+
+	ret = -ENOMEM;
+	trigger_data = kzalloc(sizeof(*trigger_data), GFP_KERNEL);
+	if (!trigger_data)
+		goto out_free;
+
+	trigger_data->count = -1;
+	trigger_data->ops = trigger_ops;
+	trigger_data->cmd_ops = cmd_ops;
+
+	INIT_LIST_HEAD(&trigger_data->list);
+	RCU_INIT_POINTER(trigger_data->filter, NULL);
+
+	trigger_data->private_data = hist_data;
+
+	if (glob[0] == '!') {
+		struct hist_trigger_data *test_data = find_hist_data(file);
+
+		/* Another trigger's onmatch() still needs its variables */
+		if (test_data && test_data->ref) {
+			ret = -EBUSY;
+			goto out_free;
+		}
+		cmd_ops->unreg(glob+1, trigger_ops, trigger_data, file);
+		ret = 0;
+		goto out_free;
+	}
+
+	if (!param) /* if param is non-empty, it's supposed to be a filter */
+		goto out_reg;
+
+	if (!cmd_ops->set_filter)
+		goto out_reg;
+
+	ret = cmd_ops->set_filter(param, trigger_data, file);
+	if (ret < 0)
+		goto out_free;
+ out_reg:
+	ret = cmd_ops->reg(glob, trigger_ops, trigger_data, file);
+	/*
+	 * The above returns on success the # of triggers registered,
+	 * but if it didn't register any it returns zero.  Consider no
+	 * triggers registered a failure too, unless an existing
+	 * trigger was paused, continued or cleared.
+	 */
+	if (!ret) {
+		if (!(attrs->pause || attrs->cont || attrs->clear))
+			ret = -ENOENT;
+		goto out_free;
+	} else if (ret < 0)
+		goto out_free;
+	/* Just return zero, not the number of registered triggers */
+	ret = 0;
+ out:
+	return ret;
+ out_free:
+	if (cmd_ops->set_filter)
+		cmd_ops->set_filter(NULL, trigger_data, NULL);
+
+	kfree(trigger_data);
+
+	destroy_hist_data(hist_data);
+	goto out;
+}
+
+static struct event_command trigger_hist_cmd = {
+	.name			= "hist",
+	.trigger_type		= ETT_EVENT_HIST,
+	.needs_rec		= true,
+	/* trace() actions log synthetic events to the ring buffer */
+	.post_trigger		= true,
+	.func			= event_hist_trigger_func,
+	.reg			= hist_register_trigger,
+	.unreg			= hist_unregister_trigger,
+	.get_trigger_ops	= event_hist_get_trigger_ops,
+	.set_filter		= set_trigger_filter,
+};
+
+__init int register_trigger_hist_cmd(void)
+{
+	int ret;
+
+	ret = register_event_command(&trigger_hist_cmd);
+	WARN_ON(ret < 0);
+
+	return ret;
+}
+
+static struct synth_event *find_synth_event(const char *name)
+{
+	struct synth_event *event;
+
+	list_for_each_entry(event, &synth_event_list, list) {
+		if (strcmp(event->name, name) == 0)
+			return event;
+	}
+
+	return NULL;
+}
+
+static int init_synth_field(struct synth_field *field, char *type, char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(synth_field_types); i++) {
+		if (strcmp(synth_field_types[i].name, type) == 0)
+			break;
+	}
+
+	if (i == ARRAY_SIZE(synth_field_types) || !*name)
+		return -EINVAL;
+
+	field->name = kstrdup(name, GFP_KERNEL);
+	if (!field->name)
+		return -ENOMEM;
+
+	field->type = synth_field_types[i].name;
+	field->is_signed = synth_field_types[i].is_signed;
+
+	return 0;
+}
+
+static void free_synth_event(struct synth_event *event)
+{
+	unsigned int i;
+
+	for (i = 0; i < event->n_fields; i++)
+		kfree(event->fields[i].name);
+
+	kfree(event->class.system);
+	kfree(event->name);
+	kfree(event);
+}
+
+/* <type> <name>[;] ..., a lone ';' between fields is also accepted */
+static struct synth_event *alloc_synth_event(char *name, int argc,
+					     char **argv)
+{
+	struct synth_event *event;
+	char *field_name;
+	int i, len, ret = -EINVAL;
+
+	event = kzalloc(sizeof(*event), GFP_KERNEL);
+	if (!event)
+		return ERR_PTR(-ENOMEM);
+
+	event->name = kstrdup(name, GFP_KERNEL);
+	event->class.system = kstrdup(SYNTH_SYSTEM, GFP_KERNEL);
+	if (!event->name || !event->class.system) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	for (i = 0; i < argc; i++) {
+		if (strcmp(argv[i], ";") == 0)
+			continue;
+
+		if (event->n_fields == SYNTH_FIELDS_MAX || i + 1 == argc) {
+			ret = -EINVAL;
+			goto free;
+		}
+
+		field_name = argv[i + 1];
+		len = strlen(field_name);
+		if (field_name[len - 1] == ';')
+			field_name[len - 1] = '\0';
+
+		ret = init_synth_field(&event->fields[event->n_fields],
+				       argv[i], field_name);
+		if (ret)
+			goto free;
+
+		event->n_fields++;
+		i++;
+	}
+
+	if (!event->n_fields) {
+		ret = -EINVAL;
+		goto free;
+	}
+
+	return event;
+ free:
+	free_synth_event(event);
+
+	return ERR_PTR(ret);
+}
+
+static int register_synth_event(struct synth_event *event)
+{
+	struct ftrace_event_call *call = &event->call;
+	int ret;
+
+	/* Initialize ftrace_event_call */
+	call->class = &event->class;
+	call->name = event->name;
+	INIT_LIST_HEAD(&call->class->fields);
+	call->event.funcs = &synth_event_funcs;
+	call->class->define_fields = synth_event_define_fields;
+	call->class->reg = synth_event_reg;
+	call->data = event;
+
+	if (set_synth_event_print_fmt(event) < 0)
+		return -ENOMEM;
+	ret = register_ftrace_event(&call->event);
+	if (!ret) {
+		kfree(call->print_fmt);
+		return -ENODEV;
+	}
+	ret = trace_add_event_call(call);
+	if (ret) {
+		pr_info("Failed to register synthetic event: %s\n",
+			event->name);
+		kfree(call->print_fmt);
+		unregister_ftrace_event(&call->event);
+	}
+	return ret;
+}
+
+static int unregister_synth_event(struct synth_event *event)
+{
+	int ret;
+
+	/* event->call.event is unregistered in trace_remove_event_call() */
+	ret = trace_remove_event_call(&event->call);
+	if (!ret)
+		kfree(event->call.print_fmt);
+	return ret;
+}
+
+static int create_synth_event(int argc, char **argv)
+{
+	struct synth_event *event;
+	char *name = argv[0];
+	bool delete = false;
+	int ret = 0;
+
+	/*
+	 * Argument syntax:
+	 *  - Add synthetic event: <event_name> <type> <field>[; <type> <field>]
+	 *  - Remove synthetic event: !<event_name>
+	 */
+	if (name[0] == '!') {
+		delete = true;
+		name++;
+	}
+
+	mutex_lock(&synth_event_mutex);
+
+	event = find_synth_event(name);
+	if (delete) {
+		if (!event) {
+			ret = -ENOENT;
+			goto out;
+		}
+		ret = unregister_synth_event(event);
+		if (!ret) {
+			list_del(&event->list);
+			free_synth_event(event);
+		}
+		goto out;
+	}
+
+	if (event) {
+		ret = -EEXIST;
+		goto out;
+	}
+
+	event = alloc_synth_event(name, argc - 1, argv + 1);
+	if (IS_ERR(event)) {
+		ret = PTR_ERR(event);
+		goto out;
+	}
+
+	ret = register_synth_event(event);
+	if (ret) {
+		free_synth_event(event);
+		goto out;
+	}
+
+	list_add_tail(&event->list, &synth_event_list);
+ out:
+	mutex_unlock(&synth_event_mutex);
+
+	return ret;
+}
+
+static int release_all_synth_events(void)
+{
+	struct synth_event *event, *e;
+	int ret = 0;
+
+	mutex_lock(&synth_event_mutex);
+
+	list_for_each_entry_safe(event, e, &synth_event_list, list) {
+		ret = unregister_synth_event(event);
+		if (ret)
+			break;
+		list_del(&event->list);
+		free_synth_event(event);
+	}
+
+	mutex_unlock(&synth_event_mutex);
+
+	return ret;
+}
+
+static void *synth_events_seq_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&synth_event_mutex);
+	return seq_list_start(&synth_event_list, *pos);
+}
+
+static void *synth_events_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &synth_event_list, pos);
+}
+
+static void synth_events_seq_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&synth_event_mutex);
+}
+
+static int synth_events_seq_show(struct seq_file *m, void *v)
+{
+	struct synth_event *event = v;
+	unsigned int i;
+
+	seq_printf(m, "%s\t", event->name);
+
+	for (i = 0; i < event->n_fields; i++)
+		seq_printf(m, "%s%s %s", i ? "; " : "",
+			   event->fields[i].type, event->fields[i].name);
+
+	seq_putc(m, '\n');
+
+	return 0;
+}
+
+static const struct seq_operations synth_events_seq_op = {
+	.start  = synth_events_seq_start,
+	.next   = synth_events_seq_next,
+	.stop   = synth_events_seq_stop,
+	.show   = synth_events_seq_show
+};
+
+static int synth_events_open(struct inode *inode, struct file *file)
+{
+	int ret;
+
+	if ((file->f_mode & FMODE_WRITE) && (file->f_flags & O_TRUNC)) {
+		ret = release_all_synth_events();
+		if (ret < 0)
+			return ret;
+	}
+
+	return seq_open(file, &synth_events_seq_op);
+}
+
+#define SYNTH_WRITE_BUFSIZE	4096
+
+static ssize_t synth_events_write(struct file *file,
+				  const char __user *buffer,
+				  size_t count, loff_t *ppos)
+{
+	char *kbuf, *buf, *line, *tmp, **argv;
+	int argc, ret = 0;
+
+	if (count >= SYNTH_WRITE_BUFSIZE)
+		return -EINVAL;
+
+	kbuf = kmalloc(count + 1, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+
+	if (copy_from_user(kbuf, buffer, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	kbuf[count] = '\0';
+
+	buf = kbuf;
+	while ((line = strsep(&buf, "\n"))) {
+		/* Remove comments */
+		tmp = strchr(line, '#');
+		if (tmp)
+			*tmp = '\0';
+
+		argv = argv_split(GFP_KERNEL, line, &argc);
+		if (!argv) {
+			ret = -ENOMEM;
+			goto out;
+		}
+
+		if (argc)
+			ret = create_synth_event(argc, argv);
+
+		argv_free(argv);
+
+		if (ret)
+			goto out;
+	}
+	ret = count;
+ out:
+	kfree(kbuf);
+
+	return ret;
+}
+
+static const struct file_operations synth_events_fops = {
+	.open           = synth_events_open,
+	.write		= synth_events_write,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = seq_release,
+};
+
+static __init int trace_events_hist_init(void)
+{
+	struct dentry *d_tracer;
+	struct dentry *entry;
+
+	d_tracer = tracing_init_dentry();
+	if (IS_ERR(d_tracer))
+		return 0;
+
+	entry = tracefs_create_file("synthetic_events", 0644, d_tracer,
+				    NULL, &synth_events_fops);
+	if (!entry)
+		pr_warning("Could not create tracefs 'synthetic_events' entry\n");
+
+	return 0;
+}
+
+fs_initcall(trace_events_hist_init);
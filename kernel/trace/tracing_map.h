@@ -0,0 +1,140 @@
+#ifndef __TRACING_MAP_H
+#define __TRACING_MAP_H
+
+#define TRACING_MAP_BITS_DEFAULT	11
+#define TRACING_MAP_BITS_MAX		17
+#define TRACING_MAP_BITS_MIN		7
+
+#define TRACING_MAP_KEYS_MAX		2
+#define TRACING_MAP_VALS_MAX		3
+#define TRACING_MAP_FIELDS_MAX		(TRACING_MAP_KEYS_MAX + \
+					 TRACING_MAP_VALS_MAX)
+#define TRACING_MAP_SORT_KEYS_MAX	2
+#define TRACING_MAP_VARS_MAX		4
+
+typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
+
+/*
+ * This is an overview of the tracing_map data structures and how they
+ * relate to the tracing_map API.  The details of the algorithms
+ * aren't discussed here - this is just a general overview of the data
+ * structures and how they interact with the API.
+ *
+ * The central data structure of the tracing_map is an initially
+ * zeroed array of struct tracing_map_entry.  Each entry holds the
+ * 32-bit hash of a key and a pointer to the element that holds the
+ * full key and the values aggregated for it.  The array is twice as
+ * large as the maximum number of elements, so that probing stays
+ * short even when the map is nearly full.
+ *
+ * Elements are preallocated when the map is created and handed out
+ * from a free index on first insertion of a key; nothing is ever
+ * allocated or freed on the tracing path.  An entry is claimed with
+ * a cmpxchg() on its hash, so tracing_map_insert() may be called
+ * from any context, including NMI.
+ *
+ * The map keeps one tracing_map_field per field added with
+ * tracing_map_add_sum_field() or tracing_map_add_key_field().  A key
+ * field describes where in the compound key a key value lives, for
+ * sorting; each element carries one 64-bit atomic counter per field,
+ * which is only used for sum fields.
+ *
+ * Each element can also hold up to TRACING_MAP_VARS_MAX variables,
+ * added with tracing_map_add_var().  Unlike sums, a variable is
+ * overwritten rather than accumulated, and remembers whether it has
+ * been set since it was last consumed with tracing_map_read_var_once().
+ * This is what lets a value saved on one event be picked up by a
+ * later, related event looking up the same key.
+ */
+struct tracing_map_field {
+	tracing_map_cmp_fn_t		cmp_fn;
+	unsigned int			offset;
+	bool				is_key;
+};
+
+struct tracing_map_elt {
+	struct tracing_map		*map;
+	atomic64_t			*sums;
+	void				*key;
+	atomic64_t			*vars;
+	bool				*var_set;
+};
+
+struct tracing_map_entry {
+	u32				key;
+	struct tracing_map_elt		*val;
+};
+
+struct tracing_map_sort_key {
+	unsigned int			field_idx;
+	bool				descending;
+};
+
+struct tracing_map_sort_entry {
+	void				*key;
+	struct tracing_map_elt		*elt;
+};
+
+struct tracing_map {
+	unsigned int			key_size;
+	unsigned int			map_bits;
+	unsigned int			map_size;
+	unsigned int			max_elts;
+	atomic_t			next_elt;
+	struct tracing_map_elt		**elts;
+	struct tracing_map_entry	*map;
+	struct tracing_map_sort_key	sort_keys[TRACING_MAP_SORT_KEYS_MAX];
+	unsigned int			n_sort_keys;
+	struct tracing_map_field	fields[TRACING_MAP_FIELDS_MAX];
+	unsigned int			n_fields;
+	unsigned int			n_vars;
+	atomic64_t			hits;
+	atomic64_t			drops;
+};
+
+extern struct tracing_map *tracing_map_create(unsigned int map_bits,
+					      unsigned int key_size);
+extern int tracing_map_init(struct tracing_map *map);
+
+extern int tracing_map_add_sum_field(struct tracing_map *map);
+extern int tracing_map_add_key_field(struct tracing_map *map,
+				     unsigned int offset,
+				     tracing_map_cmp_fn_t cmp_fn);
+extern int tracing_map_add_var(struct tracing_map *map);
+
+extern void tracing_map_destroy(struct tracing_map *map);
+extern void tracing_map_clear(struct tracing_map *map);
+
+extern struct tracing_map_elt *
+tracing_map_insert(struct tracing_map *map, void *key);
+extern struct tracing_map_elt *
+tracing_map_lookup(struct tracing_map *map, void *key);
+
+extern tracing_map_cmp_fn_t tracing_map_cmp_num(int field_size,
+						int field_is_signed);
+extern int tracing_map_cmp_string(void *val_a, void *val_b);
+extern int tracing_map_cmp_none(void *val_a, void *val_b);
+
+extern void tracing_map_update_sum(struct tracing_map_elt *elt,
+				   unsigned int i, u64 n);
+extern u64 tracing_map_read_sum(struct tracing_map_elt *elt, unsigned int i);
+extern void tracing_map_set_var(struct tracing_map_elt *elt,
+				unsigned int i, u64 n);
+extern bool tracing_map_var_set(struct tracing_map_elt *elt, unsigned int i);
+extern u64 tracing_map_read_var(struct tracing_map_elt *elt, unsigned int i);
+extern u64 tracing_map_read_var_once(struct tracing_map_elt *elt,
+				     unsigned int i);
+
+extern void tracing_map_set_sort_key(struct tracing_map *map,
+				     unsigned int i,
+				     unsigned int field_idx,
+				     bool descending);
+
+extern int
+tracing_map_sort_entries(struct tracing_map *map,
+			 struct tracing_map_sort_entry ***sort_entries);
+
+extern void
+tracing_map_destroy_sort_entries(struct tracing_map_sort_entry **entries,
+				 unsigned int n_entries);
+#endif /* __TRACING_MAP_H */
@@ -225,6 +225,17 @@ struct wq_flusher {
 
 struct wq_device;
 
+/*
+ * Run time histogram of the work items of a WQ_SYSFS workqueue.  Bucket
+ * i counts the items which ran for less than 2^i microseconds, the last
+ * one everything longer.
+ */
+#define WQ_EXEC_HIST_BUCKETS	20
+
+struct wq_exec_hist {
+	unsigned long		nr[WQ_EXEC_HIST_BUCKETS];
+};
+
 /*
  * The externally visible workqueue.  It relays the issued work items to
  * the appropriate worker_pool through its pool_workqueues.
@@ -252,6 +263,7 @@ struct workqueue_struct {
 
 #ifdef CONFIG_SYSFS
 	struct wq_device	*wq_dev;	/* I: for sysfs interface */
+	struct wq_exec_hist __percpu *exec_hist; /* I: run time histogram */
 #endif
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map	lockdep_map;
@@ -1287,6 +1299,30 @@ static bool is_chained_work(struct workqueue_struct *wq)
 	return worker && worker->current_pwq->wq == wq;
 }
 
+#ifdef CONFIG_SYSFS
+static inline bool wq_exec_hist_enabled(struct workqueue_struct *wq)
+{
+	return wq->exec_hist;
+}
+
+static void wq_exec_hist_account(struct workqueue_struct *wq, u64 delta)
+{
+	unsigned long usecs = delta >> 10;	/* close enough */
+	int bucket = usecs ? ilog2(usecs) + 1 : 0;
+
+	bucket = min(bucket, WQ_EXEC_HIST_BUCKETS - 1);
+	this_cpu_inc(wq->exec_hist->nr[bucket]);
+}
+#else
+static inline bool wq_exec_hist_enabled(struct workqueue_struct *wq)
+{
+	return false;
+}
+
+static inline void wq_exec_hist_account(struct workqueue_struct *wq,
+					u64 delta) { }
+#endif
+
 static void __queue_work(int cpu, struct workqueue_struct *wq,
 			 struct work_struct *work)
 {
@@ -1417,6 +1453,95 @@ bool queue_work_on(int cpu, struct workqueue_struct *wq,
 }
 EXPORT_SYMBOL(queue_work_on);
 
+/*
+ * Pick the CPU to queue a work item on for a @mask placement hint: the
+ * local CPU if it is in @mask, the first online CPU of @mask otherwise.
+ * If @mask has no online CPU, the hint is dropped.
+ */
+static int workqueue_select_cpu_near(const struct cpumask *mask)
+{
+	int cpu = raw_smp_processor_id();
+
+	if (cpumask_test_cpu(cpu, mask))
+		return cpu;
+
+	cpu = cpumask_any_and(mask, cpu_online_mask);
+	return cpu < nr_cpu_ids ? cpu : WORK_CPU_UNBOUND;
+}
+
+/**
+ * queue_work_node - queue work on a CPU of the given NUMA node
+ * @node: NUMA node that the work should run on
+ * @wq: unbound workqueue to use
+ * @work: work to queue
+ *
+ * Queue @work so that it is executed by the worker pool of @node, e.g.
+ * because the data it touches lives there.  This is only a hint: if
+ * @node is invalid or has no online CPU, or if NUMA affinity is disabled
+ * for unbound workqueues, this behaves like queue_work().
+ *
+ * Return: %false if @work was already on a queue, %true otherwise.
+ */
+bool queue_work_node(int node, struct workqueue_struct *wq,
+		     struct work_struct *work)
+{
+	int cpu = WORK_CPU_UNBOUND;
+	bool ret = false;
+	unsigned long flags;
+
+	/*
+	 * Per-cpu workqueues have no pool per node, the caller should use
+	 * queue_work_on() or queue_work_cpumask() for them.
+	 */
+	WARN_ON_ONCE(!(wq->flags & WQ_UNBOUND));
+
+	local_irq_save(flags);
+
+	if (!test_and_set_bit(WORK_STRUCT_PENDING_BIT, work_data_bits(work))) {
+		if (wq_numa_enabled && node >= 0 && node < MAX_NUMNODES &&
+		    node_online(node))
+			cpu = workqueue_select_cpu_near(cpumask_of_node(node));
+		__queue_work(cpu, wq, work);
+		ret = true;
+	}
+
+	local_irq_restore(flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(queue_work_node);
+
+/**
+ * queue_work_cpumask - queue work on one of a set of CPUs
+ * @mask: CPUs the work should preferably run on
+ * @wq: workqueue to use
+ * @work: work to queue
+ *
+ * Queue @work on the local CPU if it is in @mask, otherwise on an online
+ * CPU of @mask.  For an unbound workqueue this selects the worker pool of
+ * that CPU's node.  For a per-cpu workqueue, as with queue_work_on(), the
+ * caller must ensure the CPUs of @mask can't go away.  If no CPU of @mask
+ * is online, this behaves like queue_work().
+ *
+ * Return: %false if @work was already on a queue, %true otherwise.
+ */
+bool queue_work_cpumask(const struct cpumask *mask,
+			struct workqueue_struct *wq, struct work_struct *work)
+{
+	bool ret = false;
+	unsigned long flags;
+
+	local_irq_save(flags);
+
+	if (!test_and_set_bit(WORK_STRUCT_PENDING_BIT, work_data_bits(work))) {
+		__queue_work(workqueue_select_cpu_near(mask), wq, work);
+		ret = true;
+	}
+
+	local_irq_restore(flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(queue_work_cpumask);
+
 void delayed_work_timer_fn(unsigned long __data)
 {
 	struct delayed_work *dwork = (struct delayed_work *)__data;
@@ -1952,6 +2077,7 @@ __acquires(&pool->lock)
 	bool cpu_intensive = pwq->wq->flags & WQ_CPU_INTENSIVE;
 	int work_color;
 	struct worker *collision;
+	u64 exec_start = 0;
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -2021,6 +2147,8 @@ __acquires(&pool->lock)
 
 	lock_map_acquire_read(&pwq->wq->lockdep_map);
 	lock_map_acquire(&lockdep_map);
+	if (wq_exec_hist_enabled(pwq->wq))
+		exec_start = local_clock();
 	trace_workqueue_execute_start(work);
 	worker->current_func(work);
 	/*
@@ -2028,6 +2156,8 @@ __acquires(&pool->lock)
 	 * point will only record its address.
 	 */
 	trace_workqueue_execute_end(work);
+	if (exec_start)
+		wq_exec_hist_account(pwq->wq, local_clock() - exec_start);
 	lock_map_release(&lockdep_map);
 	lock_map_release(&pwq->wq->lockdep_map);
 
@@ -3130,6 +3260,9 @@ static void rcu_free_wq(struct rcu_head *rcu)
 	else
 		free_workqueue_attrs(wq->unbound_attrs);
 
+#ifdef CONFIG_SYSFS
+	free_percpu(wq->exec_hist);
+#endif
 	kfree(wq->rescuer);
 	kfree(wq);
 }
@@ -4706,6 +4839,8 @@ out_unlock:
  *
  *  per_cpu	RO bool	: whether the workqueue is per-cpu or unbound
  *  max_active	RW int	: maximum number of in-flight work items
+ *  exec_hist	RO	: run time histogram of the work items, one
+ *			  "<upper bound in usecs> <count>" line per bucket
  *
  * Unbound workqueues have the following extra attributes.
  *
@@ -4757,9 +4892,37 @@ static ssize_t max_active_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(max_active);
 
+static ssize_t exec_hist_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	unsigned long nr[WQ_EXEC_HIST_BUCKETS] = { };
+	int written = 0;
+	int cpu, i;
+
+	if (!wq->exec_hist)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct wq_exec_hist *hist = per_cpu_ptr(wq->exec_hist, cpu);
+
+		for (i = 0; i < WQ_EXEC_HIST_BUCKETS; i++)
+			nr[i] += hist->nr[i];
+	}
+
+	for (i = 0; i < WQ_EXEC_HIST_BUCKETS - 1; i++)
+		written += scnprintf(buf + written, PAGE_SIZE - written,
+				     "%lu %lu\n", 1UL << i, nr[i]);
+	written += scnprintf(buf + written, PAGE_SIZE - written,
+			     "inf %lu\n", nr[i]);
+	return written;
+}
+static DEVICE_ATTR_RO(exec_hist);
+
 static struct attribute *wq_sysfs_attrs[] = {
 	&dev_attr_per_cpu.attr,
 	&dev_attr_max_active.attr,
+	&dev_attr_exec_hist.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(wq_sysfs);
@@ -4955,6 +5118,13 @@ int workqueue_sysfs_register(struct workqueue_struct *wq)
 	if (WARN_ON(wq->flags & __WQ_ORDERED))
 		return -EINVAL;
 
+	/* freed along with @wq, see rcu_free_wq() */
+	if (!wq->exec_hist) {
+		wq->exec_hist = alloc_percpu(struct wq_exec_hist);
+		if (!wq->exec_hist)
+			return -ENOMEM;
+	}
+
 	wq->wq_dev = wq_dev = kzalloc(sizeof(*wq_dev), GFP_KERNEL);
 	if (!wq_dev)
 		return -ENOMEM;
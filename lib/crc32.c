@@ -32,6 +32,25 @@
 #include <linux/sched.h>
 #include "crc32defs.h"
 
+#ifdef CONFIG_X86
+#include <asm/crc32c.h>
+#else
+static inline bool crc32c_arch_usable(void)
+{
+	return false;
+}
+
+static inline u32 crc32c_le_arch(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc;
+}
+
+static inline void crc32c_le_arch_3way(u32 *crc, unsigned char const *const *p,
+				       size_t len)
+{
+}
+#endif
+
 #if CRC_LE_BITS > 8
 # define tole(x) ((__force u32) cpu_to_le32(x))
 #else
@@ -186,7 +205,8 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 {
 	return crc32_le_generic(crc, p, len, NULL, CRCPOLY_LE);
 }
-u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure __crc32c_le_generic(u32 crc, unsigned char const *p,
+				      size_t len)
 {
 	return crc32_le_generic(crc, p, len, NULL, CRC32C_POLY_LE);
 }
@@ -196,15 +216,59 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 	return crc32_le_generic(crc, p, len,
 			(const u32 (*)[256])crc32table_le, CRCPOLY_LE);
 }
-u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+static u32 __pure __crc32c_le_generic(u32 crc, unsigned char const *p,
+				      size_t len)
 {
 	return crc32_le_generic(crc, p, len,
 			(const u32 (*)[256])crc32ctable_le, CRC32C_POLY_LE);
 }
 #endif
 EXPORT_SYMBOL(crc32_le);
+
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	if (crc32c_arch_usable())
+		return crc32c_le_arch(crc, p, len);
+	return __crc32c_le_generic(crc, p, len);
+}
 EXPORT_SYMBOL(__crc32c_le);
 
+/**
+ * __crc32c_le_multi - calculate the crc32c of several equally sized buffers
+ * @crc: array of @nr seeds, replaced by the checksum of each buffer
+ * @p: array of @nr buffers
+ * @len: length of each buffer
+ * @nr: number of buffers
+ *
+ * Equivalent to calling __crc32c_le() on each buffer in turn, but lets the
+ * architecture code work on several buffers at once when it can.
+ */
+void __crc32c_le_multi(u32 *crc, unsigned char const *const *p, size_t len,
+		       unsigned int nr)
+{
+	unsigned int i = 0;
+
+	if (crc32c_arch_usable()) {
+		for (; i + 3 <= nr; i += 3)
+			crc32c_le_arch_3way(crc + i, p + i, len);
+	}
+	for (; i < nr; i++)
+		crc[i] = __crc32c_le(crc[i], p[i], len);
+}
+EXPORT_SYMBOL(__crc32c_le_multi);
+
+/**
+ * crc32c_le_accelerated - whether __crc32c_le() uses an arch implementation
+ *
+ * Lets users that would otherwise go through the crypto API to find a fast
+ * crc32c know that calling the library directly is at least as good.
+ */
+bool crc32c_le_accelerated(void)
+{
+	return crc32c_arch_usable();
+}
+EXPORT_SYMBOL(crc32c_le_accelerated);
+
 /*
  * This multiplies the polynomials x and y modulo the given modulus.
  * This follows the "little-endian" CRC convention that the lsbit
@@ -32,19 +32,30 @@
  */
 
 #include <crypto/hash.h>
+#include <linux/crc32.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/string.h>
 
 static struct crypto_shash *tfm;
 
+/*
+ * Skip the crypto API when the library routine is what it would end up
+ * calling anyway, or when the library has its own arch implementation.
+ */
+static bool crc32c_direct __read_mostly;
+
 u32 crc32c(u32 crc, const void *address, unsigned int length)
 {
 	SHASH_DESC_ON_STACK(shash, tfm);
 	u32 *ctx = (u32 *)shash_desc_ctx(shash);
 	int err;
 
+	if (crc32c_direct)
+		return __crc32c_le(crc, address, length);
+
 	shash->tfm = tfm;
 	shash->flags = 0;
 	*ctx = crc;
@@ -60,7 +71,13 @@ EXPORT_SYMBOL(crc32c);
 static int __init libcrc32c_mod_init(void)
 {
 	tfm = crypto_alloc_shash("crc32c", 0, 0);
-	return PTR_ERR_OR_ZERO(tfm);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	crc32c_direct = crc32c_le_accelerated() ||
+		!strcmp(crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm)),
+			"crc32c-generic");
+	return 0;
 }
 
 static void __exit libcrc32c_mod_fini(void)
@@ -0,0 +1,313 @@
+/*
+ * Dynamic interrupt moderation.  See include/linux/net_dim.h
+ */
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/net_dim.h>
+#include <linux/export.h>
+
+enum {
+	NET_DIM_START_MEASURE,
+	NET_DIM_MEASURE_IN_PROGRESS,
+	NET_DIM_APPLY_NEW_PROFILE,
+};
+
+enum {
+	NET_DIM_PARKING_ON_TOP,
+	NET_DIM_PARKING_TIRED,
+	NET_DIM_GOING_RIGHT,
+	NET_DIM_GOING_LEFT,
+};
+
+enum {
+	NET_DIM_STATS_WORSE,
+	NET_DIM_STATS_SAME,
+	NET_DIM_STATS_BETTER,
+};
+
+enum {
+	NET_DIM_STEPPED,
+	NET_DIM_TOO_TIRED,
+	NET_DIM_ON_EDGE,
+};
+
+/* From low latency to high packet rates */
+static const struct net_dim_cq_moder net_dim_profiles[] = {
+	{ 1,   256 },
+	{ 8,   256 },
+	{ 64,  256 },
+	{ 128, 256 },
+	{ 256, 256 },
+};
+
+/* more than 10% difference */
+#define IS_SIGNIFICANT_DIFF(val, ref) \
+	(((100 * abs((val) - (ref))) / (ref)) > 10)
+
+struct net_dim_cq_moder net_dim_get_profile(unsigned int profile_ix)
+{
+	BUILD_BUG_ON(ARRAY_SIZE(net_dim_profiles) !=
+		     NET_DIM_PARAMS_NUM_PROFILES);
+
+	if (profile_ix >= NET_DIM_PARAMS_NUM_PROFILES)
+		profile_ix = NET_DIM_PARAMS_NUM_PROFILES - 1;
+	return net_dim_profiles[profile_ix];
+}
+EXPORT_SYMBOL(net_dim_get_profile);
+
+static bool net_dim_on_top(struct net_dim *dim)
+{
+	switch (dim->tune_state) {
+	case NET_DIM_PARKING_ON_TOP:
+	case NET_DIM_PARKING_TIRED:
+		return true;
+	case NET_DIM_GOING_RIGHT:
+		return (dim->steps_left > 1) && (dim->steps_right == 1);
+	default: /* NET_DIM_GOING_LEFT */
+		return (dim->steps_right > 1) && (dim->steps_left == 1);
+	}
+}
+
+static void net_dim_turn(struct net_dim *dim)
+{
+	switch (dim->tune_state) {
+	case NET_DIM_PARKING_ON_TOP:
+	case NET_DIM_PARKING_TIRED:
+		break;
+	case NET_DIM_GOING_RIGHT:
+		dim->tune_state = NET_DIM_GOING_LEFT;
+		dim->steps_left = 0;
+		break;
+	case NET_DIM_GOING_LEFT:
+		dim->tune_state = NET_DIM_GOING_RIGHT;
+		dim->steps_right = 0;
+		break;
+	}
+}
+
+static int net_dim_step(struct net_dim *dim)
+{
+	if (dim->tired == (NET_DIM_PARAMS_NUM_PROFILES * 2))
+		return NET_DIM_TOO_TIRED;
+
+	switch (dim->tune_state) {
+	case NET_DIM_PARKING_ON_TOP:
+	case NET_DIM_PARKING_TIRED:
+		break;
+	case NET_DIM_GOING_RIGHT:
+		if (dim->profile_ix == (NET_DIM_PARAMS_NUM_PROFILES - 1))
+			return NET_DIM_ON_EDGE;
+		dim->profile_ix++;
+		dim->steps_right++;
+		break;
+	case NET_DIM_GOING_LEFT:
+		if (dim->profile_ix == 0)
+			return NET_DIM_ON_EDGE;
+		dim->profile_ix--;
+		dim->steps_left++;
+		break;
+	}
+
+	dim->tired++;
+	return NET_DIM_STEPPED;
+}
+
+static void net_dim_park_on_top(struct net_dim *dim)
+{
+	dim->steps_right = 0;
+	dim->steps_left = 0;
+	dim->tired = 0;
+	dim->tune_state = NET_DIM_PARKING_ON_TOP;
+}
+
+static void net_dim_park_tired(struct net_dim *dim)
+{
+	dim->steps_right = 0;
+	dim->steps_left = 0;
+	dim->tune_state = NET_DIM_PARKING_TIRED;
+}
+
+static void net_dim_exit_parking(struct net_dim *dim)
+{
+	dim->tune_state = dim->profile_ix ? NET_DIM_GOING_LEFT :
+					    NET_DIM_GOING_RIGHT;
+	net_dim_step(dim);
+}
+
+/* Throughput counts first, then packet rate, then fewer interrupts */
+static int net_dim_stats_compare(struct net_dim_stats *curr,
+				 struct net_dim_stats *prev)
+{
+	if (!prev->bpms)
+		return curr->bpms ? NET_DIM_STATS_BETTER : NET_DIM_STATS_SAME;
+
+	if (IS_SIGNIFICANT_DIFF(curr->bpms, prev->bpms))
+		return (curr->bpms > prev->bpms) ? NET_DIM_STATS_BETTER :
+						   NET_DIM_STATS_WORSE;
+
+	if (!prev->ppms)
+		return curr->ppms ? NET_DIM_STATS_BETTER : NET_DIM_STATS_SAME;
+
+	if (IS_SIGNIFICANT_DIFF(curr->ppms, prev->ppms))
+		return (curr->ppms > prev->ppms) ? NET_DIM_STATS_BETTER :
+						   NET_DIM_STATS_WORSE;
+
+	if (!prev->epms)
+		return NET_DIM_STATS_SAME;
+
+	if (IS_SIGNIFICANT_DIFF(curr->epms, prev->epms))
+		return (curr->epms < prev->epms) ? NET_DIM_STATS_BETTER :
+						   NET_DIM_STATS_WORSE;
+
+	return NET_DIM_STATS_SAME;
+}
+
+/* Returns true if the profile changed */
+static bool net_dim_decision(struct net_dim_stats *curr_stats,
+			     struct net_dim *dim)
+{
+	int prev_state = dim->tune_state;
+	int prev_ix = dim->profile_ix;
+	int stats_res;
+	int step_res;
+
+	switch (dim->tune_state) {
+	case NET_DIM_PARKING_ON_TOP:
+		stats_res = net_dim_stats_compare(curr_stats, &dim->prev_stats);
+		if (stats_res != NET_DIM_STATS_SAME)
+			net_dim_exit_parking(dim);
+		break;
+
+	case NET_DIM_PARKING_TIRED:
+		dim->tired--;
+		if (!dim->tired)
+			net_dim_exit_parking(dim);
+		break;
+
+	case NET_DIM_GOING_RIGHT:
+	case NET_DIM_GOING_LEFT:
+		stats_res = net_dim_stats_compare(curr_stats, &dim->prev_stats);
+		if (stats_res != NET_DIM_STATS_BETTER)
+			net_dim_turn(dim);
+
+		if (net_dim_on_top(dim)) {
+			net_dim_park_on_top(dim);
+			break;
+		}
+
+		step_res = net_dim_step(dim);
+		switch (step_res) {
+		case NET_DIM_ON_EDGE:
+			net_dim_park_on_top(dim);
+			break;
+		case NET_DIM_TOO_TIRED:
+			net_dim_park_tired(dim);
+			break;
+		}
+
+		break;
+	}
+
+	if ((prev_state != NET_DIM_PARKING_ON_TOP) ||
+	    (dim->tune_state != NET_DIM_PARKING_ON_TOP))
+		dim->prev_stats = *curr_stats;
+
+	return dim->profile_ix != prev_ix;
+}
+
+static bool net_dim_calc_stats(struct net_dim_sample *start,
+			       struct net_dim_sample *end,
+			       struct net_dim_stats *curr_stats)
+{
+	/* u32 holds up to 71 minutes, should be enough */
+	u32 delta_us = ktime_us_delta(end->time, start->time);
+	u32 npkts = end->pkt_ctr - start->pkt_ctr;
+	u32 nbytes = end->byte_ctr - start->byte_ctr;
+
+	if (!delta_us)
+		return false;
+
+	curr_stats->ppms = DIV_ROUND_UP_ULL((u64)npkts * USEC_PER_MSEC,
+					    delta_us);
+	curr_stats->bpms = DIV_ROUND_UP_ULL((u64)nbytes * USEC_PER_MSEC,
+					    delta_us);
+	curr_stats->epms = DIV_ROUND_UP(NET_DIM_NEVENTS * USEC_PER_MSEC,
+					delta_us);
+	return true;
+}
+
+/**
+ * net_dim - account a sample and pick a new profile if due
+ * @dim: the moderation state of the queue
+ * @end_sample: counters of the queue as of now, see net_dim_sample()
+ *
+ * To be called from NAPI poll when it completes, i.e. once per event.
+ */
+void net_dim(struct net_dim *dim, struct net_dim_sample *end_sample)
+{
+	struct net_dim_stats curr_stats;
+	u16 nevents;
+
+	switch (dim->state) {
+	case NET_DIM_MEASURE_IN_PROGRESS:
+		nevents = end_sample->event_ctr - dim->start_sample.event_ctr;
+		if (nevents < NET_DIM_NEVENTS)
+			break;
+		if (net_dim_calc_stats(&dim->start_sample, end_sample,
+				       &curr_stats) &&
+		    net_dim_decision(&curr_stats, dim)) {
+			dim->state = NET_DIM_APPLY_NEW_PROFILE;
+			schedule_work(&dim->work);
+			break;
+		}
+		/* fall through */
+	case NET_DIM_START_MEASURE:
+		dim->start_sample = *end_sample;
+		dim->state = NET_DIM_MEASURE_IN_PROGRESS;
+		break;
+	case NET_DIM_APPLY_NEW_PROFILE:
+		break;
+	}
+}
+EXPORT_SYMBOL(net_dim);
+
+static void net_dim_work(struct work_struct *work)
+{
+	struct net_dim *dim = container_of(work, struct net_dim, work);
+
+	dim->apply(dim, dim->profile_ix);
+	/* measure the new profile from scratch */
+	dim->state = NET_DIM_START_MEASURE;
+}
+
+/**
+ * net_dim_init - set up the moderation state of a queue
+ * @dim: the state to initialize
+ * @profile_ix: profile the queue starts with
+ * @apply: called from process context to switch the queue to a profile
+ */
+void net_dim_init(struct net_dim *dim, unsigned int profile_ix,
+		  void (*apply)(struct net_dim *dim, unsigned int profile_ix))
+{
+	memset(dim, 0, sizeof(*dim));
+	dim->state = NET_DIM_START_MEASURE;
+	dim->tune_state = NET_DIM_GOING_RIGHT;
+	dim->profile_ix = min_t(unsigned int, profile_ix,
+				NET_DIM_PARAMS_NUM_PROFILES - 1);
+	dim->apply = apply;
+	INIT_WORK(&dim->work, net_dim_work);
+}
+EXPORT_SYMBOL(net_dim_init);
+
+/**
+ * net_dim_cancel - wait for a pending profile change to finish
+ * @dim: the moderation state of the queue
+ *
+ * The caller must have stopped calling net_dim() for the queue, e.g. by
+ * disabling its NAPI context.
+ */
+void net_dim_cancel(struct net_dim *dim)
+{
+	cancel_work_sync(&dim->work);
+}
+EXPORT_SYMBOL(net_dim_cancel);
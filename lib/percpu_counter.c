@@ -9,6 +9,7 @@
 #include <linux/cpu.h>
 #include <linux/module.h>
 #include <linux/debugobjects.h>
+#include <linux/math64.h>
 
 #ifdef CONFIG_HOTPLUG_CPU
 static LIST_HEAD(percpu_counters);
@@ -194,16 +195,18 @@ static int percpu_counter_hotcpu_callback(struct notifier_block *nb,
 }
 
 /*
- * Compare counter against given value.
+ * Compare counter against given value, using the batch the counter is
+ * updated with.  The per-cpu counts are only summed up when the rough
+ * count is within the error that batch allows.
  * Return 1 if greater, 0 if equal and -1 if less
  */
-int percpu_counter_compare(struct percpu_counter *fbc, s64 rhs)
+int __percpu_counter_compare(struct percpu_counter *fbc, s64 rhs, s32 batch)
 {
 	s64	count;
 
 	count = percpu_counter_read(fbc);
 	/* Check to see if rough count will be sufficient for comparison */
-	if (abs(count - rhs) > (percpu_counter_batch*num_online_cpus())) {
+	if (abs(count - rhs) > ((s64)batch * num_online_cpus())) {
 		if (count > rhs)
 			return 1;
 		else
@@ -218,7 +221,26 @@ int percpu_counter_compare(struct percpu_counter *fbc, s64 rhs)
 	else
 		return 0;
 }
-EXPORT_SYMBOL(percpu_counter_compare);
+EXPORT_SYMBOL(__percpu_counter_compare);
+
+/*
+ * Batch to update a counter with which is checked against @limit.  Far
+ * from the limit this is percpu_counter_batch.  Closer to it, the batch
+ * is shrunk so that the per-cpu counts together can't exceed half of the
+ * distance, so __percpu_counter_compare() with the same batch keeps
+ * getting away with the rough count.
+ */
+s32 percpu_counter_limit_batch(struct percpu_counter *fbc, s64 limit)
+{
+	s64 room = abs(limit - percpu_counter_read(fbc));
+	s32 nr = 2 * num_online_cpus();
+
+	if (room >= (s64)percpu_counter_batch * nr)
+		return percpu_counter_batch;
+
+	return max_t(s32, div_s64(room, nr), 1);
+}
+EXPORT_SYMBOL(percpu_counter_limit_batch);
 
 static int __init percpu_counter_startup(void)
 {
@@ -27,12 +27,13 @@ struct raid6_calls raid6_call;
 char *dataptrs[NDISKS];
 char data[NDISKS][PAGE_SIZE];
 char recovi[PAGE_SIZE], recovj[PAGE_SIZE];
+char syndp[PAGE_SIZE], syndq[PAGE_SIZE];
 
-static void makedata(void)
+static void makedata(int start, int stop)
 {
 	int i, j;
 
-	for (i = 0; i < NDISKS; i++) {
+	for (i = start; i <= stop; i++) {
 		for (j = 0; j < PAGE_SIZE; j++)
 			data[i][j] = rand();
 
@@ -87,6 +88,34 @@ static int test_disks(int i, int j)
 	return erra || errb;
 }
 
+/*
+ * Rewrite data disks start..stop the way a read-modify-write does: take
+ * the old data out of P/Q, put the new data in, and check the result
+ * against a freshly generated syndrome.
+ */
+static int test_xor(int start, int stop)
+{
+	int err;
+
+	raid6_call.xor_syndrome(NDISKS, start, stop, PAGE_SIZE,
+				(void **)&dataptrs);
+	makedata(start, stop);
+	raid6_call.xor_syndrome(NDISKS, start, stop, PAGE_SIZE,
+				(void **)&dataptrs);
+
+	memcpy(syndp, data[NDISKS-2], PAGE_SIZE);
+	memcpy(syndq, data[NDISKS-1], PAGE_SIZE);
+	raid6_call.gen_syndrome(NDISKS, PAGE_SIZE, (void **)&dataptrs);
+
+	err = memcmp(syndp, data[NDISKS-2], PAGE_SIZE) ||
+		memcmp(syndq, data[NDISKS-1], PAGE_SIZE);
+	if (err)
+		printf("algo=%-8s  xor start=%3d  stop=%3d  ERR\n",
+		       raid6_call.name, start, stop);
+
+	return err;
+}
+
 int main(int argc, char *argv[])
 {
 	const struct raid6_calls *const *algo;
@@ -94,7 +123,7 @@ int main(int argc, char *argv[])
 	int i, j;
 	int err = 0;
 
-	makedata();
+	makedata(0, NDISKS-1);
 
 	for (ra = raid6_recov_algos; *ra; ra++) {
 		if ((*ra)->valid  && !(*ra)->valid())
@@ -118,6 +147,13 @@ int main(int argc, char *argv[])
 				for (i = 0; i < NDISKS-1; i++)
 					for (j = i+1; j < NDISKS; j++)
 						err += test_disks(i, j);
+
+				if (!raid6_call.xor_syndrome)
+					continue;
+
+				for (i = 0; i < NDISKS-2; i++)
+					for (j = i; j < NDISKS-2; j++)
+						err += test_xor(i, j);
 			}
 		}
 		printf("\n");
@@ -29,6 +29,9 @@
 #include <linux/ctype.h>
 #include <linux/highmem.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
 
 #include <asm/io.h>
 #include <asm/dma.h>
@@ -80,7 +83,26 @@ static phys_addr_t io_tlb_overflow_buffer;
  * each index
  */
 static unsigned int *io_tlb_list;
-static unsigned int io_tlb_index;
+
+/*
+ * The slots are split into io_tlb_nareas areas of io_tlb_area_nslabs slots
+ * each, with their own lock and search index, so that the map and unmap
+ * calls of different CPUs don't serialize on a single lock.  A CPU starts
+ * looking in its own area and only moves on to the others when that one
+ * is full.  Areas are made of whole segments, so no mapping crosses one.
+ */
+struct io_tlb_area {
+	spinlock_t lock;
+	unsigned int index;	/* next slot to look at, from the area start */
+	unsigned long used;	/* slots in use */
+} ____cacheline_aligned_in_smp;
+
+static struct io_tlb_area *io_tlb_areas;
+static unsigned int io_tlb_nareas;
+static unsigned long io_tlb_area_nslabs;
+
+/* Number of mappings that failed because the pool was full */
+static atomic_long_t io_tlb_full;
 
 /*
  * We need to save away the original address corresponding to a mapped entry
@@ -89,13 +111,15 @@ static unsigned int io_tlb_index;
 #define INVALID_PHYS_ADDR (~(phys_addr_t)0)
 static phys_addr_t *io_tlb_orig_addr;
 
-/*
- * Protect the above data structures in the map and unmap calls
- */
-static DEFINE_SPINLOCK(io_tlb_lock);
-
 static int late_alloc;
 
+/*
+ * swiotlb=<nslabs>[,<nareas>][,force]
+ *
+ * The number of areas defaults to the number of possible cpus; it is
+ * rounded up to a power of two and reduced until every area holds whole
+ * segments.
+ */
 static int __init
 setup_io_tlb_npages(char *str)
 {
@@ -104,6 +128,13 @@ setup_io_tlb_npages(char *str)
 		/* avoid tail segment of size < IO_TLB_SEGSIZE */
 		io_tlb_nslabs = ALIGN(io_tlb_nslabs, IO_TLB_SEGSIZE);
 	}
+	if (*str == ',')
+		++str;
+	if (isdigit(*str)) {
+		io_tlb_nareas = simple_strtoul(str, &str, 0);
+		if (io_tlb_nareas)
+			io_tlb_nareas = roundup_pow_of_two(io_tlb_nareas);
+	}
 	if (*str == ',')
 		++str;
 	if (!strcmp(str, "force"))
@@ -153,16 +184,53 @@ void swiotlb_print_info(void)
 	vstart = phys_to_virt(io_tlb_start);
 	vend = phys_to_virt(io_tlb_end);
 
-	printk(KERN_INFO "software IO TLB [mem %#010llx-%#010llx] (%luMB) mapped at [%p-%p]\n",
+	printk(KERN_INFO "software IO TLB [mem %#010llx-%#010llx] (%luMB, %u areas) mapped at [%p-%p]\n",
 	       (unsigned long long)io_tlb_start,
 	       (unsigned long long)io_tlb_end,
-	       bytes >> 20, vstart, vend - 1);
+	       bytes >> 20, io_tlb_nareas, vstart, vend - 1);
+}
+
+/*
+ * Number of areas to split nslabs slots into: the one asked for on the
+ * command line or the number of possible cpus, as a power of two, and
+ * small enough for every area to hold whole segments.
+ */
+static unsigned int swiotlb_nareas(unsigned long nslabs)
+{
+	unsigned int nareas = io_tlb_nareas;
+
+	if (!nareas)
+		nareas = roundup_pow_of_two(num_possible_cpus());
+
+	while (nareas > 1 &&
+	       (nslabs % nareas || (nslabs / nareas) % IO_TLB_SEGSIZE))
+		nareas >>= 1;
+
+	return nareas;
+}
+
+static void swiotlb_init_areas(struct io_tlb_area *areas,
+			       unsigned int nareas)
+{
+	unsigned int i;
+
+	for (i = 0; i < nareas; i++) {
+		spin_lock_init(&areas[i].lock);
+		areas[i].index = 0;
+		areas[i].used = 0;
+	}
+
+	io_tlb_areas = areas;
+	io_tlb_nareas = nareas;
+	io_tlb_area_nslabs = io_tlb_nslabs / nareas;
 }
 
 int __init swiotlb_init_with_tbl(char *tlb, unsigned long nslabs, int verbose)
 {
 	void *v_overflow_buffer;
+	struct io_tlb_area *areas;
 	unsigned long i, bytes;
+	unsigned int nareas;
 
 	bytes = nslabs << IO_TLB_SHIFT;
 
@@ -196,7 +264,10 @@ int __init swiotlb_init_with_tbl(char *tlb, unsigned long nslabs, int verbose)
 		io_tlb_list[i] = IO_TLB_SEGSIZE - OFFSET(i, IO_TLB_SEGSIZE);
 		io_tlb_orig_addr[i] = INVALID_PHYS_ADDR;
 	}
-	io_tlb_index = 0;
+
+	nareas = swiotlb_nareas(io_tlb_nslabs);
+	areas = memblock_virt_alloc(nareas * sizeof(*areas), SMP_CACHE_BYTES);
+	swiotlb_init_areas(areas, nareas);
 
 	if (verbose)
 		swiotlb_print_info();
@@ -287,6 +358,8 @@ swiotlb_late_init_with_tbl(char *tlb, unsigned long nslabs)
 {
 	unsigned long i, bytes;
 	unsigned char *v_overflow_buffer;
+	struct io_tlb_area *areas;
+	unsigned int nareas;
 
 	bytes = nslabs << IO_TLB_SHIFT;
 
@@ -323,11 +396,16 @@ swiotlb_late_init_with_tbl(char *tlb, unsigned long nslabs)
 	if (!io_tlb_orig_addr)
 		goto cleanup4;
 
+	nareas = swiotlb_nareas(io_tlb_nslabs);
+	areas = kcalloc(nareas, sizeof(*areas), GFP_KERNEL);
+	if (!areas)
+		goto cleanup5;
+
 	for (i = 0; i < io_tlb_nslabs; i++) {
 		io_tlb_list[i] = IO_TLB_SEGSIZE - OFFSET(i, IO_TLB_SEGSIZE);
 		io_tlb_orig_addr[i] = INVALID_PHYS_ADDR;
 	}
-	io_tlb_index = 0;
+	swiotlb_init_areas(areas, nareas);
 
 	swiotlb_print_info();
 
@@ -335,6 +413,10 @@ swiotlb_late_init_with_tbl(char *tlb, unsigned long nslabs)
 
 	return 0;
 
+cleanup5:
+	free_pages((unsigned long)io_tlb_orig_addr,
+		   get_order(io_tlb_nslabs * sizeof(phys_addr_t)));
+	io_tlb_orig_addr = NULL;
 cleanup4:
 	free_pages((unsigned long)io_tlb_list, get_order(io_tlb_nslabs *
 	                                                 sizeof(int)));
@@ -356,6 +438,7 @@ void __init swiotlb_free(void)
 		return;
 
 	if (late_alloc) {
+		kfree(io_tlb_areas);
 		free_pages((unsigned long)phys_to_virt(io_tlb_overflow_buffer),
 			   get_order(io_tlb_overflow));
 		free_pages((unsigned long)io_tlb_orig_addr,
@@ -365,6 +448,8 @@ void __init swiotlb_free(void)
 		free_pages((unsigned long)phys_to_virt(io_tlb_start),
 			   get_order(io_tlb_nslabs << IO_TLB_SHIFT));
 	} else {
+		memblock_free_late(__pa(io_tlb_areas),
+				   io_tlb_nareas * sizeof(*io_tlb_areas));
 		memblock_free_late(io_tlb_overflow_buffer,
 				   PAGE_ALIGN(io_tlb_overflow));
 		memblock_free_late(__pa(io_tlb_orig_addr),
@@ -374,6 +459,7 @@ void __init swiotlb_free(void)
 		memblock_free_late(io_tlb_start,
 				   PAGE_ALIGN(io_tlb_nslabs << IO_TLB_SHIFT));
 	}
+	io_tlb_areas = NULL;
 	io_tlb_nslabs = 0;
 }
 
@@ -422,15 +508,80 @@ static void swiotlb_bounce(phys_addr_t orig_addr, phys_addr_t tlb_addr,
 	}
 }
 
+/*
+ * Find nslots free contiguous slots in an area and mark them as used.
+ * Returns the index of the first one, or -1 if the area has no room.
+ */
+static int swiotlb_area_find_slots(unsigned int area_index,
+				   unsigned int nslots, unsigned int stride,
+				   unsigned long offset_slots,
+				   unsigned long max_slots)
+{
+	struct io_tlb_area *area = &io_tlb_areas[area_index];
+	unsigned int area_start = area_index * io_tlb_area_nslabs;
+	unsigned int area_end = area_start + io_tlb_area_nslabs;
+	unsigned int index, wrap;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&area->lock, flags);
+	index = area_start + ALIGN(area->index, stride);
+	if (index >= area_end)
+		index = area_start;
+	wrap = index;
+
+	do {
+		while (iommu_is_span_boundary(index, nslots, offset_slots,
+					      max_slots)) {
+			index += stride;
+			if (index >= area_end)
+				index = area_start;
+			if (index == wrap)
+				goto not_found;
+		}
+
+		/*
+		 * If we find a slot that indicates we have 'nslots' number of
+		 * contiguous buffers, we allocate the buffers from that slot
+		 * and mark the entries as '0' indicating unavailable.
+		 */
+		if (io_tlb_list[index] >= nslots) {
+			int count = 0;
+
+			for (i = index; i < (int) (index + nslots); i++)
+				io_tlb_list[i] = 0;
+			for (i = index - 1; (OFFSET(i, IO_TLB_SEGSIZE) != IO_TLB_SEGSIZE - 1) && io_tlb_list[i]; i--)
+				io_tlb_list[i] = ++count;
+
+			/*
+			 * Update the indices to avoid searching in the next
+			 * round.
+			 */
+			area->index = ((index + nslots) < area_end
+				       ? (index + nslots - area_start) : 0);
+			area->used += nslots;
+
+			spin_unlock_irqrestore(&area->lock, flags);
+			return index;
+		}
+		index += stride;
+		if (index >= area_end)
+			index = area_start;
+	} while (index != wrap);
+
+not_found:
+	spin_unlock_irqrestore(&area->lock, flags);
+	return -1;
+}
+
 phys_addr_t swiotlb_tbl_map_single(struct device *hwdev,
 				   dma_addr_t tbl_dma_addr,
 				   phys_addr_t orig_addr, size_t size,
 				   enum dma_data_direction dir)
 {
-	unsigned long flags;
 	phys_addr_t tlb_addr;
-	unsigned int nslots, stride, index, wrap;
-	int i;
+	unsigned int nslots, stride, start, area_index;
+	int i, index;
 	unsigned long mask;
 	unsigned long offset_slots;
 	unsigned long max_slots;
@@ -465,59 +616,26 @@ phys_addr_t swiotlb_tbl_map_single(struct device *hwdev,
 
 	/*
 	 * Find suitable number of IO TLB entries size that will fit this
-	 * request and allocate a buffer from that IO TLB pool.
+	 * request and allocate a buffer from that IO TLB pool, starting with
+	 * the area of this cpu.
 	 */
-	spin_lock_irqsave(&io_tlb_lock, flags);
-	index = ALIGN(io_tlb_index, stride);
-	if (index >= io_tlb_nslabs)
-		index = 0;
-	wrap = index;
-
+	start = raw_smp_processor_id() & (io_tlb_nareas - 1);
+	area_index = start;
 	do {
-		while (iommu_is_span_boundary(index, nslots, offset_slots,
-					      max_slots)) {
-			index += stride;
-			if (index >= io_tlb_nslabs)
-				index = 0;
-			if (index == wrap)
-				goto not_found;
-		}
-
-		/*
-		 * If we find a slot that indicates we have 'nslots' number of
-		 * contiguous buffers, we allocate the buffers from that slot
-		 * and mark the entries as '0' indicating unavailable.
-		 */
-		if (io_tlb_list[index] >= nslots) {
-			int count = 0;
-
-			for (i = index; i < (int) (index + nslots); i++)
-				io_tlb_list[i] = 0;
-			for (i = index - 1; (OFFSET(i, IO_TLB_SEGSIZE) != IO_TLB_SEGSIZE - 1) && io_tlb_list[i]; i--)
-				io_tlb_list[i] = ++count;
-			tlb_addr = io_tlb_start + (index << IO_TLB_SHIFT);
-
-			/*
-			 * Update the indices to avoid searching in the next
-			 * round.
-			 */
-			io_tlb_index = ((index + nslots) < io_tlb_nslabs
-					? (index + nslots) : 0);
-
+		index = swiotlb_area_find_slots(area_index, nslots, stride,
+						offset_slots, max_slots);
+		if (index >= 0)
 			goto found;
-		}
-		index += stride;
-		if (index >= io_tlb_nslabs)
-			index = 0;
-	} while (index != wrap);
+		if (++area_index >= io_tlb_nareas)
+			area_index = 0;
+	} while (area_index != start);
 
-not_found:
-	spin_unlock_irqrestore(&io_tlb_lock, flags);
+	atomic_long_inc(&io_tlb_full);
 	if (printk_ratelimit())
 		dev_warn(hwdev, "swiotlb buffer is full (sz: %zd bytes)\n", size);
 	return SWIOTLB_MAP_ERROR;
 found:
-	spin_unlock_irqrestore(&io_tlb_lock, flags);
+	tlb_addr = io_tlb_start + ((phys_addr_t)index << IO_TLB_SHIFT);
 
 	/*
 	 * Save away the mapping from the original address to the DMA address.
@@ -554,6 +672,7 @@ void swiotlb_tbl_unmap_single(struct device *hwdev, phys_addr_t tlb_addr,
 	unsigned long flags;
 	int i, count, nslots = ALIGN(size, 1 << IO_TLB_SHIFT) >> IO_TLB_SHIFT;
 	int index = (tlb_addr - io_tlb_start) >> IO_TLB_SHIFT;
+	struct io_tlb_area *area = &io_tlb_areas[index / io_tlb_area_nslabs];
 	phys_addr_t orig_addr = io_tlb_orig_addr[index];
 
 	/*
@@ -569,7 +688,7 @@ void swiotlb_tbl_unmap_single(struct device *hwdev, phys_addr_t tlb_addr,
 	 * While returning the entries to the free list, we merge the entries
 	 * with slots below and above the pool being returned.
 	 */
-	spin_lock_irqsave(&io_tlb_lock, flags);
+	spin_lock_irqsave(&area->lock, flags);
 	{
 		count = ((index + nslots) < ALIGN(index + 1, IO_TLB_SEGSIZE) ?
 			 io_tlb_list[index + nslots] : 0);
@@ -587,8 +706,10 @@ void swiotlb_tbl_unmap_single(struct device *hwdev, phys_addr_t tlb_addr,
 		 */
 		for (i = index - 1; (OFFSET(i, IO_TLB_SEGSIZE) != IO_TLB_SEGSIZE -1) && io_tlb_list[i]; i--)
 			io_tlb_list[i] = ++count;
+
+		area->used -= nslots;
 	}
-	spin_unlock_irqrestore(&io_tlb_lock, flags);
+	spin_unlock_irqrestore(&area->lock, flags);
 }
 EXPORT_SYMBOL_GPL(swiotlb_tbl_unmap_single);
 
@@ -992,3 +1113,57 @@ swiotlb_dma_supported(struct device *hwdev, u64 mask)
 	return phys_to_dma(hwdev, io_tlb_end - 1) <= mask;
 }
 EXPORT_SYMBOL(swiotlb_dma_supported);
+
+#ifdef CONFIG_DEBUG_FS
+static int io_tlb_used_get(void *data, u64 *val)
+{
+	unsigned int i;
+
+	*val = 0;
+	for (i = 0; i < io_tlb_nareas; i++)
+		*val += READ_ONCE(io_tlb_areas[i].used);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fops_io_tlb_used, io_tlb_used_get, NULL, "%llu\n");
+
+static int io_tlb_nslabs_get(void *data, u64 *val)
+{
+	*val = io_tlb_nslabs;
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fops_io_tlb_nslabs, io_tlb_nslabs_get, NULL, "%llu\n");
+
+static int io_tlb_full_get(void *data, u64 *val)
+{
+	*val = atomic_long_read(&io_tlb_full);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fops_io_tlb_full, io_tlb_full_get, NULL, "%llu\n");
+
+/*
+ * swiotlb/io_tlb_nslabs, io_tlb_used and io_tlb_nareas show the size of
+ * the pool, the slots in use and the number of areas; io_tlb_full counts
+ * the mappings that failed for lack of room.
+ */
+static int __init swiotlb_create_debugfs(void)
+{
+	struct dentry *root;
+
+	if (!io_tlb_nslabs)
+		return 0;
+
+	root = debugfs_create_dir("swiotlb", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_file("io_tlb_nslabs", 0400, root, NULL,
+			    &fops_io_tlb_nslabs);
+	debugfs_create_file("io_tlb_used", 0400, root, NULL,
+			    &fops_io_tlb_used);
+	debugfs_create_file("io_tlb_full", 0400, root, NULL,
+			    &fops_io_tlb_full);
+	debugfs_create_u32("io_tlb_nareas", 0400, root, &io_tlb_nareas);
+	return 0;
+}
+late_initcall(swiotlb_create_debugfs);
+#endif
@@ -24,6 +24,7 @@
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/printk.h>
+#include <linux/random.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/stacktrace.h>
@@ -300,6 +301,37 @@ void kasan_free_pages(struct page *page, unsigned int order)
 				KASAN_FREE_PAGE);
 }
 
+#ifdef CONFIG_KASAN_SAMPLING
+static unsigned int kasan_sample_rate __read_mostly = CONFIG_KASAN_SAMPLE_RATE;
+
+static int __init kasan_set_sample_rate(char *str)
+{
+	unsigned int rate;
+
+	if (kstrtouint(str, 0, &rate))
+		return -EINVAL;
+	kasan_sample_rate = rate ? rate : 1;
+	return 0;
+}
+early_param("kasan.sample", kasan_set_sample_rate);
+
+/*
+ * Decide whether a slab object gets redzones (on allocation) or free
+ * poisoning (on free). The two decisions are made independently, so
+ * no per-object state is needed: an object that was not sampled is
+ * simply left fully accessible.
+ */
+static inline bool kasan_sample_object(void)
+{
+	return kasan_sample_rate <= 1 || !prandom_u32_max(kasan_sample_rate);
+}
+#else
+static inline bool kasan_sample_object(void)
+{
+	return true;
+}
+#endif
+
 void kasan_poison_slab(struct page *page)
 {
 	kasan_poison_shadow(page_address(page),
@@ -333,6 +365,9 @@ void kasan_slab_free(struct kmem_cache *cache, void *object)
 	if (unlikely(cache->flags & SLAB_DESTROY_BY_RCU))
 		return;
 
+	if (!kasan_sample_object())
+		return;
+
 	kasan_poison_shadow(object, rounded_up_size, KASAN_KMALLOC_FREE);
 }
 
@@ -344,6 +379,11 @@ void kasan_kmalloc(struct kmem_cache *cache, const void *object, size_t size)
 	if (unlikely(object == NULL))
 		return;
 
+	if (!kasan_sample_object()) {
+		kasan_unpoison_shadow(object, cache->object_size);
+		return;
+	}
+
 	redzone_start = round_up((unsigned long)(object + size),
 				KASAN_SHADOW_SCALE_SIZE);
 	redzone_end = round_up((unsigned long)object + cache->object_size,
@@ -13,6 +13,7 @@
  *
  */
 
+#include <linux/hash.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <linux/printk.h>
@@ -182,11 +183,52 @@ static void print_shadow_for_address(const void *addr)
 
 static DEFINE_SPINLOCK(report_lock);
 
+#ifdef CONFIG_KASAN_SAMPLING
+#define REPORTED_SITES_BITS 8
+#define REPORTED_SITES_PROBE 8
+
+static unsigned long reported_sites[1 << REPORTED_SITES_BITS];
+
+/*
+ * Remember the faulting instruction so that a bug hit over and over
+ * on a long running machine is only reported once. The table is small
+ * and fixed; once it fills up every new site is reported again.
+ * Called with report_lock held.
+ */
+static bool site_already_reported(unsigned long ip)
+{
+	unsigned long idx = hash_long(ip, REPORTED_SITES_BITS);
+	int i;
+
+	for (i = 0; i < REPORTED_SITES_PROBE; i++) {
+		unsigned long *site = &reported_sites[(idx + i) &
+				((1 << REPORTED_SITES_BITS) - 1)];
+
+		if (*site == ip)
+			return true;
+		if (!*site) {
+			*site = ip;
+			return false;
+		}
+	}
+	return false;
+}
+#else
+static inline bool site_already_reported(unsigned long ip)
+{
+	return false;
+}
+#endif
+
 void kasan_report_error(struct kasan_access_info *info)
 {
 	unsigned long flags;
 
 	spin_lock_irqsave(&report_lock, flags);
+	if (site_already_reported(info->ip)) {
+		spin_unlock_irqrestore(&report_lock, flags);
+		return;
+	}
 	pr_err("================================="
 		"=================================\n");
 	print_error_description(info);
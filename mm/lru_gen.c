@@ -0,0 +1,607 @@
+/*
+ *  mm/lru_gen.c
+ *
+ *  Multi-generational LRU
+ *
+ *  The evictable pages of each lruvec, that is of each memcg on each
+ *  zone, are sorted into generations.  The aging opens a new youngest
+ *  generation and promotes the pages found accessed while walking the
+ *  page tables of the processes in the memcg, clearing the accessed
+ *  bits as it goes; no rmap walk is needed to tell hot pages from cold
+ *  ones.  Reclaim isolates from the oldest generation.
+ *
+ *  /sys/kernel/mm/lru_gen/enabled switches lruvecs between the classic
+ *  active/inactive lists and the generations.  /sys/kernel/debug/lru_gen
+ *  reports the birth time and size of every generation of every memcg,
+ *  which is a working set estimate: writing "+ <memcg inode>" ages that
+ *  memcg, and the pages not promoted since are the ones that went idle.
+ */
+
+#include <linux/mm.h>
+#include <linux/mm_inline.h>
+#include <linux/memcontrol.h>
+#include <linux/cgroup.h>
+#include <linux/sched.h>
+#include <linux/pid.h>
+#include <linux/pid_namespace.h>
+#include <linux/rcupdate.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/init.h>
+
+#define lru_to_page(_head) (list_entry((_head)->prev, struct page, lru))
+
+/* pages moved between list sets before zone->lru_lock is dropped */
+#define LRU_GEN_BATCH		64
+
+bool lru_gen_enabled __read_mostly = IS_ENABLED(CONFIG_LRU_GEN_ENABLED);
+
+/* serializes lru_gen_change_state() */
+static DEFINE_MUTEX(lru_gen_mutex);
+
+static void init_lrugen(struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int gen, type;
+
+	for (gen = 0; gen < MAX_NR_GENS; gen++) {
+		for (type = 0; type < ANON_AND_FILE; type++) {
+			INIT_LIST_HEAD(&lrugen->lists[gen][type]);
+			lrugen->nr_pages[gen][type] = 0;
+		}
+		lrugen->timestamps[gen] = jiffies;
+	}
+
+	for (type = 0; type < ANON_AND_FILE; type++)
+		lrugen->min_seq[type] = 0;
+	lrugen->max_seq = MIN_NR_GENS - 1;
+	lrugen->enabled = true;
+}
+
+/*
+ * Called under zone->lru_lock when a page is added to a lruvec that
+ * does not use the generations yet while they are enabled, typically
+ * one of a new memcg.  Lruvecs that still have pages on the classic
+ * lists are left to lru_gen_change_state().
+ */
+void lru_gen_enable_lruvec(struct lruvec *lruvec)
+{
+	enum lru_list lru;
+
+	for_each_evictable_lru(lru)
+		if (!list_empty(&lruvec->lists[lru]))
+			return;
+
+	init_lrugen(lruvec);
+}
+
+/* Returns false if it stopped early to let zone->lru_lock go. */
+static bool fill_lrugen(struct lruvec *lruvec)
+{
+	enum lru_list lru;
+	int batch = 0;
+
+	for_each_evictable_lru(lru) {
+		struct list_head *head = &lruvec->lists[lru];
+
+		/* oldest first, so the order of the pages is kept */
+		while (!list_empty(head)) {
+			struct page *page = lru_to_page(head);
+
+			list_del(&page->lru);
+			lru_gen_add_page(page, lruvec);
+			if (++batch == LRU_GEN_BATCH)
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool drain_lrugen(struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int batch = 0;
+	int type;
+
+	for (type = 0; type < ANON_AND_FILE; type++) {
+		unsigned long seq;
+
+		for (seq = lrugen->min_seq[type]; seq <= lrugen->max_seq; seq++) {
+			int gen = lru_gen_from_seq(seq);
+			struct list_head *head = &lrugen->lists[gen][type];
+
+			while (!list_empty(head)) {
+				struct page *page = lru_to_page(head);
+
+				lru_gen_del_page(page, lruvec);
+				list_add(&page->lru, &lruvec->lists[page_lru(page)]);
+				if (++batch == LRU_GEN_BATCH)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * Moves the pages of every lruvec over to the generations or back to
+ * the classic lists.  Lruvecs are flipped before their pages are moved
+ * and the lock is dropped in between batches: adding and deleting pages
+ * works on a lruvec with pages on both sets of lists.
+ */
+static void lru_gen_change_state(bool enable)
+{
+	struct mem_cgroup *memcg;
+
+	mutex_lock(&lru_gen_mutex);
+	if (enable == lru_gen_enabled)
+		goto unlock;
+
+	WRITE_ONCE(lru_gen_enabled, enable);
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		struct zone *zone;
+
+		for_each_populated_zone(zone) {
+			struct lruvec *lruvec = mem_cgroup_zone_lruvec(zone, memcg);
+			struct lru_gen_struct *lrugen = &lruvec->lrugen;
+
+			spin_lock_irq(&zone->lru_lock);
+			if (enable) {
+				if (!lrugen->enabled)
+					init_lrugen(lruvec);
+				while (!fill_lrugen(lruvec)) {
+					spin_unlock_irq(&zone->lru_lock);
+					cond_resched();
+					spin_lock_irq(&zone->lru_lock);
+				}
+			} else if (lrugen->enabled) {
+				lrugen->enabled = false;
+				while (!drain_lrugen(lruvec)) {
+					spin_unlock_irq(&zone->lru_lock);
+					cond_resched();
+					spin_lock_irq(&zone->lru_lock);
+				}
+			}
+			spin_unlock_irq(&zone->lru_lock);
+		}
+	} while ((memcg = mem_cgroup_iter(NULL, memcg, NULL)));
+unlock:
+	mutex_unlock(&lru_gen_mutex);
+}
+
+/*
+ * Folds the oldest generation of @type into the next one, the pages
+ * keep their order at the tail of it.
+ */
+static void inc_min_seq(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int old_gen = lru_gen_from_seq(lrugen->min_seq[type]);
+	int new_gen = lru_gen_from_seq(lrugen->min_seq[type] + 1);
+	struct page *page;
+
+	list_for_each_entry(page, &lrugen->lists[old_gen][type], lru)
+		page_set_lru_gen(page, new_gen);
+	list_splice_tail_init(&lrugen->lists[old_gen][type],
+			      &lrugen->lists[new_gen][type]);
+
+	lrugen->nr_pages[new_gen][type] += lrugen->nr_pages[old_gen][type];
+	lrugen->nr_pages[old_gen][type] = 0;
+	lrugen->min_seq[type]++;
+}
+
+static void inc_max_seq(struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int type;
+
+	for (type = 0; type < ANON_AND_FILE; type++)
+		if (lrugen->max_seq - lrugen->min_seq[type] + 1 >= MAX_NR_GENS)
+			inc_min_seq(lruvec, type);
+
+	lrugen->timestamps[lru_gen_from_seq(lrugen->max_seq + 1)] = jiffies;
+	WRITE_ONCE(lrugen->max_seq, lrugen->max_seq + 1);
+}
+
+/* Retires the oldest generation of @type once it is empty. */
+static bool try_inc_min_seq(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+
+	if (lrugen->max_seq - lrugen->min_seq[type] + 1 <= MIN_NR_GENS)
+		return false;
+	if (!list_empty(&lrugen->lists[gen][type]))
+		return false;
+
+	lrugen->min_seq[type]++;
+	return true;
+}
+
+struct lru_gen_walk {
+	/* the zone whose lru_lock is held, if any */
+	struct zone *locked;
+};
+
+/* Moves an accessed page to the youngest generation of its lruvec. */
+static void promote_page(struct page *page, struct lru_gen_walk *priv)
+{
+	struct zone *zone = page_zone(page);
+	struct lru_gen_struct *lrugen;
+	int gen, new_gen, type, nr_pages;
+
+	if (zone != priv->locked) {
+		if (priv->locked)
+			spin_unlock_irq(&priv->locked->lru_lock);
+		spin_lock_irq(&zone->lru_lock);
+		priv->locked = zone;
+	}
+
+	if (!PageLRU(page))
+		return;
+	gen = page_lru_gen(page);
+	if (gen < 0)
+		return;
+
+	lrugen = &mem_cgroup_page_lruvec(page, zone)->lrugen;
+	new_gen = lru_gen_from_seq(lrugen->max_seq);
+	if (gen == new_gen)
+		return;
+
+	type = page_is_file_cache(page);
+	nr_pages = hpage_nr_pages(page);
+	page_set_lru_gen(page, new_gen);
+	lrugen->nr_pages[gen][type] -= nr_pages;
+	lrugen->nr_pages[new_gen][type] += nr_pages;
+	list_move(&page->lru, &lrugen->lists[new_gen][type]);
+}
+
+static int lru_gen_pmd_entry(pmd_t *pmd, unsigned long addr,
+			     unsigned long end, struct mm_walk *walk)
+{
+	struct lru_gen_walk *priv = walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	pte_t *pte, *orig_pte;
+	spinlock_t *ptl;
+
+	if (pmd_trans_huge_lock(pmd, vma, &ptl) == 1) {
+		if (pmdp_test_and_clear_young(vma, addr, pmd))
+			promote_page(pmd_page(*pmd), priv);
+		goto unlock;
+	}
+
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		struct page *page;
+
+		if (!pte_present(*pte))
+			continue;
+		if (!ptep_test_and_clear_young(vma, addr, pte))
+			continue;
+
+		page = vm_normal_page(vma, addr, *pte);
+		if (page)
+			promote_page(page, priv);
+	}
+	pte_unmap(orig_pte);
+unlock:
+	if (priv->locked) {
+		spin_unlock_irq(&priv->locked->lru_lock);
+		priv->locked = NULL;
+	}
+	spin_unlock(ptl);
+	cond_resched();
+	return 0;
+}
+
+static int lru_gen_test_walk(unsigned long start, unsigned long end,
+			     struct mm_walk *walk)
+{
+	if (walk->vma->vm_flags & (VM_IO | VM_PFNMAP | VM_HUGETLB))
+		return 0;
+	return 1;
+}
+
+static void age_mm(struct mm_struct *mm, struct lru_gen_walk *priv)
+{
+	struct mm_walk walk = {
+		.pmd_entry = lru_gen_pmd_entry,
+		.test_walk = lru_gen_test_walk,
+		.mm = mm,
+		.private = priv,
+	};
+
+	down_read(&mm->mmap_sem);
+	walk_page_range(0, mm->highest_vm_end, &walk);
+	up_read(&mm->mmap_sem);
+}
+
+/*
+ * Goes through the processes by pid rather than the task list, so that
+ * nothing is pinned while the page tables are walked.
+ */
+static void age_memcg_mms(struct mem_cgroup *memcg, struct lru_gen_walk *priv)
+{
+	int nr = 1;
+
+	for (;;) {
+		struct task_struct *task;
+		struct mm_struct *mm = NULL;
+		struct pid *pid;
+
+		rcu_read_lock();
+		pid = find_ge_pid(nr, &init_pid_ns);
+		if (!pid) {
+			rcu_read_unlock();
+			break;
+		}
+		nr = pid_nr(pid) + 1;
+		task = pid_task(pid, PIDTYPE_PID);
+		if (task && has_group_leader_pid(task))
+			mm = get_task_mm(task);
+		rcu_read_unlock();
+
+		if (!mm)
+			continue;
+		if (!memcg || mm_match_cgroup(mm, memcg))
+			age_mm(mm, priv);
+		mmput(mm);
+		cond_resched();
+	}
+}
+
+/**
+ * lru_gen_age_memcg - open a new generation in a memcg subtree
+ * @memcg: the memcg to age, NULL without memcg
+ *
+ * Opens a new youngest generation on every lruvec of @memcg and its
+ * descendants, then promotes into it the pages mapped by their processes
+ * that were accessed since the last aging.  Reclaim calls this when
+ * lru_gen_isolate_pages() runs out of generations to evict from.
+ */
+void lru_gen_age_memcg(struct mem_cgroup *memcg)
+{
+	struct lru_gen_walk priv = { .locked = NULL };
+	struct mem_cgroup *iter;
+
+	iter = mem_cgroup_iter(memcg, NULL, NULL);
+	do {
+		struct zone *zone;
+
+		for_each_populated_zone(zone) {
+			struct lruvec *lruvec = mem_cgroup_zone_lruvec(zone, iter);
+
+			spin_lock_irq(&zone->lru_lock);
+			if (lruvec->lrugen.enabled)
+				inc_max_seq(lruvec);
+			spin_unlock_irq(&zone->lru_lock);
+		}
+	} while ((iter = mem_cgroup_iter(memcg, iter, NULL)));
+
+	age_memcg_mms(memcg, &priv);
+}
+
+/**
+ * lru_gen_isolate_pages - take pages off the oldest generation
+ * @lruvec: the lruvec to isolate from
+ * @type: LRU_GEN_ANON or LRU_GEN_FILE
+ * @nr_to_scan: the number of pages to look at
+ * @dst: the list to put the isolated pages on
+ * @nr_scanned: the number of pages looked at
+ * @mode: one or more of ISOLATE_CLEAN, ISOLATE_UNMAPPED
+ *
+ * The counterpart of isolate_lru_pages() for lruvecs on the generations,
+ * called under zone->lru_lock as well.  Unlike it, the LRU size
+ * statistics are already updated here and the caller only has to
+ * account NR_ISOLATED_*.  Returns the number of pages isolated; nothing
+ * scanned means the lruvec is down to MIN_NR_GENS generations and
+ * lru_gen_age_memcg() must run first.
+ */
+unsigned long lru_gen_isolate_pages(struct lruvec *lruvec, int type,
+				    unsigned long nr_to_scan,
+				    struct list_head *dst,
+				    unsigned long *nr_scanned,
+				    isolate_mode_t mode)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	unsigned long nr_taken = 0;
+	unsigned long scan = 0;
+
+	while (scan < nr_to_scan) {
+		int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+		struct list_head *head = &lrugen->lists[gen][type];
+		struct page *page;
+		int nr_pages;
+
+		if (list_empty(head)) {
+			if (!try_inc_min_seq(lruvec, type))
+				break;
+			continue;
+		}
+
+		page = lru_to_page(head);
+		nr_pages = hpage_nr_pages(page);
+		scan++;
+
+		switch (__isolate_lru_page(page, mode)) {
+		case 0:
+			del_page_from_lru_list(page, lruvec, page_lru(page));
+			list_add(&page->lru, dst);
+			nr_taken += nr_pages;
+			break;
+
+		case -EBUSY:
+			/* else it is being freed elsewhere */
+			list_move(&page->lru, head);
+			break;
+
+		default:
+			BUG();
+		}
+	}
+
+	*nr_scanned = scan;
+	return nr_taken;
+}
+
+static unsigned long lru_gen_memcg_ino(struct mem_cgroup *memcg)
+{
+#ifdef CONFIG_MEMCG
+	if (memcg)
+		return cgroup_ino(mem_cgroup_css(memcg)->cgroup);
+#endif
+	return 0;
+}
+
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", READ_ONCE(lru_gen_enabled));
+}
+
+static ssize_t enabled_store(struct kobject *kobj, struct kobj_attribute *attr,
+			     const char *buf, size_t len)
+{
+	bool enable;
+
+	if (strtobool(buf, &enable))
+		return -EINVAL;
+
+	lru_gen_change_state(enable);
+	return len;
+}
+
+static struct kobj_attribute lru_gen_enabled_attr =
+	__ATTR(enabled, 0644, enabled_show, enabled_store);
+
+static struct attribute *lru_gen_attrs[] = {
+	&lru_gen_enabled_attr.attr,
+	NULL,
+};
+
+static struct attribute_group lru_gen_attr_group = {
+	.name = "lru_gen",
+	.attrs = lru_gen_attrs,
+};
+
+/*
+ * One block per memcg, identified by the inode number of its cgroup
+ * directory, and per zone:
+ *
+ *   memcg <inode>
+ *    node <nid> zone <name>
+ *     <seq> <age in ms> <anon pages> <file pages>
+ */
+static int lru_gen_seq_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg;
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		struct zone *zone;
+
+		seq_printf(m, "memcg %5lu\n", lru_gen_memcg_ino(memcg));
+
+		for_each_populated_zone(zone) {
+			struct lruvec *lruvec = mem_cgroup_zone_lruvec(zone, memcg);
+			struct lru_gen_struct *lrugen = &lruvec->lrugen;
+			unsigned long seq, min_seq;
+			int type;
+
+			spin_lock_irq(&zone->lru_lock);
+			if (!lrugen->enabled) {
+				spin_unlock_irq(&zone->lru_lock);
+				continue;
+			}
+
+			seq_printf(m, " node %5d zone %-8s\n",
+				   zone->zone_pgdat->node_id, zone->name);
+
+			min_seq = min(lrugen->min_seq[LRU_GEN_ANON],
+				      lrugen->min_seq[LRU_GEN_FILE]);
+			for (seq = min_seq; seq <= lrugen->max_seq; seq++) {
+				int gen = lru_gen_from_seq(seq);
+
+				seq_printf(m, "  %10lu %10u", seq,
+					   jiffies_to_msecs(jiffies -
+						lrugen->timestamps[gen]));
+				for (type = 0; type < ANON_AND_FILE; type++)
+					seq_printf(m, " %10ld",
+						   seq < lrugen->min_seq[type] ?
+						   0 : lrugen->nr_pages[gen][type]);
+				seq_putc(m, '\n');
+			}
+			spin_unlock_irq(&zone->lru_lock);
+		}
+	} while ((memcg = mem_cgroup_iter(NULL, memcg, NULL)));
+
+	return 0;
+}
+
+static ssize_t lru_gen_seq_write(struct file *file, const char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	struct mem_cgroup *memcg;
+	unsigned long ino;
+	char buf[32];
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "+ %lu", &ino) != 1)
+		return -EINVAL;
+
+	/* the accessed bits are of no use to the classic lists */
+	if (!READ_ONCE(lru_gen_enabled))
+		return -EINVAL;
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		if (lru_gen_memcg_ino(memcg) == ino) {
+			lru_gen_age_memcg(memcg);
+			mem_cgroup_iter_break(NULL, memcg);
+			return count;
+		}
+	} while ((memcg = mem_cgroup_iter(NULL, memcg, NULL)));
+
+	return -EINVAL;
+}
+
+static int lru_gen_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lru_gen_seq_show, NULL);
+}
+
+static const struct file_operations lru_gen_fops = {
+	.open		= lru_gen_seq_open,
+	.read		= seq_read,
+	.write		= lru_gen_seq_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init init_lru_gen(void)
+{
+	BUILD_BUG_ON(MIN_NR_GENS + 1 >= MAX_NR_GENS);
+	BUILD_BUG_ON((1UL << LRU_GEN_WIDTH) <= MAX_NR_GENS);
+
+	if (sysfs_create_group(mm_kobj, &lru_gen_attr_group))
+		pr_err("lru_gen: failed to create sysfs group\n");
+
+	debugfs_create_file("lru_gen", 0644, NULL, NULL, &lru_gen_fops);
+	return 0;
+}
+late_initcall(init_lru_gen);
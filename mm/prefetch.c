@@ -0,0 +1,93 @@
+/*
+ * mm/prefetch.c
+ *
+ * prefetch(): queue readahead for a list of file ranges in one call.
+ *
+ * Readers with no sequential pattern (strided or columnar formats, many
+ * streams over one fd) know where they are going next but get nothing
+ * from the readahead heuristics.  Calling fadvise(POSIX_FADV_WILLNEED)
+ * once per range means one syscall and one plug per range; here all the
+ * ranges are read under a single plug, so the block layer sees the whole
+ * batch and can merge and dispatch it together.  Nothing waits for the
+ * I/O to complete.
+ */
+
+#include <linux/kernel.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/blkdev.h>
+#include <linux/fadvise.h>
+#include <linux/sched.h>
+#include <linux/syscalls.h>
+
+#include <asm/uaccess.h>
+
+SYSCALL_DEFINE4(prefetch, int, fd, const struct prefetch_range __user *, ranges,
+		unsigned int, nr_ranges, unsigned int, flags)
+{
+	struct address_space *mapping;
+	struct blk_plug plug;
+	struct fd f;
+	unsigned int i;
+	long ret;
+
+	if (flags)
+		return -EINVAL;
+	if (nr_ranges > PREFETCH_MAX_RANGES)
+		return -EINVAL;
+
+	f = fdget(fd);
+	if (!f.file)
+		return -EBADF;
+
+	ret = -ESPIPE;
+	if (S_ISFIFO(file_inode(f.file)->i_mode))
+		goto out;
+
+	ret = -EBADF;
+	if (!(f.file->f_mode & FMODE_READ))
+		goto out;
+
+	ret = -EINVAL;
+	mapping = f.file->f_mapping;
+	if (!mapping || !mapping->a_ops ||
+	    (!mapping->a_ops->readpage && !mapping->a_ops->readpages))
+		goto out;
+
+	/* nothing to read into the page cache */
+	ret = 0;
+	if (IS_DAX(mapping->host))
+		goto out;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < nr_ranges; i++) {
+		struct prefetch_range range;
+		pgoff_t start, end;
+
+		if (copy_from_user(&range, &ranges[i], sizeof(range))) {
+			if (!ret)
+				ret = -EFAULT;
+			break;
+		}
+		ret++;
+
+		if (!range.len || range.offset >= MAX_LFS_FILESIZE)
+			continue;
+		if (range.len > MAX_LFS_FILESIZE - range.offset)
+			range.len = MAX_LFS_FILESIZE - range.offset;
+
+		start = range.offset >> PAGE_CACHE_SHIFT;
+		end = (range.offset + range.len - 1) >> PAGE_CACHE_SHIFT;
+		force_page_cache_readahead(mapping, f.file, start,
+					   end - start + 1);
+
+		if (fatal_signal_pending(current))
+			break;
+	}
+	blk_finish_plug(&plug);
+out:
+	fdput(f);
+	return ret;
+}
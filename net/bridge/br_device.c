@@ -92,13 +92,21 @@ static int br_dev_init(struct net_device *dev)
 	struct net_bridge *br = netdev_priv(dev);
 	int err;
 
+	err = br_fdb_hash_init(br);
+	if (err)
+		return err;
+
 	br->stats = netdev_alloc_pcpu_stats(struct pcpu_sw_netstats);
-	if (!br->stats)
+	if (!br->stats) {
+		br_fdb_hash_fini(br);
 		return -ENOMEM;
+	}
 
 	err = br_vlan_init(br);
-	if (err)
+	if (err) {
 		free_percpu(br->stats);
+		br_fdb_hash_fini(br);
+	}
 
 	return err;
 }
@@ -346,6 +354,7 @@ static void br_dev_free(struct net_device *dev)
 	struct net_bridge *br = netdev_priv(dev);
 
 	free_percpu(br->stats);
+	br_fdb_hash_fini(br);
 	free_netdev(dev);
 }
 
@@ -377,6 +386,7 @@ void br_dev_setup(struct net_device *dev)
 	spin_lock_init(&br->lock);
 	INIT_LIST_HEAD(&br->port_list);
 	spin_lock_init(&br->hash_lock);
+	INIT_HLIST_HEAD(&br->fdb_list);
 
 	br->bridge_id.prio[0] = 0x80;
 	br->bridge_id.prio[1] = 0x00;
@@ -1215,7 +1215,12 @@ static void prepare_write_message_footer(struct ceph_connection *con)
 		con->out_kvec_bytes += sizeof(m->old_footer);
 	}
 	con->out_kvec_left++;
-	con->out_more = m->more_to_follow;
+	/*
+	 * If further messages are already queued, try_write() will go
+	 * straight on to them: keep the socket corked so that a burst of
+	 * small requests goes out in as few segments as possible.
+	 */
+	con->out_more = m->more_to_follow || !list_empty(&con->out_queue);
 	con->out_msg_done = true;
 }
 
@@ -1544,8 +1549,9 @@ static int write_partial_message_data(struct ceph_connection *con)
 
 		page = ceph_msg_data_next(&msg->cursor, &page_offset, &length,
 							&last_piece);
+		/* the footer always follows the data */
 		ret = ceph_tcp_sendpage(con->sock, page, page_offset,
-				      length, last_piece);
+				      length, true);
 		if (ret <= 0) {
 			if (do_datacrc)
 				msg->footer.data_crc = cpu_to_le32(crc);
@@ -119,6 +119,7 @@
 #include <linux/ip.h>
 #include <net/ip.h>
 #include <net/mpls.h>
+#include <net/busy_poll.h>
 #include <linux/ipv6.h>
 #include <linux/in.h>
 #include <linux/jhash.h>
@@ -131,6 +132,8 @@
 #include <linux/cpu_rmap.h>
 #include <linux/static_key.h>
 #include <linux/hashtable.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
 #include <linux/vmalloc.h>
 #include <linux/if_macvlan.h>
 #include <linux/errqueue.h>
@@ -1769,7 +1772,7 @@ static inline int deliver_skb(struct sk_buff *skb,
 			      struct packet_type *pt_prev,
 			      struct net_device *orig_dev)
 {
-	if (unlikely(skb_orphan_frags(skb, GFP_ATOMIC)))
+	if (unlikely(skb_orphan_frags_rx(skb, GFP_ATOMIC)))
 		return -ENOMEM;
 	atomic_inc(&skb->users);
 	return pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
@@ -2820,6 +2823,18 @@ static inline int __dev_xmit_skb(struct sk_buff *skb, struct Qdisc *q,
 
 	qdisc_pkt_len_init(skb);
 	qdisc_calculate_pkt_len(skb, q);
+
+	if (q->flags & TCQ_F_NOLOCK) {
+		if (unlikely(test_bit(__QDISC_STATE_DEACTIVATED, &q->state))) {
+			kfree_skb(skb);
+			rc = NET_XMIT_DROP;
+		} else {
+			rc = q->enqueue(skb, q) & NET_XMIT_MASK;
+			qdisc_run(q);
+		}
+		return rc;
+	}
+
 	/*
 	 * Heuristic to force contended enqueues to serialize on a
 	 * separate lock before trying to get qdisc main lock.
@@ -3491,6 +3506,13 @@ static void net_tx_action(struct softirq_action *h)
 
 			head = head->next_sched;
 
+			if (q->flags & TCQ_F_NOLOCK) {
+				smp_mb__before_atomic();
+				clear_bit(__QDISC_STATE_SCHED, &q->state);
+				qdisc_run(q);
+				continue;
+			}
+
 			root_lock = qdisc_lock(q);
 			if (spin_trylock(root_lock)) {
 				smp_mb__before_atomic();
@@ -3652,6 +3674,81 @@ static bool skb_pfmemalloc_protocol(struct sk_buff *skb)
 	}
 }
 
+static struct static_key generic_xdp_needed __read_mostly;
+
+/*
+ * Run the XDP program of a device without native support on the skb the
+ * driver built.  The program sees the frame from the MAC header on, so
+ * the skb has to be private and linear.
+ */
+static u32 netif_receive_generic_xdp(struct sk_buff *skb,
+				     struct bpf_prog *xdp_prog)
+{
+	struct xdp_buff xdp;
+	int mac_len;
+	u32 act;
+
+	if (skb_unclone(skb, GFP_ATOMIC) || skb_linearize(skb))
+		return XDP_DROP;
+
+	mac_len = skb->data - skb_mac_header(skb);
+	xdp.data = skb->data - mac_len;
+	xdp.len = skb->len + mac_len;
+
+	act = bpf_prog_run_xdp(xdp_prog, &xdp);
+	switch (act) {
+	case XDP_TX:
+		__skb_push(skb, mac_len);
+		/* fall through */
+	case XDP_PASS:
+		break;
+	case XDP_ABORTED:
+	case XDP_DROP:
+	default:
+		act = XDP_DROP;
+		break;
+	}
+
+	return act;
+}
+
+/**
+ *	netif_xdp_xmit - send a packet back out of the device it arrived on
+ *	@skb: packet, with skb->data at the MAC header
+ *
+ *	Used for the XDP_TX verdict. The packet goes straight to the driver
+ *	on the queue matching its receive queue, bypassing the qdisc. The
+ *	skb is consumed.
+ */
+void netif_xdp_xmit(struct sk_buff *skb)
+{
+	struct net_device *dev = skb->dev;
+	struct netdev_queue *txq;
+	bool free_skb = true;
+	u16 queue = 0;
+	int cpu, rc;
+
+	if (skb_rx_queue_recorded(skb))
+		queue = skb_get_rx_queue(skb) % dev->real_num_tx_queues;
+	skb_set_queue_mapping(skb, queue);
+	txq = netdev_get_tx_queue(dev, queue);
+
+	cpu = smp_processor_id();
+	HARD_TX_LOCK(dev, txq, cpu);
+	if (!netif_xmit_frozen_or_drv_stopped(txq)) {
+		rc = netdev_start_xmit(skb, dev, txq, false);
+		if (dev_xmit_complete(rc))
+			free_skb = false;
+	}
+	HARD_TX_UNLOCK(dev, txq);
+
+	if (free_skb) {
+		atomic_long_inc(&dev->tx_dropped);
+		kfree_skb(skb);
+	}
+}
+EXPORT_SYMBOL_GPL(netif_xdp_xmit);
+
 static int __netif_receive_skb_core(struct sk_buff *skb, bool pfmemalloc)
 {
 	struct packet_type *ptype, *pt_prev;
@@ -3676,6 +3773,22 @@ static int __netif_receive_skb_core(struct sk_buff *skb, bool pfmemalloc)
 
 	rcu_read_lock();
 
+	if (static_key_false(&generic_xdp_needed)) {
+		struct bpf_prog *xdp_prog = rcu_dereference(skb->dev->xdp_prog);
+
+		if (xdp_prog) {
+			u32 act = netif_receive_generic_xdp(skb, xdp_prog);
+
+			if (act == XDP_DROP)
+				goto drop;
+			if (act == XDP_TX) {
+				netif_xdp_xmit(skb);
+				ret = NET_RX_SUCCESS;
+				goto unlock;
+			}
+		}
+	}
+
 another_round:
 	skb->skb_iif = skb->dev->ifindex;
 
@@ -3784,7 +3897,7 @@ ncls:
 	}
 
 	if (pt_prev) {
-		if (unlikely(skb_orphan_frags(skb, GFP_ATOMIC)))
+		if (unlikely(skb_orphan_frags_rx(skb, GFP_ATOMIC)))
 			goto drop;
 		else
 			ret = pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
@@ -4519,6 +4632,62 @@ struct napi_struct *napi_by_id(unsigned int napi_id)
 }
 EXPORT_SYMBOL_GPL(napi_by_id);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/**
+ * napi_busy_loop - poll a NAPI context from process context
+ * @napi_id: id of the NAPI context
+ * @end_time: busy_loop_us_clock() value to give up at
+ * @loop_end: returns true once the caller has what it was waiting for,
+ *	%NULL polls only once
+ * @arg: argument for @loop_end
+ *
+ * Returns false if there is no such NAPI context or its driver can't be
+ * busy polled.
+ */
+bool napi_busy_loop(unsigned int napi_id, unsigned long end_time,
+		    bool (*loop_end)(void *), void *arg)
+{
+	const struct net_device_ops *ops;
+	struct napi_struct *napi;
+	bool ret = false;
+	int rc;
+
+	/*
+	 * rcu read lock for napi hash
+	 * bh so we don't race with net_rx_action
+	 */
+	rcu_read_lock_bh();
+
+	napi = napi_by_id(napi_id);
+	if (!napi)
+		goto out;
+
+	ops = napi->dev->netdev_ops;
+	if (!ops->ndo_busy_poll)
+		goto out;
+
+	ret = true;
+	do {
+		rc = ops->ndo_busy_poll(napi);
+
+		if (rc == LL_FLUSH_FAILED)
+			break; /* permanent failure */
+
+		if (rc > 0)
+			/* local bh are disabled so it is ok to use _BH */
+			NET_ADD_STATS_BH(dev_net(napi->dev),
+					 LINUX_MIB_BUSYPOLLRXPACKETS, rc);
+		cpu_relax();
+
+	} while (loop_end && !loop_end(arg) &&
+		 !need_resched() && !busy_loop_timeout(end_time));
+out:
+	rcu_read_unlock_bh();
+	return ret;
+}
+EXPORT_SYMBOL(napi_busy_loop);
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 void napi_hash_add(struct napi_struct *napi)
 {
 	if (!test_and_set_bit(NAPI_STATE_HASHED, &napi->state)) {
@@ -5970,6 +6139,89 @@ int dev_get_phys_port_name(struct net_device *dev,
 }
 EXPORT_SYMBOL(dev_get_phys_port_name);
 
+/**
+ *	dev_xdp_attached - check if an XDP program runs on a device
+ *	@dev: device
+ *
+ *	Caller must hold the rtnl lock.
+ */
+bool dev_xdp_attached(struct net_device *dev)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct netdev_xdp xdp;
+
+	if (!ops->ndo_xdp)
+		return rtnl_dereference(dev->xdp_prog) != NULL;
+
+	memset(&xdp, 0, sizeof(xdp));
+	xdp.command = XDP_QUERY_PROG;
+	if (ops->ndo_xdp(dev, &xdp) < 0)
+		return false;
+	return xdp.prog_attached;
+}
+
+static int dev_xdp_install(struct net_device *dev, struct bpf_prog *prog)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct netdev_xdp xdp;
+	struct bpf_prog *old;
+
+	if (ops->ndo_xdp) {
+		memset(&xdp, 0, sizeof(xdp));
+		xdp.command = XDP_SETUP_PROG;
+		xdp.prog = prog;
+		return ops->ndo_xdp(dev, &xdp);
+	}
+
+	/* no native support, run the program from the receive path */
+	old = rtnl_dereference(dev->xdp_prog);
+	rcu_assign_pointer(dev->xdp_prog, prog);
+
+	if (old) {
+		synchronize_net();
+		bpf_prog_put(old);
+		static_key_slow_dec(&generic_xdp_needed);
+	}
+	if (prog)
+		static_key_slow_inc(&generic_xdp_needed);
+
+	return 0;
+}
+
+/**
+ *	dev_change_xdp_fd - set or clear the XDP program of a device
+ *	@dev: device
+ *	@fd: file descriptor of a BPF_PROG_TYPE_XDP program, negative to
+ *	     detach the current one
+ *
+ *	Caller must hold the rtnl lock.
+ */
+int dev_change_xdp_fd(struct net_device *dev, int fd)
+{
+	struct bpf_prog *prog = NULL;
+	int err;
+
+	ASSERT_RTNL();
+
+	if (fd >= 0) {
+		prog = bpf_prog_get(fd);
+		if (IS_ERR(prog))
+			return PTR_ERR(prog);
+
+		if (prog->type != BPF_PROG_TYPE_XDP) {
+			bpf_prog_put(prog);
+			return -EINVAL;
+		}
+	}
+
+	err = dev_xdp_install(dev, prog);
+	if (err < 0 && prog)
+		bpf_prog_put(prog);
+
+	return err;
+}
+EXPORT_SYMBOL(dev_change_xdp_fd);
+
 /**
  *	dev_new_index	-	allocate an ifindex
  *	@net: the applicable net namespace
@@ -6044,6 +6296,7 @@ static void rollback_registered_many(struct list_head *head)
 		/* Shutdown queueing discipline. */
 		dev_shutdown(dev);
 
+		dev_xdp_install(dev, NULL);
 
 		/* Notify protocols, that we are about to destroy
 		   this device. They should clean all the things.
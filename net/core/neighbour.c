@@ -2214,8 +2214,37 @@ static void neigh_update_notify(struct neighbour *neigh)
 	__neigh_notify(neigh, RTM_NEWNEIGH, 0);
 }
 
+/* restricts a neighbour dump, zero fields match everything */
+struct neigh_dump_filter {
+	int dev_idx;
+	int master_idx;
+};
+
+static const struct nla_policy nda_dump_policy[NDA_MAX + 1] = {
+	[NDA_IFINDEX]		= { .type = NLA_U32 },
+	[NDA_MASTER]		= { .type = NLA_U32 },
+};
+
+static bool neigh_dump_filtered(struct net_device *dev,
+				const struct neigh_dump_filter *filter)
+{
+	struct net_device *master;
+
+	if (filter->dev_idx && dev->ifindex != filter->dev_idx)
+		return true;
+
+	if (filter->master_idx) {
+		master = netdev_master_upper_dev_get_rcu(dev);
+		if (!master || master->ifindex != filter->master_idx)
+			return true;
+	}
+
+	return false;
+}
+
 static int neigh_dump_table(struct neigh_table *tbl, struct sk_buff *skb,
-			    struct netlink_callback *cb)
+			    struct netlink_callback *cb,
+			    const struct neigh_dump_filter *filter)
 {
 	struct net *net = sock_net(skb->sk);
 	struct neighbour *n;
@@ -2236,6 +2265,8 @@ static int neigh_dump_table(struct neigh_table *tbl, struct sk_buff *skb,
 				continue;
 			if (idx < s_idx)
 				goto next;
+			if (neigh_dump_filtered(n->dev, filter))
+				goto next;
 			if (neigh_fill_info(skb, n, NETLINK_CB(cb->skb).portid,
 					    cb->nlh->nlmsg_seq,
 					    RTM_NEWNEIGH,
@@ -2256,13 +2287,15 @@ out:
 }
 
 static int pneigh_dump_table(struct neigh_table *tbl, struct sk_buff *skb,
-			     struct netlink_callback *cb)
+			     struct netlink_callback *cb,
+			     const struct neigh_dump_filter *filter)
 {
 	struct pneigh_entry *n;
 	struct net *net = sock_net(skb->sk);
 	int rc, h, s_h = cb->args[3];
 	int idx, s_idx = idx = cb->args[4];
 
+	rcu_read_lock();
 	read_lock_bh(&tbl->lock);
 
 	for (h = s_h; h <= PNEIGH_HASHMASK; h++) {
@@ -2273,11 +2306,14 @@ static int pneigh_dump_table(struct neigh_table *tbl, struct sk_buff *skb,
 				continue;
 			if (idx < s_idx)
 				goto next;
+			if (neigh_dump_filtered(n->dev, filter))
+				goto next;
 			if (pneigh_fill_info(skb, n, NETLINK_CB(cb->skb).portid,
 					    cb->nlh->nlmsg_seq,
 					    RTM_NEWNEIGH,
 					    NLM_F_MULTI, tbl) < 0) {
 				read_unlock_bh(&tbl->lock);
+				rcu_read_unlock();
 				rc = -1;
 				goto out;
 			}
@@ -2287,6 +2323,7 @@ static int pneigh_dump_table(struct neigh_table *tbl, struct sk_buff *skb,
 	}
 
 	read_unlock_bh(&tbl->lock);
+	rcu_read_unlock();
 	rc = skb->len;
 out:
 	cb->args[3] = h;
@@ -2297,6 +2334,8 @@ out:
 
 static int neigh_dump_info(struct sk_buff *skb, struct netlink_callback *cb)
 {
+	struct neigh_dump_filter filter = { 0 };
+	struct nlattr *tb[NDA_MAX + 1];
 	struct neigh_table *tbl;
 	int t, family, s_t;
 	int proxy = 0;
@@ -2311,6 +2350,16 @@ static int neigh_dump_info(struct sk_buff *skb, struct netlink_callback *cb)
 	    ((struct ndmsg *) nlmsg_data(cb->nlh))->ndm_flags == NTF_PROXY)
 		proxy = 1;
 
+	/* a daemon watching one device or bridge can ask for just that */
+	if (nlmsg_len(cb->nlh) >= sizeof(struct ndmsg) &&
+	    nlmsg_parse(cb->nlh, sizeof(struct ndmsg), tb, NDA_MAX,
+			nda_dump_policy) == 0) {
+		if (tb[NDA_IFINDEX])
+			filter.dev_idx = nla_get_u32(tb[NDA_IFINDEX]);
+		if (tb[NDA_MASTER])
+			filter.master_idx = nla_get_u32(tb[NDA_MASTER]);
+	}
+
 	s_t = cb->args[0];
 
 	for (t = 0; t < NEIGH_NR_TABLES; t++) {
@@ -2324,9 +2373,9 @@ static int neigh_dump_info(struct sk_buff *skb, struct netlink_callback *cb)
 			memset(&cb->args[1], 0, sizeof(cb->args) -
 						sizeof(cb->args[0]));
 		if (proxy)
-			err = pneigh_dump_table(tbl, skb, cb);
+			err = pneigh_dump_table(tbl, skb, cb, &filter);
 		else
-			err = neigh_dump_table(tbl, skb, cb);
+			err = neigh_dump_table(tbl, skb, cb, &filter);
 		if (err < 0)
 			break;
 	}
@@ -750,6 +750,7 @@ static ssize_t store_rps_dev_flow_table_cnt(struct netdev_rx_queue *queue,
 	unsigned long mask, count;
 	struct rps_dev_flow_table *table, *old_table;
 	static DEFINE_SPINLOCK(rps_dev_flow_lock);
+	struct device *parent = queue->dev->dev.parent;
 	int rc;
 
 	if (!capable(CAP_NET_ADMIN))
@@ -780,7 +781,12 @@ static ssize_t store_rps_dev_flow_table_cnt(struct netdev_rx_queue *queue,
 			return -EINVAL;
 		}
 #endif
-		table = vmalloc(RPS_DEV_FLOW_TABLE_SIZE(mask + 1));
+		/* the table is looked up for every received packet, keep it
+		 * on the node the device is attached to
+		 */
+		table = vmalloc_node(RPS_DEV_FLOW_TABLE_SIZE(mask + 1),
+				     parent ? dev_to_node(parent) :
+					      NUMA_NO_NODE);
 		if (!table)
 			return -ENOMEM;
 
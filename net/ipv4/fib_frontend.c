@@ -708,19 +708,53 @@ errout:
 	return err;
 }
 
+/* A dump request may carry RTA_TABLE and RTA_OIF so that a daemon
+ * interested in a single table or device does not have to walk, and
+ * receive, every route in the namespace.
+ */
+static int fib_dump_filter_parse(const struct nlmsghdr *nlh,
+				 struct fib_dump_filter *filter)
+{
+	struct nlattr *tb[RTA_MAX + 1];
+	int err;
+
+	memset(filter, 0, sizeof(*filter));
+
+	if (nlmsg_len(nlh) < sizeof(struct rtmsg))
+		return 0;
+
+	err = nlmsg_parse(nlh, sizeof(struct rtmsg), tb, RTA_MAX,
+			  rtm_ipv4_policy);
+	if (err < 0)
+		return err;
+
+	if (tb[RTA_TABLE])
+		filter->table_id = nla_get_u32(tb[RTA_TABLE]);
+	if (tb[RTA_OIF])
+		filter->ifindex = nla_get_u32(tb[RTA_OIF]);
+
+	return 0;
+}
+
 static int inet_dump_fib(struct sk_buff *skb, struct netlink_callback *cb)
 {
 	struct net *net = sock_net(skb->sk);
+	struct fib_dump_filter filter;
 	unsigned int h, s_h;
 	unsigned int e = 0, s_e;
 	struct fib_table *tb;
 	struct hlist_head *head;
 	int dumped = 0;
+	int err;
 
 	if (nlmsg_len(cb->nlh) >= sizeof(struct rtmsg) &&
 	    ((struct rtmsg *) nlmsg_data(cb->nlh))->rtm_flags & RTM_F_CLONED)
 		return skb->len;
 
+	err = fib_dump_filter_parse(cb->nlh, &filter);
+	if (err < 0)
+		return err;
+
 	s_h = cb->args[0];
 	s_e = cb->args[1];
 
@@ -732,10 +766,12 @@ static int inet_dump_fib(struct sk_buff *skb, struct netlink_callback *cb)
 		hlist_for_each_entry_rcu(tb, head, tb_hlist) {
 			if (e < s_e)
 				goto next;
+			if (filter.table_id && tb->tb_id != filter.table_id)
+				goto next;
 			if (dumped)
 				memset(&cb->args[2], 0, sizeof(cb->args) -
 						 2 * sizeof(cb->args[0]));
-			if (fib_table_dump(tb, skb, cb) < 0)
+			if (fib_table_dump(tb, skb, cb, &filter) < 0)
 				goto out;
 			dumped = 1;
 next:
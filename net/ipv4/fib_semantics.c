@@ -290,8 +290,13 @@ static inline unsigned int fib_info_hashfn(const struct fib_info *fi)
 	val ^= (fi->fib_protocol << 8) | fi->fib_scope;
 	val ^= (__force u32)fi->fib_prefsrc;
 	val ^= fi->fib_priority;
+	/* Include the gateway: many routes share a handful of devices,
+	 * and nexthop groups that differ only in their gateways would
+	 * otherwise all land in the same chain.
+	 */
 	for_nexthops(fi) {
 		val ^= fib_devindex_hashfn(nh->nh_oif);
+		val ^= ntohl(nh->nh_gw);
 	} endfor_nexthops(fi)
 
 	return (val ^ (val >> 7) ^ (val >> 12)) & mask;
@@ -126,6 +126,7 @@ struct trie_use_stats {
 	unsigned int semantic_match_miss;
 	unsigned int null_node_hit;
 	unsigned int resize_node_skipped;
+	unsigned int lookup_depth[MAX_STAT_DEPTH];
 };
 #endif
 
@@ -1255,6 +1256,17 @@ static inline t_key prefix_mismatch(t_key key, struct key_vector *n)
 	return (key ^ prefix) & (prefix | -prefix);
 }
 
+#ifdef CONFIG_IP_FIB_TRIE_STATS
+/* record how many nodes the descent of a lookup went through */
+static inline void trie_use_depth(struct trie_use_stats __percpu *stats,
+				  unsigned int depth)
+{
+	if (depth >= MAX_STAT_DEPTH)
+		depth = MAX_STAT_DEPTH - 1;
+	this_cpu_inc(stats->lookup_depth[depth]);
+}
+#endif
+
 /* should be called with rcu_read_lock */
 int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 		     struct fib_result *res, int fib_flags)
@@ -1262,6 +1274,7 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 	struct trie *t = (struct trie *) tb->tb_data;
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie_use_stats __percpu *stats = t->stats;
+	unsigned int depth = 1;
 #endif
 	const t_key key = ntohl(flp->daddr);
 	struct key_vector *n, *pn;
@@ -1298,12 +1311,20 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 		 * fact that we can only allocate a node with 32 bits if a
 		 * long is greater than 32 bits.
 		 */
-		if (index >= (1ul << n->bits))
+		if (index >= (1ul << n->bits)) {
+#ifdef CONFIG_IP_FIB_TRIE_STATS
+			trie_use_depth(stats, depth);
+#endif
 			break;
+		}
 
 		/* we have found a leaf. Prefixes have already been compared */
-		if (IS_LEAF(n))
+		if (IS_LEAF(n)) {
+#ifdef CONFIG_IP_FIB_TRIE_STATS
+			trie_use_depth(stats, depth);
+#endif
 			goto found;
+		}
 
 		/* only record pn and cindex if we are going to be chopping
 		 * bits later.  Otherwise we are just wasting cycles.
@@ -1314,6 +1335,11 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 		}
 
 		n = get_child_rcu(n, index);
+#ifdef CONFIG_IP_FIB_TRIE_STATS
+		if (unlikely(!n))
+			trie_use_depth(stats, depth);
+		depth++;
+#endif
 		if (unlikely(!n))
 			goto backtrace;
 	}
@@ -1379,6 +1405,14 @@ found:
 	/* this line carries forward the xor from earlier in the function */
 	index = key ^ n->key;
 
+	/* The aliases are sorted by suffix length and the leaf carries the
+	 * longest one, so if that does not cover the key none of the aliases
+	 * will and there is no need to pull their cache lines in.
+	 */
+	if ((index >= (1ul << n->slen)) &&
+	    ((BITS_PER_LONG > KEYLENGTH) || (n->slen != KEYLENGTH)))
+		goto backtrace;
+
 	/* Step 3: Process the leaf, if that fails fall back to backtracing */
 	hlist_for_each_entry_rcu(fa, &n->leaf, fa_list) {
 		struct fib_info *fi = fa->fa_info;
@@ -1877,8 +1911,24 @@ void fib_free_table(struct fib_table *tb)
 	call_rcu(&tb->rcu, __trie_free_rcu);
 }
 
+static bool fib_dump_filtered(const struct fib_info *fi,
+			      const struct fib_dump_filter *filter)
+{
+	int nhsel;
+
+	if (!filter->ifindex)
+		return false;
+
+	for (nhsel = 0; nhsel < fi->fib_nhs; nhsel++)
+		if (fi->fib_nh[nhsel].nh_oif == filter->ifindex)
+			return false;
+
+	return true;
+}
+
 static int fn_trie_dump_leaf(struct key_vector *l, struct fib_table *tb,
-			     struct sk_buff *skb, struct netlink_callback *cb)
+			     struct sk_buff *skb, struct netlink_callback *cb,
+			     const struct fib_dump_filter *filter)
 {
 	__be32 xkey = htonl(l->key);
 	struct fib_alias *fa;
@@ -1894,7 +1944,8 @@ static int fn_trie_dump_leaf(struct key_vector *l, struct fib_table *tb,
 			continue;
 		}
 
-		if (tb->tb_id != fa->tb_id) {
+		if (tb->tb_id != fa->tb_id ||
+		    fib_dump_filtered(fa->fa_info, filter)) {
 			i++;
 			continue;
 		}
@@ -1920,7 +1971,8 @@ static int fn_trie_dump_leaf(struct key_vector *l, struct fib_table *tb,
 
 /* rcu_read_lock needs to be hold by caller from readside */
 int fib_table_dump(struct fib_table *tb, struct sk_buff *skb,
-		   struct netlink_callback *cb)
+		   struct netlink_callback *cb,
+		   const struct fib_dump_filter *filter)
 {
 	struct trie *t = (struct trie *)tb->tb_data;
 	struct key_vector *l, *tp = t->kv;
@@ -1931,7 +1983,7 @@ int fib_table_dump(struct fib_table *tb, struct sk_buff *skb,
 	t_key key = cb->args[3];
 
 	while ((l = leaf_walk_rcu(&tp, key)) != NULL) {
-		if (fn_trie_dump_leaf(l, tb, skb, cb) < 0) {
+		if (fn_trie_dump_leaf(l, tb, skb, cb, filter) < 0) {
 			cb->args[3] = key;
 			cb->args[2] = count;
 			return -1;
@@ -1962,7 +2014,8 @@ void __init fib_trie_init(void)
 
 	trie_leaf_kmem = kmem_cache_create("ip_fib_trie",
 					   LEAF_SIZE,
-					   0, SLAB_PANIC, NULL);
+					   0, SLAB_HWCACHE_ALIGN | SLAB_PANIC,
+					   NULL);
 }
 
 struct fib_table *fib_trie_table(u32 id, struct fib_table *alias)
@@ -2155,6 +2208,7 @@ static void trie_show_usage(struct seq_file *seq,
 			    const struct trie_use_stats __percpu *stats)
 {
 	struct trie_use_stats s = { 0 };
+	unsigned int i, max;
 	int cpu;
 
 	/* loop through all of the CPUs and gather up the stats */
@@ -2167,6 +2221,8 @@ static void trie_show_usage(struct seq_file *seq,
 		s.semantic_match_miss += pcpu->semantic_match_miss;
 		s.null_node_hit += pcpu->null_node_hit;
 		s.resize_node_skipped += pcpu->resize_node_skipped;
+		for (i = 0; i < MAX_STAT_DEPTH; i++)
+			s.lookup_depth[i] += pcpu->lookup_depth[i];
 	}
 
 	seq_printf(seq, "\nCounters:\n---------\n");
@@ -2176,7 +2232,17 @@ static void trie_show_usage(struct seq_file *seq,
 		   s.semantic_match_passed);
 	seq_printf(seq, "semantic match miss = %u\n", s.semantic_match_miss);
 	seq_printf(seq, "null node hit= %u\n", s.null_node_hit);
-	seq_printf(seq, "skipped node resize = %u\n\n", s.resize_node_skipped);
+	seq_printf(seq, "skipped node resize = %u\n", s.resize_node_skipped);
+
+	max = MAX_STAT_DEPTH;
+	while (max > 0 && s.lookup_depth[max-1] == 0)
+		max--;
+
+	seq_puts(seq, "lookup depth =");
+	for (i = 1; i < max; i++)
+		if (s.lookup_depth[i] != 0)
+			seq_printf(seq, "  %u: %u", i, s.lookup_depth[i]);
+	seq_puts(seq, "\n\n");
 }
 #endif /*  CONFIG_IP_FIB_TRIE_STATS */
 
@@ -411,6 +411,8 @@ static void icmp_reply(struct icmp_bxm *icmp_param, struct sk_buff *skb)
 	saddr = fib_compute_spec_dst(skb);
 	ipc.opt = NULL;
 	ipc.tx_flags = 0;
+	ipc.gso_size = 0;
+	ipc.transmit_time = 0;
 	ipc.ttl = 0;
 	ipc.tos = -1;
 
@@ -674,6 +676,8 @@ void icmp_send(struct sk_buff *skb_in, int type, int code, __be32 info)
 	ipc.addr = iph->saddr;
 	ipc.opt = &icmp_param->replyopts.opt;
 	ipc.tx_flags = 0;
+	ipc.gso_size = 0;
+	ipc.transmit_time = 0;
 	ipc.ttl = 0;
 	ipc.tos = -1;
 
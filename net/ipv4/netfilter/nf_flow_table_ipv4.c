@@ -0,0 +1,559 @@
+/*
+ * IPv4 flow table fast path.
+ *
+ * Connections are entered into the flow table from the forward hook once
+ * conntrack considers them established.  From then on their packets are
+ * matched right after defragmentation in prerouting, NATed, and handed to
+ * the neighbour layer of the cached output route, skipping routing,
+ * conntrack and the rest of the netfilter hooks.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter_ipv4.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/netfilter/nf_conntrack_tcp.h>
+#include <net/ip.h>
+#include <net/route.h>
+#include <net/arp.h>
+#include <net/neighbour.h>
+#include <net/netns/generic.h>
+#include <net/netfilter/nf_flow_table.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+#include <net/netfilter/nf_conntrack_seqadj.h>
+#include <net/netfilter/nf_conntrack_zones.h>
+
+static bool hw_offload __read_mostly;
+module_param(hw_offload, bool, 0400);
+MODULE_PARM_DESC(hw_offload, "Offer flows to NICs implementing ndo_flow_offload");
+
+static int nf_flow_table_ipv4_net_id __read_mostly;
+
+static inline struct nf_flowtable *nf_flow_table_ipv4_pernet(struct net *net)
+{
+	return net_generic(net, nf_flow_table_ipv4_net_id);
+}
+
+struct flow_ports {
+	__be16 source, dest;
+};
+
+static int nf_flow_nat_ip_l4proto(struct sk_buff *skb, struct iphdr *iph,
+				  unsigned int thoff, __be32 addr,
+				  __be32 new_addr)
+{
+	struct tcphdr *tcph;
+	struct udphdr *udph;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		tcph = (void *)(skb_network_header(skb) + thoff);
+		inet_proto_csum_replace4(&tcph->check, skb, addr, new_addr, 1);
+		break;
+	case IPPROTO_UDP:
+		udph = (void *)(skb_network_header(skb) + thoff);
+		if (udph->check || skb->ip_summed == CHECKSUM_PARTIAL) {
+			inet_proto_csum_replace4(&udph->check, skb, addr,
+						 new_addr, 1);
+			if (!udph->check)
+				udph->check = CSUM_MANGLED_0;
+		}
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+static int nf_flow_snat_ip(const struct flow_offload *flow,
+			   struct sk_buff *skb, struct iphdr *iph,
+			   unsigned int thoff, enum flow_offload_tuple_dir dir)
+{
+	__be32 addr, new_addr;
+
+	switch (dir) {
+	case FLOW_OFFLOAD_DIR_ORIGINAL:
+		addr = iph->saddr;
+		new_addr = flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.dst_v4.s_addr;
+		iph->saddr = new_addr;
+		break;
+	case FLOW_OFFLOAD_DIR_REPLY:
+		addr = iph->daddr;
+		new_addr = flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.src_v4.s_addr;
+		iph->daddr = new_addr;
+		break;
+	default:
+		return -1;
+	}
+	csum_replace4(&iph->check, addr, new_addr);
+
+	return nf_flow_nat_ip_l4proto(skb, iph, thoff, addr, new_addr);
+}
+
+static int nf_flow_dnat_ip(const struct flow_offload *flow,
+			   struct sk_buff *skb, struct iphdr *iph,
+			   unsigned int thoff, enum flow_offload_tuple_dir dir)
+{
+	__be32 addr, new_addr;
+
+	switch (dir) {
+	case FLOW_OFFLOAD_DIR_ORIGINAL:
+		addr = iph->daddr;
+		new_addr = flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.src_v4.s_addr;
+		iph->daddr = new_addr;
+		break;
+	case FLOW_OFFLOAD_DIR_REPLY:
+		addr = iph->saddr;
+		new_addr = flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.dst_v4.s_addr;
+		iph->saddr = new_addr;
+		break;
+	default:
+		return -1;
+	}
+	csum_replace4(&iph->check, addr, new_addr);
+
+	return nf_flow_nat_ip_l4proto(skb, iph, thoff, addr, new_addr);
+}
+
+static int nf_flow_nat_port(struct sk_buff *skb, unsigned int thoff,
+			    u8 protocol, __be16 port, __be16 new_port)
+{
+	struct tcphdr *tcph;
+	struct udphdr *udph;
+
+	switch (protocol) {
+	case IPPROTO_TCP:
+		tcph = (void *)(skb_network_header(skb) + thoff);
+		inet_proto_csum_replace2(&tcph->check, skb, port, new_port, 0);
+		break;
+	case IPPROTO_UDP:
+		udph = (void *)(skb_network_header(skb) + thoff);
+		if (udph->check || skb->ip_summed == CHECKSUM_PARTIAL) {
+			inet_proto_csum_replace2(&udph->check, skb, port,
+						 new_port, 0);
+			if (!udph->check)
+				udph->check = CSUM_MANGLED_0;
+		}
+		break;
+	}
+
+	return 0;
+}
+
+static int nf_flow_snat_port(const struct flow_offload *flow,
+			     struct sk_buff *skb, unsigned int thoff,
+			     u8 protocol, enum flow_offload_tuple_dir dir)
+{
+	struct flow_ports *hdr;
+	__be16 port, new_port;
+
+	hdr = (void *)(skb_network_header(skb) + thoff);
+
+	switch (dir) {
+	case FLOW_OFFLOAD_DIR_ORIGINAL:
+		port = hdr->source;
+		new_port = flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.dst_port;
+		hdr->source = new_port;
+		break;
+	case FLOW_OFFLOAD_DIR_REPLY:
+		port = hdr->dest;
+		new_port = flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.src_port;
+		hdr->dest = new_port;
+		break;
+	default:
+		return -1;
+	}
+
+	return nf_flow_nat_port(skb, thoff, protocol, port, new_port);
+}
+
+static int nf_flow_dnat_port(const struct flow_offload *flow,
+			     struct sk_buff *skb, unsigned int thoff,
+			     u8 protocol, enum flow_offload_tuple_dir dir)
+{
+	struct flow_ports *hdr;
+	__be16 port, new_port;
+
+	hdr = (void *)(skb_network_header(skb) + thoff);
+
+	switch (dir) {
+	case FLOW_OFFLOAD_DIR_ORIGINAL:
+		port = hdr->dest;
+		new_port = flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.src_port;
+		hdr->dest = new_port;
+		break;
+	case FLOW_OFFLOAD_DIR_REPLY:
+		port = hdr->source;
+		new_port = flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.dst_port;
+		hdr->source = new_port;
+		break;
+	default:
+		return -1;
+	}
+
+	return nf_flow_nat_port(skb, thoff, protocol, port, new_port);
+}
+
+static int nf_flow_nat_ip(const struct flow_offload *flow, struct sk_buff *skb,
+			  unsigned int thoff, enum flow_offload_tuple_dir dir)
+{
+	struct iphdr *iph = ip_hdr(skb);
+
+	if (test_bit(NF_FLOW_SNAT, &flow->flags) &&
+	    (nf_flow_snat_port(flow, skb, thoff, iph->protocol, dir) < 0 ||
+	     nf_flow_snat_ip(flow, skb, iph, thoff, dir) < 0))
+		return -1;
+	if (test_bit(NF_FLOW_DNAT, &flow->flags) &&
+	    (nf_flow_dnat_port(flow, skb, thoff, iph->protocol, dir) < 0 ||
+	     nf_flow_dnat_ip(flow, skb, iph, thoff, dir) < 0))
+		return -1;
+
+	return 0;
+}
+
+static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
+			    struct flow_offload_tuple *tuple)
+{
+	struct flow_ports *ports;
+	unsigned int thoff, hdrsize;
+	struct iphdr *iph;
+
+	if (!pskb_may_pull(skb, sizeof(*iph)))
+		return -1;
+
+	iph = ip_hdr(skb);
+	thoff = iph->ihl * 4;
+
+	/* options and fragments need the full forwarding path */
+	if (ip_is_fragment(iph) || unlikely(thoff != sizeof(*iph)))
+		return -1;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		hdrsize = sizeof(struct tcphdr);
+		break;
+	case IPPROTO_UDP:
+		hdrsize = sizeof(struct udphdr);
+		break;
+	default:
+		return -1;
+	}
+
+	/* let the slow path send the time exceeded error */
+	if (iph->ttl <= 1)
+		return -1;
+
+	if (!pskb_may_pull(skb, thoff + hdrsize))
+		return -1;
+
+	iph = ip_hdr(skb);
+	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
+
+	tuple->src_v4.s_addr	= iph->saddr;
+	tuple->dst_v4.s_addr	= iph->daddr;
+	tuple->src_port		= ports->source;
+	tuple->dst_port		= ports->dest;
+	tuple->l3proto		= AF_INET;
+	tuple->l4proto		= iph->protocol;
+	tuple->iifidx		= dev->ifindex;
+
+	return 0;
+}
+
+static bool nf_flow_exceeds_mtu(const struct sk_buff *skb, unsigned int mtu)
+{
+	if (skb->len <= mtu)
+		return false;
+
+	if (skb_is_gso(skb) && skb_gso_network_seglen(skb) <= mtu)
+		return false;
+
+	return true;
+}
+
+/* FIN and RST go through conntrack so that it sees the connection close */
+static int nf_flow_state_check(struct flow_offload *flow, int proto,
+			       struct sk_buff *skb, unsigned int thoff)
+{
+	struct tcphdr *tcph;
+
+	if (proto != IPPROTO_TCP)
+		return 0;
+
+	tcph = (void *)(skb_network_header(skb) + thoff);
+	if (unlikely(tcph->fin || tcph->rst)) {
+		flow_offload_teardown(flow);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int nf_flow_xmit_ip(struct sk_buff *skb, struct rtable *rt)
+{
+	struct net_device *dev = rt->dst.dev;
+	struct neighbour *neigh;
+	u32 nexthop;
+	int ret;
+
+	rcu_read_lock_bh();
+	nexthop = (__force u32) rt_nexthop(rt, ip_hdr(skb)->daddr);
+	neigh = __ipv4_neigh_lookup_noref(dev, nexthop);
+	if (unlikely(!neigh))
+		neigh = __neigh_create(&arp_tbl, &nexthop, dev, false);
+	if (IS_ERR(neigh)) {
+		rcu_read_unlock_bh();
+		kfree_skb(skb);
+		return -EINVAL;
+	}
+	ret = dst_neigh_output(&rt->dst, neigh, skb);
+	rcu_read_unlock_bh();
+
+	return ret;
+}
+
+static unsigned int
+nf_flow_offload_ip_hook(const struct nf_hook_ops *ops,
+			struct sk_buff *skb,
+			const struct nf_hook_state *state)
+{
+	struct nf_flowtable *flow_table;
+	struct flow_offload_tuple_rhash *tuplehash;
+	struct flow_offload_tuple tuple = {};
+	enum flow_offload_tuple_dir dir;
+	struct flow_offload *flow;
+	struct net_device *outdev;
+	struct rtable *rt;
+	unsigned int thoff;
+	struct iphdr *iph;
+
+	if (skb->pkt_type != PACKET_HOST || skb->nfct)
+		return NF_ACCEPT;
+
+	if (nf_flow_tuple_ip(skb, state->in, &tuple) < 0)
+		return NF_ACCEPT;
+
+	flow_table = nf_flow_table_ipv4_pernet(dev_net(state->in));
+	tuplehash = flow_offload_lookup(flow_table, &tuple);
+	if (!tuplehash)
+		return NF_ACCEPT;
+
+	dir = tuplehash->tuple.dir;
+	flow = flow_offload_from_tuplehash(tuplehash);
+	rt = (struct rtable *)flow->tuplehash[dir].tuple.dst_cache;
+	outdev = rt->dst.dev;
+
+	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)))
+		return NF_ACCEPT;
+
+	/* the route went stale, let the slow path set up a new flow */
+	if (unlikely(!dst_check(&rt->dst, 0))) {
+		flow_offload_teardown(flow);
+		return NF_ACCEPT;
+	}
+
+	thoff = ip_hdr(skb)->ihl * 4;
+	if (nf_flow_state_check(flow, ip_hdr(skb)->protocol, skb, thoff))
+		return NF_ACCEPT;
+
+	if (skb_cow(skb, LL_RESERVED_SPACE(outdev)))
+		return NF_ACCEPT;
+
+	flow_offload_refresh(flow);
+
+	if (nf_flow_nat_ip(flow, skb, thoff, dir) < 0)
+		return NF_DROP;
+
+	iph = ip_hdr(skb);
+	ip_decrease_ttl(iph);
+
+	skb->dev = outdev;
+	skb_dst_drop(skb);
+	skb_dst_set(skb, dst_clone(&rt->dst));
+	nf_flow_xmit_ip(skb, rt);
+
+	return NF_STOLEN;
+}
+
+static int nf_flow_route_ip(struct net *net, struct sk_buff *skb,
+			    const struct nf_conn *ct,
+			    enum ip_conntrack_dir dir,
+			    const struct nf_hook_state *state,
+			    struct nf_flow_route *route)
+{
+	struct dst_entry *this_dst = skb_dst(skb);
+	struct flowi4 fl4 = {};
+	struct rtable *other_rt;
+
+	/* the other direction goes back to where this packet came from */
+	fl4.daddr = ct->tuplehash[dir].tuple.src.u3.ip;
+	other_rt = ip_route_output_key(net, &fl4);
+	if (IS_ERR(other_rt))
+		return -1;
+
+	if (other_rt->rt_type != RTN_UNICAST ||
+	    other_rt->dst.dev != state->in) {
+		ip_rt_put(other_rt);
+		return -1;
+	}
+
+	dst_hold(this_dst);
+	route->tuple[dir].dst = this_dst;
+	route->tuple[dir].ifindex = state->in->ifindex;
+	route->tuple[!dir].dst = &other_rt->dst;
+	route->tuple[!dir].ifindex = this_dst->dev->ifindex;
+
+	return 0;
+}
+
+static bool nf_flow_offloadable(const struct nf_conn *ct)
+{
+	switch (nf_ct_protonum(ct)) {
+	case IPPROTO_TCP:
+		if (ct->proto.tcp.state != TCP_CONNTRACK_ESTABLISHED)
+			return false;
+		break;
+	case IPPROTO_UDP:
+		break;
+	default:
+		return false;
+	}
+
+	/* helpers and sequence adjustment need to see every packet */
+	if (nfct_help(ct) || nfct_seqadj(ct))
+		return false;
+
+	if (nf_ct_zone(ct) != NF_CT_DEFAULT_ZONE)
+		return false;
+
+	return test_bit(IPS_ASSURED_BIT, &ct->status) &&
+	       test_bit(IPS_CONFIRMED_BIT, &ct->status);
+}
+
+static unsigned int
+nf_flow_offload_forward_hook(const struct nf_hook_ops *ops,
+			     struct sk_buff *skb,
+			     const struct nf_hook_state *state)
+{
+	struct nf_flowtable *flow_table;
+	enum ip_conntrack_info ctinfo;
+	struct nf_flow_route route;
+	struct flow_offload *flow;
+	enum ip_conntrack_dir dir;
+	struct nf_conn *ct;
+	struct net *net;
+
+	ct = nf_ct_get(skb, &ctinfo);
+	if (!ct || nf_ct_is_untracked(ct))
+		return NF_ACCEPT;
+
+	if (ctinfo != IP_CT_ESTABLISHED && ctinfo != IP_CT_ESTABLISHED_REPLY)
+		return NF_ACCEPT;
+
+	if (test_bit(IPS_OFFLOAD_BIT, &ct->status) || !nf_flow_offloadable(ct))
+		return NF_ACCEPT;
+
+	if (test_and_set_bit(IPS_OFFLOAD_BIT, &ct->status))
+		return NF_ACCEPT;
+
+	net = dev_net(state->out);
+	dir = CTINFO2DIR(ctinfo);
+	if (nf_flow_route_ip(net, skb, ct, dir, state, &route) < 0)
+		goto err_route;
+
+	flow = flow_offload_alloc(ct, &route);
+	if (!flow)
+		goto err_flow_alloc;
+
+	flow_table = nf_flow_table_ipv4_pernet(net);
+	if (flow_offload_add(flow_table, flow) < 0)
+		goto err_flow_add;
+
+	dst_release(route.tuple[FLOW_OFFLOAD_DIR_ORIGINAL].dst);
+	dst_release(route.tuple[FLOW_OFFLOAD_DIR_REPLY].dst);
+	return NF_ACCEPT;
+
+err_flow_add:
+	flow_offload_free(flow);
+err_flow_alloc:
+	dst_release(route.tuple[FLOW_OFFLOAD_DIR_ORIGINAL].dst);
+	dst_release(route.tuple[FLOW_OFFLOAD_DIR_REPLY].dst);
+err_route:
+	clear_bit(IPS_OFFLOAD_BIT, &ct->status);
+	return NF_ACCEPT;
+}
+
+static struct nf_hook_ops nf_flow_offload_ipv4_ops[] __read_mostly = {
+	{
+		.hook		= nf_flow_offload_ip_hook,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_PRE_ROUTING,
+		.priority	= NF_IP_PRI_CONNTRACK_DEFRAG + 1,
+	},
+	{
+		.hook		= nf_flow_offload_forward_hook,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_FORWARD,
+		.priority	= NF_IP_PRI_LAST,
+	},
+};
+
+static int __net_init nf_flow_table_ipv4_net_init(struct net *net)
+{
+	return nf_flow_table_init(nf_flow_table_ipv4_pernet(net), net,
+				  hw_offload ? NF_FLOWTABLE_F_HW : 0);
+}
+
+static void __net_exit nf_flow_table_ipv4_net_exit(struct net *net)
+{
+	nf_flow_table_free(nf_flow_table_ipv4_pernet(net));
+}
+
+static struct pernet_operations nf_flow_table_ipv4_net_ops = {
+	.init	= nf_flow_table_ipv4_net_init,
+	.exit	= nf_flow_table_ipv4_net_exit,
+	.id	= &nf_flow_table_ipv4_net_id,
+	.size	= sizeof(struct nf_flowtable),
+};
+
+static int __init nf_flow_ipv4_module_init(void)
+{
+	int ret;
+
+	ret = register_pernet_subsys(&nf_flow_table_ipv4_net_ops);
+	if (ret < 0)
+		return ret;
+
+	ret = nf_register_hooks(nf_flow_offload_ipv4_ops,
+				ARRAY_SIZE(nf_flow_offload_ipv4_ops));
+	if (ret < 0)
+		unregister_pernet_subsys(&nf_flow_table_ipv4_net_ops);
+
+	return ret;
+}
+
+static void __exit nf_flow_ipv4_module_exit(void)
+{
+	nf_unregister_hooks(nf_flow_offload_ipv4_ops,
+			    ARRAY_SIZE(nf_flow_offload_ipv4_ops));
+	unregister_pernet_subsys(&nf_flow_table_ipv4_net_ops);
+}
+
+module_init(nf_flow_ipv4_module_init);
+module_exit(nf_flow_ipv4_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("IPv4 flow table fast path for established connections");
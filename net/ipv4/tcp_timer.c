@@ -495,6 +495,9 @@ void tcp_write_timer_handler(struct sock *sk)
 	if (sk->sk_state == TCP_CLOSE || !icsk->icsk_pending)
 		goto out;
 
+	/* inet_csk_reset_xmit_timer() only moves the timer earlier, so we
+	 * may run before the current deadline: just re-arm for it.
+	 */
 	if (time_after(icsk->icsk_timeout, jiffies)) {
 		sk_reset_timer(sk, &icsk->icsk_retransmit_timer, icsk->icsk_timeout);
 		goto out;
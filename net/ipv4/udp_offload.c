@@ -11,6 +11,7 @@
  */
 
 #include <linux/skbuff.h>
+#include <linux/static_key.h>
 #include <net/udp.h>
 #include <net/protocol.h>
 
@@ -175,6 +176,89 @@ out_unlock:
 	return segs;
 }
 
+/* Split a datagram built with UDP_SEGMENT into gso_size sized datagrams.
+ * Unlike UFO, every segment is a complete UDP datagram with its own
+ * header, only the length and checksum need fixing up here. IP headers
+ * are updated in inet_gso_segment().
+ */
+struct sk_buff *__udp_gso_segment(struct sk_buff *gso_skb,
+				  netdev_features_t features)
+{
+	struct sk_buff *segs, *seg;
+	unsigned int sum_truesize = 0;
+	bool copy_destructor;
+	unsigned int mss;
+	struct udphdr *uh;
+	__sum16 check;
+	__be16 newlen;
+
+	if (!pskb_may_pull(gso_skb, sizeof(*uh)))
+		return ERR_PTR(-EINVAL);
+
+	mss = skb_shinfo(gso_skb)->gso_size;
+	if (gso_skb->len <= sizeof(*uh) + mss)
+		return ERR_PTR(-EINVAL);
+
+	if (skb_gso_ok(gso_skb, features | NETIF_F_GSO_ROBUST)) {
+		/* Packet is from an untrusted source, reset gso_segs. */
+		skb_shinfo(gso_skb)->gso_segs =
+			DIV_ROUND_UP(gso_skb->len - sizeof(*uh), mss);
+		return NULL;
+	}
+
+	uh = udp_hdr(gso_skb);
+	copy_destructor = gso_skb->destructor == sock_wfree;
+
+	skb_pull(gso_skb, sizeof(*uh));
+
+	segs = skb_segment(gso_skb, features);
+	if (IS_ERR_OR_NULL(segs))
+		return segs;
+
+	/* uh->check holds the pseudo header sum for the full length */
+	newlen = htons(sizeof(*uh) + mss);
+	check = csum16_add(csum16_sub(uh->check, uh->len), newlen);
+
+	for (seg = segs; seg->next; seg = seg->next) {
+		uh = udp_hdr(seg);
+		uh->len = newlen;
+		uh->check = check;
+
+		if (seg->ip_summed != CHECKSUM_PARTIAL)
+			uh->check = gso_make_checksum(seg, ~check) ? :
+				    CSUM_MANGLED_0;
+
+		if (copy_destructor) {
+			seg->destructor = gso_skb->destructor;
+			seg->sk = gso_skb->sk;
+			sum_truesize += seg->truesize;
+		}
+	}
+
+	/* the last segment may be shorter than gso_size */
+	uh = udp_hdr(seg);
+	newlen = htons(skb_tail_pointer(seg) - skb_transport_header(seg) +
+		       seg->data_len);
+	check = csum16_add(csum16_sub(uh->check, uh->len), newlen);
+	uh->len = newlen;
+	uh->check = check;
+
+	if (seg->ip_summed != CHECKSUM_PARTIAL)
+		uh->check = gso_make_checksum(seg, ~check) ? : CSUM_MANGLED_0;
+
+	/* Let the last segment release the socket memory, as TCP does */
+	if (copy_destructor) {
+		swap(gso_skb->sk, seg->sk);
+		swap(gso_skb->destructor, seg->destructor);
+		sum_truesize += seg->truesize;
+		atomic_add(sum_truesize - gso_skb->truesize,
+			   &seg->sk->sk_wmem_alloc);
+	}
+
+	return segs;
+}
+EXPORT_SYMBOL_GPL(__udp_gso_segment);
+
 static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 					 netdev_features_t features)
 {
@@ -191,6 +275,9 @@ static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 		goto out;
 	}
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4)
+		return __udp_gso_segment(skb, features);
+
 	if (!pskb_may_pull(skb, sizeof(struct udphdr)))
 		goto out;
 
@@ -349,6 +436,92 @@ out:
 	return pp;
 }
 
+/* Datagrams of a flow merged into one GRO packet at most */
+#define UDP_GRO_CNT_MAX		64
+
+static struct static_key udp_gro_needed __read_mostly;
+
+void udp_gro_enable(void)
+{
+	if (!static_key_enabled(&udp_gro_needed))
+		static_key_slow_inc(&udp_gro_needed);
+}
+EXPORT_SYMBOL(udp_gro_enable);
+
+/* Only sockets that set UDP_GRO get datagram trains, look it up. */
+static bool udp4_gro_enabled(struct sk_buff *skb, struct udphdr *uh)
+{
+	const struct iphdr *iph = skb_gro_network_header(skb);
+	struct sock *sk;
+	bool ret;
+
+	if (ipv4_is_multicast(iph->daddr) || ipv4_is_lbcast(iph->daddr))
+		return false;
+
+	sk = __udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
+			       iph->daddr, uh->dest, skb->dev->ifindex,
+			       &udp_table);
+	if (!sk)
+		return false;
+
+	ret = udp_sk(sk)->gro_enabled;
+	sock_put(sk);
+	return ret;
+}
+
+/*
+ * Merge datagrams of the same flow into one packet that can be segmented
+ * again by __udp_gso_segment(): all of them gso_size long, except for a
+ * shorter last one.
+ */
+static struct sk_buff **udp_gro_receive_segment(struct sk_buff **head,
+						struct sk_buff *skb,
+						struct udphdr *uh)
+{
+	unsigned int off = skb_gro_offset(skb);
+	unsigned int ulen = ntohs(uh->len);
+	struct sk_buff *p, **pp;
+	struct udphdr *uh2;
+	int flush;
+
+	/* GSO can't output zero checksums, don't produce them either */
+	flush = NAPI_GRO_CB(skb)->flush | !uh->check;
+
+	skb_gro_pull(skb, sizeof(struct udphdr));
+	skb_gro_postpull_rcsum(skb, uh, sizeof(struct udphdr));
+
+	for (pp = head; (p = *pp); pp = &p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+
+		/* a datagram longer than the first one starts a new train */
+		if (flush || NAPI_GRO_CB(p)->flush || NAPI_GRO_CB(p)->flush_id ||
+		    ulen > ntohs(uh2->len))
+			return pp;
+
+		if (skb_gro_receive(pp, skb))
+			return pp;
+
+		skb_shinfo(*pp)->gso_type |= SKB_GSO_UDP_L4;
+
+		/* a shorter one ends it */
+		if (ulen != ntohs(uh2->len) ||
+		    NAPI_GRO_CB(*pp)->count >= UDP_GRO_CNT_MAX)
+			return pp;
+
+		return NULL;
+	}
+
+	NAPI_GRO_CB(skb)->flush |= flush;
+	return NULL;
+}
+
 static struct sk_buff **udp4_gro_receive(struct sk_buff **head,
 					 struct sk_buff *skb)
 {
@@ -369,6 +542,8 @@ static struct sk_buff **udp4_gro_receive(struct sk_buff **head,
 					     inet_gro_compute_pseudo);
 skip:
 	NAPI_GRO_CB(skb)->is_ipv6 = 0;
+	if (static_key_false(&udp_gro_needed) && udp4_gro_enabled(skb, uh))
+		return udp_gro_receive_segment(head, skb, uh);
 	return udp_gro_receive(head, skb, uh);
 
 flush:
@@ -412,11 +587,28 @@ int udp_gro_complete(struct sk_buff *skb, int nhoff)
 	return err;
 }
 
+static int udp_gro_complete_segment(struct sk_buff *skb, struct udphdr *uh)
+{
+	skb->csum_start = (unsigned char *)uh - skb->head;
+	skb->csum_offset = offsetof(struct udphdr, check);
+	skb->ip_summed = CHECKSUM_PARTIAL;
+
+	skb_shinfo(skb)->gso_segs = NAPI_GRO_CB(skb)->count;
+	return 0;
+}
+
 static int udp4_gro_complete(struct sk_buff *skb, int nhoff)
 {
 	const struct iphdr *iph = ip_hdr(skb);
 	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) {
+		uh->len = htons(skb->len - nhoff);
+		uh->check = ~udp_v4_check(skb->len - nhoff, iph->saddr,
+					  iph->daddr, 0);
+		return udp_gro_complete_segment(skb, uh);
+	}
+
 	if (uh->check) {
 		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL_CSUM;
 		uh->check = ~udp_v4_check(skb->len - nhoff, iph->saddr,
@@ -0,0 +1,478 @@
+/*
+ * IPVS:        Maglev Hashing scheduling module
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ */
+
+/*
+ * The mh algorithm is to assign a preference list of all the lookup
+ * table positions to each destination and populate the table with
+ * the most-preferred position of destinations. Then it is to select
+ * the destination with the hash key of source IP address through
+ * looking up the lookup table.
+ *
+ * The algorithm is detailed in:
+ * [3.4 Consistent Hashing]
+ *	https://www.usenix.org/system/files/conference/nsdi16/nsdi16-paper-eisenbud.pdf
+ *
+ * The table only depends on the set of destinations and their weights,
+ * not on the order they were added in, so directors configured with the
+ * same real servers pick the same server for a given client. Removing a
+ * destination only moves the connections that were mapped to it.
+ *
+ * The weight destination attribute can be used to control the
+ * distribution of connections to the destinations, a destination with
+ * weight 0 gets no table positions.
+ */
+
+#define KMSG_COMPONENT "IPVS"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/ip.h>
+#include <linux/slab.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/skbuff.h>
+#include <linux/jhash.h>
+#include <linux/gcd.h>
+#include <linux/sort.h>
+
+#include <net/ip_vs.h>
+
+#include <net/tcp.h>
+#include <linux/udp.h>
+#include <linux/sctp.h>
+
+
+struct ip_vs_mh_lookup {
+	struct ip_vs_dest __rcu	*dest;	/* real server */
+};
+
+/* Per destination state while populating the lookup table */
+struct ip_vs_mh_dest_setup {
+	struct ip_vs_dest	*dest;
+	unsigned int		pos;	/* next position in the preference list */
+	unsigned int		skip;	/* step of the preference list */
+	unsigned int		turns;	/* positions taken per round */
+};
+
+/* Available prime numbers for the lookup table size */
+static const unsigned int primes[] = {251, 509, 1021, 2039, 4093,
+				      8191, 16381, 32749, 65521, 131071};
+
+#ifndef CONFIG_IP_VS_MH_TAB_INDEX
+#define CONFIG_IP_VS_MH_TAB_INDEX	12
+#endif
+#define IP_VS_MH_TAB_BITS		CONFIG_IP_VS_MH_TAB_INDEX
+#define IP_VS_MH_TAB_SIZE		primes[IP_VS_MH_TAB_BITS - 8]
+
+/* Fixed hash seeds: every director has to compute the same table */
+#define IP_VS_MH_SEED_OFFSET		2654435761U
+#define IP_VS_MH_SEED_SKIP		2654435801U
+#define IP_VS_MH_SEED_SRC		2654435769U
+
+struct ip_vs_mh_state {
+	struct rcu_head			rcu_head;
+	struct ip_vs_mh_lookup		*lookup;
+};
+
+/* Helper function to determine if server is unavailable */
+static inline bool is_unavailable(struct ip_vs_dest *dest)
+{
+	return atomic_read(&dest->weight) <= 0 ||
+	       dest->flags & IP_VS_DEST_F_OVERLOAD;
+}
+
+/*
+ *	Returns hash value for an address/port pair
+ */
+static inline unsigned int
+ip_vs_mh_hashkey(int af, const union nf_inet_addr *addr,
+		 __be16 port, u32 seed, unsigned int offset)
+{
+	u32 addr_fold = ntohl(addr->ip);
+
+#ifdef CONFIG_IP_VS_IPV6
+	if (af == AF_INET6)
+		addr_fold = ntohl(addr->ip6[0]) ^ ntohl(addr->ip6[1]) ^
+			    ntohl(addr->ip6[2]) ^ ntohl(addr->ip6[3]);
+#endif
+	return jhash_3words(addr_fold, ntohs(port), offset, seed);
+}
+
+
+/*
+ *      Get ip_vs_dest associated with supplied parameters.
+ */
+static inline struct ip_vs_dest *
+ip_vs_mh_get(struct ip_vs_service *svc, struct ip_vs_mh_state *s,
+	     const union nf_inet_addr *addr, __be16 port)
+{
+	unsigned int hash = ip_vs_mh_hashkey(svc->af, addr, port,
+					     IP_VS_MH_SEED_SRC, 0) %
+			    IP_VS_MH_TAB_SIZE;
+	struct ip_vs_dest *dest = rcu_dereference(s->lookup[hash].dest);
+
+	return (!dest || is_unavailable(dest)) ? NULL : dest;
+}
+
+
+/* As ip_vs_mh_get, but with fallback if selected server is unavailable
+ *
+ * Like the sh scheduler, the fallback rehashes with an offset taken
+ * from the original hash value, to stay deterministic.
+ */
+static inline struct ip_vs_dest *
+ip_vs_mh_get_fallback(struct ip_vs_service *svc, struct ip_vs_mh_state *s,
+		      const union nf_inet_addr *addr, __be16 port)
+{
+	unsigned int offset, roffset;
+	unsigned int hash, ihash;
+	struct ip_vs_dest *dest;
+
+	/* first try the dest it's supposed to go to */
+	ihash = ip_vs_mh_hashkey(svc->af, addr, port, IP_VS_MH_SEED_SRC, 0) %
+		IP_VS_MH_TAB_SIZE;
+	dest = rcu_dereference(s->lookup[ihash].dest);
+	if (!dest)
+		return NULL;
+	if (!is_unavailable(dest))
+		return dest;
+
+	IP_VS_DBG_BUF(6, "MH: selected unavailable server %s:%d, reselecting",
+		      IP_VS_DBG_ADDR(dest->af, &dest->addr), ntohs(dest->port));
+
+	/* if the original dest is unavailable, loop around the table
+	 * starting from ihash to find a new dest
+	 */
+	for (offset = 0; offset < IP_VS_MH_TAB_SIZE; offset++) {
+		roffset = (offset + ihash) % IP_VS_MH_TAB_SIZE;
+		hash = ip_vs_mh_hashkey(svc->af, addr, port, IP_VS_MH_SEED_SRC,
+					roffset) % IP_VS_MH_TAB_SIZE;
+		dest = rcu_dereference(s->lookup[hash].dest);
+		if (!dest)
+			break;
+		if (!is_unavailable(dest))
+			return dest;
+		IP_VS_DBG_BUF(6, "MH: selected unavailable "
+			      "server %s:%d (offset %d), reselecting",
+			      IP_VS_DBG_ADDR(dest->af, &dest->addr),
+			      ntohs(dest->port), roffset);
+	}
+
+	return NULL;
+}
+
+
+static void ip_vs_mh_assign(struct ip_vs_mh_lookup *l, struct ip_vs_dest *dest)
+{
+	struct ip_vs_dest *old = rcu_dereference_protected(l->dest, 1);
+
+	if (old == dest)
+		return;
+	if (old)
+		ip_vs_dest_put(old);
+	if (dest)
+		ip_vs_dest_hold(dest);
+	RCU_INIT_POINTER(l->dest, dest);
+}
+
+/*
+ *      Flush all the entries of the lookup table.
+ */
+static void ip_vs_mh_flush(struct ip_vs_mh_state *s)
+{
+	int i;
+
+	for (i = 0; i < IP_VS_MH_TAB_SIZE; i++)
+		ip_vs_mh_assign(&s->lookup[i], NULL);
+}
+
+/* Order destinations by address and port, so that the outcome of the
+ * population does not depend on the configuration order.
+ */
+static int ip_vs_mh_dest_cmp(const void *a, const void *b)
+{
+	const struct ip_vs_mh_dest_setup *da = a, *db = b;
+	int d;
+
+	d = memcmp(&da->dest->addr, &db->dest->addr, sizeof(da->dest->addr));
+	if (d)
+		return d;
+	return ntohs(da->dest->port) - ntohs(db->dest->port);
+}
+
+/*
+ *      Populate the lookup table with the current destinations.
+ *
+ *      Every destination walks its own permutation of the table positions,
+ *      given by an offset and a skip derived from its address, and takes
+ *      the first free position, "turns" times per round.  The rounds go on
+ *      until the table is full.
+ */
+static int
+ip_vs_mh_populate(struct ip_vs_mh_state *s, struct ip_vs_service *svc)
+{
+	struct ip_vs_mh_dest_setup *setup, *ds;
+	struct ip_vs_dest *dest;
+	unsigned long *table;
+	int i, num = 0, g = 0, mw = 0, shift, weight;
+	unsigned int n, t, c;
+
+	list_for_each_entry(dest, &svc->destinations, n_list) {
+		weight = atomic_read(&dest->weight);
+		if (weight <= 0)
+			continue;
+		g = g ? gcd(g, weight) : weight;
+		mw = max(mw, weight);
+		num++;
+	}
+
+	if (!num) {
+		ip_vs_mh_flush(s);
+		return 0;
+	}
+
+	setup = kcalloc(num, sizeof(*setup), GFP_KERNEL);
+	table = kcalloc(BITS_TO_LONGS(IP_VS_MH_TAB_SIZE), sizeof(unsigned long),
+			GFP_KERNEL);
+	if (!setup || !table) {
+		kfree(setup);
+		kfree(table);
+		return -ENOMEM;
+	}
+
+	i = 0;
+	list_for_each_entry(dest, &svc->destinations, n_list) {
+		if (atomic_read(&dest->weight) > 0)
+			setup[i++].dest = dest;
+	}
+	sort(setup, num, sizeof(*setup), ip_vs_mh_dest_cmp, NULL);
+
+	/* Keep the number of turns per round within the table size */
+	shift = fls(mw / g) - IP_VS_MH_TAB_BITS;
+	if (shift < 0)
+		shift = 0;
+
+	for (i = 0; i < num; i++) {
+		ds = &setup[i];
+		dest = ds->dest;
+		ds->pos = ip_vs_mh_hashkey(dest->af, &dest->addr, dest->port,
+					   IP_VS_MH_SEED_OFFSET, 0) %
+			  IP_VS_MH_TAB_SIZE;
+		ds->skip = ip_vs_mh_hashkey(dest->af, &dest->addr, dest->port,
+					    IP_VS_MH_SEED_SKIP, 0) %
+			   (IP_VS_MH_TAB_SIZE - 1) + 1;
+		ds->turns = max((atomic_read(&dest->weight) / g) >> shift, 1);
+	}
+
+	/* The table size is prime, so each preference list visits all
+	 * positions and a free one is always found.
+	 */
+	n = 0;
+	while (n < IP_VS_MH_TAB_SIZE) {
+		for (i = 0; i < num && n < IP_VS_MH_TAB_SIZE; i++) {
+			ds = &setup[i];
+			for (t = 0; t < ds->turns && n < IP_VS_MH_TAB_SIZE; t++) {
+				do {
+					c = ds->pos;
+					ds->pos = (ds->pos + ds->skip) %
+						  IP_VS_MH_TAB_SIZE;
+				} while (test_bit(c, table));
+
+				__set_bit(c, table);
+				ip_vs_mh_assign(&s->lookup[c], ds->dest);
+				n++;
+			}
+		}
+	}
+
+	IP_VS_DBG(6, "MH: populated %u positions with %d destinations\n",
+		  n, num);
+
+	kfree(table);
+	kfree(setup);
+	return 0;
+}
+
+
+static int ip_vs_mh_init_svc(struct ip_vs_service *svc)
+{
+	struct ip_vs_mh_state *s;
+	int ret;
+
+	/* allocate the MH table for this service */
+	s = kzalloc(sizeof(struct ip_vs_mh_state), GFP_KERNEL);
+	if (s == NULL)
+		return -ENOMEM;
+
+	s->lookup = kcalloc(IP_VS_MH_TAB_SIZE, sizeof(struct ip_vs_mh_lookup),
+			    GFP_KERNEL);
+	if (s->lookup == NULL) {
+		kfree(s);
+		return -ENOMEM;
+	}
+
+	IP_VS_DBG(6, "MH lookup table (memory=%Zdbytes) allocated for "
+		  "current service\n",
+		  sizeof(struct ip_vs_mh_lookup) * IP_VS_MH_TAB_SIZE);
+
+	/* populate the lookup table with current dests */
+	ret = ip_vs_mh_populate(s, svc);
+	if (ret < 0) {
+		ip_vs_mh_flush(s);
+		kfree(s->lookup);
+		kfree(s);
+		return ret;
+	}
+
+	svc->sched_data = s;
+	return 0;
+}
+
+
+static void ip_vs_mh_state_free(struct rcu_head *head)
+{
+	struct ip_vs_mh_state *s;
+
+	s = container_of(head, struct ip_vs_mh_state, rcu_head);
+	kfree(s->lookup);
+	kfree(s);
+}
+
+static void ip_vs_mh_done_svc(struct ip_vs_service *svc)
+{
+	struct ip_vs_mh_state *s = svc->sched_data;
+
+	/* got to clean up lookup entries here */
+	ip_vs_mh_flush(s);
+
+	/* release the table itself */
+	call_rcu(&s->rcu_head, ip_vs_mh_state_free);
+	IP_VS_DBG(6, "MH lookup table (memory=%Zdbytes) released\n",
+		  sizeof(struct ip_vs_mh_lookup) * IP_VS_MH_TAB_SIZE);
+}
+
+
+static int ip_vs_mh_dest_changed(struct ip_vs_service *svc,
+				 struct ip_vs_dest *dest)
+{
+	struct ip_vs_mh_state *s = svc->sched_data;
+
+	/* populate the lookup table with the updated service */
+	return ip_vs_mh_populate(s, svc);
+}
+
+
+/* Helper function to get port number */
+static inline __be16
+ip_vs_mh_get_port(const struct sk_buff *skb, struct ip_vs_iphdr *iph)
+{
+	__be16 port;
+	struct tcphdr _tcph, *th;
+	struct udphdr _udph, *uh;
+	sctp_sctphdr_t _sctph, *sh;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		th = skb_header_pointer(skb, iph->len, sizeof(_tcph), &_tcph);
+		if (unlikely(th == NULL))
+			return 0;
+		port = th->source;
+		break;
+	case IPPROTO_UDP:
+		uh = skb_header_pointer(skb, iph->len, sizeof(_udph), &_udph);
+		if (unlikely(uh == NULL))
+			return 0;
+		port = uh->source;
+		break;
+	case IPPROTO_SCTP:
+		sh = skb_header_pointer(skb, iph->len, sizeof(_sctph), &_sctph);
+		if (unlikely(sh == NULL))
+			return 0;
+		port = sh->source;
+		break;
+	default:
+		port = 0;
+	}
+
+	return port;
+}
+
+
+/*
+ *      Maglev Hashing scheduling
+ */
+static struct ip_vs_dest *
+ip_vs_mh_schedule(struct ip_vs_service *svc, const struct sk_buff *skb,
+		  struct ip_vs_iphdr *iph)
+{
+	struct ip_vs_dest *dest;
+	struct ip_vs_mh_state *s;
+	__be16 port = 0;
+
+	IP_VS_DBG(6, "ip_vs_mh_schedule(): Scheduling...\n");
+
+	if (svc->flags & IP_VS_SVC_F_SCHED_MH_PORT)
+		port = ip_vs_mh_get_port(skb, iph);
+
+	s = (struct ip_vs_mh_state *) svc->sched_data;
+
+	if (svc->flags & IP_VS_SVC_F_SCHED_MH_FALLBACK)
+		dest = ip_vs_mh_get_fallback(svc, s, &iph->saddr, port);
+	else
+		dest = ip_vs_mh_get(svc, s, &iph->saddr, port);
+
+	if (!dest) {
+		ip_vs_scheduler_err(svc, "no destination available");
+		return NULL;
+	}
+
+	IP_VS_DBG_BUF(6, "MH: source IP address %s:%d --> server %s:%d\n",
+		      IP_VS_DBG_ADDR(svc->af, &iph->saddr), ntohs(port),
+		      IP_VS_DBG_ADDR(dest->af, &dest->addr),
+		      ntohs(dest->port));
+
+	return dest;
+}
+
+
+/*
+ *      IPVS MH Scheduler structure
+ */
+static struct ip_vs_scheduler ip_vs_mh_scheduler =
+{
+	.name =			"mh",
+	.refcnt =		ATOMIC_INIT(0),
+	.module =		THIS_MODULE,
+	.n_list	 =		LIST_HEAD_INIT(ip_vs_mh_scheduler.n_list),
+	.init_service =		ip_vs_mh_init_svc,
+	.done_service =		ip_vs_mh_done_svc,
+	.add_dest =		ip_vs_mh_dest_changed,
+	.del_dest =		ip_vs_mh_dest_changed,
+	.upd_dest =		ip_vs_mh_dest_changed,
+	.schedule =		ip_vs_mh_schedule,
+};
+
+
+static int __init ip_vs_mh_init(void)
+{
+	return register_ip_vs_scheduler(&ip_vs_mh_scheduler);
+}
+
+
+static void __exit ip_vs_mh_cleanup(void)
+{
+	unregister_ip_vs_scheduler(&ip_vs_mh_scheduler);
+	rcu_barrier();
+}
+
+
+module_init(ip_vs_mh_init);
+module_exit(ip_vs_mh_cleanup);
+MODULE_DESCRIPTION("Maglev hashing ipvs scheduler");
+MODULE_LICENSE("GPL");
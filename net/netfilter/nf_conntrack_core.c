@@ -296,7 +296,6 @@ destroy_conntrack(struct nf_conntrack *nfct)
 
 	pr_debug("destroy_conntrack(%p)\n", ct);
 	NF_CT_ASSERT(atomic_read(&nfct->use) == 0);
-	NF_CT_ASSERT(!timer_pending(&ct->timeout));
 
 	rcu_read_lock();
 	l4proto = __nf_ct_l4proto_find(nf_ct_l3num(ct), nf_ct_protonum(ct));
@@ -352,37 +351,46 @@ static void nf_ct_delete_from_lists(struct nf_conn *ct)
 	local_bh_enable();
 }
 
+/* Whoever sets the dying bit first owns the hash table reference and is
+ * the only one allowed to unlink the entry.
+ */
 bool nf_ct_delete(struct nf_conn *ct, u32 portid, int report)
 {
 	struct nf_conn_tstamp *tstamp;
 
+	if (test_and_set_bit(IPS_DYING_BIT, &ct->status))
+		return false;
+
 	tstamp = nf_conn_tstamp_find(ct);
 	if (tstamp && tstamp->stop == 0)
 		tstamp->stop = ktime_get_real_ns();
 
-	if (nf_ct_is_dying(ct))
-		goto delete;
-
 	if (nf_conntrack_event_report(IPCT_DESTROY, ct,
 				    portid, report) < 0) {
-		/* destroy event was not delivered */
+		/* destroy event was not delivered, nf_ct_put will be done
+		 * by the event cache worker on redelivery.
+		 */
 		nf_ct_delete_from_lists(ct);
 		nf_conntrack_ecache_delayed_work(nf_ct_net(ct));
 		return false;
 	}
 
 	nf_conntrack_ecache_work(nf_ct_net(ct));
-	set_bit(IPS_DYING_BIT, &ct->status);
- delete:
 	nf_ct_delete_from_lists(ct);
 	nf_ct_put(ct);
 	return true;
 }
 EXPORT_SYMBOL_GPL(nf_ct_delete);
 
-static void death_by_timeout(unsigned long ul_conntrack)
+static void nf_ct_gc_expired(struct nf_conn *ct)
 {
-	nf_ct_delete((struct nf_conn *)ul_conntrack, 0, 0);
+	if (!atomic_inc_not_zero(&ct->ct_general.use))
+		return;
+
+	if (nf_ct_should_gc(ct))
+		nf_ct_kill(ct);
+
+	nf_ct_put(ct);
 }
 
 static inline bool
@@ -419,6 +427,13 @@ ____nf_conntrack_find(struct net *net, u16 zone,
 	local_bh_disable();
 begin:
 	hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[bucket], hnnode) {
+		struct nf_conn *ct = nf_ct_tuplehash_to_ctrack(h);
+
+		if (nf_ct_is_expired(ct)) {
+			nf_ct_gc_expired(ct);
+			continue;
+		}
+
 		if (nf_ct_key_equal(h, tuple, zone)) {
 			NF_CT_STAT_INC(net, found);
 			local_bh_enable();
@@ -522,7 +537,7 @@ nf_conntrack_hash_check_insert(struct nf_conn *ct)
 		    zone == nf_ct_zone(nf_ct_tuplehash_to_ctrack(h)))
 			goto out;
 
-	add_timer(&ct->timeout);
+	ct->timeout += nfct_time_stamp;
 	smp_wmb();
 	/* The caller holds a reference to this object */
 	atomic_set(&ct->ct_general.use, 2);
@@ -635,11 +650,10 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 		    zone == nf_ct_zone(nf_ct_tuplehash_to_ctrack(h)))
 			goto out;
 
-	/* Timer relative to confirmation time, not original
+	/* Timeout is relative to confirmation time, not original
 	   setting time, otherwise we'd get timer wrap in
 	   weird delay cases. */
-	ct->timeout.expires += jiffies;
-	add_timer(&ct->timeout);
+	ct->timeout += nfct_time_stamp;
 	atomic_inc(&ct->ct_general.use);
 	ct->status |= IPS_CONFIRMED;
 
@@ -652,7 +666,7 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 		tstamp->start = ktime_to_ns(skb->tstamp);
 	}
 	/* Since the lookup is lockless, hash insertion must be done after
-	 * starting the timer and setting the CONFIRMED bit. The RCU barriers
+	 * setting the timeout and the CONFIRMED bit. The RCU barriers
 	 * guarantee that no other CPU can find the conntrack before the above
 	 * stores are visible.
 	 */
@@ -714,62 +728,151 @@ EXPORT_SYMBOL_GPL(nf_conntrack_tuple_taken);
 
 #define NF_CT_EVICTION_RANGE	8
 
-/* There's a small race here where we may free a just-assured
-   connection.  Too bad: we're in trouble anyway. */
-static noinline int early_drop(struct net *net, unsigned int _hash)
+static void nf_conntrack_get_ht(struct net *net,
+				struct hlist_nulls_head **hash,
+				unsigned int *hsize)
+{
+	unsigned int sequence;
+
+	do {
+		sequence = read_seqcount_begin(&net->ct.generation);
+		*hsize = net->ct.htable_size;
+		*hash = net->ct.hash;
+	} while (read_seqcount_retry(&net->ct.generation, sequence));
+}
+
+static noinline int early_drop_list(struct hlist_nulls_head *head)
 {
-	/* Use oldest entry, which is roughly LRU */
 	struct nf_conntrack_tuple_hash *h;
-	struct nf_conn *ct = NULL, *tmp;
 	struct hlist_nulls_node *n;
-	unsigned int i = 0, cnt = 0;
-	int dropped = 0;
-	unsigned int hash, sequence;
-	spinlock_t *lockp;
+	unsigned int drops = 0;
+	struct nf_conn *tmp;
 
-	local_bh_disable();
-restart:
-	sequence = read_seqcount_begin(&net->ct.generation);
-	hash = hash_bucket(_hash, net);
-	for (; i < net->ct.htable_size; i++) {
-		lockp = &nf_conntrack_locks[hash % CONNTRACK_LOCKS];
-		spin_lock(lockp);
-		if (read_seqcount_retry(&net->ct.generation, sequence)) {
-			spin_unlock(lockp);
-			goto restart;
-		}
-		hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[hash],
-					 hnnode) {
-			tmp = nf_ct_tuplehash_to_ctrack(h);
-			if (!test_bit(IPS_ASSURED_BIT, &tmp->status) &&
-			    !nf_ct_is_dying(tmp) &&
-			    atomic_inc_not_zero(&tmp->ct_general.use)) {
-				ct = tmp;
-				break;
-			}
-			cnt++;
+	hlist_nulls_for_each_entry_rcu(h, n, head, hnnode) {
+		tmp = nf_ct_tuplehash_to_ctrack(h);
+
+		if (nf_ct_is_expired(tmp)) {
+			nf_ct_gc_expired(tmp);
+			continue;
 		}
 
-		hash = (hash + 1) % net->ct.htable_size;
-		spin_unlock(lockp);
+		if (test_bit(IPS_ASSURED_BIT, &tmp->status) ||
+		    nf_ct_is_dying(tmp))
+			continue;
 
-		if (ct || cnt >= NF_CT_EVICTION_RANGE)
-			break;
+		if (!atomic_inc_not_zero(&tmp->ct_general.use))
+			continue;
 
+		/* The entry may have been recycled (SLAB_DESTROY_BY_RCU)
+		 * and not be in the table anymore.  nf_ct_delete() fails
+		 * if someone else already killed it.
+		 */
+		if (nf_ct_is_confirmed(tmp) && nf_ct_delete(tmp, 0, 0))
+			drops++;
+
+		nf_ct_put(tmp);
 	}
-	local_bh_enable();
 
-	if (!ct)
-		return dropped;
+	return drops;
+}
+
+/* Evict unassured entries from at most NF_CT_EVICTION_RANGE buckets
+ * following the one the new entry hashes to.  Buckets are walked under
+ * RCU only; the bucket locks are taken just for the final unlink.
+ */
+static noinline bool early_drop(struct net *net, unsigned int _hash)
+{
+	unsigned int i;
+
+	for (i = 0; i < NF_CT_EVICTION_RANGE; i++) {
+		struct hlist_nulls_head *ct_hash;
+		unsigned int hash, hsize, drops;
 
-	if (del_timer(&ct->timeout)) {
-		if (nf_ct_delete(ct, 0, 0)) {
-			dropped = 1;
-			NF_CT_STAT_INC_ATOMIC(net, early_drop);
+		rcu_read_lock();
+		nf_conntrack_get_ht(net, &ct_hash, &hsize);
+		hash = reciprocal_scale(_hash++, hsize);
+
+		drops = early_drop_list(&ct_hash[hash]);
+		rcu_read_unlock();
+
+		if (drops) {
+			NF_CT_STAT_ADD_ATOMIC(net, early_drop, drops);
+			return true;
 		}
 	}
-	nf_ct_put(ct);
-	return dropped;
+
+	return false;
+}
+
+/* The gc worker visits 1/GC_MAX_BUCKETS_DIV of the table per run, but
+ * no more than GC_MAX_BUCKETS buckets and GC_MAX_EVICTS evictions.  It
+ * reschedules itself immediately while most of what it sees is expired.
+ * Lookups and early drop reap expired entries they stumble upon, too.
+ */
+#define GC_MAX_BUCKETS_DIV	64u
+#define GC_MAX_BUCKETS		8192u
+#define GC_INTERVAL		(5 * HZ)
+#define GC_MAX_EVICTS		256u
+
+static void gc_worker(struct work_struct *work)
+{
+	unsigned int i, goal, buckets = 0, expired_count = 0;
+	unsigned long next_run = GC_INTERVAL;
+	unsigned int ratio, scanned = 0;
+	struct netns_ct *ctnet;
+	struct net *net;
+
+	ctnet = container_of(work, struct netns_ct, gc_dwork.work);
+	net = container_of(ctnet, struct net, ct);
+
+	goal = min(ctnet->htable_size / GC_MAX_BUCKETS_DIV, GC_MAX_BUCKETS);
+	i = ctnet->gc_next_bucket;
+
+	do {
+		struct nf_conntrack_tuple_hash *h;
+		struct hlist_nulls_head *ct_hash;
+		struct hlist_nulls_node *n;
+		unsigned int hsize;
+		struct nf_conn *tmp;
+
+		i++;
+		rcu_read_lock();
+
+		nf_conntrack_get_ht(net, &ct_hash, &hsize);
+		if (i >= hsize)
+			i = 0;
+
+		hlist_nulls_for_each_entry_rcu(h, n, &ct_hash[i], hnnode) {
+			tmp = nf_ct_tuplehash_to_ctrack(h);
+
+			scanned++;
+			if (nf_ct_is_expired(tmp)) {
+				nf_ct_gc_expired(tmp);
+				expired_count++;
+				continue;
+			}
+		}
+
+		/* We could check get_nulls_value() here and restart if the
+		 * entry moved to another chain, but gc is best effort and
+		 * we simply continue with the next bucket.
+		 */
+		rcu_read_unlock();
+		cond_resched_rcu_qs();
+	} while (++buckets < goal && expired_count < GC_MAX_EVICTS);
+
+	if (ctnet->gc_exiting)
+		return;
+
+	/* Mostly expired entries, or an eviction budget used up: there is
+	 * more work pending, come back right away.
+	 */
+	ratio = scanned ? expired_count * 100 / scanned : 0;
+	if (ratio >= 90 || expired_count == GC_MAX_EVICTS)
+		next_run = 0;
+
+	ctnet->gc_next_bucket = i;
+	queue_delayed_work(system_long_wq, &ctnet->gc_dwork, next_run);
 }
 
 void init_nf_conntrack_hash_rnd(void)
@@ -829,8 +932,8 @@ __nf_conntrack_alloc(struct net *net, u16 zone,
 	/* save hash for reusing when confirming */
 	*(unsigned long *)(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode.pprev) = hash;
 	ct->status = 0;
-	/* Don't set timer yet: wait for confirmation */
-	setup_timer(&ct->timeout, death_by_timeout, (unsigned long)ct);
+	/* Relative until confirmation, see __nf_conntrack_confirm() */
+	ct->timeout = 0;
 	write_pnet(&ct->ct_net, net);
 	memset(&ct->__nfct_init_offset[0], 0,
 	       offsetof(struct nf_conn, proto) -
@@ -1207,25 +1310,19 @@ void __nf_ct_refresh_acct(struct nf_conn *ct,
 			  unsigned long extra_jiffies,
 			  int do_acct)
 {
-	NF_CT_ASSERT(ct->timeout.data == (unsigned long)ct);
 	NF_CT_ASSERT(skb);
 
 	/* Only update if this is not a fixed timeout */
 	if (test_bit(IPS_FIXED_TIMEOUT_BIT, &ct->status))
 		goto acct;
 
-	/* If not in hash table, timer will not be active yet */
-	if (!nf_ct_is_confirmed(ct)) {
-		ct->timeout.expires = extra_jiffies;
-	} else {
-		unsigned long newtime = jiffies + extra_jiffies;
+	/* If not in hash table, timeout is relative to confirmation */
+	if (nf_ct_is_confirmed(ct))
+		extra_jiffies += nfct_time_stamp;
 
-		/* Only update the timeout if the new timeout is at least
-		   HZ jiffies from the old timeout. Need del_timer for race
-		   avoidance (may already be dying). */
-		if (newtime - ct->timeout.expires >= HZ)
-			mod_timer_pending(&ct->timeout, newtime);
-	}
+	/* Avoid dirtying the cache line on every packet */
+	if (ct->timeout != extra_jiffies)
+		ct->timeout = extra_jiffies;
 
 acct:
 	if (do_acct) {
@@ -1260,11 +1357,11 @@ bool __nf_ct_kill_acct(struct nf_conn *ct,
 		}
 	}
 
-	if (del_timer(&ct->timeout)) {
-		ct->timeout.function((unsigned long)ct);
-		return true;
-	}
-	return false;
+	/* Not in the hash table yet, nothing to unlink */
+	if (!nf_ct_is_confirmed(ct))
+		return false;
+
+	return nf_ct_delete(ct, 0, 0);
 }
 EXPORT_SYMBOL_GPL(__nf_ct_kill_acct);
 
@@ -1399,11 +1496,7 @@ void nf_ct_iterate_cleanup(struct net *net,
 
 	while ((ct = get_next_corpse(net, iter, data, &bucket)) != NULL) {
 		/* Time to push up daises... */
-		if (del_timer(&ct->timeout))
-			nf_ct_delete(ct, portid, report);
-
-		/* ... else the timer will get him soon. */
-
+		nf_ct_delete(ct, portid, report);
 		nf_ct_put(ct);
 	}
 }
@@ -1478,6 +1571,11 @@ void nf_conntrack_cleanup_net_list(struct list_head *net_exit_list)
 	int busy;
 	struct net *net;
 
+	list_for_each_entry(net, net_exit_list, exit_list) {
+		net->ct.gc_exiting = true;
+		cancel_delayed_work_sync(&net->ct.gc_dwork);
+	}
+
 	/*
 	 * This makes sure all current packets have passed through
 	 *  netfilter framework.  Roll on, two-stage module
@@ -1591,6 +1689,8 @@ int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
 	nf_conntrack_all_unlock();
 	local_bh_enable();
 
+	/* lockless walkers (gc, early drop) may still use the old table */
+	synchronize_net();
 	nf_ct_free_hashtable(old_hash, old_size);
 	return 0;
 }
@@ -1794,6 +1894,11 @@ int nf_conntrack_init_net(struct net *net)
 	ret = nf_conntrack_proto_pernet_init(net);
 	if (ret < 0)
 		goto err_proto;
+
+	net->ct.gc_next_bucket = 0;
+	net->ct.gc_exiting = false;
+	INIT_DELAYED_WORK(&net->ct.gc_dwork, gc_worker);
+	queue_delayed_work(system_long_wq, &net->ct.gc_dwork, GC_INTERVAL);
 	return 0;
 
 err_proto:
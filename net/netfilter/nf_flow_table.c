@@ -0,0 +1,409 @@
+/*
+ * Flow table for established connections, see nf_flow_table.h.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/netfilter.h>
+#include <linux/rhashtable.h>
+#include <linux/netdevice.h>
+#include <linux/netfilter/nf_conntrack_tcp.h>
+#include <net/ip.h>
+#include <net/netfilter/nf_flow_table.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_core.h>
+#include <net/netfilter/nf_conntrack_l4proto.h>
+#include <net/netfilter/nf_conntrack_tuple.h>
+
+/* conntrack timeout while a connection is offloaded, refreshed by gc */
+#define NF_FLOW_CT_TIMEOUT	(86400 * HZ)
+
+static void
+flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
+		      struct nf_flow_route *route,
+		      enum flow_offload_tuple_dir dir)
+{
+	struct flow_offload_tuple *ft = &flow->tuplehash[dir].tuple;
+	struct nf_conntrack_tuple *ctt = &ct->tuplehash[dir].tuple;
+	struct dst_entry *dst = route->tuple[dir].dst;
+
+	ft->dir = dir;
+
+	switch (ctt->src.l3num) {
+	case NFPROTO_IPV4:
+		ft->src_v4 = ctt->src.u3.in;
+		ft->dst_v4 = ctt->dst.u3.in;
+		ft->mtu = ip_dst_mtu_maybe_forward(dst, true);
+		break;
+	case NFPROTO_IPV6:
+		ft->src_v6 = ctt->src.u3.in6;
+		ft->dst_v6 = ctt->dst.u3.in6;
+		ft->mtu = dst_mtu(dst);
+		break;
+	}
+
+	ft->l3proto = ctt->src.l3num;
+	ft->l4proto = ctt->dst.protonum;
+	ft->src_port = ctt->src.u.tcp.port;
+	ft->dst_port = ctt->dst.u.tcp.port;
+
+	ft->iifidx = route->tuple[dir].ifindex;
+	ft->oifidx = dst->dev->ifindex;
+	ft->dst_cache = dst;
+}
+
+/**
+ * flow_offload_alloc - allocate a flow for an established connection
+ * @ct: the connection, a reference is taken
+ * @route: routes and input interfaces of both directions, a reference
+ *	is taken on the routes
+ *
+ * The caller must own IPS_OFFLOAD_BIT on @ct.
+ */
+struct flow_offload *
+flow_offload_alloc(struct nf_conn *ct, struct nf_flow_route *route)
+{
+	struct flow_offload *flow;
+
+	if (unlikely(nf_ct_is_dying(ct) ||
+	    !atomic_inc_not_zero(&ct->ct_general.use)))
+		return NULL;
+
+	flow = kzalloc(sizeof(*flow), GFP_ATOMIC);
+	if (!flow) {
+		nf_ct_put(ct);
+		return NULL;
+	}
+
+	flow->ct = ct;
+	INIT_LIST_HEAD(&flow->hw_list);
+
+	dst_hold(route->tuple[FLOW_OFFLOAD_DIR_ORIGINAL].dst);
+	dst_hold(route->tuple[FLOW_OFFLOAD_DIR_REPLY].dst);
+
+	flow_offload_fill_dir(flow, ct, route, FLOW_OFFLOAD_DIR_ORIGINAL);
+	flow_offload_fill_dir(flow, ct, route, FLOW_OFFLOAD_DIR_REPLY);
+
+	if (ct->status & IPS_SRC_NAT)
+		__set_bit(NF_FLOW_SNAT, &flow->flags);
+	if (ct->status & IPS_DST_NAT)
+		__set_bit(NF_FLOW_DNAT, &flow->flags);
+
+	return flow;
+}
+EXPORT_SYMBOL_GPL(flow_offload_alloc);
+
+static void flow_offload_free_rcu(struct rcu_head *head)
+{
+	struct flow_offload *flow = container_of(head, struct flow_offload,
+						 rcu_head);
+
+	dst_release(flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple.dst_cache);
+	dst_release(flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].tuple.dst_cache);
+	nf_ct_put(flow->ct);
+	kfree(flow);
+}
+
+/* Lookups run under RCU only, so the routes and conntrack are dropped
+ * after a grace period.
+ */
+void flow_offload_free(struct flow_offload *flow)
+{
+	call_rcu(&flow->rcu_head, flow_offload_free_rcu);
+}
+EXPORT_SYMBOL_GPL(flow_offload_free);
+
+static const struct rhashtable_params nf_flow_offload_rhash_params = {
+	.head_offset		= offsetof(struct flow_offload_tuple_rhash, node),
+	.key_offset		= offsetof(struct flow_offload_tuple_rhash, tuple),
+	.key_len		= offsetof(struct flow_offload_tuple, dir),
+	.automatic_shrinking	= true,
+};
+
+/* Conntrack does not see the packets of an offloaded connection, keep
+ * the gc from reaping it.
+ */
+static void flow_offload_ct_keepalive(struct nf_conn *ct)
+{
+	if (nf_ct_expires(ct) < NF_FLOW_CT_TIMEOUT / 2)
+		ct->timeout = nfct_time_stamp + NF_FLOW_CT_TIMEOUT;
+}
+
+/* Hand the connection back to conntrack with the timeout it would have
+ * had if it had seen the last packet itself.
+ */
+static void flow_offload_fixup_ct(struct nf_conn *ct)
+{
+	struct nf_conntrack_l4proto *l4proto;
+	unsigned int *timeouts;
+	unsigned int timeout;
+
+	clear_bit(IPS_OFFLOAD_BIT, &ct->status);
+
+	rcu_read_lock();
+	l4proto = __nf_ct_l4proto_find(nf_ct_l3num(ct), nf_ct_protonum(ct));
+	timeouts = l4proto->get_timeouts(nf_ct_net(ct));
+
+	switch (nf_ct_protonum(ct)) {
+	case IPPROTO_TCP:
+		/* The window moved on without conntrack, let it pick up
+		 * the window again from the next packets.
+		 */
+		spin_lock_bh(&ct->lock);
+		ct->proto.tcp.seen[0].td_maxwin = 0;
+		ct->proto.tcp.seen[1].td_maxwin = 0;
+		spin_unlock_bh(&ct->lock);
+		timeout = timeouts[TCP_CONNTRACK_ESTABLISHED];
+		break;
+	case IPPROTO_UDP:
+		timeout = timeouts[UDP_CT_REPLIED];
+		break;
+	default:
+		rcu_read_unlock();
+		return;
+	}
+	rcu_read_unlock();
+
+	ct->timeout = nfct_time_stamp + timeout;
+}
+
+static void flow_offload_hw_queue(struct nf_flowtable *flow_table,
+				  struct flow_offload *flow)
+{
+	spin_lock_bh(&flow_table->hw_lock);
+	if (list_empty(&flow->hw_list))
+		list_add_tail(&flow->hw_list, &flow_table->hw_list);
+	spin_unlock_bh(&flow_table->hw_lock);
+
+	schedule_work(&flow_table->hw_work);
+}
+
+static void flow_offload_hw_call(struct nf_flowtable *flow_table,
+				 struct flow_offload *flow,
+				 enum flow_offload_type type)
+{
+	const struct flow_offload_tuple *tuple;
+	struct net_device *dev;
+	int err = -EOPNOTSUPP;
+
+	tuple = &flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].tuple;
+	dev = dev_get_by_index(flow_table->net, tuple->iifidx);
+	if (!dev)
+		return;
+
+	if (dev->netdev_ops->ndo_flow_offload)
+		err = dev->netdev_ops->ndo_flow_offload(dev, type, flow);
+	dev_put(dev);
+
+	if (type == FLOW_OFFLOAD_ADD && !err)
+		set_bit(NF_FLOW_HW, &flow->flags);
+}
+
+static void flow_offload_hw_work(struct work_struct *work)
+{
+	struct nf_flowtable *flow_table;
+	struct flow_offload *flow;
+
+	flow_table = container_of(work, struct nf_flowtable, hw_work);
+
+	spin_lock_bh(&flow_table->hw_lock);
+	while (!list_empty(&flow_table->hw_list)) {
+		flow = list_first_entry(&flow_table->hw_list,
+					struct flow_offload, hw_list);
+		list_del_init(&flow->hw_list);
+		spin_unlock_bh(&flow_table->hw_lock);
+
+		if (!test_bit(NF_FLOW_DYING, &flow->flags)) {
+			flow_offload_hw_call(flow_table, flow, FLOW_OFFLOAD_ADD);
+		} else {
+			if (test_bit(NF_FLOW_HW, &flow->flags))
+				flow_offload_hw_call(flow_table, flow,
+						     FLOW_OFFLOAD_DEL);
+			flow_offload_free(flow);
+		}
+
+		spin_lock_bh(&flow_table->hw_lock);
+	}
+	spin_unlock_bh(&flow_table->hw_lock);
+}
+
+int flow_offload_add(struct nf_flowtable *flow_table, struct flow_offload *flow)
+{
+	int err;
+
+	flow_offload_refresh(flow);
+
+	err = rhashtable_insert_fast(&flow_table->rhashtable,
+				     &flow->tuplehash[0].node,
+				     nf_flow_offload_rhash_params);
+	if (err < 0)
+		return err;
+
+	err = rhashtable_insert_fast(&flow_table->rhashtable,
+				     &flow->tuplehash[1].node,
+				     nf_flow_offload_rhash_params);
+	if (err < 0) {
+		rhashtable_remove_fast(&flow_table->rhashtable,
+				       &flow->tuplehash[0].node,
+				       nf_flow_offload_rhash_params);
+		return err;
+	}
+
+	flow_offload_ct_keepalive(flow->ct);
+
+	if (flow_table->flags & NF_FLOWTABLE_F_HW)
+		flow_offload_hw_queue(flow_table, flow);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(flow_offload_add);
+
+/**
+ * flow_offload_del - remove a flow and hand its connection back to conntrack
+ * @flow_table: the table holding @flow
+ * @flow: the flow to remove, freed after an RCU grace period
+ */
+void flow_offload_del(struct nf_flowtable *flow_table,
+		      struct flow_offload *flow)
+{
+	rhashtable_remove_fast(&flow_table->rhashtable,
+			       &flow->tuplehash[FLOW_OFFLOAD_DIR_ORIGINAL].node,
+			       nf_flow_offload_rhash_params);
+	rhashtable_remove_fast(&flow_table->rhashtable,
+			       &flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].node,
+			       nf_flow_offload_rhash_params);
+
+	flow_offload_fixup_ct(flow->ct);
+	set_bit(NF_FLOW_DYING, &flow->flags);
+
+	/* the hardware work frees the flow once the NIC let go of it */
+	if (flow_table->flags & NF_FLOWTABLE_F_HW)
+		flow_offload_hw_queue(flow_table, flow);
+	else
+		flow_offload_free(flow);
+}
+EXPORT_SYMBOL_GPL(flow_offload_del);
+
+/* Must be called under rcu_read_lock() */
+struct flow_offload_tuple_rhash *
+flow_offload_lookup(struct nf_flowtable *flow_table,
+		    struct flow_offload_tuple *tuple)
+{
+	struct flow_offload_tuple_rhash *tuplehash;
+	struct flow_offload *flow;
+
+	tuplehash = rhashtable_lookup_fast(&flow_table->rhashtable, tuple,
+					   nf_flow_offload_rhash_params);
+	if (!tuplehash)
+		return NULL;
+
+	flow = flow_offload_from_tuplehash(tuplehash);
+	if (test_bit(NF_FLOW_TEARDOWN, &flow->flags) ||
+	    test_bit(NF_FLOW_DYING, &flow->flags))
+		return NULL;
+
+	return tuplehash;
+}
+EXPORT_SYMBOL_GPL(flow_offload_lookup);
+
+static bool nf_flow_has_expired(const struct flow_offload *flow)
+{
+	/* drivers tear down hardware flows themselves, software never
+	 * sees their packets
+	 */
+	if (test_bit(NF_FLOW_HW, &flow->flags))
+		return false;
+
+	return time_after(jiffies, flow->timeout);
+}
+
+static void nf_flow_offload_gc_step(struct nf_flowtable *flow_table,
+				    bool flush)
+{
+	struct flow_offload_tuple_rhash *tuplehash;
+	struct rhashtable_iter hti;
+	struct flow_offload *flow;
+	int err;
+
+	err = rhashtable_walk_init(&flow_table->rhashtable, &hti);
+	if (err)
+		return;
+
+	err = rhashtable_walk_start(&hti);
+	if (err && err != -EAGAIN)
+		goto out;
+
+	while ((tuplehash = rhashtable_walk_next(&hti))) {
+		if (IS_ERR(tuplehash)) {
+			if (PTR_ERR(tuplehash) != -EAGAIN)
+				break;
+			continue;
+		}
+
+		/* look at each flow once */
+		if (tuplehash->tuple.dir)
+			continue;
+
+		flow = flow_offload_from_tuplehash(tuplehash);
+
+		if (flush || nf_flow_has_expired(flow) ||
+		    nf_ct_is_dying(flow->ct) ||
+		    test_bit(NF_FLOW_TEARDOWN, &flow->flags))
+			flow_offload_del(flow_table, flow);
+		else
+			flow_offload_ct_keepalive(flow->ct);
+	}
+out:
+	rhashtable_walk_stop(&hti);
+	rhashtable_walk_exit(&hti);
+}
+
+static void nf_flow_offload_work_gc(struct work_struct *work)
+{
+	struct nf_flowtable *flow_table;
+
+	flow_table = container_of(work, struct nf_flowtable, gc_work.work);
+	nf_flow_offload_gc_step(flow_table, false);
+	queue_delayed_work(system_power_efficient_wq, &flow_table->gc_work, HZ);
+}
+
+int nf_flow_table_init(struct nf_flowtable *flow_table, struct net *net,
+		       unsigned int flags)
+{
+	int err;
+
+	err = rhashtable_init(&flow_table->rhashtable,
+			      &nf_flow_offload_rhash_params);
+	if (err < 0)
+		return err;
+
+	flow_table->net = net;
+	flow_table->flags = flags;
+	spin_lock_init(&flow_table->hw_lock);
+	INIT_LIST_HEAD(&flow_table->hw_list);
+	INIT_WORK(&flow_table->hw_work, flow_offload_hw_work);
+
+	INIT_DEFERRABLE_WORK(&flow_table->gc_work, nf_flow_offload_work_gc);
+	queue_delayed_work(system_power_efficient_wq, &flow_table->gc_work, HZ);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(nf_flow_table_init);
+
+/* The hooks feeding @flow_table must be gone already */
+void nf_flow_table_free(struct nf_flowtable *flow_table)
+{
+	cancel_delayed_work_sync(&flow_table->gc_work);
+	nf_flow_offload_gc_step(flow_table, true);
+	flush_work(&flow_table->hw_work);
+	rhashtable_destroy(&flow_table->rhashtable);
+	rcu_barrier();
+}
+EXPORT_SYMBOL_GPL(nf_flow_table_free);
+
+MODULE_LICENSE("GPL");
@@ -542,7 +542,7 @@ static int nf_nat_proto_clean(struct nf_conn *ct, void *data)
 	 * Else, when the conntrack is destoyed, nf_nat_cleanup_conntrack()
 	 * will delete entry from already-freed table.
 	 */
-	if (!del_timer(&ct->timeout))
+	if (nf_ct_is_dying(ct))
 		return 1;
 
 	spin_lock_bh(&nf_nat_lock);
@@ -551,8 +551,6 @@ static int nf_nat_proto_clean(struct nf_conn *ct, void *data)
 	nat->ct = NULL;
 	spin_unlock_bh(&nf_nat_lock);
 
-	add_timer(&ct->timeout);
-
 	/* don't delete conntrack.  Although that would make things a lot
 	 * simpler, we'd end up flushing all conntracks on nat rmmod.
 	 */
@@ -825,18 +823,25 @@ static int __net_init nf_nat_net_init(struct net *net)
 	return 0;
 }
 
-static void __net_exit nf_nat_net_exit(struct net *net)
+static void __net_exit nf_nat_net_exit_batch(struct list_head *net_exit_list)
 {
 	struct nf_nat_proto_clean clean = {};
+	struct net *net;
 
-	nf_ct_iterate_cleanup(net, nf_nat_proto_clean, &clean, 0, 0);
+	list_for_each_entry(net, net_exit_list, exit_list)
+		nf_ct_iterate_cleanup(net, nf_nat_proto_clean, &clean, 0, 0);
+
+	/* one grace period for the whole batch of dying namespaces */
 	synchronize_rcu();
-	nf_ct_free_hashtable(net->ct.nat_bysource, net->ct.nat_htable_size);
+
+	list_for_each_entry(net, net_exit_list, exit_list)
+		nf_ct_free_hashtable(net->ct.nat_bysource,
+				     net->ct.nat_htable_size);
 }
 
 static struct pernet_operations nf_nat_net_ops = {
 	.init = nf_nat_net_init,
-	.exit = nf_nat_net_exit,
+	.exit_batch = nf_nat_net_exit_batch,
 };
 
 static struct nf_ct_helper_expectfn follow_master_nat = {
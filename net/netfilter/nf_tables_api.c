@@ -1164,6 +1164,8 @@ static void nf_tables_chain_destroy(struct nft_chain *chain)
 {
 	BUG_ON(chain->use > 0);
 
+	nft_jit_chain_destroy(chain);
+
 	if (chain->flags & NFT_BASE_CHAIN) {
 		module_put(nft_base_chain(chain)->type->owner);
 		free_percpu(nft_base_chain(chain)->stats);
@@ -2268,6 +2270,11 @@ static const struct nla_policy nft_set_policy[NFTA_SET_MAX + 1] = {
 
 static const struct nla_policy nft_set_desc_policy[NFTA_SET_DESC_MAX + 1] = {
 	[NFTA_SET_DESC_SIZE]		= { .type = NLA_U32 },
+	[NFTA_SET_DESC_CONCAT]		= { .type = NLA_NESTED },
+};
+
+static const struct nla_policy nft_concat_policy[NFTA_SET_FIELD_MAX + 1] = {
+	[NFTA_SET_FIELD_LEN]		= { .type = NLA_U32 },
 };
 
 static int nft_ctx_init_from_setattr(struct nft_ctx *ctx,
@@ -2375,6 +2382,32 @@ cont:
 	return 0;
 }
 
+static int nf_tables_fill_set_concat(struct sk_buff *skb,
+				     const struct nft_set *set)
+{
+	struct nlattr *concat, *field;
+	int i;
+
+	concat = nla_nest_start(skb, NFTA_SET_DESC_CONCAT);
+	if (concat == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < set->field_count; i++) {
+		field = nla_nest_start(skb, NFTA_LIST_ELEM);
+		if (field == NULL)
+			return -ENOMEM;
+
+		if (nla_put_be32(skb, NFTA_SET_FIELD_LEN,
+				 htonl(set->field_len[i])))
+			return -ENOMEM;
+
+		nla_nest_end(skb, field);
+	}
+
+	nla_nest_end(skb, concat);
+	return 0;
+}
+
 static int nf_tables_fill_set(struct sk_buff *skb, const struct nft_ctx *ctx,
 			      const struct nft_set *set, u16 event, u16 flags)
 {
@@ -2432,6 +2465,9 @@ static int nf_tables_fill_set(struct sk_buff *skb, const struct nft_ctx *ctx,
 	if (set->size &&
 	    nla_put_be32(skb, NFTA_SET_DESC_SIZE, htonl(set->size)))
 		goto nla_put_failure;
+	if (set->field_count > 1 &&
+	    nf_tables_fill_set_concat(skb, set))
+		goto nla_put_failure;
 	nla_nest_end(skb, desc);
 
 	nlmsg_end(skb, nlh);
@@ -2602,6 +2638,59 @@ err:
 	return err;
 }
 
+static int nft_set_desc_concat_parse(const struct nlattr *attr,
+				     struct nft_set_desc *desc)
+{
+	struct nlattr *tb[NFTA_SET_FIELD_MAX + 1];
+	u32 len;
+	int err;
+
+	if (desc->field_count >= ARRAY_SIZE(desc->field_len))
+		return -E2BIG;
+
+	err = nla_parse_nested(tb, NFTA_SET_FIELD_MAX, attr, nft_concat_policy);
+	if (err < 0)
+		return err;
+
+	if (tb[NFTA_SET_FIELD_LEN] == NULL)
+		return -EINVAL;
+
+	len = ntohl(nla_get_be32(tb[NFTA_SET_FIELD_LEN]));
+	if (len == 0 || len > NFT_DATA_VALUE_MAXLEN)
+		return -EINVAL;
+
+	desc->field_len[desc->field_count++] = len;
+	return 0;
+}
+
+static int nft_set_desc_concat(struct nft_set_desc *desc,
+			       const struct nlattr *nla)
+{
+	struct nlattr *attr;
+	u32 num_regs = 0;
+	int rem, err, i;
+
+	nla_for_each_nested(attr, nla, rem) {
+		if (nla_type(attr) != NFTA_LIST_ELEM)
+			return -EINVAL;
+
+		err = nft_set_desc_concat_parse(attr, desc);
+		if (err < 0)
+			return err;
+	}
+
+	/* Each field starts on a register boundary, as laid out by the
+	 * expressions loading the concatenation into registers.
+	 */
+	for (i = 0; i < desc->field_count; i++)
+		num_regs += DIV_ROUND_UP(desc->field_len[i], NFT_REG32_SIZE);
+
+	if (num_regs * NFT_REG32_SIZE != desc->klen)
+		return -EINVAL;
+
+	return 0;
+}
+
 static int nf_tables_set_desc_parse(const struct nft_ctx *ctx,
 				    struct nft_set_desc *desc,
 				    const struct nlattr *nla)
@@ -2615,8 +2704,10 @@ static int nf_tables_set_desc_parse(const struct nft_ctx *ctx,
 
 	if (da[NFTA_SET_DESC_SIZE] != NULL)
 		desc->size = ntohl(nla_get_be32(da[NFTA_SET_DESC_SIZE]));
+	if (da[NFTA_SET_DESC_CONCAT] != NULL)
+		err = nft_set_desc_concat(desc, da[NFTA_SET_DESC_CONCAT]);
 
-	return 0;
+	return err;
 }
 
 static int nf_tables_newset(struct sock *nlsk, struct sk_buff *skb,
@@ -2662,7 +2753,8 @@ static int nf_tables_newset(struct sock *nlsk, struct sk_buff *skb,
 		flags = ntohl(nla_get_be32(nla[NFTA_SET_FLAGS]));
 		if (flags & ~(NFT_SET_ANONYMOUS | NFT_SET_CONSTANT |
 			      NFT_SET_INTERVAL | NFT_SET_TIMEOUT |
-			      NFT_SET_MAP | NFT_SET_EVAL))
+			      NFT_SET_MAP | NFT_SET_EVAL |
+			      NFT_SET_CONCAT))
 			return -EINVAL;
 		/* Only one of both operations is supported */
 		if ((flags & (NFT_SET_MAP | NFT_SET_EVAL)) ==
@@ -2714,6 +2806,10 @@ static int nf_tables_newset(struct sock *nlsk, struct sk_buff *skb,
 			return err;
 	}
 
+	/* A concatenation is described by its fields, and vice versa */
+	if (!!(flags & NFT_SET_CONCAT) != (desc.field_count > 1))
+		return -EINVAL;
+
 	create = nlh->nlmsg_flags & NLM_F_CREATE ? true : false;
 
 	afi = nf_tables_afinfo_lookup(net, nfmsg->nfgen_family, create);
@@ -2763,6 +2859,7 @@ static int nf_tables_newset(struct sock *nlsk, struct sk_buff *skb,
 		goto err2;
 
 	INIT_LIST_HEAD(&set->bindings);
+	INIT_LIST_HEAD(&set->pending_update);
 	write_pnet(&set->pnet, net);
 	set->ops   = ops;
 	set->ktype = ktype;
@@ -2772,6 +2869,8 @@ static int nf_tables_newset(struct sock *nlsk, struct sk_buff *skb,
 	set->flags = flags;
 	set->size  = desc.size;
 	set->policy = policy;
+	memcpy(set->field_len, desc.field_len, sizeof(set->field_len));
+	set->field_count = desc.field_count;
 	set->timeout = timeout;
 	set->gc_int = gc_int;
 
@@ -2905,6 +3004,9 @@ const struct nft_set_ext_type nft_set_ext_types[] = {
 	[NFT_SET_EXT_KEY]		= {
 		.align	= __alignof__(u32),
 	},
+	[NFT_SET_EXT_KEY_END]		= {
+		.align	= __alignof__(u32),
+	},
 	[NFT_SET_EXT_DATA]		= {
 		.align	= __alignof__(u32),
 	},
@@ -2941,6 +3043,7 @@ static const struct nla_policy nft_set_elem_policy[NFTA_SET_ELEM_MAX + 1] = {
 	[NFTA_SET_ELEM_TIMEOUT]		= { .type = NLA_U64 },
 	[NFTA_SET_ELEM_USERDATA]	= { .type = NLA_BINARY,
 					    .len = NFT_USERDATA_MAXLEN },
+	[NFTA_SET_ELEM_KEY_END]		= { .type = NLA_NESTED },
 };
 
 static const struct nla_policy nft_set_elem_list_policy[NFTA_SET_ELEM_LIST_MAX + 1] = {
@@ -2991,6 +3094,11 @@ static int nf_tables_fill_setelem(struct sk_buff *skb,
 			  NFT_DATA_VALUE, set->klen) < 0)
 		goto nla_put_failure;
 
+	if (nft_set_ext_exists(ext, NFT_SET_EXT_KEY_END) &&
+	    nft_data_dump(skb, NFTA_SET_ELEM_KEY_END, nft_set_ext_key_end(ext),
+			  NFT_DATA_VALUE, set->klen) < 0)
+		goto nla_put_failure;
+
 	if (nft_set_ext_exists(ext, NFT_SET_EXT_DATA) &&
 	    nft_data_dump(skb, NFTA_SET_ELEM_DATA, nft_set_ext_data(ext),
 			  set->dtype == NFT_DATA_VERDICT ? NFT_DATA_VERDICT : NFT_DATA_VALUE,
@@ -3255,8 +3363,8 @@ static struct nft_trans *nft_trans_elem_alloc(struct nft_ctx *ctx,
 
 void *nft_set_elem_init(const struct nft_set *set,
 			const struct nft_set_ext_tmpl *tmpl,
-			const u32 *key, const u32 *data,
-			u64 timeout, gfp_t gfp)
+			const u32 *key, const u32 *key_end,
+			const u32 *data, u64 timeout, gfp_t gfp)
 {
 	struct nft_set_ext *ext;
 	void *elem;
@@ -3269,6 +3377,8 @@ void *nft_set_elem_init(const struct nft_set *set,
 	nft_set_ext_init(ext, tmpl);
 
 	memcpy(nft_set_ext_key(ext), key, set->klen);
+	if (nft_set_ext_exists(ext, NFT_SET_EXT_KEY_END))
+		memcpy(nft_set_ext_key_end(ext), key_end, set->klen);
 	if (nft_set_ext_exists(ext, NFT_SET_EXT_DATA))
 		memcpy(nft_set_ext_data(ext), data, set->dlen);
 	if (nft_set_ext_exists(ext, NFT_SET_EXT_EXPIRATION))
@@ -3285,6 +3395,8 @@ void nft_set_elem_destroy(const struct nft_set *set, void *elem)
 	struct nft_set_ext *ext = nft_set_elem_ext(set, elem);
 
 	nft_data_uninit(nft_set_ext_key(ext), NFT_DATA_VALUE);
+	if (nft_set_ext_exists(ext, NFT_SET_EXT_KEY_END))
+		nft_data_uninit(nft_set_ext_key_end(ext), NFT_DATA_VALUE);
 	if (nft_set_ext_exists(ext, NFT_SET_EXT_DATA))
 		nft_data_uninit(nft_set_ext_data(ext), set->dtype);
 	if (nft_set_ext_exists(ext, NFT_SET_EXT_EXPR))
@@ -3298,7 +3410,7 @@ static int nft_add_set_elem(struct nft_ctx *ctx, struct nft_set *set,
 			    const struct nlattr *attr)
 {
 	struct nlattr *nla[NFTA_SET_ELEM_MAX + 1];
-	struct nft_data_desc d1, d2;
+	struct nft_data_desc d1, d2, d3;
 	struct nft_set_ext_tmpl tmpl;
 	struct nft_set_ext *ext;
 	struct nft_set_elem elem;
@@ -3319,6 +3431,9 @@ static int nft_add_set_elem(struct nft_ctx *ctx, struct nft_set *set,
 
 	if (nla[NFTA_SET_ELEM_KEY] == NULL)
 		return -EINVAL;
+	if (nla[NFTA_SET_ELEM_KEY_END] != NULL &&
+	    !(set->flags & NFT_SET_INTERVAL))
+		return -EINVAL;
 
 	nft_set_ext_prepare(&tmpl);
 
@@ -3364,6 +3479,22 @@ static int nft_add_set_elem(struct nft_ctx *ctx, struct nft_set *set,
 		goto err2;
 
 	nft_set_ext_add_length(&tmpl, NFT_SET_EXT_KEY, d1.len);
+
+	if (nla[NFTA_SET_ELEM_KEY_END] != NULL) {
+		err = nft_data_init(ctx, &elem.key_end.val,
+				    sizeof(elem.key_end), &d3,
+				    nla[NFTA_SET_ELEM_KEY_END]);
+		if (err < 0)
+			goto err2;
+		err = -EINVAL;
+		if (d3.type != NFT_DATA_VALUE || d3.len != set->klen) {
+			nft_data_uninit(&elem.key_end.val, d3.type);
+			goto err2;
+		}
+
+		nft_set_ext_add_length(&tmpl, NFT_SET_EXT_KEY_END, d3.len);
+	}
+
 	if (timeout > 0) {
 		nft_set_ext_add(&tmpl, NFT_SET_EXT_EXPIRATION);
 		if (timeout != set->timeout)
@@ -3374,7 +3505,7 @@ static int nft_add_set_elem(struct nft_ctx *ctx, struct nft_set *set,
 		err = nft_data_init(ctx, &data, sizeof(data), &d2,
 				    nla[NFTA_SET_ELEM_DATA]);
 		if (err < 0)
-			goto err2;
+			goto err_key_end;
 
 		err = -EINVAL;
 		if (set->dtype != NFT_DATA_VERDICT && d2.len != set->dlen)
@@ -3414,7 +3545,8 @@ static int nft_add_set_elem(struct nft_ctx *ctx, struct nft_set *set,
 	}
 
 	err = -ENOMEM;
-	elem.priv = nft_set_elem_init(set, &tmpl, elem.key.val.data, data.data,
+	elem.priv = nft_set_elem_init(set, &tmpl, elem.key.val.data,
+				      elem.key_end.val.data, data.data,
 				      timeout, GFP_KERNEL);
 	if (elem.priv == NULL)
 		goto err3;
@@ -3448,6 +3580,9 @@ err4:
 err3:
 	if (nla[NFTA_SET_ELEM_DATA] != NULL)
 		nft_data_uninit(&data, d2.type);
+err_key_end:
+	if (nla[NFTA_SET_ELEM_KEY_END] != NULL)
+		nft_data_uninit(&elem.key_end.val, d3.type);
 err2:
 	nft_data_uninit(&elem.key.val, d1.type);
 err1:
@@ -3502,7 +3637,7 @@ static int nft_del_setelem(struct nft_ctx *ctx, struct nft_set *set,
 			   const struct nlattr *attr)
 {
 	struct nlattr *nla[NFTA_SET_ELEM_MAX + 1];
-	struct nft_data_desc desc;
+	struct nft_data_desc desc, desc_end;
 	struct nft_set_elem elem;
 	struct nft_trans *trans;
 	int err;
@@ -3525,6 +3660,25 @@ static int nft_del_setelem(struct nft_ctx *ctx, struct nft_set *set,
 	if (desc.type != NFT_DATA_VALUE || desc.len != set->klen)
 		goto err2;
 
+	/* Ranges of concatenations are identified by both of their ends,
+	 * the key alone identifies single values.
+	 */
+	memcpy(&elem.key_end, &elem.key, sizeof(elem.key));
+	if (nla[NFTA_SET_ELEM_KEY_END] != NULL) {
+		err = nft_data_init(ctx, &elem.key_end.val,
+				    sizeof(elem.key_end), &desc_end,
+				    nla[NFTA_SET_ELEM_KEY_END]);
+		if (err < 0)
+			goto err2;
+
+		err = -EINVAL;
+		if (desc_end.type != NFT_DATA_VALUE ||
+		    desc_end.len != set->klen) {
+			nft_data_uninit(&elem.key_end.val, desc_end.type);
+			goto err2;
+		}
+	}
+
 	trans = nft_trans_elem_alloc(ctx, NFT_MSG_DELSETELEM, set);
 	if (trans == NULL) {
 		err = -ENOMEM;
@@ -3813,11 +3967,33 @@ static void nf_tables_commit_release(struct nft_trans *trans)
 	kfree(trans);
 }
 
+/* Sets that batch up element changes, see nft_set_ops->commit */
+static void nft_set_pending_update(struct nft_set *set,
+				   struct list_head *set_update_list)
+{
+	if (set->ops->commit && list_empty(&set->pending_update))
+		list_add_tail(&set->pending_update, set_update_list);
+}
+
+static void nft_set_commit_update(struct list_head *set_update_list)
+{
+	struct nft_set *set, *next;
+
+	list_for_each_entry_safe(set, next, set_update_list, pending_update) {
+		list_del_init(&set->pending_update);
+		set->ops->commit(set);
+	}
+}
+
 static int nf_tables_commit(struct sk_buff *skb)
 {
 	struct net *net = sock_net(skb->sk);
 	struct nft_trans *trans, *next;
 	struct nft_trans_elem *te;
+	LIST_HEAD(set_update_list);
+
+	/* Compile the chains for the generation that is about to start */
+	nft_jit_commit(net);
 
 	/* Bump generation counter, invalidate any dump in progress */
 	while (++net->nft.base_seq == 0);
@@ -3900,6 +4076,7 @@ static int nf_tables_commit(struct sk_buff *skb)
 			nf_tables_setelem_notify(&trans->ctx, te->set,
 						 &te->elem,
 						 NFT_MSG_NEWSETELEM, 0);
+			nft_set_pending_update(te->set, &set_update_list);
 			nft_trans_destroy(trans);
 			break;
 		case NFT_MSG_DELSETELEM:
@@ -3909,12 +4086,15 @@ static int nf_tables_commit(struct sk_buff *skb)
 						 &te->elem,
 						 NFT_MSG_DELSETELEM, 0);
 			te->set->ops->remove(te->set, &te->elem);
+			nft_set_pending_update(te->set, &set_update_list);
 			atomic_dec(&te->set->nelems);
 			te->set->ndeact--;
 			break;
 		}
 	}
 
+	nft_set_commit_update(&set_update_list);
+
 	synchronize_rcu();
 
 	list_for_each_entry_safe(trans, next, &net->nft.commit_list, list) {
@@ -3955,6 +4135,7 @@ static int nf_tables_abort(struct sk_buff *skb)
 	struct net *net = sock_net(skb->sk);
 	struct nft_trans *trans, *next;
 	struct nft_trans_elem *te;
+	LIST_HEAD(set_update_list);
 
 	list_for_each_entry_safe(trans, next, &net->nft.commit_list, list) {
 		switch (trans->msg_type) {
@@ -4017,12 +4198,14 @@ static int nf_tables_abort(struct sk_buff *skb)
 			te = (struct nft_trans_elem *)trans->data;
 
 			te->set->ops->remove(te->set, &te->elem);
+			nft_set_pending_update(te->set, &set_update_list);
 			atomic_dec(&te->set->nelems);
 			break;
 		case NFT_MSG_DELSETELEM:
 			te = (struct nft_trans_elem *)trans->data;
 
 			te->set->ops->activate(te->set, &te->elem);
+			nft_set_pending_update(te->set, &set_update_list);
 			te->set->ndeact--;
 
 			nft_trans_destroy(trans);
@@ -4030,6 +4213,8 @@ static int nf_tables_abort(struct sk_buff *skb)
 		}
 	}
 
+	nft_set_commit_update(&set_update_list);
+
 	synchronize_rcu();
 
 	list_for_each_entry_safe_reverse(trans, next,
@@ -14,6 +14,7 @@
 #include <linux/list.h>
 #include <linux/rculist.h>
 #include <linux/skbuff.h>
+#include <linux/filter.h>
 #include <linux/netlink.h>
 #include <linux/netfilter.h>
 #include <linux/netfilter/nfnetlink.h>
@@ -104,6 +105,47 @@ static bool nft_payload_fast_eval(const struct nft_expr *expr,
 	return true;
 }
 
+#ifdef CONFIG_NF_TABLES_JIT
+/* Run the compiled version of the chain, if there is one for the current
+ * generation.  Traced packets always take the interpreter so that every
+ * rule can be reported.
+ */
+static bool nft_jit_run(const struct nft_chain *chain, const struct net *net,
+			const struct nft_pktinfo *pkt, struct nft_regs *regs,
+			const struct nft_rule **rule, int *rulenum)
+{
+	const struct sk_buff *skb = pkt->skb;
+	struct nft_jit_ctx ctx;
+	struct bpf_prog *prog;
+
+	prog = rcu_dereference(chain->jit[ACCESS_ONCE(net->nft.gencursor)]);
+	if (!prog || unlikely(skb->nf_trace))
+		return false;
+
+	ctx.regs = regs;
+	ctx.pkt	 = pkt;
+	ctx.nh	 = skb_network_header(skb);
+	ctx.th	 = ctx.nh + pkt->xt.thoff;
+	ctx.tail = skb_tail_pointer(skb);
+	ctx.rule = *rule;
+
+	regs->verdict.code = NFT_CONTINUE;
+	regs->verdict.code = BPF_PROG_RUN(prog, (void *)&ctx);
+	*rule = ctx.rule;
+	*rulenum = ctx.rulenum;
+	return true;
+}
+#else
+static inline bool nft_jit_run(const struct nft_chain *chain,
+			       const struct net *net,
+			       const struct nft_pktinfo *pkt,
+			       struct nft_regs *regs,
+			       const struct nft_rule **rule, int *rulenum)
+{
+	return false;
+}
+#endif
+
 struct nft_jumpstack {
 	const struct nft_chain	*chain;
 	const struct nft_rule	*rule;
@@ -127,6 +169,8 @@ nft_do_chain(struct nft_pktinfo *pkt, const struct nf_hook_ops *ops)
 do_chain:
 	rulenum = 0;
 	rule = list_entry(&chain->rules, struct nft_rule, list);
+	if (nft_jit_run(chain, net, pkt, &regs, &rule, &rulenum))
+		goto verdict;
 next_rule:
 	regs.verdict.code = NFT_CONTINUE;
 	list_for_each_entry_continue_rcu(rule, &chain->rules, list) {
@@ -159,6 +203,7 @@ next_rule:
 		break;
 	}
 
+verdict:
 	switch (regs.verdict.code & NF_VERDICT_MASK) {
 	case NF_ACCEPT:
 	case NF_DROP:
@@ -0,0 +1,402 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Translation of nf_tables chains into eBPF programs.
+ *
+ * Each chain is compiled, at commit time, into one program that evaluates
+ * the rules active in the new generation in sequence.  Registers stay in
+ * struct nft_regs, so compiled and interpreted expressions can be mixed
+ * freely:
+ *
+ *  - payload (fast variant), cmp (fast variant) and verdict immediates are
+ *    emitted inline;
+ *  - everything else becomes a call to nft_jit_eval(), which runs the
+ *    expression's ->eval() callback just like nft_do_chain() does.
+ *
+ * Rules are laid out one after another:
+ *
+ *	body:	expressions, jumping to "next" on NFT_BREAK and to "exit"
+ *		on any other verdict than NFT_CONTINUE
+ *		ja next
+ *	exit:	store rule and rule number in the context, return the
+ *		verdict code
+ *	next:	...
+ *
+ * so all branches are local to a rule.  The program returns NFT_CONTINUE
+ * when it falls off the end of the chain.  Jumps to other chains are left
+ * to nft_do_chain(), which interprets the remainder of the calling chain
+ * when it returns.
+ *
+ * Two programs are kept per chain, one per generation, the packet path
+ * picks the one matching the current generation cursor.
+ */
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/rcupdate.h>
+#include <linux/filter.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <net/netfilter/nf_tables_core.h>
+#include <net/netfilter/nf_tables.h>
+
+#define NFT_JIT_REG_CTX		BPF_REG_6
+#define NFT_JIT_REG_REGS	BPF_REG_7
+
+/* Number of instructions in the exit block of a rule */
+#define NFT_JIT_EXIT_LEN	6
+
+/* Values returned by nft_jit_eval() */
+enum nft_jit_eval_ret {
+	NFT_JIT_EVAL_CONTINUE,
+	NFT_JIT_EVAL_BREAK,
+	NFT_JIT_EVAL_VERDICT,
+};
+
+struct nft_jit_state {
+	struct bpf_insn		*insn;	/* NULL while sizing the program */
+	unsigned int		len;
+	bool			err;
+};
+
+#define NFT_JIT_REG_OFF(reg)	\
+	(offsetof(struct nft_regs, data) + (reg) * NFT_REG32_SIZE)
+#define NFT_JIT_CODE_OFF	offsetof(struct nft_regs, verdict.code)
+#define NFT_JIT_CHAIN_OFF	offsetof(struct nft_regs, verdict.chain)
+
+static u64 nft_jit_eval(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	struct nft_jit_ctx *ctx = (struct nft_jit_ctx *)(unsigned long)r1;
+	const struct nft_expr *expr;
+	struct nft_regs *regs = ctx->regs;
+
+	expr = (const struct nft_expr *)(unsigned long)r2;
+
+	expr->ops->eval(expr, regs, ctx->pkt);
+
+	switch (regs->verdict.code) {
+	case NFT_CONTINUE:
+		return NFT_JIT_EVAL_CONTINUE;
+	case NFT_BREAK:
+		regs->verdict.code = NFT_CONTINUE;
+		return NFT_JIT_EVAL_BREAK;
+	}
+	return NFT_JIT_EVAL_VERDICT;
+}
+
+static void nft_jit_emit(struct nft_jit_state *st, struct bpf_insn insn)
+{
+	if (st->insn)
+		st->insn[st->len] = insn;
+	st->len++;
+}
+
+static void nft_jit_emit_imm64(struct nft_jit_state *st, int reg,
+			       const void *ptr)
+{
+	struct bpf_insn insn[] = {
+		BPF_LD_IMM64(reg, (unsigned long)ptr),
+	};
+
+	nft_jit_emit(st, insn[0]);
+	nft_jit_emit(st, insn[1]);
+}
+
+/* Emit a jump to the absolute instruction index @target. */
+static void nft_jit_emit_jmp(struct nft_jit_state *st, struct bpf_insn insn,
+			     unsigned int target)
+{
+	int off = target - (st->len + 1);
+
+	if (off < 0 || off > S16_MAX)
+		st->err = true;
+
+	insn.off = off;
+	nft_jit_emit(st, insn);
+}
+
+static void nft_jit_emit_eval(struct nft_jit_state *st,
+			      const struct nft_expr *expr,
+			      unsigned int next, unsigned int exit)
+{
+	nft_jit_emit(st, BPF_MOV64_REG(BPF_REG_1, NFT_JIT_REG_CTX));
+	nft_jit_emit_imm64(st, BPF_REG_2, expr);
+	nft_jit_emit(st, BPF_EMIT_CALL(nft_jit_eval));
+	nft_jit_emit(st, BPF_JMP_IMM(BPF_JEQ, BPF_REG_0,
+				     NFT_JIT_EVAL_CONTINUE, 2));
+	nft_jit_emit_jmp(st, BPF_JMP_IMM(BPF_JEQ, BPF_REG_0,
+					 NFT_JIT_EVAL_BREAK, 0), next);
+	nft_jit_emit_jmp(st, BPF_JMP_IMM(BPF_JA, 0, 0, 0), exit);
+}
+
+static void nft_jit_emit_cmp_fast(struct nft_jit_state *st,
+				  const struct nft_expr *expr,
+				  unsigned int next)
+{
+	const struct nft_cmp_fast_expr *priv = nft_expr_priv(expr);
+	u32 mask = nft_cmp_fast_mask(priv->len);
+
+	nft_jit_emit(st, BPF_LDX_MEM(BPF_W, BPF_REG_0, NFT_JIT_REG_REGS,
+				     NFT_JIT_REG_OFF(priv->sreg)));
+	nft_jit_emit(st, BPF_ALU32_IMM(BPF_AND, BPF_REG_0, mask));
+	nft_jit_emit(st, BPF_MOV32_IMM(BPF_REG_1, priv->data));
+	nft_jit_emit_jmp(st, BPF_JMP_REG(BPF_JNE, BPF_REG_0, BPF_REG_1, 0),
+			 next);
+}
+
+static void nft_jit_emit_payload_fast(struct nft_jit_state *st,
+				      const struct nft_expr *expr,
+				      unsigned int next, unsigned int exit)
+{
+	const struct nft_payload *priv = nft_expr_priv(expr);
+	struct nft_jit_state probe = { .len = 0 };
+	unsigned int base, slow, done;
+	int size;
+
+	switch (priv->len) {
+	case 1:
+		size = BPF_B;
+		break;
+	case 2:
+		size = BPF_H;
+		break;
+	default:
+		size = BPF_W;
+		break;
+	}
+
+	if (priv->base == NFT_PAYLOAD_NETWORK_HEADER)
+		base = offsetof(struct nft_jit_ctx, nh);
+	else
+		base = offsetof(struct nft_jit_ctx, th);
+
+	nft_jit_emit_eval(&probe, expr, 0, 0);
+	slow = st->len + 10;
+	done = slow + probe.len;
+
+	/* Same bounds check as nft_payload_fast_eval(), the slow path deals
+	 * with anything beyond the linear area.
+	 */
+	nft_jit_emit(st, BPF_LDX_MEM(BPF_DW, BPF_REG_2, NFT_JIT_REG_CTX, base));
+	nft_jit_emit(st, BPF_ALU64_IMM(BPF_ADD, BPF_REG_2, priv->offset));
+	nft_jit_emit(st, BPF_MOV64_REG(BPF_REG_3, BPF_REG_2));
+	nft_jit_emit(st, BPF_ALU64_IMM(BPF_ADD, BPF_REG_3, priv->len));
+	nft_jit_emit(st, BPF_LDX_MEM(BPF_DW, BPF_REG_4, NFT_JIT_REG_CTX,
+				     offsetof(struct nft_jit_ctx, tail)));
+	nft_jit_emit_jmp(st, BPF_JMP_REG(BPF_JGE, BPF_REG_3, BPF_REG_4, 0),
+			 slow);
+	nft_jit_emit(st, BPF_ST_MEM(BPF_W, NFT_JIT_REG_REGS,
+				    NFT_JIT_REG_OFF(priv->dreg), 0));
+	nft_jit_emit(st, BPF_LDX_MEM(size, BPF_REG_0, BPF_REG_2, 0));
+	nft_jit_emit(st, BPF_STX_MEM(size, NFT_JIT_REG_REGS, BPF_REG_0,
+				     NFT_JIT_REG_OFF(priv->dreg)));
+	nft_jit_emit_jmp(st, BPF_JMP_IMM(BPF_JA, 0, 0, 0), done);
+	nft_jit_emit_eval(st, expr, next, exit);
+}
+
+static void nft_jit_emit_verdict(struct nft_jit_state *st,
+				 const struct nft_expr *expr,
+				 unsigned int next, unsigned int exit)
+{
+	const struct nft_immediate_expr *priv = nft_expr_priv(expr);
+	const struct nft_verdict *v = &priv->data.verdict;
+
+	switch (v->code) {
+	case NFT_CONTINUE:
+		return;
+	case NFT_BREAK:
+		nft_jit_emit_jmp(st, BPF_JMP_IMM(BPF_JA, 0, 0, 0), next);
+		return;
+	case NFT_JUMP:
+	case NFT_GOTO:
+		nft_jit_emit_imm64(st, BPF_REG_1, v->chain);
+		nft_jit_emit(st, BPF_STX_MEM(BPF_DW, NFT_JIT_REG_REGS,
+					     BPF_REG_1, NFT_JIT_CHAIN_OFF));
+		break;
+	}
+	nft_jit_emit(st, BPF_ST_MEM(BPF_W, NFT_JIT_REG_REGS,
+				    NFT_JIT_CODE_OFF, v->code));
+	nft_jit_emit_jmp(st, BPF_JMP_IMM(BPF_JA, 0, 0, 0), exit);
+}
+
+static void nft_jit_emit_body(struct nft_jit_state *st,
+			      const struct nft_rule *rule,
+			      unsigned int next, unsigned int exit)
+{
+	const struct nft_expr *expr, *last;
+
+	nft_rule_for_each_expr(expr, last, rule) {
+		if (expr->ops == &nft_cmp_fast_ops) {
+			nft_jit_emit_cmp_fast(st, expr, next);
+		} else if (expr->ops == &nft_payload_fast_ops) {
+			nft_jit_emit_payload_fast(st, expr, next, exit);
+		} else if (expr->ops == &nft_imm_ops &&
+			   ((const struct nft_immediate_expr *)
+			    nft_expr_priv(expr))->dreg == NFT_REG_VERDICT) {
+			nft_jit_emit_verdict(st, expr, next, exit);
+		} else {
+			nft_jit_emit_eval(st, expr, next, exit);
+		}
+	}
+}
+
+static void nft_jit_emit_rule(struct nft_jit_state *st,
+			      const struct nft_rule *rule, int rulenum)
+{
+	struct nft_jit_state probe = { .len = st->len };
+	unsigned int exit, next;
+
+	/* Size the body first to place the exit block right behind it */
+	nft_jit_emit_body(&probe, rule, st->len, st->len);
+	exit = probe.len + 1;
+	next = exit + NFT_JIT_EXIT_LEN;
+
+	nft_jit_emit_body(st, rule, next, exit);
+	nft_jit_emit_jmp(st, BPF_JMP_IMM(BPF_JA, 0, 0, 0), next);
+
+	nft_jit_emit_imm64(st, BPF_REG_1, rule);
+	nft_jit_emit(st, BPF_STX_MEM(BPF_DW, NFT_JIT_REG_CTX, BPF_REG_1,
+				     offsetof(struct nft_jit_ctx, rule)));
+	nft_jit_emit(st, BPF_ST_MEM(BPF_W, NFT_JIT_REG_CTX,
+				    offsetof(struct nft_jit_ctx, rulenum),
+				    rulenum));
+	nft_jit_emit(st, BPF_LDX_MEM(BPF_W, BPF_REG_0, NFT_JIT_REG_REGS,
+				     NFT_JIT_CODE_OFF));
+	nft_jit_emit(st, BPF_EXIT_INSN());
+}
+
+static void nft_jit_emit_chain(struct nft_jit_state *st,
+			       const struct nft_chain *chain, u8 genmask)
+{
+	const struct nft_rule *rule;
+	int rulenum = 0;
+
+	nft_jit_emit(st, BPF_MOV64_REG(NFT_JIT_REG_CTX, BPF_REG_1));
+	nft_jit_emit(st, BPF_LDX_MEM(BPF_DW, NFT_JIT_REG_REGS, NFT_JIT_REG_CTX,
+				     offsetof(struct nft_jit_ctx, regs)));
+
+	list_for_each_entry(rule, &chain->rules, list) {
+		if (rule->genmask & genmask)
+			continue;
+
+		nft_jit_emit_rule(st, rule, ++rulenum);
+	}
+
+	nft_jit_emit(st, BPF_ST_MEM(BPF_W, NFT_JIT_REG_CTX,
+				    offsetof(struct nft_jit_ctx, rulenum),
+				    rulenum));
+	nft_jit_emit(st, BPF_MOV32_IMM(BPF_REG_0, NFT_CONTINUE));
+	nft_jit_emit(st, BPF_EXIT_INSN());
+}
+
+/* Compile the rules of @chain that are active in @genmask.  Returns NULL
+ * if the chain is empty or could not be JITed, the interpreter handles
+ * those.
+ */
+static struct bpf_prog *nft_jit_build(const struct nft_chain *chain,
+				      u8 genmask)
+{
+	struct nft_jit_state st = {};
+	struct bpf_prog *fp;
+	long off;
+
+	if (list_empty(&chain->rules))
+		return NULL;
+
+	/* Calls are encoded relative to __bpf_call_base in 32 bits */
+	off = (unsigned long)nft_jit_eval - (unsigned long)__bpf_call_base;
+	if (off != (s32)off)
+		return NULL;
+
+	nft_jit_emit_chain(&st, chain, genmask);
+	if (st.err)
+		return NULL;
+
+	fp = bpf_prog_alloc(bpf_prog_size(st.len), __GFP_NOWARN);
+	if (fp == NULL)
+		return NULL;
+
+	fp->len = st.len;
+	st.insn = fp->insnsi;
+	st.len = 0;
+	nft_jit_emit_chain(&st, chain, genmask);
+
+	bpf_prog_select_runtime(fp);
+	/* The eBPF interpreter is no faster than nft_do_chain() */
+	if (!fp->jited) {
+		bpf_prog_free(fp);
+		return NULL;
+	}
+	return fp;
+}
+
+/* Rules changing state in this transaction toggle between the current
+ * and the next generation.
+ */
+static bool nft_jit_chain_changed(const struct nft_chain *chain,
+				  u8 genmask_cur, u8 genmask_next)
+{
+	const struct nft_rule *rule;
+
+	list_for_each_entry(rule, &chain->rules, list) {
+		if (!(rule->genmask & genmask_cur) !=
+		    !(rule->genmask & genmask_next))
+			return true;
+	}
+	return false;
+}
+
+static void nft_jit_chain_commit(struct net *net, struct nft_chain *chain)
+{
+	unsigned int cur = net->nft.gencursor, next = nft_gencursor_next(net);
+	struct bpf_prog *prog, *old;
+
+	prog = nfnl_dereference(chain->jit[cur], NFNL_SUBSYS_NFTABLES);
+	if (nft_jit_chain_changed(chain, nft_genmask_cur(net),
+				  nft_genmask_next(net)))
+		prog = nft_jit_build(chain, nft_genmask_next(net));
+
+	/* Packets only use the slot of the current generation, nothing
+	 * can still be running the one we replace: the last commit waited
+	 * for a grace period after bumping the generation.
+	 */
+	old = nfnl_dereference(chain->jit[next], NFNL_SUBSYS_NFTABLES);
+	rcu_assign_pointer(chain->jit[next], prog);
+
+	if (old && old != prog &&
+	    old != nfnl_dereference(chain->jit[cur], NFNL_SUBSYS_NFTABLES))
+		bpf_prog_free(old);
+}
+
+/* Called before the generation cursor is bumped. */
+void nft_jit_commit(struct net *net)
+{
+	struct nft_af_info *afi;
+	struct nft_table *table;
+	struct nft_chain *chain;
+
+	list_for_each_entry(afi, &net->nft.af_info, list) {
+		list_for_each_entry(table, &afi->tables, list) {
+			list_for_each_entry(chain, &table->chains, list)
+				nft_jit_chain_commit(net, chain);
+		}
+	}
+
+	/* New programs must be visible before the new generation is */
+	smp_wmb();
+}
+
+void nft_jit_chain_destroy(struct nft_chain *chain)
+{
+	struct bpf_prog *a, *b;
+
+	a = rcu_dereference_raw(chain->jit[0]);
+	b = rcu_dereference_raw(chain->jit[1]);
+
+	if (a)
+		bpf_prog_free(a);
+	if (b && b != a)
+		bpf_prog_free(b);
+}
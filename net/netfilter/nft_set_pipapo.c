@@ -0,0 +1,917 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Set type for concatenations of ranges, such as "address . port . address",
+ * where each field can be a single value, a prefix or an arbitrary range.
+ *
+ * Every field of the concatenation is split in groups of 4 bits.  For each
+ * group, a lookup table holds one bitmap per possible value of the group
+ * (16 "buckets"), and bit n of a bucket tells whether rule n of the field
+ * matches that value.  A range is first expanded into the smallest set of
+ * prefixes covering it, and every prefix becomes a rule: nibbles fully
+ * covered by the prefix set a single bucket, nibbles past the prefix length
+ * set all of them.
+ *
+ * A lookup ANDs together the buckets selected by each nibble of the field,
+ * leaving the rules matching the whole field.  A mapping table then turns
+ * each matching rule into the range of rules it is allowed to continue with
+ * in the next field, and the last field maps rules to elements.
+ *
+ * The AND of buckets is a plain loop over unsigned longs, and the bitmaps
+ * of each group are contiguous, which lets the compiler vectorise it.
+ *
+ * Lookups run locklessly on a published copy of the tables.  Insertions
+ * and removals modify a working copy, which is published by the commit
+ * operation once the transaction is complete.  Generation masks on the
+ * elements keep pending changes invisible until then.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/netlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <net/netfilter/nf_tables.h>
+
+#define NFT_PIPAPO_GROUP_BITS		4
+#define NFT_PIPAPO_BUCKETS		(1 << NFT_PIPAPO_GROUP_BITS)
+#define NFT_PIPAPO_GROUPS_PER_BYTE	(BITS_PER_BYTE / NFT_PIPAPO_GROUP_BITS)
+
+/**
+ * union nft_pipapo_map_bucket - mapping of a rule to the next field
+ * @to: first rule number (in the next field) this rule maps to
+ * @n: number of rules (in the next field) this rule maps to
+ * @e: element this rule maps to, last field only
+ */
+union nft_pipapo_map_bucket {
+	struct {
+		u32 to;
+		u32 n;
+	};
+	struct nft_pipapo_elem *e;
+};
+
+/**
+ * struct nft_pipapo_field - lookup, mapping tables and related data for a field
+ * @groups: number of 4-bit groups
+ * @rules: number of inserted rules
+ * @bsize: size of each bucket in lookup table, in longs
+ * @lt: lookup table: 'groups' rows of NFT_PIPAPO_BUCKETS buckets
+ * @mt: mapping table: one bucket per rule
+ */
+struct nft_pipapo_field {
+	unsigned int groups;
+	unsigned int rules;
+	unsigned int bsize;
+	unsigned long *lt;
+	union nft_pipapo_map_bucket *mt;
+};
+
+/**
+ * struct nft_pipapo_match - data used in lookups
+ * @field_count: number of fields in set
+ * @bsize_max: maximum lookup table bucket size of all fields, in longs
+ * @scratch: per-CPU maps of partial matching results, two per CPU
+ * @rcu: matching data is freed after a grace period once replaced
+ * @f: fields, with lookup and mapping tables
+ */
+struct nft_pipapo_match {
+	unsigned int field_count;
+	unsigned int bsize_max;
+	unsigned long * __percpu *scratch;
+	struct rcu_head rcu;
+	struct nft_pipapo_field f[0];
+};
+
+/**
+ * struct nft_pipapo - representation of a set
+ * @match: currently in-use matching data
+ * @clone: copy where pending insertions and deletions are kept
+ * @dirty: working copy has pending insertions or deletions
+ */
+struct nft_pipapo {
+	struct nft_pipapo_match __rcu *match;
+	struct nft_pipapo_match *clone;
+	bool dirty;
+};
+
+struct nft_pipapo_elem {
+	struct nft_set_ext ext;
+};
+
+#define nft_pipapo_for_each_field(field, index, match)		\
+	for ((field) = (match)->f, (index) = 0;			\
+	     (index) < (match)->field_count;			\
+	     (index)++, (field)++)
+
+/* Fields start on register boundaries, see nft_set_desc_concat() */
+static unsigned int pipapo_field_len(const struct nft_pipapo_field *f)
+{
+	return f->groups / NFT_PIPAPO_GROUPS_PER_BYTE;
+}
+
+static unsigned int pipapo_field_stride(const struct nft_pipapo_field *f)
+{
+	return round_up(pipapo_field_len(f), NFT_REG32_SIZE);
+}
+
+static unsigned long *pipapo_bucket(const struct nft_pipapo_field *f,
+				    unsigned int group, unsigned int bucket)
+{
+	return f->lt + (group * NFT_PIPAPO_BUCKETS + bucket) * f->bsize;
+}
+
+static void *pipapo_alloc(size_t size)
+{
+	void *p;
+
+	if (size <= (PAGE_SIZE << PAGE_ALLOC_COSTLY_ORDER)) {
+		p = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+		if (p)
+			return p;
+	}
+	return vzalloc(size);
+}
+
+/* AND the buckets selected by each group of 'data' into 'dst' */
+static void pipapo_and_field_buckets(const struct nft_pipapo_field *f,
+				     unsigned long *dst, const u8 *data)
+{
+	const unsigned long *lt;
+	unsigned int group, i;
+
+	for (group = 0; group < f->groups; group++) {
+		u8 v = data[group / NFT_PIPAPO_GROUPS_PER_BYTE];
+
+		v = group % NFT_PIPAPO_GROUPS_PER_BYTE ? v & 0xf : v >> 4;
+		lt = pipapo_bucket(f, group, v);
+
+		for (i = 0; i < f->bsize; i++)
+			dst[i] &= lt[i];
+	}
+}
+
+/**
+ * pipapo_find() - match data against the lookup tables
+ * @m: matching data
+ * @data: key data, as laid out in registers
+ * @genmask: element must be active in this generation
+ * @res_map: scratch map, at least m->bsize_max longs
+ * @fill_map: scratch map, at least m->bsize_max longs
+ *
+ * Return: matching element, or NULL.
+ */
+static struct nft_pipapo_elem *pipapo_find(const struct nft_pipapo_match *m,
+					   const u8 *data, u8 genmask,
+					   unsigned long *res_map,
+					   unsigned long *fill_map)
+{
+	const struct nft_pipapo_field *f;
+	unsigned long r;
+	unsigned int i;
+	bool matched;
+
+	if (!m->f[0].rules)
+		return NULL;
+
+	/* Every rule of the first field is a candidate */
+	memset(res_map, 0xff, m->f[0].bsize * sizeof(*res_map));
+
+	nft_pipapo_for_each_field(f, i, m) {
+		pipapo_and_field_buckets(f, res_map, data);
+
+		if (i == m->field_count - 1) {
+			for_each_set_bit(r, res_map, f->rules) {
+				struct nft_pipapo_elem *e = f->mt[r].e;
+
+				if (nft_set_elem_active(&e->ext, genmask))
+					return e;
+			}
+			return NULL;
+		}
+
+		/* Matching rules select the candidates in the next field */
+		memset(fill_map, 0, f[1].bsize * sizeof(*fill_map));
+		matched = false;
+		for_each_set_bit(r, res_map, f->rules) {
+			bitmap_set(fill_map, f->mt[r].to, f->mt[r].n);
+			matched = true;
+		}
+		if (!matched)
+			return NULL;
+
+		swap(res_map, fill_map);
+		data += pipapo_field_stride(f);
+	}
+
+	return NULL;
+}
+
+static bool nft_pipapo_lookup(const struct nft_set *set, const u32 *key,
+			      const struct nft_set_ext **ext)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	u8 genmask = nft_genmask_cur(read_pnet(&set->pnet));
+	const struct nft_pipapo_match *m;
+	const struct nft_pipapo_elem *e;
+	unsigned long *scratch;
+
+	/* The scratch maps are per-CPU, don't let softirqs reuse them */
+	local_bh_disable();
+	m = rcu_dereference(priv->match);
+	scratch = *this_cpu_ptr(m->scratch);
+
+	e = pipapo_find(m, (const u8 *)key, genmask, scratch,
+			scratch + m->bsize_max);
+	local_bh_enable();
+
+	if (e == NULL)
+		return false;
+
+	*ext = &e->ext;
+	return true;
+}
+
+/* Control plane lookup on the working copy */
+static struct nft_pipapo_elem *pipapo_get(const struct nft_pipapo_match *m,
+					  const u8 *data, u8 genmask)
+{
+	struct nft_pipapo_elem *e;
+	unsigned long *scratch;
+
+	if (!m->bsize_max)
+		return ERR_PTR(-ENOENT);
+
+	scratch = kcalloc(m->bsize_max * 2, sizeof(*scratch), GFP_KERNEL);
+	if (scratch == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	e = pipapo_find(m, data, genmask, scratch, scratch + m->bsize_max);
+	kfree(scratch);
+
+	return e ? e : ERR_PTR(-ENOENT);
+}
+
+static const u8 *pipapo_key_end(const struct nft_pipapo_elem *e)
+{
+	if (nft_set_ext_exists(&e->ext, NFT_SET_EXT_KEY_END))
+		return (const u8 *)nft_set_ext_key_end(&e->ext)->data;
+
+	return (const u8 *)nft_set_ext_key(&e->ext)->data;
+}
+
+/* Big-endian arbitrary length integer helpers, bit 0 is the rightmost one */
+static bool pipapo_test_bit(const u8 *v, unsigned int len, unsigned int bit)
+{
+	return v[len - 1 - bit / BITS_PER_BYTE] & BIT(bit % BITS_PER_BYTE);
+}
+
+static void pipapo_set_low_bits(u8 *v, unsigned int len, unsigned int bits)
+{
+	unsigned int bit;
+
+	for (bit = 0; bit < bits; bit++)
+		v[len - 1 - bit / BITS_PER_BYTE] |= BIT(bit % BITS_PER_BYTE);
+}
+
+static void pipapo_increment(u8 *v, unsigned int len)
+{
+	while (len--) {
+		if (++v[len])
+			break;
+	}
+}
+
+/* Set the bits of 'rule' for the prefix 'base/plen' in all groups */
+static void pipapo_insert_prefix(struct nft_pipapo_field *f, unsigned int rule,
+				 const u8 *base, unsigned int plen)
+{
+	unsigned int group, bucket;
+
+	for (group = 0; group < f->groups; group++) {
+		u8 v = base[group / NFT_PIPAPO_GROUPS_PER_BYTE];
+		int fixed;
+		u8 mask;
+
+		v = group % NFT_PIPAPO_GROUPS_PER_BYTE ? v & 0xf : v >> 4;
+		fixed = clamp_t(int, plen - group * NFT_PIPAPO_GROUP_BITS,
+				0, NFT_PIPAPO_GROUP_BITS);
+		mask = (0xf << (NFT_PIPAPO_GROUP_BITS - fixed)) & 0xf;
+
+		for (bucket = 0; bucket < NFT_PIPAPO_BUCKETS; bucket++) {
+			if ((bucket & mask) == (v & mask))
+				__set_bit(rule, pipapo_bucket(f, group, bucket));
+		}
+	}
+}
+
+/**
+ * pipapo_expand() - expand a range into prefixes
+ * @f: field to insert rules into, NULL to count them only
+ * @start: start of range
+ * @end: end of range, inclusive
+ * @len: length of the field, bytes
+ * @rule: number of the first rule to insert
+ *
+ * Return: number of prefixes, hence rules, needed to represent the range.
+ */
+static unsigned int pipapo_expand(struct nft_pipapo_field *f,
+				  const u8 *start, const u8 *end,
+				  unsigned int len, unsigned int rule)
+{
+	u8 base[NFT_DATA_VALUE_MAXLEN], tmp[NFT_DATA_VALUE_MAXLEN];
+	unsigned int bits = len * BITS_PER_BYTE, step, n = 0;
+
+	memcpy(base, start, len);
+	for (;;) {
+		/* Largest aligned block starting at base, not past end */
+		for (step = 0; step < bits; step++) {
+			if (pipapo_test_bit(base, len, step))
+				break;
+
+			memcpy(tmp, base, len);
+			pipapo_set_low_bits(tmp, len, step + 1);
+			if (memcmp(tmp, end, len) > 0)
+				break;
+		}
+
+		if (f)
+			pipapo_insert_prefix(f, rule + n, base, bits - step);
+		n++;
+
+		pipapo_set_low_bits(base, len, step);
+		if (!memcmp(base, end, len))
+			break;
+		pipapo_increment(base, len);
+	}
+
+	return n;
+}
+
+/**
+ * pipapo_resize() - resize tables of a field to fit a number of rules
+ * @f: field
+ * @rules: number of rules to make room for
+ *
+ * Only the allocation changes, f->rules is left untouched: growing the
+ * tables of one field and failing for the next one leaves a consistent,
+ * if oversized, field behind.
+ *
+ * Return: 0 on success, -ENOMEM on allocation failure.
+ */
+static int pipapo_resize(struct nft_pipapo_field *f, unsigned int rules)
+{
+	unsigned int new_bsize = BITS_TO_LONGS(rules), copy, group, bucket;
+	union nft_pipapo_map_bucket *new_mt = NULL;
+	unsigned long *new_lt = NULL;
+
+	if (new_bsize != f->bsize && new_bsize) {
+		new_lt = pipapo_alloc(f->groups * NFT_PIPAPO_BUCKETS *
+				      new_bsize * sizeof(*new_lt));
+		if (new_lt == NULL)
+			return -ENOMEM;
+
+		copy = min(f->bsize, new_bsize);
+		for (group = 0; group < f->groups; group++) {
+			for (bucket = 0; bucket < NFT_PIPAPO_BUCKETS; bucket++) {
+				memcpy(new_lt + (group * NFT_PIPAPO_BUCKETS +
+						 bucket) * new_bsize,
+				       pipapo_bucket(f, group, bucket),
+				       copy * sizeof(*new_lt));
+			}
+		}
+	}
+
+	if (rules) {
+		new_mt = pipapo_alloc(rules * sizeof(*new_mt));
+		if (new_mt == NULL) {
+			kvfree(new_lt);
+			return -ENOMEM;
+		}
+		memcpy(new_mt, f->mt, min(f->rules, rules) * sizeof(*new_mt));
+	}
+
+	kvfree(f->mt);
+	f->mt = new_mt;
+
+	if (new_bsize != f->bsize) {
+		kvfree(f->lt);
+		f->lt = new_lt;
+		f->bsize = new_bsize;
+	}
+
+	return 0;
+}
+
+static int pipapo_realloc_scratch(struct nft_pipapo_match *m,
+				  unsigned int bsize_max)
+{
+	unsigned long *scratch;
+	int i;
+
+	for_each_possible_cpu(i) {
+		scratch = kzalloc_node(bsize_max * 2 * sizeof(*scratch),
+				       GFP_KERNEL, cpu_to_node(i));
+		if (scratch == NULL)
+			return -ENOMEM;
+
+		kfree(*per_cpu_ptr(m->scratch, i));
+		*per_cpu_ptr(m->scratch, i) = scratch;
+	}
+
+	m->bsize_max = bsize_max;
+	return 0;
+}
+
+static void pipapo_free_match(struct nft_pipapo_match *m)
+{
+	struct nft_pipapo_field *f;
+	int i;
+
+	for_each_possible_cpu(i)
+		kfree(*per_cpu_ptr(m->scratch, i));
+	free_percpu(m->scratch);
+
+	nft_pipapo_for_each_field(f, i, m) {
+		kvfree(f->lt);
+		kvfree(f->mt);
+	}
+	kfree(m);
+}
+
+static void pipapo_reclaim_match(struct rcu_head *rcu)
+{
+	pipapo_free_match(container_of(rcu, struct nft_pipapo_match, rcu));
+}
+
+static struct nft_pipapo_match *pipapo_alloc_match(unsigned int field_count)
+{
+	struct nft_pipapo_match *m;
+
+	m = kzalloc(sizeof(*m) + field_count * sizeof(m->f[0]), GFP_KERNEL);
+	if (m == NULL)
+		return NULL;
+
+	m->scratch = alloc_percpu(unsigned long *);
+	if (m->scratch == NULL) {
+		kfree(m);
+		return NULL;
+	}
+
+	m->field_count = field_count;
+	return m;
+}
+
+static struct nft_pipapo_match *pipapo_clone(const struct nft_pipapo_match *old)
+{
+	const struct nft_pipapo_field *src = old->f;
+	struct nft_pipapo_field *dst;
+	struct nft_pipapo_match *new;
+	size_t lt_size;
+	int i;
+
+	new = pipapo_alloc_match(old->field_count);
+	if (new == NULL)
+		return NULL;
+
+	if (old->bsize_max && pipapo_realloc_scratch(new, old->bsize_max))
+		goto err;
+
+	nft_pipapo_for_each_field(dst, i, new) {
+		dst->groups = src->groups;
+		dst->bsize = src->bsize;
+		dst->rules = src->rules;
+
+		lt_size = src->groups * NFT_PIPAPO_BUCKETS * src->bsize *
+			  sizeof(*src->lt);
+		if (lt_size) {
+			dst->lt = pipapo_alloc(lt_size);
+			if (dst->lt == NULL)
+				goto err;
+			memcpy(dst->lt, src->lt, lt_size);
+		}
+
+		if (src->rules) {
+			dst->mt = pipapo_alloc(src->rules * sizeof(*src->mt));
+			if (dst->mt == NULL)
+				goto err;
+			memcpy(dst->mt, src->mt,
+			       src->rules * sizeof(*src->mt));
+		}
+
+		src++;
+	}
+
+	return new;
+
+err:
+	pipapo_free_match(new);
+	return NULL;
+}
+
+static int nft_pipapo_insert(const struct nft_set *set,
+			     const struct nft_set_elem *elem)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	struct nft_pipapo_match *m = priv->clone;
+	struct nft_pipapo_elem *e = elem->priv, *dup;
+	u8 genmask = nft_genmask_next(read_pnet(&set->pnet));
+	unsigned int n[NFT_REG32_COUNT], bsize_max;
+	const u8 *start, *end, *start_p, *end_p;
+	struct nft_pipapo_field *f;
+	int i, err;
+
+	if (nft_set_ext_exists(&e->ext, NFT_SET_EXT_FLAGS) &&
+	    *nft_set_ext_flags(&e->ext) & NFT_SET_ELEM_INTERVAL_END)
+		return -EOPNOTSUPP;
+
+	start = (const u8 *)nft_set_ext_key(&e->ext)->data;
+	end = pipapo_key_end(e);
+
+	dup = pipapo_get(m, start, genmask);
+	if (!IS_ERR(dup)) {
+		if (!memcmp(start, nft_set_ext_key(&dup->ext)->data,
+			    set->klen) &&
+		    !memcmp(end, pipapo_key_end(dup), set->klen))
+			return -EEXIST;
+		return -ENOTEMPTY;
+	}
+	if (PTR_ERR(dup) == -ENOENT)
+		dup = pipapo_get(m, end, genmask);
+	if (PTR_ERR(dup) != -ENOENT)
+		return IS_ERR(dup) ? PTR_ERR(dup) : -ENOTEMPTY;
+
+	start_p = start;
+	end_p = end;
+	nft_pipapo_for_each_field(f, i, m) {
+		if (memcmp(start_p, end_p, pipapo_field_len(f)) > 0)
+			return -EINVAL;
+
+		start_p += pipapo_field_stride(f);
+		end_p += pipapo_field_stride(f);
+	}
+
+	bsize_max = m->bsize_max;
+	start_p = start;
+	end_p = end;
+	nft_pipapo_for_each_field(f, i, m) {
+		n[i] = pipapo_expand(NULL, start_p, end_p,
+				     pipapo_field_len(f), 0);
+		bsize_max = max_t(unsigned int, bsize_max,
+				  BITS_TO_LONGS(f->rules + n[i]));
+
+		start_p += pipapo_field_stride(f);
+		end_p += pipapo_field_stride(f);
+	}
+
+	/* Make room for the new rules first, so that they can't fail
+	 * half-way through.  Scratch maps always fit the largest bucket.
+	 */
+	if (bsize_max > m->bsize_max) {
+		err = pipapo_realloc_scratch(m, bsize_max);
+		if (err < 0)
+			return err;
+	}
+
+	nft_pipapo_for_each_field(f, i, m) {
+		err = pipapo_resize(f, f->rules + n[i]);
+		if (err < 0)
+			return err;
+	}
+
+	priv->dirty = true;
+
+	start_p = start;
+	end_p = end;
+	nft_pipapo_for_each_field(f, i, m) {
+		unsigned int r;
+
+		pipapo_expand(f, start_p, end_p, pipapo_field_len(f), f->rules);
+
+		for (r = f->rules; r < f->rules + n[i]; r++) {
+			if (i == m->field_count - 1) {
+				f->mt[r].e = e;
+			} else {
+				f->mt[r].to = f[1].rules;
+				f->mt[r].n = n[i + 1];
+			}
+		}
+
+		start_p += pipapo_field_stride(f);
+		end_p += pipapo_field_stride(f);
+	}
+
+	nft_pipapo_for_each_field(f, i, m)
+		f->rules += n[i];
+
+	return 0;
+}
+
+/* Bit 'i' of 'map' becomes bit 'i + n', for every i >= start */
+static void pipapo_bitmap_cut(unsigned long *map, unsigned int start,
+			      unsigned int n, unsigned int nbits)
+{
+	unsigned int words = BITS_TO_LONGS(nbits), i, w, off;
+	unsigned long v;
+
+	for (i = start; i < nbits - n && i % BITS_PER_LONG; i++) {
+		if (test_bit(i + n, map))
+			__set_bit(i, map);
+		else
+			__clear_bit(i, map);
+	}
+
+	for (; i < nbits - n; i += BITS_PER_LONG) {
+		w = (i + n) / BITS_PER_LONG;
+		off = (i + n) % BITS_PER_LONG;
+
+		v = map[w] >> off;
+		if (off && w + 1 < words)
+			v |= map[w + 1] << (BITS_PER_LONG - off);
+		map[i / BITS_PER_LONG] = v;
+	}
+
+	bitmap_clear(map, nbits - n, n);
+}
+
+/* Drop rules [start, start + n) of a field, moving later rules down */
+static void pipapo_cut_rules(struct nft_pipapo_field *f, unsigned int start,
+			     unsigned int n)
+{
+	unsigned int group, bucket;
+
+	for (group = 0; group < f->groups; group++) {
+		for (bucket = 0; bucket < NFT_PIPAPO_BUCKETS; bucket++)
+			pipapo_bitmap_cut(pipapo_bucket(f, group, bucket),
+					  start, n, f->rules);
+	}
+
+	memmove(f->mt + start, f->mt + start + n,
+		(f->rules - start - n) * sizeof(*f->mt));
+}
+
+static void pipapo_drop(struct nft_pipapo_match *m,
+			const struct nft_pipapo_elem *e)
+{
+	unsigned int start[NFT_REG32_COUNT], n[NFT_REG32_COUNT], r;
+	struct nft_pipapo_field *f;
+	int i;
+
+	/* Rules of an element are contiguous in each field: the last field
+	 * maps them to the element, previous fields map them to the block
+	 * of rules in the next field.
+	 */
+	i = m->field_count - 1;
+	f = &m->f[i];
+	for (r = 0; r < f->rules && f->mt[r].e != e; r++)
+		;
+	if (WARN_ON_ONCE(r == f->rules))
+		return;
+	for (start[i] = r, n[i] = 0; r < f->rules && f->mt[r].e == e; r++)
+		n[i]++;
+
+	while (i--) {
+		f = &m->f[i];
+		for (r = 0; r < f->rules && f->mt[r].to != start[i + 1]; r++)
+			;
+		for (start[i] = r, n[i] = 0;
+		     r < f->rules && f->mt[r].to == start[i + 1]; r++)
+			n[i]++;
+	}
+
+	nft_pipapo_for_each_field(f, i, m) {
+		pipapo_cut_rules(f, start[i], n[i]);
+
+		if (i > 0) {
+			struct nft_pipapo_field *prev = f - 1;
+
+			for (r = 0; r < prev->rules; r++) {
+				if (prev->mt[r].to > start[i])
+					prev->mt[r].to -= n[i];
+			}
+		}
+
+		f->rules -= n[i];
+		/* Shrinking is best effort, larger tables still work */
+		pipapo_resize(f, f->rules);
+	}
+}
+
+static void nft_pipapo_remove(const struct nft_set *set,
+			      const struct nft_set_elem *elem)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+
+	pipapo_drop(priv->clone, elem->priv);
+	priv->dirty = true;
+}
+
+static void nft_pipapo_activate(const struct nft_set *set,
+				const struct nft_set_elem *elem)
+{
+	struct nft_pipapo_elem *e = elem->priv;
+
+	nft_set_elem_change_active(set, &e->ext);
+}
+
+static void *nft_pipapo_deactivate(const struct nft_set *set,
+				   const struct nft_set_elem *elem)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	u8 genmask = nft_genmask_next(read_pnet(&set->pnet));
+	struct nft_pipapo_elem *e;
+
+	e = pipapo_get(priv->clone, (const u8 *)elem->key.val.data, genmask);
+	if (IS_ERR(e))
+		return NULL;
+
+	/* Only exact ranges can be deleted, not values contained in them */
+	if (memcmp(nft_set_ext_key(&e->ext)->data, elem->key.val.data,
+		   set->klen) ||
+	    memcmp(pipapo_key_end(e), elem->key_end.val.data, set->klen))
+		return NULL;
+
+	nft_set_elem_change_active(set, &e->ext);
+	return e;
+}
+
+/* Publish the working copy, keep a new one for the next transaction */
+static void nft_pipapo_commit(const struct nft_set *set)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	struct nft_pipapo_match *new_clone, *old;
+
+	if (!priv->dirty)
+		return;
+
+	new_clone = pipapo_clone(priv->clone);
+	if (new_clone == NULL)
+		return;
+
+	priv->dirty = false;
+
+	old = rcu_dereference_protected(priv->match, 1);
+	rcu_assign_pointer(priv->match, priv->clone);
+	call_rcu(&old->rcu, pipapo_reclaim_match);
+
+	priv->clone = new_clone;
+}
+
+static void nft_pipapo_walk(const struct nft_ctx *ctx,
+			    const struct nft_set *set,
+			    struct nft_set_iter *iter)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	u8 genmask = nft_genmask_cur(read_pnet(&set->pnet));
+	const struct nft_pipapo_match *m;
+	const struct nft_pipapo_field *f;
+	struct nft_pipapo_elem *e;
+	struct nft_set_elem elem;
+	unsigned int r;
+
+	rcu_read_lock();
+	m = rcu_dereference(priv->match);
+	f = &m->f[m->field_count - 1];
+
+	for (r = 0; r < f->rules; r++) {
+		/* Report each element once, at its last rule */
+		if (r < f->rules - 1 && f->mt[r + 1].e == f->mt[r].e)
+			continue;
+
+		e = f->mt[r].e;
+
+		if (iter->count < iter->skip)
+			goto cont;
+		if (!nft_set_elem_active(&e->ext, genmask))
+			goto cont;
+
+		elem.priv = e;
+
+		iter->err = iter->fn(ctx, set, iter, &elem);
+		if (iter->err < 0)
+			goto out;
+cont:
+		iter->count++;
+	}
+out:
+	rcu_read_unlock();
+}
+
+static unsigned int nft_pipapo_privsize(const struct nlattr * const nla[])
+{
+	return sizeof(struct nft_pipapo);
+}
+
+static int nft_pipapo_init(const struct nft_set *set,
+			   const struct nft_set_desc *desc,
+			   const struct nlattr * const nla[])
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	unsigned int field_count = desc->field_count ? : 1;
+	struct nft_pipapo_match *m;
+	struct nft_pipapo_field *f;
+	int i;
+
+	m = pipapo_alloc_match(field_count);
+	if (m == NULL)
+		return -ENOMEM;
+
+	nft_pipapo_for_each_field(f, i, m) {
+		unsigned int len = desc->field_count ? desc->field_len[i] :
+						       desc->klen;
+
+		f->groups = len * NFT_PIPAPO_GROUPS_PER_BYTE;
+	}
+
+	priv->clone = pipapo_clone(m);
+	if (priv->clone == NULL) {
+		pipapo_free_match(m);
+		return -ENOMEM;
+	}
+
+	priv->dirty = false;
+	RCU_INIT_POINTER(priv->match, m);
+	return 0;
+}
+
+static void nft_pipapo_destroy(const struct nft_set *set)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	struct nft_pipapo_match *m = priv->clone;
+	const struct nft_pipapo_field *f = &m->f[m->field_count - 1];
+	unsigned int r;
+
+	/* The working copy holds all the elements, including pending ones */
+	for (r = 0; r < f->rules; r++) {
+		if (r < f->rules - 1 && f->mt[r + 1].e == f->mt[r].e)
+			continue;
+
+		nft_set_elem_destroy(set, f->mt[r].e);
+	}
+
+	pipapo_free_match(priv->clone);
+	pipapo_free_match(rcu_dereference_protected(priv->match, 1));
+}
+
+static bool nft_pipapo_estimate(const struct nft_set_desc *desc, u32 features,
+				struct nft_set_estimate *est)
+{
+	unsigned int entries = desc->size ? : 1, i;
+
+	if (!(features & NFT_SET_INTERVAL) || desc->field_count < 2)
+		return false;
+
+	est->size = sizeof(struct nft_pipapo) +
+		    entries * sizeof(struct nft_pipapo_elem);
+	for (i = 0; i < desc->field_count; i++) {
+		est->size += desc->field_len[i] * NFT_PIPAPO_GROUPS_PER_BYTE *
+			     NFT_PIPAPO_BUCKETS * BITS_TO_LONGS(entries) *
+			     sizeof(unsigned long);
+		est->size += entries * sizeof(union nft_pipapo_map_bucket);
+	}
+
+	est->class = NFT_SET_CLASS_O_LOG_N;
+
+	return true;
+}
+
+static struct nft_set_ops nft_pipapo_ops __read_mostly = {
+	.privsize	= nft_pipapo_privsize,
+	.elemsize	= offsetof(struct nft_pipapo_elem, ext),
+	.estimate	= nft_pipapo_estimate,
+	.init		= nft_pipapo_init,
+	.destroy	= nft_pipapo_destroy,
+	.insert		= nft_pipapo_insert,
+	.remove		= nft_pipapo_remove,
+	.commit		= nft_pipapo_commit,
+	.deactivate	= nft_pipapo_deactivate,
+	.activate	= nft_pipapo_activate,
+	.lookup		= nft_pipapo_lookup,
+	.walk		= nft_pipapo_walk,
+	.features	= NFT_SET_INTERVAL | NFT_SET_MAP,
+	.owner		= THIS_MODULE,
+};
+
+static int __init nft_pipapo_module_init(void)
+{
+	return nft_register_set(&nft_pipapo_ops);
+}
+
+static void __exit nft_pipapo_module_exit(void)
+{
+	nft_unregister_set(&nft_pipapo_ops);
+	/* Wait for outstanding pipapo_reclaim_match() callbacks */
+	rcu_barrier();
+}
+
+module_init(nft_pipapo_module_init);
+module_exit(nft_pipapo_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_ALIAS_NFT_SET();
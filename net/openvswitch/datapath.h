@@ -32,6 +32,7 @@
 
 #define DP_MAX_PORTS           USHRT_MAX
 #define DP_VPORT_HASH_BUCKETS  1024
+#define DP_MASKS_REBALANCE_INTERVAL  4000	/* msecs */
 
 #define SAMPLE_ACTION_DEPTH 3
 
@@ -49,12 +50,15 @@
  * @n_mask_hit: Number of masks looked up for flow match.
  *   @n_mask_hit / (@n_hit + @n_missed)  will be the average masks looked
  *   up per packet.
+ * @n_cache_hit: Number of flow lookups where the mask suggested by the
+ * per-cpu mask cache matched.
  */
 struct dp_stats_percpu {
 	u64 n_hit;
 	u64 n_missed;
 	u64 n_lost;
 	u64 n_mask_hit;
+	u64 n_cache_hit;
 	struct u64_stats_sync syncp;
 };
 
@@ -124,10 +128,13 @@ struct dp_upcall_info {
  * struct ovs_net - Per net-namespace data for ovs.
  * @dps: List of datapaths to enable dumping them all out.
  * Protected by genl_mutex.
+ * @masks_rebalance: Periodic reordering of the flow masks of all
+ * datapaths by usage.
  */
 struct ovs_net {
 	struct list_head dps;
 	struct work_struct dp_notify_work;
+	struct delayed_work masks_rebalance;
 	struct vport_net vport_net;
 };
 
@@ -307,6 +307,20 @@ static struct sk_buff *fq_dequeue_head(struct Qdisc *sch, struct fq_flow *flow)
 	return skb;
 }
 
+/* Earliest departure time of a packet, as set by SCM_TXTIME, or 0.
+ * Other users of skb->tstamp (receive timestamps of forwarded packets,
+ * TCP internal use) are not departure times, only trust sockets that
+ * asked for it.
+ */
+static u64 fq_skb_time_to_send(const struct sk_buff *skb)
+{
+	const struct sock *sk = skb->sk;
+
+	if (sk && sk_fullsock(sk) && sock_flag(sk, SOCK_TXTIME))
+		return ktime_to_ns(skb->tstamp);
+	return 0;
+}
+
 /* We might add in the future detection of retransmits
  * For the time being, just return false
  */
@@ -457,11 +471,17 @@ begin:
 	}
 
 	skb = f->head;
-	if (unlikely(skb && now < f->time_next_packet &&
-		     !skb_is_tcp_pure_ack(skb))) {
-		head->first = f->next;
-		fq_flow_set_throttled(q, f);
-		goto begin;
+	if (skb) {
+		u64 time_next_packet = max_t(u64, f->time_next_packet,
+					     fq_skb_time_to_send(skb));
+
+		if (unlikely(now < time_next_packet &&
+			     !skb_is_tcp_pure_ack(skb))) {
+			head->first = f->next;
+			f->time_next_packet = time_next_packet;
+			fq_flow_set_throttled(q, f);
+			goto begin;
+		}
 	}
 
 	skb = fq_dequeue_head(sch, f);
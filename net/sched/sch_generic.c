@@ -43,12 +43,18 @@ EXPORT_SYMBOL(default_qdisc_ops);
  * - enqueue, dequeue are serialized via qdisc root lock
  * - ingress filtering is also serialized via qdisc root lock
  * - updates to tree and tree walking are only done under the rtnl mutex.
+ *
+ * TCQ_F_NOLOCK qdiscs do their own locking in enqueue and dequeue, and the
+ * __QDISC_STATE_RUNNING bit serializes their dequeue side instead.
  */
 
 static inline int dev_requeue_skb(struct sk_buff *skb, struct Qdisc *q)
 {
 	q->gso_skb = skb;
-	q->qstats.requeues++;
+	if (qdisc_is_percpu_stats(q))
+		this_cpu_inc(q->cpu_qstats->requeues);
+	else
+		q->qstats.requeues++;
 	q->q.qlen++;	/* it's still part of the queue */
 	__netif_schedule(q);
 
@@ -145,6 +151,8 @@ static inline int handle_dev_cpu_collision(struct sk_buff *skb,
  * Returns to the caller:
  *				0  - queue is empty or throttled.
  *				>0 - queue is not empty.
+ *
+ * root_lock is NULL for TCQ_F_NOLOCK qdiscs.
  */
 int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 		    struct net_device *dev, struct netdev_queue *txq,
@@ -153,7 +161,8 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 	int ret = NETDEV_TX_BUSY;
 
 	/* And release qdisc */
-	spin_unlock(root_lock);
+	if (root_lock)
+		spin_unlock(root_lock);
 
 	/* Note that we validate skb (GSO, checksum, ...) outside of locks */
 	if (validate)
@@ -166,11 +175,15 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 
 		HARD_TX_UNLOCK(dev, txq);
 	}
-	spin_lock(root_lock);
+	if (root_lock)
+		spin_lock(root_lock);
 
 	if (dev_xmit_complete(ret)) {
-		/* Driver sent out skb successfully or skb was consumed */
-		ret = qdisc_qlen(q);
+		/* Driver sent out skb successfully or skb was consumed.
+		 * Summing up the percpu queue length of a lockless qdisc on
+		 * every packet is not worth it, the next dequeue tells.
+		 */
+		ret = root_lock ? qdisc_qlen(q) : 1;
 	} else if (ret == NETDEV_TX_LOCKED) {
 		/* Driver try lock failed */
 		ret = handle_dev_cpu_collision(skb, txq, q);
@@ -221,7 +234,7 @@ static inline int qdisc_restart(struct Qdisc *q, int *packets)
 	if (unlikely(!skb))
 		return 0;
 
-	root_lock = qdisc_lock(q);
+	root_lock = (q->flags & TCQ_F_NOLOCK) ? NULL : qdisc_lock(q);
 	dev = qdisc_dev(q);
 	txq = skb_get_tx_queue(dev, skb);
 
@@ -477,8 +490,84 @@ static inline struct sk_buff_head *band2list(struct pfifo_fast_priv *priv,
 	return priv->q + band;
 }
 
+/* Lockless mode: the bands are only protected by their own list lock,
+ * enqueue runs concurrently on all CPUs and dequeue on the CPU owning
+ * __QDISC_STATE_RUNNING.  The bitmap is not maintained, queue length and
+ * backlog live in the percpu statistics and the limit applies per band.
+ */
+static int pfifo_fast_enqueue_nolock(struct sk_buff *skb, struct Qdisc *qdisc)
+{
+	int band = prio2band[skb->priority & TC_PRIO_MAX];
+	struct pfifo_fast_priv *priv = qdisc_priv(qdisc);
+	struct sk_buff_head *list = band2list(priv, band);
+	unsigned int pkt_len = qdisc_pkt_len(skb);
+
+	spin_lock(&list->lock);
+	if (unlikely(skb_queue_len(list) >= qdisc_dev(qdisc)->tx_queue_len)) {
+		spin_unlock(&list->lock);
+		qdisc_qstats_drop_cpu(qdisc);
+		kfree_skb(skb);
+		return NET_XMIT_DROP;
+	}
+	__skb_queue_tail(list, skb);
+	spin_unlock(&list->lock);
+
+	this_cpu_inc(qdisc->cpu_qstats->qlen);
+	this_cpu_add(qdisc->cpu_qstats->backlog, pkt_len);
+	return NET_XMIT_SUCCESS;
+}
+
+static struct sk_buff *pfifo_fast_dequeue_nolock(struct Qdisc *qdisc)
+{
+	struct pfifo_fast_priv *priv = qdisc_priv(qdisc);
+	struct sk_buff *skb = NULL;
+	int band;
+
+	for (band = 0; band < PFIFO_FAST_BANDS && !skb; band++) {
+		struct sk_buff_head *list = band2list(priv, band);
+
+		if (skb_queue_empty(list))
+			continue;
+
+		spin_lock(&list->lock);
+		skb = __skb_dequeue(list);
+		spin_unlock(&list->lock);
+	}
+
+	if (skb) {
+		this_cpu_dec(qdisc->cpu_qstats->qlen);
+		this_cpu_sub(qdisc->cpu_qstats->backlog, qdisc_pkt_len(skb));
+		qdisc_bstats_update_cpu(qdisc, skb);
+	}
+
+	return skb;
+}
+
+static void pfifo_fast_reset_nolock(struct Qdisc *qdisc)
+{
+	struct pfifo_fast_priv *priv = qdisc_priv(qdisc);
+	struct sk_buff *skb;
+	int band;
+
+	for (band = 0; band < PFIFO_FAST_BANDS; band++) {
+		struct sk_buff_head *list = band2list(priv, band);
+
+		spin_lock(&list->lock);
+		while ((skb = __skb_dequeue(list)) != NULL) {
+			this_cpu_dec(qdisc->cpu_qstats->qlen);
+			this_cpu_sub(qdisc->cpu_qstats->backlog,
+				     qdisc_pkt_len(skb));
+			kfree_skb(skb);
+		}
+		spin_unlock(&list->lock);
+	}
+}
+
 static int pfifo_fast_enqueue(struct sk_buff *skb, struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK)
+		return pfifo_fast_enqueue_nolock(skb, qdisc);
+
 	if (skb_queue_len(&qdisc->q) < qdisc_dev(qdisc)->tx_queue_len) {
 		int band = prio2band[skb->priority & TC_PRIO_MAX];
 		struct pfifo_fast_priv *priv = qdisc_priv(qdisc);
@@ -497,6 +586,9 @@ static struct sk_buff *pfifo_fast_dequeue(struct Qdisc *qdisc)
 	struct pfifo_fast_priv *priv = qdisc_priv(qdisc);
 	int band = bitmap2band[priv->bitmap];
 
+	if (qdisc->flags & TCQ_F_NOLOCK)
+		return pfifo_fast_dequeue_nolock(qdisc);
+
 	if (likely(band >= 0)) {
 		struct sk_buff_head *list = band2list(priv, band);
 		struct sk_buff *skb = __qdisc_dequeue_head(qdisc, list);
@@ -516,6 +608,17 @@ static struct sk_buff *pfifo_fast_peek(struct Qdisc *qdisc)
 	struct pfifo_fast_priv *priv = qdisc_priv(qdisc);
 	int band = bitmap2band[priv->bitmap];
 
+	if (qdisc->flags & TCQ_F_NOLOCK) {
+		/* Only the __QDISC_STATE_RUNNING owner may use the result */
+		for (band = 0; band < PFIFO_FAST_BANDS; band++) {
+			struct sk_buff_head *list = band2list(priv, band);
+
+			if (!skb_queue_empty(list))
+				return skb_peek(list);
+		}
+		return NULL;
+	}
+
 	if (band >= 0) {
 		struct sk_buff_head *list = band2list(priv, band);
 
@@ -530,6 +633,11 @@ static void pfifo_fast_reset(struct Qdisc *qdisc)
 	int prio;
 	struct pfifo_fast_priv *priv = qdisc_priv(qdisc);
 
+	if (qdisc->flags & TCQ_F_NOLOCK) {
+		pfifo_fast_reset_nolock(qdisc);
+		return;
+	}
+
 	for (prio = 0; prio < PFIFO_FAST_BANDS; prio++)
 		__qdisc_reset_queue(qdisc, band2list(priv, prio));
 
@@ -557,7 +665,7 @@ static int pfifo_fast_init(struct Qdisc *qdisc, struct nlattr *opt)
 	struct pfifo_fast_priv *priv = qdisc_priv(qdisc);
 
 	for (prio = 0; prio < PFIFO_FAST_BANDS; prio++)
-		__skb_queue_head_init(band2list(priv, prio));
+		skb_queue_head_init(band2list(priv, prio));
 
 	/* Can by-pass the queue discipline */
 	qdisc->flags |= TCQ_F_CAN_BYPASS;
@@ -645,6 +753,29 @@ errout:
 }
 EXPORT_SYMBOL(qdisc_create_dflt);
 
+/* Let a qdisc that feeds a transmit queue directly run without the root
+ * lock, if it knows how to.  Children of classful qdiscs stay locked:
+ * their parent drives them and reads their queue length.  Must be called
+ * before the qdisc is attached.
+ */
+void qdisc_set_nolock(struct Qdisc *qdisc)
+{
+	if (qdisc->ops != &pfifo_fast_ops || qdisc_is_percpu_stats(qdisc))
+		return;
+
+	qdisc->cpu_bstats = netdev_alloc_pcpu_stats(struct gnet_stats_basic_cpu);
+	qdisc->cpu_qstats = alloc_percpu(struct gnet_stats_queue);
+	if (!qdisc->cpu_bstats || !qdisc->cpu_qstats) {
+		free_percpu(qdisc->cpu_bstats);
+		free_percpu(qdisc->cpu_qstats);
+		qdisc->cpu_bstats = NULL;
+		qdisc->cpu_qstats = NULL;
+		return;
+	}
+	qdisc->flags |= TCQ_F_CPUSTATS | TCQ_F_NOLOCK;
+}
+EXPORT_SYMBOL(qdisc_set_nolock);
+
 /* Under qdisc_lock(qdisc) and BH! */
 
 void qdisc_reset(struct Qdisc *qdisc)
@@ -666,8 +797,10 @@ static void qdisc_rcu_free(struct rcu_head *head)
 {
 	struct Qdisc *qdisc = container_of(head, struct Qdisc, rcu_head);
 
-	if (qdisc_is_percpu_stats(qdisc))
+	if (qdisc_is_percpu_stats(qdisc)) {
 		free_percpu(qdisc->cpu_bstats);
+		free_percpu(qdisc->cpu_qstats);
+	}
 
 	kfree((char *) qdisc - qdisc->padded);
 }
@@ -744,6 +877,7 @@ static void attach_one_default_qdisc(struct net_device *dev,
 		}
 		if (!netif_is_multiqueue(dev))
 			qdisc->flags |= TCQ_F_ONETXQUEUE;
+		qdisc_set_nolock(qdisc);
 	}
 	dev_queue->qdisc_sleeping = qdisc;
 }
@@ -828,8 +962,23 @@ static void dev_deactivate_queue(struct net_device *dev,
 			set_bit(__QDISC_STATE_DEACTIVATED, &qdisc->state);
 
 		rcu_assign_pointer(dev_queue->qdisc, qdisc_default);
-		qdisc_reset(qdisc);
+		/* a lockless qdisc may still be in use, see dev_reset_queue */
+		if (!(qdisc->flags & TCQ_F_NOLOCK))
+			qdisc_reset(qdisc);
+
+		spin_unlock_bh(qdisc_lock(qdisc));
+	}
+}
+
+static void dev_reset_queue(struct net_device *dev,
+			    struct netdev_queue *dev_queue,
+			    void *_unused)
+{
+	struct Qdisc *qdisc = dev_queue->qdisc_sleeping;
 
+	if (qdisc && (qdisc->flags & TCQ_F_NOLOCK)) {
+		spin_lock_bh(qdisc_lock(qdisc));
+		qdisc_reset(qdisc);
 		spin_unlock_bh(qdisc_lock(qdisc));
 	}
 }
@@ -895,6 +1044,10 @@ void dev_deactivate_many(struct list_head *head)
 	list_for_each_entry(dev, head, close_list)
 		while (some_qdisc_is_busy(dev))
 			yield();
+
+	/* Lockless qdiscs can only be reset once nobody uses them anymore */
+	list_for_each_entry(dev, head, close_list)
+		netdev_for_each_tx_queue(dev, dev_reset_queue, NULL);
 }
 
 void dev_deactivate(struct net_device *dev)
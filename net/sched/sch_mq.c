@@ -64,6 +64,7 @@ static int mq_init(struct Qdisc *sch, struct nlattr *opt)
 			goto err;
 		priv->qdiscs[ntx] = qdisc;
 		qdisc->flags |= TCQ_F_ONETXQUEUE;
+		qdisc_set_nolock(qdisc);
 	}
 
 	sch->flags |= TCQ_F_MQROOT;
@@ -107,15 +108,28 @@ static int mq_dump(struct Qdisc *sch, struct sk_buff *skb)
 	memset(&sch->qstats, 0, sizeof(sch->qstats));
 
 	for (ntx = 0; ntx < dev->num_tx_queues; ntx++) {
+		struct gnet_stats_basic_cpu __percpu *cpu_bstats = NULL;
+		struct gnet_stats_queue __percpu *cpu_qstats = NULL;
+		struct gnet_stats_basic_packed bstats = { 0 };
+		struct gnet_stats_queue qstats = { 0 };
+
 		qdisc = netdev_get_tx_queue(dev, ntx)->qdisc_sleeping;
 		spin_lock_bh(qdisc_lock(qdisc));
-		sch->q.qlen		+= qdisc->q.qlen;
-		sch->bstats.bytes	+= qdisc->bstats.bytes;
-		sch->bstats.packets	+= qdisc->bstats.packets;
-		sch->qstats.backlog	+= qdisc->qstats.backlog;
-		sch->qstats.drops	+= qdisc->qstats.drops;
-		sch->qstats.requeues	+= qdisc->qstats.requeues;
-		sch->qstats.overlimits	+= qdisc->qstats.overlimits;
+		if (qdisc_is_percpu_stats(qdisc)) {
+			cpu_bstats = qdisc->cpu_bstats;
+			cpu_qstats = qdisc->cpu_qstats;
+		}
+		__gnet_stats_copy_basic(&bstats, cpu_bstats, &qdisc->bstats);
+		__gnet_stats_copy_queue(&qstats, cpu_qstats, &qdisc->qstats,
+					qdisc_qlen(qdisc));
+
+		sch->q.qlen		+= qstats.qlen;
+		sch->bstats.bytes	+= bstats.bytes;
+		sch->bstats.packets	+= bstats.packets;
+		sch->qstats.backlog	+= qstats.backlog;
+		sch->qstats.drops	+= qstats.drops;
+		sch->qstats.requeues	+= qstats.requeues;
+		sch->qstats.overlimits	+= qstats.overlimits;
 		spin_unlock_bh(qdisc_lock(qdisc));
 	}
 	return 0;
@@ -197,10 +211,17 @@ static int mq_dump_class_stats(struct Qdisc *sch, unsigned long cl,
 			       struct gnet_dump *d)
 {
 	struct netdev_queue *dev_queue = mq_queue_get(sch, cl);
+	struct gnet_stats_basic_cpu __percpu *cpu_bstats = NULL;
+	struct gnet_stats_queue __percpu *cpu_qstats = NULL;
 
 	sch = dev_queue->qdisc_sleeping;
-	if (gnet_stats_copy_basic(d, NULL, &sch->bstats) < 0 ||
-	    gnet_stats_copy_queue(d, NULL, &sch->qstats, sch->q.qlen) < 0)
+	if (qdisc_is_percpu_stats(sch)) {
+		cpu_bstats = sch->cpu_bstats;
+		cpu_qstats = sch->cpu_qstats;
+	}
+	if (gnet_stats_copy_basic(d, cpu_bstats, &sch->bstats) < 0 ||
+	    gnet_stats_copy_queue(d, cpu_qstats, &sch->qstats,
+				  qdisc_qlen(sch)) < 0)
 		return -1;
 	return 0;
 }
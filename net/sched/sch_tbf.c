@@ -18,6 +18,7 @@
 #include <linux/string.h>
 #include <linux/errno.h>
 #include <linux/skbuff.h>
+#include <linux/rtnetlink.h>
 #include <net/netlink.h>
 #include <net/sch_generic.h>
 #include <net/pkt_sched.h>
@@ -96,8 +97,38 @@
 	With classful TBF, limit is just kept for backwards compatibility.
 	It is passed to the default bfifo qdisc - if the inner qdisc is
 	changed the limit is not effective anymore.
+
+	Shared rate groups.
+	-------------------
+
+	A tbf instance can also join a group (TCA_TBF_GROUP), identified by
+	a number per device. All members of a group share the group rate on
+	top of their own one. Put one tbf per queue below mq and each queue
+	is shaped under its own qdisc lock, while the group caps the sum.
+
+	Members borrow transmission time from the group in quanta of a
+	quarter of the group window, with a lockless GCRA: the group
+	keeps the theoretical arrival time (TAT) of its budget, and a
+	member may borrow as long as TAT does not run more than the window
+	ahead of now. The aggregate rate is thus accurate over the window,
+	not for every packet.
 */
 
+struct tbf_group {
+	struct list_head	list;
+	struct net_device	*dev;
+	u32			id;
+	int			refcnt;		/* protected by RTNL */
+	struct psched_ratecfg	rate;
+	s64			window;		/* ns */
+	s64			quantum;	/* ns */
+	atomic64_t		tat;		/* ns */
+};
+
+static LIST_HEAD(tbf_groups);			/* protected by RTNL */
+
+#define TBF_GROUP_WINDOW_DEFAULT	1000	/* usec */
+
 struct tbf_sched_data {
 /* Parameters */
 	u32		limit;		/* Maximal length of backlog: bytes */
@@ -113,6 +144,8 @@ struct tbf_sched_data {
 	s64	t_c;			/* Time check-point */
 	struct Qdisc	*qdisc;		/* Inner qdisc, default - bfifo queue */
 	struct qdisc_watchdog watchdog;	/* Watchdog timer */
+	struct tbf_group *group;	/* Shared rate group, or NULL */
+	s64	gtokens;		/* Time borrowed from the group */
 };
 
 
@@ -226,6 +259,95 @@ static bool tbf_peak_present(const struct tbf_sched_data *q)
 	return q->peak.rate_bytes_ps;
 }
 
+static void tbf_group_set(struct tbf_group *g, u64 rate64, u32 window)
+{
+	struct tc_ratespec conf = { .linklayer = TC_LINKLAYER_ETHERNET };
+
+	psched_ratecfg_precompute(&g->rate, &conf, rate64);
+	g->window = (s64)window * NSEC_PER_USEC;
+	g->quantum = g->window >> 2;
+}
+
+/* Find or create the group @id of @dev, a new group needs a rate. */
+static struct tbf_group *tbf_group_get(struct net_device *dev, u32 id,
+				       u64 rate64, u32 window)
+{
+	struct tbf_group *g;
+
+	ASSERT_RTNL();
+
+	if (!window)
+		window = TBF_GROUP_WINDOW_DEFAULT;
+
+	list_for_each_entry(g, &tbf_groups, list) {
+		if (g->dev != dev || g->id != id)
+			continue;
+		/* Members read the parameters without locking, a change
+		 * may be seen half done by a single dequeue.
+		 */
+		if (rate64)
+			tbf_group_set(g, rate64, window);
+		g->refcnt++;
+		return g;
+	}
+
+	if (!rate64)
+		return ERR_PTR(-EINVAL);
+
+	g = kzalloc(sizeof(*g), GFP_KERNEL);
+	if (!g)
+		return ERR_PTR(-ENOMEM);
+
+	g->dev = dev;
+	g->id = id;
+	g->refcnt = 1;
+	tbf_group_set(g, rate64, window);
+	atomic64_set(&g->tat, ktime_get_ns());
+	list_add(&g->list, &tbf_groups);
+	return g;
+}
+
+static void tbf_group_put(struct tbf_group *g)
+{
+	ASSERT_RTNL();
+
+	if (g && --g->refcnt == 0) {
+		list_del(&g->list);
+		kfree(g);
+	}
+}
+
+/* Take the transmission time of @len bytes from the group budget. Returns
+ * 0 on success, or the time in ns until the group can lend again.
+ */
+static s64 tbf_group_borrow(struct tbf_sched_data *q, unsigned int len,
+			    s64 now)
+{
+	struct tbf_group *g = q->group;
+	s64 cost = (s64) psched_l2t_ns(&g->rate, len);
+	s64 want, old, tat, cur;
+
+	if (q->gtokens >= cost) {
+		q->gtokens -= cost;
+		return 0;
+	}
+
+	want = max_t(s64, cost - q->gtokens, g->quantum);
+	old = atomic64_read(&g->tat);
+	for (;;) {
+		tat = max_t(s64, old, now);
+		if (tat - now > g->window)
+			return tat - now - g->window;
+		cur = atomic64_cmpxchg(&g->tat, old, tat + want);
+		if (cur == old)
+			break;
+		old = cur;
+	}
+
+	q->gtokens += want - cost;
+	return 0;
+}
+
 static struct sk_buff *tbf_dequeue(struct Qdisc *sch)
 {
 	struct tbf_sched_data *q = qdisc_priv(sch);
@@ -237,6 +359,7 @@ static struct sk_buff *tbf_dequeue(struct Qdisc *sch)
 		s64 now;
 		s64 toks;
 		s64 ptoks = 0;
+		s64 gdelay = 0;
 		unsigned int len = qdisc_pkt_len(skb);
 
 		now = ktime_get_ns();
@@ -253,7 +376,10 @@ static struct sk_buff *tbf_dequeue(struct Qdisc *sch)
 			toks = q->buffer;
 		toks -= (s64) psched_l2t_ns(&q->rate, len);
 
-		if ((toks|ptoks) >= 0) {
+		if ((toks|ptoks) >= 0 && q->group)
+			gdelay = tbf_group_borrow(q, len, now);
+
+		if ((toks|ptoks) >= 0 && !gdelay) {
 			skb = qdisc_dequeue_peeked(q->qdisc);
 			if (unlikely(!skb))
 				return NULL;
@@ -268,7 +394,8 @@ static struct sk_buff *tbf_dequeue(struct Qdisc *sch)
 		}
 
 		qdisc_watchdog_schedule_ns(&q->watchdog,
-					   now + max_t(long, -toks, -ptoks),
+					   now + max_t(s64, gdelay,
+						       max_t(long, -toks, -ptoks)),
 					   true);
 
 		/* Maybe we have a shorter packet in the queue,
@@ -307,6 +434,9 @@ static const struct nla_policy tbf_policy[TCA_TBF_MAX + 1] = {
 	[TCA_TBF_PRATE64]	= { .type = NLA_U64 },
 	[TCA_TBF_BURST] = { .type = NLA_U32 },
 	[TCA_TBF_PBURST] = { .type = NLA_U32 },
+	[TCA_TBF_GROUP] = { .type = NLA_U32 },
+	[TCA_TBF_GROUP_RATE64] = { .type = NLA_U64 },
+	[TCA_TBF_GROUP_WINDOW] = { .type = NLA_U32 },
 };
 
 static int tbf_change(struct Qdisc *sch, struct nlattr *opt)
@@ -316,6 +446,7 @@ static int tbf_change(struct Qdisc *sch, struct nlattr *opt)
 	struct nlattr *tb[TCA_TBF_MAX + 1];
 	struct tc_tbf_qopt *qopt;
 	struct Qdisc *child = NULL;
+	struct tbf_group *group = NULL;
 	struct psched_ratecfg rate;
 	struct psched_ratecfg peak;
 	u64 max_size;
@@ -397,6 +528,25 @@ static int tbf_change(struct Qdisc *sch, struct nlattr *opt)
 		}
 	}
 
+	if (tb[TCA_TBF_GROUP]) {
+		u64 grate64 = 0;
+		u32 gwindow = 0;
+
+		if (tb[TCA_TBF_GROUP_RATE64])
+			grate64 = nla_get_u64(tb[TCA_TBF_GROUP_RATE64]);
+		if (tb[TCA_TBF_GROUP_WINDOW])
+			gwindow = nla_get_u32(tb[TCA_TBF_GROUP_WINDOW]);
+		group = tbf_group_get(qdisc_dev(sch),
+				      nla_get_u32(tb[TCA_TBF_GROUP]),
+				      grate64, gwindow);
+		if (IS_ERR(group)) {
+			if (child)
+				qdisc_destroy(child);
+			err = PTR_ERR(group);
+			goto done;
+		}
+	}
+
 	sch_tree_lock(sch);
 	if (child) {
 		qdisc_tree_decrease_qlen(q->qdisc, q->qdisc->q.qlen);
@@ -418,8 +568,11 @@ static int tbf_change(struct Qdisc *sch, struct nlattr *opt)
 
 	memcpy(&q->rate, &rate, sizeof(struct psched_ratecfg));
 	memcpy(&q->peak, &peak, sizeof(struct psched_ratecfg));
+	swap(q->group, group);
+	q->gtokens = 0;
 
 	sch_tree_unlock(sch);
+	tbf_group_put(group);
 	err = 0;
 done:
 	return err;
@@ -445,6 +598,7 @@ static void tbf_destroy(struct Qdisc *sch)
 
 	qdisc_watchdog_cancel(&q->watchdog);
 	qdisc_destroy(q->qdisc);
+	tbf_group_put(q->group);
 }
 
 static int tbf_dump(struct Qdisc *sch, struct sk_buff *skb)
@@ -475,6 +629,13 @@ static int tbf_dump(struct Qdisc *sch, struct sk_buff *skb)
 	    q->peak.rate_bytes_ps >= (1ULL << 32) &&
 	    nla_put_u64(skb, TCA_TBF_PRATE64, q->peak.rate_bytes_ps))
 		goto nla_put_failure;
+	if (q->group &&
+	    (nla_put_u32(skb, TCA_TBF_GROUP, q->group->id) ||
+	     nla_put_u64(skb, TCA_TBF_GROUP_RATE64,
+			 q->group->rate.rate_bytes_ps) ||
+	     nla_put_u32(skb, TCA_TBF_GROUP_WINDOW,
+			 div_s64(q->group->window, NSEC_PER_USEC))))
+		goto nla_put_failure;
 
 	return nla_nest_end(skb, nest);
 
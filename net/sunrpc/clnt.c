@@ -79,6 +79,9 @@ static void	call_connect_status(struct rpc_task *task);
 static __be32	*rpc_encode_header(struct rpc_task *task);
 static __be32	*rpc_verify_header(struct rpc_task *task);
 static int	rpc_ping(struct rpc_clnt *clnt);
+static void	rpc_clnt_add_extra_xprts(struct rpc_clnt *clnt,
+					 struct xprt_create *xprtargs,
+					 const struct rpc_create_args *args);
 
 static void rpc_register_client(struct rpc_clnt *clnt)
 {
@@ -488,6 +491,7 @@ EXPORT_SYMBOL_GPL(rpc_create_xprt);
  */
 struct rpc_clnt *rpc_create(struct rpc_create_args *args)
 {
+	struct rpc_clnt *clnt;
 	struct rpc_xprt *xprt;
 	struct xprt_create xprtargs = {
 		.net = args->net,
@@ -552,10 +556,80 @@ struct rpc_clnt *rpc_create(struct rpc_create_args *args)
 	if (args->flags & RPC_CLNT_CREATE_NONPRIVPORT)
 		xprt->resvport = 0;
 
-	return rpc_create_xprt(args, xprt);
+	clnt = rpc_create_xprt(args, xprt);
+	if (!IS_ERR(clnt) && args->nconnect > 1)
+		rpc_clnt_add_extra_xprts(clnt, &xprtargs, args);
+	return clnt;
 }
 EXPORT_SYMBOL_GPL(rpc_create);
 
+/*
+ * Open the extra connections asked for with args->nconnect.  Each one is
+ * an independent transport to the same server address; new requests are
+ * spread over them by rpc_clnt_pick_xprt().  Only transports that are
+ * already bound can be cloned this way, since the rpcbind result of the
+ * main transport is not shared.  Failing to open an extra connection is
+ * not fatal: the client simply runs with fewer of them.
+ */
+static void rpc_clnt_add_extra_xprts(struct rpc_clnt *clnt,
+				     struct xprt_create *xprtargs,
+				     const struct rpc_create_args *args)
+{
+	struct rpc_xprt *first, *xprt;
+	unsigned int i, n;
+
+	first = rcu_dereference_raw(clnt->cl_xprt);
+	if (!xprt_bound(first))
+		return;
+
+	n = min_t(unsigned int, args->nconnect, RPC_MAX_NCONNECT) - 1;
+	for (i = 0; i < n; i++) {
+		xprt = xprt_create_transport(xprtargs);
+		if (IS_ERR(xprt)) {
+			dprintk("RPC:       %s: extra transport %u: error %ld\n",
+				__func__, i, PTR_ERR(xprt));
+			break;
+		}
+		xprt->resvport = first->resvport;
+		clnt->cl_extra_xprt[i] = xprt;
+	}
+	/* publish the array before the count rpc_clnt_pick_xprt() reads */
+	smp_store_release(&clnt->cl_nr_extra_xprt, i);
+}
+
+static void rpc_clnt_put_extra_xprts(struct rpc_clnt *clnt)
+{
+	unsigned int i, n = clnt->cl_nr_extra_xprt;
+
+	clnt->cl_nr_extra_xprt = 0;
+	for (i = 0; i < n; i++) {
+		xprt_put(clnt->cl_extra_xprt[i]);
+		clnt->cl_extra_xprt[i] = NULL;
+	}
+}
+
+/**
+ * rpc_clnt_pick_xprt - choose the transport for a new request
+ * @clnt: RPC client
+ *
+ * Returns the main transport, or one of the extra transports opened
+ * with nconnect, in round-robin order.  Must be called under
+ * rcu_read_lock().
+ */
+struct rpc_xprt *rpc_clnt_pick_xprt(struct rpc_clnt *clnt)
+{
+	unsigned int n = smp_load_acquire(&clnt->cl_nr_extra_xprt);
+	unsigned int i;
+
+	if (n) {
+		i = (unsigned int)atomic_inc_return(&clnt->cl_xprt_rr) % (n + 1);
+		if (i)
+			return clnt->cl_extra_xprt[i - 1];
+	}
+	return rcu_dereference(clnt->cl_xprt);
+}
+EXPORT_SYMBOL_GPL(rpc_clnt_pick_xprt);
+
 /*
  * This function clones the RPC client structure. It allows us to share the
  * same transport while varying parameters such as the authentication
@@ -566,6 +640,7 @@ static struct rpc_clnt *__rpc_clone_client(struct rpc_create_args *args,
 {
 	struct rpc_xprt *xprt;
 	struct rpc_clnt *new;
+	unsigned int i;
 	int err;
 
 	err = -ENOMEM;
@@ -583,6 +658,10 @@ static struct rpc_clnt *__rpc_clone_client(struct rpc_create_args *args,
 		goto out_err;
 	}
 
+	for (i = 0; i < clnt->cl_nr_extra_xprt; i++)
+		new->cl_extra_xprt[i] = xprt_get(clnt->cl_extra_xprt[i]);
+	smp_store_release(&new->cl_nr_extra_xprt, i);
+
 	/* Turn off autobind on clones */
 	new->cl_autobind = 0;
 	new->cl_softrtry = clnt->cl_softrtry;
@@ -659,6 +738,7 @@ int rpc_switch_client_transport(struct rpc_clnt *clnt,
 	rpc_authflavor_t pseudoflavor;
 	struct rpc_xprt *xprt, *old;
 	struct rpc_clnt *parent;
+	unsigned int i, n;
 	int err;
 
 	xprt = xprt_create_transport(args);
@@ -694,9 +774,20 @@ int rpc_switch_client_transport(struct rpc_clnt *clnt,
 	if (err)
 		goto out_revert;
 
+	/*
+	 * The extra transports point at the old server; from now on
+	 * everything goes over the new one.
+	 */
+	n = clnt->cl_nr_extra_xprt;
+	WRITE_ONCE(clnt->cl_nr_extra_xprt, 0);
+
 	synchronize_rcu();
 	if (parent != clnt)
 		rpc_release_client(parent);
+	for (i = 0; i < n; i++) {
+		xprt_put(clnt->cl_extra_xprt[i]);
+		clnt->cl_extra_xprt[i] = NULL;
+	}
 	xprt_put(old);
 	dprintk("RPC:       replaced xprt for clnt %p\n", clnt);
 	return 0;
@@ -782,6 +873,7 @@ rpc_free_client(struct rpc_clnt *clnt)
 	rpc_unregister_client(clnt);
 	rpc_free_iostats(clnt->cl_metrics);
 	clnt->cl_metrics = NULL;
+	rpc_clnt_put_extra_xprts(clnt);
 	xprt_put(rcu_dereference_raw(clnt->cl_xprt));
 	rpciod_down();
 	rpc_free_clid(clnt);
@@ -33,6 +33,18 @@ static void svc_xprt_do_enqueue(struct svc_xprt *xprt);
  */
 static int svc_conn_age_period = 6*60;
 
+/*
+ * How long, at most, an idle server thread spins looking for work
+ * before it goes to sleep.  0 disables polling.
+ */
+static unsigned int svc_idle_poll_usecs;
+module_param(svc_idle_poll_usecs, uint, 0644);
+MODULE_PARM_DESC(svc_idle_poll_usecs,
+		 "Max time (us) an idle RPC server thread polls before sleeping");
+
+/* the least the adaptive budget shrinks to, so that it can grow back */
+#define SVC_MIN_POLL_NS		(1 * NSEC_PER_USEC)
+
 /* List of registered transport classes */
 static DEFINE_SPINLOCK(svc_xprt_class_lock);
 static LIST_HEAD(svc_xprt_class_list);
@@ -644,6 +656,10 @@ rqst_should_sleep(struct svc_rqst *rqstp)
 {
 	struct svc_pool		*pool = rqstp->rq_pool;
 
+	/* did svc_xprt_do_enqueue() hand us a transport already? */
+	if (READ_ONCE(rqstp->rq_xprt))
+		return false;
+
 	/* did someone call svc_wake_up? */
 	if (test_and_clear_bit(SP_TASK_PENDING, &pool->sp_flags))
 		return false;
@@ -663,6 +679,41 @@ rqst_should_sleep(struct svc_rqst *rqstp)
 	return true;
 }
 
+/*
+ * Spin for a little while before sleeping.  A polling thread looks idle
+ * to svc_xprt_do_enqueue() just like a sleeping one, but picks the work
+ * up without a context switch and a cross-CPU wakeup.  The budget adapts
+ * per thread: it doubles when polling found work and halves when not.
+ * Returns true if there is no point in going to sleep.
+ */
+static bool svc_poll_for_work(struct svc_rqst *rqstp)
+{
+	unsigned int max_ns = READ_ONCE(svc_idle_poll_usecs) * NSEC_PER_USEC;
+	bool found = false;
+	u64 end;
+
+	if (!max_ns)
+		return false;
+	if (!rqstp->rq_poll_ns || rqstp->rq_poll_ns > max_ns)
+		rqstp->rq_poll_ns = max_ns;
+
+	end = local_clock() + rqstp->rq_poll_ns;
+	do {
+		if (!rqst_should_sleep(rqstp)) {
+			found = true;
+			break;
+		}
+		cpu_relax();
+	} while (!need_resched() && local_clock() < end);
+
+	if (found)
+		rqstp->rq_poll_ns = min(rqstp->rq_poll_ns * 2, max_ns);
+	else
+		rqstp->rq_poll_ns = max_t(unsigned int, rqstp->rq_poll_ns / 2,
+					  SVC_MIN_POLL_NS);
+	return found;
+}
+
 static struct svc_xprt *svc_get_next_xprt(struct svc_rqst *rqstp, long timeout)
 {
 	struct svc_xprt *xprt;
@@ -690,18 +741,24 @@ static struct svc_xprt *svc_get_next_xprt(struct svc_rqst *rqstp, long timeout)
 		return xprt;
 	}
 
-	/*
-	 * We have to be able to interrupt this wait
-	 * to bring down the daemons ...
-	 */
-	set_current_state(TASK_INTERRUPTIBLE);
 	clear_bit(RQ_BUSY, &rqstp->rq_flags);
 	smp_mb();
 
-	if (likely(rqst_should_sleep(rqstp)))
-		time_left = schedule_timeout(timeout);
-	else
-		__set_current_state(TASK_RUNNING);
+	if (!svc_poll_for_work(rqstp)) {
+		/*
+		 * We have to be able to interrupt this wait
+		 * to bring down the daemons ...
+		 *
+		 * A transport handed over while we were still polling
+		 * found us running, so its wakeup was lost; the rq_xprt
+		 * test in rqst_should_sleep() catches that.
+		 */
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (likely(rqst_should_sleep(rqstp)))
+			time_left = schedule_timeout(timeout);
+		else
+			__set_current_state(TASK_RUNNING);
+	}
 
 	try_to_freeze();
 
@@ -1181,7 +1181,7 @@ void xprt_reserve(struct rpc_task *task)
 	task->tk_timeout = 0;
 	task->tk_status = -EAGAIN;
 	rcu_read_lock();
-	xprt = rcu_dereference(task->tk_client->cl_xprt);
+	xprt = rpc_clnt_pick_xprt(task->tk_client);
 	if (!xprt_throttle_congested(xprt, task))
 		xprt->ops->alloc_slot(xprt, task);
 	rcu_read_unlock();
@@ -1207,7 +1207,7 @@ void xprt_retry_reserve(struct rpc_task *task)
 	task->tk_timeout = 0;
 	task->tk_status = -EAGAIN;
 	rcu_read_lock();
-	xprt = rcu_dereference(task->tk_client->cl_xprt);
+	xprt = rpc_clnt_pick_xprt(task->tk_client);
 	xprt->ops->alloc_slot(xprt, task);
 	rcu_read_unlock();
 }
@@ -0,0 +1,478 @@
+/*
+ * Kernel TLS (record layer) support: software record encryption.
+ *
+ * Data written to the socket is collected into an open record, a list
+ * of plaintext page fragments.  sendmsg() copies user data into the
+ * socket page_frag; sendpage() just takes a reference on the page it is
+ * given, so sendfile() never copies file data through user space.  When
+ * the record is full, or the caller does not announce more data, it is
+ * encrypted with AES-GCM into freshly allocated pages behind the record
+ * header and explicit nonce, and those pages are handed to TCP with
+ * do_tcp_sendpages().
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ */
+
+#include <linux/module.h>
+#include <crypto/aead.h>
+
+#include <net/tls.h>
+
+static bool tls_record_is_full(struct tls_sw_context *ctx)
+{
+	return ctx->sg_plaintext_size >= TLS_MAX_PAYLOAD_SIZE ||
+	       ctx->sg_plaintext_num_elem >= MAX_SKB_FRAGS;
+}
+
+static void free_sg(struct sock *sk, struct scatterlist *sg,
+		    int *sg_num_elem, unsigned int *sg_size, int max_elem)
+{
+	int i, n = *sg_num_elem;
+
+	for (i = 0; i < n; ++i) {
+		sk_mem_uncharge(sk, sg[i].length);
+		put_page(sg_page(&sg[i]));
+	}
+	sg_init_table(sg, max_elem);
+	*sg_num_elem = 0;
+	*sg_size = 0;
+}
+
+static void trim_both_sgl(struct sock *sk, struct tls_sw_context *ctx)
+{
+	int i;
+
+	/* The encrypted pages are never charged to the socket, TCP accounts
+	 * for them once do_tcp_sendpages() attaches them to an skb.
+	 */
+	for (i = 0; i < ctx->sg_encrypted_num_elem; i++)
+		put_page(sg_page(&ctx->sg_encrypted_data[i]));
+	sg_init_table(ctx->sg_encrypted_data,
+		      ARRAY_SIZE(ctx->sg_encrypted_data));
+	ctx->sg_encrypted_num_elem = 0;
+	ctx->sg_encrypted_size = 0;
+}
+
+static int alloc_encrypted_sg(struct sock *sk, int len)
+{
+	struct tls_context *tls_ctx = tls_get_ctx(sk);
+	struct tls_sw_context *ctx = tls_sw_ctx(tls_ctx);
+	struct scatterlist *sg = ctx->sg_encrypted_data;
+	int i = 0;
+
+	sg_init_table(sg, ARRAY_SIZE(ctx->sg_encrypted_data));
+	while (len > 0) {
+		size_t chunk = min_t(size_t, len, PAGE_SIZE);
+		struct page *page;
+
+		page = alloc_page(sk->sk_allocation);
+		if (!page) {
+			ctx->sg_encrypted_num_elem = i;
+			trim_both_sgl(sk, ctx);
+			return -ENOMEM;
+		}
+
+		sg_set_page(&sg[i++], page, chunk, 0);
+		ctx->sg_encrypted_size += chunk;
+		len -= chunk;
+	}
+
+	sg_mark_end(&sg[i - 1]);
+	ctx->sg_encrypted_num_elem = i;
+	return 0;
+}
+
+static int tls_do_encryption(struct tls_context *tls_ctx,
+			     struct tls_sw_context *ctx, size_t data_len,
+			     gfp_t flags)
+{
+	unsigned int prepend = tls_ctx->tx.prepend_size;
+	struct aead_request *aead_req;
+	int rc;
+
+	aead_req = aead_request_alloc(ctx->aead_send, flags);
+	if (!aead_req)
+		return -ENOMEM;
+
+	/* The ciphertext goes right behind the header and explicit nonce */
+	ctx->sg_encrypted_data[0].offset += prepend;
+	ctx->sg_encrypted_data[0].length -= prepend;
+
+	aead_request_set_callback(aead_req, 0, NULL, NULL);
+	aead_request_set_assoc(aead_req, ctx->sg_aad, TLS_AAD_SPACE_SIZE);
+	aead_request_set_crypt(aead_req, ctx->sg_plaintext_data,
+			       ctx->sg_encrypted_data,
+			       data_len, tls_ctx->tx.iv);
+	rc = crypto_aead_encrypt(aead_req);
+
+	ctx->sg_encrypted_data[0].offset -= prepend;
+	ctx->sg_encrypted_data[0].length += prepend;
+
+	aead_request_free(aead_req);
+	return rc;
+}
+
+/* Close the open record: encrypt it and start pushing it to TCP.  The
+ * record counts as sent once encrypted, even if TCP only took part of
+ * it; the rest is pushed before any later record.
+ */
+static int tls_push_record(struct sock *sk, int flags)
+{
+	struct tls_context *tls_ctx = tls_get_ctx(sk);
+	struct tls_sw_context *ctx = tls_sw_ctx(tls_ctx);
+	size_t size = ctx->sg_plaintext_size;
+	struct scatterlist *last;
+	int rc;
+
+	if (!ctx->sg_plaintext_num_elem)
+		return 0;
+
+	rc = alloc_encrypted_sg(sk, size + tls_ctx->tx.overhead_size);
+	if (rc)
+		return rc;
+
+	last = &ctx->sg_plaintext_data[ctx->sg_plaintext_num_elem - 1];
+	sg_mark_end(last);
+
+	tls_make_aad(ctx->aad_space, size,
+		     tls_ctx->tx.rec_seq, tls_ctx->tx.rec_seq_size,
+		     TLS_RECORD_TYPE_DATA);
+
+	tls_fill_prepend(tls_ctx,
+			 page_address(sg_page(&ctx->sg_encrypted_data[0])) +
+			 ctx->sg_encrypted_data[0].offset,
+			 size, TLS_RECORD_TYPE_DATA);
+
+	rc = tls_do_encryption(tls_ctx, ctx, size, sk->sk_allocation);
+	if (rc < 0) {
+		/* Leave the open record alone, a later send retries it */
+		sg_unmark_end(last);
+		trim_both_sgl(sk, ctx);
+		return rc;
+	}
+
+	free_sg(sk, ctx->sg_plaintext_data, &ctx->sg_plaintext_num_elem,
+		&ctx->sg_plaintext_size, ARRAY_SIZE(ctx->sg_plaintext_data));
+
+	/* Only advance the record number once the record is committed */
+	tls_advance_record_sn(sk, &tls_ctx->tx);
+
+	/* tls_push_sg() drops our page references as TCP takes them */
+	ctx->sg_encrypted_num_elem = 0;
+	ctx->sg_encrypted_size = 0;
+	return tls_push_sg(sk, tls_ctx, ctx->sg_encrypted_data, 0, flags);
+}
+
+int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
+{
+	struct tls_context *tls_ctx = tls_get_ctx(sk);
+	struct tls_sw_context *ctx = tls_sw_ctx(tls_ctx);
+	bool eor = !(msg->msg_flags & MSG_MORE);
+	struct page_frag *pfrag;
+	int copied = 0;
+	long timeo;
+	int ret = 0;
+
+	if (msg->msg_flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL))
+		return -ENOTSUPP;
+
+	lock_sock(sk);
+
+	timeo = sock_sndtimeo(sk, msg->msg_flags & MSG_DONTWAIT);
+
+	ret = tls_push_partial_record(sk, tls_ctx, msg->msg_flags);
+	if (ret)
+		goto send_end;
+
+	pfrag = sk_page_frag(sk);
+	while (msg_data_left(msg)) {
+		struct scatterlist *sg;
+		size_t copy;
+
+		if (sk->sk_err) {
+			ret = -sk->sk_err;
+			goto send_end;
+		}
+
+		/* Retry a full record that an earlier push left open */
+		if (tls_record_is_full(ctx)) {
+			ret = tls_push_record(sk, msg->msg_flags);
+			if (ret)
+				goto send_end;
+		}
+
+		if (!sk_page_frag_refill(sk, pfrag))
+			goto wait_for_memory;
+
+		copy = min_t(size_t, msg_data_left(msg),
+			     TLS_MAX_PAYLOAD_SIZE - ctx->sg_plaintext_size);
+		copy = min_t(size_t, copy, pfrag->size - pfrag->offset);
+
+		if (!sk_wmem_schedule(sk, copy))
+			goto wait_for_memory;
+
+		copy = copy_page_from_iter(pfrag->page, pfrag->offset, copy,
+					   &msg->msg_iter);
+		if (!copy) {
+			ret = -EFAULT;
+			goto send_end;
+		}
+
+		sg = &ctx->sg_plaintext_data[ctx->sg_plaintext_num_elem];
+		if (ctx->sg_plaintext_num_elem &&
+		    sg_page(sg - 1) == pfrag->page &&
+		    (sg - 1)->offset + (sg - 1)->length == pfrag->offset) {
+			(sg - 1)->length += copy;
+		} else {
+			get_page(pfrag->page);
+			sg_set_page(sg, pfrag->page, copy, pfrag->offset);
+			ctx->sg_plaintext_num_elem++;
+		}
+
+		pfrag->offset += copy;
+		ctx->sg_plaintext_size += copy;
+		sk_mem_charge(sk, copy);
+		copied += copy;
+
+		if (tls_record_is_full(ctx) || (!msg_data_left(msg) && eor)) {
+			ret = tls_push_record(sk, msg->msg_flags);
+			if (ret)
+				goto send_end;
+		}
+
+		continue;
+
+wait_for_memory:
+		set_bit(SOCK_NOSPACE, &sk->sk_socket->flags);
+		ret = sk_stream_wait_memory(sk, &timeo);
+		if (ret)
+			goto send_end;
+	}
+
+send_end:
+	ret = sk_stream_error(sk, msg->msg_flags, ret);
+
+	release_sock(sk);
+	return copied ? copied : ret;
+}
+
+int tls_sw_sendpage(struct sock *sk, struct page *page,
+		    int offset, size_t size, int flags)
+{
+	struct tls_context *tls_ctx = tls_get_ctx(sk);
+	struct tls_sw_context *ctx = tls_sw_ctx(tls_ctx);
+	struct scatterlist *sg;
+	int copied = 0;
+	long timeo;
+	bool eor;
+	int ret;
+
+	if (flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL |
+		      MSG_SENDPAGE_NOTLAST))
+		return -ENOTSUPP;
+
+	/* No MSG_EOR from splice, only look at MSG_MORE */
+	eor = !(flags & (MSG_MORE | MSG_SENDPAGE_NOTLAST));
+
+	lock_sock(sk);
+
+	timeo = sock_sndtimeo(sk, flags & MSG_DONTWAIT);
+
+	ret = tls_push_partial_record(sk, tls_ctx, flags);
+	if (ret)
+		goto sendpage_end;
+
+	while (size > 0) {
+		size_t copy;
+
+		if (sk->sk_err) {
+			ret = -sk->sk_err;
+			goto sendpage_end;
+		}
+
+		if (tls_record_is_full(ctx)) {
+			ret = tls_push_record(sk, flags);
+			if (ret)
+				goto sendpage_end;
+		}
+
+		copy = min_t(size_t, size,
+			     TLS_MAX_PAYLOAD_SIZE - ctx->sg_plaintext_size);
+
+		if (!sk_wmem_schedule(sk, copy))
+			goto wait_for_memory;
+
+		/* Reference the caller's page instead of copying it */
+		get_page(page);
+		sg = &ctx->sg_plaintext_data[ctx->sg_plaintext_num_elem];
+		sg_set_page(sg, page, copy, offset);
+		ctx->sg_plaintext_num_elem++;
+
+		sk_mem_charge(sk, copy);
+		offset += copy;
+		size -= copy;
+		copied += copy;
+		ctx->sg_plaintext_size += copy;
+
+		if (tls_record_is_full(ctx) || (!size && eor)) {
+			ret = tls_push_record(sk, flags);
+			if (ret)
+				goto sendpage_end;
+		}
+
+		continue;
+
+wait_for_memory:
+		set_bit(SOCK_NOSPACE, &sk->sk_socket->flags);
+		ret = sk_stream_wait_memory(sk, &timeo);
+		if (ret)
+			goto sendpage_end;
+	}
+
+sendpage_end:
+	ret = sk_stream_error(sk, flags, ret);
+
+	release_sock(sk);
+	return copied ? copied : ret;
+}
+
+void tls_sw_free_tx_resources(struct sock *sk)
+{
+	struct tls_context *tls_ctx = tls_get_ctx(sk);
+	struct tls_sw_context *ctx = tls_sw_ctx(tls_ctx);
+
+	if (!ctx)
+		return;
+
+	/* Flush whatever is still queued, without blocking the close */
+	if (!tls_push_partial_record(sk, tls_ctx,
+				     MSG_DONTWAIT | MSG_NOSIGNAL))
+		tls_push_record(sk, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+	crypto_free_aead(ctx->aead_send);
+
+	tls_free_partial_record(tls_ctx);
+	free_sg(sk, ctx->sg_plaintext_data, &ctx->sg_plaintext_num_elem,
+		&ctx->sg_plaintext_size, ARRAY_SIZE(ctx->sg_plaintext_data));
+
+	kfree(tls_ctx->tx.rec_seq);
+	kfree(tls_ctx->tx.iv);
+
+	kfree(ctx);
+	tls_ctx->priv_ctx = NULL;
+}
+
+int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx)
+{
+	struct tls_crypto_info *crypto_info;
+	struct tls12_crypto_info_aes_gcm_128 *gcm_128_info;
+	struct tls_sw_context *sw_ctx;
+	u16 nonce_size, tag_size, iv_size, rec_seq_size;
+	char *iv, *rec_seq;
+	int rc = 0;
+
+	if (!ctx) {
+		rc = -EINVAL;
+		goto out;
+	}
+
+	if (ctx->priv_ctx) {
+		rc = -EEXIST;
+		goto out;
+	}
+
+	sw_ctx = kzalloc(sizeof(*sw_ctx), GFP_KERNEL);
+	if (!sw_ctx) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	ctx->priv_ctx = sw_ctx;
+
+	crypto_info = &ctx->crypto_send;
+	switch (crypto_info->cipher_type) {
+	case TLS_CIPHER_AES_GCM_128: {
+		nonce_size = TLS_CIPHER_AES_GCM_128_IV_SIZE;
+		tag_size = TLS_CIPHER_AES_GCM_128_TAG_SIZE;
+		iv_size = TLS_CIPHER_AES_GCM_128_IV_SIZE;
+		iv = ((struct tls12_crypto_info_aes_gcm_128 *)crypto_info)->iv;
+		rec_seq_size = TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE;
+		rec_seq =
+		 ((struct tls12_crypto_info_aes_gcm_128 *)crypto_info)->rec_seq;
+		gcm_128_info =
+			(struct tls12_crypto_info_aes_gcm_128 *)crypto_info;
+		break;
+	}
+	default:
+		rc = -EINVAL;
+		goto free_priv;
+	}
+
+	ctx->tx.prepend_size = TLS_HEADER_SIZE + nonce_size;
+	ctx->tx.tag_size = tag_size;
+	ctx->tx.overhead_size = ctx->tx.prepend_size + ctx->tx.tag_size;
+	ctx->tx.iv_size = iv_size;
+	ctx->tx.iv = kmalloc(iv_size + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+			     GFP_KERNEL);
+	if (!ctx->tx.iv) {
+		rc = -ENOMEM;
+		goto free_priv;
+	}
+	/* GCM nonce: implicit salt followed by the explicit per-record IV */
+	memcpy(ctx->tx.iv, gcm_128_info->salt,
+	       TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+	memcpy(ctx->tx.iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE, iv, iv_size);
+	ctx->tx.rec_seq_size = rec_seq_size;
+	ctx->tx.rec_seq = kmemdup(rec_seq, rec_seq_size, GFP_KERNEL);
+	if (!ctx->tx.rec_seq) {
+		rc = -ENOMEM;
+		goto free_iv;
+	}
+
+	sg_init_table(sw_ctx->sg_encrypted_data,
+		      ARRAY_SIZE(sw_ctx->sg_encrypted_data));
+	sg_init_table(sw_ctx->sg_plaintext_data,
+		      ARRAY_SIZE(sw_ctx->sg_plaintext_data));
+
+	sg_init_table(sw_ctx->sg_aad, ARRAY_SIZE(sw_ctx->sg_aad));
+	sg_set_buf(&sw_ctx->sg_aad[0], sw_ctx->aad_space,
+		   sizeof(sw_ctx->aad_space));
+
+	/* Encryption runs under the socket lock and the record is pushed
+	 * right after it, so only take synchronous implementations.
+	 */
+	sw_ctx->aead_send = crypto_alloc_aead("gcm(aes)", 0,
+					      CRYPTO_ALG_ASYNC);
+	if (IS_ERR(sw_ctx->aead_send)) {
+		rc = PTR_ERR(sw_ctx->aead_send);
+		sw_ctx->aead_send = NULL;
+		goto free_rec_seq;
+	}
+
+	rc = crypto_aead_setkey(sw_ctx->aead_send, gcm_128_info->key,
+				TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+	if (rc)
+		goto free_aead;
+
+	rc = crypto_aead_setauthsize(sw_ctx->aead_send, ctx->tx.tag_size);
+	if (!rc)
+		goto out;
+
+free_aead:
+	crypto_free_aead(sw_ctx->aead_send);
+	sw_ctx->aead_send = NULL;
+free_rec_seq:
+	kfree(ctx->tx.rec_seq);
+	ctx->tx.rec_seq = NULL;
+free_iv:
+	kfree(ctx->tx.iv);
+	ctx->tx.iv = NULL;
+free_priv:
+	kfree(ctx->priv_ctx);
+	ctx->priv_ctx = NULL;
+out:
+	return rc;
+}
@@ -517,6 +517,8 @@ static unsigned int unix_dgram_poll(struct file *, struct socket *,
 static int unix_ioctl(struct socket *, unsigned int, unsigned long);
 static int unix_shutdown(struct socket *, int);
 static int unix_stream_sendmsg(struct socket *, struct msghdr *, size_t);
+static ssize_t unix_stream_sendpage(struct socket *, struct page *, int offset,
+				    size_t size, int flags);
 static int unix_stream_recvmsg(struct socket *, struct msghdr *, size_t, int);
 static int unix_dgram_sendmsg(struct socket *, struct msghdr *, size_t);
 static int unix_dgram_recvmsg(struct socket *, struct msghdr *, size_t, int);
@@ -558,7 +560,7 @@ static const struct proto_ops unix_stream_ops = {
 	.sendmsg =	unix_stream_sendmsg,
 	.recvmsg =	unix_stream_recvmsg,
 	.mmap =		sock_no_mmap,
-	.sendpage =	sock_no_sendpage,
+	.sendpage =	unix_stream_sendpage,
 	.set_peek_off =	unix_set_peek_off,
 };
 
@@ -1720,6 +1722,117 @@ out_err:
 	return sent ? : err;
 }
 
+/* Page data can only be glued onto an skb carrying the same credentials
+ * and no file descriptors, the reader never merges across those.
+ */
+static bool unix_skb_can_append(const struct sk_buff *skb,
+				const struct sock *sk, const struct pid *pid,
+				kuid_t uid, kgid_t gid)
+{
+	return skb && skb->sk == sk && !UNIXCB(skb).fp &&
+	       UNIXCB(skb).pid == pid &&
+	       uid_eq(UNIXCB(skb).uid, uid) && gid_eq(UNIXCB(skb).gid, gid);
+}
+
+/* splice() into a stream socket: pass a reference to the page to the peer
+ * instead of copying, growing the skb at the tail of its receive queue
+ * when possible so a stream of small splices does not cost an skb each.
+ */
+static ssize_t unix_stream_sendpage(struct socket *socket, struct page *page,
+				    int offset, size_t size, int flags)
+{
+	struct sock *other, *sk = socket->sk;
+	struct sk_buff *skb, *newskb = NULL;
+	struct pid *pid = task_tgid(current);
+	bool queue;
+	kuid_t uid;
+	kgid_t gid;
+	int err;
+
+	if (flags & MSG_OOB)
+		return -EOPNOTSUPP;
+
+	other = unix_peer(sk);
+	if (!other || sk->sk_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+
+	current_uid_gid(&uid, &gid);
+
+again:
+	/* the reader holds its readlock while it looks at skb->len, which
+	 * we are about to change on an skb it may already be consuming
+	 */
+	err = mutex_lock_interruptible(&unix_sk(other)->readlock);
+	if (err) {
+		err = flags & MSG_DONTWAIT ? -EAGAIN : -ERESTARTSYS;
+		goto out_free;
+	}
+
+	if (sk->sk_shutdown & SEND_SHUTDOWN)
+		goto pipe_err_readlock;
+
+	unix_state_lock(other);
+
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN))
+		goto pipe_err_unlock;
+
+	skb = skb_peek_tail(&other->sk_receive_queue);
+	if (unix_skb_can_append(skb, sk, pid, uid, gid) &&
+	    !skb_append_pagefrags(skb, page, offset, size)) {
+		queue = false;
+	} else if (newskb) {
+		skb = newskb;
+		newskb = NULL;
+		UNIXCB(skb).pid = get_pid(pid);
+		UNIXCB(skb).uid = uid;
+		UNIXCB(skb).gid = gid;
+		skb->destructor = unix_destruct_scm;
+		/* an empty skb always has room */
+		skb_append_pagefrags(skb, page, offset, size);
+		queue = true;
+	} else {
+		/* allocating may sleep, so drop the locks and start over */
+		unix_state_unlock(other);
+		mutex_unlock(&unix_sk(other)->readlock);
+
+		newskb = sock_alloc_send_pskb(sk, 0, 0, flags & MSG_DONTWAIT,
+					      &err, 0);
+		if (!newskb)
+			return err;
+		goto again;
+	}
+
+	skb->len += size;
+	skb->data_len += size;
+	skb->truesize += size;
+	atomic_add(size, &sk->sk_wmem_alloc);
+
+	if (queue)
+		skb_queue_tail(&other->sk_receive_queue, skb);
+
+	unix_state_unlock(other);
+	mutex_unlock(&unix_sk(other)->readlock);
+
+	other->sk_data_ready(other);
+
+	/* the tail became usable while we were allocating */
+	consume_skb(newskb);
+
+	return size;
+
+pipe_err_unlock:
+	unix_state_unlock(other);
+pipe_err_readlock:
+	mutex_unlock(&unix_sk(other)->readlock);
+	if (!(flags & MSG_NOSIGNAL))
+		send_sig(SIGPIPE, current, 0);
+	err = -EPIPE;
+out_free:
+	kfree_skb(newskb);
+	return err;
+}
+
 static int unix_seqpacket_sendmsg(struct socket *sock, struct msghdr *msg,
 				  size_t len)
 {
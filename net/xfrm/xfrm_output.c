@@ -38,6 +38,54 @@ static int xfrm_skb_check_space(struct sk_buff *skb)
 	return pskb_expand_head(skb, nhead, ntail, GFP_ATOMIC);
 }
 
+/* Make room for and add the outer header of @x */
+static int xfrm_output_prepare(struct xfrm_state *x, struct sk_buff *skb)
+{
+	struct net *net = xs_net(x);
+	int err;
+
+	err = xfrm_skb_check_space(skb);
+	if (err) {
+		XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTERROR);
+		return err;
+	}
+
+	err = x->outer_mode->output(x, skb);
+	if (err)
+		XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTSTATEMODEERROR);
+
+	return err;
+}
+
+/* Check @x is usable and charge @skb to it, called with x->lock held */
+static int xfrm_output_account(struct xfrm_state *x, struct sk_buff *skb)
+{
+	struct net *net = xs_net(x);
+	int err;
+
+	if (unlikely(x->km.state != XFRM_STATE_VALID)) {
+		XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTSTATEINVALID);
+		return -EINVAL;
+	}
+
+	err = xfrm_state_check_expire(x);
+	if (err) {
+		XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTSTATEEXPIRED);
+		return err;
+	}
+
+	err = x->repl->overflow(x, skb);
+	if (err) {
+		XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTSTATESEQERROR);
+		return err;
+	}
+
+	x->curlft.bytes += skb->len;
+	x->curlft.packets++;
+
+	return 0;
+}
+
 static int xfrm_output_one(struct sk_buff *skb, int err)
 {
 	struct dst_entry *dst = skb_dst(skb);
@@ -48,41 +96,14 @@ static int xfrm_output_one(struct sk_buff *skb, int err)
 		goto resume;
 
 	do {
-		err = xfrm_skb_check_space(skb);
-		if (err) {
-			XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTERROR);
-			goto error_nolock;
-		}
-
-		err = x->outer_mode->output(x, skb);
-		if (err) {
-			XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTSTATEMODEERROR);
+		err = xfrm_output_prepare(x, skb);
+		if (err)
 			goto error_nolock;
-		}
 
 		spin_lock_bh(&x->lock);
-
-		if (unlikely(x->km.state != XFRM_STATE_VALID)) {
-			XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTSTATEINVALID);
-			err = -EINVAL;
-			goto error;
-		}
-
-		err = xfrm_state_check_expire(x);
-		if (err) {
-			XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTSTATEEXPIRED);
-			goto error;
-		}
-
-		err = x->repl->overflow(x, skb);
-		if (err) {
-			XFRM_INC_STATS(net, LINUX_MIB_XFRMOUTSTATESEQERROR);
+		err = xfrm_output_account(x, skb);
+		if (err)
 			goto error;
-		}
-
-		x->curlft.bytes += skb->len;
-		x->curlft.packets++;
-
 		spin_unlock_bh(&x->lock);
 
 		skb_dst_force(skb);
@@ -149,9 +170,18 @@ static int xfrm_output2(struct sock *sk, struct sk_buff *skb)
 	return xfrm_output_resume(skb, 1);
 }
 
+/*
+ * The segments of a GSO packet all leave through the same first state.
+ * Add their outer headers, then check the state and hand out their
+ * sequence numbers in a single x->lock section rather than one per
+ * segment, before encrypting each and sending it down the rest of the
+ * bundle.
+ */
 static int xfrm_output_gso(struct sock *sk, struct sk_buff *skb)
 {
-	struct sk_buff *segs;
+	struct xfrm_state *x = skb_dst(skb)->xfrm;
+	struct sk_buff *segs, *seg, *end, *nskb, **pprev;
+	int err = 0;
 
 	segs = skb_gso_segment(skb, 0);
 	kfree_skb(skb);
@@ -160,22 +190,50 @@ static int xfrm_output_gso(struct sock *sk, struct sk_buff *skb)
 	if (segs == NULL)
 		return -EINVAL;
 
-	do {
-		struct sk_buff *nskb = segs->next;
-		int err;
+	for (end = segs; end; end = end->next) {
+		err = xfrm_output_prepare(x, end);
+		if (err)
+			break;
+	}
 
-		segs->next = NULL;
-		err = xfrm_output2(sk, segs);
+	spin_lock_bh(&x->lock);
+	for (seg = segs; seg != end; seg = seg->next) {
+		int ret = xfrm_output_account(x, seg);
 
-		if (unlikely(err)) {
-			kfree_skb_list(nskb);
-			return err;
+		if (ret) {
+			err = ret;
+			break;
 		}
+	}
+	spin_unlock_bh(&x->lock);
+
+	/* Drop what was not accounted, the earlier segments still go out */
+	if (seg) {
+		for (pprev = &segs; *pprev != seg; pprev = &(*pprev)->next)
+			;
+		*pprev = NULL;
+		kfree_skb_list(seg);
+	}
 
-		segs = nskb;
-	} while (segs);
+	for (seg = segs; seg; seg = nskb) {
+		int ret;
 
-	return 0;
+		nskb = seg->next;
+		seg->next = NULL;
+
+		skb_dst_force(seg);
+		ret = x->type->output(x, seg);
+		if (ret == -EINPROGRESS)
+			continue;
+
+		ret = xfrm_output_resume(seg, ret);
+		if (unlikely(ret)) {
+			kfree_skb_list(nskb);
+			return ret;
+		}
+	}
+
+	return err;
 }
 
 int xfrm_output(struct sock *sk, struct sk_buff *skb)
@@ -0,0 +1,105 @@
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#include <uapi/linux/bpf.h>
+#include <uapi/linux/perf_event.h>
+#include <linux/version.h>
+#include <linux/sched.h>
+#include "bpf_helpers.h"
+
+#define KERN_STACKID_FLAGS (0 | BPF_F_FAST_STACK_CMP)
+#define USER_STACKID_FLAGS (0 | BPF_F_FAST_STACK_CMP | BPF_F_USER_STACK)
+
+struct key_t {
+	char comm[TASK_COMM_LEN];
+	int kernstack;
+	int userstack;
+};
+
+struct start_t {
+	u64 ts;
+	struct key_t key;
+};
+
+/* off-cpu usecs per (comm, kernel stack, user stack) */
+struct bpf_map_def SEC("maps") counts = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(struct key_t),
+	.value_size = sizeof(u64),
+	.max_entries = 10000,
+};
+
+/* when and where a task went off-cpu, by pid */
+struct bpf_map_def SEC("maps") start = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(u32),
+	.value_size = sizeof(struct start_t),
+	.max_entries = 10000,
+};
+
+struct bpf_map_def SEC("maps") stackmap = {
+	.type = BPF_MAP_TYPE_STACK_TRACE,
+	.key_size = sizeof(u32),
+	.value_size = PERF_MAX_STACK_DEPTH * sizeof(u64),
+	.max_entries = 10000,
+};
+
+/* taken from /sys/kernel/debug/tracing/events/sched/sched_switch/format,
+ * the first 8 bytes (common fields) can not be accessed by the program
+ */
+struct sched_switch_args {
+	unsigned long long pad;
+	char prev_comm[TASK_COMM_LEN];
+	int prev_pid;
+	int prev_prio;
+	long long prev_state;
+	char next_comm[TASK_COMM_LEN];
+	int next_pid;
+	int next_prio;
+};
+
+/* the tracepoint runs in the context of prev, so the stacks are prev's */
+SEC("tracepoint/sched/sched_switch")
+int oncpu(struct sched_switch_args *ctx)
+{
+	struct start_t s = {};
+	struct start_t *sp;
+	u64 delta, zero = 0, *val;
+	u32 pid = ctx->prev_pid;
+
+	/* remember when and why the previous task went off-cpu */
+	if (pid) {
+		__builtin_memcpy(&s.key.comm, ctx->prev_comm,
+				 sizeof(s.key.comm));
+		s.key.kernstack = bpf_get_stackid(ctx, &stackmap,
+						  KERN_STACKID_FLAGS);
+		s.key.userstack = bpf_get_stackid(ctx, &stackmap,
+						  USER_STACKID_FLAGS);
+		s.ts = bpf_ktime_get_ns();
+		bpf_map_update_elem(&start, &pid, &s, BPF_ANY);
+	}
+
+	/* and charge the next one for the time it was off-cpu */
+	pid = ctx->next_pid;
+	sp = bpf_map_lookup_elem(&start, &pid);
+	if (!sp)
+		return 0;
+
+	delta = (bpf_ktime_get_ns() - sp->ts) / 1000;
+	s.key = sp->key;
+	bpf_map_delete_elem(&start, &pid);
+
+	val = bpf_map_lookup_elem(&counts, &s.key);
+	if (!val) {
+		bpf_map_update_elem(&counts, &s.key, &zero, BPF_NOEXIST);
+		val = bpf_map_lookup_elem(&counts, &s.key);
+		if (!val)
+			return 0;
+	}
+	__sync_fetch_and_add(val, delta);
+
+	return 0;
+}
+char _license[] SEC("license") = "GPL";
+u32 _version SEC("version") = LINUX_VERSION_CODE;
@@ -0,0 +1,181 @@
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * Print where tasks blocked and for how long, as aggregated in the
+ * kernel by offcputime_kern.c, every few seconds.  The output is one
+ * folded stack per line, "comm;user frames;kernel frames usecs", as
+ * flame graph tools expect; user frames are left as raw addresses.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <linux/bpf.h>
+#include <linux/perf_event.h>
+#include "libbpf.h"
+#include "bpf_load.h"
+
+#define MAX_SYMS 300000
+
+struct ksym {
+	long addr;
+	char *name;
+};
+
+static struct ksym syms[MAX_SYMS];
+static int sym_cnt;
+
+struct key_t {
+	char comm[16];
+	int kernstack;
+	int userstack;
+};
+
+static int ksym_cmp(const void *p1, const void *p2)
+{
+	return ((struct ksym *)p1)->addr - ((struct ksym *)p2)->addr;
+}
+
+static int load_kallsyms(void)
+{
+	FILE *f = fopen("/proc/kallsyms", "r");
+	char func[256], buf[256];
+	char symbol;
+	void *addr;
+
+	if (!f)
+		return -ENOENT;
+
+	while (sym_cnt < MAX_SYMS && fgets(buf, sizeof(buf), f)) {
+		if (sscanf(buf, "%p %c %255s", &addr, &symbol, func) != 3)
+			continue;
+		if (!addr)
+			continue;
+		syms[sym_cnt].addr = (long) addr;
+		syms[sym_cnt].name = strdup(func);
+		sym_cnt++;
+	}
+	fclose(f);
+
+	qsort(syms, sym_cnt, sizeof(struct ksym), ksym_cmp);
+	return 0;
+}
+
+static struct ksym *ksym_search(long key)
+{
+	int start = 0, end = sym_cnt;
+
+	/* kallsyms not loaded, or below the first symbol */
+	if (!sym_cnt || key < syms[0].addr)
+		return NULL;
+
+	while (start < end) {
+		size_t mid = start + (end - start) / 2;
+
+		if (key < syms[mid].addr)
+			end = mid;
+		else if (key > syms[mid].addr)
+			start = mid + 1;
+		else
+			return &syms[mid];
+	}
+
+	return &syms[start - 1];
+}
+
+static void print_stack(int stack_id, int fd, bool kernel)
+{
+	__u64 ip[PERF_MAX_STACK_DEPTH] = {};
+	struct ksym *sym;
+	int i;
+
+	if (stack_id < 0) {
+		/* e.g. -EFAULT for the user stack of a kernel thread */
+		printf(";[%s stack missing]", kernel ? "kernel" : "user");
+		return;
+	}
+
+	if (bpf_lookup_elem(fd, &stack_id, ip) != 0) {
+		printf(";[%s stack lost]", kernel ? "kernel" : "user");
+		return;
+	}
+
+	/* outermost frame first */
+	for (i = PERF_MAX_STACK_DEPTH - 1; i >= 0; i--) {
+		if (!ip[i])
+			continue;
+		sym = kernel ? ksym_search(ip[i]) : NULL;
+		if (sym)
+			printf(";%s", sym->name);
+		else
+			printf(";0x%llx", ip[i]);
+	}
+}
+
+/* print and reset what the kernel collected since the last call */
+static void print_counts(int counts_fd, int stack_fd)
+{
+	struct key_t key = {}, next_key;
+	__u64 value;
+
+	while (bpf_get_next_key(counts_fd, &key, &next_key) == 0) {
+		key = next_key;
+		if (bpf_lookup_elem(counts_fd, &key, &value) != 0)
+			continue;
+
+		printf("%.16s", key.comm);
+		print_stack(key.userstack, stack_fd, false);
+		print_stack(key.kernstack, stack_fd, true);
+		printf(" %lld\n", value);
+	}
+
+	/* start the next period from scratch */
+	memset(&key, 0, sizeof(key));
+	while (bpf_get_next_key(counts_fd, &key, &next_key) == 0)
+		bpf_delete_elem(counts_fd, &next_key);
+	fflush(stdout);
+}
+
+static void int_exit(int sig)
+{
+	print_counts(map_fd[0], map_fd[2]);
+	exit(0);
+}
+
+int main(int argc, char **argv)
+{
+	char filename[256];
+	int interval = 5;
+
+	snprintf(filename, sizeof(filename), "%s_kern.o", argv[0]);
+
+	if (argc > 1)
+		interval = atoi(argv[1]);
+	if (interval <= 0) {
+		printf("usage: %s [interval in seconds]\n", argv[0]);
+		return 1;
+	}
+
+	if (load_kallsyms()) {
+		printf("failed to process /proc/kallsyms\n");
+		return 2;
+	}
+
+	if (load_bpf_file(filename)) {
+		printf("%s", bpf_log_buf);
+		return 1;
+	}
+
+	signal(SIGINT, int_exit);
+
+	for (;;) {
+		sleep(interval);
+		print_counts(map_fd[0], map_fd[2]);
+	}
+
+	return 0;
+}
@@ -22,6 +22,8 @@
 #include <linux/init.h>
 #include <linux/skbuff.h>
 #include <linux/percpu.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
 #include <net/sock.h>
 #include <linux/un.h>
 #include <net/af_unix.h>
@@ -34,6 +36,7 @@
 #include "classmap.h"
 
 #define AVC_CACHE_SLOTS			512
+#define AVC_MAX_CACHE_SLOTS		65536
 #define AVC_DEF_CACHE_THRESHOLD		512
 #define AVC_CACHE_RECLAIM		16
 
@@ -57,8 +60,9 @@ struct avc_node {
 };
 
 struct avc_cache {
-	struct hlist_head	slots[AVC_CACHE_SLOTS]; /* head for avc_node->list */
-	spinlock_t		slots_lock[AVC_CACHE_SLOTS]; /* lock for writes */
+	struct hlist_head	*slots; /* head for avc_node->list */
+	spinlock_t		*slots_lock; /* lock for writes */
+	unsigned int		nr_slots;	/* power of two */
 	atomic_t		lru_hint;	/* LRU hint for reclaim scan */
 	atomic_t		active_nodes;
 	u32			latest_notif;	/* latest revocation notification */
@@ -81,9 +85,30 @@ static struct avc_cache avc_cache;
 static struct avc_callback_node *avc_callbacks;
 static struct kmem_cache *avc_node_cachep;
 
+/*
+ * Number of hash slots, set with selinux_avc_slots= for hosts with many
+ * distinct contexts.  The default cache threshold follows it.
+ */
+static unsigned int avc_cache_slots __initdata = AVC_CACHE_SLOTS;
+
+static int __init avc_cache_slots_setup(char *str)
+{
+	unsigned long slots;
+
+	if (!kstrtoul(str, 0, &slots) && slots) {
+		slots = clamp_t(unsigned long, slots, AVC_CACHE_SLOTS,
+				AVC_MAX_CACHE_SLOTS);
+		avc_cache_slots = roundup_pow_of_two(slots);
+		avc_cache_threshold = avc_cache_slots;
+	}
+	return 1;
+}
+__setup("selinux_avc_slots=", avc_cache_slots_setup);
+
 static inline int avc_hash(u32 ssid, u32 tsid, u16 tclass)
 {
-	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (AVC_CACHE_SLOTS - 1);
+	/* SIDs are allocated sequentially, so mix them well */
+	return jhash_3words(ssid, tsid, tclass, 0) & (avc_cache.nr_slots - 1);
 }
 
 /**
@@ -162,7 +187,17 @@ void __init avc_init(void)
 {
 	int i;
 
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	avc_cache.nr_slots = avc_cache_slots;
+	avc_cache.slots = kcalloc(avc_cache.nr_slots, sizeof(*avc_cache.slots),
+				  GFP_KERNEL);
+	avc_cache.slots_lock = kcalloc(avc_cache.nr_slots,
+				       sizeof(*avc_cache.slots_lock),
+				       GFP_KERNEL);
+	if (!avc_cache.slots || !avc_cache.slots_lock)
+		panic("SELinux: unable to allocate %u AVC slots\n",
+		      avc_cache.nr_slots);
+
+	for (i = 0; i < avc_cache.nr_slots; i++) {
 		INIT_HLIST_HEAD(&avc_cache.slots[i]);
 		spin_lock_init(&avc_cache.slots_lock[i]);
 	}
@@ -185,7 +220,7 @@ int avc_get_hash_stats(char *page)
 
 	slots_used = 0;
 	max_chain_len = 0;
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	for (i = 0; i < avc_cache.nr_slots; i++) {
 		head = &avc_cache.slots[i];
 		if (!hlist_empty(head)) {
 			slots_used++;
@@ -202,7 +237,7 @@ int avc_get_hash_stats(char *page)
 	return scnprintf(page, PAGE_SIZE, "entries: %d\nbuckets used: %d/%d\n"
 			 "longest chain: %d\n",
 			 atomic_read(&avc_cache.active_nodes),
-			 slots_used, AVC_CACHE_SLOTS, max_chain_len);
+			 slots_used, avc_cache.nr_slots, max_chain_len);
 }
 
 static void avc_node_free(struct rcu_head *rhead)
@@ -241,8 +276,9 @@ static inline int avc_reclaim_node(void)
 	struct hlist_head *head;
 	spinlock_t *lock;
 
-	for (try = 0, ecx = 0; try < AVC_CACHE_SLOTS; try++) {
-		hvalue = atomic_inc_return(&avc_cache.lru_hint) & (AVC_CACHE_SLOTS - 1);
+	for (try = 0, ecx = 0; try < avc_cache.nr_slots; try++) {
+		hvalue = atomic_inc_return(&avc_cache.lru_hint) &
+			 (avc_cache.nr_slots - 1);
 		head = &avc_cache.slots[hvalue];
 		lock = &avc_cache.slots_lock[hvalue];
 
@@ -613,7 +649,7 @@ static void avc_flush(void)
 	unsigned long flag;
 	int i;
 
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	for (i = 0; i < avc_cache.nr_slots; i++) {
 		head = &avc_cache.slots[i];
 		lock = &avc_cache.slots_lock[i];
 
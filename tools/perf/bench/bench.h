@@ -34,6 +34,11 @@ extern int bench_mem_memset(int argc, const char **argv, const char *prefix);
 extern int bench_futex_hash(int argc, const char **argv, const char *prefix);
 extern int bench_futex_wake(int argc, const char **argv, const char *prefix);
 extern int bench_futex_requeue(int argc, const char **argv, const char *prefix);
+extern int bench_futex_lock_pi(int argc, const char **argv, const char *prefix);
+extern int bench_epoll_wait(int argc, const char **argv, const char *prefix);
+extern int bench_epoll_ctl(int argc, const char **argv, const char *prefix);
+extern int bench_io_submit(int argc, const char **argv, const char *prefix);
+extern int bench_net_pingpong(int argc, const char **argv, const char *prefix);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
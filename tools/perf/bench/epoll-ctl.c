@@ -0,0 +1,292 @@
+/*
+ * epoll-ctl: Measure the cost of epoll_ctl(2) add/modify/delete.
+ *
+ * Every thread repeatedly adds, modifies and removes its set of
+ * eventfds on its own epoll instance, or with --shared on a single
+ * instance used by all threads, where the ep->mtx and the rbtree in
+ * fs/eventpoll.c become the bottleneck.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "../util/cpumap.h"
+#include "bench.h"
+
+#include <err.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+
+struct worker {
+	int tid;
+	int epollfd;
+	int *fds;
+	pthread_t thread;
+	unsigned long ops[3];
+};
+
+enum {
+	OP_EPOLL_ADD,
+	OP_EPOLL_MOD,
+	OP_EPOLL_DEL,
+};
+
+static const char * const op_names[] = {
+	[OP_EPOLL_ADD]	= "add",
+	[OP_EPOLL_MOD]	= "mod",
+	[OP_EPOLL_DEL]	= "del",
+};
+
+static struct worker *worker;
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* amount of fds per thread */
+static unsigned int nfds     = 64;
+static bool shared = false, silent = false;
+static volatile bool done = false;
+static const char *cpu_list;
+static struct cpu_map *cpus;
+static struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats op_stats[3];
+static pthread_cond_t thread_parent, thread_worker;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('f', "nfds",    &nfds,     "Specify amount of file descriptors per thread"),
+	OPT_BOOLEAN( 'S', "shared",  &shared,   "Use a single epoll instance for all threads"),
+	OPT_STRING(  'C', "cpu",     &cpu_list, "cpu", "List of cpus to pin threads to"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_ctl_usage[] = {
+	"perf bench epoll ctl <options>",
+	NULL
+};
+
+static void do_epoll_op(struct worker *w, int op, int fd)
+{
+	struct epoll_event ev;
+	int ctl;
+
+	switch (op) {
+	case OP_EPOLL_ADD:
+		ctl = EPOLL_CTL_ADD;
+		ev.events = EPOLLIN;
+		break;
+	case OP_EPOLL_MOD:
+		ctl = EPOLL_CTL_MOD;
+		ev.events = EPOLLIN | EPOLLOUT;
+		break;
+	default:
+		ctl = EPOLL_CTL_DEL;
+		break;
+	}
+
+	ev.data.fd = fd;
+	if (epoll_ctl(w->epollfd, ctl, fd, &ev))
+		err(EXIT_FAILURE, "epoll_ctl(%s)", op_names[op]);
+
+	w->ops[op]++;
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned int i, op;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		for (op = OP_EPOLL_ADD; op <= OP_EPOLL_DEL; op++)
+			for (i = 0; i < nfds; i++)
+				do_epoll_op(w, op, w->fds[i]);
+	} while (!done);
+
+	return NULL;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg[3];
+	double stddev[3];
+	int op;
+
+	for (op = OP_EPOLL_ADD; op <= OP_EPOLL_DEL; op++) {
+		avg[op] = avg_stats(&op_stats[op]);
+		stddev[op] = stddev_stats(&op_stats[op]);
+	}
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		for (op = OP_EPOLL_ADD; op <= OP_EPOLL_DEL; op++)
+			printf("%s%lu %.2f", op ? " " : "", avg[op],
+			       rel_stddev_stats(stddev[op], avg[op]));
+		printf("\n");
+		return;
+	}
+
+	printf("%s", !silent ? "\n" : "");
+	for (op = OP_EPOLL_ADD; op <= OP_EPOLL_DEL; op++)
+		printf("Averaged %ld %s operations/sec (+- %.2f%%), total secs = %d\n",
+		       avg[op], op_names[op],
+		       rel_stddev_stats(stddev[op], avg[op]),
+		       (int) runtime.tv_sec);
+}
+
+int bench_epoll_ctl(int argc, const char **argv,
+		    const char *prefix __maybe_unused)
+{
+	int ret = 0, epollfd = -1;
+	cpu_set_t cpu;
+	struct sigaction act;
+	unsigned int i, j, op;
+	pthread_attr_t thread_attr;
+
+	argc = parse_options(argc, argv, options, bench_epoll_ctl_usage, 0);
+	if (argc || !nfds) {
+		usage_with_options(bench_epoll_ctl_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpus = cpu_map__new(cpu_list);
+	if (!cpus)
+		errx(EXIT_FAILURE, "invalid cpu list: %s", cpu_list);
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = cpus->nr;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("Run summary [PID %d]: %d threads doing epoll_ctl ops on %d eventfds each, %s epoll instance%s, for %d secs.\n\n",
+		       getpid(), nthreads, nfds,
+		       shared ? "one shared" : "a private", shared ? "" : " each",
+		       nsecs);
+
+	if (shared) {
+		epollfd = epoll_create1(0);
+		if (epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		if (!shared) {
+			epollfd = epoll_create1(0);
+			if (epollfd < 0)
+				err(EXIT_FAILURE, "epoll_create1");
+		}
+		worker[i].epollfd = epollfd;
+
+		worker[i].fds = calloc(nfds, sizeof(int));
+		if (!worker[i].fds)
+			err(EXIT_FAILURE, "calloc");
+
+		for (j = 0; j < nfds; j++) {
+			worker[i].fds[j] = eventfd(0, EFD_NONBLOCK);
+			if (worker[i].fds[j] < 0)
+				err(EXIT_FAILURE, "eventfd");
+		}
+	}
+
+	for (op = OP_EPOLL_ADD; op <= OP_EPOLL_DEL; op++)
+		init_stats(&op_stats[op]);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		CPU_ZERO(&cpu);
+		CPU_SET(cpus->map[i % cpus->nr], &cpu);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	gettimeofday(&start, NULL);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t[3];
+
+		for (op = OP_EPOLL_ADD; op <= OP_EPOLL_DEL; op++) {
+			t[op] = worker[i].ops[op] / runtime.tv_sec;
+			update_stats(&op_stats[op], t[op]);
+		}
+
+		if (!silent && bench_format == BENCH_FORMAT_DEFAULT)
+			printf("[thread %3d] fds: %d ... %d [ add: %ld mod: %ld del: %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].fds[0],
+			       worker[i].fds[nfds - 1],
+			       t[OP_EPOLL_ADD], t[OP_EPOLL_MOD], t[OP_EPOLL_DEL]);
+
+		for (j = 0; j < nfds; j++)
+			close(worker[i].fds[j]);
+		free(worker[i].fds);
+		if (!shared)
+			close(worker[i].epollfd);
+	}
+	if (shared)
+		close(epollfd);
+
+	print_summary();
+
+	free(worker);
+	cpu_map__delete(cpus);
+	return ret;
+}
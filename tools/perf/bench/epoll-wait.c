@@ -0,0 +1,301 @@
+/*
+ * epoll-wait: Measure how fast events are delivered through epoll_wait(2).
+ *
+ * Every worker thread waits on its own epoll instance, which watches a
+ * set of eventfds, while a single writer thread keeps making those fds
+ * readable.  Each event a worker receives and consumes counts as one
+ * operation.  With --shared all the workers wait on one epoll instance
+ * instead, which is what shows contention on the ep->lock and the
+ * wakeup path in fs/eventpoll.c.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "../util/cpumap.h"
+#include "bench.h"
+
+#include <err.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+
+struct worker {
+	int tid;
+	int epollfd;
+	int *fds;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static struct worker *worker;
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 8;
+/* amount of fds per thread */
+static unsigned int nfds     = 64;
+static bool shared = false, edge = false, silent = false;
+static volatile bool done = false;
+static const char *cpu_list;
+static struct cpu_map *cpus;
+static struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('f', "nfds",    &nfds,     "Specify amount of file descriptors per thread"),
+	OPT_BOOLEAN( 'S', "shared",  &shared,   "Use a single epoll instance for all threads"),
+	OPT_BOOLEAN( 'E', "edge",    &edge,     "Use edge-triggered events"),
+	OPT_STRING(  'C', "cpu",     &cpu_list, "cpu", "List of cpus to pin threads to"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_wait_usage[] = {
+	"perf bench epoll wait <options>",
+	NULL
+};
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	struct epoll_event *events;
+	u_int64_t val;
+	int i, n;
+
+	events = calloc(nfds, sizeof(*events));
+	if (!events)
+		err(EXIT_FAILURE, "calloc");
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		/* time out now and then so we notice when we're done */
+		n = epoll_wait(w->epollfd, events, nfds, 100);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "epoll_wait");
+		}
+
+		for (i = 0; i < n; i++) {
+			/*
+			 * Another waiter on a shared instance may have
+			 * consumed it already, don't count that.
+			 */
+			if (read(events[i].data.fd, &val, sizeof(val)) == sizeof(val))
+				w->ops++;
+		}
+	} while (!done);
+
+	free(events);
+	return NULL;
+}
+
+static void *writerfn(void *arg __maybe_unused)
+{
+	u_int64_t val = 1;
+	unsigned int i, j;
+	ssize_t sz;
+
+	while (!done) {
+		for (i = 0; i < nthreads && !done; i++) {
+			for (j = 0; j < nfds; j++) {
+				sz = write(worker[i].fds[j], &val, sizeof(val));
+				if (sz != sizeof(val) && errno != EAGAIN)
+					err(EXIT_FAILURE, "write");
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void setup_worker_fds(struct worker *w, int epollfd)
+{
+	struct epoll_event ev;
+	unsigned int i;
+
+	w->epollfd = epollfd;
+	w->fds = calloc(nfds, sizeof(int));
+	if (!w->fds)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < nfds; i++) {
+		w->fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (w->fds[i] < 0)
+			err(EXIT_FAILURE, "eventfd");
+
+		ev.events = EPOLLIN;
+		if (edge)
+			ev.events |= EPOLLET;
+		ev.data.fd = w->fds[i];
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, w->fds[i], &ev))
+			err(EXIT_FAILURE, "epoll_ctl");
+	}
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		printf("%lu %.2f\n", avg, rel_stddev_stats(stddev, avg));
+		return;
+	}
+
+	printf("%sAveraged %ld events/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_epoll_wait(int argc, const char **argv,
+		     const char *prefix __maybe_unused)
+{
+	int ret = 0, epollfd = -1;
+	cpu_set_t cpu;
+	struct sigaction act;
+	unsigned int i, j;
+	pthread_attr_t thread_attr;
+	pthread_t writer;
+
+	argc = parse_options(argc, argv, options, bench_epoll_wait_usage, 0);
+	if (argc || !nfds) {
+		usage_with_options(bench_epoll_wait_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpus = cpu_map__new(cpu_list);
+	if (!cpus)
+		errx(EXIT_FAILURE, "invalid cpu list: %s", cpu_list);
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = cpus->nr;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("Run summary [PID %d]: %d threads waiting on %d%s eventfds each, %s epoll instance%s, for %d secs.\n\n",
+		       getpid(), nthreads, nfds, edge ? " edge-triggered" : "",
+		       shared ? "one shared" : "a private", shared ? "" : " each",
+		       nsecs);
+
+	if (shared) {
+		epollfd = epoll_create1(0);
+		if (epollfd < 0)
+			err(EXIT_FAILURE, "epoll_create1");
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		if (!shared) {
+			epollfd = epoll_create1(0);
+			if (epollfd < 0)
+				err(EXIT_FAILURE, "epoll_create1");
+		}
+		setup_worker_fds(&worker[i], epollfd);
+	}
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		CPU_ZERO(&cpu);
+		CPU_SET(cpus->map[i % cpus->nr], &cpu);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	gettimeofday(&start, NULL);
+	ret = pthread_create(&writer, NULL, writerfn, NULL);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_create");
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	ret = pthread_join(writer, NULL);
+	if (ret)
+		err(EXIT_FAILURE, "pthread_join");
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops/runtime.tv_sec;
+
+		update_stats(&throughput_stats, t);
+		if (!silent && bench_format == BENCH_FORMAT_DEFAULT)
+			printf("[thread %3d] fds: %d ... %d [ %ld events/sec ]\n",
+			       worker[i].tid, worker[i].fds[0],
+			       worker[i].fds[nfds - 1], t);
+
+		for (j = 0; j < nfds; j++)
+			close(worker[i].fds[j]);
+		free(worker[i].fds);
+		if (!shared)
+			close(worker[i].epollfd);
+	}
+	if (shared)
+		close(epollfd);
+
+	print_summary();
+
+	free(worker);
+	cpu_map__delete(cpus);
+	return ret;
+}
@@ -0,0 +1,366 @@
+/*
+ * io-submit: Measure native AIO submission and completion rates.
+ *
+ * Every thread sets up its own AIO context and keeps --depth O_DIRECT
+ * reads of --bs bytes in flight against the given block device, at
+ * random offsets, submitting and reaping them in batches.  Pointed at
+ * a null_blk device (modprobe null_blk, the default is /dev/nullb0)
+ * there is no media cost, so what is measured is fs/aio.c, the block
+ * layer and blk-mq queueing and completion.
+ *
+ * The io_*() syscalls are called directly, there is no dependency on
+ * libaio.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "../util/cpumap.h"
+#include "bench.h"
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+#include <linux/fs.h>
+#include <pthread.h>
+
+struct worker {
+	int tid;
+	int fd;
+	aio_context_t ctx;
+	struct iocb *iocbs;
+	struct iocb **iocbps;
+	struct io_event *events;
+	void *buf;
+	unsigned int seed;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static struct worker *worker;
+static unsigned int nthreads = 1;
+static unsigned int nsecs    = 8;
+static unsigned int depth    = 32;
+static unsigned int batch    = 8;
+static unsigned int bs       = 4096;
+static const char *path      = "/dev/nullb0";
+static bool silent = false;
+static volatile bool done = false;
+static u64 nr_blocks;
+static const char *cpu_list;
+static struct cpu_map *cpus;
+static struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+static const struct option options[] = {
+	OPT_STRING(  'd', "device",  &path,     "path", "Block device to read from"),
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('q', "depth",   &depth,    "Specify amount of I/Os in flight per thread"),
+	OPT_UINTEGER('b', "batch",   &batch,    "Specify amount of I/Os per io_submit() call"),
+	OPT_UINTEGER('B', "bs",      &bs,       "Specify block size (in bytes)"),
+	OPT_STRING(  'C', "cpu",     &cpu_list, "cpu", "List of cpus to pin threads to"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_io_submit_usage[] = {
+	"perf bench io submit <options>",
+	NULL
+};
+
+static inline int io_setup(unsigned int nr, aio_context_t *ctxp)
+{
+	return syscall(__NR_io_setup, nr, ctxp);
+}
+
+static inline int io_destroy(aio_context_t ctx)
+{
+	return syscall(__NR_io_destroy, ctx);
+}
+
+static inline int io_submit(aio_context_t ctx, long nr, struct iocb **iocbpp)
+{
+	return syscall(__NR_io_submit, ctx, nr, iocbpp);
+}
+
+static inline int io_getevents(aio_context_t ctx, long min_nr, long max_nr,
+			       struct io_event *events, struct timespec *timeout)
+{
+	return syscall(__NR_io_getevents, ctx, min_nr, max_nr, events, timeout);
+}
+
+static void prep_read(struct worker *w, struct iocb *iocb, unsigned int slot)
+{
+	u64 block = ((u64)rand_r(&w->seed) << 31 | rand_r(&w->seed)) % nr_blocks;
+
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->aio_fildes = w->fd;
+	iocb->aio_lio_opcode = IOCB_CMD_PREAD;
+	iocb->aio_buf = (u64)(unsigned long)(w->buf + (size_t)slot * bs);
+	iocb->aio_nbytes = bs;
+	iocb->aio_offset = block * bs;
+	iocb->aio_data = slot;
+}
+
+/* submit up to @nr of the free slots in @slots, returns how many went in */
+static unsigned int submit_reads(struct worker *w, unsigned int *slots,
+				 unsigned int nr)
+{
+	unsigned int i, submitted = 0;
+	int ret;
+
+	for (i = 0; i < nr; i++) {
+		prep_read(w, &w->iocbs[slots[i]], slots[i]);
+		w->iocbps[i] = &w->iocbs[slots[i]];
+	}
+
+	while (submitted < nr) {
+		ret = io_submit(w->ctx, nr - submitted, w->iocbps + submitted);
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				break;
+			err(EXIT_FAILURE, "io_submit");
+		}
+		submitted += ret;
+	}
+
+	return submitted;
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	struct timespec timeout = { .tv_sec = 0, .tv_nsec = 100000000 };
+	unsigned int *free_slots, nr_free, i, n;
+	int ret;
+
+	free_slots = calloc(depth, sizeof(*free_slots));
+	if (!free_slots)
+		err(EXIT_FAILURE, "calloc");
+	for (i = 0; i < depth; i++)
+		free_slots[i] = i;
+	nr_free = depth;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		/* refill the queue, batch at a time */
+		while (nr_free) {
+			n = min(nr_free, batch);
+			n = submit_reads(w, free_slots + nr_free - n, n);
+			if (!n)
+				break;
+			nr_free -= n;
+		}
+
+		ret = io_getevents(w->ctx, 1, depth, w->events, &timeout);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "io_getevents");
+		}
+
+		for (i = 0; i < (unsigned int)ret; i++) {
+			if ((long)w->events[i].res != (long)bs && !silent)
+				warnx("thread %d: read returned %lld", w->tid,
+				      (long long)w->events[i].res);
+			free_slots[nr_free++] = w->events[i].data;
+			w->ops++;
+		}
+	} while (!done);
+
+	/* let whatever is still in flight finish before tearing down */
+	while (nr_free < depth) {
+		ret = io_getevents(w->ctx, 1, depth, w->events, NULL);
+		if (ret < 0 && errno != EINTR)
+			err(EXIT_FAILURE, "io_getevents");
+		if (ret > 0)
+			nr_free += ret;
+	}
+
+	free(free_slots);
+	return NULL;
+}
+
+static void setup_worker(struct worker *w)
+{
+	w->fd = open(path, O_RDONLY | O_DIRECT);
+	if (w->fd < 0)
+		err(EXIT_FAILURE, "open %s", path);
+
+	if (io_setup(depth, &w->ctx))
+		err(EXIT_FAILURE, "io_setup");
+
+	w->iocbs = calloc(depth, sizeof(*w->iocbs));
+	w->iocbps = calloc(depth, sizeof(*w->iocbps));
+	w->events = calloc(depth, sizeof(*w->events));
+	if (!w->iocbs || !w->iocbps || !w->events)
+		err(EXIT_FAILURE, "calloc");
+
+	/* O_DIRECT wants aligned buffers */
+	if (posix_memalign(&w->buf, page_size, (size_t)depth * bs))
+		err(EXIT_FAILURE, "posix_memalign");
+
+	w->seed = w->tid + 1;
+}
+
+static void cleanup_worker(struct worker *w)
+{
+	io_destroy(w->ctx);
+	close(w->fd);
+	free(w->iocbs);
+	free(w->iocbps);
+	free(w->events);
+	free(w->buf);
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+	double total = avg * nthreads;
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		printf("%.0f %lu %.2f\n", total, avg,
+		       rel_stddev_stats(stddev, avg));
+		return;
+	}
+
+	printf("%sTotal %.0f IOPS, %.2f MB/sec\n", !silent ? "\n" : "",
+	       total, total * bs / (1024 * 1024));
+	printf("Averaged %ld IOPS/thread (+- %.2f%%), total secs = %d\n",
+	       avg, rel_stddev_stats(stddev, avg), (int) runtime.tv_sec);
+}
+
+int bench_io_submit(int argc, const char **argv,
+		    const char *prefix __maybe_unused)
+{
+	int ret = 0, fd;
+	u64 size;
+	cpu_set_t cpu;
+	struct sigaction act;
+	unsigned int i;
+	pthread_attr_t thread_attr;
+
+	argc = parse_options(argc, argv, options, bench_io_submit_usage, 0);
+	if (argc || !depth || !batch || !bs || bs % 512) {
+		usage_with_options(bench_io_submit_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpus = cpu_map__new(cpu_list);
+	if (!cpus)
+		errx(EXIT_FAILURE, "invalid cpu list: %s", cpu_list);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		err(EXIT_FAILURE, "open %s", path);
+	if (ioctl(fd, BLKGETSIZE64, &size))
+		err(EXIT_FAILURE, "BLKGETSIZE64 on %s", path);
+	close(fd);
+
+	nr_blocks = size / bs;
+	if (!nr_blocks)
+		errx(EXIT_FAILURE, "%s is smaller than one block", path);
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("Run summary [PID %d]: %d threads reading %d bytes from %s, qd %d, batch %d, for %d secs.\n\n",
+		       getpid(), nthreads, bs, path, depth, batch, nsecs);
+
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		setup_worker(&worker[i]);
+	}
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		CPU_ZERO(&cpu);
+		CPU_SET(cpus->map[i % cpus->nr], &cpu);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	gettimeofday(&start, NULL);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops/runtime.tv_sec;
+
+		update_stats(&throughput_stats, t);
+		if (!silent && bench_format == BENCH_FORMAT_DEFAULT)
+			printf("[thread %3d] %s [ %ld IOPS ]\n",
+			       worker[i].tid, path, t);
+
+		cleanup_worker(&worker[i]);
+	}
+
+	print_summary();
+
+	free(worker);
+	cpu_map__delete(cpus);
+	return ret;
+}
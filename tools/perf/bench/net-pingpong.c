@@ -0,0 +1,384 @@
+/*
+ * net-pingpong: Measure TCP or UDP round trips over the loopback device.
+ *
+ * Each pair of threads has a client sending a --size byte message to
+ * its server, which echoes it straight back, one message in flight at
+ * a time.  The round trip rate is then mostly the cost of the socket
+ * send and receive paths, the loopback device and the wakeups, with
+ * no NIC involved.  Use --cpu to place the two ends of each pair on
+ * the same or on different cpus or nodes.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "../util/cpumap.h"
+#include "bench.h"
+
+#include <err.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+
+struct pair {
+	int id;
+	int server_fd;
+	int client_fd;
+	pthread_t server;
+	pthread_t client;
+	unsigned long ops;
+};
+
+static struct pair *pairs;
+static unsigned int npairs = 1;
+static unsigned int nsecs  = 8;
+static unsigned int msg_size = 1;
+static bool udp = false, silent = false;
+static volatile bool done = false;
+static const char *cpu_list;
+static struct cpu_map *cpus;
+static struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+static const struct option options[] = {
+	OPT_UINTEGER('p', "pairs",   &npairs,   "Specify amount of client/server pairs"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('m', "size",    &msg_size, "Specify message size (in bytes)"),
+	OPT_BOOLEAN( 'u', "udp",     &udp,      "Use UDP instead of TCP"),
+	OPT_STRING(  'C', "cpu",     &cpu_list, "cpu", "List of cpus to pin threads to, client and server alternating"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_net_pingpong_usage[] = {
+	"perf bench net pingpong <options>",
+	NULL
+};
+
+static void wait_for_start(void)
+{
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+}
+
+/*
+ * Move a whole message.  Returns 1 when it went through, 0 when the
+ * receive timed out, so the caller gets to look at 'done', and -1 when
+ * the peer went away.
+ */
+static int xfer_msg(int fd, char *buf, bool send_msg,
+		    struct sockaddr *addr, socklen_t *addrlen)
+{
+	size_t len = 0;
+	ssize_t ret;
+
+	while (len < msg_size) {
+		if (send_msg)
+			ret = sendto(fd, buf + len, msg_size - len, 0,
+				     addr, addr ? *addrlen : 0);
+		else
+			ret = recvfrom(fd, buf + len, msg_size - len, 0,
+				       addr, addrlen);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				/* don't lose track of a partial message */
+				if (len && !done)
+					continue;
+				return 0;
+			}
+			if (errno == ECONNRESET || errno == EPIPE)
+				return -1;
+			err(EXIT_FAILURE, send_msg ? "send" : "recv");
+		}
+		if (!ret && !send_msg)
+			return -1;
+
+		/* a datagram is all or nothing */
+		if (udp)
+			return 1;
+		len += ret;
+	}
+
+	return 1;
+}
+
+static void *serverfn(void *arg)
+{
+	struct pair *p = (struct pair *) arg;
+	struct sockaddr_storage peer;
+	socklen_t peerlen;
+	char *buf;
+	int fd;
+
+	buf = calloc(1, msg_size);
+	if (!buf)
+		err(EXIT_FAILURE, "calloc");
+
+	wait_for_start();
+
+	if (udp)
+		fd = p->server_fd;
+	else {
+		/* the client connected already, it's in the backlog */
+		do {
+			fd = accept(p->server_fd, NULL, NULL);
+		} while (fd < 0 && (errno == EINTR || errno == EAGAIN));
+		if (fd < 0)
+			err(EXIT_FAILURE, "accept");
+	}
+
+	while (!done) {
+		struct sockaddr *addr = udp ? (struct sockaddr *)&peer : NULL;
+		socklen_t *addrlen = udp ? &peerlen : NULL;
+		int ret;
+
+		peerlen = sizeof(peer);
+		ret = xfer_msg(fd, buf, false, addr, addrlen);
+		if (ret < 0)
+			break;
+		if (!ret)
+			continue;
+
+		if (xfer_msg(fd, buf, true, addr, addrlen) < 0)
+			break;
+	}
+
+	if (!udp)
+		close(fd);
+	free(buf);
+	return NULL;
+}
+
+static void *clientfn(void *arg)
+{
+	struct pair *p = (struct pair *) arg;
+	char *buf;
+
+	buf = calloc(1, msg_size);
+	if (!buf)
+		err(EXIT_FAILURE, "calloc");
+
+	wait_for_start();
+
+	while (!done) {
+		int ret;
+
+		ret = xfer_msg(p->client_fd, buf, true, NULL, NULL);
+		if (ret < 0)
+			break;
+		if (!ret)
+			continue;
+
+		/* on a timeout, a lost datagram gets sent again */
+		ret = xfer_msg(p->client_fd, buf, false, NULL, NULL);
+		if (ret < 0)
+			break;
+		if (ret)
+			p->ops++;
+	}
+
+	/* wake the TCP server up */
+	shutdown(p->client_fd, SHUT_RDWR);
+	free(buf);
+	return NULL;
+}
+
+static int new_socket(void)
+{
+	/* time receives out so that the threads notice when we're done */
+	struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
+	int one = 1;
+	int fd;
+
+	fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+	if (fd < 0)
+		err(EXIT_FAILURE, "socket");
+
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+		err(EXIT_FAILURE, "setsockopt(SO_RCVTIMEO)");
+
+	if (!udp && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)))
+		err(EXIT_FAILURE, "setsockopt(TCP_NODELAY)");
+
+	return fd;
+}
+
+static void setup_pair(struct pair *p)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	/* bind to an ephemeral port, then find out which one we got */
+	p->server_fd = new_socket();
+	if (bind(p->server_fd, (struct sockaddr *)&addr, sizeof(addr)))
+		err(EXIT_FAILURE, "bind");
+	if (getsockname(p->server_fd, (struct sockaddr *)&addr, &addrlen))
+		err(EXIT_FAILURE, "getsockname");
+	if (!udp && listen(p->server_fd, 1))
+		err(EXIT_FAILURE, "listen");
+
+	p->client_fd = new_socket();
+	if (connect(p->client_fd, (struct sockaddr *)&addr, sizeof(addr)))
+		err(EXIT_FAILURE, "connect");
+}
+
+static void pin_thread(pthread_attr_t *attr, unsigned int idx)
+{
+	cpu_set_t cpu;
+
+	CPU_ZERO(&cpu);
+	CPU_SET(cpus->map[idx % cpus->nr], &cpu);
+
+	if (pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &cpu))
+		err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+	double usecs = avg ? 1000000.0 / avg : 0;
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		printf("%lu %.2f %.3f\n", avg, rel_stddev_stats(stddev, avg),
+		       usecs);
+		return;
+	}
+
+	printf("%sAveraged %ld round trips/sec (+- %.2f%%), %.3f usecs/round trip, total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       usecs, (int) runtime.tv_sec);
+}
+
+int bench_net_pingpong(int argc, const char **argv,
+		       const char *prefix __maybe_unused)
+{
+	int ret = 0;
+	struct sigaction act;
+	unsigned int i;
+	pthread_attr_t thread_attr;
+
+	argc = parse_options(argc, argv, options, bench_net_pingpong_usage, 0);
+	if (argc || !npairs || !msg_size || (udp && msg_size > 65507)) {
+		usage_with_options(bench_net_pingpong_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpus = cpu_map__new(cpu_list);
+	if (!cpus)
+		errx(EXIT_FAILURE, "invalid cpu list: %s", cpu_list);
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	/* the server may write to a socket the client already shut down */
+	signal(SIGPIPE, SIG_IGN);
+
+	pairs = calloc(npairs, sizeof(*pairs));
+	if (!pairs)
+		err(EXIT_FAILURE, "calloc");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("Run summary [PID %d]: %d %s pairs exchanging %d byte messages over loopback for %d secs.\n\n",
+		       getpid(), npairs, udp ? "UDP" : "TCP", msg_size, nsecs);
+
+	for (i = 0; i < npairs; i++) {
+		pairs[i].id = i;
+		setup_pair(&pairs[i]);
+	}
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = npairs * 2;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < npairs; i++) {
+		pin_thread(&thread_attr, i * 2);
+		ret = pthread_create(&pairs[i].client, &thread_attr, clientfn,
+				     &pairs[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+
+		pin_thread(&thread_attr, i * 2 + 1);
+		ret = pthread_create(&pairs[i].server, &thread_attr, serverfn,
+				     &pairs[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	gettimeofday(&start, NULL);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < npairs; i++) {
+		ret = pthread_join(pairs[i].client, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+		ret = pthread_join(pairs[i].server, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < npairs; i++) {
+		unsigned long t = pairs[i].ops/runtime.tv_sec;
+
+		update_stats(&throughput_stats, t);
+		if (!silent && bench_format == BENCH_FORMAT_DEFAULT)
+			printf("[pair %3d] [ %ld round trips/sec ]\n",
+			       pairs[i].id, t);
+
+		close(pairs[i].client_fd);
+		close(pairs[i].server_fd);
+	}
+
+	print_summary();
+
+	free(pairs);
+	cpu_map__delete(cpus);
+	return ret;
+}
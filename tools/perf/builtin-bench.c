@@ -13,6 +13,9 @@
  *  mem   ... memory access performance
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
+ *  epoll ... Event poll performance
+ *  io    ... Block I/O submission performance
+ *  net   ... Loopback networking performance
  */
 #include "perf.h"
 #include "util/util.h"
@@ -59,10 +62,30 @@ static struct bench futex_benchmarks[] = {
 	{ "hash",	"Benchmark for futex hash table",               bench_futex_hash	},
 	{ "wake",	"Benchmark for futex wake calls",               bench_futex_wake	},
 	{ "requeue",	"Benchmark for futex requeue calls",            bench_futex_requeue	},
+	{ "lock-pi",	"Benchmark for futex lock_pi calls",            bench_futex_lock_pi	},
 	{ "all",	"Test all futex benchmarks",			NULL			},
 	{ NULL,		NULL,						NULL			}
 };
 
+static struct bench epoll_benchmarks[] = {
+	{ "wait",	"Benchmark epoll concurrent epoll_waits",	bench_epoll_wait	},
+	{ "ctl",	"Benchmark epoll concurrent epoll_ctls",	bench_epoll_ctl		},
+	{ "all",	"Test all epoll benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench io_benchmarks[] = {
+	{ "submit",	"Benchmark for native AIO submission",		bench_io_submit		},
+	{ "all",	"Test all io benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench net_benchmarks[] = {
+	{ "pingpong",	"Benchmark for loopback TCP/UDP round trips",	bench_net_pingpong	},
+	{ "all",	"Test all net benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 struct collection {
 	const char	*name;
 	const char	*summary;
@@ -76,6 +99,9 @@ static struct collection collections[] = {
 	{ "numa",	"NUMA scheduling and MM benchmarks",		numa_benchmarks		},
 #endif
 	{"futex",       "Futex stressing benchmarks",                   futex_benchmarks        },
+	{ "epoll",	"Epoll stressing benchmarks",			epoll_benchmarks	},
+	{ "io",		"Block I/O submission benchmarks",		io_benchmarks		},
+	{ "net",	"Loopback networking benchmarks",		net_benchmarks		},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -204,8 +230,12 @@ static void run_all_collections(void)
 {
 	struct collection *coll;
 
-	for_each_collection(coll)
+	for_each_collection(coll) {
+		/* needs a block device to be set up, see bench/io-submit.c */
+		if (!strcmp(coll->name, "io"))
+			continue;
 		run_collection(coll);
+	}
 }
 
 int cmd_bench(int argc, const char **argv, const char *prefix __maybe_unused)
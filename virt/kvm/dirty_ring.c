@@ -0,0 +1,163 @@
+/*
+ * KVM dirty ring implementation
+ *
+ * Every vcpu publishes the gfns it dirties into its own ring, which
+ * userspace maps through the vcpu fd.  Harvesting a ring does not need
+ * to walk or copy a bitmap covering the whole guest, so the cost of a
+ * migration pass scales with the number of pages dirtied rather than
+ * with the size of guest memory.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <linux/kvm_host.h>
+#include <linux/kvm.h>
+#include <linux/vmalloc.h>
+#include <linux/kvm_dirty_ring.h>
+
+static u32 kvm_dirty_ring_used(struct kvm_dirty_ring *ring)
+{
+	return READ_ONCE(ring->dirty_index) -
+	       smp_load_acquire(&ring->reset_index);
+}
+
+bool kvm_dirty_ring_soft_full(struct kvm_dirty_ring *ring)
+{
+	return kvm_dirty_ring_used(ring) >= ring->soft_limit;
+}
+
+bool kvm_page_in_dirty_ring(struct kvm *kvm, unsigned long pgoff)
+{
+	return KVM_DIRTY_LOG_PAGE_OFFSET > 0 &&
+	       pgoff >= KVM_DIRTY_LOG_PAGE_OFFSET &&
+	       pgoff < KVM_DIRTY_LOG_PAGE_OFFSET +
+		       kvm->dirty_ring_size / PAGE_SIZE;
+}
+
+static void kvm_reset_dirty_gfn(struct kvm *kvm, u32 slot, u64 offset,
+				unsigned long mask)
+{
+	struct kvm_memory_slot *memslot;
+
+	if (!mask || slot >= KVM_MEM_SLOTS_NUM)
+		return;
+
+	memslot = id_to_memslot(kvm_memslots(kvm), slot);
+	if (!(memslot->flags & KVM_MEM_LOG_DIRTY_PAGES) ||
+	    offset + __fls(mask) >= memslot->npages)
+		return;
+
+	spin_lock(&kvm->mmu_lock);
+	kvm_arch_mmu_enable_log_dirty_pt_masked(kvm, memslot, offset, mask);
+	spin_unlock(&kvm->mmu_lock);
+}
+
+int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, u32 size)
+{
+	ring->dirty_gfns = vzalloc(size);
+	if (!ring->dirty_gfns)
+		return -ENOMEM;
+
+	ring->size = size / sizeof(struct kvm_dirty_gfn);
+	ring->soft_limit = ring->size - kvm_dirty_ring_get_rsvd_entries();
+	ring->dirty_index = 0;
+	ring->reset_index = 0;
+
+	return 0;
+}
+
+void kvm_dirty_ring_free(struct kvm_dirty_ring *ring)
+{
+	vfree(ring->dirty_gfns);
+	ring->dirty_gfns = NULL;
+}
+
+/*
+ * Publish one dirty gfn.  Only called from the thread that has the ring's
+ * vcpu loaded.  Asks for an exit to userspace once the soft limit is
+ * reached, and fails only when even the reserved entries are used up, in
+ * which case the caller falls back to the dirty bitmap.
+ */
+int kvm_dirty_ring_push(struct kvm_vcpu *vcpu, u32 slot, u64 offset)
+{
+	struct kvm_dirty_ring *ring = &vcpu->dirty_ring;
+	struct kvm_dirty_gfn *entry;
+
+	if (unlikely(!ring->size || kvm_dirty_ring_used(ring) >= ring->size))
+		return -ENOSPC;
+
+	entry = &ring->dirty_gfns[ring->dirty_index & (ring->size - 1)];
+	entry->slot = slot;
+	entry->offset = offset;
+	/* Make the gfn visible before userspace can see the entry as dirty */
+	smp_wmb();
+	WRITE_ONCE(entry->flags, KVM_DIRTY_GFN_F_DIRTY);
+	smp_store_release(&ring->dirty_index, ring->dirty_index + 1);
+
+	if (kvm_dirty_ring_soft_full(ring))
+		kvm_make_request(KVM_REQ_DIRTY_RING_SOFT_FULL, vcpu);
+
+	return 0;
+}
+
+/*
+ * Take back the entries userspace has marked for reset, in ring order,
+ * and write protect their gfns again.  Runs of nearby gfns in the same
+ * slot are coalesced into one mask, so that harvesting sequential writes
+ * costs one mmu_lock round trip per 64 pages.  Called with slots_lock
+ * held; returns the number of entries reset.
+ */
+int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
+{
+	struct kvm_dirty_gfn *entry;
+	u32 cur_slot = 0, next_slot;
+	u64 cur_offset = 0, next_offset;
+	unsigned long mask = 0;
+	int count = 0;
+
+	while (ring->reset_index != smp_load_acquire(&ring->dirty_index)) {
+		entry = &ring->dirty_gfns[ring->reset_index & (ring->size - 1)];
+		if (!(READ_ONCE(entry->flags) & KVM_DIRTY_GFN_F_RESET))
+			break;
+
+		next_slot = READ_ONCE(entry->slot);
+		next_offset = READ_ONCE(entry->offset);
+
+		WRITE_ONCE(entry->flags, 0);
+		/* Pairs with kvm_dirty_ring_used(), the entry is free again */
+		smp_store_release(&ring->reset_index, ring->reset_index + 1);
+		count++;
+
+		if (mask && next_slot == cur_slot) {
+			s64 delta = next_offset - cur_offset;
+
+			if (delta >= 0 && delta < BITS_PER_LONG) {
+				mask |= 1UL << delta;
+				continue;
+			}
+
+			/* Backwards, but still fits into the same mask */
+			if (delta < 0 && delta > -BITS_PER_LONG &&
+			    (mask << -delta >> -delta) == mask) {
+				cur_offset = next_offset;
+				mask = (mask << -delta) | 1;
+				continue;
+			}
+		}
+
+		kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
+		cur_slot = next_slot;
+		cur_offset = next_offset;
+		mask = 1;
+	}
+
+	kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
+
+	return count;
+}
+
+struct page *kvm_dirty_ring_get_page(struct kvm_dirty_ring *ring, u32 offset)
+{
+	return vmalloc_to_page((void *)ring->dirty_gfns + offset * PAGE_SIZE);
+}